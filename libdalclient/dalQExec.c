@@ -390,25 +390,30 @@ dal_closeQueryResponse (QResponse qr_h)
     if (qr == NULL)
 	return;
 
-    /* Free character data storage. */
-    vut_cmemDestroy (qr->cmem);
-
-    /* Free row storage. */
-    free ((void *)qr->rows);
-
-    /* Free all hash tables. */
-    vht_destroy (qr->hash_ucd);
-    vht_destroy (qr->hash_utype);
-    vht_destroy (qr->hash_name);
-    vht_destroy (qr->hash_id);
-    vht_destroy (qr->hash_prop);
-
-    /* Free the list of properties and associated nodes. */
-    vll_destroy (qr->properties, free);
-
-    /* Free the FIELD and INFO lists and associated nodes. */
-    vll_destroy (qr->fields, free);
-    vll_destroy (qr->infos, free);
+    /* A response created by dal_executeVOTable() holds only the cached
+     * text, the parsed-table storage is allocated by dal_executeQuery().
+     */
+    if (qr->cmem) {
+	/* Free character data storage. */
+	vut_cmemDestroy (qr->cmem);
+
+	/* Free row storage. */
+	free ((void *)qr->rows);
+
+	/* Free all hash tables. */
+	vht_destroy (qr->hash_ucd);
+	vht_destroy (qr->hash_utype);
+	vht_destroy (qr->hash_name);
+	vht_destroy (qr->hash_id);
+	vht_destroy (qr->hash_prop);
+
+	/* Free the list of properties and associated nodes. */
+	vll_destroy (qr->properties, free);
+
+	/* Free the FIELD and INFO lists and associated nodes. */
+	vll_destroy (qr->fields, free);
+	vll_destroy (qr->infos, free);
+    }
 
     /* Free the votable text. */
     if (qr->votable)
@@ -453,8 +458,6 @@ dal_executeVOTable (Query query_h)
     /* Allocate the QueryResponse descriptor. */
     if ((qr = (dalQR_t *) calloc ((size_t)1, sizeof(dalQR_t))) == NULL)
 	return (dal_nError (dal, DAL_MEMALLOCFAIL));
-    else
-	query->qr_h = svr_newHandle (dal->context, dal);
 
     /* Get the Query URL. */
     char *queryURL = dal_getQueryURL (query_h);
@@ -476,10 +479,16 @@ dal_executeVOTable (Query query_h)
 	    (errcode > 0) ? errcode : DAL_EXECUTEQUERY));
     } else {
         len = strlen (qr->votable);
-	if (qr->votable[len-1] != '\n')		/* ensure a newline	*/
+	if (len > 0 && qr->votable[len-1] != '\n')	/* ensure a newline */
 	    strcat (qr->votable, "\n");
     }
 
+    /* Register the response only once it holds the text, so the cached
+     * copy is found by the dal_executeDelimited() family.
+     */
+    qr->query = query;
+    query->qr_h = qr->qr_h = svr_newHandle (dal->context, qr);
+
     return (qr->votable);
 }
 
@@ -572,9 +581,11 @@ dal_executeDelimited (Query query_h, char delim)
     dalQuery_t *query = svr_H2P (query_h);
     dalQR_t *qr = svr_H2P (query->qr_h);
 
-    /* If the query has already executed merely return the votable text */
-    qr->votable = votable;
-    if (qr != NULL && qr->votable != NULL) {
+    /* If the query has already been converted merely return the text. */
+    if (qr != NULL && qr->delimited != NULL)
+	return (qr->delimited);
+
+    if (qr != NULL && votable != NULL) {
 
         /* Convert the VOTable to the delimited result table requested. We
 	 * also free up the VOTable text at this point.
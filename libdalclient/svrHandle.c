@@ -49,6 +49,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 
 /* Internal Definitions.
@@ -59,7 +60,7 @@
 #define	SZ_HCNAME	64	/* context name */
 
 #define	H_ENCODE(c,i)	(((i)<<8)|(c))
-#define	H_CONTEXT(h)	((h)&0x77)
+#define	H_CONTEXT(h)	((h)&0xff)
 #define	H_SLOT(h)	((h)>>8)
 
 typedef  int 	handle_t;
@@ -75,6 +76,12 @@ int	svr_HContextOverflow = 0;
 int	svr_HContextPoolOverflow = 0;
 svr_hContext_t *svrHContexts[MAX_CONTEXTS];	/* context descriptors */
 
+/* Connections may be opened and closed from several threads at once (e.g.
+ * concurrent service queries), so changes to the tables are serialized.
+ * Lookups are not locked:  a handle is only used by the thread owning it.
+ */
+static pthread_mutex_t svr_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /*  Public procedures
 */
@@ -124,12 +131,14 @@ svr_resetHandles (void)
 	return;
 
     /* Free any context descriptors. */
-    for (i=0;  i < svr_numHContexts;  i++)
+    pthread_mutex_lock (&svr_mutex);
+    for (i=0;  i <= svr_numHContexts && i < MAX_CONTEXTS;  i++)
 	if (svrHContexts[i] != NULL)
 	    free ((void *) svrHContexts[i]);
 
     svr_numHContexts = 0;
     memset (svrHContexts, 0, sizeof (svrHContexts));
+    pthread_mutex_unlock (&svr_mutex);
 }
 
 
@@ -156,6 +165,11 @@ svr_newHandleContext (char *name, int size)
     svr_hContext_t *hc = NULL;
     int i, context = -1;
 
+    /* Allocate a new Context descriptor. */
+    hc = (svr_hContext_t *) calloc ((size_t)1, sizeof(svr_hContext_t));
+
+    pthread_mutex_lock (&svr_mutex);
+
     /* Initialize the handle-to-ptr converter the first time we're called.  */
     if (svr_numHContexts == 0)
 	memset (svrHContexts, 0, sizeof (svrHContexts));
@@ -163,23 +177,21 @@ svr_newHandleContext (char *name, int size)
     /* Reuse an empty context if available.  Skip context zero so that a
      * legal handle cannot be zero.
      */
-    for (i=1;  i < svr_numHContexts;  i++)
+    for (i=1;  i <= svr_numHContexts && i < MAX_CONTEXTS;  i++)
 	if (svrHContexts[i] == NULL) {
 	    context = i;
 	    break;
 	}
 
     /* Add a new context descriptor to the active pool. */
-    if (context < 0)
+    if (context < 0 && svr_numHContexts < MAX_CONTEXTS - 1)
 	context = ++svr_numHContexts;
 
-    /* Allocate a new Context descriptor. */
-    hc = (svr_hContext_t *) calloc ((size_t)1, sizeof(svr_hContext_t));
-
     /* Overflow should not be possible or we will need a smarter error
      * handling mechanism here.
      */
-    if (svr_numHContexts > MAX_CONTEXTS || (hc == NULL)) {
+    if (context < 0 || (hc == NULL)) {
+	pthread_mutex_unlock (&svr_mutex);
 	fprintf (stderr, "Error: ran out of voclient handle contexts!\n");
 	if (hc != NULL) {
 	    svr_HContextPoolOverflow++;
@@ -193,6 +205,7 @@ svr_newHandleContext (char *name, int size)
     strncpy (hc->name, name, SZ_HCNAME-1);
     hc->nHandles = 0;
 
+    pthread_mutex_unlock (&svr_mutex);
     return (context);
 }
 
@@ -211,8 +224,13 @@ svr_newHandleContext (char *name, int size)
 void
 svr_closeHandleContext (int context)
 {
-	free ((void *) svrHContexts[context]);
-	svrHContexts[context] = NULL;
+    if (context <= 0 || context >= MAX_CONTEXTS)
+	return;
+
+    pthread_mutex_lock (&svr_mutex);
+    free ((void *) svrHContexts[context]);
+    svrHContexts[context] = NULL;
+    pthread_mutex_unlock (&svr_mutex);
 }
 
 
@@ -246,16 +264,18 @@ svr_newHandle (int context, void *ptr)
     }
 
     /* Index zero is not used here. */
+    pthread_mutex_lock (&svr_mutex);
     slot = ++hc->nHandles;
     hc->index[slot] = (long) ptr;
 
     /* Wrap around if we run out of slots.  This should not happen, but
      * could if the context is very active and handles are not freed.
      */
-    if (hc->nHandles >= MAX_HANDLES) {
+    if (hc->nHandles >= MAX_HANDLES - 1) {
 	svr_HContextOverflow++;
 	hc->nHandles = 0;
     }
+    pthread_mutex_unlock (&svr_mutex);
 
     return (H_ENCODE(context,slot));
 } 
@@ -291,9 +311,11 @@ svr_freeHandle (handle_t handle)
     }
 
     /* Free the handle. */
+    pthread_mutex_lock (&svr_mutex);
     hc->index[slot] = 0;
     if (slot > 0 && slot == hc->nHandles)
 	--hc->nHandles;
+    pthread_mutex_unlock (&svr_mutex);
 }
 
 
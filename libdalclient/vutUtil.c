@@ -20,6 +20,7 @@
 #include <ctype.h>
 #include <sys/file.h>
 #include <sys/types.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #ifdef OLD_CURL
 #include <curl/types.h>
@@ -34,6 +35,15 @@
 static char vut_toHex (char code);
 static size_t vut_memoryCallback (void *ptr,
     size_t size, size_t nmemb, void *data);
+static CURL *vut_threadCurl (void);
+static void  vut_curlInit (void);
+static void  vut_curlFree (void *curl);
+
+/*  Curl handles are kept per-thread so that repeated queries from the same
+ *  thread reuse the open (keep-alive) connection to the service host.
+ */
+static pthread_once_t vut_curlOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  vut_curlKey;
 
 
 /*
@@ -71,7 +81,7 @@ vut_urlOpen (char *baseURL, char *resource)
     char *ip, *op;
 
     /* Get descriptor. */
-    vutUrl_t *vutUrl = (vutUrl_t *) calloc (1, sizeof(vutUrl));
+    vutUrl_t *vutUrl = (vutUrl_t *) calloc (1, sizeof(vutUrl_t));
     vutUrl->urlbuf = (char *) calloc (1, SZ_URL);
 
     /* Copy the baseURL. */
@@ -235,9 +245,8 @@ vut_getURLtoFile (dalConn_t *dal, char *url, char *fname)
     if (fp == NULL)
 	return (dal_error (dal, DAL_CANNOTOPENFILE));
 
-    /* Init the Curl session. */
-    curl_global_init (CURL_GLOBAL_ALL);
-    if ((curl = curl_easy_init()) == NULL) {
+    /* Get the Curl session for this thread. */
+    if ((curl = vut_threadCurl ()) == NULL) {
 	fclose (fp);
 	return (dal_error (dal, DAL_CURLINITERR));
     }
@@ -248,10 +257,10 @@ vut_getURLtoFile (dalConn_t *dal, char *url, char *fname)
     curl_easy_setopt (curl, CURLOPT_WRITEDATA, (void *)fp);
     curl_easy_setopt (curl, CURLOPT_USERAGENT, "dalclient/1.0");
     curl_easy_setopt (curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
 
     /* Perform the request. */
     stat = curl_easy_perform (curl);
-    curl_easy_cleanup (curl);
 
     /* Clean up if operation fails. */
     if (stat != CURLE_OK) {
@@ -288,6 +297,7 @@ vut_getURLtoFile (dalConn_t *dal, char *url, char *fname)
 	return (dal_error (dal, errcode));
     }
 
+    fclose (fp);
     return (DAL_OK);
 }
 
@@ -307,9 +317,9 @@ vut_getURL (dalConn_t *dal, char *url)
     chunk.size = 0;    /* no data at this point */
 
 
-    /*  Init the Curl session.  */
-    curl_global_init (CURL_GLOBAL_ALL);
-    curl = curl_easy_init ();
+    /*  Get the Curl session for this thread.  */
+    if ((curl = vut_threadCurl ()) == NULL)
+	return (dal_nError (dal, DAL_CURLINITERR));
 
     /*  Specify the Curl options.  */
     curl_easy_setopt (curl, CURLOPT_URL, url);
@@ -318,18 +328,17 @@ vut_getURL (dalConn_t *dal, char *url)
     curl_easy_setopt (curl, CURLOPT_USERAGENT, "dalclient/1.0");
     curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION, 1);
     curl_easy_setopt (curl, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1);
 
     /*  Do the download.  */
     if ((stat = curl_easy_perform (curl)) != CURLE_OK) {
         data = NULL; 			/* error in download.  	*/
     } else 
 	data = (char *) calloc (1, chunk.size + 2);
-    
-    curl_easy_cleanup (curl); 	/* cleanup curl stuff 	*/
-    curl_global_cleanup();		
 
     if (chunk.memory) {
-	memcpy (data, chunk.memory, chunk.size);
+	if (data)
+	    memcpy (data, chunk.memory, chunk.size);
 	free ((void *) chunk.memory);
     }
 
@@ -371,6 +380,47 @@ vut_getURL (dalConn_t *dal, char *url)
 }
 
 
+/* vut_threadCurl -- Return the calling thread's Curl session, creating it
+ * on first use.  The session (and its connection cache) is released when
+ * the thread exits.
+ */
+static CURL *
+vut_threadCurl (void)
+{
+    CURL *curl;
+
+    pthread_once (&vut_curlOnce, vut_curlInit);
+
+    if ((curl = (CURL *) pthread_getspecific (vut_curlKey)) == NULL) {
+	if ((curl = curl_easy_init ()) != NULL)
+	    pthread_setspecific (vut_curlKey, (void *) curl);
+    } else
+	curl_easy_reset (curl);		/* keeps the open connections	*/
+
+    return (curl);
+}
+
+
+/* vut_curlInit -- One-time Curl library initialization.
+ */
+static void
+vut_curlInit (void)
+{
+    curl_global_init (CURL_GLOBAL_ALL);
+    pthread_key_create (&vut_curlKey, vut_curlFree);
+}
+
+
+/* vut_curlFree -- Thread-exit destructor for a per-thread Curl session.
+ */
+static void
+vut_curlFree (void *curl)
+{
+    if (curl)
+	curl_easy_cleanup ((CURL *) curl);
+}
+
+
 /* vut_memoryCallback -- Callback function for Curl downloader.
  * (adapted from the VOClient svr_getURL to be more self-contained)
  */
@@ -595,7 +645,7 @@ char *
 vut_votableToDelimited (char *votable, char delim)
 {
     handle_t vot, res, tab, field, data, tdata, tr, td;
-    char  *delimited = NULL, *name = NULL, *id = NULL, *ucd = NULL, *s;
+    char  *delimited = NULL, *name = NULL, *id = NULL, *ucd = NULL, *s, *op;
     char   buf[SZ_VALSTR], dbuf[2];
     int    i, ncols = 0;
 
@@ -614,37 +664,41 @@ vut_votableToDelimited (char *votable, char delim)
 
     /*  Get the table and data elements.
      */
-    if ( ! (res = vot_getRESOURCE (vot)) )
-	return (NULL);
-    if ( ! (tab = vot_getTABLE (res)) )
-	return (NULL);
-    if ( ! (data = vot_getDATA (tab)) )
-	return (NULL);
-    if ( ! (tdata = vot_getTABLEDATA (data)) )
-	return (NULL);
+    if ( ! (res = vot_getRESOURCE (vot)) ||
+	 ! (tab = vot_getTABLE (res)) ||
+	 ! (data = vot_getDATA (tab)) ||
+	 ! (tdata = vot_getTABLEDATA (data)) ) {
+	    vot_closeVOTABLE (vot);
+	    free ((void *) delimited);
+	    return (NULL);
+    }
     ncols = vot_getNCols (tdata);
 
 
-    /* Build the header line.
+    /* Build the header line.  The text is appended at 'op' so the cost
+     * stays linear in the size of the table.
      */
-    strcpy (delimited, "# ");
+    op = stpcpy (delimited, "# ");
     i = 0;
     for (field = vot_getFIELD (tab); field; field = vot_getNext (field)) {
         name = vot_getAttr (field, "name");     /* find a reasonable value */
         id   = vot_getAttr (field, "id");
         ucd  = vot_getAttr (field, "ucd");
         if (name || id || ucd) {
-	    strcat (delimited, (name ? name : (id ? id : ucd)) );
+	    op = stpcpy (op, (name ? name : (id ? id : ucd)) );
         } else {
 	    memset (buf, 0, SZ_VALSTR);
             sprintf (buf, "col%d", i);
-	    strcat (delimited, buf);
+	    op = stpcpy (op, buf);
 	}
         if (i < (ncols-1))
-	    strcat (delimited, dbuf);
+	    op = stpcpy (op, dbuf);
+	if (name) free ((void *) name);
+	if (id)   free ((void *) id);
+	if (ucd)  free ((void *) ucd);
         i++;
     }
-    strcat (delimited, "\n");
+    op = stpcpy (op, "\n");
 
     /* Now dump the data.
     */
@@ -652,16 +706,16 @@ vut_votableToDelimited (char *votable, char delim)
         for (td=vot_getTD(tr),i=0; td; td=vot_getNext(td),i++) {
             s = ((s =vot_getValue (td)) ? s : "");
             if (strchr (s, (int) delim) || strchr (s, (int) ' ')) {
-		memset (buf, 0, SZ_VALSTR);
-                sprintf (buf, "\"%s\"", s);
-                strcat (delimited, buf);
+                *op++ = '"';
+                op = stpcpy (op, s);
+                *op++ = '"';
             } else
-                strcat (delimited, s);
+                op = stpcpy (op, s);
 
             if (i < (ncols-1))
-                strcat (delimited, dbuf);
+                op = stpcpy (op, dbuf);
         }
-        strcat (delimited, "\n");
+        op = stpcpy (op, "\n");
     }
 
     /* Clean up. */
@@ -0,0 +1,299 @@
+/**
+ *  BENCHGEN.C -- Synthetic VOTable generator for the benchmark suite.
+ *
+ *  @file       benchGen.c
+ *  @author     Mike Fitzpatrick
+ *  @date       10/18/26
+ *
+ *  @brief      Synthetic VOTable generator for the benchmark suite.
+ *
+ *  Tables are written with a fixed random seed so a given shape always
+ *  produces the same document.  Column datatypes are taken cyclically from
+ *  a comma-delimited list (e.g. "double,int,char"), data may be serialized
+ *  as TABLEDATA or as a base64 BINARY2 stream.  The supported datatypes
+ *  are boolean, unsignedByte, short, int, long, float, double and char.
+ *  The first two floating-point columns are tagged as the RA and Dec.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchGen.h"
+
+
+#define	SZ_TYPE		32
+#define	MAX_TYPES	64
+#define	SZ_STRVAL	12			/* length of char values      */
+
+static char *bench_types[] = {
+    "boolean", "unsignedByte", "short", "int", "long",
+    "float", "double", "char", NULL
+};
+
+static char  b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int   bench_parseTypes (char *types, char tlist[][SZ_TYPE]);
+static void  bench_putBE (unsigned char *op, void *val, int nbytes);
+static void  bench_b64Write (FILE *fd, unsigned char *buf, int len,
+				int *col, unsigned char *carry, int *ncarry);
+
+
+
+/**
+ *  BENCH_GENTABLE -- Write a synthetic VOTable.
+ *
+ *  @brief  Write a synthetic VOTable
+ *  @fn     nbytes = bench_genTable (char *fname, int nrows, int ncols,
+ *		char *types, int binary)
+ *
+ *  @param  fname 	output file name
+ *  @param  nrows 	number of rows
+ *  @param  ncols 	number of columns
+ *  @param  types 	comma-delimited datatype list (NULL for default)
+ *  @param  binary 	serialize as BINARY2?
+ *  @return		size of the file written, or -1 on error
+ */
+long
+bench_genTable (char *fname, int nrows, int ncols, char *types, int binary)
+{
+    char   tlist[MAX_TYPES][SZ_TYPE], *dtype, sval[SZ_STRVAL+1];
+    unsigned char *row, *op, carry[3];
+    int    i, j, k, ntypes, nflag, rowmax, col = 0, ncarry = 0;
+    int    ival, racol = -1, deccol = -1;
+    short  sval16;
+    long long lval;
+    float  fval;
+    double dval;
+    long   size;
+    FILE  *fd;
+
+
+    if ((ntypes = bench_parseTypes ((types ? types : BENCH_TYPES), tlist)) < 0)
+	return (-1);
+
+    if ((fd = fopen (fname, "w")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open output file '%s'\n", fname);
+	return (-1);
+    }
+
+    /*  The position UCDs go on the first two floating-point columns.
+     */
+    for (j=0; j < ncols && deccol < 0; j++) {
+	dtype = tlist[j % ntypes];
+	if (strcmp (dtype, "double") == 0 || strcmp (dtype, "float") == 0) {
+	    if (racol < 0)
+		racol = j;
+	    else
+		deccol = j;
+	}
+    }
+
+    srand48 (BENCH_SEED);
+
+    fprintf (fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf (fd, "<VOTABLE version=\"1.3\">\n<RESOURCE>\n");
+    fprintf (fd, "<TABLE name=\"bench\">\n");
+    for (j=0; j < ncols; j++) {
+	dtype = tlist[j % ntypes];
+	fprintf (fd, "<FIELD name=\"col%d\" ID=\"col%d\" datatype=\"%s\"%s",
+	    j + 1, j + 1, dtype,
+	    (strcmp (dtype, "char") == 0 ? " arraysize=\"*\"" : ""));
+	if (j == racol)
+	    fprintf (fd, " ucd=\"pos.eq.ra;meta.main\"");
+	else if (j == deccol)
+	    fprintf (fd, " ucd=\"pos.eq.dec;meta.main\"");
+	fprintf (fd, "/>\n");
+    }
+    fprintf (fd, "<DATA>\n");
+
+
+    if (!binary) {
+	fprintf (fd, "<TABLEDATA>\n");
+	for (i=0; i < nrows; i++) {
+	    fprintf (fd, "<TR>");
+	    for (j=0; j < ncols; j++) {
+		dtype = tlist[j % ntypes];
+		fprintf (fd, "<TD>");
+		if (strcmp (dtype, "char") == 0) {
+		    for (k=0; k < SZ_STRVAL; k++)
+			fputc ('a' + (int)(drand48() * 26), fd);
+		} else if (strcmp (dtype, "boolean") == 0) {
+		    fputc ((drand48() < 0.5 ? 'F' : 'T'), fd);
+		} else if (strcmp (dtype, "unsignedByte") == 0) {
+		    fprintf (fd, "%d", (int)(drand48() * 256));
+		} else if (strcmp (dtype, "short") == 0 ||
+		           strcmp (dtype, "int") == 0) {
+		    fprintf (fd, "%d", (int)(drand48() * 32000));
+		} else if (strcmp (dtype, "long") == 0) {
+		    fprintf (fd, "%lld", (long long)(drand48() * 4.0e12));
+		} else {
+		    dval = drand48() * 360.0;
+		    fprintf (fd, "%.10g", (j == deccol ? dval / 2.0 - 90.0 : dval));
+		}
+		fprintf (fd, "</TD>");
+	    }
+	    fprintf (fd, "</TR>\n");
+	}
+	fprintf (fd, "</TABLEDATA>\n");
+
+    } else {
+	/*  BINARY2 rows are a null-flag prefix followed by the big-endian
+	 *  values, char values carry a 4-byte length.
+	 */
+	nflag  = (ncols + 7) / 8;
+	rowmax = nflag + ncols * (4 + SZ_STRVAL);
+	row    = (unsigned char *) calloc (rowmax, 1);
+
+	fprintf (fd, "<BINARY2>\n<STREAM encoding=\"base64\">\n");
+	for (i=0; i < nrows; i++) {
+	    memset (row, 0, rowmax);
+	    op = row + nflag;
+	    for (j=0; j < ncols; j++) {
+		dtype = tlist[j % ntypes];
+		if (strcmp (dtype, "char") == 0) {
+		    ival = SZ_STRVAL;
+		    bench_putBE (op, &ival, 4), op += 4;
+		    for (k=0; k < SZ_STRVAL; k++)
+			sval[k] = 'a' + (int)(drand48() * 26);
+		    memcpy (op, sval, SZ_STRVAL), op += SZ_STRVAL;
+		} else if (strcmp (dtype, "boolean") == 0) {
+		    *op++ = (drand48() < 0.5 ? 'F' : 'T');
+		} else if (strcmp (dtype, "unsignedByte") == 0) {
+		    *op++ = (unsigned char) (drand48() * 256);
+		} else if (strcmp (dtype, "short") == 0) {
+		    sval16 = (short) (drand48() * 32000);
+		    bench_putBE (op, &sval16, 2), op += 2;
+		} else if (strcmp (dtype, "int") == 0) {
+		    ival = (int) (drand48() * 32000);
+		    bench_putBE (op, &ival, 4), op += 4;
+		} else if (strcmp (dtype, "long") == 0) {
+		    lval = (long long) (drand48() * 4.0e12);
+		    bench_putBE (op, &lval, 8), op += 8;
+		} else if (strcmp (dtype, "float") == 0) {
+		    fval = (float) (drand48() * 360.0);
+		    if (j == deccol)
+			fval = fval / 2.0 - 90.0;
+		    bench_putBE (op, &fval, 4), op += 4;
+		} else {
+		    dval = drand48() * 360.0;
+		    if (j == deccol)
+			dval = dval / 2.0 - 90.0;
+		    bench_putBE (op, &dval, 8), op += 8;
+		}
+	    }
+	    bench_b64Write (fd, row, (int)(op - row), &col, carry, &ncarry);
+	}
+	bench_b64Write (fd, NULL, 0, &col, carry, &ncarry);	/* flush */
+	fprintf (fd, "\n</STREAM>\n</BINARY2>\n");
+	free ((void *) row);
+    }
+
+    fprintf (fd, "</DATA>\n</TABLE>\n</RESOURCE>\n</VOTABLE>\n");
+
+    size = ftell (fd);
+    fclose (fd);
+
+    return (size);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  BENCH_PARSETYPES -- Split the datatype list, returns -1 if a type is
+ *  not one the generator knows how to encode.
+ */
+static int
+bench_parseTypes (char *types, char tlist[][SZ_TYPE])
+{
+    char  buf[SZ_TYPE * MAX_TYPES], *tok, *last = NULL;
+    int   n = 0, i;
+
+    memset (buf, 0, sizeof (buf));
+    strncpy (buf, types, sizeof (buf) - 1);
+    for (tok=strtok_r (buf, ",", &last); tok && n < MAX_TYPES;
+	tok=strtok_r (NULL, ",", &last)) {
+	    for (i=0; bench_types[i]; i++)
+		if (strcmp (tok, bench_types[i]) == 0)
+		    break;
+	    if (bench_types[i] == NULL) {
+		fprintf (stderr, "Error: unsupported datatype '%s'\n", tok);
+		return (-1);
+	    }
+	    memset (tlist[n], 0, SZ_TYPE);
+	    strncpy (tlist[n++], tok, SZ_TYPE - 1);
+    }
+    if (n == 0)
+	strcpy (tlist[n++], "double");
+
+    return (n);
+}
+
+
+/**
+ *  BENCH_PUTBE -- Store a value in big-endian byte order.
+ */
+static void
+bench_putBE (unsigned char *op, void *val, int nbytes)
+{
+    unsigned char *ip = (unsigned char *) val;
+    int  i, one = 1;
+
+    if (*((char *) &one))		/* little-endian host	*/
+	for (i=0; i < nbytes; i++)
+	    op[i] = ip[nbytes - 1 - i];
+    else
+	memcpy (op, ip, nbytes);
+}
+
+
+/**
+ *  BENCH_B64WRITE -- Base64 encode a buffer to the stream.  Leftover
+ *  bytes are carried to the next call, a NULL buffer flushes them.
+ */
+static void
+bench_b64Write (FILE *fd, unsigned char *buf, int len, int *col,
+		unsigned char *carry, int *ncarry)
+{
+    unsigned char  in[3];
+    int  i = 0, n;
+
+
+    if (buf == NULL) {				/* flush with padding	*/
+	if ((n = *ncarry) == 0)
+	    return;
+	in[0] = carry[0];
+	in[1] = (n > 1 ? carry[1] : 0);
+	fputc (b64[in[0] >> 2], fd);
+	fputc (b64[((in[0] & 0x03) << 4) | (in[1] >> 4)], fd);
+	fputc ((n > 1 ? b64[(in[1] & 0x0f) << 2] : '='), fd);
+	fputc ('=', fd);
+	*ncarry = 0;
+	return;
+    }
+
+    while (*ncarry + (len - i) >= 3) {
+	for (n=0; n < *ncarry; n++)
+	    in[n] = carry[n];
+	for ( ; n < 3; n++)
+	    in[n] = buf[i++];
+	*ncarry = 0;
+
+	fputc (b64[in[0] >> 2], fd);
+	fputc (b64[((in[0] & 0x03) << 4) | (in[1] >> 4)], fd);
+	fputc (b64[((in[1] & 0x0f) << 2) | (in[2] >> 6)], fd);
+	fputc (b64[in[2] & 0x3f], fd);
+
+	if ((*col += 4) >= 76) {
+	    fputc ('\n', fd);
+	    *col = 0;
+	}
+    }
+    while (i < len)
+	carry[(*ncarry)++] = buf[i++];
+}
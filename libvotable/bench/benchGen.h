@@ -0,0 +1,15 @@
+/**
+ *  BENCHGEN.H -- Declarations for the libVOTable benchmark suite.
+ *
+ *  @file       benchGen.h
+ *  @author     Mike Fitzpatrick
+ *  @date       10/18/26
+ *
+ *  @brief      Declarations for the libVOTable benchmark suite.
+ */
+
+#define	BENCH_SEED	1234			/* generator random seed      */
+#define	BENCH_TYPES	"double,double,float,int,char"	/* default types      */
+
+long	bench_genTable (char *fname, int nrows, int ncols, char *types,
+			int binary);
@@ -0,0 +1,213 @@
+/*
+ *  VOTBENCH
+ *
+ *  Benchmark the libVOTable parser, accessors and writers.
+ *
+ *    Usage:
+ *		votbench [-r rows] [-c cols] [-t types] [-b] [-l] [-n reps]
+ *			 [-f file] [-k]
+ *
+ *	-r rows		number of rows to generate (default 100000)
+ *	-c cols		number of columns to generate (default 10)
+ *	-t types	comma-delimited column datatypes, used cyclically
+ *	-b		generate BINARY2 rather than TABLEDATA
+ *	-l		parse with lazy <TR>/<TD> materialization
+ *	-n reps		repetitions, the best time is reported (default 3)
+ *	-f file		benchmark an existing VOTable rather than generating
+ *	-k		keep the generated and output files
+ *
+ *  Results are written to stdout as one tab-separated line per benchmark:
+ *
+ *	bench  serialization  rows  cols  bytes  sec  rows_s  mb_s
+ *
+ *  where 'bytes' is the input document size for the parse/scan/sort/close
+ *  benchmarks and the output file size for the writers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include "votParse.h"
+#include "benchGen.h"
+
+
+#define	SZ_FNAME		256
+
+enum { B_PARSE, B_SCAN, B_SORT, B_WVOT, B_WCSV, B_WFITS, B_CLOSE, NBENCH };
+
+static char *bnames[] = { "parse", "scan", "sort", "write_votable",
+			  "write_csv", "write_fits", "close" };
+
+static double  btime[NBENCH];			/* best time per benchmark  */
+static long    bbytes[NBENCH];			/* bytes per benchmark	    */
+
+static double  bench_now (void);
+static long    bench_fsize (char *fname);
+static void    bench_record (int b, double t0, long nbytes);
+
+
+
+int
+main (int argc, char **argv)
+{
+    char   *iname = NULL, *types = NULL, *s;
+    char    gname[SZ_FNAME], oname[SZ_FNAME];
+    int     i, j, n, nrows = 100000, ncols = 10, binary = 0, lazy = 0;
+    int     reps = 3, keep = 0;
+    int     vot, res, tab, data, tdata, nr, nc;
+    long    isize, nscan;
+    double  t0;
+
+
+    for (i=1; i < argc; i++) {
+	if (argv[i][0] == '-') {
+	    switch (argv[i][1]) {
+	    case 'r':  nrows  = atoi (argv[++i]);	break;
+	    case 'c':  ncols  = atoi (argv[++i]);	break;
+	    case 't':  types  = argv[++i];		break;
+	    case 'b':  binary++;			break;
+	    case 'l':  lazy++;				break;
+	    case 'n':  reps   = atoi (argv[++i]);	break;
+	    case 'f':  iname  = argv[++i];		break;
+	    case 'k':  keep++;				break;
+	    default:
+		fprintf (stderr, "Invalid option '%s'\n", argv[i]);
+		return (1);
+	    }
+	}
+    }
+
+    memset (gname, 0, SZ_FNAME);
+    memset (oname, 0, SZ_FNAME);
+    sprintf (oname, "/tmp/votbench%d", (int) getpid ());
+
+    if (iname == NULL) {			/* generate the input table  */
+	sprintf (gname, "/tmp/votbench%d.xml", (int) getpid ());
+	if (bench_genTable (gname, nrows, ncols, types, binary) < 0)
+	    return (1);
+	iname = gname;
+    }
+    isize = bench_fsize (iname);
+
+    for (i=0; i < NBENCH; i++)
+	btime[i] = -1.0;
+    vot_setLazyTD (lazy);
+
+
+    for (n=0; n < reps; n++) {
+	t0 = bench_now ();
+	if ((vot = vot_openVOTABLE (iname)) <= 0) {
+	    fprintf (stderr, "Error opening VOTable '%s'\n", iname);
+	    return (1);
+	}
+	bench_record (B_PARSE, t0, isize);
+
+	res   = vot_getRESOURCE (vot);
+	tab   = vot_getTABLE (res);
+	data  = vot_getDATA (tab);
+	tdata = vot_getTABLEDATA (data);
+	nr    = (tdata ? vot_getNRows (tdata) : nrows);
+	nc    = (tdata ? vot_getNCols (tdata) : ncols);
+	nrows = nr, ncols = nc;
+
+	if (tdata) {
+	    t0 = bench_now ();
+	    for (i=nscan=0; i < nr; i++)
+		for (j=0; j < nc; j++)
+		    if (*(s = vot_getTableCell (tdata, i, j)))
+			nscan++;
+	    bench_record (B_SCAN, t0, isize);
+
+	    t0 = bench_now ();
+	    vot_sortTable (tdata, 0, 0, 1);
+	    bench_record (B_SORT, t0, isize);
+	}
+
+	t0 = bench_now ();
+	vot_writeVOTable (vot, oname, 0);
+	bench_record (B_WVOT, t0, bench_fsize (oname));
+
+	if (tdata) {
+	    t0 = bench_now ();
+	    vot_writeCSV (vot, oname, 1);
+	    bench_record (B_WCSV, t0, bench_fsize (oname));
+	}
+
+	t0 = bench_now ();
+	vot_closeVOTABLE (vot);
+	bench_record (B_CLOSE, t0, isize);
+
+#ifdef HAVE_CFITSIO
+	/*  The FITS writer closes the document it is given, so use a
+	 *  separate (untimed) parse.
+	 */
+	if (tdata && (vot = vot_openVOTABLE (iname)) > 0) {
+	    t0 = bench_now ();
+	    vot_writeFITS (vot, oname);
+	    bench_record (B_WFITS, t0, bench_fsize (oname));
+	}
+#endif
+    }
+
+
+    printf ("# bench\tserialization\trows\tcols\tbytes\tsec\trows_s\tmb_s\n");
+    for (i=0; i < NBENCH; i++) {
+	if (btime[i] < 0.0)
+	    continue;
+	printf ("%s\t%s\t%d\t%d\t%ld\t%.6f\t%.1f\t%.3f\n", bnames[i],
+	    (binary ? "BINARY2" : (lazy ? "TABLEDATA/lazy" : "TABLEDATA")),
+	    nrows, ncols, bbytes[i], btime[i],
+	    (btime[i] > 0.0 ? nrows / btime[i] : 0.0),
+	    (btime[i] > 0.0 ? bbytes[i] / btime[i] / 1.0e6 : 0.0));
+    }
+
+    if (!keep) {
+	unlink (oname);
+	if (gname[0])
+	    unlink (gname);
+    }
+    return (0);
+}
+
+
+/**
+ *  BENCH_NOW -- Wall clock time in seconds.
+ */
+static double
+bench_now (void)
+{
+    struct timeval  tv;
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec / 1.0e6);
+}
+
+
+/**
+ *  BENCH_FSIZE -- Size of a file in bytes.
+ */
+static long
+bench_fsize (char *fname)
+{
+    struct stat  st;
+
+    return ((stat (fname, &st) == 0) ? (long) st.st_size : 0L);
+}
+
+
+/**
+ *  BENCH_RECORD -- Record a benchmark time, keeping the best of the reps.
+ */
+static void
+bench_record (int b, double t0, long nbytes)
+{
+    double  t = bench_now () - t0;
+
+    if (btime[b] < 0.0 || t < btime[b])
+	btime[b] = t;
+    bbytes[b] = nbytes;
+}
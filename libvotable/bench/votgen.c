@@ -0,0 +1,46 @@
+/*
+ *  VOTGEN
+ *
+ *  Generate a synthetic VOTable of a given shape for benchmarking.
+ *
+ *    Usage:
+ *		votgen [-r rows] [-c cols] [-t types] [-b] [-o file]
+ *
+ *	-r rows		number of rows (default 1000)
+ *	-c cols		number of columns (default 10)
+ *	-t types	comma-delimited column datatypes, used cyclically
+ *	-b		serialize as BINARY2 rather than TABLEDATA
+ *	-o file		output file (default stdout)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchGen.h"
+
+
+int
+main (int argc, char **argv)
+{
+    char  *oname = "/dev/stdout", *types = NULL;
+    int    i, nrows = 1000, ncols = 10, binary = 0;
+
+
+    for (i=1; i < argc; i++) {
+	if (argv[i][0] == '-') {
+	    switch (argv[i][1]) {
+	    case 'r':  nrows  = atoi (argv[++i]);	break;
+	    case 'c':  ncols  = atoi (argv[++i]);	break;
+	    case 't':  types  = argv[++i];		break;
+	    case 'b':  binary++;			break;
+	    case 'o':  oname  = argv[++i];		break;
+	    default:
+		fprintf (stderr, "Invalid option '%s'\n", argv[i]);
+		return (1);
+	    }
+	}
+    }
+
+    return ((bench_genTable (oname, nrows, ncols, types, binary) < 0));
+}
@@ -19,16 +19,10 @@
 
 #include "votParse.h"
 
-#define	MAX_FILES	1024
+#define	MAX_FILES	4096
 
 char   *infile[MAX_FILES];
-int	in_vot[MAX_FILES];
-int	in_res[MAX_FILES];
-
 int	nfiles  = 0;			/* Number of input files	*/
-int	out	= 0;			/* Output VOTable handle	*/
-int	vot	= 0;			/* First VOTable handle		*/
-int   	res 	= 0;			/* <RESOURCE> handle 		*/
 
 
 /**
@@ -38,7 +32,7 @@ int
 main (int argc, char **argv)
 {
     char  *out_fname = (char *) "stdout";
-    int   i, verbose = 0, indent = 1;;
+    int   i, verbose = 0;
 
 
     if (argc < 3) {
@@ -49,44 +43,23 @@ main (int argc, char **argv)
 	for (i=1; i < argc; i++) {
 	    if (argv[i][0] == '-' && strlen (argv[i]) > 1) {
 		switch (argv[i][1]) {
-		case 'i':    indent = atoi (argv[++i]); 	break;
 		case 'o':    out_fname = argv[++i]; 		break;
 		case 'v':    verbose++; 			break;
 		default:
 		    fprintf (stderr, "Unrecognized option '%c'\n", argv[i][1]);
 		    return (1);
 		}
-	    } else
+	    } else if (nfiles < MAX_FILES)
 		infile[nfiles++] = argv[i];
 	}
     }
 
 
-    /*  Open output table.
-     */
-    out = vot_openVOTABLE (NULL); 	
-
-    /*  Loop over the input tables on the cmdline.
-     */
-    for (i=0; i < nfiles; i++) {
-        vot = vot_openVOTABLE (infile[i]);	/*  Parse the table	*/
-
-	/*  Concat tables.
- 	 */
-	if ((res = vot_getRESOURCE (vot)))
-            vot_attachNode (out, res); 		
-
-        vot_closeVOTABLE (vot);			/*  Close the tables 	*/
-    }
-
-    /*  Write it out.
-     */
-    vot_writeVOTable (out, out_fname, indent);
-
-    /*  Close (and free) the output table.
+    /*  Stream the <RESOURCE> elements of each input to the output table,
+     *  the inputs are never parsed to a document tree.
      */
-    if (out) 
-	vot_closeVOTABLE (out);
+    if (verbose)
+	fprintf (stderr, "Concatenating %d tables\n", nfiles);
 
-    return (0);
+    return (vot_streamCat (infile, nfiles, out_fname));
 }
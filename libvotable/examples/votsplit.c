@@ -1 +1,53 @@
+/**
+ *  VOTSPLIT 
+ *
+ *  Example program to split a multi-RESOURCE table into single tables.
+ *
+ *    Usage:
+ *		votsplit [-n] [-o <root>] <vot>
+ *
+ *    Where
+ *	    <vot>	Input table	
+ *	    -n		Number the output tables rather than using the ID
+ *	    -o <root>	Output root name, output tables are <root>.<id>.xml
+ */
 
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "votParse.h"
+
+
+/**
+ *  Program entry point.
+ */
+int
+main (int argc, char **argv)
+{
+    char  *in_fname = (char *) "stdin", *root = (char *) "votsplit";
+    int   i, nres, number = 0;
+
+
+    for (i=1; i < argc; i++) {
+	if (argv[i][0] == '-' && strlen (argv[i]) > 1) {
+	    switch (argv[i][1]) {
+	    case 'n':    number++; 				break;
+	    case 'o':    root = argv[++i]; 			break;
+	    default:
+		fprintf (stderr, "Unrecognized option '%c'\n", argv[i][1]);
+		return (1);
+	    }
+	} else
+	    in_fname = argv[i];
+    }
+
+    /*  Stream each top-level <RESOURCE> to its own table.
+     */
+    if ((nres = vot_streamSplit (in_fname, root, number)) < 0)
+	return (1);
+
+    printf ("Wrote %d tables\n", nres);
+    return (0);
+}
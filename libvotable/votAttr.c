@@ -70,7 +70,8 @@ vot_attrSet (AttrBlock *ablock, char *name, char *value)
     } else {
 	while (attr != NULL) {
             if (name_m[0] && strcasecmp (attr->name, name_m) == 0) {
-                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL));
+		memset (attr->value, 0, SZ_ATTRVAL);	/* may be shorter */
+                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL-1));
                 value_existing = 1;
             }
             attr = attr->next;
@@ -80,12 +81,12 @@ vot_attrSet (AttrBlock *ablock, char *name, char *value)
             attr = (AttrList *) calloc (1, sizeof(AttrList));
             if (ablock->attributes == NULL) {
 		attr->next = NULL;
-                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL));
+                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL-1));
                 strcpy (attr->name, name_m);
 	    } else {
                 attr = (AttrList *) calloc (1, sizeof(AttrList));
                 attr->next = ablock->attributes;
-                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL));
+                strncpy (attr->value, value, min (strlen (value), SZ_ATTRVAL-1));
                 strcpy (attr->name, name_m);
 	    }
 	    ablock->attributes = attr;
@@ -122,8 +123,8 @@ vot_attrGet (AttrBlock *ablock, char *name)
             strncpy (value, attr->value, strlen (attr->value));
 	    if (value && value[0])
                 return (value);
-	    else 
-		return (NULL);
+	    free ((void *) value);
+	    return (NULL);
         }
         attr = attr->next;
     }
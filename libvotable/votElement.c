@@ -149,6 +149,28 @@ vot_elemName  (Element *e)
 }
 
 
+/** 
+ *  vot_elemIndex -- Get the type table index of the Element (private method).
+ *
+ *  @brief  Get the type table index of the Element (private method)
+ *  @fn     int vot_elemIndex (Element *e)
+ *
+ *  @param  *e 		A pointer to the Element
+ *  @return 		Index in the element type table, or -1
+ */
+int
+vot_elemIndex  (Element *e)
+{
+    register int i;
+    
+    for (i=0; e && elemTypes[i].type >= 0; i++) {
+        if (e->type == elemTypes[i].type)
+            return (i);
+    }
+    return (-1);
+}
+
+
 /** 
  *  vot_eType -- Get the integer value (ID) of the name (private method).
  *
@@ -207,7 +229,7 @@ char *
 vot_elemXML (Element *e)
 {
     char *XML_out = (char *) calloc (SZ_XMLTAG, sizeof (char));
-    char *name = vot_elemName (e);
+    char *name = vot_elemName (e), *attrs;
 
     
     outstr ("<");
@@ -217,8 +239,10 @@ vot_elemXML (Element *e)
 	outattr (" xmlns:xsi=\"", VOT_XSI);
 	outattr (" xsi:schemaLocation=\"", VOT_SCHEMA_LOC);
 	outattr (" xmlns=\"", VOT_XMLNS);
-    } else
-        outstr (vot_attrXML (e->attr));
+    } else {
+        outstr ((attrs = vot_attrXML (e->attr)));
+	free ((void *) attrs);
+    }
     outstr (">");
     
     return (XML_out);
@@ -20,8 +20,46 @@
 
 
 extern Stack   *element_stack;
+extern int      votLazyTD;
 
 static void     vot_compileTable (Element *tdata);
+static void     vot_lazyStart (Element *tdata);
+static void     vot_lazyElement (const char *name, int start);
+static void     vot_lazyCell (void);
+static void     vot_lazyPut (const char *s, size_t len);
+static void     vot_lazyCompile (Element *tdata);
+static void     vot_lazyFlush (int end);
+
+
+/*  Lazy TABLEDATA parse state.  When votLazyTD is set the <TR> and <TD>
+ *  elements of a TABLEDATA are never turned into Elements.  Cell text is
+ *  appended to a single string pool and the cells are recorded as pool
+ *  offsets (plus one, zero means a NULL cell) until the TABLEDATA is
+ *  complete, at which point the offsets become the compiled data matrix.
+ */
+#define	SZ_CELLPOOL		65536	/** initial cell pool size	      */
+
+static Element *lazy_tdata	= NULL;	/** TABLEDATA being parsed	      */
+static char    *lazy_pool	= NULL;	/** cell string pool		      */
+static size_t   lazy_plen	= 0;	/** used length of pool		      */
+static size_t   lazy_pmax	= 0;	/** allocated size of pool	      */
+static char   **lazy_cells	= NULL;	/** cell offsets into the pool	      */
+static size_t   lazy_ncells	= 0;	/** number of cells		      */
+static size_t   lazy_cmax	= 0;	/** allocated size of cells	      */
+static size_t   lazy_cstart	= 0;	/** pool offset of the current <TD>   */
+static int      lazy_ncols	= 0;	/** number of columns in the table    */
+static int      lazy_nrows	= 0;	/** number of rows seen		      */
+static int      lazy_rcells	= 0;	/** cells seen in the current row     */
+static int      lazy_inTD	= 0;	/** inside a <TD>?		      */
+
+/*  Row sink.  When set, every TABLEDATA is parsed in lazy mode and its
+ *  rows are handed to the sink in batches of SZ_ROWBATCH as they are
+ *  read, nothing is kept in the document tree.
+ */
+static votRowSink lazy_sink	= NULL;	/** row batch callback		      */
+static void    *lazy_client	= NULL;	/** row batch callback data	      */
+static int      lazy_brows	= 0;	/** rows in the current batch	      */
+static char    *lazy_want	= NULL;	/** columns kept (NULL: all)	      */
 
 
 /** 
@@ -44,6 +82,11 @@ vot_startElement (void *user, const char *name, const char **atts)
     char name_str[SZ_ATTRNAME], value[SZ_ATTRNAME], tempstr[SZ_ATTRNAME];
 
     
+    if (lazy_tdata) {		/* TR/TD of a lazy TABLEDATA 		*/
+	vot_lazyElement (name, 1);
+	return;
+    }
+
     memset (name_str, 0, SZ_ATTRNAME);
     strncpy (name_str, name, (SZ_ATTRNAME - 1));
     
@@ -91,6 +134,9 @@ vot_startElement (void *user, const char *name, const char **atts)
             
             votPush (element_stack, me);
 
+            if (me->type == TY_TABLEDATA && (votLazyTD || lazy_sink))
+		vot_lazyStart (me);
+
         } else
             fprintf (stderr, "ERROR: No Root node!\n");
     }
@@ -118,6 +164,11 @@ vot_endElement (void *user, const char *name)
     char tempstr[SZ_ATTRNAME];
     
 
+    if (lazy_tdata && strcasecmp (name, "TABLEDATA") != 0) {
+	vot_lazyElement (name, 0);
+	return;
+    }
+
     memset (value, 0, SZ_ATTRNAME);
     memset (tempstr, 0, SZ_ATTRNAME);
     memset (name_str, 0, SZ_ATTRNAME);
@@ -151,8 +202,14 @@ vot_endElement (void *user, const char *name)
                     }
                 }
                 
-                if (cur->type == TY_TABLEDATA)
-                    vot_compileTable (cur);
+                if (cur->type == TY_TABLEDATA) {
+		    if (cur == lazy_tdata && lazy_sink)
+                        vot_lazyFlush (1);
+		    else if (cur == lazy_tdata)
+                        vot_lazyCompile (cur);
+		    else
+                        vot_compileTable (cur);
+		}
             }
             
             if (cur->type != type)
@@ -185,6 +242,12 @@ vot_charData (void *user, const XML_Char *s, int len)
     int      clen = 0;
     
 
+    if (lazy_tdata) {		/* only <TD> text is kept in a lazy table */
+	if (lazy_inTD && len > 0)
+	    vot_lazyPut (s, (size_t) len);
+	return;
+    }
+
     cur = votPeek (element_stack);
     clen = (cur->content ? strlen (cur->content) : 0);
 
@@ -219,7 +282,12 @@ vot_charData (void *user, const XML_Char *s, int len)
 void
 vot_startCData (void *user)
 {
-    Element  *cur = votPeek (element_stack);
+    Element  *cur;
+
+    if (lazy_tdata)		/* cells carry no CDATA flag		*/
+	return;
+
+    cur = votPeek (element_stack);
     cur->isCData = 1;
 }
 
@@ -301,3 +369,387 @@ vot_compileTable (Element *tdata)
             c = r->child;
     }
 }
+
+
+
+/** 
+ *  vot_lazyMaterialize -- Build the TR/TD Elements of a lazy TABLEDATA.
+ *
+ *  @brief  Build the TR/TD Elements of a lazy TABLEDATA (private method)
+ *  @fn     vot_lazyMaterialize (Element *tdata)
+ *
+ *  @param  tdata 	TABLEDATA Element parsed in lazy mode
+ *  @return		nothing
+ *
+ *  Called the first time a caller asks for the rows of a lazy table.  The
+ *  cell strings are copied into new <TD> Elements, the data matrix is
+ *  pointed at the new content and the string pool is released, after
+ *  which the table behaves exactly as one parsed normally.
+ */
+void
+vot_lazyMaterialize (Element *tdata)
+{
+    Element *tr, *td;
+    handle_t tdata_h;
+    int   cols, rows, i, j;
+    char  *s;
+
+
+    if (tdata == NULL || tdata->pool == NULL)
+	return;
+
+    tdata_h = vot_lookupHandle (tdata);
+    cols = vot_getNCols (tdata_h);
+    rows = vot_getNRows (tdata_h);
+
+    for (i=0; i < rows; i++) {
+	tr = vot_newElem (TY_TR);
+	tr->parent = tdata;
+	if (tdata->child)
+	    tdata->last_child->next = tr;
+	else
+	    tdata->child = tr;
+	tdata->last_child = tr;
+	vot_setHandle (tr);
+
+	for (j=0; j < cols; j++) {
+	    td = vot_newElem (TY_TD);
+	    td->parent = tr;
+	    if ((s = tdata->data[i * cols + j]))
+		td->content = strdup (s);
+	    if (tr->child)
+		tr->last_child->next = td;
+	    else
+		tr->child = td;
+	    tr->last_child = td;
+	    vot_setHandle (td);
+
+	    tdata->data[i * cols + j] = td->content;
+	}
+    }
+
+    free ((void *) tdata->pool);
+    tdata->pool = NULL;
+}
+
+
+/** 
+ *  vot_lazyStart -- Begin a lazy parse of a TABLEDATA element.
+ *
+ *  @brief  Begin a lazy parse of a TABLEDATA element (private method)
+ *  @fn     vot_lazyStart (Element *tdata)
+ *
+ *  @param  tdata 	TABLEDATA Element just opened
+ *  @return		nothing
+ */
+static void
+vot_lazyStart (Element *tdata)
+{
+    /*  We need the column count to lay out the matrix as rows arrive, a
+     *  table without FIELDs is left to the normal parser.
+     */
+    if ((lazy_ncols = vot_getNCols (vot_lookupHandle (tdata))) <= 0)
+	return;
+
+    lazy_pmax   = SZ_CELLPOOL;
+    lazy_pool   = (char *) calloc (lazy_pmax, sizeof (char));
+    lazy_plen   = 0;
+    lazy_cmax   = (size_t) lazy_ncols * 1024;
+    lazy_cells  = (char **) calloc (lazy_cmax, sizeof (char *));
+    lazy_ncells = 0;
+    lazy_nrows  = 0;
+    lazy_brows  = 0;
+    lazy_rcells = 0;
+    lazy_inTD   = 0;
+
+    lazy_tdata  = tdata;
+    vot_setRowColumns (NULL, 0);
+
+    if (lazy_sink)
+	(*lazy_sink) (lazy_client, tdata, NULL, NULL, 0, VOT_ROWS_BEGIN);
+}
+
+
+/** 
+ *  vot_lazyElement -- Handle a start/end tag inside a lazy TABLEDATA.
+ *
+ *  @brief  Handle a start/end tag inside a lazy TABLEDATA (private method)
+ *  @fn     vot_lazyElement (const char *name, int start)
+ *
+ *  @param  name 	The name in the XML tag
+ *  @param  start 	Is this a start tag?
+ *  @return		nothing
+ */
+static void
+vot_lazyElement (const char *name, int start)
+{
+    if (strcasecmp (name, "TD") == 0) {
+	if (start) {
+	    lazy_inTD = (lazy_want == NULL ||
+		(lazy_rcells < lazy_ncols && lazy_want[lazy_rcells]));
+	    lazy_cstart = lazy_plen;
+	} else {
+	    vot_lazyCell ();
+	    lazy_inTD = 0;
+	}
+
+    } else if (strcasecmp (name, "TR") == 0) {
+	if (start) {
+	    lazy_rcells = 0;
+	} else {
+	    /*  Pad short rows so the matrix stays aligned.
+	     */
+	    for ( ; lazy_rcells < lazy_ncols; lazy_rcells++) {
+		lazy_cstart = lazy_plen;
+		vot_lazyCell ();
+	    }
+	    lazy_nrows++;
+
+	    if (lazy_sink && ++lazy_brows >= SZ_ROWBATCH)
+		vot_lazyFlush (0);
+	}
+
+    } else
+	votEmsg ("Unexpected element in TABLEDATA ignored.\n");
+}
+
+
+/** 
+ *  vot_lazyCell -- Record the cell just completed in the pool.
+ *
+ *  @brief  Record the cell just completed in the pool (private method)
+ *  @fn     vot_lazyCell (void)
+ *
+ *  @return		nothing
+ */
+static void
+vot_lazyCell (void)
+{
+    char **cp;
+
+
+    if (lazy_rcells >= lazy_ncols) {	/* extra cells are dropped	*/
+	lazy_plen = lazy_cstart;
+	return;
+    }
+
+    if (lazy_ncells == lazy_cmax) {
+	if (!(cp = (char **) realloc (lazy_cells, 2*lazy_cmax*sizeof(char *)))){
+	    fprintf (stderr, "ERROR: Could not realloc table cell space.\n");
+	    return;
+	}
+	lazy_cells = cp;
+	lazy_cmax *= 2;
+    }
+
+    if (lazy_plen > lazy_cstart) {
+	vot_lazyPut ("", 1);		/* terminate the string		*/
+	lazy_cells[lazy_ncells++] = (char *) (lazy_cstart + 1);
+    } else
+	lazy_cells[lazy_ncells++] = (char *) NULL;
+    lazy_rcells++;
+}
+
+
+/** 
+ *  vot_lazyPut -- Append bytes to the cell string pool.
+ *
+ *  @brief  Append bytes to the cell string pool (private method)
+ *  @fn     vot_lazyPut (const char *s, size_t len)
+ *
+ *  @param  s 		string to append
+ *  @param  len 	length of string
+ *  @return		nothing
+ */
+static void
+vot_lazyPut (const char *s, size_t len)
+{
+    char  *pp;
+    size_t pmax = lazy_pmax;
+
+
+    while (lazy_plen + len > pmax)
+	pmax *= 2;
+    if (pmax != lazy_pmax) {
+	if ((pp = (char *) realloc (lazy_pool, pmax)) == NULL) {
+	    fprintf (stderr, "ERROR: Could not realloc cell pool space.\n");
+	    return;
+	}
+	lazy_pool = pp;
+	lazy_pmax = pmax;
+    }
+
+    memcpy (&lazy_pool[lazy_plen], s, len);
+    lazy_plen += len;
+}
+
+
+/** 
+ *  vot_lazyCompile -- Compile the data matrix of a lazy TABLEDATA.
+ *
+ *  @brief  Compile the data matrix of a lazy TABLEDATA (private method)
+ *  @fn     vot_lazyCompile (Element *tdata)
+ *
+ *  @param  tdata 	TABLEDATA Element being closed
+ *  @return		nothing
+ */
+static void
+vot_lazyCompile (Element *tdata)
+{
+    Element *tab = tdata->parent->parent;
+    char  value[SZ_ATTRNAME];
+    size_t i, off;
+
+
+    /*  Trim the pool and cells to size, then turn the offsets into
+     *  pointers now that the pool can no longer move.
+     */
+    if (lazy_plen > 0 && (tdata->pool = realloc (lazy_pool, lazy_plen)))
+	lazy_pool = tdata->pool;
+    tdata->pool = lazy_pool;
+
+    if (lazy_ncells > 0)
+	tdata->data = (char **) realloc (lazy_cells,
+	    lazy_ncells * sizeof (char *));
+    if (tdata->data == NULL)
+	tdata->data = lazy_cells;
+
+    for (i=0; i < lazy_ncells; i++) {
+	off = (size_t) tdata->data[i];
+	tdata->data[i] = (off ? &tdata->pool[off - 1] : (char *) NULL);
+    }
+
+    sprintf (value, "%i", lazy_nrows);
+    vot_attrSet (tab->attr, "NROWS", value);
+
+    vot_setRowColumns (NULL, 0);
+    lazy_tdata  = NULL;
+    lazy_pool   = NULL;
+    lazy_cells  = NULL;
+    lazy_plen   = lazy_pmax = 0;
+    lazy_ncells = lazy_cmax = 0;
+}
+
+
+/** 
+ *  vot_lazyFlush -- Hand the rows parsed so far to the row sink.
+ *
+ *  @brief  Hand the rows parsed so far to the row sink (private method)
+ *  @fn     vot_lazyFlush (int end)
+ *
+ *  @param  end 	Is this the end of the TABLEDATA?
+ *  @return		nothing
+ *
+ *  The pool and cells become the property of the sink and a new pool is
+ *  started.  At the end of the TABLEDATA the remaining rows are flushed
+ *  and the sink is told the table is complete.
+ */
+static void
+vot_lazyFlush (int end)
+{
+    Element *tdata = lazy_tdata;
+    char   value[SZ_ATTRNAME];
+    size_t i, off;
+
+
+    if (lazy_brows > 0) {
+	for (i=0; i < lazy_ncells; i++) {
+	    off = (size_t) lazy_cells[i];
+	    lazy_cells[i] = (off ? &lazy_pool[off - 1] : (char *) NULL);
+	}
+	(*lazy_sink) (lazy_client, tdata, lazy_pool, lazy_cells, lazy_brows,
+	    VOT_ROWS_DATA);
+
+	lazy_pool   = (char *) calloc (lazy_pmax, sizeof (char));
+	lazy_cells  = (char **) calloc (lazy_cmax, sizeof (char *));
+	lazy_plen   = 0;
+	lazy_ncells = 0;
+	lazy_brows  = 0;
+    }
+
+    if (end) {
+	(*lazy_sink) (lazy_client, tdata, NULL, NULL, 0, VOT_ROWS_END);
+
+	sprintf (value, "%i", lazy_nrows);
+	vot_attrSet (tdata->parent->parent->attr, "NROWS", value);
+
+	vot_lazyReset ();
+    }
+}
+
+
+/** 
+ *  vot_lazyReset -- Discard the state of a lazy TABLEDATA parse.
+ *
+ *  @brief  Discard the state of a lazy TABLEDATA parse (private method)
+ *  @fn     vot_lazyReset (void)
+ *
+ *  @return		nothing
+ */
+void
+vot_lazyReset (void)
+{
+    if (lazy_pool)
+	free ((void *) lazy_pool);
+    if (lazy_cells)
+	free ((void *) lazy_cells);
+    vot_setRowColumns (NULL, 0);
+
+    lazy_tdata  = NULL;
+    lazy_pool   = NULL;
+    lazy_cells  = NULL;
+    lazy_plen   = lazy_pmax = 0;
+    lazy_ncells = lazy_cmax = 0;
+    lazy_brows  = 0;
+    lazy_inTD   = 0;
+}
+
+
+/** 
+ *  vot_setRowSink -- Set the callback receiving streamed table rows.
+ *
+ *  @brief  Set the callback receiving streamed table rows (private method)
+ *  @fn     vot_setRowSink (votRowSink sink, void *client)
+ *
+ *  @param  sink 	Row batch callback, or NULL to stop streaming
+ *  @param  client 	Data passed to the callback
+ *  @return		nothing
+ */
+void
+vot_setRowSink (votRowSink sink, void *client)
+{
+    lazy_sink   = sink;
+    lazy_client = client;
+}
+
+
+/** 
+ *  vot_setRowColumns -- Set the columns kept from the TABLEDATA being read.
+ *
+ *  @brief  Set the columns kept from the TABLEDATA being read (private method)
+ *  @fn     vot_setRowColumns (int *cols, int ncols)
+ *
+ *  @param  cols 	Column numbers to keep, or NULL for all columns
+ *  @param  ncols 	Number of columns in the list
+ *  @return		nothing
+ *
+ *  The text of the other cells is not stored, they are passed as empty
+ *  cells.  The list applies until the end of the current TABLEDATA.
+ */
+void
+vot_setRowColumns (int *cols, int ncols)
+{
+    int   i;
+
+    if (lazy_want) {
+	free ((void *) lazy_want);
+	lazy_want = NULL;
+    }
+    if (cols == NULL || lazy_tdata == NULL)
+	return;
+
+    lazy_want = (char *) calloc (lazy_ncols + 1, sizeof (char));
+    for (i=0; i < ncols; i++)
+	if (cols[i] >= 0 && cols[i] < lazy_ncols)
+	    lazy_want[cols[i]] = 1;
+}
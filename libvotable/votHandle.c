@@ -17,6 +17,7 @@
 static  Element   **handles;		/** A pointer to the handles	   */
 static  handle_t  handleMax 	= 0;	/** max	available handles	   */
 static  handle_t  handleCount 	= 0;	/** count of current used handles  */
+static  handle_t  handlePeak 	= 0;	/** peak count of used handles     */
 
 
 
@@ -31,6 +32,28 @@ static  handle_t  handleCount 	= 0;	/** count of current used handles  */
 int vot_handleCount () { return (handleCount); }
 
 
+/** 
+ *  vot_handlePeak -- Get the peak number of handle_t used (private method)
+ *
+ *  @brief  Get the peak number of handle_t used (private method)
+ *  @fn     int vot_handlePeak (void)
+ *
+ *  @return 		The largest number of handle_t types stored at once
+ */
+int vot_handlePeak () { return (handlePeak); }
+
+
+/** 
+ *  vot_handleMax -- Get the size of the handle table (private method)
+ *
+ *  @brief  Get the size of the handle table (private method)
+ *  @fn     int vot_handleMax (void)
+ *
+ *  @return 		The number of slots allocated in the handle table
+ */
+int vot_handleMax () { return (handleMax); }
+
+
 /** 
  *  vot_lookupHandle -- Lookup the handle_t to an Element (private method)
  *
@@ -103,7 +126,7 @@ vot_setHandle (Element *elem)
         handles = (Element **) calloc ((handleMax + HANDLE_INCREMENT + 1), 
 	    sizeof(Element *));
         
-        for (i = 0; i < handleMax; i++)
+        for (i = 0; i <= handleMax; i++)	/* incl. the spare slot	*/
             handles[i] = old_handles[i];
         
         handleMax = handleMax + HANDLE_INCREMENT;
@@ -114,7 +137,8 @@ vot_setHandle (Element *elem)
         if (handles[i] == NULL) {
 	    elem->handle = i + 1;
             handles[i] = elem;
-            handleCount++;
+            if (++handleCount > handlePeak)
+		handlePeak = handleCount;
             return ((i + 1));
         }
     }
@@ -138,7 +162,7 @@ vot_setHandle (Element *elem)
 void
 vot_freeHandle (handle_t handle)
 {
-    if (handle < handleMax) {
+    if (handle <= (handleMax + 1)) {
         handles[(handle - 1)] = NULL;
         handleCount--;
 
@@ -164,10 +188,10 @@ vot_getElement (handle_t handle)
         vot_handleError ("ERROR: Handle NULL.");
         /*return (NULL);*/
 
-    else if (handle > handleMax) 
+    else if (handle > (handleMax + 1)) 
         vot_handleError ("ERROR: Handle overflow.");
     
-    else if (handle < handleMax) 
+    else
         return (Element *) handles[(handle - 1)];
 
     return (NULL);
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include <curl/curl.h>
 #ifdef OLD_CURL
@@ -42,6 +43,8 @@ extern char  *strcasestr();
 static Element *vot_elementDup (handle_t element_h);
 static handle_t vot_nodeCreate (int type);
 static char    *vot_deWS (char *in);
+static void     vot_putText (char *s, FILE *fd);
+static void     vot_putCData (char *s, FILE *fd);
 #ifdef USE_VALIDITY
 static int      vot_validParents (int type);
 static int      vot_validChildren (int type);
@@ -50,6 +53,7 @@ static int      vot_validChildren (int type);
 static void     vot_attachToNode (handle_t parent, handle_t new);
 static void     vot_attachSibling (handle_t big_brother, handle_t new);
 static void 	vot_dumpXML (Element *node, int level, int indent, FILE *fd);
+static void 	vot_dumpCells (Element *tdata, int level, int indent, FILE *fd);
 
 static void 	vot_htmlHeader (FILE *fd, char *fname);
 static void 	vot_htmlTableMeta (FILE *fd, handle_t res, char *ifname);
@@ -57,6 +61,7 @@ static void 	vot_htmlTableData (FILE *fd, handle_t res, char *ifname);
 static void 	vot_htmlFooter (FILE *fd);
 
 static int 	vot_simpleGetURL (char *url, char *ofname);
+static void 	vot_parseAbort (XML_Parser parser, FILE *fd, char *tfname);
 
 #ifdef USE_DEBUG
 static void 	vot_printData (Element *tdata);
@@ -167,6 +172,9 @@ static void 	votBob (void);
  *               int = vot_valueOf  (handle)
  *               type = vot_typeOf  (handle)
  *                 vot_setWarnings  (value)
+ *                   vot_setLazyTD  (value)
+ *           value = vot_getLazyTD  (void)
+ *                    vot_getStats  (votStats *stats)
  *
  *                vot_writeVOTable  (handle, char *fname, int indent)
  *                   vot_writeHTML  (handle, char *fname)
@@ -199,6 +207,18 @@ int	 votWarn	= 0;	/*  Warn about parsing issues.  Values:
 				 *	2    Strict parsing
 				 */
 
+int	 votLazyTD	= 0;	/*  Keep TABLEDATA cells only in the compiled
+				 *  data matrix, <TR>/<TD> Elements are made
+				 *  on demand by vot_getTR().
+				 */
+
+int	 votNParse	= 0;	/*  Number of documents parsed		*/
+double	 votParseBytes	= 0.0;	/*  Bytes of XML parsed			*/
+double	 votParseTime	= 0.0;	/*  Parse wall time (sec)		*/
+
+static XML_Parser vot_parser = NULL;	/*  Parser being run		*/
+static int	 vot_stopped	= 0;	/*  Parse stopped by vot_stopParse() */
+
 
 
 /** 
@@ -221,6 +241,7 @@ vot_openVOTABLE (char *arg)
     XML_Parser parser;
 
     struct   stat st;
+    struct   timeval t0, t1;
 
     
     memset (buf, 0, BUFSIZE);
@@ -266,6 +287,7 @@ vot_openVOTABLE (char *arg)
 	nerrs = vot_simpleGetURL (arg, urlFname);
         if ( !(fd = fopen (urlFname, "r")) ) {
             fprintf (stderr, "Unable to open url '%s'\n", arg);
+	    vot_parseAbort (NULL, NULL, urlFname);
             return (0);			/* cannot open file error	*/
         }
 	fstat (fileno(fd), &st);
@@ -280,6 +302,7 @@ vot_openVOTABLE (char *arg)
         len = strlen (&arg[7]);
         if (!(fd = fopen (&arg[7], "r"))) {
             fprintf (stderr, "Unable to open input file '%s'\n", &arg[7]);
+	    vot_parseAbort (NULL, NULL, urlFname);
             return (0);			/* cannot open file error	*/
         }
 	fstat (fileno(fd), &st);
@@ -289,6 +312,7 @@ vot_openVOTABLE (char *arg)
         len = strlen (arg);
         if (!(fd = fopen (arg, "r"))) {
             fprintf (stderr, "Unable to open input file '%s'\n", arg);
+	    vot_parseAbort (NULL, NULL, urlFname);
             return (0);			/* cannot open file error	*/
         }
 	fstat (fileno(fd), &st);
@@ -301,13 +325,17 @@ vot_openVOTABLE (char *arg)
 
     } else {
         fprintf (stderr, "openVOTable(): Invalid input arg '%s'\n", arg);
+	vot_parseAbort (NULL, NULL, urlFname);
 	return (-1);
     }
 
   
     /*  Create the parser and set the input handlers.
     */
+    gettimeofday (&t0, NULL);
     parser = XML_ParserCreate (NULL);
+    vot_parser  = parser;
+    vot_stopped = 0;
     XML_SetElementHandler (parser, vot_startElement, vot_endElement);
     XML_SetCdataSectionHandler (parser, vot_startCData, vot_endCData);
     XML_SetCharacterDataHandler (parser, vot_charData);
@@ -326,8 +354,7 @@ vot_openVOTABLE (char *arg)
 		/*  Check that this actually is a VOTable.
 		 */
 		if (strcasestr (buf, "<votable") == (char *) NULL) {
-    		    if (fd != stdin) fclose (fd);
-    		    if (urlFname[0]) unlink (urlFname);
+		    vot_parseAbort (parser, fd, urlFname);
 		    return (-1);	/* not a votable */
 		}
 	    }
@@ -347,22 +374,35 @@ vot_openVOTABLE (char *arg)
 		buf[len] = '\n';
 
             if (!XML_Parse (parser, buf, len, done)) {
+		if (vot_stopped)
+		    break;		/* stopped by a row sink	*/
                 fprintf (stderr, "Error: %s at line %d\n",
                     XML_ErrorString (XML_GetErrorCode (parser)),
                     (int)XML_GetCurrentLineNumber (parser));
+		vot_parseAbort (parser, fd, urlFname);
                 return (0);		/* parse error			*/
             }
         } while (!done);
 
     } else {
-        if (!XML_Parse (parser, ip, len, 1)) {
+        if (!XML_Parse (parser, ip, len, 1) && !vot_stopped) {
             fprintf (stderr, "Error: %s at line %d\n",
                 XML_ErrorString (XML_GetErrorCode (parser)),
                 (int)XML_GetCurrentLineNumber (parser));
+	    vot_parseAbort (parser, fd, urlFname);
             return (0);	/* parse error			*/
         }
     }
     XML_ParserFree (parser);
+    vot_parser = NULL;
+    if (vot_stopped)
+	vot_lazyReset ();
+
+    gettimeofday (&t1, NULL);
+    votNParse++;
+    votParseBytes += (double) (fd ? nread : len);
+    votParseTime  += (t1.tv_sec - t0.tv_sec) + 
+		     (t1.tv_usec - t0.tv_usec) / 1.0e6;
 
     if (fd && fd != stdin) 
         fclose (fd);
@@ -377,6 +417,27 @@ vot_openVOTABLE (char *arg)
 }
 
 
+/** 
+ *  vot_stopParse -- Stop the parse in progress (private method).
+ *
+ *  @brief  Stop the parse in progress (private method)
+ *  @fn     vot_stopParse (void)
+ *
+ *  @return		nothing
+ *
+ *  May be called from a parser callback, the parse ends once the callback
+ *  returns and vot_openVOTABLE() returns the document read so far.
+ */
+void
+vot_stopParse (void)
+{
+    if (vot_parser && !vot_stopped) {
+	vot_stopped = 1;
+	XML_StopParser (vot_parser, XML_FALSE);
+    }
+}
+
+
 /** 
  *  vot_closeVOTABLE -- Destroy the root node and all of it's children.
  *
@@ -387,18 +448,25 @@ vot_openVOTABLE (char *arg)
  *  @return		nothing
  *
  *  @warning Destroys the node and all of it's children.
+ *
+ *  If the VOT_STATS environment variable is set (>0), the document statistics
+ *  (see vot_getStats()) are printed to the stderr before it is destroyed.
  */
 void
 vot_closeVOTABLE (handle_t vot)
 {
     Element *elem = vot_getElement (vot);
     int my_type = vot_elemType (elem);
+    char *env = NULL;
 
     
     if ((my_type != TY_VOTABLE)) {
 	votEmsg ("closeVOTABLE() arg must be a VOTABLE tag\n");
         return;
     }
+
+    if ((env = getenv ("VOT_STATS")) && atoi (env) > 0)
+	vot_printStats (stderr);
     vot_deleteNode (vot);
 }
 
@@ -604,6 +672,9 @@ vot_getTR (handle_t handle)
         votEmsg ("TR must be child of a TABLEDATA tag\n");
         return (0);
     }
+
+    if (elem->pool)			/* lazy table, build the rows	*/
+	vot_lazyMaterialize (elem);
     
     for (child = elem->child; child; child = child->next)
         if (child->type == TY_TR)
@@ -1769,28 +1840,31 @@ vot_attachNode (handle_t parent, handle_t new)
 void
 vot_freeNode (handle_t node)
 {
-    /* Recursive function to delete the Element and it's children. */
-    Element *node_ptr;
-    handle_t child_handle, sibling_handle;
+    /* Delete the Element, it's children and following siblings.  Children
+     * recurse, siblings are walked iteratively since a TABLEDATA may have
+     * many thousands of <TR> children.
+     */
+    Element *node_ptr, *next;
     
 
     if (! (node_ptr = vot_getElement (node)) )
 	return;
     
-    if (node_ptr->child) {
-        child_handle = vot_lookupHandle (node_ptr->child);
-        vot_freeNode (child_handle);
-    } 
+    for ( ; node_ptr; node_ptr = next) {
+	next = node_ptr->next;
+
+        if (node_ptr->child)
+            vot_freeNode (vot_lookupHandle (node_ptr->child));
     
-    if (node_ptr->next) {
-        sibling_handle = vot_lookupHandle (node_ptr->next);
-        vot_freeNode (sibling_handle);
+        /* Clean the handle and free the memory. 
+        */
+        vot_freeHandle (vot_lookupHandle (node_ptr));
+        if (node_ptr->pool) {
+	    free ((void *) node_ptr->pool);
+	    free ((void *) node_ptr->data);
+        }
+        free (node_ptr);
     }
-    
-    /* Clean the handle and free the memory. 
-    */
-    vot_freeHandle (node);
-    free (node_ptr);
 }
 
 
@@ -1860,6 +1934,8 @@ vot_copyElement (handle_t src_h, handle_t parent_h)
     
     if (src_ptr == 0)
         return (0);
+    if (src_ptr->pool)				/* copy needs real rows	     */
+	vot_lazyMaterialize (src_ptr);
 
     return_ptr = vot_elementDup (src_h); 	/* copy the source Element   */
     if (!return_ptr)
@@ -2043,8 +2119,11 @@ vot_sortTable (handle_t tdata_h, int col, int strsort, int order)
     /*  Rewrite the TDATA elements.  We've re-ordered the compiled string
      *  table, now we need to reset the <TD> contents accordingly.  Do not
      *  free existing pointers first since we've simply moved around the 
-     *  values.
+     *  values.  A lazy table has no <TD> elements, the matrix is all.
      */
+    if (tdata->pool)
+	return (OK);
+
     i = 0;
     for (tr = vot_getTR (tdata_h); tr; tr = vot_getNext(tr)) {
         for (td = vot_getTD(tr); td; td = vot_getNext(td)) {
@@ -2778,9 +2857,12 @@ vot_simpleGetURL (char *url, char *ofname)
 
 static int vot_addFITSMeta (int handle, fitsfile *fp, char *meta, int index);
 static int vot_addFieldMeta (int handle, fitsfile *fp, int index);
-static int vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], 
-				int nrows, int ncols);
-static void vot_printerror (int status);
+
+void vot_fitsTForm (char *tform, char *dtype, char *asize, int width,
+				int spaces);
+int  vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], 
+				int nrows, int ncols, long frow);
+void vot_printerror (int status);
 
 
 void
@@ -2877,48 +2959,7 @@ vot_writeFITS (handle_t vot, char *oname)
 	    tunit[i] = ((unit=vot_getAttr(field, "unit")) ? unit : strdup(""));
 
 	    tform[i] = calloc (1, 16);
-
-	    if (strncasecmp (dtype, "char", 4) == 0 ||
-	        strncasecmp (dtype, "bool", 4) == 0 ||
-	        strncasecmp (dtype, "unsignedByte", 12) == 0) {
-
-		    if (asize && asize[0]  && widths[i]) {
-		        sprintf (tform[i], "%dA", 
-			    (asize[0] == '*' ? widths[i] : atoi (asize)));
-		    } else
-		        strcpy (tform[i], "A");
-
-	    } else if (strncasecmp (dtype, "float", 4) == 0) {
-		if (spaces[i])
-		    sprintf (tform[i], "%dE", spaces[i]+1);
-		else
-		    strcpy (tform[i], "E");
-
-	    } else if (strncasecmp (dtype, "double", 4) == 0) {
-		if (spaces[i])
-		    sprintf (tform[i], "%dD", spaces[i]+1);
-		else
-		    strcpy (tform[i], "D");
-
-	    } else if (strncasecmp (dtype, "short", 5) == 0 ||
-	        strncasecmp (dtype, "unicodeChar", 11) == 0) {
-		    if (spaces[i])
-		        sprintf (tform[i], "%dI", spaces[i]+1);
-		    else
-		        strcpy (tform[i], "I");
-
-	    } else if (strncasecmp (dtype, "int", 3) == 0) {
-		if (spaces[i])
-		    sprintf (tform[i], "%dJ", spaces[i]+1);
-		else
-		    strcpy (tform[i], "J");
-
-	    } else if (strncasecmp (dtype, "long", 4) == 0) {
-		if (spaces[i])
-		    sprintf (tform[i], "%dJ", spaces[i]+1);
-		else
-		    strcpy (tform[i], "J");
-	    }
+	    vot_fitsTForm (tform[i], dtype, asize, widths[i], spaces[i]);
 
 	    if (dtype)	free ( (void *) dtype);
 	    if (width)	free ( (void *) width);
@@ -2971,7 +3012,7 @@ vot_writeFITS (handle_t vot, char *oname)
 	/*  Write the data to the file.
 	 */
 	if (nrows > 0)
-	    vot_writeFITSData (fp, cells, tform, nrows, ncols);
+	    vot_writeFITSData (fp, cells, tform, nrows, ncols, 1L);
 
 	/*  Free the allocated pointers.
 	 */
@@ -3079,8 +3120,88 @@ vot_addFieldMeta (int handle, fitsfile *fp, int index)
 }
 
 
-static int
-vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
+/**
+ *  vot_fitsTForm -- Get the FITS TFORM for a FIELD (private method).
+ *
+ *  @brief  Get the FITS TFORM for a FIELD (private method)
+ *  @fn     vot_fitsTForm (char *tform, char *dtype, char *asize, int width,
+ *		int spaces)
+ *
+ *  @param  tform 	Output TFORM string
+ *  @param  dtype 	FIELD datatype attribute
+ *  @param  asize 	FIELD arraysize attribute
+ *  @param  width 	Widest value in a char column
+ *  @param  spaces 	Number of spaces in a value (array columns)
+ *  @return		nothing
+ */
+void
+vot_fitsTForm (char *tform, char *dtype, char *asize, int width, int spaces)
+{
+    if (dtype == NULL)
+	dtype = "char";
+
+    if (strncasecmp (dtype, "char", 4) == 0 ||
+        strncasecmp (dtype, "bool", 4) == 0 ||
+        strncasecmp (dtype, "unsignedByte", 12) == 0) {
+
+	    if (asize && asize[0]  && width) {
+	        sprintf (tform, "%dA", 
+		    (asize[0] == '*' ? width : atoi (asize)));
+	    } else
+	        strcpy (tform, "A");
+
+    } else if (strncasecmp (dtype, "float", 4) == 0) {
+	if (spaces)
+	    sprintf (tform, "%dE", spaces+1);
+	else
+	    strcpy (tform, "E");
+
+    } else if (strncasecmp (dtype, "double", 4) == 0) {
+	if (spaces)
+	    sprintf (tform, "%dD", spaces+1);
+	else
+	    strcpy (tform, "D");
+
+    } else if (strncasecmp (dtype, "short", 5) == 0 ||
+        strncasecmp (dtype, "unicodeChar", 11) == 0) {
+	    if (spaces)
+	        sprintf (tform, "%dI", spaces+1);
+	    else
+	        strcpy (tform, "I");
+
+    } else if (strncasecmp (dtype, "int", 3) == 0) {
+	if (spaces)
+	    sprintf (tform, "%dJ", spaces+1);
+	else
+	    strcpy (tform, "J");
+
+    } else if (strncasecmp (dtype, "long", 4) == 0) {
+	if (spaces)
+	    sprintf (tform, "%dJ", spaces+1);
+	else
+	    strcpy (tform, "J");
+    }
+}
+
+
+/**
+ *  vot_writeFITSData -- Write rows of cells to a FITS table (private method).
+ *
+ *  @brief  Write rows of cells to a FITS table (private method)
+ *  @fn     vot_writeFITSData (fitsfile *fp, char **data, char *fmt[],
+ *		int nrows, int ncols, long frow)
+ *
+ *  @param  fp 		FITS file positioned at the table
+ *  @param  data 	Row-major cell strings
+ *  @param  fmt 	Column TFORM strings
+ *  @param  nrows 	Number of rows
+ *  @param  ncols 	Number of columns
+ *  @param  frow 	First table row to write (one-indexed)
+ *  @return		zero
+ */
+int
+vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols,
+		long frow)
 {
     int     i, j, n, type, width, status = 0;
     char    **ccol, *d, *tform, cell[1024], *tok, *sep = " ", *brkt = NULL;
@@ -3088,7 +3209,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
     double *dcol;
     long   *icol;
     short  *scol;
-    long    frow = 1, felem = 1, nr = nrows;
+    long    felem = 1, nr = nrows;
     
 
     for (j = 0; j < ncols; j++) {
@@ -3099,8 +3220,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 
 	switch (tform[type]) {
 	case 'A':						/* CHAR	    */
-//    	    ccol = (char **) calloc (1, (nrows * (width+1) * sizeof (char *)));
-    	    ccol = (char **) calloc (1, (nrows * (SZ_LINE) * sizeof (char *)));
+    	    ccol = (char **) calloc (1, (nrows * sizeof (char *)));
 
     	    for (i = 0; i < nrows; i++) {
 		d = data[i * ncols + j];
@@ -3138,7 +3258,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 		    for ( ; n < width; n++)		/* missing values  */
 			*dp++ = (double) 0.0;
 
-	            fits_write_col (fp, TDOUBLE, j+1, i+1,felem, width, dpr, 
+	            fits_write_col (fp, TDOUBLE, j+1, frow+i,felem, width, dpr, 
 			&status);
 		}
 	    }
@@ -3168,7 +3288,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 		    for ( ; n < width; n++)		/* missing values  */
 			*rp++ = (float) 0.0;
 
-	            fits_write_col (fp, TFLOAT, j+1, i+1,felem, width, rpr, 
+	            fits_write_col (fp, TFLOAT, j+1, frow+i,felem, width, rpr, 
 			&status);
 		}
 	    }
@@ -3199,7 +3319,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 		    for ( ; n < width; n++)		/* missing values  */
 			*sp++ = (short) 0;
 
-	            fits_write_col (fp, TSHORT, j+1, i+1,felem, width, spr, 
+	            fits_write_col (fp, TSHORT, j+1, frow+i,felem, width, spr, 
 			&status);
 		}
 	    }
@@ -3229,7 +3349,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 		    for ( ; n < width; n++)		/* missing values  */
 			*ip++ = (long) 0;
 
-	            fits_write_col (fp, TLONG, j+1, i+1,felem, width, ipr, 
+	            fits_write_col (fp, TLONG, j+1, frow+i,felem, width, ipr, 
 			&status);
 		}
 	    }
@@ -3247,7 +3367,7 @@ vot_writeFITSData (fitsfile *fp, char **data, char *fmt[], int nrows, int ncols)
 }
 
 
-static void 
+void 
 vot_printerror (int status) 
 {
     if (status) {
@@ -3400,8 +3520,8 @@ vot_htmlTableMeta (FILE *fd, handle_t res, char *ifname)
 static void
 vot_htmlTableData (FILE *fd, handle_t res, char *ifname)
 {
-    handle_t  tab, data, tdata, field, tr, td;
-    register  int i, nrows, ncols;
+    handle_t  tab, data, tdata, field;
+    register  int i, j, nrows, ncols;
     char     *name, *id, *ucd, *s;
 
 
@@ -3447,14 +3567,14 @@ vot_htmlTableData (FILE *fd, handle_t res, char *ifname)
     /*  Now dump the data.
     */
     fprintf (fd, "<tbody>\n");
-    for (tr=vot_getTR (tdata),i=0; tr; tr=vot_getNext(tr),i++) {
+    for (i=0; i < nrows; i++) {
         fprintf (fd, " <tr style=\"background:#%s\">\n",
 	    (((i % 2) == 0) ? ecolor : ocolor));
 
 	/*  Print table cells.  If we have a url, make it a link.
 	 */
-        for (td=vot_getTD(tr),i=0; td; td=vot_getNext(td),i++) {
-            s = ((s = vot_getValue (td)) ? s : "");
+        for (j=0; j < ncols; j++) {
+            s = vot_getTableCell (tdata, i, j);
 	    if (strncasecmp ("http://", s, 7) == 0) 
                 fprintf (fd, "  <td><a href=\"%s\">%s</a></td>\n", s, s);
 	    else 
@@ -3501,8 +3621,8 @@ void
 vot_writeDelimited (handle_t vot, char *fname, char delim, int hdr)
 {
     char  *name, *id, *ucd, *s;
-    int   res, tab, data, tdata, field, tr, td;         /* handles      */
-    int   i=0, ncols=0;
+    int   res, tab, data, tdata, field;         	/* handles      */
+    int   i=0, j=0, ncols=0, nrows=0;
     FILE *fd = (FILE *) NULL;
 
 
@@ -3524,6 +3644,7 @@ vot_writeDelimited (handle_t vot, char *fname, char delim, int hdr)
     if ((tdata = vot_getTABLEDATA (data)) <= 0)
 	return;
     ncols = vot_getNCols (tdata);
+    nrows = vot_getNRows (tdata);
 
     /* Print the Column header names.
     */
@@ -3547,16 +3668,16 @@ vot_writeDelimited (handle_t vot, char *fname, char delim, int hdr)
     }
                 
             
-    /* Now dump the data.
+    /* Now dump the data from the compiled table.
     */
-    for (tr=vot_getTR (tdata); tr; tr=vot_getNext(tr)) {
-        for (td=vot_getTD(tr),i=0; td; td=vot_getNext(td),i++) {
-	    s = ((s =vot_getValue (td)) ? s : "");
+    for (i=0; i < nrows; i++) {
+        for (j=0; j < ncols; j++) {
+	    s = vot_getTableCell (tdata, i, j);
 	    if (strchr (s, (int) delim))
 	        fprintf (fd, "\"%s\"", s);
 	    else
 	        fprintf (fd, "%s", s);
-	    if (i < (ncols-1))
+	    if (j < (ncols-1))
 	        fprintf (fd, "%c", delim);
 	}
 	fprintf (fd, "\n");
@@ -3660,6 +3781,43 @@ vot_setWarnings (int value)
 }
 
 
+/**
+ *  vot_setLazyTD --  Set the lazy TABLEDATA parse mode.
+ *
+ *  @brief  Set the lazy TABLEDATA parse mode.
+ *  @fn     vot_setLazyTD (int value)
+ *
+ *  @param  value 	Enable lazy mode?
+ *  @return		nothing
+ *
+ *  In lazy mode the <TR>/<TD> elements of tables parsed by a following
+ *  vot_openVOTABLE() are not created, cell text is kept in a string pool
+ *  indexed by the data matrix used by vot_getTableCell().  The row and
+ *  cell elements are built on the first vot_getTR() call on the table.
+ *  <TD> attributes are not preserved in this mode.
+ */
+void
+vot_setLazyTD (int value)
+{
+    votLazyTD = value;
+}
+
+
+/**
+ *  vot_getLazyTD --  Get the lazy TABLEDATA parse mode.
+ *
+ *  @brief  Get the lazy TABLEDATA parse mode.
+ *  @fn     value = vot_getLazyTD (void)
+ *
+ *  @return		Current lazy mode, so a caller can restore it
+ */
+int
+vot_getLazyTD (void)
+{
+    return (votLazyTD);
+}
+
+
 /**
  *  votEmsg -- Error message print utility.
  */
@@ -3696,6 +3854,37 @@ vot_cleanUp (void)
  */
 
 
+/**
+ *  vot_parseAbort -- Clean up after a failed vot_openVOTABLE().
+ *
+ *  @brief  Clean up after a failed vot_openVOTABLE().
+ *  @fn     vot_parseAbort (XML_Parser parser, FILE *fd, char *tfname)
+ *
+ *  @param  parser 	Parser to free, or NULL
+ *  @param  fd 		Input to close, or NULL
+ *  @param  tfname 	Downloaded URL file to delete, or empty
+ *  @return		nothing
+ *
+ *  A parse that stops inside a TABLEDATA leaves the lazy table state set,
+ *  which would route the elements of every later document to it.
+ */
+static void
+vot_parseAbort (XML_Parser parser, FILE *fd, char *tfname)
+{
+    if (parser)
+	XML_ParserFree (parser);
+    vot_parser  = NULL;
+    vot_stopped = 0;
+    vot_lazyReset ();
+
+    if (fd && fd != stdin)
+	fclose (fd);
+    if (tfname && tfname[0])
+	unlink (tfname);
+    vot_clearStack (element_stack);
+}
+
+
 /**
  *  vot_elementDup -- Duplicate the input Element.
  *
@@ -3855,64 +4044,110 @@ static void
 vot_dumpXML (Element *node, int level, int indent, FILE *fd)
 {
     register int i, space = indent;
+    char *tag;
 
     
-    /* If the element is NULL, there is nothing to print.
+    /* Print the node and its siblings, recursing only for the children.
     */
-    if (node == NULL)
-        return;
-    
-    /* Make spaces based on how deep we are and print the formatted Element. 
-    */
-    for (i = 0; space && i < (space * level); i++) 
-	fprintf (fd, " ");
-    fprintf (fd, "%s", vot_elemXML (node));
-    
-    /* If there are children, recurse to them, print function returns. 
-    */
-    if (node->child) {
-	if (indent) 
-	    fprintf (fd, "\n");
-        vot_dumpXML (node->child, (level + 1), indent, fd);
-        
-        /* Print the content between the tags.  */
-        if (node->content) {
-	    if (node->isCData)
-                fprintf (fd, "<![CDATA[%s]]>", node->content);
-	    else
-                fprintf (fd, "%s", vot_deWS(node->content));
-        }
-        
-	/*  Make space and print the closing XML tag.
-	 */
+    for ( ; node; node = node->next) {
+
+        /* Make spaces based on how deep we are and print the formatted
+	 * Element. 
+        */
         for (i = 0; space && i < (space * level); i++) 
 	    fprintf (fd, " ");
-        fprintf (fd, "%s", vot_elemXMLEnd (node));
+        fprintf (fd, "%s", (tag = vot_elemXML (node)));
+	free ((void *) tag);
+    
+        /* If there are children, recurse to them, print function returns. 
+        */
+        if (node->child) {
+	    if (indent) 
+	        fprintf (fd, "\n");
+            vot_dumpXML (node->child, (level + 1), indent, fd);
         
-    } else  {   	/* This node has no children, beginning of base case. */
-        if (node->content) {
-	    if (node->isCData)
-                fprintf (fd, "<![CDATA[%s]]>", node->content);
-	    else
-                fprintf (fd, "%s", vot_deWS(node->content));
+            /* Print the content between the tags.  */
+            if (node->content) {
+	        if (node->isCData)
+                    vot_putCData (node->content, fd);
+	        else
+                    vot_putText (vot_deWS(node->content), fd);
+            }
+        
+	    /*  Make space and print the closing XML tag.
+	     */
+            for (i = 0; space && i < (space * level); i++) 
+	        fprintf (fd, " ");
+        
+        } else if (node->pool) {   /* lazy TABLEDATA, rows from the matrix */
+	    if (indent) 
+	        fprintf (fd, "\n");
+	    vot_dumpCells (node, (level + 1), indent, fd);
+
+            for (i = 0; space && i < (space * level); i++) 
+	        fprintf (fd, " ");
+
+        } else  {   	/* This node has no children, base case. */
+            if (node->content) {
+	        if (node->isCData)
+                    vot_putCData (node->content, fd);
+	        else
+                    vot_putText (vot_deWS(node->content), fd);
+            }
         }
         
         /* Print the closing XML tag. 
-	*/
-        fprintf (fd, "%s", vot_elemXMLEnd (node));
+        */
+        fprintf (fd, "%s", (tag = vot_elemXMLEnd (node)));
+	free ((void *) tag);
+
+        if (indent) 
+	    fprintf (fd, "\n");
     }
+}
 
-    if (indent) 
-	fprintf (fd, "\n");
-    
-    /* If there are siblings, recurse through them. 
-    */
-    if (node->next)
-        vot_dumpXML (node->next, level, indent, fd);
-    
-    /* At this point there should be no more children or sibling on this node.
-    */
-    fflush (fd);
+
+/**
+ *  vot_dumpCells -- Print the rows of a lazy TABLEDATA as XML.
+ *
+ *  @brief  Print the rows of a lazy TABLEDATA as XML.
+ *  @fn     vot_dumpCells (Element *tdata, int level, int indent, FILE *fd)
+ *
+ *  @param  tdata 	A pointer to the TABLEDATA Element
+ *  @param  level 	The number of tabs to format the output.
+ *  @param  indent 	Number of spaces to indent at each level.
+ *  @param  fd 		The file descriptor to send the output to.
+ *  @return		nothing
+ */
+static void
+vot_dumpCells (Element *tdata, int level, int indent, FILE *fd)
+{
+    handle_t tdata_h = vot_lookupHandle (tdata);
+    int   i, j, k, nrows, ncols;
+
+
+    nrows = vot_getNRows (tdata_h);
+    ncols = vot_getNCols (tdata_h);
+
+    for (i=0; i < nrows; i++) {
+        for (k = 0; indent && k < (indent * level); k++) 
+	    fprintf (fd, " ");
+	fprintf (fd, "<TR>%s", (indent ? "\n" : ""));
+
+	for (j=0; j < ncols; j++) {
+            for (k = 0; indent && k < (indent * (level + 1)); k++) 
+	        fprintf (fd, " ");
+	    fprintf (fd, "<TD>");
+	    vot_putText (tdata->data[i * ncols + j], fd);
+	    fprintf (fd, "</TD>");
+	    if (indent)
+	        fprintf (fd, "\n");
+	}
+
+        for (k = 0; indent && k < (indent * level); k++) 
+	    fprintf (fd, " ");
+	fprintf (fd, "</TR>%s", (indent ? "\n" : ""));
+    }
 }
 
 
@@ -3929,6 +4164,44 @@ vot_deWS (char *in)
 }
 
 
+/**
+ *  vot_putText -- Print character data, escaping the XML markup characters.
+ *  Content is stored unescaped by the parser so it must be quoted on output.
+ */
+static void
+vot_putText (char *s, FILE *fd)
+{
+    char *ip;
+
+    for (ip=s; ip && *ip; ip++) {
+	switch (*ip) {
+	case '&':   fputs ("&amp;", fd);	break;
+	case '<':   fputs ("&lt;", fd);		break;
+	case '>':   fputs ("&gt;", fd);		break;
+	default:    fputc (*ip, fd);		break;
+	}
+    }
+}
+
+
+/**
+ *  vot_putCData -- Print a CDATA section, splitting any embedded ']]>'
+ *  across two sections so it cannot terminate the first one early.
+ */
+static void
+vot_putCData (char *s, FILE *fd)
+{
+    char *ip, *ep;
+
+    fputs ("<![CDATA[", fd);
+    for (ip=s; (ep = strstr (ip, "]]>")); ip = ep + 2) {
+	fwrite (ip, 1, (size_t) (ep - ip + 2), fd);
+	fputs ("]]><![CDATA[", fd);
+    }
+    fprintf (fd, "%s]]>", ip);
+}
+
+
 #ifdef USE_VALIDITY
 /**
  *  vot_validParents -- Return the mask of valid parents for the type.
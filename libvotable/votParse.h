@@ -63,6 +63,32 @@
 #endif
 
 
+/**
+ *  Memory and timing statistics for the open documents (vot_getStats).
+ */
+typedef struct {
+    long    nelem[NUM_ELEMENTS];	/* element counts by type index	    */
+    char   *ename[NUM_ELEMENTS];	/* element name for each index	    */
+    long    nelements;			/* total Elements		    */
+    long    ncells;			/* TABLEDATA cells		    */
+
+    long    elem_bytes;			/* Element + AttrBlock structs	    */
+    long    attr_bytes;			/* attribute list nodes		    */
+    long    content_bytes;		/* element content strings	    */
+    long    data_bytes;			/* data matrix and cell pools	    */
+    long    handle_bytes;		/* handle table			    */
+
+    int     nhandles;			/* handles currently in use	    */
+    int     handle_peak;		/* peak handles in use		    */
+    int     handle_max;			/* handle table size		    */
+
+    int     nparse;			/* documents parsed		    */
+    double  parse_bytes;		/* bytes of XML parsed		    */
+    double  parse_time;			/* parse wall time (sec)	    */
+    double  parse_rate;			/* parse rate (bytes/s)		    */
+} votStats;
+
+
 /** *************************************************************************
  *  Public LIBVOTABLE interface.
  ** ************************************************************************/
@@ -163,6 +189,9 @@ int 	 vot_setAttr (handle_t elem_h, char *attr, char *value);
 char    *vot_getAttr (handle_t elem_h, char *attr);
 
 void 	 vot_setWarnings (int value);
+void 	 vot_setLazyTD (int value);
+int 	 vot_getLazyTD (void);
+void 	 vot_getStats (votStats *stats);
 void 	 votEmsg (char *msg);
 
 
@@ -179,3 +208,26 @@ void 	 vot_writeCSV (handle_t node, char *fname, int hdr);
 void 	 vot_writeTSV (handle_t node, char *fname, int hdr);
 void 	 vot_writeFITS (handle_t node, char *fname);
 
+
+/****************************************************************************
+ * Streaming
+ ***************************************************************************/
+
+#define	VOT_ROWS_BEGIN		0	/* start of a TABLEDATA		    */
+#define	VOT_ROWS_DATA		1	/* a batch of rows		    */
+#define	VOT_ROWS_END		2	/* end of a TABLEDATA		    */
+
+/*  Callback for vot_streamRows().  For VOT_ROWS_DATA 'cells' holds 'nrows'
+ *  rows of vot_getNCols(tdata) cells in row-major order, a NULL cell is an
+ *  empty <TD>.  The cells are only valid for the duration of the call.
+ */
+typedef void (*votRowFunc) (void *client, handle_t tdata, char **cells,
+				int nrows, int flag);
+
+int 	 vot_streamCat (char **infiles, int nfiles, char *oname);
+int 	 vot_streamSplit (char *iname, char *root, int number);
+int 	 vot_streamConvert (char *iname, char *oname, char *fmt, int hdr);
+handle_t vot_streamRows (char *iname, votRowFunc func, void *client);
+void 	 vot_streamColumns (int *cols, int ncols);
+void 	 vot_streamStop (void);
+
@@ -91,6 +91,8 @@ extern char     *vot_getAttr (handle_t elem_h, char *attr);
 
 extern void      vot_writeVOTable (handle_t node, FILE *fd);
 extern void      vot_setWarnings (int value);
+extern void      vot_setLazyTD (int value);
+extern void      vot_getStats (votStats *stats);
 %}
 
 
@@ -96,6 +96,7 @@ typedef struct elem_t {
     struct elem_t *parent;    /** @brief   Ptr to the parent element          	*/
 
     char  **data;             /** @brief   Ptr to the data matrix             	*/
+    char  *pool;              /** @brief   Cell string pool (lazy TABLEDATA)  	*/
 
     unsigned char ref_count;  /** @brief   No. refrences to this Element      	*/
 } Element;
@@ -122,6 +123,19 @@ typedef struct {
 
 
 
+/**
+ *  @typedef 	votRowSink
+ *  @brief 	Callback receiving the rows of a streamed TABLEDATA.  The
+ *		'pool' and 'cells' of a VOT_ROWS_DATA batch are owned by
+ *		the callback, a NULL cell is an empty <TD>.
+ */
+typedef void (*votRowSink) (void *client, Element *tdata, char *pool,
+				char **cells, int nrows, int flag);
+
+#define	SZ_ROWBATCH		1024	/** rows per streamed batch	      */
+
+
+
 /** ***************************************************************************
  *
  *  Public Internal Methods.  The procedures are used to implement the
@@ -142,6 +156,7 @@ char    *vot_elemName (Element *e);
 int 	 vot_elemType (Element *e);
 char    *vot_elemXML (Element *e);
 char    *vot_elemXMLEnd (Element *e);
+int 	 vot_elemIndex (Element *e);
 Element *vot_newElem (unsigned int type);
 
 /*  votHandle.c
@@ -152,6 +167,8 @@ void 	  vot_freeHandle (handle_t handle);
 Element  *vot_getElement (handle_t handle);
 void 	  vot_newHandleTable (void);
 int       vot_handleCount (void);
+int       vot_handlePeak (void);
+int       vot_handleMax (void);
 void 	  vot_handleCleanup (void);
 void      vot_handleError (char *msg);
 
@@ -162,6 +179,18 @@ void  	vot_startElement (void *userData, const char *name, const char **atts);
 void  	vot_charData (void *userData, const XML_Char *s, int len);
 void  	vot_startCData (void *userData);
 void  	vot_endCData (void *userData);
+void 	vot_lazyMaterialize (Element *tdata);
+void 	vot_setRowSink (votRowSink sink, void *client);
+void 	vot_setRowColumns (int *cols, int ncols);
+void 	vot_lazyReset (void);
+
+/*  votParse.c
+ */
+void 	vot_stopParse (void);
+
+/*  votStats.c
+ */
+void 	vot_printStats (FILE *fd);
 
 /*  votStack.c
  */
@@ -117,6 +117,7 @@
 #define VF_WRITECSV             vf_writecsv
 #define VF_WRITETSV             vf_writetsv
 #define VF_SETWARN		vf_setwarn
+#define VF_SETLAZY		vf_setlazy
 
 #else
 
@@ -209,6 +210,7 @@
 #define VF_WRITECSV             vf_writecsv_
 #define VF_WRITETSV             vf_writetsv_
 #define VF_SETWARN		vf_setwarn_
+#define VF_SETLAZY		vf_setlazy_
 
 #endif
 
@@ -314,6 +316,7 @@ void 	  VF_WRITEBSV (handle_t *elem, char *fname, int flen);
 void 	  VF_WRITECSV (handle_t *elem, char *fname, int flen);
 void 	  VF_WRITETSV (handle_t *elem, char *fname, int flen);
 void 	  VF_SETWARN (int *value);
+void 	  VF_SETLAZY (int *value);
 
 
 
@@ -1336,6 +1339,19 @@ VF_SETWARN (int *value)
 }
 
 
+/** VF_SETLAZY
+ * 
+ *  @brief		Set the lazy TABLEDATA parse mode
+ *  @param[in]  value 	Enable lazy mode
+ *  @return		Nothing
+ */
+void
+VF_SETLAZY (int *value)
+{
+    vot_setLazyTD (*value);
+}
+
+
 
 /****************************************************************************
  *
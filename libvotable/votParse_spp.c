@@ -125,6 +125,7 @@
 #define VX_WRITECSV   		vwrcsv
 #define VX_WRITETSV   		vwrtsv
 #define VX_SETWARN   		vswarn
+#define VX_SETLAZY   		vslazy
 
 #else
 
@@ -217,6 +218,7 @@
 #define VX_WRITECSV   		vwrcsv_
 #define VX_WRITETSV   		vwrtsv_
 #define VX_SETWARN   		vswarn_
+#define VX_SETLAZY   		vslazy_
 
 #endif
 
@@ -317,6 +319,7 @@ void 	  VX_WRITEBSV (handle_t *elem, XCHAR *fname);
 void 	  VX_WRITECSV (handle_t *elem, XCHAR *fname);
 void 	  VX_WRITETSV (handle_t *elem, XCHAR *fname);
 void 	  VX_SETWARN (int *value);
+void 	  VX_SETLAZY (int *value);
 
 
 
@@ -1440,6 +1443,19 @@ VX_SETWARN (int *value)
 }
 
 
+/** VX_SETLAZY
+ *
+ *  @brief 		Set the lazy TABLEDATA parse mode.
+ *  @param[in]  value 	Enable lazy mode
+ *  @return		Nothing
+ */
+void
+VX_SETLAZY (int *value)
+{
+    vot_setLazyTD (*value);
+}
+
+
 /****************************************************************************
  *
  ***************************************************************************/
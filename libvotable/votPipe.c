@@ -0,0 +1,1001 @@
+/**
+ *  VOTPIPE.C -- Streaming table format conversion.
+ *
+ *  @file       votPipe.c
+ *  @author     Mike Fitzpatrick
+ *  @date       10/18/26
+ *
+ *  @brief      Streaming table format conversion.
+ *
+ *  The input is parsed on a reader thread with a row sink installed, so
+ *  <TR>/<TD> elements are never added to the document tree.  Instead each
+ *  TABLEDATA is delivered as batches of rows which are passed through a
+ *  bounded ring buffer to the writer running on the calling thread.  The
+ *  reader also takes a copy of the table metadata (FIELDs and the
+ *  RESOURCE INFO/PARAMs) when a table starts so the writer never touches
+ *  the document tree while the parse is still building it.
+ *
+ *  Only the batches in the ring are in memory at any time.  FITS output
+ *  creates each table with the column widths seen in the first batch,
+ *  later batches widen a column when needed and CFITSIO updates NAXIS2
+ *  as rows are appended.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <expat.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "votParseP.h"
+#include "votParse.h"
+#ifdef HAVE_CFITSIO
+#include "fitsio.h"
+#endif
+
+
+#define	VP_NSLOTS		8		/* batches in the ring	      */
+
+#define	VP_TABLE		0		/* start of a table	      */
+#define	VP_ROWS			1		/* a batch of rows	      */
+#define	VP_END			2		/* end of a table	      */
+#define	VP_EOF			3		/* end of the input	      */
+
+#define	VP_ASV			0		/* output formats	      */
+#define	VP_BSV			1
+#define	VP_CSV			2
+#define	VP_TSV			3
+#define	VP_HTML			4
+#define	VP_SHTML		5
+#define	VP_FITS			6
+
+
+typedef struct {				/* INFO or PARAM	      */
+    char   *name, *value, *id, *unit, *desc;
+} vpMeta;
+
+typedef struct {				/* FIELD		      */
+    char   *name, *id, *ucd, *utype, *unit, *dtype, *asize;
+} vpCol;
+
+typedef struct vpTable {			/* table metadata	      */
+    int     index;				/* table number (1-indexed)   */
+    int     ncols;				/* number of columns	      */
+    char   *tname;				/* TABLE name		      */
+    char   *res_id, *res_name, *res_type;	/* RESOURCE attributes	      */
+    char   *res_desc;				/* RESOURCE DESCRIPTION	      */
+    vpMeta *info;				/* RESOURCE INFOs	      */
+    int     ninfo;
+    vpMeta *param;				/* RESOURCE PARAMs	      */
+    int     nparam;
+    vpCol  *cols;				/* FIELDs		      */
+    struct vpTable *fin;			/* INFO/PARAMs at the end     */
+} vpTable;
+
+typedef struct {				/* ring buffer entry	      */
+    int      type;				/* VP_TABLE, VP_ROWS, ...     */
+    vpTable *tab;				/* table metadata	      */
+    char    *pool;				/* cell string pool	      */
+    char   **cells;				/* row-major cells	      */
+    int      nrows;				/* number of rows	      */
+} vpBatch;
+
+typedef struct {
+    char    *iname;				/* input name		      */
+    char    *oname;				/* output name		      */
+    int      format;				/* output format	      */
+    int      hdr;				/* write a header?	      */
+    int      status;				/* OK or ERR		      */
+
+    vpBatch  ring[VP_NSLOTS];			/* reader -> writer ring      */
+    int      head, tail, count;
+    pthread_mutex_t lock;
+    pthread_cond_t  not_full, not_empty;
+
+    vpTable *cur;				/* reader: current table      */
+    vpTable *pend;				/* reader: table to finish    */
+    Element *pend_res;				/* reader: its RESOURCE	      */
+    int      ntables;				/* reader: tables seen	      */
+
+    FILE    *fd;				/* writer: text output	      */
+    int      nwritten;				/* writer: tables written     */
+    int      skip;				/* writer: skip this table?   */
+    long     nrows;				/* writer: rows in this table */
+#ifdef HAVE_CFITSIO
+    fitsfile *fp;				/* writer: FITS output	      */
+    char    **tform;				/* writer: column TFORMs      */
+    int      created;				/* writer: table created?     */
+#endif
+} vpState;
+
+
+static void *vot_pipeReader (void *arg);
+static void  vot_pipeSink (void *client, Element *tdata, char *pool,
+				char **cells, int nrows, int flag);
+static void  vot_pipePut (vpState *ps, int type, vpTable *tab, char *pool,
+				char **cells, int nrows);
+static void  vot_pipeGet (vpState *ps, vpBatch *b);
+static void  vot_pipeFinish (vpState *ps);
+
+static vpTable *vot_pipeTable (vpState *ps, Element *tdata);
+static void  vot_pipeMeta (handle_t h, vpMeta **meta, int *nmeta);
+static void  vot_pipeFreeTable (vpTable *tab);
+static char *vot_pipeDesc (handle_t h);
+
+static int   vot_pipeOpen (vpState *ps);
+static void  vot_pipeBegin (vpState *ps, vpTable *tab);
+static void  vot_pipeRows (vpState *ps, vpTable *tab, char **cells, int nr);
+static void  vot_pipeEnd (vpState *ps, vpTable *tab);
+static void  vot_pipeClose (vpState *ps);
+
+static char *vot_pipeColName (vpCol *col, int i);
+static void  vot_pipeHTMLMeta (FILE *fd, vpTable *tab, char *ifname);
+static void  vot_pipeHTMLHead (FILE *fd, vpTable *tab, char *ifname);
+
+#ifdef HAVE_CFITSIO
+extern void  vot_fitsTForm (char *tform, char *dtype, char *asize, int width,
+				int spaces);
+extern int   vot_writeFITSData (fitsfile *fp, char **data, char *fmt[],
+				int nrows, int ncols, long frow);
+extern void  vot_printerror (int status);
+
+static void  vot_pipeFITSCreate (vpState *ps, vpTable *tab, char **cells,
+				int nrows);
+static void  vot_pipeFITSWiden (vpState *ps, vpTable *tab, char **cells,
+				int nrows);
+static void  vot_pipeFITSMeta (fitsfile *fp, char *meta, int index,
+				vpMeta *m);
+static void  vot_pipeFITSKey (fitsfile *fp, char *keyw, int index, char *val,
+				char *comment);
+#endif
+
+
+
+/**
+ *  vot_streamConvert -- Convert a VOTable to another format as a stream.
+ *
+ *  @brief  Convert a VOTable to another format as a stream
+ *  @fn     status = vot_streamConvert (char *iname, char *oname, char *fmt,
+ *		int hdr)
+ *
+ *  @param  iname 	Input file name ("-" or "stdin" allowed)
+ *  @param  oname 	Output file name ("-" or "stdout" allowed)
+ *  @param  fmt 	Output format (asv, bsv, csv, tsv, html, shtml, fits)
+ *  @return		OK or ERR
+ *
+ *  The table is never held in memory.  Output matches the corresponding
+ *  vot_writeXXX() method, except that a multi-RESOURCE input converted
+ *  to a delimited format writes the first table rather than nothing.
+ *  The parse runs on a separate thread, no other libVOTable calls should
+ *  be made until the conversion completes.
+ */
+int
+vot_streamConvert (char *iname, char *oname, char *fmt, int hdr)
+{
+    vpState    ps;
+    vpBatch    b;
+    pthread_t  tid;
+    int        i;
+
+
+    memset (&ps, 0, sizeof (vpState));
+    ps.iname = iname;
+    ps.oname = oname;
+    ps.hdr   = hdr;
+
+    if (strcasecmp (fmt, "asv") == 0 || strcasecmp (fmt, "ascii") == 0)
+	ps.format = VP_ASV;
+    else if (strcasecmp (fmt, "bsv") == 0)	ps.format = VP_BSV;
+    else if (strcasecmp (fmt, "csv") == 0)	ps.format = VP_CSV;
+    else if (strcasecmp (fmt, "tsv") == 0)	ps.format = VP_TSV;
+    else if (strcasecmp (fmt, "html") == 0)	ps.format = VP_HTML;
+    else if (strcasecmp (fmt, "shtml") == 0)	ps.format = VP_SHTML;
+#ifdef HAVE_CFITSIO
+    else if (strcasecmp (fmt, "fits") == 0)	ps.format = VP_FITS;
+#endif
+    else {
+	fprintf (stderr, "Error: cannot stream to format '%s'\n", fmt);
+	return (ERR);
+    }
+
+    if (vot_pipeOpen (&ps) != OK)
+	return (ERR);
+
+    pthread_mutex_init (&ps.lock, NULL);
+    pthread_cond_init (&ps.not_full, NULL);
+    pthread_cond_init (&ps.not_empty, NULL);
+
+    if (pthread_create (&tid, NULL, vot_pipeReader, (void *) &ps) != 0) {
+	fprintf (stderr, "Error: cannot create reader thread\n");
+	vot_pipeClose (&ps);
+	return (ERR);
+    }
+
+
+    /*  Write batches as they arrive until the reader is done.
+     */
+    for (vot_pipeGet (&ps, &b); b.type != VP_EOF; vot_pipeGet (&ps, &b)) {
+	switch (b.type) {
+	case VP_TABLE:
+	    vot_pipeBegin (&ps, b.tab);
+	    break;
+	case VP_ROWS:
+	    for (i=0; i < b.nrows * b.tab->ncols; i++)
+		if (b.cells[i] == NULL)
+		    b.cells[i] = "";
+	    if (!ps.skip)
+		vot_pipeRows (&ps, b.tab, b.cells, b.nrows);
+	    free ((void *) b.pool);
+	    free ((void *) b.cells);
+	    break;
+	case VP_END:
+	    vot_pipeEnd (&ps, b.tab);
+	    vot_pipeFreeTable (b.tab);
+	    break;
+	}
+    }
+
+    pthread_join (tid, NULL);
+    vot_pipeClose (&ps);
+
+    pthread_mutex_destroy (&ps.lock);
+    pthread_cond_destroy (&ps.not_full);
+    pthread_cond_destroy (&ps.not_empty);
+
+    return (ps.status);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  vot_pipeReader -- Reader thread, parse the input with the row sink set.
+ */
+static void *
+vot_pipeReader (void *arg)
+{
+    vpState *ps = (vpState *) arg;
+    handle_t vot;
+
+
+    vot_setRowSink (vot_pipeSink, (void *) ps);
+    if ((vot = vot_openVOTABLE (ps->iname)) <= 0) {
+	fprintf (stderr, "Error opening VOTable '%s'\n", ps->iname);
+	ps->status = ERR;
+    }
+    vot_setRowSink (NULL, NULL);
+    if (vot <= 0)
+	vot_lazyReset ();		/* no table left open for later parses */
+
+    if (ps->cur) {			/* truncated input	*/
+	ps->pend = ps->cur;
+	ps->cur  = NULL;
+    }
+    vot_pipeFinish (ps);
+    vot_pipePut (ps, VP_EOF, NULL, NULL, NULL, 0);
+
+    if (vot > 0)
+	vot_closeVOTABLE (vot);
+
+    return (NULL);
+}
+
+
+/**
+ *  vot_pipeSink -- Row sink, queue the parser events for the writer.
+ */
+static void
+vot_pipeSink (void *client, Element *tdata, char *pool, char **cells,
+		int nrows, int flag)
+{
+    vpState *ps = (vpState *) client;
+
+
+    switch (flag) {
+    case VOT_ROWS_BEGIN:
+	vot_pipeFinish (ps);
+	ps->cur = vot_pipeTable (ps, tdata);
+	vot_pipePut (ps, VP_TABLE, ps->cur, NULL, NULL, 0);
+	break;
+    case VOT_ROWS_DATA:
+	vot_pipePut (ps, VP_ROWS, ps->cur, pool, cells, nrows);
+	break;
+    case VOT_ROWS_END:
+	ps->pend     = ps->cur;
+	ps->pend_res = tdata->parent->parent->parent;
+	ps->cur      = NULL;
+	break;
+    }
+}
+
+
+/**
+ *  vot_pipeFinish -- Send the end of the last table.  This is held back
+ *  until the next table starts or the parse ends so that INFO and PARAM
+ *  elements following the TABLE in the RESOURCE are seen.
+ */
+static void
+vot_pipeFinish (vpState *ps)
+{
+    vpTable *fin;
+    handle_t res_h;
+
+
+    if (ps->pend == NULL)
+	return;
+
+    fin = (vpTable *) calloc (1, sizeof (vpTable));
+    if (ps->pend_res && ps->pend_res->type == TY_RESOURCE) {
+	res_h = vot_lookupHandle (ps->pend_res);
+	vot_pipeMeta (vot_getINFO (res_h), &fin->info, &fin->ninfo);
+	vot_pipeMeta (vot_getPARAM (res_h), &fin->param, &fin->nparam);
+    }
+    ps->pend->fin = fin;
+
+    vot_pipePut (ps, VP_END, ps->pend, NULL, NULL, 0);
+    ps->pend     = NULL;
+    ps->pend_res = NULL;
+}
+
+
+/**
+ *  vot_pipePut -- Add a batch to the ring, waiting while it is full.
+ */
+static void
+vot_pipePut (vpState *ps, int type, vpTable *tab, char *pool, char **cells,
+		int nrows)
+{
+    vpBatch *b;
+
+
+    pthread_mutex_lock (&ps->lock);
+    while (ps->count == VP_NSLOTS)
+	pthread_cond_wait (&ps->not_full, &ps->lock);
+
+    b = &ps->ring[ps->tail];
+    b->type  = type;
+    b->tab   = tab;
+    b->pool  = pool;
+    b->cells = cells;
+    b->nrows = nrows;
+
+    ps->tail = (ps->tail + 1) % VP_NSLOTS;
+    ps->count++;
+
+    pthread_cond_signal (&ps->not_empty);
+    pthread_mutex_unlock (&ps->lock);
+}
+
+
+/**
+ *  vot_pipeGet -- Take the next batch from the ring, waiting while empty.
+ */
+static void
+vot_pipeGet (vpState *ps, vpBatch *b)
+{
+    pthread_mutex_lock (&ps->lock);
+    while (ps->count == 0)
+	pthread_cond_wait (&ps->not_empty, &ps->lock);
+
+    *b = ps->ring[ps->head];
+    ps->head = (ps->head + 1) % VP_NSLOTS;
+    ps->count--;
+
+    pthread_cond_signal (&ps->not_full);
+    pthread_mutex_unlock (&ps->lock);
+}
+
+
+/**
+ *  vot_pipeTable -- Copy the metadata for the table owning a TABLEDATA.
+ */
+static vpTable *
+vot_pipeTable (vpState *ps, Element *tdata)
+{
+    vpTable *tab = (vpTable *) calloc (1, sizeof (vpTable));
+    Element *t = tdata->parent->parent, *r = t->parent;
+    handle_t tab_h = vot_lookupHandle (t), res_h, field;
+    vpCol   *c;
+    int      i;
+
+
+    tab->index = ++ps->ntables;
+    tab->ncols = vot_getNCols (vot_lookupHandle (tdata));
+    tab->tname = vot_getAttr (tab_h, "name");
+    tab->cols  = (vpCol *) calloc (tab->ncols, sizeof (vpCol));
+
+    for (i=0, field=vot_getFIELD (tab_h); field && i < tab->ncols;
+	field=vot_getNext (field), i++) {
+	    c = &tab->cols[i];
+	    c->name  = vot_getAttr (field, "name");
+	    c->id    = vot_getAttr (field, "id");
+	    c->ucd   = vot_getAttr (field, "ucd");
+	    c->utype = vot_getAttr (field, "utype");
+	    c->unit  = vot_getAttr (field, "unit");
+	    c->dtype = vot_getAttr (field, "datatype");
+	    c->asize = vot_getAttr (field, "arraysize");
+    }
+
+    if (r && r->type == TY_RESOURCE) {
+	res_h = vot_lookupHandle (r);
+	tab->res_id   = vot_getAttr (res_h, "ID");
+	tab->res_name = vot_getAttr (res_h, "name");
+	tab->res_type = vot_getAttr (res_h, "type");
+	tab->res_desc = vot_pipeDesc (res_h);
+
+	vot_pipeMeta (vot_getINFO (res_h), &tab->info, &tab->ninfo);
+	vot_pipeMeta (vot_getPARAM (res_h), &tab->param, &tab->nparam);
+    }
+
+    return (tab);
+}
+
+
+/**
+ *  vot_pipeMeta -- Copy a list of INFO or PARAM elements.
+ */
+static void
+vot_pipeMeta (handle_t h, vpMeta **meta, int *nmeta)
+{
+    vpMeta  *m;
+    int      n;
+
+
+    if ((n = (h ? vot_getLength (h) : 0)) <= 0)
+	return;
+
+    *meta  = (vpMeta *) calloc (n, sizeof (vpMeta));
+    *nmeta = n;
+    for (m = *meta; h && n--; h = vot_getNext (h), m++) {
+	m->name  = vot_getAttr (h, "name");
+	m->value = vot_getAttr (h, "value");
+	m->id    = vot_getAttr (h, "id");
+	m->unit  = vot_getAttr (h, "unit");
+	m->desc  = vot_pipeDesc (h);
+    }
+}
+
+
+/**
+ *  vot_pipeDesc -- Copy the DESCRIPTION of an element.
+ */
+static char *
+vot_pipeDesc (handle_t h)
+{
+    handle_t desc = vot_getDESCRIPTION (h);
+    char    *s = (desc ? vot_getValue (desc) : NULL);
+
+    return ((s ? strdup (s) : NULL));
+}
+
+
+/**
+ *  vot_pipeFreeTable -- Free a table metadata copy.
+ */
+static void
+vot_pipeFreeTable (vpTable *tab)
+{
+    vpMeta  *m;
+    vpCol   *c;
+    int      i;
+
+
+    for (i=0; i < tab->ncols; i++) {
+	c = &tab->cols[i];
+	free (c->name);  free (c->id);    free (c->ucd);  free (c->utype);
+	free (c->unit);  free (c->dtype); free (c->asize);
+    }
+    for (i=0, m=tab->info; i < tab->ninfo; i++, m++) {
+	free (m->name);  free (m->value); free (m->id);
+	free (m->unit);  free (m->desc);
+    }
+    for (i=0, m=tab->param; i < tab->nparam; i++, m++) {
+	free (m->name);  free (m->value); free (m->id);
+	free (m->unit);  free (m->desc);
+    }
+    free (tab->cols);     free (tab->info);     free (tab->param);
+    free (tab->tname);    free (tab->res_id);   free (tab->res_name);
+    free (tab->res_type); free (tab->res_desc);
+    if (tab->fin)
+	vot_pipeFreeTable (tab->fin);
+    free (tab);
+}
+
+
+
+/*****************************************
+ *  Format writers.
+ *****************************************/
+
+static char  vp_delim[] = { ' ', '|', ',', '\t' };
+
+
+/**
+ *  vot_pipeOpen -- Open the output.
+ */
+static int
+vot_pipeOpen (vpState *ps)
+{
+#ifdef HAVE_CFITSIO
+    long  naxes[2] = { 0, 0 };
+    int   status = 0;
+
+    if (ps->format == VP_FITS) {
+	if (access (ps->oname, F_OK) == 0)	/* remove an existing file  */
+	    unlink (ps->oname);
+	if (fits_create_file (&ps->fp, ps->oname, &status))
+	    vot_printerror (status);
+	if (fits_create_img (ps->fp, 8, 0, naxes, &status))
+	    vot_printerror (status);
+	return (OK);
+    }
+#endif
+
+    if (strcasecmp (ps->oname, "stdout") == 0 || strcmp (ps->oname, "-") == 0)
+	ps->fd = stdout;
+    else if ((ps->fd = fopen (ps->oname, "w+")) == (FILE *) NULL) {
+	fprintf (stderr, "Cannot open output file '%s'\n", ps->oname);
+	return (ERR);
+    }
+
+    if (ps->format == VP_HTML) {
+	fprintf (ps->fd, "<!DOCTYPE HTML PUBLIC "
+	    "\"-//W3C//DTD HTML 4.01 Transitional//EN\">\n");
+	fprintf (ps->fd, "<html><head><title>File: %s</title></head><body>\n",
+	    ps->iname);
+    }
+    return (OK);
+}
+
+
+/**
+ *  vot_pipeBegin -- Start a new table.
+ */
+static void
+vot_pipeBegin (vpState *ps, vpTable *tab)
+{
+    int   i;
+    char  delim;
+
+
+    ps->nrows = 0;
+    ps->skip  = 0;
+
+    switch (ps->format) {
+    case VP_ASV:
+    case VP_BSV:
+    case VP_CSV:
+    case VP_TSV:
+	if (ps->nwritten) {
+	    if (ps->nwritten++ == 1)
+		fprintf (stderr, "Error: multiple RESOURCES not supported\n");
+	    ps->skip = 1;
+	    return;
+	}
+	if (ps->hdr) {
+	    delim = vp_delim[ps->format];
+	    fprintf (ps->fd, "# ");
+	    for (i=0; i < tab->ncols; i++) {
+		fputs (vot_pipeColName (&tab->cols[i], i), ps->fd);
+		if (i < (tab->ncols-1))
+		    fputc (delim, ps->fd);
+	    }
+	    fprintf (ps->fd, "\n");
+	}
+	break;
+
+    case VP_HTML:
+	if (ps->nwritten)
+	    fprintf (ps->fd, "<hr noshade='3'>\n");
+	vot_pipeHTMLMeta (ps->fd, tab, ps->iname);
+	vot_pipeHTMLHead (ps->fd, tab, NULL);
+	break;
+
+    case VP_SHTML:
+	if (ps->nwritten) {
+	    ps->skip = 1;
+	    return;
+	}
+	vot_pipeHTMLHead (ps->fd, tab, ps->iname);
+	break;
+
+#ifdef HAVE_CFITSIO
+    case VP_FITS:
+	ps->created = 0;
+	break;
+#endif
+    }
+
+    ps->nwritten++;
+}
+
+
+/**
+ *  vot_pipeRows -- Write a batch of rows.
+ */
+static void
+vot_pipeRows (vpState *ps, vpTable *tab, char **cells, int nr)
+{
+    register int  i, j, ncols = tab->ncols;
+    FILE   *fd = ps->fd;
+    char   *s, delim;
+
+
+    switch (ps->format) {
+    case VP_ASV:
+    case VP_BSV:
+    case VP_CSV:
+    case VP_TSV:
+	delim = vp_delim[ps->format];
+	for (i=0; i < nr; i++) {
+	    for (j=0; j < ncols; j++) {
+		s = *cells++;
+		if (strchr (s, (int) delim)) {
+		    fputc ('"', fd); fputs (s, fd); fputc ('"', fd);
+		} else
+		    fputs (s, fd);
+		if (j < (ncols-1))
+		    fputc (delim, fd);
+	    }
+	    fputc ('\n', fd);
+	}
+	break;
+
+    case VP_HTML:
+    case VP_SHTML:
+	for (i=0; i < nr; i++) {
+	    fprintf (fd, " <tr style=\"background:#%s\">\n",
+		((((ps->nrows + i) % 2) == 0) ? "ccc" : "eee"));
+	    for (j=0; j < ncols; j++) {
+		s = *cells++;
+		if (strncasecmp ("http://", s, 7) == 0)
+		    fprintf (fd, "  <td><a href=\"%s\">%s</a></td>\n", s, s);
+		else
+		    fprintf (fd, "  <td>%s</td>\n", s);
+	    }
+	    fprintf (fd, " </tr>\n");
+	}
+	break;
+
+#ifdef HAVE_CFITSIO
+    case VP_FITS:
+	if (!ps->created)
+	    vot_pipeFITSCreate (ps, tab, cells, nr);
+	else
+	    vot_pipeFITSWiden (ps, tab, cells, nr);
+	vot_writeFITSData (ps->fp, cells, ps->tform, nr, ncols, ps->nrows + 1);
+	break;
+#endif
+    }
+
+    ps->nrows += nr;
+}
+
+
+/**
+ *  vot_pipeEnd -- Finish a table.
+ */
+static void
+vot_pipeEnd (vpState *ps, vpTable *tab)
+{
+#ifdef HAVE_CFITSIO
+    int  i;
+#endif
+
+
+    if (ps->skip)
+	return;
+
+    switch (ps->format) {
+    case VP_HTML:
+    case VP_SHTML:
+	fprintf (ps->fd, "</tbody>\n</table>\n");
+	break;
+
+#ifdef HAVE_CFITSIO
+    case VP_FITS:
+	if (!ps->created)			/* no rows in the table	    */
+	    vot_pipeFITSCreate (ps, tab, NULL, 0);
+
+	/*  The INFO and PARAM keywords are added at the end since they
+	 *  may follow the TABLE in the RESOURCE.
+	 */
+	for (i=0; tab->fin && i < tab->fin->ninfo; i++)
+	    vot_pipeFITSMeta (ps->fp, "INFO", i+1, &tab->fin->info[i]);
+	for (i=0; tab->fin && i < tab->fin->nparam; i++)
+	    vot_pipeFITSMeta (ps->fp, "PARAM", i+1, &tab->fin->param[i]);
+
+	for (i=0; i < tab->ncols; i++)
+	    free ((void *) ps->tform[i]);
+	free ((void *) ps->tform);
+	ps->tform = NULL;
+	break;
+#endif
+    }
+}
+
+
+/**
+ *  vot_pipeClose -- Close the output.
+ */
+static void
+vot_pipeClose (vpState *ps)
+{
+#ifdef HAVE_CFITSIO
+    int  status = 0;
+
+    if (ps->fp) {
+	if (fits_close_file (ps->fp, &status))
+	    vot_printerror (status);
+	return;
+    }
+#endif
+
+    if (ps->format == VP_HTML)
+	fprintf (ps->fd, "</body>\n</html>\n");
+
+    fflush (ps->fd);
+    if (ps->fd != stdout)
+	fclose (ps->fd);
+}
+
+
+/**
+ *  vot_pipeColName -- Find a reasonable name for a column.
+ */
+static char *
+vot_pipeColName (vpCol *col, int i)
+{
+    static char  name[SZ_ATTRNAME];
+
+    if (col->name || col->id || col->ucd)
+	return ((col->name ? col->name : (col->id ? col->id : col->ucd)));
+
+    sprintf (name, "col%d", i);
+    return (name);
+}
+
+
+/**
+ *  vot_pipeHTMLMeta -- Print the RESOURCE metadata of a table as HTML.
+ */
+static void
+vot_pipeHTMLMeta (FILE *fd, vpTable *tab, char *ifname)
+{
+    vpMeta  *m;
+    int      i;
+
+
+    fprintf (fd, "<table border='0' width='90%%'><tbody><tr>");
+
+    fprintf (fd, "<td><b>FILE NAME</b>:</td><td colspan='3'>%s</td></tr>",
+	ifname);
+    fprintf (fd, "<tr><td><b>RESOURCE</b>:</td><td colspan='3'>");
+    if (tab->res_id)    fprintf (fd, " ID='%s'", tab->res_id);
+    if (tab->res_name)  fprintf (fd, " name='%s'", tab->res_name);
+    if (tab->res_type)  fprintf (fd, " type='%s'", tab->res_type);
+    fprintf (fd, "</td></tr>\n");
+
+    fprintf (fd, "<tr><td valign='top'><b>DESCRIPTION:</b></td>");
+    fprintf (fd, "<td colspan='3'>%s</td></tr>",
+	(tab->res_desc ? tab->res_desc : ""));
+
+    fprintf (fd, "<tr><td>&nbsp;</td><td colspan='3'/></tr>\n");
+
+    for (i=0, m=tab->info; i < tab->ninfo; i++, m++) {
+        fprintf (fd, "<tr><td><b>INFO</b></td><td>%s</td><td>%s</td>",
+	   (m->name ? m->name : ""), (m->value ? m->value : ""));
+	if (m->desc)
+           fprintf (fd, "<td>%s</td>", m->desc);
+	else
+           fprintf (fd, "<td/>");
+        fprintf (fd, "</tr>");
+    }
+    for (i=0, m=tab->param; i < tab->nparam; i++, m++) {
+        fprintf (fd, "<tr><td><b>PARAM</b></td><td>%s</td><td>%s</td>",
+	   (m->name ? m->name : ""), (m->value ? m->value : ""));
+	if (m->desc)
+           fprintf (fd, "<td>%s</td>", m->desc);
+	else
+           fprintf (fd, "<td/>");
+        fprintf (fd, "</tr>");
+    }
+    fprintf (fd, "<tr><td>&nbsp;</td><td colspan='3'/></tr>\n");
+
+    fprintf (fd, "</tr></tbody></table>\n");
+}
+
+
+/**
+ *  vot_pipeHTMLHead -- Print the start of an HTML table.
+ */
+static void
+vot_pipeHTMLHead (FILE *fd, vpTable *tab, char *ifname)
+{
+    int  i;
+
+
+    fprintf (fd, "<table border='%d'>\n", 1);
+    if (ifname)
+	fprintf (fd, "<tcaption>File: %s</tcaption>\n", ifname);
+
+    fprintf (fd, "<thead><tr style=\"background:#%s\">\n", "eec");
+    for (i=0; i < tab->ncols; i++)
+	fprintf (fd, "<th>%s</th>", vot_pipeColName (&tab->cols[i], i));
+    fprintf (fd, "</tr></thead>\n");
+
+    fprintf (fd, "<tbody>\n");
+}
+
+
+#ifdef HAVE_CFITSIO
+
+/**
+ *  vot_pipeFITSCreate -- Create the FITS table using the first batch to
+ *  size the character columns.
+ */
+static void
+vot_pipeFITSCreate (vpState *ps, vpTable *tab, char **cells, int nrows)
+{
+    char  **ttype, **tunit, extname[SZ_LINE], *cell, *ch, *end;
+    int    *widths, *spaces, i, j, len, hdutype, ncols = tab->ncols;
+    int     status = 0;
+    vpCol  *c;
+
+
+    widths = (int *) calloc (ncols, sizeof (int));
+    spaces = (int *) calloc (ncols, sizeof (int));
+    for (i=0; i < nrows; i++) {
+	for (j=0; j < ncols; j++) {
+	    cell = cells[i * ncols + j];
+	    if ((len = strlen (cell)) > widths[j])
+		widths[j] = len;
+
+	    /*  Count the separators of an array value in the first row.
+	     */
+	    if (i == 0 && len > 1 && strchr (cell, (int)' ')) {
+		for (end=&cell[len-1]; isspace(*end) && end > cell; end--)
+		    ;
+		for (ch=cell; isspace(*ch) && ch < end; )
+		    ch++;
+		for (       ; ch <= end; ch++)
+		    if (*ch == ' ')
+			spaces[j]++;
+	    }
+	}
+    }
+
+    ttype    = (char **) calloc (ncols, sizeof (char *));
+    tunit    = (char **) calloc (ncols, sizeof (char *));
+    ps->tform = (char **) calloc (ncols, sizeof (char *));
+    for (j=0; j < ncols; j++) {
+	c = &tab->cols[j];
+	if (c->name)
+	    ttype[j] = strdup (c->name);
+	else {
+	    ttype[j] = calloc (1, SZ_ATTRNAME);
+	    sprintf (ttype[j], "col%d", j + 1);
+	}
+	tunit[j] = strdup (c->unit ? c->unit : "");
+	ps->tform[j] = calloc (1, 16);
+	vot_fitsTForm (ps->tform[j], c->dtype, c->asize, widths[j], spaces[j]);
+    }
+
+    memset (extname, 0, SZ_LINE);
+    if (!tab->tname || strchr (tab->tname, (int)'?') ||
+	strchr (tab->tname, (int)'&'))
+	    sprintf (extname, "ext%d", tab->index + 1);
+    else
+	strncpy (extname, tab->tname, SZ_LINE - 1);
+
+    if (fits_movabs_hdu (ps->fp, tab->index, &hdutype, &status))
+	vot_printerror (status);
+    if (fits_create_tbl (ps->fp, BINARY_TBL, 0, ncols, ttype, ps->tform,
+	tunit, extname, &status))
+	    vot_printerror (status);
+
+    for (j=0; j < ncols; j++) {
+	c = &tab->cols[j];
+	vot_pipeFITSKey (ps->fp, "TID",    j+1, c->id,    "ID attribute");
+	vot_pipeFITSKey (ps->fp, "TUCD",   j+1, c->ucd,   "UCD attribute");
+	vot_pipeFITSKey (ps->fp, "TUTYPE", j+1, c->utype, "UTYPE attribute");
+    }
+
+    for (j=0; j < ncols; j++) {
+	free ((void *) ttype[j]);
+	free ((void *) tunit[j]);
+    }
+    free ((void *) ttype);
+    free ((void *) tunit);
+    free ((void *) widths);
+    free ((void *) spaces);
+
+    ps->created = 1;
+}
+
+
+/**
+ *  vot_pipeFITSWiden -- Widen variable-length character columns that
+ *  have a value longer than the width set from the first batch.
+ */
+static void
+vot_pipeFITSWiden (vpState *ps, vpTable *tab, char **cells, int nrows)
+{
+    int   i, j, len, width, ncols = tab->ncols, status = 0;
+    char *tform;
+
+
+    for (j=0; j < ncols; j++) {
+	tform = ps->tform[j];
+	if (tform[strlen (tform) - 1] != 'A' || !tab->cols[j].asize ||
+	    tab->cols[j].asize[0] != '*')
+		continue;
+
+	for (i=0, width=atoi (tform); i < nrows; i++)
+	    if ((len = strlen (cells[i * ncols + j])) > width)
+		width = len;
+
+	if (width > atoi (tform)) {
+	    if (fits_modify_vector_len (ps->fp, j+1, (long) width, &status))
+		vot_printerror (status);
+	    sprintf (tform, "%dA", width);
+	}
+    }
+}
+
+
+/**
+ *  vot_pipeFITSMeta -- Add the keywords for an INFO or PARAM.
+ */
+static void
+vot_pipeFITSMeta (fitsfile *fp, char *meta, int index, vpMeta *m)
+{
+    char  keyw[SZ_FNAME], comment[SZ_FNAME];
+
+    memset (keyw, 0, SZ_FNAME);
+    memset (comment, 0, SZ_FNAME);
+
+    sprintf (keyw, "%3.3sNAM", meta);
+    sprintf (comment, "%s name attribute", meta);
+    vot_pipeFITSKey (fp, keyw, index, m->name, comment);
+
+    sprintf (keyw, "%3.3sVAL", meta);
+    sprintf (comment, "%s val attribute", meta);
+    vot_pipeFITSKey (fp, keyw, index, m->value, comment);
+
+    sprintf (keyw, "%3.3sID", meta);
+    sprintf (comment, "%s id attribute", meta);
+    vot_pipeFITSKey (fp, keyw, index, m->id, comment);
+
+    sprintf (keyw, "%3.3sUNI", meta);
+    sprintf (comment, "%s unit attribute", meta);
+    vot_pipeFITSKey (fp, keyw, index, m->unit, comment);
+}
+
+
+/**
+ *  vot_pipeFITSKey -- Add an indexed string keyword if it has a value.
+ */
+static void
+vot_pipeFITSKey (fitsfile *fp, char *keyw, int index, char *val,
+		char *comment)
+{
+    char  key[SZ_FNAME];
+    int   status = 0;
+
+
+    if (val == NULL)
+	return;
+
+    memset (key, 0, SZ_FNAME);
+    sprintf (key, "%s%d", keyw, index);
+    if (fits_update_key (fp, TSTRING, key, val, comment, &status))
+	vot_printerror (status);
+}
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ *  VOTSTATS.C -- Memory and timing statistics for the parser.
+ *
+ *  @file       votStats.c
+ *  @author     Mike Fitzpatrick
+ *  @date       10/18/26
+ *
+ *  @brief      Memory and timing statistics for the parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "votParseP.h"
+#include "votParse.h"
+
+
+extern Element *vot_struct;
+extern int      votNParse;
+extern double   votParseBytes;
+extern double   votParseTime;
+
+static void     vot_statElem (Element *e, votStats *st);
+
+
+
+/**
+ *  vot_getStats -- Get memory and timing statistics for the open documents.
+ *
+ *  @brief  Get memory and timing statistics for the open documents.
+ *  @fn     vot_getStats (votStats *stats)
+ *
+ *  @param  stats 	Structure to be filled in
+ *  @return		nothing
+ *
+ *  Byte counts are the sizes allocated by the parser for each part of the
+ *  document tree, not including allocator overhead.  Timing covers every
+ *  vot_openVOTABLE() call made so far.
+ */
+void
+vot_getStats (votStats *stats)
+{
+    memset (stats, 0, sizeof (votStats));
+
+    if (vot_struct)
+	vot_statElem (vot_struct->child, stats);
+
+    stats->nhandles     = vot_handleCount ();
+    stats->handle_peak  = vot_handlePeak ();
+    stats->handle_max   = vot_handleMax ();
+    stats->handle_bytes = (long) stats->handle_max * sizeof (Element *);
+
+    stats->nparse       = votNParse;
+    stats->parse_bytes  = votParseBytes;
+    stats->parse_time   = votParseTime;
+    stats->parse_rate   = (votParseTime > 0.0 ?
+			    (votParseBytes / votParseTime) : 0.0);
+}
+
+
+/**
+ *  vot_printStats -- Print the document statistics (private method).
+ *
+ *  @brief  Print the document statistics (private method)
+ *  @fn     vot_printStats (FILE *fd)
+ *
+ *  @param  fd 		The file descriptor to send the output to.
+ *  @return		nothing
+ */
+void
+vot_printStats (FILE *fd)
+{
+    votStats  st;
+    int  i;
+
+
+    vot_getStats (&st);
+
+    fprintf (fd, "# libVOTable statistics\n");
+    fprintf (fd, "elements       %12ld\n", st.nelements);
+    for (i=0; i < NUM_ELEMENTS; i++) {
+	if (st.nelem[i])
+	    fprintf (fd, "  %-12s %12ld\n", st.ename[i], st.nelem[i]);
+    }
+    fprintf (fd, "cells          %12ld\n", st.ncells);
+    fprintf (fd, "elem_bytes     %12ld\n", st.elem_bytes);
+    fprintf (fd, "attr_bytes     %12ld\n", st.attr_bytes);
+    fprintf (fd, "content_bytes  %12ld\n", st.content_bytes);
+    fprintf (fd, "data_bytes     %12ld\n", st.data_bytes);
+    fprintf (fd, "handle_bytes   %12ld\n", st.handle_bytes);
+    fprintf (fd, "handles        %12d\n",  st.nhandles);
+    fprintf (fd, "handle_peak    %12d\n",  st.handle_peak);
+    fprintf (fd, "parse_docs     %12d\n",  st.nparse);
+    fprintf (fd, "parse_bytes    %12.0f\n", st.parse_bytes);
+    fprintf (fd, "parse_time     %12.4f\n", st.parse_time);
+    fprintf (fd, "parse_rate     %12.0f\n", st.parse_rate);
+    fflush (fd);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  vot_statElem -- Accumulate the statistics for an Element tree.
+ *
+ *  @brief  Accumulate the statistics for an Element tree (private method)
+ *  @fn     vot_statElem (Element *e, votStats *st)
+ *
+ *  @param  e 		First Element of a sibling list
+ *  @param  st 		Statistics to update
+ *  @return		nothing
+ */
+static void
+vot_statElem (Element *e, votStats *st)
+{
+    AttrList *attr;
+    int   idx, i, ncells;
+    char *s;
+
+
+    /*  Siblings are walked iteratively since a TABLEDATA may have many
+     *  thousands of <TR> children, only the children recurse.
+     */
+    for ( ; e; e = e->next) {
+	st->nelements++;
+	if ((idx = vot_elemIndex (e)) >= 0 && idx < NUM_ELEMENTS) {
+	    st->nelem[idx]++;
+	    st->ename[idx] = vot_elemName (e);
+	}
+
+	st->elem_bytes += sizeof (Element) + sizeof (AttrBlock);
+	if (e->attr) {
+	    for (attr=e->attr->attributes; attr; attr=attr->next)
+		st->attr_bytes += sizeof (AttrList);
+	}
+	if (e->content)
+	    st->content_bytes += strlen (e->content) + 2;
+
+	if (e->type == TY_TABLEDATA && e->data) {
+	    handle_t tdata_h = vot_lookupHandle (e);
+
+	    ncells = vot_getNRows (tdata_h) * vot_getNCols (tdata_h);
+	    st->ncells += ncells;
+	    st->data_bytes += (long) ncells * sizeof (char *);
+
+	    if (e->pool) {			/* lazy table, count the pool */
+		for (i=0; i < ncells; i++)
+		    if ((s = e->data[i]))
+		        st->data_bytes += strlen (s) + 1;
+	    }
+	}
+
+	if (e->child)
+	    vot_statElem (e->child, st);
+    }
+}
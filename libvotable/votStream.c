@@ -0,0 +1,616 @@
+/**
+ *  VOTSTREAM.C -- Streaming (non-DOM) VOTable concatenation, splitting and
+ *  row scanning.
+ *
+ *  @file       votStream.c
+ *  @author     Mike Fitzpatrick
+ *  @date       10/18/26
+ *
+ *  @brief      Streaming (non-DOM) VOTable concatenation, splitting and
+ *		row scanning.
+ *
+ *  Rather than building the Element tree, the input is run through an
+ *  Expat parser whose only job is to track the element depth.  Every
+ *  event is forwarded to the default handler which receives the original
+ *  markup, so a top-level <RESOURCE> (and any TABLEDATA or STREAM within
+ *  it) is copied to its output unchanged and nothing is kept in memory
+ *  beyond the input buffer.
+ *
+ *  Row scanning uses the regular parser with a row sink installed so the
+ *  metadata is available as a document but TABLEDATA rows are passed to
+ *  the caller in batches as they are read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <expat.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "votParseP.h"
+#include "votParse.h"
+
+
+#define	SZ_STREAMBUF		65536
+#define	SZ_OUTBUF		262144
+
+#define	STR_CAT			0		/* concatenate inputs	      */
+#define	STR_SPLIT		1		/* one output per RESOURCE    */
+
+
+typedef struct {
+    XML_Parser parser;				/* input parser		      */
+    FILE   *out;				/* current output	      */
+    int     mode;				/* STR_CAT or STR_SPLIT	      */
+    int     depth;				/* current element depth      */
+    int     emit;				/* forwarding this subtree?   */
+    int     capture;			/* capturing the root tag?    */
+    int     nres;				/* number of RESOURCEs	      */
+    int     ninput;				/* number of inputs read      */
+    int     status;				/* OK or ERR		      */
+
+    char   *root;				/* output root (split)	      */
+    int     number;				/* number outputs (split)     */
+    char  **fnames;				/* files written (split)      */
+    int     nfnames, maxfnames;
+
+    char   *header;				/* <VOTABLE> start tag	      */
+    int     hlen, hmax;
+} vsState;
+
+typedef struct {
+    votRowFunc  func;				/* caller's row function      */
+    void       *client;				/* caller's data	      */
+} vsRows;
+
+
+static int   vot_streamFile (vsState *st, char *iname);
+static FILE *vot_streamOpen (char *fname, char *mode);
+static FILE *vot_streamTemp (char *oname, char *tname);
+static void  vot_streamClose (FILE *fd);
+static void  vot_streamHeader (vsState *st, FILE *fd);
+static FILE *vot_streamRoute (vsState *st, const char **atts);
+static int   vot_streamUsed (vsState *st, char *fname);
+
+static void  vot_streamStart (void *user, const char *name, const char **atts);
+static void  vot_streamEnd (void *user, const char *name);
+static void  vot_streamDefault (void *user, const char *s, int len);
+static void  vot_streamRowSink (void *client, Element *tdata, char *pool,
+				char **cells, int nrows, int flag);
+
+
+
+/**
+ *  vot_streamCat -- Concatenate VOTables without parsing them to a tree.
+ *
+ *  @brief  Concatenate VOTables without parsing them to a tree
+ *  @fn     status = vot_streamCat (char **infiles, int nfiles, char *oname)
+ *
+ *  @param  infiles 	List of input file names ("-" or "stdin" allowed)
+ *  @param  nfiles 	Number of input files
+ *  @param  oname 	Output file name ("-" or "stdout" allowed)
+ *  @return		OK or ERR
+ *
+ *  The <VOTABLE> tag of the first input is used for the output document,
+ *  the top-level <RESOURCE>, <INFO>, <PARAM>, <COOSYS> and <GROUP> elements
+ *  of every input are then copied to the output in order.  Only the first
+ *  input's <DESCRIPTION> is kept.  A named output is written to a temporary
+ *  file which replaces it once every input has been read, so the output
+ *  may also be one of the inputs.
+ */
+int
+vot_streamCat (char **infiles, int nfiles, char *oname)
+{
+    vsState  st;
+    char  tname[SZ_FNAME];
+    int  i;
+
+
+    memset (&st, 0, sizeof (vsState));
+    st.mode = STR_CAT;
+
+    memset (tname, 0, SZ_FNAME);
+    if (strcmp (oname, "-") == 0 || strcasecmp (oname, "stdout") == 0)
+	st.out = vot_streamOpen (oname, "w");
+    else
+	st.out = vot_streamTemp (oname, tname);
+    if (st.out == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open output file '%s'\n", oname);
+	return (ERR);
+    }
+
+    for (i=0; i < nfiles; i++) {
+	if (vot_streamFile (&st, infiles[i]) != OK)
+	    st.status = ERR;
+    }
+
+    if (st.header) {
+	fprintf (st.out, "</VOTABLE>\n");
+	free ((void *) st.header);
+    }
+
+    if (tname[0]) {
+	if (fclose (st.out) != 0 || st.status != OK) {
+	    if (st.status == OK)
+		fprintf (stderr, "Error: cannot write output file '%s'\n",
+		    oname);
+	    unlink (tname);
+	    return (ERR);
+	}
+	if (rename (tname, oname) != 0) {
+	    fprintf (stderr, "Error: cannot replace output file '%s'\n", oname);
+	    unlink (tname);
+	    return (ERR);
+	}
+    } else
+	vot_streamClose (st.out);
+
+    return (st.status);
+}
+
+
+/**
+ *  vot_streamSplit -- Split a VOTable into one document per RESOURCE.
+ *
+ *  @brief  Split a VOTable into one document per RESOURCE
+ *  @fn     nres = vot_streamSplit (char *iname, char *root, int number)
+ *
+ *  @param  iname 	Input file name ("-" or "stdin" allowed)
+ *  @param  root 	Root name of the output files
+ *  @param  number 	Always number the output files?
+ *  @return		Number of files written, or -1 on error
+ *
+ *  Each top-level <RESOURCE> is written to "<root>.<name>.xml", where the
+ *  name is the ID or name attribute of the RESOURCE, or to "<root>.<N>.xml"
+ *  when the RESOURCE has neither or 'number' is set.  A name already used
+ *  by an earlier RESOURCE is written as "<root>.<name>.<N>.xml", N being
+ *  the RESOURCE number.
+ */
+int
+vot_streamSplit (char *iname, char *root, int number)
+{
+    vsState  st;
+
+
+    memset (&st, 0, sizeof (vsState));
+    st.mode   = STR_SPLIT;
+    st.root   = root;
+    st.number = number;
+
+    if (vot_streamFile (&st, iname) != OK)
+	st.status = ERR;
+
+    if (st.header)
+	free ((void *) st.header);
+    while (st.nfnames > 0)
+	free ((void *) st.fnames[--st.nfnames]);
+    if (st.fnames)
+	free ((void *) st.fnames);
+
+    return (st.status == OK ? st.nres : -1);
+}
+
+
+/**
+ *  vot_streamRows -- Parse a VOTable passing the table rows to a function.
+ *
+ *  @brief  Parse a VOTable passing the table rows to a function
+ *  @fn     vot = vot_streamRows (char *iname, votRowFunc func, void *client)
+ *
+ *  @param  iname 	Input file name
+ *  @param  func 	Function called for each batch of rows
+ *  @param  client 	Data passed to the function
+ *  @return		Handle to the document, or 0 on error
+ *
+ *  For each TABLEDATA the function is called with VOT_ROWS_BEGIN, then
+ *  with VOT_ROWS_DATA for each batch of rows, then with VOT_ROWS_END.  The
+ *  'tdata' handle may be used to get the table metadata during the calls.
+ *  The returned document holds the metadata only, no rows, and must be
+ *  closed by the caller.
+ */
+handle_t
+vot_streamRows (char *iname, votRowFunc func, void *client)
+{
+    vsRows   vr;
+    handle_t vot;
+
+
+    vr.func   = func;
+    vr.client = client;
+
+    vot_setRowSink (vot_streamRowSink, (void *) &vr);
+    vot = vot_openVOTABLE (iname);
+    vot_setRowSink (NULL, NULL);
+
+    return (vot > 0 ? vot : 0);
+}
+
+
+/**
+ *  vot_streamColumns -- Keep only some columns of the table being streamed.
+ *
+ *  @brief  Keep only some columns of the table being streamed
+ *  @fn     vot_streamColumns (int *cols, int ncols)
+ *
+ *  @param  cols 	Column numbers (0-indexed) to keep, NULL for all
+ *  @param  ncols 	Number of columns in the list
+ *  @return		nothing
+ *
+ *  Called from a vot_streamRows() function at VOT_ROWS_BEGIN.  The text of
+ *  the other columns isn't stored and their cells are passed as NULL, the
+ *  rows keep the full width.  Applies until the end of the TABLEDATA.
+ */
+void
+vot_streamColumns (int *cols, int ncols)
+{
+    vot_setRowColumns (cols, ncols);
+}
+
+
+/**
+ *  vot_streamStop -- Stop reading the input of vot_streamRows().
+ *
+ *  @brief  Stop reading the input of vot_streamRows()
+ *  @fn     vot_streamStop (void)
+ *
+ *  @return		nothing
+ *
+ *  Called from a vot_streamRows() function, no more rows are passed (nor
+ *  the VOT_ROWS_END) and vot_streamRows() returns the metadata read so far.
+ */
+void
+vot_streamStop (void)
+{
+    vot_stopParse ();
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  vot_streamFile -- Run one input through the streaming parser.
+ */
+static int
+vot_streamFile (vsState *st, char *iname)
+{
+    FILE   *fd;
+    void   *buf;
+    size_t  len;
+    int     done = 0, status = OK;
+
+
+    if ((fd = vot_streamOpen (iname, "r")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open input file '%s'\n", iname);
+	return (ERR);
+    }
+
+    st->parser = XML_ParserCreate (NULL);
+    st->depth  = 0;
+    st->emit   = 0;
+    st->ninput++;
+    XML_SetUserData (st->parser, st);
+    XML_SetElementHandler (st->parser, vot_streamStart, vot_streamEnd);
+    XML_SetDefaultHandler (st->parser, vot_streamDefault);
+
+    do {
+	if ((buf = XML_GetBuffer (st->parser, SZ_STREAMBUF)) == NULL) {
+	    fprintf (stderr, "Error: out of memory reading '%s'\n", iname);
+	    status = ERR;
+	    break;
+	}
+	len  = fread (buf, 1, SZ_STREAMBUF, fd);
+	done = (len < SZ_STREAMBUF);
+
+	if (!XML_ParseBuffer (st->parser, (int) len, done)) {
+	    fprintf (stderr, "Error: %s at line %d of '%s'\n",
+		XML_ErrorString (XML_GetErrorCode (st->parser)),
+		(int) XML_GetCurrentLineNumber (st->parser), iname);
+	    status = ERR;
+	    break;
+	}
+    } while (!done);
+
+    /*  Don't leave a split output open on a truncated input.
+     */
+    if (st->emit && st->mode == STR_SPLIT && st->out) {
+	fprintf (st->out, "\n</VOTABLE>\n");
+	vot_streamClose (st->out);
+	st->out = NULL;
+    }
+    st->emit = 0;
+
+    XML_ParserFree (st->parser);
+    if (fd != stdin)
+	fclose (fd);
+
+    return (status);
+}
+
+
+/**
+ *  vot_streamOpen -- Open a stream, allowing for stdin/stdout.
+ */
+static FILE *
+vot_streamOpen (char *fname, char *mode)
+{
+    FILE  *fd = (FILE *) NULL;
+
+
+    if (*mode == 'r') {
+	if (strcmp (fname, "-") == 0 || strcasecmp (fname, "stdin") == 0)
+	    return (stdin);
+	if (strncmp (fname, "file://", 7) == 0)
+	    fname += 7;
+    } else {
+	if (strcmp (fname, "-") == 0 || strcasecmp (fname, "stdout") == 0)
+	    fd = stdout;
+    }
+
+    if (fd == (FILE *) NULL && (fd = fopen (fname, mode)) == (FILE *) NULL)
+	return (fd);
+
+    if (*mode == 'w')
+	setvbuf (fd, NULL, _IOFBF, SZ_OUTBUF);
+    return (fd);
+}
+
+
+/**
+ *  vot_streamTemp -- Open a temporary file to be renamed to 'oname', in
+ *  the same directory so the rename can't cross filesystems.
+ */
+static FILE *
+vot_streamTemp (char *oname, char *tname)
+{
+    FILE  *fd;
+    mode_t mask;
+    int    tfd;
+
+
+    if (strncmp (oname, "file://", 7) == 0)
+	oname += 7;
+    snprintf (tname, SZ_FNAME, "%s.XXXXXX", oname);
+    if ((tfd = mkstemp (tname)) < 0) {
+	tname[0] = '\0';
+	return ((FILE *) NULL);
+    }
+
+    mask = umask (0);				/* mkstemp() mode is 0600     */
+    umask (mask);
+    fchmod (tfd, 0666 & ~mask);
+
+    if ((fd = fdopen (tfd, "w")) == (FILE *) NULL) {
+	close (tfd);
+	unlink (tname);
+	tname[0] = '\0';
+	return (fd);
+    }
+    setvbuf (fd, NULL, _IOFBF, SZ_OUTBUF);
+
+    return (fd);
+}
+
+
+/**
+ *  vot_streamClose -- Close an output stream.
+ */
+static void
+vot_streamClose (FILE *fd)
+{
+    if (fd == stdout)
+	fflush (fd);
+    else if (fd)
+	fclose (fd);
+}
+
+
+/**
+ *  vot_streamHeader -- Write the output document header.
+ */
+static void
+vot_streamHeader (vsState *st, FILE *fd)
+{
+    fprintf (fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fwrite (st->header, 1, st->hlen, fd);
+    fputc ('\n', fd);
+}
+
+
+/**
+ *  vot_streamRoute -- Open the output for the next split RESOURCE.
+ */
+static FILE *
+vot_streamRoute (vsState *st, const char **atts)
+{
+    char   fname[SZ_FNAME], *name = NULL, *s;
+    FILE  *fd;
+    int    i, n;
+
+
+    for (i=0; atts && atts[i]; i += 2) {
+	if (strcasecmp (atts[i], "ID") == 0 ||
+	    (!name && strcasecmp (atts[i], "name") == 0))
+		name = (char *) atts[i+1];
+    }
+
+    memset (fname, 0, SZ_FNAME);
+    if (name && *name && !st->number) {
+	snprintf (fname, SZ_FNAME, "%s.%s.xml", st->root, name);
+	for (s=&fname[strlen(st->root)+1]; *s; s++)	/* no paths    */
+	    if (*s == '/')
+		*s = '_';
+    } else
+	snprintf (fname, SZ_FNAME, "%s.%d.xml", st->root, st->nres + 1);
+
+    /*  RESOURCE names needn't be unique, number any repeated one.
+    */
+    for (i=0; i < 4 && vot_streamUsed (st, fname); i++) {
+	n = strlen (fname) - 4;
+	snprintf (&fname[n], SZ_FNAME - n, ".%d.xml", st->nres + 1);
+    }
+    if (vot_streamUsed (st, fname)) {
+	fprintf (stderr, "Error: output file '%s' already written\n", fname);
+	st->status = ERR;
+	return ((FILE *) NULL);
+    }
+    if (st->nfnames >= st->maxfnames) {
+	st->maxfnames += 64;
+	st->fnames = (char **) realloc (st->fnames,
+	    st->maxfnames * sizeof (char *));
+    }
+    st->fnames[st->nfnames++] = strdup (fname);
+
+    if ((fd = vot_streamOpen (fname, "w")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open output file '%s'\n", fname);
+	st->status = ERR;
+	return (fd);
+    }
+    vot_streamHeader (st, fd);
+
+    return (fd);
+}
+
+
+/**
+ *  vot_streamUsed -- See whether a split output file was already written.
+ */
+static int
+vot_streamUsed (vsState *st, char *fname)
+{
+    int  i;
+
+    for (i=0; i < st->nfnames; i++)
+	if (strcmp (st->fnames[i], fname) == 0)
+	    return (1);
+    return (0);
+}
+
+
+/**
+ *  vot_streamStart -- Start element handler.
+ */
+static void
+vot_streamStart (void *user, const char *name, const char **atts)
+{
+    vsState *st = (vsState *) user;
+
+
+    st->depth++;
+    if (st->depth == 1) {
+	/*  Keep the raw root tag of the first input for the output header.
+	 */
+	if (st->header == NULL) {
+	    st->capture = 1;
+	    XML_DefaultCurrent (st->parser);
+	    st->capture = 0;
+
+	    if (st->hlen > 1 && strcmp (&st->header[st->hlen-2], "/>") == 0)
+		strcpy (&st->header[--st->hlen - 1], ">");   /* empty root */
+	    if (st->mode == STR_CAT)
+		vot_streamHeader (st, st->out);
+	}
+	return;
+    }
+
+    if (st->depth == 2 && !st->emit) {
+	if (strcasecmp (name, "RESOURCE") != 0) {
+	    /*  Concatenation keeps the document-level metadata as well.
+	     */
+	    if (st->mode != STR_CAT)
+		return;
+	    if (strcasecmp (name, "DESCRIPTION") == 0) {
+		if (st->ninput > 1)
+		    return;
+	    } else if (strcasecmp (name, "INFO") != 0 &&
+		strcasecmp (name, "PARAM") != 0 &&
+		strcasecmp (name, "COOSYS") != 0 &&
+		strcasecmp (name, "GROUP") != 0)
+		    return;
+	    st->emit = 1;
+
+	} else {
+	    if (st->mode == STR_SPLIT &&
+		!(st->out = vot_streamRoute (st, atts)))
+		    return;
+	    st->emit = 1;
+	    st->nres++;
+	}
+    }
+
+    if (st->emit)
+	XML_DefaultCurrent (st->parser);
+}
+
+
+/**
+ *  vot_streamEnd -- End element handler.
+ */
+static void
+vot_streamEnd (void *user, const char *name)
+{
+    vsState *st = (vsState *) user;
+
+
+    if (st->emit) {
+	XML_DefaultCurrent (st->parser);
+
+	if (st->depth == 2) {			/* end of a RESOURCE	*/
+	    fputc ('\n', st->out);		/* (or kept metadata)	*/
+	    if (st->mode == STR_SPLIT) {
+		fprintf (st->out, "</VOTABLE>\n");
+		vot_streamClose (st->out);
+		st->out = NULL;
+	    }
+	    st->emit = 0;
+	}
+    }
+    st->depth--;
+}
+
+
+/**
+ *  vot_streamDefault -- Default handler, receives the original markup and
+ *  character data of every event.
+ */
+static void
+vot_streamDefault (void *user, const char *s, int len)
+{
+    vsState *st = (vsState *) user;
+
+
+    if (st->emit) {
+	fwrite (s, 1, len, st->out);
+
+    } else if (st->capture) {
+	if (st->hlen + len + 1 > st->hmax) {
+	    st->hmax = st->hlen + len + SZ_LINE;
+	    st->header = realloc (st->header, st->hmax);
+	}
+	memcpy (&st->header[st->hlen], s, len);
+	st->hlen += len;
+	st->header[st->hlen] = '\0';
+    }
+}
+
+
+/**
+ *  vot_streamRowSink -- Row sink, pass a batch to the caller's function.
+ */
+static void
+vot_streamRowSink (void *client, Element *tdata, char *pool, char **cells,
+		int nrows, int flag)
+{
+    vsRows *vr = (vsRows *) client;
+
+
+    (*vr->func) (vr->client, vot_lookupHandle (tdata), cells, nrows, flag);
+
+    if (flag == VOT_ROWS_DATA) {		/* the batch is ours	*/
+	free ((void *) pool);
+	free ((void *) cells);
+    }
+}
@@ -5,20 +5,26 @@
 **  M. Fitzpatrick, NOAO, July 2007
 */
 
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/types.h>
-#include <sys/wait.h>
-#include <sys/ipc.h>
-#include <sys/sem.h>
 #include "VOClient.h"
+#include "voApps.h"
 #include "voAppsP.h"
 
 
 /* Local processing definitions.
 */
+typedef struct {
+    Acref  *ac;				/* access reference		*/
+    char    fname[SZ_FNAME];		/* output file name		*/
+    char    svc[SZ_FNAME];		/* service name			*/
+    char    idx[10];			/* file index			*/
+} acFile;
 
 extern Acref  *acList, *acTail;		/* Access reference linked list	*/
 extern int     nacrefs;			/* number of access refs	*/
@@ -26,7 +32,7 @@ extern int     file_get;		/* number of files to get	*/
 extern time_t  as_time, ae_time;	/* processing times		*/
 
 extern  int  debug, verbose, quiet;
-extern  int  max_download;
+extern  int  max_download, max_hostq;
 extern  char *output;
 extern  int  errno;			/* system error code		*/
 
@@ -42,8 +48,8 @@ void    vot_addToAclist (char *url, char *fname);
 void    vot_freeAclist (void);
 void    vot_procAclist (void);
 
-static pid_t vot_dlProc (Acref *ac, int filenum);
-static int   vot_acGetURL (char *url, char *fname, long *size);
+static void  vot_acFname (Acref *ac, int filenum, acFile *f);
+static void  vot_acDone (dlReq *req, char *errmsg);
 
 
 
@@ -99,66 +105,50 @@ vot_freeAclist ()
 
 
 /************************************************************************
-**  VOT_PROCACLIST -- Begin processing the access list.  We do this by
-**  spawning up to MAX_DOWNLOADS procs to download the references in
-**  parallel.
+**  VOT_PROCACLIST -- Begin processing the access list.  The references
+**  are downloaded in parallel by the download engine (see voDownload.c),
+**  running up to 'max_download' transfers at once and 'max_hostq' to any
+**  one server.
 */
 void
 vot_procAclist (void)
 {
-    int   nthreads, nfile, nrunning, nremaining;
-    pid_t pid, rc, status;
-    Acref *ac = acList;
+    dlReq  *reqs;
+    acFile *files;
+    Acref  *ac = acList;
+    int     i, nconn;
 
     
     /* Initialize.
     */
-    nthreads = (nacrefs > max_download) ? max_download : nacrefs;
-    nrunning = 0;
-    nremaining = nacrefs;
-
     as_time = time ((time_t *) NULL);	/* get start time	*/
 
-
     if (verbose && !quiet)
 	printf ("\n# Beginning download of %d files....\n", nacrefs);
 
-    for (nfile=1; nremaining > 0;) {
-
-	/* Spawn a process thread for each access reference.
-	*/
-	if (nrunning < nthreads && nfile <= nacrefs) {
-
-	    if (debug)
-		fprintf (stderr, "Starting download for '%s'\n", ac->url);
+    reqs  = (dlReq *) calloc (nacrefs, sizeof (dlReq));
+    files = (acFile *) calloc (nacrefs, sizeof (acFile));
 
-	    if ((pid = vot_dlProc (ac, nfile)) < 0) {
-	        fprintf (stderr, "ERROR: process fork() fails\n");
-	        exit (-1);
- 	    }
-	    nrunning++;
-	    nfile++;
+    for (i=0; i < nacrefs && ac; i++, ac=ac->next) {
+	vot_acFname (ac, i+1, &files[i]);
+	files[i].ac = ac;
+	ac->status  = AC_WORKING;
 
-	    if (ac)
-		ac = ac->next;
+	reqs[i].url  = ac->url;
+	reqs[i].fname = ((output && output[0] == '-') ? "-" : files[i].fname);
+	reqs[i].data = (void *) &files[i];
 
-	} else {
-	    /* All processes running, wait for one to finish.
-	    */
-	    if (debug)
-		fprintf (stderr, "Waiting on download\n");
+	if (debug)
+	    fprintf (stderr, "Queueing download for '%s'\n", ac->url);
+    }
 
-	    if ((rc = waitpid ((pid_t)-1, &status, (int) 0)) < 0) {
-		fprintf (stderr, "ERROR: aclist waitpid() fails, code: %d\n",
-		    (int)rc);
-		exit (-1);
-	    }
-	    status = WEXITSTATUS(status);
+    /* Output to the stdout is written one file at a time.
+    */
+    nconn = ((output && output[0] == '-') ? 1 : max(1,max_download));
+    (void) vot_dlRun (reqs, i, nconn, max(1,max_hostq), 1, vot_acDone);
 
-	    nrunning--;
-	    nremaining--;
-	}
-    }
+    free ((void *) reqs);
+    free ((void *) files);
 
     if (verbose && !quiet)
 	printf ("#\n# Downloads complete.\n");
@@ -171,129 +161,66 @@ vot_procAclist (void)
 
 
 /************************************************************************
-**  VOT_DLPROC -- Procedure used to spawn a download child process.  We
-**  return the child pid, and fork off the actual download.  The caller
-**  will wait for completion. 
+**  VOT_ACFNAME -- Get the output file name, service name and file index
+**  of an access reference.
 */
-static pid_t
-vot_dlProc (Acref *ac, int filenum)
+static void
+vot_acFname (Acref *ac, int filenum, acFile *f)
 {
-    pid_t  cpid;
-    int    nerrs = 0;
-    long   nbytes = 0;
-    char   *urlFname, *out, svc[SZ_FNAME], idx[10], fname[SZ_FNAME];
-
-
-    if (debug)
-	fprintf (stderr, "vot_dlProc(%d): %s\n", filenum, ac->url);
-
-    if ((cpid = fork()) < 0) {
-	fprintf (stderr,
-	    "vot_dlProc: Unable to create child process, exiting\n");
-	exit (-1);
-
-    } else if (cpid > 0) {
-	return (cpid);				/* parent		*/
-
-    } else {					/* child		*/
-        /*  Initialize the VOClient code.  Error messages are printed by the
-        **  interface so we just quit if there is a problem.
-        */
-        if (voc_initVOClient ((char *) NULL) == ERR) 
-            exit (1);
-
-	bzero (idx, 10);
-	bzero (svc, SZ_FNAME);
-	if (ac->fname[0]) {
-	    char *ip, *op;
-
-	    strcpy (fname, ac->fname);
-	    for (ip=fname,op=svc; *ip && *ip != '.'; )
-		*op++ = *ip++;
-	    ip++;
-	    if (isdigit(*ip))
-	        strcpy (idx, ip);
-	    else
-	        strcpy (idx, "001");
-	} else {
-            bzero (fname, SZ_FNAME);
-            sprintf (fname, "%s%03d", (output ? output : "file"), filenum);
-	    strcpy (svc, "file");
-            sprintf (idx, "%03d", filenum);
-	}
-
-	urlFname = vot_urlFname(ac->url);
-        if (verbose) {
-	    if (strcmp (idx, "001") == 0 && !quiet)
-	        fprintf (stderr, "#\n# Downloading URLs from service:  %s...\n",
-		    svc);
-	    if (!quiet)
-	        fprintf (stderr, "#   File %s...", idx);
-	}
-
-        nerrs = vot_acGetURL (ac->url, fname, &nbytes);
+    bzero (f->idx, 10);
+    bzero (f->svc, SZ_FNAME);
+    bzero (f->fname, SZ_FNAME);
 
-        out = vot_validateFile (fname);
+    if (ac->fname[0]) {
+	char *ip, *op;
 
-        if (verbose && !quiet && !nerrs)
-	    fprintf (stderr, " (%ld bytes)  file:  %s\n", nbytes, out);
-
-	strcpy (ac->fname, fname);
-	ac->nbytes = nbytes;
-	ac->status = (nerrs ? AC_ERROR : AC_COMPLETE);
-
-        voc_closeVOClient (0);			/* close VOClient connection */
+	strcpy (f->fname, ac->fname);
+	for (ip=f->fname,op=f->svc; *ip && *ip != '.'; )
+	    *op++ = *ip++;
+	if (*ip)
+	    ip++;
+	if (isdigit(*ip))
+	    strncpy (f->idx, ip, 9);
+	else
+	    strcpy (f->idx, "001");
+    } else {
+        sprintf (f->fname, "%s%03d", (output ? output : "file"), filenum);
+	strcpy (f->svc, "file");
+        sprintf (f->idx, "%03d", filenum);
     }
-
-    exit (0);
 }
 
 
 /************************************************************************
-**  Download a raw URL to the named file.
+**  VOT_ACDONE -- Download engine callback as each reference completes.
 */
-
-static int
-vot_acGetURL (char *url, char *fname, long *size)
+static void
+vot_acDone (dlReq *req, char *errmsg)
 {
-    int  fd, nbytes, err = 0;
-    char *res;
-    extern char *output;
-
-                    
-    if ((res = voc_getRawURL (url, &nbytes)) == NULL) {
-        fprintf (stderr, "Cannot access URL\n");
-        err++;
+    acFile *f = (acFile *) req->data;
+    Acref  *ac = f->ac;
+    char   *out = f->fname;
+
+
+    if (req->status == DL_DONE) {
+	if (strcmp (req->fname, "-") != 0)
+            out = vot_validateFile (f->fname);
+
+	if (verbose && !quiet) {
+	    if (strcmp (f->idx, "001") == 0)
+	        fprintf (stderr, "#\n# Downloading URLs from service:  %s...\n",
+		    f->svc);
+	    fprintf (stderr, "#   File %s... (%ld bytes)  file:  %s\n", 
+		f->idx, req->nbytes, out);
+	}
+	ac->status = AC_COMPLETE;
+
     } else {
-        if (output && output[0] == '-')                 /* use stdout   */
-            fd = fileno(stdout);
-        else {
-            if (access (fname, R_OK|W_OK) == 0)         /* overwrite    */
-                unlink (fname);
-
-            /* Open the file.
-            */
-            if ((fd = open (fname, O_RDWR|O_CREAT, 0644)) < 0) {
-                fprintf (stderr, "Cannot open file '%s'\n",
-                    fname);
-                err++;
-            }
-        }
-
-        /* Write the (binary) result string to the file.
-        */
-        if (write (fd, res, nbytes) != nbytes) {
-            fprintf (stderr, "Short file write\n");
-            err++;
-        }
-
-        if (fd != fileno(stdout))               /* close if not stdout  */
-            close (fd);
+        fprintf (stderr, "Cannot access URL '%s': %s\n", req->url, 
+	    (errmsg ? errmsg : "download failed"));
+	ac->status = AC_ERROR;
     }
 
-    if (res) 
-        free ((char *) res);
-
-    *size = nbytes;                             /* return the size      */
-    return (err);
+    strcpy (ac->fname, out);
+    ac->nbytes = req->nbytes;
 }
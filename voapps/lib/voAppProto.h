@@ -16,8 +16,8 @@ void vot_procAclist (void);
 */
 int   vot_extractResults (char *result, char delim, svcParams *pars);
 char *vot_openExFile (svcParams *pars, int nrows, char *extn, FILE **ofd);
-char *vot_getOFName (svcParams *pars, char *extn, int pid);
-char *vot_getOFIndex (svcParams *pars, char *extn, int pid);
+char *vot_getOFName (svcParams *pars, char *extn);
+char *vot_getOFIndex (svcParams *pars, char *extn);
 int   vot_countResults (char *result);
 void  vot_dalExit (int code, int count);
 void  vot_printHdr (int fd, svcParams *pars);
@@ -63,6 +63,10 @@ char *vot_getSName (char *root);
 char *vot_getOName (char *root);
 int   vot_copyKMLFile (char *root, char *name, FILE *fd);
 void  vot_cleanKML (void);
+int   vot_kmlSinkInit (void);
+int   vot_kmlSinkEnabled (void);
+FILE *vot_kmlSinkOpen (svcParams *pars);
+void  vot_kmlSinkClose (int save);
 
 
 /**
@@ -121,6 +125,72 @@ char *vot_validateFile (char *fname);
 int vot_callSsapSvc (svcParams *pars);
 
 
+/**
+ *  VODALQUERY.C -- Worker procedure to run a DAL query in-process.
+ */
+int vot_dalQuery (svcParams *pars, int *res_count);
+
+
+/**
+ *  VOSINK.C -- Aggregate in-process query results into one output per
+ *  service.
+ */
+int   vot_sinkInit (void);
+int   vot_sinkResult (svcParams *pars, char *votable);
+void  vot_sinkClose (void);
+int   vot_sinkEnabled (void);
+
+
+/**
+ *  VOCACHE.C -- Persistent cache of DAL query results.
+ */
+char *vot_cacheGet (char *url, int fmt);
+void  vot_cachePut (char *url, int fmt, char *result);
+char *vot_cacheExec (Query query, int conn, int fmt, 
+				char *(*execfn)(Query query));
+void  vot_cacheKey (char *url, int fmt, char *key, char *hash);
+
+
+/**
+ *  VODOWNLOAD.C -- Event-driven engine to download many URLs at once.
+ */
+int   vot_dlRun (dlReq *reqs, int nreqs, int maxconn, int maxhost, 
+				int maxtrys, dlDoneFunc done);
+int   vot_dlDigest (char *fname, unsigned char *md5);
+
+
+/**
+ *  VODLCACHE.C -- Content-addressed cache of downloaded files.
+ */
+int   vot_dlcGet (char *url, char *fname);
+int   vot_dlcPut (char *url, char *fname);
+
+
+/**
+ *  VOHASHLOG.C -- A cache file of keyed records, a hash index and log.
+ */
+int   vot_hlogOpen (char *subdir, char *name, char *magic, int nbuckets,
+				int tag, int writable);
+char *vot_hlogLookup (int fd, char *key, int sep, int maxlen, int *len);
+int   vot_hlogStore (int fd, char *key, char *rec, int len);
+uint64_t vot_hlogHash (char *key);
+
+
+/**
+ *  VOPOOL.C -- A pool of worker threads for the tasks.
+ */
+voPool *vot_poolCreate (int nthreads);
+int   vot_poolSize (voPool *pool);
+void  vot_poolRun (voPool *pool, void (*func)(void *data, int k), void *data);
+void  vot_poolFree (voPool *pool);
+
+
+/**
+ *  VORESOLVE.C -- Resolve many object names at once through Sesame.
+ */
+int   vot_resolveNames (resObj *objs, int nobjs, int maxconn, int refresh);
+
+
 /**
  *  VOSVC.C -- Procedures for commandline argument and DAL service handling.
  */
@@ -140,6 +210,8 @@ void  vot_readSvcFile (char *fname, int dalOnly);
  */
 int vo_runTask (char *method, Task *apps, int argc, char **argv, size_t *len, 
 		void **result);
+int vo_setTaskMode (int mode);
+int vo_getTaskMode (void);
 int  vo_taskTest (Task self, char *arg, ...);
 
 int vo_setResultFromFile (char *fname, size_t *len, void **data);
@@ -177,7 +249,9 @@ void  vot_printRegVOTableTail (FILE *fd);
 char *xmlEncode (char *in);
 char *vot_getline (FILE *fd);
 char *vot_normalizeCoord (char *coord);
+char *vot_normCoord (char *coord, char *norm);
 char *vot_normalize (char *str);
+char *vot_normName (char *str, char *name);
 char *vot_toURL (char *arg);
 void  vot_setArg (char **argv, int *argc, char *value);
 
@@ -192,6 +266,7 @@ char *vot_copyStdin (void);
 void  vot_skipHdr (FILE *fd);
 
 char *vot_getTableCol (char *line, int col, int span);
+char *vot_tableCol (char *line, int col, int span, char *value);
 int   vot_isNumericField (handle_t field);
 int   vot_fileType (char *fname);
 int   vot_sum32 (char *str);
@@ -0,0 +1,566 @@
+/************************************************************************
+**  VOCACHE.C -- Persistent cache of DAL query results.
+**
+**  Query results are kept in the 'dalQuery' subdirectory of the VOClient
+**  cache (see voc_getCacheDir(), also used for Sesame), one file per
+**  query named by a hash of the normalized query URL and the result
+**  format.  Each file begins with a header giving its creation time, size
+**  and the full key so a hash collision is never mistaken for a hit:
+**
+**	VOCACHE <ctime> <size>
+**	<key>
+**	<result text>
+**
+**  Lookups open the entry file directly.  A hit sets the file mtime, which
+**  serves as the last-use time for the LRU eviction.  Entries are listed
+**  in an 'index' file ("<hash> <size> <ctime>" per line) that is appended
+**  as results are stored;  when the listed entries exceed the size limit
+**  the index is compacted and the least recently used entries removed
+**  without having to scan the directory.  Updates to the index are made
+**  holding a lock on 'index.lock', so the forked query processes and the
+**  in-process query threads may share the cache.
+**
+**  Only good responses are stored:  an HTML page, a VOTable reporting a
+**  QUERY_STATUS of ERROR, or anything else that isn't a table is taken to
+**  be a service failure that should be retried rather than replayed.  The
+**  total size of the listed entries is kept in 'index.lock' so a store
+**  doesn't have to re-read the index.
+**
+**  The cache is used unless the 'qcache' mode is QC_OFF (the vodata
+**  --nocache option or VOC_NO_CACHE in the environment); with QC_REFRESH
+**  entries are not read but are replaced by the new results.  Entries
+**  expire after VOC_CACHE_TTL seconds (DEF_CACHE_TTL) and the cache is
+**  kept under VOC_CACHE_SIZE megabytes (DEF_CACHE_SIZE).
+**
+**	  result = vot_cacheGet (url, fmt)
+**		   vot_cachePut (url, fmt, result)
+**	  result = vot_cacheExec (query, conn, fmt, execfn)
+*/
+
+#define  _GNU_SOURCE			/* for strcasestr() on linux	*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <time.h>
+#include <utime.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "VOClient.h"
+#include "voAppsP.h"
+
+
+extern int  qcache, debug;
+
+extern char *voc_getCacheDir (char *subdir);
+extern int   vos_fileWrite (int fd, void *vptr, int nbytes);
+
+
+#define	SZ_KEY		8192		/* max normalized key length	*/
+#define	MAX_KPARAMS	256		/* max query params in a key	*/
+
+typedef struct {
+    char    hash[20];			/* entry hash			*/
+    long    size;			/* entry file size		*/
+    time_t  ctime;			/* entry creation time		*/
+    time_t  used;			/* entry last use time		*/
+} cacheEnt;
+
+
+static char    *cacheDir	= (char *) NULL;
+static long     cacheTTL	= DEF_CACHE_TTL;
+static long     cacheMax	= (long) DEF_CACHE_SIZE * 1048576L;
+static int      cacheInit	= FALSE;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+char   *vot_cacheGet (char *url, int fmt);
+void    vot_cachePut (char *url, int fmt, char *result);
+char   *vot_cacheExec (Query query, int conn, int fmt,
+		char *(*execfn)(Query query));
+void    vot_cacheKey (char *url, int fmt, char *key, char *hash);
+
+static int   vot_cacheOpen (void);
+static int   vot_cacheValid (char *result, int fmt);
+static long  vot_cacheTotal (int lfd, long size);
+static void  vot_cacheSetTotal (int lfd, long total);
+static long  vot_cacheEvict (void);
+static int   vot_cacheLock (void);
+static void  vot_cacheUnlock (int fd);
+static int   vot_cacheKCmp (const void *a, const void *b);
+static int   vot_cacheHCmp (const void *a, const void *b);
+static int   vot_cacheUCmp (const void *a, const void *b);
+
+
+
+/************************************************************************
+**  VOT_CACHEGET -- Get the cached result of a query URL in the given
+**  format.  Returns an allocated string, or NULL if not in the cache.
+*/
+char *
+vot_cacheGet (char *url, int fmt)
+{
+    FILE   *fd;
+    char    key[SZ_KEY], hash[20], path[SZ_FNAME], *line, *result;
+    long    ctime = 0, size = -1;
+    time_t  now = time ((time_t *) NULL);
+
+
+    if (qcache != QC_ON || !url || !vot_cacheOpen ())
+	return ((char *) NULL);
+
+    vot_cacheKey (url, fmt, key, hash);
+    sprintf (path, "%s/%s", cacheDir, hash);
+    if ((fd = fopen (path, "r")) == (FILE *) NULL)
+	return ((char *) NULL);
+
+    /*  Check the entry is the one we want and is still current.
+    */
+    line = (char *) calloc (1, SZ_KEY + 2);
+    if (fscanf (fd, "VOCACHE %ld %ld\n", &ctime, &size) != 2 || size < 0 ||
+	!fgets (line, SZ_KEY + 1, fd) || strncmp (line, key, strlen (key)) ||
+	line[strlen (key)] != '\n' || (now - (time_t) ctime) > cacheTTL) {
+	    free ((void *) line);
+	    fclose (fd);
+	    return ((char *) NULL);
+    }
+    free ((void *) line);
+
+    result = (char *) calloc (1, size + 1);
+    if (fread (result, 1, size, fd) != (size_t) size) {
+	free ((void *) result);			/* truncated entry	*/
+	fclose (fd);
+	unlink (path);
+	return ((char *) NULL);
+    }
+    fclose (fd);
+
+    utime (path, NULL);				/* mark the last use	*/
+
+    if (debug)
+	fprintf (stderr, "cache hit: %s\n", key);
+
+    return (result);
+}
+
+
+/************************************************************************
+**  VOT_CACHEPUT -- Save the result of a query URL in the cache.
+*/
+void
+vot_cachePut (char *url, int fmt, char *result)
+{
+    FILE   *fd;
+    char    key[SZ_KEY], hash[20], path[SZ_FNAME], tmp[SZ_FNAME];
+    char    line[SZ_LINE];
+    long    size, osize = 0, total;
+    time_t  now = time ((time_t *) NULL);
+    int     tfd, lfd, ifd, len;
+
+
+    if (qcache == QC_OFF || !url || !result || !vot_cacheOpen ())
+	return;
+    if (!vot_cacheValid (result, fmt)) {
+	if (debug)
+	    fprintf (stderr, "cache: error response not saved: %s\n", url);
+	return;
+    }
+
+    vot_cacheKey (url, fmt, key, hash);
+    size = (long) strlen (result);
+
+    /*  Write the entry to a temp file and move it into place so readers
+    **  never see it partially written.
+    */
+    sprintf (tmp, "%s/.%sXXXXXX", cacheDir, hash);
+    if ((tfd = mkstemp (tmp)) < 0)
+	return;
+    if ((fd = fdopen (tfd, "w")) == (FILE *) NULL) {
+	close (tfd);
+	unlink (tmp);
+	return;
+    }
+    fprintf (fd, "VOCACHE %ld %ld\n%s\n", (long) now, size, key);
+    if (fwrite (result, 1, size, fd) != (size_t) size) {
+	fclose (fd);
+	unlink (tmp);
+	return;
+    }
+    fclose (fd);
+    chmod (tmp, 0644);
+
+    /*  Move it into place holding the index lock, noting the size of
+    **  any entry it replaces so that isn't counted twice in the total.
+    */
+    lfd = vot_cacheLock ();
+    sprintf (path, "%s/%s", cacheDir, hash);
+    if ((fd = fopen (path, "r"))) {
+	if (fscanf (fd, "VOCACHE %*d %ld", &osize) != 1 || osize < 0)
+	    osize = 0;
+	fclose (fd);
+    }
+    if (rename (tmp, path) < 0) {
+	unlink (tmp);
+	vot_cacheUnlock (lfd);
+	return;
+    }
+
+    /*  Add it to the index, and evict entries if we've gone over the
+    **  size limit.  An entry we can't list is removed again.
+    */
+    sprintf (line, "%s %ld %ld\n", hash, size, (long) now);
+    len = (int) strlen (line);
+    sprintf (tmp, "%s/index", cacheDir);
+    if ((ifd = open (tmp, O_WRONLY|O_CREAT|O_APPEND, 0644)) < 0 ||
+	vos_fileWrite (ifd, line, len) != len) {
+	    if (debug)
+		fprintf (stderr, "cache: cannot update index: %s\n", tmp);
+	    unlink (path);
+	    size = 0;
+    }
+    if (ifd >= 0)
+	close (ifd);
+
+    if ((total = vot_cacheTotal (lfd, size - osize)) > cacheMax)
+	total = vot_cacheEvict ();
+    vot_cacheSetTotal (lfd, total);
+    vot_cacheUnlock (lfd);
+}
+
+
+/************************************************************************
+**  VOT_CACHEEXEC -- Execute a VOClient query through the cache.  The
+**  'execfn' is the voc_executeXXX() procedure for the result format and
+**  'conn' the connection type of the query.
+*/
+char *
+vot_cacheExec (Query query, int conn, int fmt, char *(*execfn)(Query query))
+{
+    char  *url = (char *) NULL, *result = (char *) NULL, *ip;
+
+
+    if (qcache != QC_OFF && (url = voc_getQueryString (query, conn, 0))) {
+	for (ip=url; *ip && isspace (*ip); ip++)
+	    ;
+	if ((result = vot_cacheGet (ip, fmt))) {
+	    free ((void *) url);
+	    return (result);
+	}
+    }
+
+    if ((result = (*execfn) (query)) && url)
+	vot_cachePut (ip, fmt, result);
+
+    if (url)
+	free ((void *) url);
+    return (result);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Locate the cache directory and get the cache limits, once.
+*/
+static int
+vot_cacheOpen ()
+{
+    char  *s;
+
+
+    pthread_mutex_lock (&cache_mutex);
+    if (!cacheInit) {
+	cacheInit = TRUE;
+	if (getenv ("VOC_NO_CACHE"))
+	    qcache = QC_OFF;
+	if ((s = getenv ("VOC_CACHE_TTL")))
+	    cacheTTL = atol (s);
+	if ((s = getenv ("VOC_CACHE_SIZE")))
+	    cacheMax = atol (s) * 1048576L;
+	if (qcache != QC_OFF)
+	    cacheDir = voc_getCacheDir ("dalQuery");
+    }
+    pthread_mutex_unlock (&cache_mutex);
+
+    return (qcache != QC_OFF && cacheDir != (char *) NULL);
+}
+
+
+/*  Normalize a query URL into the cache key and compute its hash.  The
+**  scheme and host are case-folded and the query parameters sorted, so
+**  the same query from differently formed service URLs share an entry.
+**  Also used to key the download cache (see voDLCache.c).
+*/
+void
+vot_cacheKey (char *url, int fmt, char *key, char *hash)
+{
+    char  *buf, *ip, *op, *params[MAX_KPARAMS];
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a	*/
+    int    i, np = 0, slashes = 0;
+
+
+    buf = strdup (url);
+    for (op=key, ip=buf; *ip && *ip != '?' && (op - key) < SZ_KEY - 64; ) {
+	if (*ip == '/')
+	    slashes++;
+	*op++ = (slashes < 3 ? tolower (*ip) : *ip);
+	ip++;
+    }
+
+    if (*ip == '?') {
+	*ip++ = '\0';
+	for (op[0]='\0'; *ip && np < MAX_KPARAMS; ) {
+	    params[np] = ip;
+	    while (*ip && *ip != '&')
+		ip++;
+	    if (*ip)
+		*ip++ = '\0';
+	    if (*params[np])			/* skip empty params	*/
+		np++;
+	}
+	qsort (params, np, sizeof (char *), vot_cacheKCmp);
+
+	for (i=0; i < np; i++) {
+	    if ((op - key) + strlen (params[i]) + 2 >= SZ_KEY - 16)
+		break;
+	    *op++ = (i ? '&' : '?');
+	    op = stpcpy (op, params[i]);
+	}
+    }
+    sprintf (op, "#%d", fmt);
+    free ((void *) buf);
+
+    for (ip=key; *ip; ip++) {
+	h ^= (unsigned char) *ip;
+	h *= 1099511628211ULL;
+    }
+    sprintf (hash, "%016llx", h);
+}
+
+
+/*  Compact the index and remove the expired and least recently used
+**  entries until the cache is back under 90% of its limit.  Returns the
+**  total size of the entries left.  Called holding the index lock.
+*/
+static long
+vot_cacheEvict ()
+{
+    FILE     *fd;
+    cacheEnt *ent = (cacheEnt *) NULL;
+    struct stat st;
+    char      line[SZ_LINE], path[SZ_FNAME], tmp[SZ_FNAME];
+    int       i, j, n = 0, nalloc = 0;
+    long      total = 0, ctime;
+    time_t    now = time ((time_t *) NULL);
+
+
+    sprintf (path, "%s/index", cacheDir);
+    if ((fd = fopen (path, "r")) == (FILE *) NULL)
+	return (0L);
+    while (fgets (line, SZ_LINE, fd)) {
+	if (n == nalloc) {
+	    nalloc += 1024;
+	    ent = (cacheEnt *) realloc (ent, nalloc * sizeof (cacheEnt));
+	}
+	memset (&ent[n], 0, sizeof (cacheEnt));
+	if (sscanf (line, "%19s %ld %ld", ent[n].hash, &ent[n].size,
+	    &ctime) == 3) {
+		ent[n].ctime = (time_t) ctime;
+		n++;
+	}
+    }
+    fclose (fd);
+
+    /*  Keep only the last listing of each entry, and drop the entries
+    **  that are gone or out of date.  Sorting by hash keeps the listing
+    **  order within each hash.
+    */
+    for (i=0; i < n; i++)
+	ent[i].used = (time_t) i;
+    qsort (ent, n, sizeof (cacheEnt), vot_cacheHCmp);
+    for (i=0, j=0; i < n; i++) {
+	if (i < n-1 && strcmp (ent[i].hash, ent[i+1].hash) == 0)
+	    continue;
+	sprintf (path, "%s/%s", cacheDir, ent[i].hash);
+	if (stat (path, &st) < 0)
+	    continue;
+	if ((now - ent[i].ctime) > cacheTTL || st.st_size < ent[i].size) {
+	    unlink (path);
+	    continue;
+	}
+	ent[i].used = st.st_mtime;
+	ent[i].size = (long) st.st_size;
+	total += ent[i].size;
+	ent[j++] = ent[i];
+    }
+    n = j;
+
+    /*  Remove the least recently used until we're under the limit.
+    */
+    qsort (ent, n, sizeof (cacheEnt), vot_cacheUCmp);
+    for (i=0; i < n && total > (cacheMax / 10) * 9; i++) {
+	sprintf (path, "%s/%s", cacheDir, ent[i].hash);
+	unlink (path);
+	total -= ent[i].size;
+    }
+
+    /*  Rewrite the index with the remaining entries.
+    */
+    sprintf (tmp, "%s/index.tmp", cacheDir);
+    if ((fd = fopen (tmp, "w"))) {
+	for ( ; i < n; i++)
+	    fprintf (fd, "%s %ld %ld\n", ent[i].hash, ent[i].size,
+		(long) ent[i].ctime);
+	fclose (fd);
+	sprintf (path, "%s/index", cacheDir);
+	rename (tmp, path);
+    }
+
+    if (ent)
+	free ((void *) ent);
+    return (total);
+}
+
+
+/*  See whether a query response is worth keeping:  a table in the
+**  requested format rather than an error page or error VOTable.
+*/
+static int
+vot_cacheValid (char *result, int fmt)
+{
+    char  *ip, *tp, *ep;
+
+
+    for (ip=result; *ip && isspace (*ip); ip++)
+	;
+    if (!*ip || strncasecmp (ip, "<!DOCTYPE html", 14) == 0 ||
+	strncasecmp (ip, "<html", 5) == 0)
+	    return (FALSE);
+
+    if (fmt != F_RAW)			/* delimited text is no markup	*/
+	return (*ip != '<');
+
+    if (!strcasestr (ip, "<VOTABLE"))
+	return (FALSE);
+    for (tp=ip; (tp = strcasestr (tp, "QUERY_STATUS")); tp++) {
+	/*  Check the value in the tag holding the status, either an
+	**  INFO (value="ERROR") or an old-style attribute.
+	*/
+	for (ep=tp; *ep && *ep != '>'; ep++)
+	    ;
+	while (tp > ip && *tp != '<')
+	    tp--;
+	for ( ; tp < ep; tp++)
+	    if ((*tp == '"' || *tp == '\'') &&
+		strncasecmp (tp+1, "ERROR", 5) == 0 && tp[6] == *tp)
+		    return (FALSE);
+    }
+
+    return (TRUE);
+}
+
+
+/*  Get the total size of the listed entries changed by 'size' bytes (a
+**  new entry less any it replaced).  The total is kept in the lock file;
+**  a cache without it has its index read once to find it.  Called holding the index lock.
+*/
+static long
+vot_cacheTotal (int lfd, long size)
+{
+    FILE  *fd;
+    char   buf[64], line[SZ_LINE], path[SZ_FNAME];
+    long   total = 0;
+    int    n;
+
+
+    memset (buf, 0, sizeof (buf));
+    if (lfd >= 0 && (n = pread (lfd, buf, sizeof (buf) - 1, 0L)) > 0 &&
+	isdigit (buf[0]))
+	    return (atol (buf) + size);
+
+    sprintf (path, "%s/index", cacheDir);
+    if ((fd = fopen (path, "r"))) {
+	while (fgets (line, SZ_LINE, fd))
+	    total += atol (strchr (line, ' ') ? strchr (line, ' ') : "0");
+	fclose (fd);
+    }
+    return (total);
+}
+
+
+/*  Save the total size of the listed entries in the lock file.
+*/
+static void
+vot_cacheSetTotal (int lfd, long total)
+{
+    char  buf[64];
+
+
+    if (lfd < 0)
+	return;
+    sprintf (buf, "%ld\n", total);
+    if (pwrite (lfd, buf, strlen (buf), 0L) == (ssize_t) strlen (buf))
+	ftruncate (lfd, (off_t) strlen (buf));
+}
+
+
+/*  Lock the cache index against the other query processes and threads.
+*/
+static int
+vot_cacheLock ()
+{
+    char  path[SZ_FNAME];
+    int   fd;
+
+
+    pthread_mutex_lock (&cache_mutex);
+    sprintf (path, "%s/index.lock", cacheDir);
+    if ((fd = open (path, O_RDWR|O_CREAT, 0644)) >= 0)
+	flock (fd, LOCK_EX);
+    return (fd);
+}
+
+static void
+vot_cacheUnlock (int fd)
+{
+    if (fd >= 0) {
+	flock (fd, LOCK_UN);
+	close (fd);
+    }
+    pthread_mutex_unlock (&cache_mutex);
+}
+
+
+/*  Sort comparisons:  query params by name, and index entries by hash
+**  (then listing order) or by last use.
+*/
+static int
+vot_cacheKCmp (const void *a, const void *b)
+{
+    return (strcmp (*(char **) a, *(char **) b));
+}
+
+static int
+vot_cacheHCmp (const void *a, const void *b)
+{
+    cacheEnt *ea = (cacheEnt *) a, *eb = (cacheEnt *) b;
+    int  c = strcmp (ea->hash, eb->hash);
+
+    return (c ? c : ((ea->used < eb->used) ? -1 : 1));
+}
+
+static int
+vot_cacheUCmp (const void *a, const void *b)
+{
+    time_t  ua = ((cacheEnt *) a)->used, ub = ((cacheEnt *) b)->used;
+
+    return ((ua < ub) ? -1 : ((ua > ub) ? 1 : 0));
+}
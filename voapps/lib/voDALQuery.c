@@ -0,0 +1,278 @@
+/************************************************************************
+**  VODALQUERY.C -- Worker procedure to run a DAL query in-process.
+**
+**  The Cone, SIAP and SSAP callers fork a child process for each query.
+**  When vodata runs its queries in-process this procedure is called from
+**  one of its query threads instead:  the service is queried directly
+**  through the DALClient interface, whose HTTP sessions are kept per-thread
+**  so later queries to the same server reuse the open connection, and the
+**  response is handed to the extraction code as an in-memory buffer.
+**
+**  Responses are looked up in and saved to the query result cache (see
+**  voCache.c) as VOTable text, so a cached query makes no network request
+**  at all.
+**
+**  Only the network request runs concurrently.  The VOTable parser behind
+**  the delimited-text conversion and the extraction code both keep static
+**  state, so the result processing of each query is done holding the
+**  'vot_dalLock'.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "VOClient.h"
+#include "voAppsP.h"
+
+
+extern int  debug, verbose, all_named, all_data, extract, count, count_only;
+extern int  use_name, format, id_col;
+
+extern char *output;
+extern char *d2_band, *d2_time, *d2_format, *d2_version;
+
+int     vot_dalQuery (svcParams *pars, int *res_count);
+
+static  int   vot_dalResult (Query query, char *votable, svcParams *pars,
+		int *res_count);
+
+extern int    vot_extractResults (char *result, char delim, svcParams *pars);
+extern int    vot_countResults (char *result);
+extern void   vot_printCountLine (int nrec, svcParams *pars);
+extern  char *vot_getOFName (svcParams *pars, char *extn);
+extern  char *vot_getOFIndex (svcParams *pars, char *extn);
+extern int    vot_sinkEnabled (void);
+extern int    vot_sinkResult (svcParams *pars, char *votable);
+extern int    vos_fileWrite (int fd, void *vptr, int nbytes);
+
+/*  DALClient interface, called directly rather than through VOClient.
+*/
+extern DAL    dal_openConnection (char *baseurl, char *protocol, char *version);
+extern void   dal_closeConnection (DAL dal_h);
+extern Query  dal_getConeQuery (DAL dal_h, double ra, double dec, double sr);
+extern Query  dal_getSiapQuery (DAL dal_h, double ra, double dec,
+		double ra_size, double dec_size, char *format);
+extern Query  dal_getSsapQuery (DAL dal_h, double ra, double dec,
+		double size, char *band, char *time, char *format);
+extern void   dal_closeQuery (Query query_h);
+extern int    dal_addIntParam (Query query_h, char *pname, long value);
+extern int    dal_addStringParam (Query query_h, char *pname, char *value);
+extern char  *dal_getQueryURL (Query query_h);
+extern int    dal_getQueryResponse (Query query_h);
+extern void   dal_closeQueryResponse (int qr_h);
+extern char  *dal_executeVOTable (Query query_h);
+extern char  *dal_executeDelimited (Query query_h, char delim);
+extern char  *vut_votableToDelimited (char *votable, char delim);
+
+extern char  *vot_cacheGet (char *url, int fmt);
+extern void   vot_cachePut (char *url, int fmt, char *result);
+
+
+pthread_mutex_t vot_dalLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/************************************************************************
+**  VOT_DALQUERY -- Query a DAL service from the calling thread.  Returns
+**  the query status (an E_* code) and the result count in 'res_count'.
+*/
+int
+vot_dalQuery (svcParams *pars, int *res_count)
+{
+    char  *votable = (char *) NULL, *cached = (char *) NULL, *url, *proto;
+    DAL	   dal;					/* DAL Connection handle */
+    Query  query;				/* Query handle		 */
+    int    code = E_NONE;
+
+
+    *res_count = 0;
+    if (getenv ("VOC_NO_NETWORK"))
+	return (E_NONE);
+
+    switch (pars->type) {
+    case SVC_SIAP:	proto = "sia";	break;
+    case SVC_SSAP:	proto = "ssa";	break;
+    default:		proto = "scs";	break;	/* Cone and Vizier	*/
+    }
+
+    /*  Get a new connection to the named service and form the query.
+    */
+    if ((dal = dal_openConnection (pars->service_url, proto, "1.0")) <= 0)
+	return (E_REQFAIL);
+
+    switch (pars->type) {
+    case SVC_SIAP:
+        query = dal_getSiapQuery (dal, pars->ra, pars->dec,
+	    pars->sr, pars->sr, (char *)NULL);
+	break;
+    case SVC_SSAP:
+        query = dal_getSsapQuery (dal, pars->ra, pars->dec, pars->sr,
+	    d2_band, d2_time, d2_format);
+	if (query > 0 && d2_version)
+	    (void) dal_addStringParam (query, "VERSION", d2_version);
+	break;
+    default:
+        query = dal_getConeQuery (dal, pars->ra, pars->dec, pars->sr);
+	if (query > 0 && verbose > 1)
+	    (void) dal_addIntParam (query, "VERB", (all_data ? 3 : verbose));
+	break;
+    }
+    if (query <= 0) {
+	dal_closeConnection (dal);
+	return (E_REQFAIL);
+    }
+
+    url = dal_getQueryURL (query);
+    if (debug)
+	fprintf (stderr, "dalQuery(%s): executing query:\n  %s\n\n",
+	    pars->name, url);
+
+
+    /*  Execute the query unless it is cached, then process the response
+    **  in turn with the other query threads.
+    */
+    if ((cached = vot_cacheGet (url, F_RAW))) {
+	pthread_mutex_lock (&vot_dalLock);
+	code = vot_dalResult ((Query) 0, cached, pars, res_count);
+	pthread_mutex_unlock (&vot_dalLock);
+	free ((void *) cached);
+
+    } else if ((votable = dal_executeVOTable (query)) == (char *) NULL) {
+	if (verbose > 1)
+	    fprintf (stderr, "Query failed: %s\n", pars->service_url);
+	code = E_REQFAIL;
+
+    } else {
+	vot_cachePut (url, F_RAW, votable);
+
+	pthread_mutex_lock (&vot_dalLock);
+	code = vot_dalResult (query, votable, pars, res_count);
+	pthread_mutex_unlock (&vot_dalLock);
+
+	dal_closeQueryResponse (dal_getQueryResponse (query));
+    }
+
+    if (url)
+	free ((void *) url);
+    dal_closeQuery (query);
+    dal_closeConnection (dal);
+
+    return (code);
+}
+
+
+/************************************************************************
+**  VOT_DALRESULT -- Convert, extract and save the result of a query, as
+**  the forked callers do.  A cached result is passed with no 'query'.
+**  Called holding the 'vot_dalLock'.
+*/
+static int
+vot_dalResult (Query query, char *votable, svcParams *pars, int *res_count)
+{
+    char  *result = (char *) NULL, *conv = (char *) NULL;
+    char  *extn, fname[SZ_LINE], delim;
+    int    fd, len;
+
+
+    if (count_only) {
+	*res_count = vot_countResults (votable);
+        if (*res_count <= 0 || count < 0)
+	    return (E_NODATA);
+	vot_printCountLine (*res_count, pars);
+	return (E_NONE);
+    }
+
+    /*  One-file output is appended to the sink of the service directly.
+    */
+    if (vot_sinkEnabled ()) {
+	*res_count = vot_sinkResult (pars, votable);
+	if (count && (!output || (output && output[0] != '-')))
+	    vot_printCountLine (*res_count, pars);
+	return (E_NONE);
+    }
+
+    switch (pars->fmt) {
+    case F_ASCII:
+	extn = "asv"; delim = ' ';
+	break;
+    case F_RAW:
+	extn = "xml"; delim = '\0';
+	break;
+    case F_RAW | F_XML:
+	extn = "xml"; delim = '\0';
+	break;
+    case F_CSV:
+    case F_CSV | F_HTML:			/* EX_* set with the format */
+    case F_CSV | F_KML:
+	extn = "csv"; delim = ',';
+	break;
+    case F_TSV:
+	extn = "tsv"; delim = '\t';
+	break;
+    default:
+	fprintf (stderr, "dalQuery: Unknown format: %d\n", pars->fmt);
+	return (E_REQFAIL);
+    }
+
+    /*  The delimited forms are converted from the VOTable text kept with
+    **  the query response, or from the cached text.
+    */
+    if (!delim)
+	result = votable;
+    else if (query > 0)
+	result = dal_executeDelimited (query, delim);
+    else
+	result = conv = vut_votableToDelimited (votable, delim);
+    if (!result)
+	return (E_NODATA);
+    else if (pars->fmt != F_RAW)
+	*res_count = vot_extractResults (result, delim, pars);
+    else
+	*res_count = vot_countResults (result);
+    if (*res_count < 0) {
+	*res_count = 0;
+	if (conv)
+	    free ((void *) conv);
+	return (E_FILOPEN);
+    }
+
+    if (count && (!output || (output && output[0] != '-')))
+	vot_printCountLine (*res_count, pars);
+
+    if (use_name || all_named || id_col)
+	strcpy (fname, vot_getOFName (pars, extn));
+    else
+	strcpy (fname, vot_getOFIndex (pars, extn));
+
+    /*  Standard output is written by the concatenation step, as for the
+    **  forked callers.
+    */
+    if (format != (F_CSV|F_HTML) && format != (F_CSV|F_KML)) {
+	if ((fd = open (fname, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+	    fprintf (stderr, "Error opening file '%s'\n", fname);
+	    if (conv)
+		free ((void *) conv);
+	    return (E_FILOPEN);
+	}
+	len = strlen (result);
+	if (vos_fileWrite (fd, result, len) != len) {
+	    fprintf (stderr, "Error writing file '%s'\n", fname);
+	    close (fd);
+	    unlink (fname);
+	    if (conv)
+		free ((void *) conv);
+	    return (E_FILOPEN);
+	}
+	close (fd);
+    }
+
+    if (*res_count == 0)
+	unlink (fname);
+    if (conv)
+	free ((void *) conv);
+
+    return (E_NONE);
+}
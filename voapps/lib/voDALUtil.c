@@ -32,8 +32,8 @@ extern  char *vot_getOName (char *root);
 int     vot_extractResults (char *result, char delim, svcParams *pars);
 int     vot_printCount (Query query, svcParams *pars, int *count);
 char    vot_svcTypeCode (int type);
-char   *vot_getOFName (svcParams *pars, char *extn, int pid);
-char   *vot_getOFIndex (svcParams *pars, char *extn, int pid);
+char   *vot_getOFName (svcParams *pars, char *extn);
+char   *vot_getOFIndex (svcParams *pars, char *extn);
 char   *vot_openExFile (svcParams *pars, int nrows, char *extn, FILE **ofd);
 char   *vot_procTimestamp (void);
 char   *vot_getExtn (void);
@@ -55,6 +55,8 @@ extern  void  vot_printKMLPlacemark (FILE *fd, char *id,
 		double ra, double dec, char *line, char *acref,
 		svcParams *pars);
 extern  void  vot_closeKML (FILE *fd);
+extern  int   vot_kmlSinkEnabled (void);
+extern  FILE *vot_kmlSinkOpen (svcParams *pars);
 
 extern  void  vot_initHTML (FILE *fd, svcParams *pars);
 extern  void  vot_printHTMLRow (FILE *fd,  char *line, int isHdr, int rnum);
@@ -79,7 +81,7 @@ vot_extractResults (char *result, char delim, svcParams *pars)
     char  col[SZ_LINE], s_id[SZ_LINE], s_ra[SZ_LINE], s_dec[SZ_LINE];
     char  s_acref[SZ_URL], afname[SZ_LINE], pfname[SZ_LINE];
     char  hfname[SZ_LINE], kfname[SZ_LINE];
-    char *ip = result, *sres, *op, *lp;
+    char *ip = result, *sres, *op, *lp, *fn;
     char  hline[SZ_RESULT], line[SZ_RESULT];
     FILE *pfd = (FILE *)NULL;
     FILE *afd = (FILE *)NULL;
@@ -90,8 +92,8 @@ vot_extractResults (char *result, char delim, svcParams *pars)
 
 
     if (!result)
-	vot_dalExit (E_NODATA, 0);
-	
+	return (0);
+
 
     /* Skip leading whitespace
     */
@@ -185,15 +187,25 @@ vot_extractResults (char *result, char delim, svcParams *pars)
 
     if (extract & EX_POS && (abs(ra) >= 0 && abs(dec) >= 0)) {
 	bzero (pfname, SZ_LINE);
-	strcpy  (pfname, vot_openExFile (pars, nrows, "pos", &pfd) );
+	if ((fn = vot_openExFile (pars, nrows, "pos", &pfd)) == NULL)
+	    goto exerr_;
+	strcpy  (pfname, fn);
     }
     if (extract & EX_ACREF && acref >= 0) {
 	bzero (afname, SZ_LINE);
-	strcpy  (afname, vot_openExFile (pars, nrows, "urls", &afd) );
+	if ((fn = vot_openExFile (pars, nrows, "urls", &afd)) == NULL)
+	    goto exerr_;
+	strcpy  (afname, fn);
     }
     if ((extract & EX_KML) && (abs(ra) >= 0 && abs(dec) >= 0)) {
-	bzero (kfname, SZ_LINE);
-	strcpy  (kfname, vot_openExFile (pars, nrows, "kml", &kfd) );
+	if (vot_kmlSinkEnabled ())		/* in-process, no file	*/
+	    kfd = vot_kmlSinkOpen (pars);
+	else {
+	    bzero (kfname, SZ_LINE);
+	    if ((fn = vot_openExFile (pars, nrows, "kml", &kfd)) == NULL)
+		goto exerr_;
+	    strcpy  (kfname, fn);
+	}
 
 	vot_initKML (kfd, pars);
     }
@@ -202,7 +214,9 @@ vot_extractResults (char *result, char delim, svcParams *pars)
 	    hfd = stdout;
 	} else {
 	    bzero (hfname, SZ_LINE);
-	    strcpy  (hfname, vot_openExFile (pars, nrows, "html", &hfd) );
+	    if ((fn = vot_openExFile (pars, nrows, "html", &hfd)) == NULL)
+		goto exerr_;
+	    strcpy  (hfname, fn);
 	}
 
 	vot_initHTML (hfd, pars);
@@ -298,11 +312,17 @@ vot_extractResults (char *result, char delim, svcParams *pars)
 
 
     return (nrows);
+
+exerr_:					/* an extraction file failed	*/
+    if (pfd) fclose (pfd), unlink (pfname);
+    if (afd) fclose (afd), unlink (afname);
+    if (kfd) vot_closeKML (kfd);
+    return (-1);
 }
 
 
 /************************************************************************
-**  Open an extraction file.
+**  Open an extraction file.  Returns NULL if the file can't be opened.
 */
 char *
 vot_openExFile (svcParams *pars, int nrows, char *extn, FILE **ofd)
@@ -312,12 +332,13 @@ vot_openExFile (svcParams *pars, int nrows, char *extn, FILE **ofd)
 
     bzero (fname, SZ_LINE);
     strcpy (fname, (use_name ? 
-	    vot_getOFName (pars, extn, (int)getpid()) : 
-	    vot_getOFIndex (pars, extn, (int)getpid())) );
+	    vot_getOFName (pars, extn) : 
+	    vot_getOFIndex (pars, extn)) );
 
     if ((fd = fopen (fname, "w+")) == (FILE *) NULL) {
-	fprintf (stderr, "exiting ERROR opening position file\n");
-        vot_dalExit (E_NONE, nrows);
+	fprintf (stderr, "ERROR: Cannot open extraction file '%s'\n", fname);
+	*ofd = (FILE *) NULL;
+	return ( (char *) NULL );
     }
 
     *ofd = fd;
@@ -326,17 +347,20 @@ vot_openExFile (svcParams *pars, int nrows, char *extn, FILE **ofd)
 
 
 /************************************************************************
-**  Construct a standard filename from the service params.
+**  Construct a standard filename from the service params.  Names which
+**  must be unique among the queries are keyed on the service and object
+**  index of the query, so the forked and in-process queries of a run
+**  name their files alike.
 */
 char *
-vot_getOFName (svcParams *pars, char *extn, int pid)
+vot_getOFName (svcParams *pars, char *extn)
 {
-    static char fname[SZ_LINE], *root, spid[16];
+    static char fname[SZ_LINE], *root, spid[32];
 
 
     bzero (fname, SZ_LINE);
-    bzero (spid, 16);
-    sprintf (spid, "_%d", pid);
+    bzero (spid, 32);
+    sprintf (spid, "_%d-%d", pars->svc_index, pars->obj_index);
 
 
     /* Create the root part of the name. */
@@ -387,13 +411,13 @@ vot_getOFName (svcParams *pars, char *extn, int pid)
 
 
 char *
-vot_getOFIndex (svcParams *pars, char *extn, int pid)
+vot_getOFIndex (svcParams *pars, char *extn)
 {
-    static char fname[SZ_LINE], *root, spid[16];
+    static char fname[SZ_LINE], *root, spid[32];
 
     bzero (fname, SZ_LINE);
-    bzero (spid, 16);
-    sprintf (spid, "_%d", pid);
+    bzero (spid, 32);
+    sprintf (spid, "_%d-%d", pars->svc_index, pars->obj_index);
 
 
     /* Create the root part of the name. */
@@ -468,24 +492,20 @@ vot_countResults (char *result)
 
 
 /************************************************************************
-**  Exit the process with the given code.  Before leaving, we create a 
-**  semaphore based on the pid and set the value to be the result count.
-**  This allows us to pass back the information to the parent thread when
-**  setting the status.
+**  Exit the query process with the given code.  Before leaving, we create
+**  a semaphore based on the pid and set the value to be the result count.
+**  This allows us to pass back the information to the parent when setting
+**  the status, the exit code is the query status.
 */
 void
 vot_dalExit (int code, int count)
 {
     int  rc, sem_id, id = getpid();
-    int  status = code;
 
     if ((sem_id = semget ((key_t)id, 1, IPC_CREAT | 0777)) >= 0)
 	rc = semctl (sem_id, 0, SETVAL, count);
 
-/*
     exit (code);
-*/
-    pthread_exit ((void *) &status);
 }
 
 
@@ -699,6 +719,8 @@ vot_getExtn ()
         return ("kml");
     else if (format & F_XML)
         return ("xml");
+    else if (format & F_FITS)
+        return ("fits");
 
     return ((char *) NULL);
 }
@@ -0,0 +1,470 @@
+/************************************************************************
+**  VODLCACHE.C -- Content-addressed cache of downloaded files.
+**
+**  Downloaded files are kept in the 'download' subdirectory of the VOClient
+**  cache (see voc_getCacheDir()).  The file data are stored once in the
+**  'objects' directory, named by the MD5 checksum of their contents, so the
+**  same file reached through different URLs (e.g. the same image returned
+**  by several SIAP queries) is kept only once.  Each URL is mapped to its
+**  data by a small entry file in the 'urls' directory, named by a hash of
+**  the URL normalized as for the query cache (see vot_cacheKey()):
+**
+**	VODLCACHE <ctime> <size>
+**	<key>
+**	<md5>
+**
+**  Entries and objects are written to temp files and renamed into place,
+**  so there is no shared index to lock:  lookups and additions from any
+**  number of download threads and processes go straight to the files.  An
+**  object is checked against its MD5 name before it is served, and a cached
+**  file is materialized at the requested output name as a reflink (copy-on-
+**  write clone) where the filesystem supports it, else as a copy;  new
+**  downloads are cloned or copied into the cache.  Nothing is hard linked,
+**  so the user's files and the cache never share an inode.  A hit sets the
+**  object mtime, which serves as the last-use time for the LRU eviction.
+**
+**  When the objects exceed the size limit one process (holding a lock on
+**  'evict.lock') removes the least recently used until the cache is back
+**  under 90% of the limit, then drops the URL entries left without data.
+**  The cache is kept under VOC_DLCACHE_SIZE megabytes (DEF_DLCACHE_SIZE),
+**  URL entries expire after VOC_DLCACHE_TTL seconds (DEF_DLCACHE_TTL), and
+**  VOC_NO_CACHE in the environment disables it.
+**
+**	    stat = vot_dlcGet (url, fname)
+**	    stat = vot_dlcPut (url, fname)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <utime.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#ifdef Linux
+#include <linux/fs.h>
+#endif
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+extern int   debug;
+
+extern char *voc_getCacheDir (char *subdir);
+extern void  vot_cacheKey (char *url, int fmt, char *key, char *hash);
+
+
+#define	SZ_KEY		8192		/* max normalized key length	*/
+#define	SZ_COPYBUF	65536		/* file copy buffer		*/
+#define	DLC_TMPAGE	3600		/* age of stale temp files	*/
+
+typedef struct {
+    char    name[40];			/* object name (MD5)		*/
+    long    size;			/* object size			*/
+    time_t  used;			/* last use time		*/
+} dlcObj;
+
+
+static char    *dlcDir		= (char *) NULL;
+static long     dlcTTL		= DEF_DLCACHE_TTL;
+static long     dlcMax		= (long) DEF_DLCACHE_SIZE * 1048576L;
+static long     dlcTotal	= -1;		/* est. size of objects	*/
+static int      dlcInit		= FALSE;
+
+static pthread_mutex_t dlc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+int     vot_dlcGet (char *url, char *fname);
+int     vot_dlcPut (char *url, char *fname);
+
+static int   vot_dlcOpen (void);
+static int   vot_dlcLink (char *src, char *dst);
+static int   vot_dlcCopy (char *src, char *dst);
+static long  vot_dlcScan (dlcObj **objs, int *nobjs);
+static void  vot_dlcEvict (void);
+static int   vot_dlcUCmp (const void *a, const void *b);
+
+
+
+/************************************************************************
+**  VOT_DLCGET -- Materialize the cached file of a URL at the named output
+**  file.  Returns OK on a hit, ERR if the URL isn't in the cache.
+*/
+int
+vot_dlcGet (char *url, char *fname)
+{
+    FILE   *fd;
+    char    key[SZ_KEY], hash[20], path[SZ_FNAME], obj[SZ_FNAME];
+    char   *line, md5[40], sum[40];
+    unsigned char  digest[16];
+    long    ctime = 0, size = -1;
+    time_t  now = time ((time_t *) NULL);
+    struct stat st;
+    int     i, ok;
+
+
+    if (!url || !vot_dlcOpen ())
+	return (ERR);
+
+    vot_cacheKey (url, 0, key, hash);
+    sprintf (path, "%s/urls/%s", dlcDir, hash);
+    if ((fd = fopen (path, "r")) == (FILE *) NULL)
+	return (ERR);
+
+    /*  Check the entry is the one we want and is still current.
+    */
+    line = (char *) calloc (1, SZ_KEY + 2);
+    ok = (fscanf (fd, "VODLCACHE %ld %ld\n", &ctime, &size) == 2 &&
+	fgets (line, SZ_KEY + 1, fd) && strncmp (line, key, strlen (key)) == 0
+	&& line[strlen (key)] == '\n' && fscanf (fd, "%32s", md5) == 1);
+    free ((void *) line);
+    fclose (fd);
+
+    if (!ok || (now - (time_t) ctime) > dlcTTL)
+	return (ERR);
+
+    /*  The object may have been evicted since, or been damaged.
+    */
+    sprintf (obj, "%s/objects/%s", dlcDir, md5);
+    if (stat (obj, &st) < 0 || (long) st.st_size != size) {
+	unlink (path);
+	return (ERR);
+    }
+    if (vot_dlDigest (obj, digest) != OK)
+	return (ERR);
+    for (i=0; i < 16; i++)
+	sprintf (&sum[2*i], "%02x", digest[i]);
+    if (strcmp (sum, md5) != 0) {
+	if (debug)
+	    fprintf (stderr, "download cache: bad object %s\n", md5);
+	unlink (obj);
+	unlink (path);
+	return (ERR);
+    }
+
+    if (vot_dlcLink (obj, fname) != OK)
+	return (ERR);
+    utime (obj, NULL);				/* mark the last use	*/
+
+    if (debug)
+	fprintf (stderr, "download cache hit: %s\n", key);
+
+    return (OK);
+}
+
+
+/************************************************************************
+**  VOT_DLCPUT -- Add a downloaded file to the cache for the URL.  The data
+**  are stored only if no other URL gave the same contents.
+*/
+int
+vot_dlcPut (char *url, char *fname)
+{
+    FILE   *fd;
+    char    key[SZ_KEY], hash[20], path[SZ_FNAME], obj[SZ_FNAME];
+    char    tmp[SZ_FNAME], md5[40];
+    unsigned char  digest[16];
+    time_t  now = time ((time_t *) NULL);
+    struct stat st;
+    int     i, tfd, evict = FALSE;
+
+
+    if (!url || !fname || !vot_dlcOpen ())
+	return (ERR);
+    if (stat (fname, &st) < 0 || !S_ISREG (st.st_mode))
+	return (ERR);
+    if (vot_dlDigest (fname, digest) != OK)
+	return (ERR);
+    for (i=0; i < 16; i++)
+	sprintf (&md5[2*i], "%02x", digest[i]);
+
+    /*  Store the data unless we already have them.
+    */
+    sprintf (obj, "%s/objects/%s", dlcDir, md5);
+    if (access (obj, F_OK) == 0)
+	utime (obj, NULL);
+    else {
+	sprintf (tmp, "%s/objects/.%s.%d.%lx", dlcDir, md5, (int) getpid (),
+	    (unsigned long) pthread_self ());
+	if (vot_dlcLink (fname, tmp) != OK || rename (tmp, obj) < 0) {
+	    unlink (tmp);
+	    return (ERR);
+	}
+
+	pthread_mutex_lock (&dlc_mutex);
+	if (dlcTotal >= 0)
+	    dlcTotal += (long) st.st_size;
+	evict = (dlcTotal < 0 || dlcTotal > dlcMax);
+	pthread_mutex_unlock (&dlc_mutex);
+    }
+
+    /*  Add the URL entry.
+    */
+    vot_cacheKey (url, 0, key, hash);
+    sprintf (tmp, "%s/urls/.%sXXXXXX", dlcDir, hash);
+    if ((tfd = mkstemp (tmp)) < 0)
+	return (ERR);
+    if ((fd = fdopen (tfd, "w")) == (FILE *) NULL) {
+	close (tfd);
+	unlink (tmp);
+	return (ERR);
+    }
+    fprintf (fd, "VODLCACHE %ld %ld\n%s\n%s\n", (long) now,
+	(long) st.st_size, key, md5);
+    fclose (fd);
+    chmod (tmp, 0644);
+
+    sprintf (path, "%s/urls/%s", dlcDir, hash);
+    if (rename (tmp, path) < 0) {
+	unlink (tmp);
+	return (ERR);
+    }
+
+    if (evict)
+	vot_dlcEvict ();
+
+    return (OK);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Locate the cache directories and get the cache limits, once.
+*/
+static int
+vot_dlcOpen ()
+{
+    char  *s, path[SZ_FNAME];
+
+
+    pthread_mutex_lock (&dlc_mutex);
+    if (!dlcInit) {
+	dlcInit = TRUE;
+	if ((s = getenv ("VOC_DLCACHE_TTL")))
+	    dlcTTL = atol (s);
+	if ((s = getenv ("VOC_DLCACHE_SIZE")))
+	    dlcMax = atol (s) * 1048576L;
+	if (!getenv ("VOC_NO_CACHE") &&
+	    (dlcDir = voc_getCacheDir ("download"))) {
+		sprintf (path, "%s/objects", dlcDir);
+		mkdir (path, 0755);
+		sprintf (path, "%s/urls", dlcDir);
+		mkdir (path, 0755);
+	}
+    }
+    pthread_mutex_unlock (&dlc_mutex);
+
+    return (dlcDir != (char *) NULL);
+}
+
+
+/*  Make 'dst' a file with the contents of 'src':  a reflink if possible,
+**  else a copy.
+*/
+static int
+vot_dlcLink (char *src, char *dst)
+{
+    unlink (dst);
+
+#ifdef FICLONE
+    {   int  sfd, dfd, stat = ERR;
+
+	if ((sfd = open (src, O_RDONLY)) >= 0) {
+	    if ((dfd = open (dst, O_WRONLY|O_CREAT|O_TRUNC, 0644)) >= 0) {
+		if (ioctl (dfd, FICLONE, sfd) == 0)
+		    stat = OK;
+		close (dfd);
+		if (stat != OK)
+		    unlink (dst);
+	    }
+	    close (sfd);
+	}
+	if (stat == OK)
+	    return (OK);
+    }
+#endif
+
+    return (vot_dlcCopy (src, dst));
+}
+
+
+/*  Copy a file.
+*/
+static int
+vot_dlcCopy (char *src, char *dst)
+{
+    char  buf[SZ_COPYBUF];
+    int   sfd, dfd, n, stat = OK;
+
+
+    if ((sfd = open (src, O_RDONLY)) < 0)
+	return (ERR);
+    if ((dfd = open (dst, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+	close (sfd);
+	return (ERR);
+    }
+    while ((n = read (sfd, buf, SZ_COPYBUF)) > 0) {
+	if (write (dfd, buf, n) != n) {
+	    stat = ERR;
+	    break;
+	}
+    }
+    if (n < 0)
+	stat = ERR;
+    close (sfd);
+    close (dfd);
+
+    if (stat != OK)
+	unlink (dst);
+    return (stat);
+}
+
+
+/*  List the objects and return their total size.  Temp files left by
+**  an interrupted addition are removed.
+*/
+static long
+vot_dlcScan (dlcObj **objs, int *nobjs)
+{
+    DIR    *dir;
+    struct dirent *d;
+    struct stat st;
+    char    path[SZ_FNAME];
+    long    total = 0;
+    int     n = 0, nalloc = 0;
+    time_t  now = time ((time_t *) NULL);
+
+
+    *objs = (dlcObj *) NULL;
+    *nobjs = 0;
+    sprintf (path, "%s/objects", dlcDir);
+    if ((dir = opendir (path)) == (DIR *) NULL)
+	return (0);
+
+    while ((d = readdir (dir))) {
+	if (strlen (d->d_name) >= 40 || strcmp (d->d_name, ".") == 0 ||
+	    strcmp (d->d_name, "..") == 0)
+		continue;
+	snprintf (path, SZ_FNAME, "%s/objects/%s", dlcDir, d->d_name);
+	if (stat (path, &st) < 0)
+	    continue;
+	if (d->d_name[0] == '.') {
+	    if ((now - st.st_mtime) > DLC_TMPAGE)
+		unlink (path);
+	    continue;
+	}
+
+	if (n == nalloc) {
+	    nalloc += 1024;
+	    *objs = (dlcObj *) realloc (*objs, nalloc * sizeof (dlcObj));
+	}
+	strcpy ((*objs)[n].name, d->d_name);
+	(*objs)[n].size = (long) st.st_size;
+	(*objs)[n].used = st.st_mtime;
+	total += (long) st.st_size;
+	n++;
+    }
+    closedir (dir);
+
+    *nobjs = n;
+    return (total);
+}
+
+
+/*  Remove the least recently used objects until the cache is back under
+**  90% of its limit, then the URL entries left without data.  Only one
+**  process evicts at a time, the others carry on.
+*/
+static void
+vot_dlcEvict ()
+{
+    DIR    *dir;
+    FILE   *fd;
+    struct dirent *d;
+    dlcObj *objs = (dlcObj *) NULL;
+    char    path[SZ_FNAME], obj[SZ_FNAME], line[SZ_LINE], md5[40];
+    long    total, ctime, removed = 0;
+    int     i, lfd, nobjs = 0;
+    time_t  now = time ((time_t *) NULL);
+
+
+    sprintf (path, "%s/evict.lock", dlcDir);
+    if ((lfd = open (path, O_RDWR|O_CREAT, 0644)) < 0)
+	return;
+    if (flock (lfd, LOCK_EX|LOCK_NB) < 0) {
+	close (lfd);				/* someone else is at it */
+	return;
+    }
+
+    total = vot_dlcScan (&objs, &nobjs);
+    if (total > dlcMax) {
+	qsort (objs, nobjs, sizeof (dlcObj), vot_dlcUCmp);
+	for (i=0; i < nobjs && total > (dlcMax / 10) * 9; i++) {
+	    sprintf (path, "%s/objects/%s", dlcDir, objs[i].name);
+	    if (unlink (path) == 0) {
+		total -= objs[i].size;
+		removed++;
+	    }
+	}
+    }
+
+    /*  Drop the entries whose data are gone or which have expired.
+    */
+    sprintf (path, "%s/urls", dlcDir);
+    if (removed && (dir = opendir (path))) {
+	while ((d = readdir (dir))) {
+	    if (d->d_name[0] == '.' || strlen (d->d_name) >= 40)
+		continue;
+	    snprintf (path, SZ_FNAME, "%s/urls/%s", dlcDir, d->d_name);
+	    if ((fd = fopen (path, "r")) == (FILE *) NULL)
+		continue;
+	    md5[0] = '\0';
+	    ctime = 0;
+	    if (fgets (line, SZ_LINE, fd))
+		sscanf (line, "VODLCACHE %ld", &ctime);
+	    while (fgets (line, SZ_LINE, fd))	/* md5 is the last line	*/
+		sscanf (line, "%39s", md5);
+	    fclose (fd);
+
+	    sprintf (obj, "%s/objects/%s", dlcDir, md5);
+	    if (!md5[0] || access (obj, F_OK) < 0 || (now - ctime) > dlcTTL)
+		unlink (path);
+	}
+	closedir (dir);
+    }
+
+    pthread_mutex_lock (&dlc_mutex);
+    dlcTotal = total;
+    pthread_mutex_unlock (&dlc_mutex);
+
+    if (debug)
+	fprintf (stderr, "download cache: %ld objects removed, %ld bytes\n",
+	    removed, total);
+
+    if (objs)
+	free ((void *) objs);
+    flock (lfd, LOCK_UN);
+    close (lfd);
+}
+
+
+/*  Sort comparison:  objects by last use.
+*/
+static int
+vot_dlcUCmp (const void *a, const void *b)
+{
+    time_t  ua = ((dlcObj *) a)->used, ub = ((dlcObj *) b)->used;
+
+    return ((ua < ub) ? -1 : ((ua > ub) ? 1 : 0));
+}
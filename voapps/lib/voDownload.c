@@ -0,0 +1,1294 @@
+/************************************************************************
+**  VODOWNLOAD.C -- Event-driven engine to download many URLs at once.
+**
+**  A list of requests is downloaded from a single libcurl 'multi' handle
+**  driven by poll(2) on the transfer sockets, so thousands of transfers
+**  may be run at once from the calling thread without a thread or process
+**  per file.  The multi handle keeps one connection cache for all the
+**  transfers and the easy handles are reused, so requests to the same
+**  server reuse its open connections.  At most 'maxconn' transfers run at
+**  once, and at most 'maxhost' of those to any one server:  the requests
+**  of each server are queued separately and started in turn.  Data are
+**  written straight to the output file of each request as they arrive.
+**
+**	   ngot = vot_dlRun (reqs, nreqs, maxconn, maxhost, maxtrys, done)
+**
+**  The 'done' procedure (if any) is called from the loop as each request
+**  completes or finally fails, to post-process or report the file while
+**  other transfers continue.  A failed request is retried up to 'maxtrys'
+**  attempts in all.  An output name of "-" writes to the standard output;
+**  the caller should then run one transfer at a time, and a transfer that
+**  fails after writing data there isn't retried.  A request with no
+**  output name keeps the data in memory, in the 'buf' of the request, for
+**  small replies such as those of a name resolver;  the caller frees it.
+**
+**  A retry continues a partial file with an HTTP Range request rather than
+**  starting again, as does the first attempt of a request with 'resume'
+**  set if its file already exists.  A request with 'nchunks' > 1 is first
+**  probed with a HEAD request:  if the server takes byte ranges and the
+**  file is large enough, up to 'nchunks' ranges are fetched in parallel
+**  into a "<fname>.part" file sized to the full length, which is renamed
+**  once all the ranges are complete.  Otherwise the file is fetched over
+**  one connection as usual.  The size of each download is checked against
+**  the length given by the server, and the file against its MD5 checksum
+**  when the server sends one (a Content-MD5 or RFC 3230 Digest header).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <curl/curl.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+#define	DL_NHASH	1021		/* host hash table size		*/
+#define	DL_MAXWAIT	1000		/* max poll wait (msec)		*/
+#define	DL_MINCHUNK	(8L*1024*1024)	/* min. size of a parallel range*/
+#define	DL_SZBUF	65536		/* checksum read buffer size	*/
+
+#define	PH_GET		0		/* whole (or resumed) transfer	*/
+#define	PH_PROBE	1		/* HEAD request for the size	*/
+#define	PH_CHUNK	2		/* parallel range transfers	*/
+
+typedef struct dlHost {
+    char    *name;			/* host[:port] of the URL	*/
+    int      nactive;			/* transfers running		*/
+    int      head, tail;		/* queued jobs			*/
+    int      queued;			/* on the ready list?		*/
+    struct dlHost *hnext;		/* hash chain			*/
+    struct dlHost *rnext;		/* ready list			*/
+} dlHost;
+
+typedef struct {
+    long     start, end;		/* byte range of the piece	*/
+    long     pos;			/* next byte to fetch		*/
+    int      ntries;			/* attempts made		*/
+} dlPiece;
+
+typedef struct {
+    int      phase;			/* PH_GET, PH_PROBE or PH_CHUNK	*/
+    long     offset;			/* resume offset of a PH_GET	*/
+    int      hasmd5;			/* checksum given by server?	*/
+    unsigned char md5[16];		/* file checksum		*/
+    long     size;			/* size of a chunked file	*/
+    int      fd;			/* chunked output file		*/
+    char    *part;			/* chunked output file name	*/
+    dlPiece *piece;			/* chunk ranges			*/
+    int      npiece, nwait;		/* chunks, chunks not finished	*/
+    int      failed, fallback;		/* chunk failed, retry whole?	*/
+    char     errmsg[CURL_ERROR_SIZE];	/* chunk error message		*/
+} dlState;
+
+typedef struct {
+    int      req;			/* request index		*/
+    int      piece;			/* chunk index, or -1		*/
+    int      next;			/* host queue link		*/
+} dlJob;
+
+typedef struct {
+    CURL    *curl;			/* easy handle			*/
+    FILE    *fd;			/* output file			*/
+    int      req;			/* request index		*/
+    int      piece;			/* chunk index, or -1		*/
+    dlReq   *r;				/* request			*/
+    dlState *st;			/* request state		*/
+    dlHost  *host;			/* request host			*/
+    int      http;			/* HTTP transfer?		*/
+    int      checked;			/* response code checked?	*/
+    int      norange;			/* server ignored the range?	*/
+    long     offset;			/* bytes in file at start	*/
+    long     code;			/* response code		*/
+    long     hlen, htotal;		/* Content-Length/Range sizes	*/
+    int      hranges;			/* Accept-Ranges: bytes?	*/
+    int      hmd5;			/* 1=Content-MD5, 2=Digest	*/
+    unsigned char md5[16];		/* header checksum		*/
+    char     errbuf[CURL_ERROR_SIZE];	/* transfer error message	*/
+} dlXfer;
+
+typedef struct {
+    CURLM   *multi;			/* multi handle			*/
+    dlReq   *reqs;			/* request list			*/
+    dlState *state;			/* request state		*/
+    int      nleft;			/* requests not yet finished	*/
+    int      ngot;			/* requests downloaded		*/
+    int      maxtrys;			/* max attempts per request	*/
+    dlDoneFunc done;			/* completion procedure		*/
+    dlJob   *jobs;			/* queued jobs			*/
+    int      njobs, szjobs;
+    dlHost **hash;			/* host table			*/
+    dlHost  *ready, *rtail;		/* hosts with queued jobs	*/
+    dlXfer  *xfer;			/* transfer slots		*/
+    CURL   **pool;			/* idle easy handles		*/
+    int      npool, nactive;
+
+    short   *events;			/* poll events, by socket	*/
+    int      nevents;
+    struct pollfd *pfd;			/* poll list			*/
+    int      npfd, dirty;
+    long     deadline;			/* libcurl timer expiry (msec)	*/
+} dlEngine;
+
+typedef struct {
+    unsigned int  a, b, c, d;		/* digest state			*/
+    unsigned int  lo, hi;		/* byte count			*/
+    unsigned char buf[64];		/* input block			*/
+} dlMD5;
+
+
+static pthread_once_t dl_once = PTHREAD_ONCE_INIT;
+
+
+int     vot_dlRun (dlReq *reqs, int nreqs, int maxconn, int maxhost,
+		int maxtrys, dlDoneFunc done);
+int     vot_dlDigest (char *fname, unsigned char *md5);
+
+static void    vot_dlInit (void);
+static dlHost *vot_dlHost (dlEngine *dl, char *url);
+static void    vot_dlQueue (dlEngine *dl, int req, int piece, dlHost *host);
+static int     vot_dlStart (dlEngine *dl, int maxconn, int maxhost);
+static void    vot_dlSetup (dlEngine *dl, dlXfer *x);
+static void    vot_dlGetDone (dlEngine *dl, dlXfer *x, CURLcode res);
+static void    vot_dlProbeDone (dlEngine *dl, dlXfer *x, CURLcode res);
+static void    vot_dlPieceDone (dlEngine *dl, dlXfer *x, CURLcode res);
+static void    vot_dlChunk (dlEngine *dl, int req, long size, dlHost *host);
+static void    vot_dlChunkEnd (dlEngine *dl, int req, dlHost *host);
+static void    vot_dlFinish (dlEngine *dl, dlReq *r, char *errmsg);
+static int     vot_dlSocket (CURL *e, curl_socket_t s, int what, void *data,
+		void *sockp);
+static int     vot_dlTimer (CURLM *multi, long timeout_ms, void *data);
+static size_t  vot_dlWrite (void *ptr, size_t size, size_t nmemb, void *data);
+static size_t  vot_dlHeader (void *ptr, size_t size, size_t nmemb, void *data);
+static int     vot_dlCheck (dlXfer *x);
+static void    vot_dlPollList (dlEngine *dl);
+static long    vot_dlClock (void);
+
+static char   *vot_dlHdrVal (char *line, char *name);
+static int     vot_dlBase64 (char *in, unsigned char *out, int maxout);
+static int     vot_dlVerify (char *fname, unsigned char *md5);
+static void    vot_md5Init (dlMD5 *m);
+static void    vot_md5Update (dlMD5 *m, unsigned char *data, size_t len);
+static void    vot_md5Final (dlMD5 *m, unsigned char *digest);
+static void    vot_md5Block (dlMD5 *m, unsigned char *p);
+
+
+
+/************************************************************************
+**  VOT_DLRUN -- Download a list of URLs.  Returns the number of requests
+**  downloaded successfully;  the status and size of each are set in the
+**  request.
+*/
+int
+vot_dlRun (dlReq *reqs, int nreqs, int maxconn, int maxhost, int maxtrys,
+	dlDoneFunc done)
+{
+    dlEngine  dl;
+    dlXfer   *x;
+    CURLMsg  *msg;
+    CURLcode  res;
+    struct stat fs;
+    int       i, n, wait, running = 0, msgs;
+
+
+    if (nreqs <= 0)
+	return (0);
+
+    maxconn = max(1, maxconn);
+    maxhost = max(1, min(maxhost, maxconn));
+    maxtrys = max(1, maxtrys);
+    pthread_once (&dl_once, vot_dlInit);
+
+    memset (&dl, 0, sizeof (dl));
+    dl.reqs    = reqs;
+    dl.nleft   = nreqs;
+    dl.done    = done;
+    dl.maxtrys = maxtrys;
+    dl.deadline = -1;
+    dl.state   = (dlState *) calloc (nreqs, sizeof (dlState));
+    dl.szjobs  = nreqs;
+    dl.jobs    = (dlJob *) calloc (dl.szjobs, sizeof (dlJob));
+    dl.hash    = (dlHost **) calloc (DL_NHASH, sizeof (dlHost *));
+    dl.xfer    = (dlXfer *) calloc (maxconn, sizeof (dlXfer));
+    dl.pool    = (CURL **) calloc (maxconn, sizeof (CURL *));
+
+    dl.multi = curl_multi_init ();
+    curl_multi_setopt (dl.multi, CURLMOPT_SOCKETFUNCTION, vot_dlSocket);
+    curl_multi_setopt (dl.multi, CURLMOPT_SOCKETDATA, &dl);
+    curl_multi_setopt (dl.multi, CURLMOPT_TIMERFUNCTION, vot_dlTimer);
+    curl_multi_setopt (dl.multi, CURLMOPT_TIMERDATA, &dl);
+    curl_multi_setopt (dl.multi, CURLMOPT_MAXCONNECTS, (long) maxconn);
+
+    /*  Queue the requests by host.  Output to the standard output or to
+    **  memory is never resumed or chunked.
+    */
+    for (i=0; i < nreqs; i++) {
+	dlReq   *r  = &reqs[i];
+	dlState *st = &dl.state[i];
+
+	r->status = DL_PENDING;
+	r->nbytes = 0;
+	r->ntries = 0;
+	st->fd    = -1;
+	st->phase = PH_GET;
+	if (r->fname && strcmp (r->fname, "-") != 0) {
+	    if (r->resume && stat (r->fname, &fs) == 0)
+		st->offset = (long) fs.st_size;
+	    else if (r->nchunks > 1)
+		st->phase = PH_PROBE;
+	}
+	vot_dlQueue (&dl, i, -1, vot_dlHost (&dl, r->url));
+    }
+    for (i=0; i < maxconn; i++)
+	dl.xfer[i].req = -1;
+
+
+    while (dl.nleft > 0) {
+	vot_dlStart (&dl, maxconn, maxhost);
+
+	/*  Wait for socket activity or the libcurl timeout, and let
+	**  libcurl service the transfers.
+	*/
+	if (dl.dirty)
+	    vot_dlPollList (&dl);
+	wait = DL_MAXWAIT;
+	if (dl.deadline >= 0)
+	    wait = (int) max(0, min(DL_MAXWAIT, dl.deadline - vot_dlClock()));
+	n = poll (dl.pfd, dl.npfd, wait);
+
+	/*  The libcurl timer fires once, it is re-armed by the callback.
+	*/
+	if (dl.deadline >= 0 && vot_dlClock() >= dl.deadline) {
+	    dl.deadline = -1;
+	    curl_multi_socket_action (dl.multi, CURL_SOCKET_TIMEOUT, 0,
+		&running);
+	}
+	if (n > 0) {
+	    for (i=0; i < dl.npfd && n > 0; i++) {
+		short rev = dl.pfd[i].revents;
+		int   ev = 0;
+
+		if (!rev)
+		    continue;
+		n--;
+		if (rev & POLLIN)  ev |= CURL_CSELECT_IN;
+		if (rev & POLLOUT) ev |= CURL_CSELECT_OUT;
+		if (rev & (POLLERR|POLLHUP|POLLNVAL)) ev |= CURL_CSELECT_ERR;
+		curl_multi_socket_action (dl.multi, dl.pfd[i].fd, ev,
+		    &running);
+	    }
+	}
+
+	/*  Finish the completed transfers.
+	*/
+	while ((msg = curl_multi_info_read (dl.multi, &msgs))) {
+	    if (msg->msg != CURLMSG_DONE)
+		continue;
+
+	    res = msg->data.result;		/* freed by the remove	*/
+	    curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, (char **)&x);
+	    if (x->http)
+		curl_easy_getinfo (x->curl, CURLINFO_RESPONSE_CODE, &x->code);
+	    curl_multi_remove_handle (dl.multi, x->curl);
+	    dl.pool[dl.npool++] = x->curl;
+	    if (x->fd && x->fd != stdout)
+		fclose (x->fd);
+	    else if (x->fd)
+		fflush (x->fd);
+	    x->fd = (FILE *) NULL;
+	    x->host->nactive--;
+	    dl.nactive--;
+
+	    if (x->piece >= 0)
+		vot_dlPieceDone (&dl, x, res);
+	    else if (x->st->phase == PH_PROBE)
+		vot_dlProbeDone (&dl, x, res);
+	    else
+		vot_dlGetDone (&dl, x, res);
+
+	    x->req = -1;
+	    x->curl = (CURL *) NULL;
+	}
+    }
+
+
+    /*  Clean up.
+    */
+    for (i=0; i < dl.npool; i++)
+	curl_easy_cleanup (dl.pool[i]);
+    curl_multi_cleanup (dl.multi);
+
+    for (i=0; i < DL_NHASH; i++) {
+	dlHost *h, *hn;
+
+	for (h=dl.hash[i]; h; h=hn) {
+	    hn = h->hnext;
+	    free ((void *) h->name);
+	    free ((void *) h);
+	}
+    }
+    free ((void *) dl.state);
+    free ((void *) dl.jobs);
+    free ((void *) dl.hash);
+    free ((void *) dl.xfer);
+    free ((void *) dl.pool);
+    if (dl.events)
+	free ((void *) dl.events);
+    if (dl.pfd)
+	free ((void *) dl.pfd);
+
+    return (dl.ngot);
+}
+
+
+
+/************************************************************************
+**  VOT_DLDIGEST -- Compute the MD5 checksum of a file.
+*/
+int
+vot_dlDigest (char *fname, unsigned char *md5)
+{
+    unsigned char  buf[DL_SZBUF];
+    dlMD5  m;
+    int    fd, n;
+
+
+    if ((fd = open (fname, O_RDONLY)) < 0)
+	return (ERR);
+
+    vot_md5Init (&m);
+    while ((n = read (fd, buf, DL_SZBUF)) > 0)
+	vot_md5Update (&m, buf, (size_t) n);
+    vot_md5Final (&m, md5);
+    close (fd);
+
+    return ((n == 0) ? OK : ERR);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Finish a request:  remove the output of a failed download and call
+**  the completion procedure.
+*/
+static void
+vot_dlFinish (dlEngine *dl, dlReq *r, char *errmsg)
+{
+    if (r->status == DL_DONE)
+	dl->ngot++;
+    else if (!r->fname) {
+	if (r->buf)
+	    free ((void *) r->buf);
+	r->buf = (char *) NULL;
+    } else if (strcmp (r->fname, "-") != 0)
+	unlink (r->fname);
+
+    dl->nleft--;
+    if (dl->done)
+	(*dl->done) (r, errmsg);
+}
+
+/*  One-time libcurl initialization;  curl_global_init() isn't thread-safe.
+*/
+static void
+vot_dlInit (void)
+{
+    curl_global_init (CURL_GLOBAL_ALL);
+}
+
+
+/*  Find (or add) the host of a URL.
+*/
+static dlHost *
+vot_dlHost (dlEngine *dl, char *url)
+{
+    char   name[SZ_FNAME], *ip, *op;
+    unsigned int  h = 0;
+    dlHost *host;
+
+
+    memset (name, 0, SZ_FNAME);
+    ip = ((ip = strstr (url, "://")) ? ip + 3 : url);
+    for (op=name; *ip && *ip != '/' && *ip != '?' && op < &name[SZ_FNAME-1]; )
+	*op++ = *ip++;
+    for (op=name; *op; op++)
+	h = (h * 31) + (unsigned char) *op;
+    h %= DL_NHASH;
+
+    for (host=dl->hash[h]; host; host=host->hnext)
+	if (strcmp (host->name, name) == 0)
+	    return (host);
+
+    host = (dlHost *) calloc (1, sizeof (dlHost));
+    host->name = strdup (name);
+    host->head = host->tail = -1;
+    host->hnext = dl->hash[h];
+    dl->hash[h] = host;
+
+    return (host);
+}
+
+
+/*  Add a job (a request, or one chunk of it) to the queue of its host.
+*/
+static void
+vot_dlQueue (dlEngine *dl, int req, int piece, dlHost *host)
+{
+    int  job;
+
+
+    if (dl->njobs >= dl->szjobs) {
+	dl->szjobs *= 2;
+	dl->jobs = (dlJob *) realloc (dl->jobs, dl->szjobs * sizeof (dlJob));
+    }
+    job = dl->njobs++;
+    dl->jobs[job].req   = req;
+    dl->jobs[job].piece = piece;
+    dl->jobs[job].next  = -1;
+
+    if (host->tail < 0)
+	host->head = job;
+    else
+	dl->jobs[host->tail].next = job;
+    host->tail = job;
+
+    if (!host->queued) {			/* add to the ready list */
+	host->queued = TRUE;
+	host->rnext = (dlHost *) NULL;
+	if (dl->rtail)
+	    dl->rtail->rnext = host;
+	else
+	    dl->ready = host;
+	dl->rtail = host;
+    }
+}
+
+
+/*  Start queued jobs while there are free transfer slots, taking one
+**  from each host in turn so no server is favored.  Returns the number
+**  started.
+*/
+static int
+vot_dlStart (dlEngine *dl, int maxconn, int maxhost)
+{
+    dlHost  *host, *last;
+    dlXfer  *x;
+    dlReq   *r;
+    dlState *st;
+    int      i, job, req, piece, nstart = 0, nskip = 0;
+
+
+    while (dl->nactive < maxconn && dl->ready) {
+	/*  Take the first host off the ready list.
+	*/
+	host = dl->ready;
+	if (!(dl->ready = host->rnext))
+	    dl->rtail = (dlHost *) NULL;
+	host->rnext = (dlHost *) NULL;
+
+	if (host->nactive >= maxhost) {
+	    /*  Host is busy, put it back at the end.  Stop once we've
+	    **  seen every host on the list busy.
+	    */
+	    if (dl->rtail)
+		dl->rtail->rnext = host;
+	    else
+		dl->ready = host;
+	    dl->rtail = host;
+	    for (i=0, last=dl->ready; last; last=last->rnext)
+		i++;
+	    if (++nskip >= i)
+		break;
+	    continue;
+	}
+	nskip = 0;
+
+	job = host->head;
+	if ((host->head = dl->jobs[job].next) < 0)
+	    host->tail = -1;
+	req   = dl->jobs[job].req;
+	piece = dl->jobs[job].piece;
+
+	r  = &dl->reqs[req];
+	st = &dl->state[req];
+	if (piece >= 0 && st->failed) {
+	    /*  A chunk of a failed file, just count it out.
+	    */
+	    if (--st->nwait == 0)
+		vot_dlChunkEnd (dl, req, host);
+
+	} else {
+	    for (x=dl->xfer; x->req >= 0; x++)	/* find a free slot	*/
+		;
+	    x->req   = req;
+	    x->piece = piece;
+	    x->r     = r;
+	    x->st    = st;
+	    x->host  = host;
+	    vot_dlSetup (dl, x);
+
+	    if (x->req >= 0) {
+		host->nactive++;
+		dl->nactive++;
+		nstart++;
+		curl_multi_add_handle (dl->multi, x->curl);
+	    }
+	}
+
+	if (host->head >= 0) {			/* more to do, requeue	*/
+	    if (dl->rtail)
+		dl->rtail->rnext = host;
+	    else
+		dl->ready = host;
+	    dl->rtail = host;
+	} else
+	    host->queued = FALSE;
+    }
+
+    return (nstart);
+}
+
+
+/*  Set up the transfer of a job.  The output file of a whole-file transfer
+**  is opened here, continuing a partial file from its resume offset.  If
+**  the file can't be opened the request is finished and the slot is left
+**  free.
+*/
+static void
+vot_dlSetup (dlEngine *dl, dlXfer *x)
+{
+    dlReq   *r  = x->r;
+    dlState *st = x->st;
+    char     range[SZ_FNAME];
+
+
+    memset (x->errbuf, 0, CURL_ERROR_SIZE);
+    x->fd      = (FILE *) NULL;
+    x->offset  = 0;
+    x->code    = 0;
+    x->checked = x->norange = 0;
+    x->hlen    = x->htotal = -1;
+    x->hranges = x->hmd5 = 0;
+    x->http    = (strncasecmp (r->url, "http", 4) == 0);
+
+    if (x->piece < 0 && st->phase == PH_GET) {
+	r->ntries++;
+	r->nbytes = 0;
+	if (!r->fname) {
+	    if (r->buf)				/* data kept in memory	*/
+		free ((void *) r->buf);
+	    r->buf = (char *) NULL;
+	} else if (strcmp (r->fname, "-") == 0)
+	    x->fd = stdout;
+	else if (st->offset > 0 && x->http &&
+	    (x->fd = fopen (r->fname, "r+b"))) {
+		fseek (x->fd, st->offset, SEEK_SET);
+		x->offset = r->nbytes = st->offset;
+	} else {
+	    unlink (r->fname);		/* may share an old cached copy */
+	    if ((x->fd = fopen (r->fname, "wb")) == (FILE *) NULL) {
+		x->req = -1;
+		r->status = DL_ERROR;
+		vot_dlFinish (dl, r, "cannot open output file");
+		return;
+	    }
+	}
+    }
+
+    /*  Handles are reset for reuse;  the connections are kept by the
+    **  multi handle.
+    */
+    if (dl->npool > 0) {
+	x->curl = dl->pool[--dl->npool];
+	curl_easy_reset (x->curl);
+    } else
+	x->curl = curl_easy_init ();
+
+    curl_easy_setopt (x->curl, CURLOPT_URL, r->url);
+    curl_easy_setopt (x->curl, CURLOPT_WRITEFUNCTION, vot_dlWrite);
+    curl_easy_setopt (x->curl, CURLOPT_WRITEDATA, x);
+    curl_easy_setopt (x->curl, CURLOPT_HEADERFUNCTION, vot_dlHeader);
+    curl_easy_setopt (x->curl, CURLOPT_HEADERDATA, x);
+    curl_easy_setopt (x->curl, CURLOPT_PRIVATE, x);
+    curl_easy_setopt (x->curl, CURLOPT_ERRORBUFFER, x->errbuf);
+    curl_easy_setopt (x->curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt (x->curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt (x->curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+    if (x->piece >= 0) {
+	dlPiece *p = &st->piece[x->piece];
+
+	p->ntries++;
+	sprintf (range, "%ld-%ld", p->pos, p->end);
+	curl_easy_setopt (x->curl, CURLOPT_RANGE, range);
+    } else if (st->phase == PH_PROBE)
+	curl_easy_setopt (x->curl, CURLOPT_NOBODY, 1L);
+
+    else if (x->offset > 0) {
+	/*  A plain range rather than a libcurl resume, which fails if the
+	**  server sends the whole file;  vot_dlCheck() handles that.
+	*/
+	sprintf (range, "%ld-", x->offset);
+	curl_easy_setopt (x->curl, CURLOPT_RANGE, range);
+    }
+}
+
+
+/*  Finish a whole-file transfer:  check the size and checksum, and either
+**  finish the request or queue it again to continue the partial file.
+*/
+static void
+vot_dlGetDone (dlEngine *dl, dlXfer *x, CURLcode res)
+{
+    dlReq   *r  = x->r;
+    dlState *st = x->st;
+    char    *err = (char *) NULL;
+    long     size = -1;
+    int      stdo = (!r->fname || strcmp (r->fname, "-") == 0);
+    int      sent = (r->fname && stdo && r->nbytes > 0);
+
+
+    if (res != CURLE_OK)
+	err = (x->errbuf[0] ? x->errbuf : (char *) curl_easy_strerror (res));
+    else if (x->http && x->code >= 400) {
+	if (x->code == 416 && x->offset > 0 && x->htotal == x->offset)
+	    x->hlen = 0;			/* file was complete	*/
+	else {
+	    sprintf (x->errbuf, "HTTP error %ld", x->code);
+	    err = x->errbuf;
+	}
+    }
+
+    if (!err) {
+	/*  A Content-MD5 of a ranged response is for the range only.
+	*/
+	if (x->hmd5 == 2 || (x->hmd5 && x->code != 206)) {
+	    memcpy (st->md5, x->md5, 16);
+	    st->hasmd5 = TRUE;
+	}
+
+	if (x->htotal >= 0)
+	    size = x->htotal;
+	else if (x->hlen >= 0)
+	    size = x->offset + x->hlen;
+
+	if (size >= 0 && r->nbytes != size) {
+	    sprintf (x->errbuf, "size mismatch (%ld of %ld bytes)",
+		r->nbytes, size);
+	    err = x->errbuf;
+	} else if (st->hasmd5 && !stdo && vot_dlVerify (r->fname,st->md5) != OK)
+	    err = "checksum mismatch";
+
+	if (!err) {
+	    r->status = DL_DONE;
+	    vot_dlFinish (dl, r, (char *) NULL);
+	    return;
+	}
+	st->offset = 0;				/* bad file, start again */
+
+    } else if (!stdo && x->http && r->nbytes > 0 && !(x->code >= 400))
+	st->offset = r->nbytes;			/* continue partial file */
+    else
+	st->offset = 0;
+
+    /*  Data already written to the standard output can't be taken back
+    **  or continued, so a retry there would repeat it.
+    */
+    if (r->ntries < dl->maxtrys && !sent)
+	vot_dlQueue (dl, x->req, -1, x->host);	/* try again		*/
+    else {
+	r->status = DL_ERROR;
+	vot_dlFinish (dl, r, err);
+    }
+}
+
+
+/*  Finish the HEAD request of a chunked download:  split the file into
+**  ranges if the server allows it and the file is large enough, else
+**  fetch it whole.
+*/
+static void
+vot_dlProbeDone (dlEngine *dl, dlXfer *x, CURLcode res)
+{
+    dlState *st = x->st;
+
+
+    if (res == CURLE_OK && x->code == 200 && x->hmd5) {
+	memcpy (st->md5, x->md5, 16);
+	st->hasmd5 = TRUE;
+    }
+
+    st->phase = PH_GET;
+    if (res == CURLE_OK && x->code == 200 && x->hranges && 
+	x->hlen >= 2 * DL_MINCHUNK)
+	    vot_dlChunk (dl, x->req, x->hlen, x->host);
+    else
+	vot_dlQueue (dl, x->req, -1, x->host);
+}
+
+
+/*  Split a request into ranges written in parallel to a full-sized
+**  "<fname>.part" file.
+*/
+static void
+vot_dlChunk (dlEngine *dl, int req, long size, dlHost *host)
+{
+    dlReq   *r  = &dl->reqs[req];
+    dlState *st = &dl->state[req];
+    long     chunk;
+    int      i, n;
+
+
+    st->part = (char *) calloc (1, strlen (r->fname) + 8);
+    sprintf (st->part, "%s.part", r->fname);
+
+    if ((st->fd = open (st->part, O_RDWR|O_CREAT|O_TRUNC, 0644)) < 0 ||
+	ftruncate (st->fd, (off_t) size) < 0) {
+	    if (st->fd >= 0) {
+		close (st->fd);
+		unlink (st->part);
+	    }
+	    st->fd = -1;
+	    free ((void *) st->part);
+	    st->part = (char *) NULL;
+	    vot_dlQueue (dl, req, -1, host);	/* fetch it whole	*/
+	    return;
+    }
+
+    n = (int) min((long) r->nchunks, size / DL_MINCHUNK);
+    chunk = size / n;
+
+    st->phase  = PH_CHUNK;
+    st->size   = size;
+    st->npiece = st->nwait = n;
+    st->failed = st->fallback = 0;
+    st->piece  = (dlPiece *) calloc (n, sizeof (dlPiece));
+    r->nbytes  = 0;
+    r->ntries++;
+
+    for (i=0; i < n; i++) {
+	st->piece[i].start = st->piece[i].pos = i * chunk;
+	st->piece[i].end   = (i == n - 1) ? size - 1 : (i + 1) * chunk - 1;
+	vot_dlQueue (dl, req, i, host);
+    }
+}
+
+
+/*  Finish one range of a chunked download.  A failed range is retried
+**  from where it stopped.
+*/
+static void
+vot_dlPieceDone (dlEngine *dl, dlXfer *x, CURLcode res)
+{
+    dlState *st = x->st;
+    dlPiece *p  = &st->piece[x->piece];
+    char    *err = (char *) NULL;
+
+
+    if (x->norange)
+	err = "range request ignored";
+    else if (res != CURLE_OK)
+	err = (x->errbuf[0] ? x->errbuf : (char *) curl_easy_strerror (res));
+    else if (x->http && x->code != 206) {
+	if (x->code >= 400)
+	    sprintf (x->errbuf, "HTTP error %ld", x->code);
+	else
+	    x->norange = TRUE;
+	err = (x->norange ? "range request ignored" : x->errbuf);
+    } else if (p->pos != p->end + 1) {
+	sprintf (x->errbuf, "short range (%ld of %ld bytes)",
+	    p->pos - p->start, p->end - p->start + 1);
+	err = x->errbuf;
+    }
+
+    if (err && !st->failed) {
+	if (x->norange) {
+	    /*  The server ignored the range, fetch the file whole.
+	    */
+	    st->failed = st->fallback = TRUE;
+
+	} else if (p->ntries < dl->maxtrys) {
+	    vot_dlQueue (dl, x->req, x->piece, x->host);
+	    return;
+
+	} else {
+	    st->failed = TRUE;
+	    strncpy (st->errmsg, err, CURL_ERROR_SIZE - 1);
+	}
+    }
+
+    if (--st->nwait == 0)
+	vot_dlChunkEnd (dl, x->req, x->host);
+}
+
+
+/*  All ranges of a chunked download are finished:  check the file and
+**  rename it, fetch it whole if the ranges couldn't be used, or fail the
+**  request.
+*/
+static void
+vot_dlChunkEnd (dlEngine *dl, int req, dlHost *host)
+{
+    dlReq   *r  = &dl->reqs[req];
+    dlState *st = &dl->state[req];
+    int      whole = FALSE;
+    char    *err = (char *) NULL;
+
+
+    close (st->fd);
+    st->fd = -1;
+
+    if (!st->failed) {
+	if (st->hasmd5 && vot_dlVerify (st->part, st->md5) != OK) {
+	    err = "checksum mismatch";
+	    whole = (r->ntries < dl->maxtrys);
+	} else if (rename (st->part, r->fname) < 0)
+	    err = "cannot rename output file";
+	else
+	    r->nbytes = st->size;
+    } else {
+	whole = st->fallback;
+	err = st->errmsg;
+    }
+
+    if (err)
+	unlink (st->part);
+    free ((void *) st->piece);
+    free ((void *) st->part);
+    st->piece = (dlPiece *) NULL;
+    st->part  = (char *) NULL;
+    st->phase = PH_GET;
+    st->offset = 0;
+
+    if (!err) {
+	r->status = DL_DONE;
+	vot_dlFinish (dl, r, (char *) NULL);
+    } else if (whole) {
+	vot_dlQueue (dl, req, -1, host);
+    } else {
+	r->status = DL_ERROR;
+	vot_dlFinish (dl, r, err);
+    }
+}
+
+
+/*  libcurl socket callback:  note the events to poll for on a socket.
+*/
+static int
+vot_dlSocket (CURL *e, curl_socket_t s, int what, void *data, void *sockp)
+{
+    dlEngine *dl = (dlEngine *) data;
+    int       n;
+
+
+    if (s >= dl->nevents) {
+	n = max(s + 1, dl->nevents * 2);
+	dl->events = (short *) realloc (dl->events, n * sizeof (short));
+	memset (&dl->events[dl->nevents], 0,
+	    (n - dl->nevents) * sizeof (short));
+	dl->nevents = n;
+    }
+
+    switch (what) {
+    case CURL_POLL_IN:		dl->events[s] = POLLIN;			break;
+    case CURL_POLL_OUT:		dl->events[s] = POLLOUT;		break;
+    case CURL_POLL_INOUT:	dl->events[s] = POLLIN | POLLOUT;	break;
+    default:			dl->events[s] = 0;			break;
+    }
+    dl->dirty = TRUE;
+
+    return (0);
+}
+
+
+/*  libcurl timer callback:  save the time libcurl wants to be called
+**  again, or -1 to cancel the timer.
+*/
+static int
+vot_dlTimer (CURLM *multi, long timeout_ms, void *data)
+{
+    ((dlEngine *) data)->deadline = 
+	(timeout_ms < 0 ? -1 : vot_dlClock () + timeout_ms);
+    return (0);
+}
+
+
+/*  Monotonic clock time in msec.
+*/
+static long
+vot_dlClock (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+/*  Write transfer data to the output file, or to its range of a chunked
+**  file.
+*/
+static size_t
+vot_dlWrite (void *ptr, size_t size, size_t nmemb, void *data)
+{
+    dlXfer *x = (dlXfer *) data;
+    size_t  nb = size * nmemb;
+
+
+    if (!x->checked && vot_dlCheck (x) != OK)
+	return (0);				/* abort the transfer	*/
+    if (x->http && x->code >= 400)
+	return (nb);				/* discard error page	*/
+
+    if (x->piece >= 0) {
+	dlPiece *p = &x->st->piece[x->piece];
+
+	if (p->pos + (long) nb > p->end + 1 ||
+	    pwrite (x->st->fd, ptr, nb, (off_t) p->pos) != (ssize_t) nb)
+		return (0);
+	p->pos += (long) nb;
+
+    } else if (!x->fd) {
+	char *buf = realloc (x->r->buf, x->r->nbytes + nb + 1);
+
+	if (!buf)
+	    return (0);
+	memcpy (buf + x->r->nbytes, ptr, nb);
+	buf[x->r->nbytes + nb] = '\0';
+	x->r->buf = buf;
+
+    } else if (fwrite (ptr, 1, nb, x->fd) != nb)
+	return (0);
+
+    x->r->nbytes += (long) nb;
+    return (nb);
+}
+
+
+/*  Check the response code before the first data are written.  A server
+**  that ignores the range of a resumed file sends it all again, so the
+**  file is started over;  a chunk transfer is stopped instead.
+*/
+static int
+vot_dlCheck (dlXfer *x)
+{
+    x->checked = TRUE;
+    if (!x->http)
+	return (OK);
+
+    curl_easy_getinfo (x->curl, CURLINFO_RESPONSE_CODE, &x->code);
+    if (x->code >= 400)
+	return (OK);
+
+    if (x->piece >= 0 && x->code != 206) {
+	x->norange = TRUE;
+	return (ERR);
+
+    } else if (x->piece < 0 && x->offset > 0 && x->code != 206) {
+	if (ftruncate (fileno (x->fd), (off_t) 0) < 0)
+	    return (ERR);
+	rewind (x->fd);
+	x->r->nbytes = x->offset = x->st->offset = 0;
+    }
+    return (OK);
+}
+
+
+/*  Save the size, range and checksum headers of the response.  Each
+**  response of a redirect starts with a new status line.
+*/
+static size_t
+vot_dlHeader (void *ptr, size_t size, size_t nmemb, void *data)
+{
+    dlXfer *x = (dlXfer *) data;
+    size_t  nb = size * nmemb, len = min(nb, SZ_LINE - 1);
+    char    line[SZ_LINE], *v, *ip;
+
+
+    memcpy (line, ptr, len);
+    line[len] = '\0';
+    for (ip=&line[len-1]; len > 0 && ip >= line && isspace(*ip); ip--)
+	*ip = '\0';
+
+    if (strncmp (line, "HTTP/", 5) == 0) {
+	x->hlen = x->htotal = -1;
+	x->hranges = x->hmd5 = 0;
+
+    } else if ((v = vot_dlHdrVal (line, "Content-Length")))
+	x->hlen = atol (v);
+
+    else if ((v = vot_dlHdrVal (line, "Accept-Ranges")))
+	x->hranges = (strncasecmp (v, "bytes", 5) == 0);
+
+    else if ((v = vot_dlHdrVal (line, "Content-Range"))) {
+	if ((ip = strchr (v, '/')) && isdigit (ip[1]))	/* bytes a-b/total */
+	    x->htotal = atol (ip + 1);
+
+    } else if ((v = vot_dlHdrVal (line, "Content-MD5"))) {
+	if (x->hmd5 != 2 && vot_dlBase64 (v, x->md5, 16) == 16)
+	    x->hmd5 = 1;
+
+    } else if ((v = vot_dlHdrVal (line, "Digest"))) {
+	for (ip=v; *ip; ip++) {			/* e.g. "SHA=...,MD5=..." */
+	    if (strncasecmp (ip, "md5=", 4) == 0 && (ip == v || ip[-1] == ',' ||
+		isspace (ip[-1]))) {
+		    if (vot_dlBase64 (ip + 4, x->md5, 16) == 16)
+			x->hmd5 = 2;
+		    break;
+	    }
+	}
+    }
+
+    return (nb);
+}
+
+
+/*  Return the value of a header line with the given name, or NULL.
+*/
+static char *
+vot_dlHdrVal (char *line, char *name)
+{
+    int  len = strlen (name);
+    char *ip;
+
+    if (strncasecmp (line, name, len) != 0 || line[len] != ':')
+	return ((char *) NULL);
+    for (ip=&line[len+1]; *ip && isspace (*ip); ip++)
+	;
+    return (ip);
+}
+
+
+/*  Decode a base64 string, stopping at the first character not in the
+**  alphabet.  Returns the number of bytes decoded.
+*/
+static int
+vot_dlBase64 (char *in, unsigned char *out, int maxout)
+{
+    static char *b64 = 
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned int  acc = 0;
+    int  nbits = 0, nout = 0;
+    char *ip, *cp;
+
+
+    for (ip=in; *ip && (cp = strchr (b64, *ip)); ip++) {
+	acc = (acc << 6) | (unsigned int) (cp - b64);
+	if ((nbits += 6) >= 8) {
+	    nbits -= 8;
+	    if (nout >= maxout)
+		return (-1);
+	    out[nout++] = (unsigned char) ((acc >> nbits) & 0xff);
+	}
+    }
+    return (nout);
+}
+
+
+/*  Compare the MD5 checksum of a file with the one given by the server.
+*/
+static int
+vot_dlVerify (char *fname, unsigned char *md5)
+{
+    unsigned char  digest[16];
+
+    if (vot_dlDigest (fname, digest) != OK)
+	return (ERR);
+    return ((memcmp (digest, md5, 16) == 0) ? OK : ERR);
+}
+
+
+/*  Rebuild the poll list from the socket events.
+*/
+static void
+vot_dlPollList (dlEngine *dl)
+{
+    int  s;
+
+
+    dl->npfd = 0;
+    dl->pfd = (struct pollfd *) realloc (dl->pfd,
+	max(1, dl->nevents) * sizeof (struct pollfd));
+    for (s=0; s < dl->nevents; s++) {
+	if (dl->events[s]) {
+	    dl->pfd[dl->npfd].fd = s;
+	    dl->pfd[dl->npfd].events = dl->events[s];
+	    dl->pfd[dl->npfd].revents = 0;
+	    dl->npfd++;
+	}
+    }
+    dl->dirty = FALSE;
+}
+
+
+
+/************************************************************************
+**  MD5 message digest (RFC 1321), used to check downloaded files.
+*/
+
+#define MD5_F(x,y,z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x,y,z)	((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x,y,z)	((x) ^ (y) ^ (z))
+#define MD5_I(x,y,z)	((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f,a,b,c,d,x,t,s) \
+	(a) += f((b),(c),(d)) + (x) + (t); \
+	(a) = (((a) << (s)) | (((a) & 0xffffffff) >> (32 - (s)))); \
+	(a) += (b);
+
+static void
+vot_md5Init (dlMD5 *m)
+{
+    m->a = 0x67452301;  m->b = 0xefcdab89;
+    m->c = 0x98badcfe;  m->d = 0x10325476;
+    m->lo = m->hi = 0;
+}
+
+
+static void
+vot_md5Update (dlMD5 *m, unsigned char *data, size_t len)
+{
+    unsigned int  used = m->lo & 0x3f, avail, saved = m->lo;
+
+
+    if ((m->lo = (saved + (unsigned int) len) & 0x1fffffff) < saved)
+	m->hi++;					/* byte count carry */
+    m->hi += (unsigned int) ((unsigned long) len >> 29);
+
+    if (used) {
+	avail = 64 - used;
+	if (len < avail) {
+	    memcpy (&m->buf[used], data, len);
+	    return;
+	}
+	memcpy (&m->buf[used], data, avail);
+	data += avail;
+	len  -= avail;
+	vot_md5Block (m, m->buf);
+    }
+    for ( ; len >= 64; data += 64, len -= 64)
+	vot_md5Block (m, data);
+    memcpy (m->buf, data, len);
+}
+
+
+static void
+vot_md5Final (dlMD5 *m, unsigned char *digest)
+{
+    unsigned int  used = m->lo & 0x3f, avail, v[4];
+    int  i;
+
+
+    m->buf[used++] = 0x80;
+    if ((avail = 64 - used) < 8) {
+	memset (&m->buf[used], 0, avail);
+	vot_md5Block (m, m->buf);
+	used = 0;
+	avail = 64;
+    }
+    memset (&m->buf[used], 0, avail - 8);
+
+    m->lo <<= 3;				/* length in bits	*/
+    for (i=0; i < 4; i++) {
+	m->buf[56+i] = (unsigned char) (m->lo >> (8 * i));
+	m->buf[60+i] = (unsigned char) (m->hi >> (8 * i));
+    }
+    vot_md5Block (m, m->buf);
+
+    v[0] = m->a;  v[1] = m->b;  v[2] = m->c;  v[3] = m->d;
+    for (i=0; i < 16; i++)
+	digest[i] = (unsigned char) (v[i/4] >> (8 * (i % 4)));
+}
+
+
+static void
+vot_md5Block (dlMD5 *m, unsigned char *p)
+{
+    unsigned int  a = m->a, b = m->b, c = m->c, d = m->d, x[16];
+    int  i;
+
+
+    for (i=0; i < 16; i++)
+	x[i] = (unsigned int) p[4*i] | ((unsigned int) p[4*i+1] << 8) |
+	    ((unsigned int) p[4*i+2] << 16) | ((unsigned int) p[4*i+3] << 24);
+
+    MD5_STEP(MD5_F, a, b, c, d, x[ 0], 0xd76aa478,  7)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 1], 0xe8c7b756, 12)
+    MD5_STEP(MD5_F, c, d, a, b, x[ 2], 0x242070db, 17)
+    MD5_STEP(MD5_F, b, c, d, a, x[ 3], 0xc1bdceee, 22)
+    MD5_STEP(MD5_F, a, b, c, d, x[ 4], 0xf57c0faf,  7)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 5], 0x4787c62a, 12)
+    MD5_STEP(MD5_F, c, d, a, b, x[ 6], 0xa8304613, 17)
+    MD5_STEP(MD5_F, b, c, d, a, x[ 7], 0xfd469501, 22)
+    MD5_STEP(MD5_F, a, b, c, d, x[ 8], 0x698098d8,  7)
+    MD5_STEP(MD5_F, d, a, b, c, x[ 9], 0x8b44f7af, 12)
+    MD5_STEP(MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17)
+    MD5_STEP(MD5_F, b, c, d, a, x[11], 0x895cd7be, 22)
+    MD5_STEP(MD5_F, a, b, c, d, x[12], 0x6b901122,  7)
+    MD5_STEP(MD5_F, d, a, b, c, x[13], 0xfd987193, 12)
+    MD5_STEP(MD5_F, c, d, a, b, x[14], 0xa679438e, 17)
+    MD5_STEP(MD5_F, b, c, d, a, x[15], 0x49b40821, 22)
+
+    MD5_STEP(MD5_G, a, b, c, d, x[ 1], 0xf61e2562,  5)
+    MD5_STEP(MD5_G, d, a, b, c, x[ 6], 0xc040b340,  9)
+    MD5_STEP(MD5_G, c, d, a, b, x[11], 0x265e5a51, 14)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 0], 0xe9b6c7aa, 20)
+    MD5_STEP(MD5_G, a, b, c, d, x[ 5], 0xd62f105d,  5)
+    MD5_STEP(MD5_G, d, a, b, c, x[10], 0x02441453,  9)
+    MD5_STEP(MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 4], 0xe7d3fbc8, 20)
+    MD5_STEP(MD5_G, a, b, c, d, x[ 9], 0x21e1cde6,  5)
+    MD5_STEP(MD5_G, d, a, b, c, x[14], 0xc33707d6,  9)
+    MD5_STEP(MD5_G, c, d, a, b, x[ 3], 0xf4d50d87, 14)
+    MD5_STEP(MD5_G, b, c, d, a, x[ 8], 0x455a14ed, 20)
+    MD5_STEP(MD5_G, a, b, c, d, x[13], 0xa9e3e905,  5)
+    MD5_STEP(MD5_G, d, a, b, c, x[ 2], 0xfcefa3f8,  9)
+    MD5_STEP(MD5_G, c, d, a, b, x[ 7], 0x676f02d9, 14)
+    MD5_STEP(MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+    MD5_STEP(MD5_H, a, b, c, d, x[ 5], 0xfffa3942,  4)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 8], 0x8771f681, 11)
+    MD5_STEP(MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16)
+    MD5_STEP(MD5_H, b, c, d, a, x[14], 0xfde5380c, 23)
+    MD5_STEP(MD5_H, a, b, c, d, x[ 1], 0xa4beea44,  4)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 4], 0x4bdecfa9, 11)
+    MD5_STEP(MD5_H, c, d, a, b, x[ 7], 0xf6bb4b60, 16)
+    MD5_STEP(MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23)
+    MD5_STEP(MD5_H, a, b, c, d, x[13], 0x289b7ec6,  4)
+    MD5_STEP(MD5_H, d, a, b, c, x[ 0], 0xeaa127fa, 11)
+    MD5_STEP(MD5_H, c, d, a, b, x[ 3], 0xd4ef3085, 16)
+    MD5_STEP(MD5_H, b, c, d, a, x[ 6], 0x04881d05, 23)
+    MD5_STEP(MD5_H, a, b, c, d, x[ 9], 0xd9d4d039,  4)
+    MD5_STEP(MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11)
+    MD5_STEP(MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16)
+    MD5_STEP(MD5_H, b, c, d, a, x[ 2], 0xc4ac5665, 23)
+
+    MD5_STEP(MD5_I, a, b, c, d, x[ 0], 0xf4292244,  6)
+    MD5_STEP(MD5_I, d, a, b, c, x[ 7], 0x432aff97, 10)
+    MD5_STEP(MD5_I, c, d, a, b, x[14], 0xab9423a7, 15)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 5], 0xfc93a039, 21)
+    MD5_STEP(MD5_I, a, b, c, d, x[12], 0x655b59c3,  6)
+    MD5_STEP(MD5_I, d, a, b, c, x[ 3], 0x8f0ccc92, 10)
+    MD5_STEP(MD5_I, c, d, a, b, x[10], 0xffeff47d, 15)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 1], 0x85845dd1, 21)
+    MD5_STEP(MD5_I, a, b, c, d, x[ 8], 0x6fa87e4f,  6)
+    MD5_STEP(MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+    MD5_STEP(MD5_I, c, d, a, b, x[ 6], 0xa3014314, 15)
+    MD5_STEP(MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21)
+    MD5_STEP(MD5_I, a, b, c, d, x[ 4], 0xf7537e82,  6)
+    MD5_STEP(MD5_I, d, a, b, c, x[11], 0xbd3af235, 10)
+    MD5_STEP(MD5_I, c, d, a, b, x[ 2], 0x2ad7d2bb, 15)
+    MD5_STEP(MD5_I, b, c, d, a, x[ 9], 0xeb86d391, 21)
+
+    m->a += a;  m->b += b;  m->c += c;  m->d += d;
+}
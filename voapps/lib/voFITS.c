@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "voApps.h"
 #include "fitsio.h"
 
@@ -20,6 +21,12 @@ static  int  vot_getFrameWcs (fitsfile *fptr, frameInfo *info);
 extern  int  vot_fileType (char *name);
 
 
+/*  CFITSIO isn't built reentrant, so images it opens are read one at a
+ *  time when vot_imageInfo() is called from several threads.
+ */
+static pthread_mutex_t fits_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
 
 
 /**
@@ -40,7 +47,6 @@ vot_imageInfo (char *name, int do_all)
     long      naxes[3] = {0, 0, 0}, nrows=0;
     int	      nextns=0, naxis=0, bitpix=0, extnum=0;
     int       hdupos=0, hdutype=0, ncols=0, i=0, status=0;
-    double    cxsum=0.0, cysum=0.0, rxsum=0.0, rysum=0.0;
 
 
     /*  Check for file existence.
@@ -49,11 +55,18 @@ vot_imageInfo (char *name, int do_all)
 	fprintf (stderr, "Error: cannot open image '%s'\n", name);
 	return ((ImInfo *) NULL);
     }
+
+    /*  Plain FITS files are read directly from their header blocks, the
+     *  rest (compressed images, non-standard files) go through CFITSIO.
+     */
+    if ((info = vot_imageInfoMap (name)))
+	return (info);
     if (vot_fileType (name) != VOT_FITS) {
 	fprintf (stderr, "Error: file '%s' is not a FITS image\n", name);
 	return ((ImInfo *) NULL);
     }
 
+    pthread_mutex_lock (&fits_mutex);
     info = (ImInfo *) calloc (1, sizeof (ImInfo));
     if (fits_open_file (&fptr, name, READONLY, &status) == 0) {
 	fits_get_num_hdus (fptr, &nextns, &status);
@@ -131,6 +144,32 @@ vot_imageInfo (char *name, int do_all)
         fits_report_error (stderr, status);
 
 
+    vot_imageFrame (info, nextns, naxis);
+
+    fits_close_file (fptr, &status);
+    pthread_mutex_unlock (&fits_mutex);
+    return ( (ImInfo *) info);
+}
+
+
+/**
+ *  VOT_IMAGEFRAME -- Compute the full-frame values from the extensions.
+ *
+ *  @fn      vot_imageFrame (ImInfo *info, int nextns, int naxis)
+ *
+ *  @brief            Compute the full-frame values from the extensions.
+ *  @param   info     image information with the extensions filled in
+ *  @param   nextns   number of HDUs in the file
+ *  @param   naxis    NAXIS of the last image HDU
+ *  @return           nothing
+ */
+void
+vot_imageFrame (ImInfo *info, int nextns, int naxis)
+{
+    double    cxsum=0.0, cysum=0.0, rxsum=0.0, rysum=0.0;
+    int       i;
+
+
     /*  Compute the values for the entire frame.
      */
     info->frame.lx = info->frame.ly =  360.0;
@@ -203,13 +242,10 @@ vot_imageInfo (char *name, int do_all)
     info->frame.xc[1]  = info->frame.lx;   info->frame.yc[1] = info->frame.uy;
     info->frame.xc[2]  = info->frame.ux;   info->frame.yc[2] = info->frame.uy;
     info->frame.xc[3]  = info->frame.ux;   info->frame.yc[3] = info->frame.ly;
-
-
-    fits_close_file (fptr, &status);
-    return ( (ImInfo *) info);
 }
 
 
+
 /**
  *  VOT_IMAGENEXTNS -- Get the number of extensions in an MEF file.
  *
@@ -316,19 +352,73 @@ vot_printFrameInfo (FILE *fd, frameInfo *im)
  */
 static int  
 vot_getFrameWcs (fitsfile *fptr, frameInfo *info)
+{
+    wcsKeys  kw;
+    int      status = 0;
+    char     comment[80];
+
+
+    /*  Get the header WCS keywords.
+     */
+    memset (&kw, 0, sizeof (wcsKeys));
+    fits_read_img_coord (fptr, &kw.xrval, &kw.yrval, &kw.xrpix,
+               &kw.yrpix, &kw.xinc, &kw.yinc, &kw.rot, kw.proj, &status);
+
+    status = 0;
+    if (fits_read_key_dbl (fptr, "CD1_1", &kw.cd11, comment, &status) == 0) {
+	kw.has_cd = 1;
+        fits_read_key_dbl (fptr, "CD1_2", &kw.cd12, comment, &status);
+        fits_read_key_dbl (fptr, "CD2_1", &kw.cd21, comment, &status);
+        fits_read_key_dbl (fptr, "CD2_2", &kw.cd22, comment, &status);
+    } else {
+	status = 0;
+        if (!fits_read_key_dbl (fptr, "CDELT1", &kw.cdelt1, comment, &status)) {
+	    kw.has_cdelt = 1;
+            fits_read_key_dbl (fptr, "CDELT2", &kw.cdelt2, comment, &status);
+            if (!fits_read_key_dbl (fptr, "CROTA1", &kw.crota1, comment,
+		&status)) {
+		    kw.has_crota = 1;
+                    fits_read_key_dbl (fptr, "CROTA2", &kw.crota2, comment,
+			&status);
+	    }
+	}
+    }
+
+    status = 0;
+    if (fits_read_key_str (fptr, "CTYPE1", kw.ctype1, comment, &status))
+	kw.ctype1[0] = '\0';
+
+    return (vot_frameWcs (info, &kw));
+}
+
+
+/**
+ *  VOT_FRAMEWCS -- Compute the WCS information for a frame from its header
+ *  keywords.
+ *
+ *  @fn      has_wcs = vot_frameWcs (frameInfo *info, wcsKeys *kw)
+ *
+ *  @brief            Compute the WCS information for a frame.
+ *  @param   info     frame information, the NAXISn values set
+ *  @param   kw       WCS keyword values
+ *  @return           1 if the frame has a WCS
+ */
+int
+vot_frameWcs (frameInfo *info, wcsKeys *kw)
 {
     double   xrval=0.0, yrval=0.0, xrpix=0.0, yrpix=0.0, xpix=0.0, ypix=0.0;
     double   xinc=0.0, yinc=0.0, rot=0.0, scale=0.0, xrot=0.0, yrot=0.0;
     double   cx=0.0, cy=0.0, lx=0.0, ly=0.0, ux=0.0, uy=0.0;
     double   cd11=0.0, cd12=0.0, cd21=0.0, cd22=0.0, cdelt1=0.0, cdelt2=0.0;
-    int      i, axflip=0, status = 0;
-    char     str[32], ctype[5], comment[80];
+    int      axflip=0, status = 0;
+    char     ctype[5];
 
 
-    /*  Get the header WCS keywords.
-     */
-    fits_read_img_coord (fptr, &xrval, &yrval, &xrpix,
-               &yrpix, &xinc, &yinc, &rot, ctype, &status);
+    xrval = kw->xrval;  yrval = kw->yrval;
+    xrpix = kw->xrpix;  yrpix = kw->yrpix;
+    xinc  = kw->xinc;   yinc  = kw->yinc;
+    rot   = kw->rot;
+    strncpy (ctype, kw->proj, 4);  ctype[4] = '\0';
 
     info->xrval    = xrval;
     info->yrval    = yrval;
@@ -378,11 +468,9 @@ vot_getFrameWcs (fitsfile *fptr, frameInfo *info)
     uy = info->uy = info->yc[2];
     cx = info->cx;
     cy = info->cy;
-    status = 0;
-    if ((i = fits_read_key_dbl(fptr, "CD1_1", &cd11, comment, &status))==0) {
-        fits_read_key_dbl (fptr, "CD1_2", &cd12, comment, &status);
-        fits_read_key_dbl (fptr, "CD2_1", &cd21, comment, &status);
-        fits_read_key_dbl (fptr, "CD2_2", &cd22, comment, &status);
+    if (kw->has_cd) {
+	cd11 = kw->cd11;  cd12 = kw->cd12;
+	cd21 = kw->cd21;  cd22 = kw->cd22;
 
         scale = 3600.0 * sqrt ((cd11*cd11+cd21*cd21+cd12*cd12+cd22*cd22) / 2.);
 	xrot  = dabs (atan2 ( cd21, cd11));
@@ -391,26 +479,24 @@ vot_getFrameWcs (fitsfile *fptr, frameInfo *info)
     } else {
 	/*  Old-style keywords.
 	 */
-	status = 0;
-        if (!fits_read_key_dbl (fptr, "CDELT1", &cdelt1, comment, &status)) {
-             fits_read_key_dbl (fptr, "CDELT2", &cdelt2, comment, &status);
+        if (kw->has_cdelt) {
+	    cdelt1 = kw->cdelt1;
+	    cdelt2 = kw->cdelt2;
 
 	    scale = 3600.0 * sqrt ((cdelt1*cdelt1 + cdelt2*cdelt2) / 2.);
 
-            if (!fits_read_key_dbl (fptr, "CROTA1", &xrot, comment, &status)) {
-                 fits_read_key_dbl (fptr, "CROTA2", &yrot, comment, &status);
-		     rot   = (xrot + yrot) / 2.0;
+            if (kw->has_crota) {
+		xrot = kw->crota1;
+		yrot = kw->crota2;
+		rot  = (xrot + yrot) / 2.0;
             }
         } else
 	    info->has_wcs  = 0;
     }
 
-    status = 0;
-    memset (str, 0, 32);
-    if ((i = fits_read_key_str(fptr, "CTYPE1", str, comment, &status))==0) {
-	if (strncasecmp (str,"DEC",3) == 0 || strncasecmp (str,"LAT",3) == 0)
+    if (strncasecmp (kw->ctype1,"DEC",3) == 0 || 
+	strncasecmp (kw->ctype1,"LAT",3) == 0)
 	    axflip = 1;
-    }
 
     /*  For a bad/approximate WCS, compute in rough coords.
      */
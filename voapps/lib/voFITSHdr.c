@@ -0,0 +1,610 @@
+/************************************************************************
+**  VOFITSHDR.C -- Fast FITS header scanning of many images.
+**
+**  vot_imageInfoMap() gets the same ImInfo as vot_imageInfo() without
+**  going through CFITSIO:  the file is mapped and only its 2880-byte header
+**  blocks are read, the size of each data unit being computed from the
+**  BITPIX, NAXISn, PCOUNT and GCOUNT keywords so the data are skipped
+**  without ever being paged in.  Files it can't read this way (compressed
+**  images, gzip'd or non-standard files) return NULL and are left to
+**  CFITSIO.
+**
+**  vot_imageInfoList() reads a list of images on a pool of threads.  With
+**  'use_cache' set the results are also kept in the header cache, the
+**  single file 'fitshdr.db' in the 'fitshdr' subdirectory of the VOClient
+**  cache (see voc_getCacheDir()), keyed by the image path, mtime and size
+**  so a changed image is simply read again.  It is a hashed append-log
+**  (see voHashLog.c) tagged with sizeof(frameInfo), whose records are
+**
+**	"<path>\t<mtime>\t<size>\0", nextns, frame, extns
+**
+**  VOC_NO_CACHE in the environment disables the cache.
+**
+**	    info  = vot_imageInfoMap (name)
+**	    nread = vot_imageInfoList (names, nimages, nthreads, use_cache, info)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+extern int   debug;
+
+
+#define	FITS_BLOCK	2880		/* FITS logical record size	*/
+#define	FITS_CARD	80		/* header card size		*/
+
+#define	HDR_MAGIC	"VOFITDB1"
+#define	HDR_NBUCKETS	262144		/* index size			*/
+#define	HDR_MAXREC	16777216	/* max record size		*/
+
+typedef struct {
+    char    *cards;			/* first card of the header	*/
+    int      ncards;			/* number of cards before END	*/
+} fitsHdr;
+
+typedef struct {
+    char   **names;			/* images to read		*/
+    ImInfo **info;			/* results			*/
+    int      nimages;			/* number of images		*/
+    int      next;			/* next image to read		*/
+    int      cfd;			/* header cache, or -1		*/
+    pthread_mutex_t lock;
+} hdrPool;
+
+
+ImInfo *vot_imageInfoMap (char *name);
+int     vot_imageInfoList (char **names, int nimages, int nthreads,
+		int use_cache, ImInfo **info);
+
+static void     vot_hdrWorker (void *data, int k);
+static ImInfo  *vot_hdrRead (hdrPool *pool, char *name);
+static char    *vot_hdrCard (fitsHdr *h, char *key);
+static int      vot_hdrValue (fitsHdr *h, char *key, char *val);
+static int      vot_hdrDbl (fitsHdr *h, char *key, double *dval);
+static int      vot_hdrLong (fitsHdr *h, char *key, long *lval);
+static int      vot_hdrBool (fitsHdr *h, char *key);
+static void     vot_hdrWcs (fitsHdr *h, wcsKeys *kw);
+static double   vot_hdrRot (double m11, double m12, double m21, double m22);
+static char    *vot_hdrKey (char *name, char *key);
+static ImInfo  *vot_hdrLookup (int fd, char *key);
+static void     vot_hdrStore (int fd, char *key, ImInfo *info);
+
+
+
+/************************************************************************
+**  VOT_IMAGEINFOMAP -- Get information about a FITS file structure and
+**  WCS from its header blocks.  Returns NULL if the file isn't a plain
+**  FITS file, without an error message.
+*/
+ImInfo *
+vot_imageInfoMap (char *name)
+{
+    ImInfo    *info = (ImInfo *) NULL;
+    frameInfo *ext, *extns = (frameInfo *) NULL;
+    fitsHdr    hdr;
+    wcsKeys    kw;
+    struct stat st;
+    char      *map, *cp, *end, key[FITS_CARD], val[FITS_CARD];
+    long       off = 0, dlen, npix, n, bitpix, naxis, pcount, gcount;
+    int        fd, nextns = 0, nalloc = 0, last_naxis = 0, i;
+
+
+    if ((fd = open (name, O_RDONLY)) < 0)
+	return ((ImInfo *) NULL);
+    if (fstat (fd, &st) < 0 || st.st_size < FITS_BLOCK) {
+	close (fd);
+	return ((ImInfo *) NULL);
+    }
+    map = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+	return ((ImInfo *) NULL);
+    (void) madvise (map, (size_t) st.st_size, MADV_RANDOM);
+    end = map + st.st_size;
+
+    if (strncmp (map, "SIMPLE  =", 9) != 0)
+	goto fail;
+
+    while (off + FITS_BLOCK <= (long) st.st_size) {
+	if (nextns > 0 && strncmp (&map[off], "XTENSION=", 9) != 0)
+	    break;			/* fill after the last HDU	*/
+
+	/*  Find the END card.  A truncated header is left to CFITSIO.
+	*/
+	hdr.cards = &map[off];
+	for (hdr.ncards=0, cp=hdr.cards; cp + FITS_CARD <= end;
+	    cp += FITS_CARD, hdr.ncards++)
+		if (strncmp (cp, "END     ", 8) == 0)
+		    break;
+	if (cp + FITS_CARD > end)
+	    goto fail;
+	off += ((long) (hdr.ncards + 1) * FITS_CARD + FITS_BLOCK - 1) /
+	    FITS_BLOCK * FITS_BLOCK;
+
+	/*  Get the size of the data unit.  Tile-compressed images are
+	**  binary tables to us but images to CFITSIO.
+	*/
+	if (vot_hdrBool (&hdr, "ZIMAGE"))
+	    goto fail;
+	if (vot_hdrLong (&hdr, "BITPIX", &bitpix) != OK ||
+	    vot_hdrLong (&hdr, "NAXIS", &naxis) != OK || naxis < 0 ||
+	    naxis > 999)
+		goto fail;
+	if (vot_hdrLong (&hdr, "PCOUNT", &pcount) != OK)
+	    pcount = 0;
+	if (vot_hdrLong (&hdr, "GCOUNT", &gcount) != OK)
+	    gcount = 1;
+
+	if (nextns == nalloc) {
+	    nalloc += 16;
+	    extns = (frameInfo *) realloc (extns, nalloc * sizeof (frameInfo));
+	}
+	ext = &extns[nextns];
+	memset (ext, 0, sizeof (frameInfo));
+
+	for (i=1, npix=(naxis > 0); i <= naxis; i++) {
+	    sprintf (key, "NAXIS%d", i);
+	    if (vot_hdrLong (&hdr, key, &n) != OK || n < 0)
+		goto fail;
+	    if (i <= 3)
+		ext->naxes[i-1] = (int) n;
+	    if (i == 1 && n == 0 && nextns == 0 && vot_hdrBool (&hdr,"GROUPS"))
+		continue;		/* random groups		*/
+	    npix *= n;
+	}
+	dlen = (labs (bitpix) / 8) * gcount * (pcount + npix);
+	off += (dlen + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+
+	/*  Fill in the extension as vot_imageInfo() does.
+	*/
+	if (nextns > 0 && vot_hdrValue (&hdr, "XTENSION", val) != OK)
+	    goto fail;
+	if (nextns == 0 || strcmp (val, "IMAGE") == 0) {
+	    ext->is_image = 1;
+	    ext->extnum   = nextns;
+	    ext->naxis    = (int) naxis;
+	    ext->bitpix   = (int) bitpix;
+
+	    vot_hdrWcs (&hdr, &kw);
+	    if (vot_frameWcs (ext, &kw) == 0)
+		ext->has_wcs = 1;
+	    last_naxis = (int) naxis;
+
+	} else if (strcmp (val, "BINTABLE") == 0 || strcmp (val, "TABLE") == 0) {
+	    if (vot_hdrLong (&hdr, "TFIELDS", &n) != OK)
+		goto fail;
+	    ext->is_table = 1;
+	    ext->naxis    = 2;
+	    ext->naxes[0] = (int) n;		/* NAXIS2 is the rows	*/
+	    ext->naxes[2] = 0;
+
+	} else
+	    goto fail;			/* not a standard extension	*/
+
+	nextns++;
+    }
+    if (nextns == 0)
+	goto fail;
+
+    info = (ImInfo *) calloc (1, sizeof (ImInfo));
+    strncpy (info->imname, name, SZ_PATH - 1);
+    info->nextend = (nextns - 1);
+    info->extns   = extns;
+    vot_imageFrame (info, nextns, last_naxis);
+
+    munmap (map, (size_t) st.st_size);
+    return (info);
+
+fail:
+    if (debug)
+	fprintf (stderr, "imageInfoMap: '%s' left to CFITSIO\n", name);
+    if (extns)
+	free ((void *) extns);
+    munmap (map, (size_t) st.st_size);
+    return ((ImInfo *) NULL);
+}
+
+
+/************************************************************************
+**  VOT_IMAGEINFOLIST -- Get the information of a list of images on a pool
+**  of 'nthreads' threads (the number of CPUs if zero).  info[i] is set to
+**  the ImInfo of names[i], or NULL if it can't be read.  Returns the
+**  number of images read.
+*/
+int
+vot_imageInfoList (char **names, int nimages, int nthreads, int use_cache,
+		    ImInfo **info)
+{
+    hdrPool    pool;
+    voPool    *workers;
+    int        i, nread = 0;
+
+
+    if (nimages <= 0)
+	return (0);
+    if (nthreads <= 0)
+	nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    if (nthreads > nimages)
+	nthreads = nimages;
+
+    memset (&pool, 0, sizeof (hdrPool));
+    pool.names   = names;
+    pool.info    = info;
+    pool.nimages = nimages;
+    pool.cfd     = (use_cache ? vot_hlogOpen ("fitshdr", "fitshdr.db",
+			HDR_MAGIC, HDR_NBUCKETS, (int) sizeof (frameInfo),
+			TRUE) : -1);
+    pthread_mutex_init (&pool.lock, NULL);
+
+    workers = vot_poolCreate (nthreads);
+    vot_poolRun (workers, vot_hdrWorker, (void *) &pool);
+    vot_poolFree (workers);
+
+    if (pool.cfd >= 0)
+	close (pool.cfd);
+    pthread_mutex_destroy (&pool.lock);
+
+    for (i=0; i < nimages; i++)
+	nread += (info[i] != (ImInfo *) NULL);
+    return (nread);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Pool worker:  read images until the list is done.
+*/
+static void
+vot_hdrWorker (void *data, int k)
+{
+    hdrPool *pool = (hdrPool *) data;
+    int      i;
+
+
+    for ( ; ; ) {
+	pthread_mutex_lock (&pool->lock);
+	i = pool->next++;
+	pthread_mutex_unlock (&pool->lock);
+
+	if (i >= pool->nimages)
+	    break;
+	pool->info[i] = vot_hdrRead (pool, pool->names[i]);
+    }
+}
+
+
+/*  Read one image, through the cache if there is one.
+*/
+static ImInfo *
+vot_hdrRead (hdrPool *pool, char *name)
+{
+    ImInfo  *info;
+    char     key[PATH_MAX + 64];
+
+
+    if (pool->cfd >= 0 && vot_hdrKey (name, key)) {
+	if ((info = vot_hdrLookup (pool->cfd, key))) {
+	    strncpy (info->imname, name, SZ_PATH - 1);
+	    return (info);
+	}
+	if ((info = vot_imageInfo (name, 1))) {
+	    pthread_mutex_lock (&pool->lock);	/* flock() is per file	*/
+	    vot_hdrStore (pool->cfd, key, info);
+	    pthread_mutex_unlock (&pool->lock);
+	}
+	return (info);
+    }
+
+    return (vot_imageInfo (name, 1));
+}
+
+
+/*  Find the card of a keyword with a value.
+*/
+static char *
+vot_hdrCard (fitsHdr *h, char *key)
+{
+    char  kname[8], *cp;
+    int   len = strlen (key), i;
+
+
+    if (len > 8)
+	return ((char *) NULL);
+    memset (kname, ' ', 8);
+    memcpy (kname, key, len);
+
+    for (i=0, cp=h->cards; i < h->ncards; i++, cp += FITS_CARD)
+	if (memcmp (cp, kname, 8) == 0 && cp[8] == '=')
+	    return (cp);
+    return ((char *) NULL);
+}
+
+
+/*  Get the value of a keyword as a string:  quotes are removed from a
+**  string value, the comment from any other, and trailing blanks from
+**  both.  'val' must hold FITS_CARD chars.
+*/
+static int
+vot_hdrValue (fitsHdr *h, char *key, char *val)
+{
+    char  *cp, *end, *op = val;
+
+
+    memset (val, 0, FITS_CARD);
+    if (!(cp = vot_hdrCard (h, key)))
+	return (ERR);
+    end = cp + FITS_CARD;
+
+    for (cp += 9; cp < end && *cp == ' '; cp++)
+	;
+    if (cp < end && *cp == '\'') {
+	for (cp++; cp < end; cp++) {
+	    if (*cp == '\'') {
+		if (cp + 1 < end && cp[1] == '\'')
+		    cp++;		/* quoted quote			*/
+		else
+		    break;
+	    }
+	    *op++ = *cp;
+	}
+    } else {
+	for ( ; cp < end && *cp != '/'; cp++)
+	    *op++ = *cp;
+    }
+    while (op > val && op[-1] == ' ')
+	*--op = '\0';
+
+    return (op > val ? OK : ERR);
+}
+
+
+/*  Get the value of a numeric keyword.
+*/
+static int
+vot_hdrDbl (fitsHdr *h, char *key, double *dval)
+{
+    char    val[FITS_CARD], *ip, *ep;
+    double  d;
+
+
+    if (vot_hdrValue (h, key, val) != OK)
+	return (ERR);
+    for (ip=val; *ip; ip++)
+	if (*ip == 'D' || *ip == 'd')
+	    *ip = 'E';			/* Fortran double exponent	*/
+
+    d = strtod (val, &ep);
+    if (ep == val || *ep)
+	return (ERR);
+    *dval = d;
+    return (OK);
+}
+
+static int
+vot_hdrLong (fitsHdr *h, char *key, long *lval)
+{
+    double  d;
+
+    if (vot_hdrDbl (h, key, &d) != OK)
+	return (ERR);
+    *lval = (long) d;
+    return (OK);
+}
+
+static int
+vot_hdrBool (fitsHdr *h, char *key)
+{
+    char  val[FITS_CARD];
+
+    return (vot_hdrValue (h, key, val) == OK && val[0] == 'T');
+}
+
+
+/*  Get the WCS keywords of an image header.  The fits_read_img_coord()
+**  values are computed the way CFITSIO does (see ffgics()).
+*/
+static void
+vot_hdrWcs (fitsHdr *h, wcsKeys *kw)
+{
+    double  cd11=0.0, cd12=0.0, cd21=0.0, cd22=0.0, phia, temp;
+    double  pc11=1.0, pc12=0.0, pc21=0.0, pc22=1.0;
+    int     cd_exists = 0, pc_exists = 0;
+    char    ctype[FITS_CARD];
+
+
+    memset (kw, 0, sizeof (wcsKeys));
+    if (vot_hdrDbl (h, "CRVAL1", &kw->xrval) != OK)  kw->xrval = 0.0;
+    if (vot_hdrDbl (h, "CRVAL2", &kw->yrval) != OK)  kw->yrval = 0.0;
+    if (vot_hdrDbl (h, "CRPIX1", &kw->xrpix) != OK)  kw->xrpix = 0.0;
+    if (vot_hdrDbl (h, "CRPIX2", &kw->yrpix) != OK)  kw->yrpix = 0.0;
+
+    if (vot_hdrDbl (h, "CDELT1", &kw->xinc) != OK) {
+	/*  No CDELTn, convert a CD matrix back to CDELTn and a rotation.
+	*/
+	cd_exists |= (vot_hdrDbl (h, "CD1_1", &cd11) == OK);
+	cd_exists |= (vot_hdrDbl (h, "CD2_1", &cd21) == OK);
+	cd_exists |= (vot_hdrDbl (h, "CD1_2", &cd12) == OK);
+	cd_exists |= (vot_hdrDbl (h, "CD2_2", &cd22) == OK);
+
+	if (cd_exists) {
+	    phia = vot_hdrRot (cd11, cd12, cd21, cd22);
+	    kw->xinc = cd11 / cos (phia);
+	    kw->yinc = cd22 / cos (phia);
+	    kw->rot  = phia * 180. / M_PI;
+	    if (kw->yinc < 0) {
+		kw->xinc = -kw->xinc;
+		kw->yinc = -kw->yinc;
+		kw->rot  = kw->rot - 180.;
+	    }
+	} else {
+	    kw->xinc = 1.0;
+	    if (vot_hdrDbl (h, "CDELT2", &kw->yinc) != OK)  kw->yinc = 1.0;
+	    if (vot_hdrDbl (h, "CROTA2", &kw->rot) != OK)   kw->rot  = 0.0;
+	}
+
+    } else {
+	/*  CDELTn and a CROTA2 or PC matrix.
+	*/
+	if (vot_hdrDbl (h, "CDELT2", &kw->yinc) != OK)  kw->yinc = 1.0;
+	if (vot_hdrDbl (h, "CROTA2", &kw->rot) != OK) {
+	    kw->rot = 0.0;
+	    pc_exists |= (vot_hdrDbl (h, "PC1_1", &pc11) == OK);
+	    pc_exists |= (vot_hdrDbl (h, "PC2_1", &pc21) == OK);
+	    pc_exists |= (vot_hdrDbl (h, "PC1_2", &pc12) == OK);
+	    pc_exists |= (vot_hdrDbl (h, "PC2_2", &pc22) == OK);
+	    if (pc_exists)
+		kw->rot = vot_hdrRot (pc11, pc12, pc21, pc22) * 180. / M_PI;
+	}
+    }
+
+    /*  Get the projection type, swapping the axes if the latitude is first.
+    */
+    if (vot_hdrValue (h, "CTYPE1", ctype) == OK) {
+	strncpy (kw->proj, &ctype[4], 4);
+	strncpy (kw->ctype1, ctype, sizeof (kw->ctype1) - 1);
+
+	if (!strncmp (ctype, "DEC-", 4) || !strncmp (ctype+1, "LAT", 3)) {
+	    kw->rot  = 90. - kw->rot;
+	    kw->yinc = -kw->yinc;
+	    temp = kw->xrval;
+	    kw->xrval = kw->yrval;
+	    kw->yrval = temp;
+	}
+    }
+
+    /*  The keywords vot_frameWcs() reads itself.
+    */
+    if (vot_hdrDbl (h, "CD1_1", &kw->cd11) == OK) {
+	kw->has_cd = 1;
+	if (vot_hdrDbl (h, "CD1_2", &kw->cd12) == OK &&
+	    vot_hdrDbl (h, "CD2_1", &kw->cd21) == OK)
+		(void) vot_hdrDbl (h, "CD2_2", &kw->cd22);
+
+    } else if (vot_hdrDbl (h, "CDELT1", &kw->cdelt1) == OK) {
+	kw->has_cdelt = 1;
+	if (vot_hdrDbl (h, "CDELT2", &kw->cdelt2) == OK &&
+	    vot_hdrDbl (h, "CROTA1", &kw->crota1) == OK) {
+		kw->has_crota = 1;
+		(void) vot_hdrDbl (h, "CROTA2", &kw->crota2);
+	}
+    }
+}
+
+
+/*  Rotation angle (radians) of a CD or PC matrix, averaging the angles of
+**  the two axes as CFITSIO does.
+*/
+static double
+vot_hdrRot (double m11, double m12, double m21, double m22)
+{
+    double  phia = atan2 (m21, m11), phib = atan2 (-m12, m22), temp;
+
+    temp = (phia < phib ? phia : phib);
+    phib = (phia > phib ? phia : phib);
+    phia = temp;
+    if ((phib - phia) > (M_PI / 2.))
+	phia += M_PI;
+
+    return ((phia + phib) / 2.);
+}
+
+
+/*  Make the cache key of an image, "<path>\t<mtime>\t<size>".  Returns
+**  NULL if the image can't be found.
+*/
+static char *
+vot_hdrKey (char *name, char *key)
+{
+    char   path[PATH_MAX];
+    struct stat st;
+
+
+    if (!realpath (name, path) || stat (path, &st) < 0)
+	return ((char *) NULL);
+    sprintf (key, "%s\t%ld\t%ld", path, (long) st.st_mtime, (long) st.st_size);
+    return (key);
+}
+
+
+/*  Find the newest record of an image.
+*/
+static ImInfo *
+vot_hdrLookup (int fd, char *key)
+{
+    ImInfo  *info;
+    char    *buf, *bp;
+    int      len, klen = strlen (key), nextns;
+
+
+    if (!(buf = vot_hlogLookup (fd, key, '\0', HDR_MAXREC, &len)))
+	return ((ImInfo *) NULL);
+
+    bp = buf + klen + 1;
+    if (len < klen + 1 + (int) (sizeof (int) + sizeof (frameInfo))) {
+	free ((void *) buf);
+	return ((ImInfo *) NULL);
+    }
+    memcpy (&nextns, bp, sizeof (int));
+    bp += sizeof (int);
+    if (nextns <= 0 || len != (int) (klen + 1 + sizeof (int) +
+	(nextns + 1) * sizeof (frameInfo))) {
+	    free ((void *) buf);
+	    return ((ImInfo *) NULL);
+    }
+
+    info = (ImInfo *) calloc (1, sizeof (ImInfo));
+    info->nextend = (nextns - 1);
+    info->extns   = (frameInfo *) calloc (nextns, sizeof (frameInfo));
+    memcpy (&info->frame, bp, sizeof (frameInfo));
+    memcpy (info->extns, bp + sizeof (frameInfo), nextns * sizeof (frameInfo));
+    free ((void *) buf);
+
+    return (info);
+}
+
+
+/*  Append a record for an image.
+*/
+static void
+vot_hdrStore (int fd, char *key, ImInfo *info)
+{
+    char    *buf, *bp, *nullp = (char *) NULL;
+    int      len, nextns = info->nextend + 1, i;
+
+
+    len = strlen (key) + 1 + sizeof (int) + (nextns + 1) * sizeof (frameInfo);
+    if (len > HDR_MAXREC)
+	return;
+
+    /*  Pointers aren't kept.
+    */
+    buf = bp = (char *) calloc (1, len);
+    strcpy (bp, key);
+    bp += strlen (key) + 1;
+    memcpy (bp, &nextns, sizeof (int));
+    bp += sizeof (int);
+    memcpy (bp, &info->frame, sizeof (frameInfo));
+    memcpy (bp + sizeof (frameInfo), info->extns, nextns * sizeof(frameInfo));
+    for (i=0; i <= nextns; i++)
+	memcpy (bp + i * sizeof (frameInfo) + offsetof (frameInfo, imname),
+	    &nullp, sizeof (char *));
+
+    (void) vot_hlogStore (fd, key, buf, len);
+    free ((void *) buf);
+}
@@ -0,0 +1,242 @@
+/************************************************************************
+**  VOHASHLOG.C -- A cache file of keyed records:  a hash index followed by
+**  an append-only log of records.
+**
+**  The file is kept in a subdirectory of the VOClient cache (see
+**  voc_getCacheDir()) and has the layout
+**
+**	header		magic[8], nbuckets, tag
+**	index		nbuckets x 8-byte offset of the newest record
+**	records		8-byte offset of the next record, 4-byte length,
+**			 "<key><sep><data>"
+**
+**  The 'tag' is chosen by the user of the file (e.g. the size of a struct
+**  saved in the records) and a file with another tag isn't used.  Records
+**  are found by the hash of their key, the newest first.  A record is
+**  written at the end of the file before the index slot is pointed at it,
+**  so readers need no lock and always see a complete chain.  Writers take
+**  an flock() on the file for the append;  the lock is per open file, so
+**  threads sharing a descriptor must also serialize their stores.
+**  VOC_NO_CACHE in the environment disables the caches.
+**
+**	      fd = vot_hlogOpen (subdir, name, magic, nbuckets, tag, writable)
+**	     rec = vot_hlogLookup (fd, key, sep, maxlen, &len)
+**	    stat = vot_hlogStore (fd, key, rec, len)
+**	       h = vot_hlogHash (key)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+extern char *voc_getCacheDir (char *subdir);
+
+
+#define	HLOG_SZHDR	16		/* file header size		*/
+#define	HLOG_SZREC	12		/* record header size		*/
+
+
+int      vot_hlogOpen (char *subdir, char *name, char *magic, int nbuckets,
+		int tag, int writable);
+char    *vot_hlogLookup (int fd, char *key, int sep, int maxlen, int *len);
+int      vot_hlogStore (int fd, char *key, char *rec, int len);
+uint64_t vot_hlogHash (char *key);
+
+static int  vot_hlogSlot (int fd, char *key, off_t *slot);
+
+
+
+/************************************************************************
+**  VOT_HLOGOPEN -- Open the cache file 'name' in the cache subdirectory,
+**  creating it with 'nbuckets' index slots if it is to be written.  Returns
+**  -1 if the cache is disabled, the file can't be opened, or it was made
+**  with another magic or tag.
+*/
+int
+vot_hlogOpen (char *subdir, char *name, char *magic, int nbuckets, int tag,
+		int writable)
+{
+    char  *dir, path[SZ_FNAME], hdr[HLOG_SZHDR];
+    int    fd;
+    struct stat st;
+
+
+    if (getenv ("VOC_NO_CACHE") || !(dir = voc_getCacheDir (subdir)))
+	return (-1);
+    sprintf (path, "%s/%s", dir, name);
+    free ((void *) dir);
+
+    if (!writable) {
+	if ((fd = open (path, O_RDONLY)) < 0)
+	    return (-1);
+
+    } else {
+	if ((fd = open (path, O_RDWR|O_CREAT, 0644)) < 0)
+	    return (-1);
+
+	/*  Create the index of a new file.  The magic is written last so
+	**  readers ignore the file until it is ready.
+	*/
+	flock (fd, LOCK_EX);
+	if (fstat (fd, &st) == 0 && st.st_size < HLOG_SZHDR) {
+	    memset (hdr, 0, HLOG_SZHDR);
+	    memcpy (&hdr[8], &nbuckets, sizeof (int));
+	    memcpy (&hdr[12], &tag, sizeof (int));
+	    if (ftruncate (fd, (off_t) (HLOG_SZHDR + 8L * nbuckets)) < 0 ||
+		pwrite (fd, hdr, HLOG_SZHDR, (off_t) 0) != HLOG_SZHDR ||
+		pwrite (fd, magic, 8, (off_t) 0) != 8) {
+		    flock (fd, LOCK_UN);
+		    close (fd);
+		    return (-1);
+	    }
+	}
+	flock (fd, LOCK_UN);
+    }
+
+    if (pread (fd, hdr, HLOG_SZHDR, (off_t) 0) != HLOG_SZHDR ||
+	memcmp (hdr, magic, 8) != 0 || memcmp (&hdr[12], &tag, 4) != 0) {
+	    close (fd);
+	    return (-1);
+    }
+
+    return (fd);
+}
+
+
+/************************************************************************
+**  VOT_HLOGLOOKUP -- Find the newest record of a key, one beginning with
+**  the key followed by the 'sep' character.  Returns the record, including
+**  the key, as an allocated buffer of '*len' bytes plus a terminating NUL,
+**  or NULL if there is none.  Records longer than 'maxlen' end the search.
+*/
+char *
+vot_hlogLookup (int fd, char *key, int sep, int maxlen, int *len)
+{
+    char     rec[HLOG_SZREC], *buf, *bp;
+    int      n, klen = strlen (key);
+    int64_t  off = 0, next;
+    off_t    slot;
+
+
+    if (fd < 0 || vot_hlogSlot (fd, key, &slot) != OK ||
+	pread (fd, &off, 8, slot) != 8)
+	    return ((char *) NULL);
+
+    /*  Records only point back to older ones, so the chain ends.  The key
+    **  is compared before the rest of a record is read.
+    */
+    buf = (char *) malloc (klen + 2);
+    for ( ; off > 0; off = next) {
+	if (pread (fd, rec, HLOG_SZREC, (off_t) off) != HLOG_SZREC)
+	    break;
+	memcpy (&next, rec, 8);
+	memcpy (&n, &rec[8], sizeof (int));
+	if (next >= off || n <= 0 || n > maxlen)
+	    break;
+	if (n <= klen)
+	    continue;
+	if (pread (fd, buf, klen + 1, (off_t) (off + HLOG_SZREC)) != klen + 1 ||
+	    memcmp (buf, key, klen) != 0 || buf[klen] != (char) sep)
+		continue;
+
+	bp = (char *) realloc (buf, n + 1);
+	buf = bp;
+	if (pread (fd, buf, n, (off_t) (off + HLOG_SZREC)) != n)
+	    break;
+	buf[n] = '\0';
+	*len = n;
+	return (buf);
+    }
+    free ((void *) buf);
+
+    return ((char *) NULL);
+}
+
+
+/************************************************************************
+**  VOT_HLOGSTORE -- Append a record of 'len' bytes, beginning with its
+**  key, and point the index slot of the key at it.
+*/
+int
+vot_hlogStore (int fd, char *key, char *rec, int len)
+{
+    char     *buf;
+    int64_t   head = 0, end;
+    off_t     slot;
+    struct stat st;
+    int       stat = ERR;
+
+
+    if (fd < 0 || len <= 0)
+	return (ERR);
+
+    buf = (char *) malloc (HLOG_SZREC + len);
+    memcpy (&buf[HLOG_SZREC], rec, len);
+
+    flock (fd, LOCK_EX);
+    if (vot_hlogSlot (fd, key, &slot) == OK && fstat (fd, &st) == 0 &&
+	pread (fd, &head, 8, slot) == 8) {
+
+	end = (int64_t) st.st_size;
+	memcpy (buf, &head, 8);
+	memcpy (&buf[8], &len, sizeof (int));
+	if (pwrite (fd, buf, HLOG_SZREC + len, (off_t) end) ==
+	    HLOG_SZREC + len && pwrite (fd, &end, 8, slot) == 8)
+		stat = OK;
+    }
+    flock (fd, LOCK_UN);
+    free ((void *) buf);
+
+    return (stat);
+}
+
+
+/************************************************************************
+**  VOT_HLOGHASH -- FNV-1a hash of a key.
+*/
+uint64_t
+vot_hlogHash (char *key)
+{
+    uint64_t  h = 14695981039346656037ULL;
+
+    for ( ; *key; key++) {
+	h ^= (unsigned char) *key;
+	h *= 1099511628211ULL;
+    }
+    return (h);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Get the offset of the index slot of a key.
+*/
+static int
+vot_hlogSlot (int fd, char *key, off_t *slot)
+{
+    char  hdr[HLOG_SZHDR];
+    int   nb;
+
+
+    if (pread (fd, hdr, HLOG_SZHDR, (off_t) 0) != HLOG_SZHDR)
+	return (ERR);
+    memcpy (&nb, &hdr[8], sizeof (int));
+    if (nb <= 0)
+	return (ERR);
+
+    *slot = (off_t) (HLOG_SZHDR + 8L * (long) (vot_hlogHash (key) %
+	(uint64_t) nb));
+    return (OK);
+}
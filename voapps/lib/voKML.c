@@ -1,11 +1,26 @@
 /************************************************************************
 **  VOKML.C  -- Utility procedures for writing Google KML files.
 **
+**  Each query writes its placemarks as a KML document of its own, which
+**  vot_concatKML() gathers into a single file grouped by object, service
+**  or both.  Queries run in-process write their documents to one spool
+**  instead of a file per query (the KML sink), and the grouping copies
+**  them from there:
+**
+**	    stat = vot_kmlSinkInit ()
+**	      fd = vot_kmlSinkOpen (pars)	    (closed by vot_closeKML)
+**		   vot_kmlSinkClose (save)
+**	   bool  = vot_kmlSinkEnabled ()
+**
+**  Callers are serialized by the 'vot_dalLock'.
+**
 **  M. Fitzpatrick, NOAO, July 2007
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <math.h>
@@ -13,7 +28,7 @@
 #include "voAppsP.h"
 
 
-extern  int 	format, debug, errno, extract;
+extern  int 	format, debug, errno, extract, use_name;
 extern  int 	kml_max, kml_sample, kml_region,  kml_label, kml_verbose;
 extern  int 	kml_bySvc, kml_byObj, kml_byBoth;
 
@@ -35,6 +50,40 @@ int     vot_copyKMLFile (char *root, char *sname, FILE *fd);
 char   *vot_getSName (char *root);
 char   *vot_getOName (char *root);
 
+int     vot_kmlSinkInit (void);
+int     vot_kmlSinkEnabled (void);
+FILE   *vot_kmlSinkOpen (svcParams *pars);
+void    vot_kmlSinkClose (int save);
+
+static int   vot_copyKMLResult (Service *svc, int index, char *root, 
+		char *name, FILE *fd);
+static int   vot_copyKMLDoc (FILE *ifd, long end, char *name, FILE *fd);
+static int   vot_kmlDocCmp (const void *a, const void *b);
+
+extern  char *vot_getOFName (svcParams *pars, char *extn);
+extern  char *vot_getOFIndex (svcParams *pars, char *extn);
+
+
+/*  The KML sink.  The document of each query is a range of the spool,
+**  found by its service and object index.
+*/
+#define	KML_CHUNK	1024		/* document list allocation	*/
+
+typedef struct {
+    int      svc_index;			/* service index		*/
+    int      obj_index;			/* object index			*/
+    long     off;			/* document offset in spool	*/
+    long     len;			/* document length		*/
+    char     fname[SZ_FNAME];		/* per-query file name		*/
+} kmlDoc;
+
+static FILE   *kmlSpool	 = (FILE *) NULL;
+static kmlDoc *kmlDocs	 = (kmlDoc *) NULL;
+static int     kmlNDocs	 = 0;
+static int     kmlSzDocs = 0;
+static int     kmlSorted = FALSE;
+static int     kmlSinkOn = FALSE;
+
 
 
 /************************************************************************
@@ -235,7 +284,12 @@ vot_closeKML (FILE *fd)
 	return;
 
     fprintf (fd, "</Document>\n</kml>\n");	
-    fclose (fd);
+    if (fd == kmlSpool && kmlNDocs < kmlSzDocs) {
+	kmlDoc *doc = &kmlDocs[kmlNDocs++];	/* end the sink document */
+	doc->len = ftell (fd) - doc->off;
+	kmlSorted = FALSE;
+    } else
+	fclose (fd);
 }
 
 
@@ -326,17 +380,28 @@ vot_concatKMLByObject (FILE *fd)
 {
     Service *svc = svcList;		/* the service list		*/
     Proc    *proc;			/* process list in each service	*/
-    Proc    *ps;
+    Proc    *ps, **cur;
     char    sname[SZ_FNAME],
 	    oname[SZ_FNAME],
 	    obj[SZ_FNAME];
+    int     i, j, k, nsvc;
 
 
+    /*  Each service's process list is walked along with the first one,
+    **  so we normally find the object at the same place in each.
+    */
+    for (nsvc=0, svc=svcList; svc; svc=svc->next)
+	nsvc++;
+    if ((cur = (Proc **) calloc (nsvc, sizeof (Proc *))) == NULL)
+	return;
+    for (i=0, svc=svcList; svc; svc=svc->next)
+	cur[i++] = svc->proc;
+
     /*  Loop over the "query matrix" by object.  The process table will
     **  have the same objects for each resource so we can use with the
     **  first service's list of objects/positions.
     */
-    for (proc=svcList->proc; proc; proc=proc->next) {
+    for (k=0, proc=svcList->proc; proc; proc=proc->next, k++) {
         bzero (oname, SZ_FNAME);
         strcpy (oname, vot_getOName (proc->root));
 
@@ -344,44 +409,48 @@ vot_concatKMLByObject (FILE *fd)
 	fprintf (fd, "    <name>%s</name>\n", oname);
 	fprintf (fd, "    <open>0</open>\n");
 
-	/*  Go through the list of services to find this object.  This is
-	**  known to be somewhat inefficient for the moment, but we don't
-	**  expect the query matrix to be large, and if it is this is still
-	**  a small overhead compared to the queries.
+	/*  Go through the list of services to find this object, searching
+	**  the list when it isn't in step.
 	*/
-    	for (svc=svcList; svc; svc=svc->next) {
-    
-	    for (ps=svc->proc; ps; ps=ps->next) {
-                bzero (obj, SZ_FNAME);
-                strcpy (obj, vot_getOName (ps->root));
-
-	        if (strcmp (oname, obj) == 0) {
-                    bzero (sname, SZ_FNAME);
-                    strcpy (sname, vot_getSName (svc->proc->root));
-
-		    if (debug) {
-                        fprintf (stderr, "\t\t%s.%s\t%s\n",
-		            oname, sname, ps->root);
-		    }
-
-		    /* At this point we have the following:
-		    **
-		    **	  oname      - name of object we using to group
-		    **	  sname      - name of the service we're processing
-		    **	  ps->root   - name of root file associated w/ result
-		    **
-		    ** The job now is simply to concatenate any KML file onto
-		    ** the final output.
-		    */
-
-		    vot_copyKMLFile (ps->root, sname, fd);
-		    break;
-	        }
+    	for (i=0, svc=svcList; svc; svc=svc->next, i++) {
+	    ps = cur[i];
+	    j = k;
+	    if (!ps || strcmp (oname, vot_getOName (ps->root)) != 0) {
+	        for (j=0, ps=svc->proc; ps; ps=ps->next, j++) {
+                    bzero (obj, SZ_FNAME);
+                    strcpy (obj, vot_getOName (ps->root));
+	            if (strcmp (oname, obj) == 0)
+			break;
+		}
+	    }
+	    if (cur[i])
+		cur[i] = cur[i]->next;
+
+	    if (ps) {
+                bzero (sname, SZ_FNAME);
+                strcpy (sname, vot_getSName (svc->proc->root));
+
+		if (debug) {
+                    fprintf (stderr, "\t\t%s.%s\t%s\n",
+		        oname, sname, ps->root);
+		}
+
+		/* At this point we have the following:
+		**
+		**	  oname      - name of object we using to group
+		**	  sname      - name of the service we're processing
+		**	  ps->root   - name of root file associated w/ result
+		**
+		** The job now is simply to concatenate the query's KML
+		** document onto the final output.
+		*/
+		vot_copyKMLResult (svc, j, ps->root, sname, fd);
 	    }
     	}
 	fprintf (fd, "  </Folder>\n");
     }
 
+    free ((void *) cur);
     return;
 }
 
@@ -397,6 +466,7 @@ vot_concatKMLByService (FILE *fd)
     Proc    *proc;			/* process list in each service	*/
     char    sname[SZ_FNAME];
     char    oname[SZ_FNAME];
+    int     k;
 
 
     for (svc=svcList; svc; svc=svc->next) {
@@ -408,10 +478,10 @@ vot_concatKMLByService (FILE *fd)
 	fprintf (fd, "    <name>%s</name>\n", sname);
 	fprintf (fd, "    <open>0</open>\n");
 
-        for (proc=svc->proc; proc; proc=proc->next) {
+        for (k=0, proc=svc->proc; proc; proc=proc->next, k++) {
             bzero (oname, SZ_FNAME);
             strcpy (oname, vot_getOName (proc->root));
-	    vot_copyKMLFile (proc->root, oname, fd);
+	    vot_copyKMLResult (svc, k, proc->root, oname, fd);
 	}
 
 	fprintf (fd, "  </Folder>\n");
@@ -467,7 +537,7 @@ vot_getOName (char *root)
 int
 vot_copyKMLFile (char *root, char *name, FILE *fd) 
 {
-    char  line[4096], fname[SZ_FNAME];
+    char  fname[SZ_FNAME];
     FILE  *ifd;
 
 
@@ -486,6 +556,57 @@ vot_copyKMLFile (char *root, char *name, FILE *fd)
 	return (OK);
     }
 
+    vot_copyKMLDoc (ifd, -1L, name, fd);
+
+    fclose (ifd);
+    return (OK);
+}
+
+
+/************************************************************************
+**  COPYKMLRESULT -- Copy the KML document of a query, from the sink if
+**  it's enabled or else from the query's file.
+*/
+static int
+vot_copyKMLResult (Service *svc, int index, char *root, char *name, FILE *fd)
+{
+    kmlDoc  key, *doc;
+
+
+    if (!kmlSinkOn)
+	return (vot_copyKMLFile (root, name, fd));
+
+    if (!kmlSorted) {
+	qsort (kmlDocs, kmlNDocs, sizeof (kmlDoc), vot_kmlDocCmp);
+	kmlSorted = TRUE;
+    }
+
+    /* A query with no document has no data, as for a missing file.
+    */
+    key.svc_index = svc->index;
+    key.obj_index = index;
+    doc = (kmlDoc *) bsearch (&key, kmlDocs, kmlNDocs, sizeof (kmlDoc),
+	vot_kmlDocCmp);
+    if (!doc)
+	return (OK);
+
+    if (fseek (kmlSpool, doc->off, SEEK_SET) < 0)
+	return (ERR);
+    return (vot_copyKMLDoc (kmlSpool, doc->off + doc->len, name, fd));
+}
+
+
+/************************************************************************
+**  COPYKMLDOC -- Copy the inner part of a KML <Document> as a folder of
+**  the output, reading no further than offset 'end' (-1 for the whole
+**  file).
+*/
+static int
+vot_copyKMLDoc (FILE *ifd, long end, char *name, FILE *fd)
+{
+    char  line[4096];
+
+
     fprintf (fd, "    <Folder id=\"s_%s\">\n", name);
     fprintf (fd, "      <name>%s</name>\n", name);
     fprintf (fd, "      <open>0</open>\n");
@@ -495,25 +616,23 @@ vot_copyKMLFile (char *root, char *name, FILE *fd)
     /* Skip ahead to the start of the part we're interested in.
     */
     bzero (line, 4096);
-    while (fgets (line, 4096, ifd)) {
+    while ((end < 0 || ftell (ifd) < end) && fgets (line, 4096, ifd)) {
 	if (strstr (line, "<Document>"))
 	    break;
         bzero (line, 4096);
     }
 
-    /* (Slow) Copy the file until the end of the Document.
+    /* Copy the file until the end of the Document.
     */
     bzero (line, 4096);
-    while (fgets (line, 4096, ifd)) {
+    while ((end < 0 || ftell (ifd) < end) && fgets (line, 4096, ifd)) {
 	if (strstr (line, "</Document>"))
 	    break;
-	fprintf (fd, "%s", line);
+	fputs (line, fd);
         bzero (line, 4096);
     }
 
     fprintf (fd, "    </Folder>\n");
-
-    fclose (ifd);
     return (OK);
 }
 
@@ -531,9 +650,11 @@ vot_cleanKML ()
 
     for (svc=svcList; svc; svc=svc->next) {
         for (proc=svc->proc; proc; proc=proc->next) {
-	    bzero (fname, SZ_FNAME);
-	    sprintf (fname, "%s.kml", proc->root);
-	    unlink (fname);
+	    if (!kmlSinkOn) {			/* none with the sink	*/
+	        bzero (fname, SZ_FNAME);
+	        sprintf (fname, "%s.kml", proc->root);
+	        unlink (fname);
+	    }
 
 	    bzero (fname, SZ_FNAME);
 	    sprintf (fname, "%s.csv", proc->root);
@@ -541,3 +662,132 @@ vot_cleanKML ()
 	}
     }
 }
+
+
+/************************************************************************
+**  VOT_KMLSINKINIT -- Enable the KML sink if the query documents are to
+**  be gathered into one file.  Returns TRUE if enabled.
+*/
+int
+vot_kmlSinkInit ()
+{
+    kmlDocs = (kmlDoc *) NULL;
+    kmlNDocs = kmlSzDocs = 0;
+    kmlSorted = FALSE;
+
+    kmlSinkOn = ((format & F_KML) ||
+		 (extract & EX_KML && extract & EX_COLLECT));
+    if (kmlSinkOn && (kmlSpool = tmpfile ()) == (FILE *) NULL) {
+	fprintf (stderr, "Warning: Cannot open KML spool, using files\n");
+	kmlSinkOn = FALSE;
+    }
+
+    return (kmlSinkOn);
+}
+
+
+/************************************************************************
+**  VOT_KMLSINKENABLED -- See whether KML documents go to the sink.
+*/
+int
+vot_kmlSinkEnabled ()
+{
+    return (kmlSinkOn);
+}
+
+
+/************************************************************************
+**  VOT_KMLSINKOPEN -- Start the KML document of a query in the sink.  The
+**  document is written to the returned descriptor as to a file, and ended
+**  by vot_closeKML().
+*/
+FILE *
+vot_kmlSinkOpen (svcParams *pars)
+{
+    kmlDoc *doc;
+
+
+    if (!kmlSinkOn)
+	return ((FILE *) NULL);
+
+    if (kmlNDocs >= kmlSzDocs) {
+	doc = (kmlDoc *) realloc (kmlDocs, 
+	    (kmlSzDocs + KML_CHUNK) * sizeof (kmlDoc));
+	if (doc == (kmlDoc *) NULL) {
+	    fprintf (stderr, "ERROR: Cannot allocate KML sink\n");
+	    return ((FILE *) NULL);
+	}
+	kmlDocs = doc;
+	kmlSzDocs += KML_CHUNK;
+    }
+
+    doc = &kmlDocs[kmlNDocs];
+    memset (doc, 0, sizeof (kmlDoc));
+    doc->svc_index = pars->svc_index;
+    doc->obj_index = pars->obj_index;
+    strcpy (doc->fname, (use_name ? 
+	    vot_getOFName (pars, "kml") : 
+	    vot_getOFIndex (pars, "kml")) );
+
+    fseek (kmlSpool, 0L, SEEK_END);
+    doc->off = ftell (kmlSpool);
+
+    return (kmlSpool);
+}
+
+
+/************************************************************************
+**  VOT_KMLSINKCLOSE -- Close the KML sink.  If 'save' is set the query
+**  documents weren't gathered, write each to the file it would have had.
+*/
+void
+vot_kmlSinkClose (int save)
+{
+    kmlDoc *doc;
+    FILE   *fd;
+    char    buf[8192];
+    long    n, nb;
+    int     i;
+
+
+    if (!kmlSinkOn)
+	return;
+
+    for (i=0; save && i < kmlNDocs; i++) {
+	doc = &kmlDocs[i];
+	if ((fd = fopen (doc->fname, "w+")) == (FILE *) NULL) {
+	    fprintf (stderr, "ERROR: Cannot open KML file: '%s'\n", doc->fname);
+	    continue;
+	}
+	fseek (kmlSpool, doc->off, SEEK_SET);
+	for (n=doc->len; n > 0; n -= nb) {
+	    nb = fread (buf, 1, (n < sizeof(buf) ? n : sizeof(buf)), kmlSpool);
+	    if (nb <= 0)
+		break;
+	    fwrite (buf, 1, nb, fd);
+	}
+	fclose (fd);
+    }
+
+    fclose (kmlSpool);
+    free ((void *) kmlDocs);
+    kmlSpool = (FILE *) NULL;
+    kmlDocs = (kmlDoc *) NULL;
+    kmlNDocs = kmlSzDocs = 0;
+    kmlSinkOn = FALSE;
+}
+
+
+/************************************************************************
+**  KMLDOCCMP -- Order the sink documents by service and object.
+*/
+static int
+vot_kmlDocCmp (const void *a, const void *b)
+{
+    const kmlDoc *d1 = (const kmlDoc *) a, *d2 = (const kmlDoc *) b;
+
+    if (d1->svc_index != d2->svc_index)
+	return (d1->svc_index < d2->svc_index ? -1 : 1);
+    return (d1->obj_index < d2->obj_index ? -1 : 
+	   (d1->obj_index > d2->obj_index ? 1 : 0));
+}
@@ -2,23 +2,33 @@
 **  VOARGS.C -- Procedures for commandline argument handling.  We also do
 **  some of the heavy lifting for registry and object resolution.
 **
+**  A table of positions is memory-mapped and split into chunks of lines
+**  that are counted and parsed on several threads, the objects then being
+**  added to the list in file order.  Object names, in a list file or on
+**  the command line, are resolved in one batch before the list is read.
+**
 **  M. Fitzpatrick, NOAO, June 2007
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
 #include "VOClient.h"
 #include "votParse.h"
+#include "voApps.h"
 #include "voAppsP.h"
 
 
 #define OBJ_DEBUG	0		/* local debug options		*/
+#define OBJ_CHUNK	65536		/* min. bytes per parse thread	*/
 
 
 extern int   nobjects, nservices;
@@ -39,22 +49,70 @@ int id_col		= 0;	/* input table ID column  (0 => none)	*/
 int id_span		= 0;	/* input table ID column span		*/
 
 
+/*  Names of an object list file, resolved all at once before the file is
+**  processed in order.
+*/
+typedef struct {
+    resObj  *objs;			/* resolved names		*/
+    int      nobjs;			/* number of names		*/
+    int      next;			/* next name expected		*/
+} resBatch;
+
+static resBatch *curBatch = (resBatch *) NULL;
+
+
+/*  An object list file mapped into memory.  The lines to load are split
+**  into chunks, each counted and parsed on its own thread.
+*/
+typedef struct {
+    char    *buf;			/* mapped file			*/
+    size_t   size;			/* file size			*/
+    size_t   start;			/* offset of the first line	*/
+    char     sep[16];			/* word delimiters		*/
+    int      nwords;			/* words per line		*/
+    char   **lines;			/* lines to load		*/
+    Object **objs;			/* parsed objects, by line	*/
+    int      nlines;			/* number of lines		*/
+} objMap;
+
+typedef struct {
+    objMap  *map;			/* the list			*/
+    size_t   first, last;		/* byte range to count		*/
+    int      lfirst, llast;		/* line range to parse		*/
+    int      ntok;			/* words per line, -1 if varies	*/
+} objChunk;
+
+
 int    vot_parseObjectList (char *list, int isCmdLine);
 int    vot_printObjectList (FILE *fd);
 void   vot_freeObjectList (void);
 void   vot_readObjFile (char *fname);
 
 static int   vot_objectResolver (char *idlist, int nwords, int isCmdLine);
+static void  vot_resolveFile (FILE *fd, resBatch *batch);
+static resObj *vot_batchResult (char *name);
 static int   vot_loadVOTable (char *fname);
-static int   vot_countWords (FILE *fd);
+static int   vot_countWords (objMap *map);
 static int   vot_parseCmdLineObject (char *idlist);
+static char *vot_cmdLineToken (char *ip, char *opos);
 static void  vot_getColumns ();
 
+static int   vot_mapList (char *fname, objMap *map);
+static void  vot_unmapList (objMap *map);
+static int   vot_loadTable (objMap *map, int nwords);
+static void  vot_runChunks (objMap *map, int nitems, objChunk **chunks,
+		int *nchunks, void (*func)(void *data, int k));
+static void  vot_countChunk (void *data, int k);
+static void  vot_parseChunk (void *data, int k);
+
 static char *vot_parseTableLine (char *idlist, int nwords,
-		double *ra, double *dec); 
+		double *ra, double *dec, char *id); 
 
 extern char  *vot_copyStdin (void);
 extern char  *vot_getTableCol (char *line, int col, int span);
+extern char  *vot_tableCol (char *line, int col, int span, char *value);
+extern char  *vot_normCoord (char *coord, char *norm);
+extern char  *vot_normName (char *str, char *name);
 extern char  *toSexa (double val);
 extern char  *strcasestr ();
 extern char  *vot_normalize (char *str);
@@ -90,6 +148,8 @@ vot_parseObjectList (char *list, int isCmdLine)
     FILE  *fd;
     char  line[SZ_LINE];
     int   i, nl = 1, nwords;
+    resBatch  batch, *outer = curBatch;
+    objMap    map;
 
 
     if (access (list, R_OK) == 0) {
@@ -99,29 +159,51 @@ vot_parseObjectList (char *list, int isCmdLine)
 	    return (0);
 	}
 
-	/* Process the file contents. 
+	/* Map the file contents. 
 	*/
-	if ((fd = fopen (list, "r")) == (FILE *) NULL) {
+	if (vot_mapList (list, &map) != OK) {
 	    fprintf (stderr, "ERROR: Cannot open file '%s'\n", list);
 	    return (1);
 	}
 
         /* Count the number of words (tokens) on each line of the list.
         */
-	vot_skipHdr (fd);
-	if ((nwords = vot_countWords (fd)) < 0 && !force_read) {
+	if ((nwords = vot_countWords (&map)) < 0 && !force_read) {
 	    fprintf (stderr,
 		"ERROR: Can't parse object/position table '%s' ", list);
 	    fprintf (stderr, "(Variable number of columns).\n");
-	    fclose (fd);
-	    exit (1);
+	    vot_unmapList (&map);
+	    return (1);
 	}
 
         /* Parse the column description so we can properly read a table.
         */
         vot_getColumns ();
+
+	/* A table of positions is parsed on several threads.
+	*/
+	if (nwords != 1) {
+	    vot_loadTable (&map, nwords);
+	    vot_unmapList (&map);
+	    use_name = 0;
+	    goto done_;
+	}
+	vot_unmapList (&map);
+
+	if ((fd = fopen (list, "r")) == (FILE *) NULL) {
+	    fprintf (stderr, "ERROR: Cannot open file '%s'\n", list);
+	    return (1);
+	}
 	vot_skipHdr (fd);			/* prepare		*/
 
+	/* Resolve the list of names in one batch.
+	*/
+	memset (&batch, 0, sizeof (resBatch));
+	vot_resolveFile (fd, &batch);
+	curBatch = &batch;
+	rewind (fd);
+	vot_skipHdr (fd);
+
 	while (fgets (line, SZ_LINE, fd)) {	/* do it		*/
 
 	    /* Resolve the object name.
@@ -148,10 +230,17 @@ vot_parseObjectList (char *list, int isCmdLine)
 	fclose (fd);
 	use_name = 0;
 
+	curBatch = outer;
+	for (i=0; i < batch.nobjs; i++)
+	    free ((void *) batch.objs[i].name);
+	if (batch.objs)
+	    free ((void *) batch.objs);
+
     } else 
 	vot_objectResolver (list, 1, isCmdLine);
 
 
+done_:
     if (debug) 
 	vot_printObjectList (stderr);
     if (obj_list) {
@@ -240,7 +329,7 @@ vot_loadVOTable (char *fname)
 	}
     } else {
 	fprintf (stderr, "Cannot open votable '%s'\n", fname);
-	exit (1);
+	return (-1);
     }
 
     if (vot > 0)
@@ -354,6 +443,7 @@ static int
 vot_objectResolver (char *idlist, int nwords, int isCmdLine)
 {
     char    *id = (char *)NULL, *name = (char *)NULL, *ip;
+    char    idbuf[SZ_FNAME];
     double  ra, dec;
     Object *obj;
     Sesame  sesame;
@@ -380,6 +470,15 @@ vot_objectResolver (char *idlist, int nwords, int isCmdLine)
     	    return (OK);
 
 	} else {					/* resolve name	*/
+	    resObj *res;
+	    double  era, edec;
+
+	    /* Use the result of a batch resolution if we have one.
+	    */
+	    if ((ip = strchr (idlist, (int)'\n')))
+		*ip = '\0';
+	    res = vot_batchResult (idlist);
+
             /* Clobber the newline and do a poor-man's URL encoding of
             ** embedded spaces.
             */
@@ -389,9 +488,18 @@ vot_objectResolver (char *idlist, int nwords, int isCmdLine)
                 if (*ip == '\n') *ip = '\0';
             }
 
-	    sesame = voc_nameResolver (idlist);
-	    ra   = voc_resolverRA (sesame);
-	    dec  = voc_resolverDEC (sesame);
+	    if (res) {
+		ra   = res->ra;
+		dec  = res->dec;
+		era  = res->era;
+		edec = res->edec;
+	    } else {
+	        sesame = voc_nameResolver (idlist);
+	        ra   = voc_resolverRA (sesame);
+	        dec  = voc_resolverDEC (sesame);
+	        era  = voc_resolverRAErr (sesame);
+	        edec = voc_resolverDECErr (sesame);
+	    }
 	    name = idlist;
 
 	    /* If the positions are zero, make sure the errs are also zero
@@ -399,8 +507,7 @@ vot_objectResolver (char *idlist, int nwords, int isCmdLine)
 	    ** with this object but will print a warning.
 	    */
 	    if (ra == 0.0 && dec == 0.0) {
-	        if (voc_resolverRAErr (sesame) == 0.0 &&
-	            voc_resolverDECErr (sesame) == 0.0) {
+	        if (era == 0.0 && edec == 0.0) {
 			fprintf (stderr,
 			    "Warning: Cannot resolve '%s'....skipping\n", name);
 			return (ERR);
@@ -424,7 +531,7 @@ vot_objectResolver (char *idlist, int nwords, int isCmdLine)
 	** find the values.  The 'id' string may be optional in the table,
 	** if not specified we'll make something up.
 	*/
-	id = vot_parseTableLine (idlist, nwords, &ra, &dec); 
+	id = vot_parseTableLine (idlist, nwords, &ra, &dec, idbuf); 
 
         if (verbose > 1&& id && !quiet) {
 	    fprintf (stderr,"# Resolver: %-16.16s", (id ? id : "(none)"));
@@ -458,70 +565,135 @@ vot_objectResolver (char *idlist, int nwords, int isCmdLine)
 }
 
 
+/****************************************************************************
+**  RESOLVEFILE -- Resolve the names of a one-column object list in a single
+**  batch.  The lines are read as for the list itself;  those naming a file
+**  are left for the recursive call.
+*/
+static void
+vot_resolveFile (FILE *fd, resBatch *batch)
+{
+    char  line[SZ_LINE], *ip;
+    int   i, nl = 1, nalloc = 0;
+
+
+    while (fgets (line, SZ_LINE, fd)) {
+	if ((ip = strchr (line, (int)'\n')))
+	    *ip = '\0';
+	if (access (line, R_OK) != 0) {
+	    if (batch->nobjs == nalloc) {
+		nalloc += 1024;
+		batch->objs = (resObj *) realloc (batch->objs,
+		    nalloc * sizeof (resObj));
+	    }
+	    memset (&batch->objs[batch->nobjs], 0, sizeof (resObj));
+	    batch->objs[batch->nobjs++].name = strdup (line);
+	}
+
+	if (table_nlines > 0 && nl >= table_nlines)
+	    break;
+	else
+	    nl++;
+	if (table_sample > 1) {
+	    for (i=1; i < table_sample; i++) {
+		if (fgets (line, SZ_LINE, fd) == (char *)NULL)
+		    break;
+	    }
+	}
+    }
+
+    if (batch->nobjs > 0)
+	(void) vot_resolveNames (batch->objs, batch->nobjs, 0, FALSE);
+}
+
+
+/****************************************************************************
+**  BATCHRESULT -- Find the batch result of a name.  Names are asked for in
+**  the order of the list, so the search starts after the last one found.
+**  Returns NULL if the name wasn't part of a batch.
+*/
+static resObj *
+vot_batchResult (char *name)
+{
+    resBatch *b = curBatch;
+    int  i;
+
+
+    if (!b)
+	return ((resObj *) NULL);
+    for (i=b->next; i < b->nobjs; i++) {
+	if (strcmp (b->objs[i].name, name) == 0) {
+	    b->next = i + 1;
+	    return (&b->objs[i]);		/* zero if not resolved	*/
+	}
+    }
+    return ((resObj *) NULL);
+}
+
+
 /****************************************************************************
 **  PARSETABLELINE --  Parse a line of table input to extract the values for
 **  the given ra/dec/id columns.   Values that span multiple columns are
-**  concatenated to a single space-delimited string.
+**  concatenated to a single space-delimited string.  The ID is written to
+**  'id' (SZ_FNAME chars), only local buffers are used so lines may be
+**  parsed on several threads at once.
 */
 static char *
-vot_parseTableLine (char *idlist, int nwords, double *ra, double *dec)
+vot_parseTableLine (char *idlist, int nwords, double *ra, double *dec,
+		char *id)
 {
-    char *id = (char *) NULL, *sra = (char *) NULL, *sdec = (char *) NULL;
-
+    char  c1[SZ_LINE], c2[SZ_LINE], c3[SZ_LINE], sra[SZ_LINE], sdec[SZ_LINE];
+    char *v;
 
 
     if (ecols == (char *)NULL && nwords == 3) {
 	/* No user-specified columns, see if we can figure it out.
 	*/
-	char *c1 = calloc (1, SZ_LINE);
-	char *c2 = calloc (1, SZ_LINE);
-	char *c3 = calloc (1, SZ_LINE);
-
-	strcpy (c1, vot_getTableCol (idlist, 1, 1));
-	strcpy (c2, vot_getTableCol (idlist, 2, 1));
-	strcpy (c3, vot_getTableCol (idlist, 3, 1));
+	if (!vot_tableCol (idlist, 1, 1, c1))  c1[0] = '\0';
+	if (!vot_tableCol (idlist, 2, 1, c2))  c2[0] = '\0';
+	if (!vot_tableCol (idlist, 3, 1, c3))  c3[0] = '\0';
 
 	if ( (strchr(c1,(int)'.') && strchr(c2,(int)'.')) ||
 	     (strchr(c1,(int)':') && strchr(c2,(int)':')) )  {
 
 	     /* ID is column 3 */
-             sra  = strdup (vot_normalizeCoord (c1));
-             sdec = strdup (vot_normalizeCoord (c2));
-             id   = vot_normalize (c3);
+             vot_normCoord (c1, sra);
+             vot_normCoord (c2, sdec);
+             id = vot_normName (c3, id);
 
 	} else if ( (strchr(c2,(int)'.') && strchr(c3,(int)'.')) ||
 	     (strchr(c2,(int)':') && strchr(c3,(int)':')) )  {
 
 	     /* ID is column 1 */
-             id   = vot_normalize (c1);
-             sra  = strdup (vot_normalizeCoord (c2));
-             sdec = strdup (vot_normalizeCoord (c3));
+             id = vot_normName (c1, id);
+             vot_normCoord (c2, sra);
+             vot_normCoord (c3, sdec);
 
 	} else {
 	     fprintf (stderr, "ERROR: Unable to parse table colummns\n");
 	     *ra = *dec = 0.0;
-	     free (c1); free (c2); free (c3);
 	     return ((char *)NULL);
 	}
-        *ra = (strchr (sra, (int)':') ?  (sexa (sra) * 15.) : atof (sra));
-        *dec = (strchr (sdec, (int)':') ?  sexa (sdec) : atof (sdec));
-
-	free (c1); free (c2); free (c3);
-	free (sra); free (sdec);
 
     } else {
-        sra = vot_normalizeCoord (vot_getTableCol (idlist, ra_col, ra_span));
-        *ra = (strchr (sra, (int)':') ?  (sexa (sra) * 15.) : atof (sra));
-
-        sdec = vot_normalizeCoord (vot_getTableCol (idlist, dec_col, dec_span));
-        *dec = (strchr (sdec, (int)':') ?  sexa (sdec) : atof (sdec));
+        if ((v = vot_tableCol (idlist, ra_col, ra_span, c1)) && v[0])
+	    vot_normCoord (v, sra);
+	else
+	    sra[0] = '\0';
+        if ((v = vot_tableCol (idlist, dec_col, dec_span, c2)) && v[0])
+	    vot_normCoord (v, sdec);
+	else
+	    sdec[0] = '\0';
 
         if (nwords == 3 && id_col == 0)
-            id  = vot_normalize (vot_getTableCol (idlist, 3, 1));
+            id  = vot_normName (vot_tableCol (idlist, 3, 1, c3), id);
         else
-            id  = vot_normalize (vot_getTableCol (idlist, id_col, id_span));
+            id  = vot_normName (vot_tableCol (idlist, id_col, id_span, c3), id);
     }
 
+    *ra = (strchr (sra, (int)':') ?  (sexa (sra) * 15.) : atof (sra));
+    *dec = (strchr (sdec, (int)':') ?  sexa (sdec) : atof (sdec));
+
     return ((char *) id);
 }
 
@@ -533,13 +705,39 @@ vot_parseTableLine (char *idlist, int nwords, double *ra, double *dec)
 static int
 vot_parseCmdLineObject (char *idlist)
 {
-    char    *ip, *op, *id, opos[SZ_LINE];
-    double  ra, dec;
+    char    *ip, *op, *id, *list, opos[SZ_LINE];
+    double  ra, dec, era, edec;
+    int     i, nalloc = 0;
     Object *obj;
     Sesame  sesame;
+    resObj *res;
+    resBatch  batch, *outer = curBatch;
     extern  double sr;
 
 
+    /* Resolve the object names of the list in one batch first.
+    */
+    memset (&batch, 0, sizeof (resBatch));
+    for (ip=(list = strdup (idlist)); *ip; ) {
+	ip = vot_cmdLineToken (ip, opos);
+        if (access (opos, R_OK) == 0 || isDecimal (opos) || 
+	    isSexagesimal (opos))
+		continue;
+	if (batch.nobjs == nalloc) {
+	    nalloc += 64;
+	    batch.objs = (resObj *) realloc (batch.objs,
+		nalloc * sizeof (resObj));
+	}
+	memset (&batch.objs[batch.nobjs], 0, sizeof (resObj));
+	batch.objs[batch.nobjs++].name = strdup (opos);
+    }
+    free ((void *) list);
+
+    if (batch.nobjs > 0)
+	(void) vot_resolveNames (batch.objs, batch.nobjs, 0, FALSE);
+    curBatch = &batch;
+
+
     /* Resolve the (list) of object names/positions and add them to the
     ** service list to be processed.
     */
@@ -548,25 +746,7 @@ vot_parseCmdLineObject (char *idlist)
 
 	/* Break up the input list into a single ID to resolve.
 	*/
-	op = &opos[0];
-	bzero (opos, SZ_LINE);
-
-	/* We allow positions to be comma-delimited, but objects
-	** list are processed individually.
-	*/
-	while (*ip && *ip != '\n') {
-	    if (*ip == ',') {
-		if (isDecimal(opos) || isSexagesimal(opos)) {
-		    *op++ = ' '; ip++;
-		} else {
-		    *ip++ = '\0';
-		    break;
-		}
-	    } else
-		*op++ = *ip++;
-	}
-	if (*ip && *(ip-1)) 		/* only advance on a position  	*/
-	    ip++;
+	ip = vot_cmdLineToken (ip, opos);
 
 
 	/*  Process the name, position or file.
@@ -594,6 +774,10 @@ vot_parseCmdLineObject (char *idlist)
 	} else {					/* resolve name	*/
 	    char *ip = opos;
 
+	    /* Use the result of the batch resolution if we have one.
+	    */
+	    res = vot_batchResult (opos);
+
             /* Clobber the newline and do a poor-man's URL encoding of
             ** embedded spaces.
             */
@@ -603,9 +787,18 @@ vot_parseCmdLineObject (char *idlist)
                 if (*ip == '\n') *ip = '\0';
             }
 
-	    sesame = voc_nameResolver (opos);
-	    ra   = voc_resolverRA (sesame);
-	    dec  = voc_resolverDEC (sesame);
+	    if (res) {
+		ra   = res->ra;
+		dec  = res->dec;
+		era  = res->era;
+		edec = res->edec;
+	    } else {
+	        sesame = voc_nameResolver (opos);
+	        ra   = voc_resolverRA (sesame);
+	        dec  = voc_resolverDEC (sesame);
+	        era  = voc_resolverRAErr (sesame);
+	        edec = voc_resolverDECErr (sesame);
+	    }
 	    id = opos;
 	    all_named = 1;
 
@@ -614,8 +807,7 @@ vot_parseCmdLineObject (char *idlist)
 	    ** with this object but will print a warning.
 	    */
 	    if (ra == 0.0 && dec == 0.0) {
-	        if (voc_resolverRAErr (sesame) == 0.0 &&
-	            voc_resolverDECErr (sesame) == 0.0) {
+	        if (era == 0.0 && edec == 0.0) {
 			fprintf (stderr,
 			    "Warning: Cannot resolve '%s'....skipping\n", opos);
 			continue;
@@ -643,10 +835,50 @@ vot_parseCmdLineObject (char *idlist)
         objTail  = obj;
     }
 
+    curBatch = outer;
+    for (i=0; i < batch.nobjs; i++)
+	free ((void *) batch.objs[i].name);
+    if (batch.objs)
+	free ((void *) batch.objs);
+
     return (0);
 }
 
 
+/****************************************************************************
+**  CMDLINETOKEN -- Get the next object name, position or file name of a
+**  command-line list into 'opos' (SZ_LINE chars).  Returns the rest of the
+**  list.
+*/
+static char *
+vot_cmdLineToken (char *ip, char *opos)
+{
+    char *op = &opos[0];
+
+
+    bzero (opos, SZ_LINE);
+
+    /* We allow positions to be comma-delimited, but objects
+    ** list are processed individually.
+    */
+    while (*ip && *ip != '\n') {
+	if (*ip == ',') {
+	    if (isDecimal(opos) || isSexagesimal(opos)) {
+		*op++ = ' '; ip++;
+	    } else {
+		*ip++ = '\0';
+		break;
+	    }
+	} else
+	    *op++ = *ip++;
+    }
+    if (*ip && *(ip-1)) 		/* only advance on a position  	*/
+	ip++;
+
+    return (ip);
+}
+
+
 /****************************************************************************
 **  Utility routines to print and count the object list.
 */
@@ -690,51 +922,302 @@ vot_printObjectList (FILE *fd)
 **  If the number varies for each line it's likely to be a table we can't
 **  handle so throw an error, otherwise assume we have a single item or
 **  a consistent table.  Allowed delimiters include whitespace, tabs,
-**  commas or '|'.  Lines beginning with a '#' are ignored.
+**  commas or '|'.  Lines beginning with a '#' are ignored.  Chunks of the
+**  mapped list are counted on separate threads.
 */
 static int
-vot_countWords (FILE *fd)
+vot_countWords (objMap *map)
 {
-    char *tok, *line = (char *) NULL;
-    char *sep = delim, *del = (char *) NULL;
-    int   ntok = -1, last_ntok = -1;
+    char   *ip, *end = map->buf + map->size, *del = (char *) NULL;
+    int     i, nchunks = 0, ntok = -2;
+    objChunk *chunks = (objChunk *) NULL;
 
-    line = malloc(4096);
 
-    while (1) {
+    /* The delimiter is set by the first line.
+    */
+    strcpy (map->sep, delim);
+    for (ip=map->buf + map->start; ip < end; ) {
+	char *eol = memchr (ip, '\n', end - ip);
+
+	if (*ip != '#' && *ip != '\n') {
+	    for (del=ip; del < (eol ? eol : end); del++) {
+		if (*del && strchr (" \t,|", (int)*del)) {
+		    map->sep[0] = *del, map->sep[1] = '\0';
+		    break;
+		}
+	    }
+	    break;
+	}
+	ip = (eol ? eol + 1 : end);
+    }
 
-	bzero (line, 4096);			/* get a line of data	*/
-	if (fgets (line, SZ_FNAME, fd) == (char *)NULL)
+    vot_runChunks (map, 0, &chunks, &nchunks, vot_countChunk);
+    for (i=0; i < nchunks; i++) {
+	if (chunks[i].ntok == -2)		/* no lines in chunk	*/
+	    continue;
+	if (chunks[i].ntok < 0 || (ntok >= 0 && chunks[i].ntok != ntok)) {
+	    ntok = -1;
 	    break;
+	}
+	ntok = chunks[i].ntok;
+    }
+    free ((void *) chunks);
 
-        if (line[0] == '#' || line[0] == '\n')  /* skip comments/blank	*/
+    return (ntok < 0 ? -1 : ntok);
+}
+
+
+/******************************************************************************
+**  COUNTCHUNK -- Count the words of each line in a chunk of the list.  The
+**  count is -1 if it varies, -2 if the chunk has no lines to count.
+*/
+static void
+vot_countChunk (void *data, int k)
+{
+    objChunk *c = &((objChunk *) data)[k];
+    char   *ip, *eol, *sep = c->map->sep, *end = c->map->buf + c->last;
+    int     n, inword;
+
+
+    c->ntok = -2;
+    for (ip=c->map->buf + c->first; ip < end; ip = eol + 1) {
+	if (!(eol = memchr (ip, '\n', end - ip)))
+	    eol = end;
+        if (*ip == '#' || *ip == '\n')  	/* skip comments/blank	*/
             continue;
 
-        if (last_ntok < 0) {                    /* first line only      */
-            del = strpbrk (line, " \t,|");
-            if (del) {
-                sep = calloc (1,16);
-                sep[0] = del[0];
-            } else
-                sep = delim; 
-        }
+	for (n=0, inword=0; ip < eol; ip++) {
+	    if (*ip && strchr (sep, (int)*ip))
+		inword = 0;
+	    else if (!inword)
+		n++, inword = 1;
+	}
+	if (c->ntok >= 0 && n != c->ntok) {
+	    c->ntok = -1;
+	    break;
+	}
+	c->ntok = n;
+    }
+}
 
-        for (ntok=0, tok=strtok(line, sep); tok; tok=strtok(NULL, sep)) {
-            if (tok[0] != '\n')
-                ntok++;
-        }
 
-        if (last_ntok >= 0 && ntok != last_ntok) {
-            free ((void *) line);
-            return (-1);
+/******************************************************************************
+**  LOADTABLE -- Load a table of positions from the mapped list.  The lines
+**  to read are found first, allowing for the line limit and sampling, then
+**  parsed on several threads and the objects added to the list in order.
+**  Blank lines and comments are skipped.  Returns the number of objects.
+*/
+static int
+vot_loadTable (objMap *map, int nwords)
+{
+    char   *ip, *eol, *end = map->buf + map->size;
+    int     i, k, nalloc = 0, nchunks = 0, nobjs = 0;
+    objChunk *chunks = (objChunk *) NULL;
+    Object *obj;
+
+
+    for (k=0, ip=map->buf + map->start; ip < end; ip = eol + 1, k++) {
+	if (!(eol = memchr (ip, '\n', end - ip)))
+	    eol = end;
+	if (table_sample > 1 && (k % table_sample))
+	    continue;
+	if (map->nlines == nalloc) {
+	    nalloc += 65536;
+	    map->lines = (char **) realloc (map->lines, nalloc*sizeof(char *));
+	}
+	map->lines[map->nlines++] = ip;
+	if (table_nlines > 0 && map->nlines >= table_nlines)
+	    break;
+    }
+    if (map->nlines == 0)
+	return (0);
+
+    map->nwords = nwords;
+    map->objs = (Object **) calloc (map->nlines, sizeof (Object *));
+    vot_runChunks (map, map->nlines, &chunks, &nchunks, vot_parseChunk);
+    free ((void *) chunks);
+
+    for (i=0; i < map->nlines; i++) {
+	if (!(obj = map->objs[i]))
+	    continue;
+
+        if (verbose > 1 && !quiet) {
+	    fprintf (stderr,"# Resolver: %-16.16s", obj->id);
+	    fprintf (stderr," %11.11s", toSexa(obj->ra));
+	    fprintf (stderr," %12.12s", toSexa(obj->dec));
+	    fprintf (stderr,"\n");
         }
-        last_ntok = ntok;
+
+        if (!objList)
+	    objList = objTail = obj;
+        else
+	    objTail->next = (Object *)obj;
+        obj->index = objIndex++;
+        objTail  = obj;
+	nobjs++;
+    }
+
+    return (nobjs);
+}
+
+
+/******************************************************************************
+**  PARSECHUNK -- Parse a chunk of the lines of a table into objects.
+*/
+static void
+vot_parseChunk (void *data, int k)
+{
+    objChunk *c = &((objChunk *) data)[k];
+    objMap  *map = c->map;
+    char    line[SZ_LINE], idbuf[SZ_FNAME], *ip, *eol, *id;
+    char    *end = map->buf + map->size;
+    double  ra, dec;
+    size_t  len;
+    int     i;
+    Object *obj;
+
+
+    for (i=c->lfirst; i < c->llast; i++) {
+	ip = map->lines[i];
+	if (ip >= end || *ip == '#' || *ip == '\n')
+	    continue;				/* skip comments/blank	*/
+
+	eol = memchr (ip, '\n', end - ip);
+	len = (eol ? (eol - ip + 1) : (end - ip));
+	if (len > SZ_LINE - 1)
+	    len = SZ_LINE - 1;
+	memcpy (line, ip, len);
+	line[len] = '\0';
+
+	id = vot_parseTableLine (line, map->nwords, &ra, &dec, idbuf);
+
+	obj = (Object *) calloc (1, sizeof (Object));
+	strcpy (obj->id, (id ? id : ""));
+	obj->ra  = ra;
+	obj->dec = dec;
+	map->objs[i] = obj;
+    }
+}
+
+
+/******************************************************************************
+**  RUNCHUNKS -- Split the list into chunks and run 'func' on each, one per
+**  pool worker.  The bytes of the list are split if 'nitems' is zero,
+**  otherwise the 'nitems' lines found.  Small lists are run on the calling
+**  thread.
+*/
+static void
+vot_runChunks (objMap *map, int nitems, objChunk **chunks, int *nchunks,
+	void (*func)(void *data, int k))
+{
+    objChunk  *c;
+    voPool    *pool;
+    size_t     nbytes = map->size - map->start, pos, next;
+    int        i, n = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    char      *eol;
+
+
+    n = (n < 1 ? 1 : (n > MAX_THREADS ? MAX_THREADS : n));
+    if ((size_t) n > nbytes / OBJ_CHUNK)
+	n = (int) (nbytes / OBJ_CHUNK) + 1;
+    if (nitems > 0 && n > nitems)
+	n = nitems;
+
+    c = (objChunk *) calloc (n, sizeof (objChunk));
+    for (i=0, pos=map->start; i < n; i++) {
+	c[i].map = map;
+	if (nitems > 0) {
+	    c[i].lfirst = (int) ((long) nitems * i / n);
+	    c[i].llast  = (int) ((long) nitems * (i+1) / n);
+	} else {
+	    /* Chunks of bytes end at a line boundary.
+	    */
+	    next = (i == n-1 ? map->size : map->start + nbytes * (i+1) / n);
+	    if (next < pos)
+		next = pos;
+	    if (next < map->size && next > 0 && map->buf[next-1] != '\n') {
+		eol = memchr (&map->buf[next], '\n', map->size - next);
+		next = (eol ? (size_t) (eol - map->buf) + 1 : map->size);
+	    }
+	    c[i].first = pos;
+	    c[i].last  = pos = next;
+	}
+    }
+
+    /*  One chunk per worker, or all of them here if the threads couldn't
+     *  all be started.
+     */
+    pool = vot_poolCreate (n);
+    if (vot_poolSize (pool) == n) {
+	vot_poolRun (pool, func, (void *) c);
+    } else {
+	for (i=0; i < n; i++)
+	    (*func) ((void *) c, i);
     }
+    vot_poolFree (pool);
 
-    rewind (fd);
-    free ((void *) line);
+    *chunks  = c;
+    *nchunks = n;
+}
 
-    return (ntok);
+
+/******************************************************************************
+**  MAPLIST -- Map an object list file and skip the table header lines.
+*/
+static int
+vot_mapList (char *fname, objMap *map)
+{
+    struct stat st;
+    char  *ip, *end;
+    int    i, fd;
+
+
+    memset (map, 0, sizeof (objMap));
+    if ((fd = open (fname, O_RDONLY)) < 0)
+	return (ERR);
+    if (fstat (fd, &st) < 0) {
+	close (fd);
+	return (ERR);
+    }
+
+    if ((map->size = (size_t) st.st_size) > 0) {
+	map->buf = mmap (NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map->buf == MAP_FAILED) {
+	    close (fd);
+	    return (ERR);
+	}
+	(void) madvise (map->buf, map->size, MADV_SEQUENTIAL);
+    }
+    close (fd);
+
+    /* Skip header lines.
+    */
+    end = map->buf + map->size;
+    for (i=0, ip=map->buf; i < table_hskip && ip < end; i++) {
+	if (!(ip = memchr (ip, '\n', end - ip)))
+	    ip = end;
+	else
+	    ip++;
+    }
+    map->start = (size_t) (ip - map->buf);
+
+    return (OK);
+}
+
+
+/******************************************************************************
+**  UNMAPLIST -- Free a mapped object list.
+*/
+static void
+vot_unmapList (objMap *map)
+{
+    if (map->buf && map->size > 0)
+	munmap (map->buf, map->size);
+    if (map->lines)
+	free ((void *) map->lines);
+    if (map->objs)
+	free ((void *) map->objs);
+    memset (map, 0, sizeof (objMap));
 }
 
 
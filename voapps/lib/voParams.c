@@ -19,11 +19,15 @@
 
 
 #define	MAXARGS		256
-#define	SZ_ARG		128
+#define	SZ_ARG		SZ_LINE
 
 
     
 static  int last_good_index = 0;
+static  int pos = 0, apos = 0;		/* positional/argument indices	*/
+
+static int  vo_isParamArg (char *arg, struct option long_opts[]);
+static int  vo_paramCopy (char *optval, char *arg);
 
 /**
  *  VO_PARAMINIT -- Initialize the task parameter vector.
@@ -41,20 +45,21 @@ vo_paramInit (int argc, char *argv[], char *opts, struct option long_opts[])
     static  char *pargv[MAXARGS], arg[SZ_ARG];
     int  i, j, k, len = 0;
 
-    memset (&pargv[0], 0, MAXARGS);
+    memset (&pargv[0], 0, sizeof (pargv));
     last_good_index = 0;
+    pos = apos = 0;			/* reset for the next task call	*/
 
     for (i=0; i < argc; i++) {
 	/*  Make a local copy of the arg so we can modify it without side
  	 *  effects.
 	 */
 	memset (arg, 0, SZ_ARG);
-	strcpy (arg, argv[i]);
+	strncpy (arg, argv[i], SZ_ARG - 1);
 	len = strlen (arg);
 
 	if (arg[0] != '-') {
 	    pargv[i] = calloc (1, strlen (arg) + 6);
-	    if (strchr (argv[i], (int) '='))
+	    if (vo_isParamArg (arg, long_opts))
 	        sprintf (pargv[i], "--%s", arg);
 	    else if (argv[i][len-1] == '+') {
 		arg[len-1] = '\0';
@@ -77,7 +82,8 @@ vo_paramInit (int argc, char *argv[], char *opts, struct option long_opts[])
 		    memset (new, 0, SZ_ARG);
 		    for (j=0; (char *)long_opts[j].name; j++) {
 			if ((int) long_opts[j].val == (int) arg[1]) {
-			    sprintf (new, "--%s=%s",long_opts[j].name, &arg[3]);
+			    snprintf (new, SZ_ARG, "--%s=%s", long_opts[j].name,
+				&arg[3]);
 			    memset (arg, 0, SZ_ARG);
 			    strcpy (arg, new);
 			    len = strlen (arg);
@@ -141,7 +147,6 @@ vo_paramNext (char *opts, struct option long_opts[], int argc, char *argv[],
 		char *optval, int *posindex)
 {
     int  ch = 0, index;
-    static  int pos = 0, apos = 0;
 
 
     apos++;
@@ -159,7 +164,7 @@ vo_paramNext (char *opts, struct option long_opts[], int argc, char *argv[],
 
     if (ch >= 0) {
         if (ch > 0 && optarg) {
-	    if ((strchr (optarg, (int)'=') != 0) && (optarg[0] != '-') && 
+	    if (vo_isParamArg (optarg, long_opts) && (optarg[0] != '-') && 
 	        (argv[apos][0] == '-' && argv[apos][1] != '-') ) {
 		    fprintf (stderr, 
 			"Error: invalid argument = '%s' in vot_paramNext()\n",
@@ -169,20 +174,21 @@ vo_paramNext (char *opts, struct option long_opts[], int argc, char *argv[],
 		if (optarg[0] == '-') {
 		    // optind--;
 		    memset (optval, 0, SZ_FNAME);
-		} else
-	            strcpy (optval, optarg);
+		} else if (vo_paramCopy (optval, optarg) < 0)
+		    return (PARG_ERR);
 	    }
 
 	} else if (ch == 0) {
 	    *posindex = index;
-	    if (optarg)
-	        strcpy (optval, optarg);
+	    if (optarg && vo_paramCopy (optval, optarg) < 0)
+		return (PARG_ERR);
 	} else {
 	}
 
     } else {
 	if (argv[optind+pos]) {
-	    strcpy (optval, argv[optind+pos]);
+	    if (vo_paramCopy (optval, argv[optind+pos]) < 0)
+		return (PARG_ERR);
 	    *posindex = pos++;
 	    return (-pos);
 	} else
@@ -220,3 +226,43 @@ vo_paramFree (int argc, char *argv[])
 	    free ((void *)argv[i]);
     }
 }
+
+
+/**
+ *  VO_ISPARAMARG -- Is a positional argument of the form "param=value"?
+ *  The name before the '=' must be one of the task's long options so that
+ *  an expression such as "mag >= 12" or "id==5" is passed through as-is.
+ */
+static int
+vo_isParamArg (char *arg, struct option long_opts[])
+{
+    char *ip;
+    int   i;
+
+    if (!(ip = strchr (arg, (int) '=')) || ip == arg || ip[1] == '=')
+	return (0);
+
+    for (i=0; long_opts && long_opts[i].name; i++) {
+	if (strlen (long_opts[i].name) == (size_t) (ip - arg) &&
+	    strncmp (long_opts[i].name, arg, (size_t) (ip - arg)) == 0)
+		return (1);
+    }
+    return (0);
+}
+
+
+/**
+ *  VO_PARAMCOPY -- Copy an argument value to the caller's optval buffer,
+ *  rather than truncate a value too long for it report an error.
+ */
+static int
+vo_paramCopy (char *optval, char *arg)
+{
+    if (strlen (arg) >= SZ_FNAME) {
+	fprintf (stderr, "Error: argument too long (max %d chars): '%.40s...'\n",
+	    SZ_FNAME - 1, arg);
+	return (-1);
+    }
+    strcpy (optval, arg);
+    return (0);
+}
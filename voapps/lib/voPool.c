@@ -0,0 +1,199 @@
+/************************************************************************
+**  VOPOOL.C -- A pool of worker threads for the tasks.
+**
+**  A pool runs a function once on each of its 'nthreads' workers, the
+**  calling thread being worker 0, and returns when all of them are done.
+**  The other workers are started when the pool is created and wait between
+**  runs, so a task may run the pool on each batch of rows it reads without
+**  creating threads every time.  The function is called as
+**
+**	    (*func) (data, k)
+**
+**  with k in [0,nthreads), each worker doing its share of the work (e.g.
+**  rows [nrows*k/n, nrows*(k+1)/n) of a batch) or taking items from a
+**  shared queue.  A pool of one thread simply calls the function.
+**
+**	    pool = vot_poolCreate (nthreads)
+**	       n = vot_poolSize (pool)
+**		   vot_poolRun (pool, func, data)
+**		   vot_poolFree (pool)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+typedef struct {
+    voPool  *pool;			/* pool of the worker		*/
+    int      k;				/* worker number		*/
+} poolWorker;
+
+struct voPool {
+    int      nthreads;			/* number of workers		*/
+    pthread_t  *tids;			/* worker threads		*/
+    poolWorker *workers;		/* worker arguments		*/
+
+    pthread_mutex_t lock;
+    pthread_cond_t  go, done;
+    int      gen, pending, quit;	/* run generation/state		*/
+
+    void   (*func)(void *data, int k);	/* function being run		*/
+    void    *data;
+};
+
+
+static void *vot_poolWorker (void *arg);
+
+
+
+/************************************************************************
+**  VOT_POOLCREATE -- Create a pool of 'nthreads' workers (the number of
+**  CPUs if zero).  The pool may have fewer workers than asked for if the
+**  threads can't be started, see vot_poolSize().
+*/
+voPool *
+vot_poolCreate (int nthreads)
+{
+    voPool *pool = (voPool *) calloc (1, sizeof (voPool));
+    int     k;
+
+
+    if (nthreads <= 0)
+	nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    nthreads = (nthreads < 1 ? 1 :
+	(nthreads > MAX_THREADS ? MAX_THREADS : nthreads));
+
+    pool->nthreads = nthreads;
+    if (nthreads == 1)
+	return (pool);
+
+    pthread_mutex_init (&pool->lock, NULL);
+    pthread_cond_init (&pool->go, NULL);
+    pthread_cond_init (&pool->done, NULL);
+
+    pool->tids    = (pthread_t *) calloc (nthreads, sizeof (pthread_t));
+    pool->workers = (poolWorker *) calloc (nthreads, sizeof (poolWorker));
+    for (k=1; k < nthreads; k++) {
+	pool->workers[k].pool = pool;
+	pool->workers[k].k    = k;
+	if (pthread_create (&pool->tids[k], NULL, vot_poolWorker,
+	    (void *) &pool->workers[k]) != 0) {
+		pool->nthreads = k;
+		break;
+	}
+    }
+
+    return (pool);
+}
+
+
+/************************************************************************
+**  VOT_POOLSIZE -- Get the number of workers in the pool.
+*/
+int
+vot_poolSize (voPool *pool)
+{
+    return (pool ? pool->nthreads : 1);
+}
+
+
+/************************************************************************
+**  VOT_POOLRUN -- Run func(data,k) on every worker k and wait for all of
+**  them to finish.
+*/
+void
+vot_poolRun (voPool *pool, void (*func)(void *data, int k), void *data)
+{
+    if (pool == (voPool *) NULL || pool->nthreads <= 1) {
+	(*func) (data, 0);
+	return;
+    }
+
+    pthread_mutex_lock (&pool->lock);
+    pool->func    = func;
+    pool->data    = data;
+    pool->pending = pool->nthreads - 1;
+    pool->gen++;
+    pthread_cond_broadcast (&pool->go);
+    pthread_mutex_unlock (&pool->lock);
+
+    (*func) (data, 0);
+
+    pthread_mutex_lock (&pool->lock);
+    while (pool->pending > 0)
+	pthread_cond_wait (&pool->done, &pool->lock);
+    pthread_mutex_unlock (&pool->lock);
+}
+
+
+/************************************************************************
+**  VOT_POOLFREE -- Stop the workers and free the pool.
+*/
+void
+vot_poolFree (voPool *pool)
+{
+    int  k;
+
+
+    if (pool == (voPool *) NULL)
+	return;
+
+    if (pool->tids) {
+	pthread_mutex_lock (&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast (&pool->go);
+	pthread_mutex_unlock (&pool->lock);
+
+	for (k=1; k < pool->nthreads; k++)
+	    pthread_join (pool->tids[k], NULL);
+
+	pthread_mutex_destroy (&pool->lock);
+	pthread_cond_destroy (&pool->go);
+	pthread_cond_destroy (&pool->done);
+	free ((void *) pool->tids);
+	free ((void *) pool->workers);
+    }
+    free ((void *) pool);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Worker thread:  run each new function until told to quit.
+*/
+static void *
+vot_poolWorker (void *arg)
+{
+    poolWorker *w = (poolWorker *) arg;
+    voPool     *pool = w->pool;
+    int         gen = 0;
+
+
+    pthread_mutex_lock (&pool->lock);
+    for ( ; ; ) {
+	while (pool->gen == gen && !pool->quit)
+	    pthread_cond_wait (&pool->go, &pool->lock);
+	if (pool->quit)
+	    break;
+	gen = pool->gen;
+	pthread_mutex_unlock (&pool->lock);
+
+	(*pool->func) (pool->data, w->k);
+
+	pthread_mutex_lock (&pool->lock);
+	if (--pool->pending == 0)
+	    pthread_cond_signal (&pool->done);
+    }
+    pthread_mutex_unlock (&pool->lock);
+
+    return ((void *) NULL);
+}
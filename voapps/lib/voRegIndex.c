@@ -0,0 +1,989 @@
+/************************************************************************
+**  VOREGINDEX.C -- Local full-text index of a Registry snapshot.
+**
+**  A snapshot of the Registry (every resource record, with the attributes
+**  vot_regSearch() and the VOTable output use) is kept as the single file
+**  'registry.idx' in the 'registry' subdirectory of the VOClient cache (see
+**  voc_getCacheDir()).  The file is mapped read-only by a search, so a
+**  keyword search with the usual constraints is answered locally instead
+**  of by a round trip to the Registry service:
+**
+**	header		magic[8], ctime, nrec, nfields, nterms, nwords,
+**			 section offsets, file size
+**	records		nrec x nfields string offsets
+**	terms		nterms x (string, first posting, npostings), sorted
+**	postings	(record, weight) pairs, sorted by record
+**	bitmaps		NBITMAPS x nwords, one bit per record for each of
+**			 the service types and bandpasses known by name
+**	strings		NUL-terminated field values and terms
+**
+**  Terms are the lowercased words of the Title, ShortName, Identifier,
+**  Subject, Publisher and Description;  the weight of a posting is the sum
+**  of the weights of the fields the word appears in.  A search keyword
+**  matches a term exactly or (at half weight) as a prefix, results are
+**  ranked by the sum of weight x idf over the keywords, and all keywords
+**  must match unless the terms are OR'd.  Searches using ADQL terms are
+**  still sent to the Registry.
+**
+**  The snapshot is rebuilt and renamed into place, so searches never see
+**  a partial file.  A refresh asks the Registry only for records updated
+**  since the last snapshot and merges them by Identifier and capability;
+**  resources removed from the Registry are dropped only by a new snapshot.
+**
+**	    nrec = vot_regIdxBuild (refresh)
+**	   nhits = vot_regIdxSearch (ids, nids, svctype, bpass, subject,
+**			clevel, orValues, dalOnly)
+**	     str = vot_regIdxStr (index, attr)
+**	    stat = vot_regIdxConnect ()
+**	     str = vot_regGetStr (res, attr, index)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+extern int   debug, verbose;
+
+extern char *voc_getCacheDir (char *subdir);
+extern char *strcasestr ();
+
+
+#define	RIX_MAGIC	"VOREGIX1"
+#define	RIX_FILE	"registry.idx"
+#define	RIX_MAXTOK	32		/* max keyword terms of a search */
+#define	RIX_SZTOK	64		/* max term length		*/
+#define	RIX_NPREFIX	64		/* max terms a prefix expands to */
+#define	RIX_MINPREFIX	3		/* min length of prefix match	*/
+
+/*  Record fields, by the attribute names of voc_resGetStr().
+*/
+#define	F_IDENT		0
+#define	F_TITLE		1
+#define	F_SNAME		2
+#define	F_CAPID		3
+#define	F_CAPNAME	4
+#define	F_URL		5
+#define	F_SUBJECT	6
+#define	F_DESCR		7
+#define	F_WAVEBAND	8
+#define	F_CLEVEL	9
+#define	F_TAGS		10
+#define	F_PUBLISHER	11
+#define	F_UPDATED	12
+#define	NFIELDS		29
+
+static struct {
+    char   *name;			/* attribute name		*/
+    int     weight;			/* term weight (0 = not indexed) */
+} rixFields[NFIELDS] = {
+    { "identifier",         4 },	{ "title",              8 },
+    { "shortName",         10 },	{ "capabilityID",       0 },
+    { "capabilityName",     0 },	{ "accessURL",          0 },
+    { "subject",            3 },	{ "description",        1 },
+    { "waveband",           0 },	{ "contentLevel",       0 },
+    { "tags",               0 },	{ "publisher",          2 },
+    { "updated",            0 },	{ "type",               0 },
+    { "referenceURL",       0 },	{ "creator",            0 },
+    { "publisherID",        0 },	{ "version",            0 },
+    { "capabilityClass",    0 },	{ "capabilityValidationLevel", 0 },
+    { "interfaceClass",     0 },	{ "interfaceVersion",   0 },
+    { "interfaceRole",      0 },	{ "supportedInputParam", 0 },
+    { "maxRadius",          0 },	{ "maxRecords",         0 },
+    { "regionOfRegard",     0 },	{ "coverageSpatial",    0 },
+    { "coverageTemporal",   0 }
+};
+
+static struct {
+    char   *alias;			/* other name of an attribute	*/
+    int     field;
+} rixAlias[] = {
+    { "ServiceURL",           F_URL },	{ "CapabilityStandardID", F_CAPID },
+    { "Tag",                  F_TAGS },
+    { NULL,                   0 }
+};
+
+/*  Bitmaps of the service types and bandpasses known by name, matching
+**  the constraints of vot_parseSvcType() and vot_parseBandpass().
+*/
+#define	B_CATALOG	0
+#define	B_IMAGE		1
+#define	B_SPECTRA	2
+#define	B_TABLE		3
+#define	B_RADIO		4
+#define	B_MILLIMETER	5
+#define	B_INFRARED	6
+#define	B_OPTICAL	7
+#define	B_UV		8
+#define	B_XRAY		9
+#define	B_GAMMA		10
+#define	B_DAL		11
+#define	NBITMAPS	12
+
+static struct {
+    int     field;			/* field searched		*/
+    char   *match;			/* substring matched		*/
+} rixBits[NBITMAPS] = {
+    { F_TAGS,     "catalog" },		{ F_TAGS,     "image" },
+    { F_TAGS,     "spec" },		{ F_IDENT,    "vizier" },
+    { F_WAVEBAND, "radio" },		{ F_WAVEBAND, "millimeter" },
+    { F_WAVEBAND, "infrared" },		{ F_WAVEBAND, "optical" },
+    { F_WAVEBAND, "ultraviolet" },	{ F_WAVEBAND, "x-ray" },
+    { F_WAVEBAND, "gamma-ray" },	{ F_CAPID,    "" }
+};
+
+#define	C_SVCTYPE	0		/* constraint types		*/
+#define	C_BANDPASS	1
+#define	C_SUBJECT	2
+#define	C_CLEVEL	3
+
+
+typedef struct {
+    char      magic[8];			/* RIX_MAGIC			*/
+    int64_t   ctime;			/* time of the snapshot query	*/
+    uint32_t  nrec;			/* number of records		*/
+    uint32_t  nfields;			/* fields per record		*/
+    uint32_t  nterms;			/* number of terms		*/
+    uint32_t  nwords;			/* words per bitmap		*/
+    uint32_t  o_recs;			/* section offsets		*/
+    uint32_t  o_terms;
+    uint32_t  o_posts;
+    uint32_t  o_bits;
+    uint32_t  o_strs;
+    uint32_t  size;			/* file size			*/
+} rixHdr;
+
+typedef struct {
+    uint32_t  str;			/* term string			*/
+    uint32_t  post;			/* first posting		*/
+    uint32_t  npost;			/* number of postings		*/
+} rixEnt;
+
+typedef struct {			/* term of an index being built	*/
+    char     *term;
+    uint32_t *post;			/* (record, weight) pairs	*/
+    int       npost, nalloc;
+} rixTerm;
+
+typedef struct {			/* record of an index being built */
+    char     *f[NFIELDS];
+} rixRec;
+
+
+static char     *rixBase	= (char *) NULL;	/* mapped index	*/
+static size_t    rixSize	= 0;
+static rixHdr   *rixH		= (rixHdr *) NULL;
+static uint32_t *rixHits	= (uint32_t *) NULL;	/* last search	*/
+static int       rixNHits	= 0;
+
+static pthread_mutex_t rix_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int      reg_local		= 0;	/* search the local index?	*/
+static int rixConnected		= 0;	/* VOClient initialized?	*/
+
+
+int      vot_regIdxBuild (int refresh);
+int      vot_regIdxOpen (void);
+int      vot_regIdxConnect (void);
+int      vot_regIdxSearch (char **ids, int nids, char *svctype, char *bpass,
+		char *subject, char *clevel, int orValues, int dalOnly);
+char    *vot_regIdxStr (int index, char *attr);
+char    *vot_regGetStr (RegResult res, char *attr, int index);
+
+static char    *vot_rixPath (void);
+static char    *vot_rixString (uint32_t off);
+static int      vot_rixField (char *attr);
+static int      vot_rixBit (uint32_t rec, int bitmap);
+static int      vot_rixToken (char **sp, char *tok);
+static int      vot_rixLookup (char *tok);
+static void     vot_rixConstraint (char *list, int type, char *keep);
+static int      vot_rixWrite (char *path, rixRec *recs, int nrec,
+		    time_t ctime);
+static rixTerm *vot_rixAddTerm (rixTerm ***tab, int *nalloc, int *nterms,
+		    char *tok);
+static uint32_t vot_rixHash (char *str);
+static int      vot_rixTermCmp (const void *a, const void *b);
+static int      vot_rixHitCmp (const void *a, const void *b);
+
+static float   *rixScore	= (float *) NULL;	/* for qsort()	*/
+
+
+
+/************************************************************************
+**  VOT_REGIDXBUILD -- Snapshot the Registry into the local index.  With
+**  'refresh' set and an index present, only the records updated since the
+**  last snapshot are fetched and merged.  Returns the number of records
+**  indexed, or ERR.
+*/
+int
+vot_regIdxBuild (int refresh)
+{
+    RegResult res;
+    rixRec   *recs = (rixRec *) NULL;
+    int      *hash, nhash, nrec = 0, nalloc = 0, nres, nnew = 0, i, j, k;
+    char     *path, *val, qstring[SZ_LINE], since[SZ_LINE];
+    time_t    ctime = time ((time_t *) NULL), then;
+    uint32_t  h;
+
+
+    if (!(path = vot_rixPath ()))
+	return (ERR);
+
+    /*  Start from the records of the existing snapshot on a refresh.
+    */
+    strcpy (qstring, "(Identifier like '%')");
+    if (refresh && vot_regIdxOpen ()) {
+	uint32_t *roff = (uint32_t *) (rixBase + rixH->o_recs);
+
+	pthread_mutex_lock (&rix_mutex);
+	nrec = nalloc = rixH->nrec;
+	recs = (rixRec *) calloc (nalloc + 1, sizeof (rixRec));
+	for (i=0; i < nrec; i++)
+	    for (j=0; j < NFIELDS; j++)
+		recs[i].f[j] = strdup (vot_rixString (roff[i*NFIELDS+j]));
+
+	/*  Overlap the window by a day in case of clock or time zone skew.
+	*/
+	then = (time_t) rixH->ctime - 86400;
+	strftime (since, SZ_LINE, "%Y-%m-%dT%H:%M:%S", gmtime (&then));
+	snprintf (qstring, SZ_LINE, "([@updated] >= '%s')", since);
+	pthread_mutex_unlock (&rix_mutex);
+    }
+
+    if (verbose)
+	fprintf (stderr, "Querying Registry %s ....\n",
+	    (nrec ? "for updated records" : "for all records"));
+
+    res  = voc_regSearch (qstring, NULL, 0);
+    nres = voc_resGetCount (res);
+    if (nres <= 0 && nrec == 0) {
+	fprintf (stderr, "ERROR: No records returned by the Registry\n");
+	free ((void *) recs);
+	free ((void *) path);
+	return (ERR);
+    }
+
+    /*  Hash the records by Identifier and capability for the merge.
+    */
+    nalloc = nrec + nres;
+    recs   = (rixRec *) realloc (recs, (nalloc + 1) * sizeof (rixRec));
+    nhash  = (nalloc * 2) | 1;
+    hash   = (int *) calloc (nhash, sizeof (int));
+    for (i=0; i < nhash; i++)
+	hash[i] = -1;
+    for (i=0; i < nrec; i++) {
+	h = (vot_rixHash (recs[i].f[F_IDENT]) ^
+		vot_rixHash (recs[i].f[F_CAPID])) % nhash;
+	while (hash[h] >= 0)
+	    h = (h + 1) % nhash;
+	hash[h] = i;
+    }
+
+    for (i=0; i < nres; i++) {
+	rixRec  rec;
+
+	for (j=0; j < NFIELDS; j++) {
+	    val = voc_resGetStr (res, rixFields[j].name, i);
+	    rec.f[j] = strdup (val ? val : "");
+	    if (val)
+		voc_freePointer ((char *) val);
+	}
+	if (!rec.f[F_IDENT][0]) {
+	    for (j=0; j < NFIELDS; j++)
+		free ((void *) rec.f[j]);
+	    continue;
+	}
+
+	h = (vot_rixHash (rec.f[F_IDENT]) ^ vot_rixHash (rec.f[F_CAPID]))
+	    % nhash;
+	for (k = hash[h]; k >= 0; h = (h + 1) % nhash, k = hash[h])
+	    if (strcmp (recs[k].f[F_IDENT], rec.f[F_IDENT]) == 0 &&
+	        strcmp (recs[k].f[F_CAPID], rec.f[F_CAPID]) == 0)
+		    break;
+
+	if (k >= 0) {				/* replace an old record */
+	    for (j=0; j < NFIELDS; j++)
+		free ((void *) recs[k].f[j]);
+	} else {
+	    hash[h] = k = nrec++;
+	    nnew++;
+	}
+	recs[k] = rec;
+
+	if (verbose > 1 && (i % 1000) == 999)
+	    fprintf (stderr, "    %d of %d records ....\n", i+1, nres);
+    }
+
+    if (verbose)
+	fprintf (stderr, "%d records fetched, %d new, %d in the index\n",
+	    (nres > 0 ? nres : 0), nnew, nrec);
+
+    i = vot_rixWrite (path, recs, nrec, ctime);
+
+    /*  Searches from here on should see the new snapshot.
+    */
+    pthread_mutex_lock (&rix_mutex);
+    if (rixBase) {
+	munmap (rixBase, rixSize);
+	rixBase = (char *) NULL, rixH = (rixHdr *) NULL;
+	rixNHits = 0;
+    }
+    pthread_mutex_unlock (&rix_mutex);
+
+    for (k=0; k < nrec; k++)
+	for (j=0; j < NFIELDS; j++)
+	    free ((void *) recs[k].f[j]);
+    free ((void *) recs);
+    free ((void *) hash);
+    free ((void *) path);
+
+    return (i == OK ? nrec : ERR);
+}
+
+
+/************************************************************************
+**  VOT_REGIDXOPEN -- Map the local index if we haven't already.  Returns
+**  TRUE if an index is available.
+*/
+int
+vot_regIdxOpen (void)
+{
+    struct stat st;
+    rixHdr  *h;
+    char    *path, *base;
+    int      fd, ok;
+
+
+    pthread_mutex_lock (&rix_mutex);
+    if (rixBase) {
+	pthread_mutex_unlock (&rix_mutex);
+	return (TRUE);
+    }
+
+    if (!(path = vot_rixPath ()) || (fd = open (path, O_RDONLY)) < 0) {
+	pthread_mutex_unlock (&rix_mutex);
+	if (path)
+	    free ((void *) path);
+	return (FALSE);
+    }
+    free ((void *) path);
+
+    if (fstat (fd, &st) < 0 || st.st_size < (off_t) sizeof (rixHdr) ||
+	(base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) ==
+	    MAP_FAILED) {
+	    close (fd);
+	    pthread_mutex_unlock (&rix_mutex);
+	    return (FALSE);
+    }
+    close (fd);
+
+    /*  Check the sections all lie within the file before trusting it.
+    */
+    h  = (rixHdr *) base;
+    ok = (memcmp (h->magic, RIX_MAGIC, 8) == 0 &&
+	h->nfields == NFIELDS && h->size == (uint32_t) st.st_size &&
+	h->nwords == (h->nrec + 31) / 32 &&
+	h->o_recs == sizeof (rixHdr) &&
+	h->o_terms == h->o_recs + (uint64_t) h->nrec * NFIELDS * 4 &&
+	h->o_posts == h->o_terms + (uint64_t) h->nterms * sizeof (rixEnt) &&
+	h->o_bits >= h->o_posts && (h->o_bits - h->o_posts) % 8 == 0 &&
+	h->o_strs == h->o_bits + (uint64_t) NBITMAPS * h->nwords * 4 &&
+	h->o_strs < h->size && base[h->size - 1] == '\0');
+
+    if (!ok) {
+	fprintf (stderr, "Warning: invalid Registry index, ignored\n");
+	munmap (base, st.st_size);
+	pthread_mutex_unlock (&rix_mutex);
+	return (FALSE);
+    }
+
+    rixBase = base;
+    rixSize = st.st_size;
+    rixH    = h;
+    pthread_mutex_unlock (&rix_mutex);
+
+    return (TRUE);
+}
+
+
+/************************************************************************
+**  VOT_REGIDXCONNECT -- Initialize VOClient for a query the local index
+**  can't answer, the first time one is sent.  Returns OK or ERR.
+*/
+int
+vot_regIdxConnect ()
+{
+    if (!rixConnected) {
+	if (voc_initVOClient ("runid=voc.voregistry") == ERR)
+	    return (ERR);
+	rixConnected = 1;
+    }
+    return (OK);
+}
+
+
+/************************************************************************
+**  VOT_REGIDXSEARCH -- Search the local index for the keyword terms and
+**  constraints of a vot_regSearch().  Returns the number of matching
+**  records, ranked best first, or -1 if the search can't be done locally
+**  (no index, or ADQL terms) and should be sent to the Registry.
+*/
+int
+vot_regIdxSearch (char **ids, int nids, char *svctype, char *bpass,
+		char *subject, char *clevel, int orValues, int dalOnly)
+{
+    rixEnt   *ents;
+    uint32_t *posts, *mask, all, r;
+    char      toks[RIX_MAXTOK][RIX_SZTOK], *keep, *ip;
+    int       ntoks = 0, any, nrec, i, j, k, t, lo, len;
+    double    w;
+
+
+    for (i=0; i < nids; i++) {
+	if (strcasestr (ids[i], "like") || strchr (ids[i], '<') ||
+	    strchr (ids[i], '>') || strchr (ids[i], '='))
+		return (-1);
+    }
+    if (!vot_regIdxOpen ())
+	return (-1);
+
+    /*  Break the keywords into terms, as they were indexed.
+    */
+    any = (nids == 0 || (nids == 1 && strcmp ("any", ids[0]) == 0));
+    for (i=0; !any && i < nids; i++) {
+	for (ip=ids[i]; ntoks < RIX_MAXTOK && vot_rixToken (&ip, toks[ntoks]);){
+	    for (j=0; j < ntoks && strcmp (toks[j], toks[ntoks]); j++)
+		;
+	    if (j == ntoks)
+		ntoks++;
+	}
+    }
+    if (!any && ntoks == 0)
+	return (-1);
+
+    pthread_mutex_lock (&rix_mutex);
+    nrec  = rixH->nrec;
+    ents  = (rixEnt *) (rixBase + rixH->o_terms);
+    posts = (uint32_t *) (rixBase + rixH->o_posts);
+
+    if (rixScore) free ((void *) rixScore);
+    if (rixHits)  free ((void *) rixHits);
+    rixScore = (float *) calloc (nrec + 1, sizeof (float));
+    rixHits  = (uint32_t *) calloc (nrec + 1, sizeof (uint32_t));
+    mask     = (uint32_t *) calloc (nrec + 1, sizeof (uint32_t));
+    keep     = (char *) calloc (nrec + 1, sizeof (char));
+
+    /*  Score the postings of each term and of the terms it's a prefix of.
+    */
+    for (t=0; t < ntoks; t++) {
+	len = strlen (toks[t]);
+	lo  = vot_rixLookup (toks[t]);
+
+	for (k=lo; k < (int) rixH->nterms && k < lo + RIX_NPREFIX; k++) {
+	    char *term = vot_rixString (ents[k].str);
+	    int   exact = (strcmp (term, toks[t]) == 0);
+
+	    if (strncmp (term, toks[t], len) != 0)
+		break;
+	    if (!exact && len < RIX_MINPREFIX)
+		continue;
+	    if (ents[k].post + (uint64_t) ents[k].npost >
+		(rixH->o_bits - rixH->o_posts) / 8)
+		    continue;
+
+	    w = (exact ? 1.0 : 0.5) * log (1.0 + (double) nrec / ents[k].npost);
+	    for (j=0; j < (int) ents[k].npost; j++) {
+		r = posts[2 * (ents[k].post + j)];
+		if (r < (uint32_t) nrec) {
+		    rixScore[r] += (float) (w * posts[2 * (ents[k].post+j) + 1]);
+		    mask[r] |= (1U << t);
+		}
+	    }
+	}
+    }
+
+    all = (ntoks >= 32 ? ~0U : ((1U << ntoks) - 1));
+    for (r=0; r < (uint32_t) nrec; r++)
+	keep[r] = (any || (orValues ? mask[r] != 0 : mask[r] == all));
+
+    /*  Apply the constraints.
+    */
+    if (svctype && svctype[0])
+	vot_rixConstraint (svctype, C_SVCTYPE, keep);
+    if (bpass && bpass[0])
+	vot_rixConstraint (bpass, C_BANDPASS, keep);
+    if (subject && subject[0])
+	vot_rixConstraint (subject, C_SUBJECT, keep);
+    if (clevel && clevel[0])
+	vot_rixConstraint (clevel, C_CLEVEL, keep);
+    for (r=0; dalOnly && r < (uint32_t) nrec; r++)
+	keep[r] = (keep[r] && vot_rixBit (r, B_DAL));
+
+    for (r=0, rixNHits=0; r < (uint32_t) nrec; r++)
+	if (keep[r])
+	    rixHits[rixNHits++] = r;
+    if (!any)
+	qsort (rixHits, rixNHits, sizeof (uint32_t), vot_rixHitCmp);
+    pthread_mutex_unlock (&rix_mutex);
+
+    if (debug)
+	fprintf (stderr, "regIdxSearch: %d terms, %d of %d records\n",
+	    ntoks, rixNHits, nrec);
+
+    free ((void *) mask);
+    free ((void *) keep);
+
+    return (rixNHits);
+}
+
+
+/************************************************************************
+**  VOT_REGIDXSTR -- Get an attribute of a result of the last local search.
+**  As with voc_resGetStr(), the value is allocated and NULL if empty.
+*/
+char *
+vot_regIdxStr (int index, char *attr)
+{
+    uint32_t *roff;
+    char     *val;
+    int       f;
+
+
+    if (!rixBase || index < 0 || index >= rixNHits ||
+	(f = vot_rixField (attr)) < 0)
+	    return ((char *) NULL);
+
+    roff = (uint32_t *) (rixBase + rixH->o_recs);
+    val  = vot_rixString (roff[rixHits[index] * NFIELDS + f]);
+
+    return (*val ? strdup (val) : (char *) NULL);
+}
+
+
+/************************************************************************
+**  VOT_REGGETSTR -- Get a result attribute from either the local index or
+**  a Registry query, depending on where the search was done.
+*/
+char *
+vot_regGetStr (RegResult res, char *attr, int index)
+{
+    if (res == REG_LOCALRES)
+	return (vot_regIdxStr (index, attr));
+    return (voc_resGetStr (res, attr, index));
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Get the path to the index file.
+*/
+static char *
+vot_rixPath (void)
+{
+    char  *dir, *path;
+
+
+    if (!(dir = voc_getCacheDir ("registry")))
+	return ((char *) NULL);
+    path = calloc (1, strlen (dir) + strlen (RIX_FILE) + 2);
+    sprintf (path, "%s/%s", dir, RIX_FILE);
+    free ((void *) dir);
+
+    return (path);
+}
+
+
+/*  Get a string from the mapped index.
+*/
+static char *
+vot_rixString (uint32_t off)
+{
+    if ((uint64_t) rixH->o_strs + off >= rixSize)
+	return ("");
+    return (rixBase + rixH->o_strs + off);
+}
+
+
+/*  Get the record field of an attribute name.
+*/
+static int
+vot_rixField (char *attr)
+{
+    int  i;
+
+
+    for (i=0; i < NFIELDS; i++)
+	if (strcasecmp (attr, rixFields[i].name) == 0)
+	    return (i);
+    for (i=0; rixAlias[i].alias; i++)
+	if (strcasecmp (attr, rixAlias[i].alias) == 0)
+	    return (rixAlias[i].field);
+
+    return (-1);
+}
+
+
+/*  Test the bit of a record in one of the bitmaps.
+*/
+static int
+vot_rixBit (uint32_t rec, int bitmap)
+{
+    uint32_t *bits = (uint32_t *) (rixBase + rixH->o_bits);
+
+    return ((bits[bitmap * rixH->nwords + rec / 32] >> (rec % 32)) & 1);
+}
+
+
+/*  Get the next term from a string, lowercased.  Single characters and a
+**  few common words aren't indexed.
+*/
+static int
+vot_rixToken (char **sp, char *tok)
+{
+    static char *stop[] = { "an", "and", "at", "by", "for", "from", "in",
+			    "of", "on", "or", "the", "to", "with", NULL };
+    char  *ip = *sp;
+    int    n, i;
+
+
+    while (*ip) {
+	while (*ip && !isalnum ((unsigned char) *ip))
+	    ip++;
+	for (n=0; *ip && isalnum ((unsigned char) *ip); ip++)
+	    if (n < RIX_SZTOK - 1)
+		tok[n++] = tolower ((unsigned char) *ip);
+	tok[n] = '\0';
+
+	for (i=0; stop[i] && strcmp (tok, stop[i]); i++)
+	    ;
+	if (n > 1 && !stop[i]) {
+	    *sp = ip;
+	    return (TRUE);
+	}
+    }
+    *sp = ip;
+
+    return (FALSE);
+}
+
+
+/*  Find the first term not less than a string in the term dictionary.
+*/
+static int
+vot_rixLookup (char *tok)
+{
+    rixEnt *ents = (rixEnt *) (rixBase + rixH->o_terms);
+    int     lo = 0, hi = rixH->nterms, mid;
+
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (strcmp (vot_rixString (ents[mid].str), tok) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return (lo);
+}
+
+
+/*  Apply a comma-delimited constraint list to the records kept.  A record
+**  is kept if it matches any of the values, where a leading '-' on a
+**  service type or bandpass negates the value.
+*/
+static void
+vot_rixConstraint (char *list, int type, char *keep)
+{
+    uint32_t *roff = (uint32_t *) (rixBase + rixH->o_recs), r;
+    char     *ip, *op, *pass, val[SZ_FNAME];
+    int       not, bit, field, nrec = rixH->nrec;
+
+
+    pass = (char *) calloc (nrec + 1, sizeof (char));
+    for (ip=list; *ip; ) {
+	not = 0;
+	memset (val, 0, SZ_FNAME);
+	for (op=val; *ip && (op - val) < SZ_FNAME - 1; ) {
+	    if (*ip == '-' && type <= C_BANDPASS && strncasecmp(ip,"-ray",4)) {
+		not++, ip++;
+	    } else if (*ip == ',') {
+		ip++;
+		break;
+	    } else
+		*op++ = *ip++;
+	}
+
+	/*  Map the value to a bitmap or a field to search, as the Registry
+	**  query would.
+	*/
+	bit = -1;
+	switch (type) {
+	case C_SVCTYPE:
+	    field = F_TAGS;
+	    if (strncasecmp (val,"catalog",3) == 0)	  bit = B_CATALOG;
+	    else if (strncasecmp (val,"image",5) == 0)	  bit = B_IMAGE;
+	    else if (strncasecmp (val,"spectr",6) == 0)	  bit = B_SPECTRA;
+	    else if (strncasecmp (val,"table",5) == 0)	  bit = B_TABLE;
+	    break;
+	case C_BANDPASS:
+	    field = F_WAVEBAND;
+	    if (strncasecmp (val,"radio",3) == 0)	  bit = B_RADIO;
+	    else if (strncasecmp (val,"millimeter",9) == 0) bit = B_MILLIMETER;
+	    else if (strncasecmp (val,"infrared",5) == 0 ||
+	         strncasecmp (val,"ir",2) == 0)		  bit = B_INFRARED;
+	    else if (strncasecmp (val,"optical",8) == 0)  bit = B_OPTICAL;
+	    else if (strncasecmp (val,"ultraviolet",5) == 0 ||
+	         strncasecmp (val,"uv",2) == 0)		  bit = B_UV;
+	    else if (strncasecmp (val,"x-ray",5) == 0 ||
+	         strncasecmp (val,"xray",4) == 0)	  bit = B_XRAY;
+	    else if (strncasecmp (val,"gamma-ray",9) == 0 ||
+	         strncasecmp (val,"gammaray",8) == 0)	  bit = B_GAMMA;
+	    break;
+	case C_SUBJECT:
+	    field = F_SUBJECT;
+	    break;
+	default:
+	    field = F_CLEVEL;
+	    break;
+	}
+
+	for (r=0; r < (uint32_t) nrec; r++) {
+	    int match = (bit >= 0 ? vot_rixBit (r, bit) :
+		(strcasestr (vot_rixString (roff[r*NFIELDS+field]), val) != 0));
+	    if (match != (not != 0))
+		pass[r] = 1;
+	}
+    }
+
+    for (r=0; r < (uint32_t) nrec; r++)
+	keep[r] = (keep[r] && pass[r]);
+    free ((void *) pass);
+}
+
+
+/*  Write the index of a list of records, to a temp file renamed into place.
+*/
+static int
+vot_rixWrite (char *path, rixRec *recs, int nrec, time_t ctime)
+{
+    FILE     *fd;
+    rixHdr    hdr;
+    rixEnt    ent;
+    rixTerm **tab = (rixTerm **) NULL, *t;
+    uint32_t *bits, off, pos, nposts = 0;
+    uint64_t  sz_strs = 1;
+    char      tmp[SZ_FNAME], tok[RIX_SZTOK], *ip;
+    int       nalloc = 0, nterms = 0, i, j, k, status = OK;
+
+
+    /*  Collect the postings of each term.  The records are visited in
+    **  order so a term's postings come out sorted by record.
+    */
+    for (i=0; i < nrec; i++) {
+	for (j=0; j < NFIELDS; j++) {
+	    if (recs[i].f[j][0])
+		sz_strs += strlen (recs[i].f[j]) + 1;
+	    if (rixFields[j].weight == 0)
+		continue;
+
+	    for (ip=recs[i].f[j]; vot_rixToken (&ip, tok); ) {
+		t = vot_rixAddTerm (&tab, &nalloc, &nterms, tok);
+		if (t->npost && t->post[2*(t->npost-1)] == (uint32_t) i) {
+		    t->post[2*(t->npost-1)+1] += rixFields[j].weight;
+		    continue;
+		}
+		if (t->npost == t->nalloc) {
+		    t->nalloc = (t->nalloc ? 2 * t->nalloc : 4);
+		    t->post = realloc (t->post, 2*t->nalloc*sizeof(uint32_t));
+		}
+		t->post[2*t->npost]   = i;
+		t->post[2*t->npost+1] = rixFields[j].weight;
+		t->npost++, nposts++;
+	    }
+	}
+    }
+
+    /*  Pack the hash table and sort the terms for the dictionary.
+    */
+    for (i=0, k=0; i < nalloc; i++)
+	if (tab[i])
+	    tab[k++] = tab[i];
+    qsort (tab, nterms, sizeof (rixTerm *), vot_rixTermCmp);
+    for (i=0; i < nterms; i++)
+	sz_strs += strlen (tab[i]->term) + 1;
+
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, RIX_MAGIC, 8);
+    hdr.ctime   = (int64_t) ctime;
+    hdr.nrec    = nrec;
+    hdr.nfields = NFIELDS;
+    hdr.nterms  = nterms;
+    hdr.nwords  = (nrec + 31) / 32;
+    hdr.o_recs  = sizeof (rixHdr);
+    hdr.o_terms = hdr.o_recs + nrec * NFIELDS * 4;
+    hdr.o_posts = hdr.o_terms + nterms * sizeof (rixEnt);
+    hdr.o_bits  = hdr.o_posts + nposts * 8;
+    hdr.o_strs  = hdr.o_bits + NBITMAPS * hdr.nwords * 4;
+
+    if ((uint64_t) hdr.o_strs + sz_strs >= 0xffffffffULL) {
+	fprintf (stderr, "ERROR: Registry index too large\n");
+	status = ERR;
+	goto done;
+    }
+    hdr.size = hdr.o_strs + (uint32_t) sz_strs;
+
+    sprintf (tmp, "%s.%d", path, (int) getpid ());
+    if ((fd = fopen (tmp, "w")) == (FILE *) NULL) {
+	fprintf (stderr, "ERROR: Cannot create '%s'\n", tmp);
+	status = ERR;
+	goto done;
+    }
+    fwrite (&hdr, sizeof (hdr), 1, fd);
+
+    /*  The strings are laid out in the order written:  record fields,
+    **  then terms, after an empty string at offset zero.
+    */
+    for (i=0, off=1; i < nrec; i++) {
+	for (j=0; j < NFIELDS; j++) {
+	    pos = (recs[i].f[j][0] ? off : 0);
+	    fwrite (&pos, sizeof (uint32_t), 1, fd);
+	    if (recs[i].f[j][0])
+	        off += strlen (recs[i].f[j]) + 1;
+	}
+    }
+    for (i=0, pos=0; i < nterms; i++) {
+	ent.str   = off;
+	ent.post  = pos;
+	ent.npost = tab[i]->npost;
+	fwrite (&ent, sizeof (ent), 1, fd);
+	off += strlen (tab[i]->term) + 1;
+	pos += tab[i]->npost;
+    }
+    for (i=0; i < nterms; i++)
+	fwrite (tab[i]->post, 2 * sizeof (uint32_t), tab[i]->npost, fd);
+
+    bits = (uint32_t *) calloc (hdr.nwords + 1, sizeof (uint32_t));
+    for (k=0; k < NBITMAPS; k++) {
+	memset (bits, 0, (hdr.nwords + 1) * sizeof (uint32_t));
+	for (i=0; i < nrec; i++) {
+	    char *v = recs[i].f[rixBits[k].field];
+
+	    if (rixBits[k].match[0] ? (strcasestr (v, rixBits[k].match) != 0)
+				    : (v[0] != '\0'))
+		bits[i / 32] |= (1U << (i % 32));
+	}
+	fwrite (bits, sizeof (uint32_t), hdr.nwords, fd);
+    }
+    free ((void *) bits);
+
+    fputc ('\0', fd);
+    for (i=0; i < nrec; i++)
+	for (j=0; j < NFIELDS; j++)
+	    if (recs[i].f[j][0])
+		fwrite (recs[i].f[j], strlen (recs[i].f[j]) + 1, 1, fd);
+    for (i=0; i < nterms; i++)
+	fwrite (tab[i]->term, strlen (tab[i]->term) + 1, 1, fd);
+
+    if (fclose (fd) != 0 || rename (tmp, path) < 0) {
+	fprintf (stderr, "ERROR: Cannot write Registry index '%s'\n", path);
+	unlink (tmp);
+	status = ERR;
+    }
+
+done:
+    for (i=0; i < nterms; i++) {
+	free ((void *) tab[i]->term);
+	free ((void *) tab[i]->post);
+	free ((void *) tab[i]);
+    }
+    free ((void *) tab);
+
+    return (status);
+}
+
+
+/*  Find or add a term in the hash table of an index being built.
+*/
+static rixTerm *
+vot_rixAddTerm (rixTerm ***tab, int *nalloc, int *nterms, char *tok)
+{
+    rixTerm **old;
+    uint32_t  h;
+    int       i, n;
+
+
+    if (2 * (*nterms + 1) > *nalloc) {
+	old = *tab, n = *nalloc;
+	*nalloc = (n ? 2 * n : 4096);
+	*tab = (rixTerm **) calloc (*nalloc, sizeof (rixTerm *));
+	for (i=0; i < n; i++) {
+	    if (old[i]) {
+		for (h = vot_rixHash (old[i]->term) & (*nalloc - 1); (*tab)[h];)
+		    h = (h + 1) & (*nalloc - 1);
+		(*tab)[h] = old[i];
+	    }
+	}
+	free ((void *) old);
+    }
+
+    for (h = vot_rixHash (tok) & (*nalloc - 1); (*tab)[h]; ) {
+	if (strcmp ((*tab)[h]->term, tok) == 0)
+	    return ((*tab)[h]);
+	h = (h + 1) & (*nalloc - 1);
+    }
+
+    (*tab)[h] = (rixTerm *) calloc (1, sizeof (rixTerm));
+    (*tab)[h]->term = strdup (tok);
+    (*nterms)++;
+
+    return ((*tab)[h]);
+}
+
+
+/*  FNV-1a hash of a string.
+*/
+static uint32_t
+vot_rixHash (char *str)
+{
+    uint32_t  h = 2166136261U;
+
+    for ( ; *str; str++)
+	h = (h ^ (unsigned char) *str) * 16777619U;
+    return (h);
+}
+
+
+static int
+vot_rixTermCmp (const void *a, const void *b)
+{
+    return (strcmp ((*(rixTerm **) a)->term, (*(rixTerm **) b)->term));
+}
+
+
+/*  Order the hits by decreasing score, then by record.
+*/
+static int
+vot_rixHitCmp (const void *a, const void *b)
+{
+    uint32_t  ra = *(uint32_t *) a, rb = *(uint32_t *) b;
+
+    if (rixScore[ra] != rixScore[rb])
+	return (rixScore[ra] > rixScore[rb] ? -1 : 1);
+    return (ra < rb ? -1 : (ra > rb));
+}
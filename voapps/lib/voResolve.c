@@ -0,0 +1,333 @@
+/************************************************************************
+**  VORESOLVE.C -- Resolve many object names at once through Sesame.
+**
+**  The names of a list are first looked up in the resolver cache, then the
+**  rest are sent to the CDS Sesame service as concurrent requests from the
+**  download engine (see voDownload.c), at most 'maxconn' at a time over
+**  reused connections, rather than one blocking round trip per name.  A
+**  name appearing more than once in the list is queried only once.
+**
+**  The cache is the single file 'sesame.db' in the 'sesame' subdirectory of
+**  the VOClient cache (see voc_getCacheDir()), a hashed append-log (see
+**  voHashLog.c) of records
+**
+**	"<name>\t<pos>\t<ra>\t<dec>\t<era>\t<edec>\t<otype>\n"
+**
+**  Names that don't resolve aren't cached.  VOC_NO_CACHE in the environment
+**  disables the cache and VOC_SESAME_URL sets another service URL.
+**
+**	    nfound = vot_resolveNames (objs, nobjs, maxconn, refresh)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include "VOClient.h"
+#include "voApps.h"
+#include "voAppsP.h"
+
+
+extern int   debug;
+
+extern char *vo_urlEncode (char *str);
+
+
+#define	RES_MAGIC	"VOSESDB1"
+#define	RES_NBUCKETS	65536		/* index size			*/
+#define	RES_NTRIES	3		/* attempts per query		*/
+#define	RES_SZLINE	1024		/* max record text		*/
+
+#define	SESAME_URL  "http://cdsweb.u-strasbg.fr/cgi-bin/nph-sesame/-oxp/NSV?"
+
+typedef struct {
+    resObj  *obj;			/* result to fill		*/
+    char    *key;			/* normalized name		*/
+    int      next;			/* next job in the hash chain	*/
+} resJob;
+
+static int   resDB		= -1;	/* cache file of a vot_resDone	*/
+
+
+int     vot_resolveNames (resObj *objs, int nobjs, int maxconn, int refresh);
+
+static int      vot_resLookup (int fd, char *key, resObj *obj);
+static void     vot_resStore (int fd, char *key, resObj *obj);
+static void     vot_resDone (dlReq *req, char *errmsg);
+static int      vot_resParse (char *xml, resObj *obj);
+static char    *vot_resElement (char *xml, char *el, char *value, int maxch);
+static char    *vot_resKey (char *name);
+
+
+
+/************************************************************************
+**  VOT_RESOLVENAMES -- Resolve the names of a list of objects.  The
+**  position of each object is set and its status set to OK if the name
+**  was resolved, ERR if not.  Cached names are queried again if 'refresh'
+**  is set.  Returns the number of names resolved.
+*/
+int
+vot_resolveNames (resObj *objs, int nobjs, int maxconn, int refresh)
+{
+    resJob  *jobs;
+    dlReq   *reqs;
+    int     *dups, *hash, nhash, njobs = 0, nfound = 0, i, j, fd;
+    char    *key, *enc, *base;
+    uint64_t h;
+
+
+    if (nobjs <= 0)
+	return (0);
+    if (maxconn <= 0)
+	maxconn = DEF_RESOLVE_CONN;
+    if (!(base = getenv ("VOC_SESAME_URL")))
+	base = SESAME_URL;
+
+    jobs  = (resJob *) calloc (nobjs, sizeof (resJob));
+    reqs  = (dlReq *) calloc (nobjs, sizeof (dlReq));
+    dups  = (int *) calloc (nobjs, sizeof (int));
+    nhash = (nobjs * 2) | 1;
+    hash  = (int *) calloc (nhash, sizeof (int));
+    for (i=0; i < nhash; i++)
+	hash[i] = -1;
+
+    /*  Look up each name, then queue a query for each distinct name not
+    **  in the cache.  'dups' holds the job of a name, or -1 if cached.
+    */
+    fd = vot_hlogOpen ("sesame", "sesame.db", RES_MAGIC, RES_NBUCKETS, 0,
+	FALSE);
+    for (i=0; i < nobjs; i++) {
+	resObj *obj = &objs[i];
+
+	obj->status = ERR;
+	obj->ra = obj->dec = obj->era = obj->edec = 0.0;
+	obj->pos[0] = obj->otype[0] = '\0';
+	dups[i] = -1;
+
+	if (!obj->name || !*(key = vot_resKey (obj->name))) {
+	    continue;
+	} else if (!refresh && fd >= 0 &&
+	    vot_resLookup (fd, key, obj) == OK) {
+	    nfound++;
+	    continue;
+	}
+
+	h = vot_hlogHash (key) % (uint64_t) nhash;
+	for (j=hash[h]; j >= 0; j=jobs[j].next)
+	    if (strcmp (jobs[j].key, key) == 0)
+		break;
+	if (j < 0) {
+	    j = njobs++;
+	    jobs[j].obj  = obj;
+	    jobs[j].key  = strdup (key);
+	    jobs[j].next = hash[h];
+	    hash[h] = j;
+
+	    enc = vo_urlEncode (key);
+	    reqs[j].url = (char *) calloc (1, strlen (base) + strlen (enc)+1);
+	    sprintf (reqs[j].url, "%s%s", base, enc);
+	    reqs[j].fname = (char *) NULL;		/* keep in memory    */
+	    reqs[j].data  = (void *) &jobs[j];
+	    free ((void *) enc);
+	}
+	dups[i] = j;
+    }
+    if (fd >= 0)
+	close (fd);
+
+    /*  Run the queries, saving the results as they arrive.
+    */
+    if (njobs > 0) {
+	if (debug)
+	    fprintf (stderr, "resolveNames: %d cached, %d to query\n",
+		nfound, njobs);
+
+	resDB = vot_hlogOpen ("sesame", "sesame.db", RES_MAGIC,
+	    RES_NBUCKETS, 0, TRUE);
+	(void) vot_dlRun (reqs, njobs, maxconn, maxconn, RES_NTRIES,
+	    vot_resDone);
+	if (resDB >= 0)
+	    close (resDB);
+	resDB = -1;
+    }
+
+    for (i=0; i < nobjs; i++) {
+	if ((j = dups[i]) < 0)
+	    continue;
+	if (jobs[j].obj != &objs[i]) {
+	    char *name = objs[i].name;
+
+	    memcpy (&objs[i], jobs[j].obj, sizeof (resObj));
+	    objs[i].name = name;
+	}
+	if (objs[i].status == OK)
+	    nfound++;
+    }
+
+    for (j=0; j < njobs; j++) {
+	free ((void *) jobs[j].key);
+	free ((void *) reqs[j].url);
+    }
+    free ((void *) jobs);
+    free ((void *) reqs);
+    free ((void *) dups);
+    free ((void *) hash);
+
+    return (nfound);
+}
+
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Completion procedure of a query:  parse the reply and cache the result.
+*/
+static void
+vot_resDone (dlReq *req, char *errmsg)
+{
+    resJob *job = (resJob *) req->data;
+
+
+    if (req->status == DL_DONE && req->buf &&
+	vot_resParse (req->buf, job->obj) == OK) {
+	    if (resDB >= 0)
+		vot_resStore (resDB, job->key, job->obj);
+    } else if (debug)
+	fprintf (stderr, "resolveNames: '%s' not resolved%s%s\n", job->key,
+	    (errmsg ? ": " : ""), (errmsg ? errmsg : ""));
+
+    if (req->buf)
+	free ((void *) req->buf);
+    req->buf = (char *) NULL;
+}
+
+
+/*  Parse a Sesame reply.  The first resolver to give a position is used.
+*/
+static int
+vot_resParse (char *xml, resObj *obj)
+{
+    char  val[SZ_LINE];
+
+
+    if (!strstr (xml, "<jradeg>"))
+	return (ERR);
+
+    obj->ra   = atof (vot_resElement (xml, "<jradeg>", val, SZ_LINE));
+    obj->dec  = atof (vot_resElement (xml, "<jdedeg>", val, SZ_LINE));
+    obj->era  = atof (vot_resElement (xml, "<errRAmas>", val, SZ_LINE));
+    obj->edec = atof (vot_resElement (xml, "<errDEmas>", val, SZ_LINE));
+    vot_resElement (xml, "<jpos>", obj->pos, SZ_RESVAL);
+    vot_resElement (xml, "<otype>", obj->otype, SZ_RESVAL);
+
+    obj->status = OK;
+    return (OK);
+}
+
+
+/*  Copy the text of the first occurrence of an element, or an empty
+**  string.  Tabs and newlines are replaced so the value can be saved in a
+**  cache record.
+*/
+static char *
+vot_resElement (char *xml, char *el, char *value, int maxch)
+{
+    char  *ip = strstr (xml, el), *op = value;
+
+
+    if (ip)
+	ip += strlen (el);
+    for ( ; ip && *ip && *ip != '<' && op < &value[maxch-1]; ip++)
+	*op++ = (isspace (*ip) ? ' ' : *ip);
+    *op = '\0';
+
+    return (value);
+}
+
+
+/*  Find the newest record of a name.
+*/
+static int
+vot_resLookup (int fd, char *key, resObj *obj)
+{
+    char    *line, *ip, *op, *field[7];
+    int      len, i;
+
+
+    if (!(line = vot_hlogLookup (fd, key, '\t', RES_SZLINE - 1, &len)))
+	return (ERR);
+
+    /*  Split the fields.
+    */
+    for (i=0, ip=line; i < 7; i++) {
+	field[i] = ip;
+	while (*ip && *ip != '\t' && *ip != '\n')
+	    ip++;
+	if (i < 6 && *ip != '\t') {
+	    free ((void *) line);
+	    return (ERR);
+	}
+	*ip++ = '\0';
+    }
+    strncpy (obj->pos, field[1], SZ_RESVAL-1);
+    obj->ra   = atof (field[2]);
+    obj->dec  = atof (field[3]);
+    obj->era  = atof (field[4]);
+    obj->edec = atof (field[5]);
+    for (op=obj->otype, ip=field[6]; *ip && op < &obj->otype[SZ_RESVAL-1];)
+	*op++ = *ip++;
+    *op = '\0';
+    free ((void *) line);
+
+    obj->status = OK;
+    return (OK);
+}
+
+
+/*  Append a record for a name.
+*/
+static void
+vot_resStore (int fd, char *key, resObj *obj)
+{
+    char     line[RES_SZLINE];
+    int      len;
+
+
+    len = snprintf (line, RES_SZLINE,
+	"%s\t%s\t%.8f\t%.8f\t%.2f\t%.2f\t%s\n", key, obj->pos,
+	obj->ra, obj->dec, obj->era, obj->edec, obj->otype);
+    if (len < RES_SZLINE)
+	(void) vot_hlogStore (fd, key, line, len);
+}
+
+
+/*  Normalize a name for the cache and the query:  leading and trailing
+**  space is removed, and runs of white space become one blank.
+*/
+static char *
+vot_resKey (char *name)
+{
+    static char  key[SZ_LINE];
+    char  *ip, *op = key;
+
+
+    for (ip=name; *ip && isspace (*ip); ip++)
+	;
+    for ( ; *ip && op < &key[SZ_LINE-2]; ip++) {
+	if (isspace (*ip)) {
+	    if (op > key && op[-1] != ' ')
+		*op++ = ' ';
+	} else
+	    *op++ = *ip;
+    }
+    while (op > key && op[-1] == ' ')
+	op--;
+    *op = '\0';
+
+    return (key);
+}
@@ -33,8 +33,10 @@ extern void   vot_printHdr (int fd, svcParams *pars);
 
 extern  void  vot_printAttrs (char *fname, Query query, char *id);
 extern  char *vot_normalize (char *str);
-extern  char *vot_getOFName (svcParams *pars, char *extn, int pid);
-extern  char *vot_getOFIndex (svcParams *pars, char *extn, int pid);
+extern  char *vot_getOFName (svcParams *pars, char *extn);
+extern  char *vot_getOFIndex (svcParams *pars, char *extn);
+extern  char *vot_cacheExec (Query query, int conn, int fmt,
+		char *(*execfn)(Query query));
 
 
 /************************************************************************
@@ -58,8 +60,8 @@ vot_callConeSvc (svcParams *pars)
 
     if ((cpid = fork()) < 0) {
 	fprintf (stderr, 
-	    "vot_callConeSvc: Unable to create child process, exiting\n");
-	vot_dalExit (-1, 0);
+	    "vot_callConeSvc: Unable to create child process\n");
+	return (-1);
 
     } else if (cpid > 0) { 			/* Parent process	*/
 	return (cpid);
@@ -117,34 +119,41 @@ vot_callConeSvc (svcParams *pars)
             switch (pars->fmt) {
             case F_ASCII:
 	        extn = "asv", delim = ' ';
-		result = voc_executeASCII (query);
+		result = vot_cacheExec (query, CONE_CONN, F_ASCII,
+		    voc_executeASCII);
 		break;
             case F_RAW:
 	        extn = "xml", delim = '\0';
-		result = voc_executeVOTable (query);
+		result = vot_cacheExec (query, CONE_CONN, F_RAW,
+		    voc_executeVOTable);
 		break;
             case F_RAW | F_XML:
                 extract |= EX_XML;
                 extn = "xml"; delim = '\0';
-                result = voc_executeVOTable (query);
+                result = vot_cacheExec (query, CONE_CONN, F_RAW,
+		    voc_executeVOTable);
                 break;
             case F_CSV:
 	        extn = "csv", delim = ',';
-		result = voc_executeCSV (query);
+		result = vot_cacheExec (query, CONE_CONN, F_CSV,
+		    voc_executeCSV);
 		break;
             case F_CSV | F_HTML:
 		extract |= EX_HTML;
 	        extn = "csv", delim = ',';
-		result = voc_executeCSV (query);      
+		result = vot_cacheExec (query, CONE_CONN, F_CSV,
+		    voc_executeCSV);      
 		break;
             case F_CSV | F_KML:
 		extract |= EX_KML;
 	        extn = "csv", delim = ',';
-		result = voc_executeCSV (query);      
+		result = vot_cacheExec (query, CONE_CONN, F_CSV,
+		    voc_executeCSV);      
 		break;
             case F_TSV:
 	        extn = "tsv", delim = '\t';
-		result = voc_executeTSV (query);      
+		result = vot_cacheExec (query, CONE_CONN, F_TSV,
+		    voc_executeTSV);      
 		break;
             default:
 	        fprintf (stderr, "coneCaller: Unknown format: %d\n", pars->fmt);
@@ -155,9 +164,10 @@ vot_callConeSvc (svcParams *pars)
    	        vot_dalExit (E_NODATA, 0);
 	    //else if (pars->fmt != F_RAW && pars->fmt != (F_RAW|F_XML))
 	    //else if (pars->fmt != F_RAW)
-	    else if (! (pars->fmt | F_RAW) )
-		res_count = vot_extractResults (result, delim, pars);
-	    else 
+	    else if (! (pars->fmt | F_RAW) ) {
+		if ((res_count = vot_extractResults (result, delim, pars)) < 0)
+		    vot_dalExit (E_FILOPEN, 0);
+	    } else 
 		res_count = vot_countResults (result);
 
             if (count && (!output || (output && output[0] != '-')))
@@ -194,7 +204,7 @@ vot_callConeSvc (svcParams *pars)
 		    /*
 		    */
 		    if (output[0] == '-')
-			strcpy (fname, vot_getOFName(pars,extn,(int)getpid()));
+			strcpy (fname, vot_getOFName(pars,extn));
 		    else
 	                sprintf (fname, "%s_%s.%s",
 		            output, vot_urlFname(pars->service_url), extn);
@@ -205,10 +215,10 @@ vot_callConeSvc (svcParams *pars)
 		        vot_urlFname(pars->service_url), extn);
 
 	    } else if (use_name || all_named || id_col) {
-		strcpy (fname, vot_getOFName (pars, extn, (int)getpid()));
+		strcpy (fname, vot_getOFName (pars, extn));
 
 	    } else {
-		strcpy (fname, vot_getOFIndex (pars, extn, (int)getpid()));
+		strcpy (fname, vot_getOFIndex (pars, extn));
 	    }
 
 	    if (output && output[0] == '-' && (! extract & EX_COLLECT)) {
@@ -27,8 +27,10 @@ extern int    vot_printCount (Query query, svcParams *pars, int *count);
 extern int    vot_countResults (char *result);
 extern char   vot_svcTypeCode (int type);
 extern char  *vot_normalize (char *str);
-extern char  *vot_getOFName (svcParams *pars, char *extn, int pid);
-extern char  *vot_getOFIndex (svcParams *pars, char *extn, int pid);
+extern char  *vot_getOFName (svcParams *pars, char *extn);
+extern char  *vot_getOFIndex (svcParams *pars, char *extn);
+extern char  *vot_cacheExec (Query query, int conn, int fmt,
+		char *(*execfn)(Query query));
 extern void   vot_printCountHdr (void);
 extern void   vot_printCountLine (int nrec, svcParams *pars);
 extern void   vot_dalExit (int code, int count);
@@ -59,8 +61,8 @@ vot_callSsapSvc (svcParams *pars)
 
     if ((cpid = fork()) < 0) {
 	fprintf (stderr, 
-	    "vot_callSsapSvc: Unable to create child process, exiting\n");
-	exit (-1);
+	    "vot_callSsapSvc: Unable to create child process\n");
+	return (-1);
 
     } else if (cpid > 0) { 			/* Parent process	*/
 	return (cpid);
@@ -124,34 +126,41 @@ vot_callSsapSvc (svcParams *pars)
             switch (pars->fmt) {
             case F_ASCII:
 	        extn = "asv"; delim = ' ';
-		result = voc_executeASCII (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_ASCII,
+		    voc_executeASCII);
 		break;
             case F_RAW:
 	        extn = "xml"; delim = '\0';
-		result = voc_executeVOTable (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_RAW,
+		    voc_executeVOTable);
 		break;
             case F_RAW | F_XML:
 		extract |= EX_XML;
 	        extn = "xml"; delim = '\0';
-		result = voc_executeVOTable (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_RAW,
+		    voc_executeVOTable);
 		break;
             case F_CSV:
 	        extn = "csv"; delim = ',';
-		result = voc_executeCSV (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_CSV,
+		    voc_executeCSV);
 		break;
             case F_CSV | F_HTML:
 		extract |= EX_HTML;
 	        extn = "csv"; delim = ',';
-		result = voc_executeCSV (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_CSV,
+		    voc_executeCSV);
 		break;
             case F_CSV | F_KML:
 		extract |= EX_KML;
 	        extn = "csv"; delim = ',';
-		result = voc_executeCSV (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_CSV,
+		    voc_executeCSV);
 		break;
             case F_TSV:
 	        extn = "tsv"; delim = '\t';
-		result = voc_executeTSV (query);
+		result = vot_cacheExec (query, SSAP_CONN, F_TSV,
+		    voc_executeTSV);
 		break;
             default:
 	        fprintf (stderr, "ssapCaller: Unknown format: %d\n", pars->fmt);
@@ -160,9 +169,10 @@ vot_callSsapSvc (svcParams *pars)
 
  	    if (!result)
    	        vot_dalExit (E_NODATA, 0);
-	    else if (pars->fmt != F_RAW)
-		res_count = vot_extractResults (result, delim, pars);
-	    else  if (pars->fmt == F_RAW)
+	    else if (pars->fmt != F_RAW) {
+		if ((res_count = vot_extractResults (result, delim, pars)) < 0)
+		    vot_dalExit (E_FILOPEN, 0);
+	    } else  if (pars->fmt == F_RAW)
 		res_count = vot_countResults (result);
 
             if (count && (!output || (output && output[0] != '-')))
@@ -191,9 +201,9 @@ vot_callSsapSvc (svcParams *pars)
 	    }
 
             if (use_name || all_named || id_col)
-                strcpy (fname, vot_getOFName (pars, extn, (int)getpid()));
+                strcpy (fname, vot_getOFName (pars, extn));
             else
-                strcpy (fname, vot_getOFIndex (pars, extn, (int)getpid()));
+                strcpy (fname, vot_getOFIndex (pars, extn));
 
 
             if (output && output[0] == '-' && (! extract & EX_COLLECT)) {
@@ -0,0 +1,523 @@
+/************************************************************************
+**  VOSINK.C -- Aggregate in-process query results into one output per
+**  service.
+**
+**  For one-file output the forked queries each write a result file which
+**  vot_concat() reads back and stitches together once all queries are
+**  done.  Queries run in-process instead hand their VOTable response to
+**  the sink of their service, which appends the rows to that service's
+**  output as each query finishes, preceded by 'svc' and 'obj' columns to
+**  say where they came from.  No per-query files are created.
+**
+**  Delimited (CSV/TSV/ASCII) and VOTable output is streamed.  A FITS table
+**  needs its column widths before the first row is written, so the rows
+**  of a FITS sink are held until the sink is closed.  On the standard
+**  output the services are written in turn when the sinks are closed, the
+**  text forms from a temp file and the FITS tables as extensions of a
+**  single file.  The table schema of
+**  a service is taken from its first result with a table; rows of later
+**  results are padded or truncated to it.
+**
+**	    stat = vot_sinkInit ()
+**	   nrows = vot_sinkResult (pars, votable)
+**		   vot_sinkClose ()
+**	   bool  = vot_sinkEnabled ()
+**
+**  Callers are serialized by the 'vot_dalLock':  the VOTable parser used
+**  to read the responses is not reentrant.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "VOClient.h"
+#include "voAppsP.h"
+#include "votParse.h"
+#include "fitsio.h"
+
+
+extern int  format, extract, quiet, use_name, all_named, id_col;
+extern char *output;
+
+extern  char *vot_getOFName (svcParams *pars, char *extn);
+extern  char *vot_getOFIndex (svcParams *pars, char *extn);
+extern  char *vot_getSName (char *root);
+extern  char *vot_getExtn (void);
+
+extern  void  vot_fitsTForm (char *tform, char *dtype, char *asize,
+		int width, int spaces);
+extern  int   vot_writeFITSData (fitsfile *fp, char **data, char *fmt[],
+		int nrows, int ncols, long frow);
+
+
+#define	SINK_NATTR	9		/* FIELD attributes copied	*/
+#define	SINK_CHUNK	4096		/* FITS cell allocation chunk	*/
+
+static char *sinkAttrs[SINK_NATTR] = {
+    "name", "ID", "ucd", "utype", "datatype", "arraysize", "width",
+    "precision", "unit"
+};
+
+typedef struct voSink {
+    int      svc_index;			/* service index		*/
+    char     fname[SZ_FNAME];		/* output name ('-' = stdout)	*/
+    char     sname[SZ_LINE];		/* service name			*/
+    FILE    *fd;			/* text/VOTable output		*/
+    char     delim;			/* column delimiter		*/
+
+    int      ncols;			/* result columns (0 = no schema)*/
+    char   **attrs;			/* FIELD attrs [ncols*NATTR]	*/
+    int      nrows;			/* rows written			*/
+
+    char   **cells;			/* FITS:  held cells		*/
+    int      ncells, szcells;
+
+    struct voSink *next;
+} voSink;
+
+
+static voSink *sinkList	= (voSink *) NULL;
+static int     sinkOn	= FALSE;
+
+
+int     vot_sinkInit (void);
+int     vot_sinkResult (svcParams *pars, char *votable);
+void    vot_sinkClose (void);
+int     vot_sinkEnabled (void);
+
+static voSink *vot_getSink (svcParams *pars);
+static void  vot_sinkSchema (voSink *sk, handle_t tab);
+static void  vot_sinkHeader (voSink *sk);
+static void  vot_sinkValue (voSink *sk, char *val, int last);
+static void  vot_sinkKeep (voSink *sk, char *val);
+static void  vot_sinkFITS (voSink *sk, fitsfile *fp);
+static void  vot_sinkXML (FILE *fd, char *s);
+
+
+
+/************************************************************************
+**  VOT_SINKINIT -- Enable the sinks if the output can be aggregated by
+**  them:  one-file delimited, VOTable or FITS output with no other
+**  extractions requested.  Returns TRUE if enabled.
+*/
+int
+vot_sinkInit ()
+{
+    sinkList = (voSink *) NULL;
+    sinkOn = ((extract & EX_COLLECT) &&
+	      !(extract & ~(EX_COLLECT|EX_SAVE)) &&
+	      (format == F_CSV || format == F_TSV || format == F_ASCII ||
+	       format == F_RAW || format == F_FITS));
+
+    return (sinkOn);
+}
+
+
+/************************************************************************
+**  VOT_SINKENABLED -- See whether results go to the sinks.
+*/
+int
+vot_sinkEnabled ()
+{
+    return (sinkOn);
+}
+
+
+/************************************************************************
+**  VOT_SINKRESULT -- Append the rows of a query's VOTable response to the
+**  sink of its service.  Returns the number of rows.
+*/
+int
+vot_sinkResult (svcParams *pars, char *votable)
+{
+    handle_t  vot, res, tab, data, tdata, tr, td;
+    voSink   *sk;
+    char      obj[SZ_LINE], *val;
+    int       i, nr = 0;
+
+
+    if (!votable || (vot = vot_openVOTABLE (votable)) <= 0)
+	return (0);
+
+    if ((res = vot_getRESOURCE (vot)) <= 0 ||
+	(tab = vot_getTABLE (res)) <= 0 ||
+	(data = vot_getDATA (tab)) <= 0 ||
+	(tdata = vot_getTABLEDATA (data)) <= 0) {
+	    vot_closeVOTABLE (vot);
+	    return (0);
+    }
+
+    if ((sk = vot_getSink (pars)) == (voSink *) NULL) {
+	vot_closeVOTABLE (vot);
+	return (0);
+    }
+    if (sk->ncols == 0) {
+	vot_sinkSchema (sk, tab);
+	vot_sinkHeader (sk);
+    }
+
+    /*  The object is identified by its name, or its number for a plain
+    **  position.
+    */
+    memset (obj, 0, SZ_LINE);
+    if (pars->oname[0])
+	strncpy (obj, pars->oname, SZ_LINE-1);
+    else
+	sprintf (obj, "%d", pars->index);
+
+    for (tr=vot_getTR (tdata); tr; tr=vot_getNext (tr), nr++) {
+	if (format == F_RAW)
+	    fprintf (sk->fd, "<TR>");
+
+	vot_sinkValue (sk, pars->name, FALSE);
+	vot_sinkValue (sk, obj, FALSE);
+	for (i=0, td=vot_getTD (tr); i < sk->ncols; i++) {
+	    val = (td ? vot_getValue (td) : NULL);
+	    vot_sinkValue (sk, (val ? val : ""), (i == sk->ncols - 1));
+	    if (td)
+		td = vot_getNext (td);
+	}
+
+	if (format == F_RAW)
+	    fprintf (sk->fd, "</TR>\n");
+	else if (format != F_FITS)
+	    fprintf (sk->fd, "\n");
+    }
+    sk->nrows += nr;
+
+    if (sk->fd)
+	fflush (sk->fd);
+    vot_closeVOTABLE (vot);
+
+    return (nr);
+}
+
+
+/************************************************************************
+**  VOT_SINKCLOSE -- Finish and close all the service outputs.
+*/
+void
+vot_sinkClose ()
+{
+    voSink   *sk, *next;
+    fitsfile *fp = (fitsfile *) NULL;
+    char      buf[SZ_LINE];
+    int       i, n, status = 0;
+
+
+    for (sk=sinkList; sk; sk=next) {
+	next = sk->next;
+
+	if (format == F_FITS && sk->ncols > 0) {
+	    if (sk->fname[0] != '-' || !fp) {
+		if (access (sk->fname, F_OK) == 0)	/* replace old file  */
+		    unlink (sk->fname);
+		if (fits_create_file (&fp, sk->fname, &status))
+		    fits_report_error (stderr, status);
+	    }
+	    if (fp)
+		vot_sinkFITS (sk, fp);
+	    if (fp && sk->fname[0] != '-') {
+		fits_close_file (fp, &status);
+		fp = (fitsfile *) NULL;
+	    }
+	    status = 0;
+
+	} else if (sk->fd && format == F_RAW) {
+	    fprintf (sk->fd, "</TABLEDATA></DATA>\n</TABLE>\n</RESOURCE>\n");
+	    fprintf (sk->fd, "</VOTABLE>\n");
+	}
+
+	if (sk->fd && sk->fname[0] == '-') {
+	    rewind (sk->fd);			/* copy temp file to stdout */
+	    while ((n = fread (buf, 1, SZ_LINE, sk->fd)) > 0)
+		fwrite (buf, 1, n, stdout);
+	    fflush (stdout);
+	}
+	if (sk->fd)
+	    fclose (sk->fd);
+
+	if (!quiet && sk->fname[0] != '-')
+	    fprintf (stderr, "# Wrote %d rows to '%s'\n", sk->nrows, sk->fname);
+
+	for (i=0; i < sk->ncells; i++)
+	    free ((void *) sk->cells[i]);
+	for (i=0; i < sk->ncols * SINK_NATTR; i++)
+	    if (sk->attrs[i])
+		free ((void *) sk->attrs[i]);
+	if (sk->cells)
+	    free ((void *) sk->cells);
+	if (sk->attrs)
+	    free ((void *) sk->attrs);
+	free ((void *) sk);
+    }
+
+    if (fp)
+	fits_close_file (fp, &status);
+
+    sinkList = (voSink *) NULL;
+    sinkOn = FALSE;
+}
+
+
+/************************************************************************
+**  Private procedures.
+*/
+
+/*  Find the sink of a query's service, opening it on first use.  The
+**  output is named as vot_concat() would name it.  The sinks are kept in
+**  service order.
+*/
+static voSink *
+vot_getSink (svcParams *pars)
+{
+    voSink *sk, **prev;
+    char   *root, *extn = vot_getExtn ();
+    int     pid = (int) getpid ();
+
+
+    for (sk=sinkList; sk; sk=sk->next)
+	if (sk->svc_index == pars->svc_index)
+	    return (sk);
+
+    sk = (voSink *) calloc (1, sizeof (voSink));
+    sk->svc_index = pars->svc_index;
+    strncpy (sk->sname, pars->name, SZ_LINE-1);
+    sk->delim = (format == F_TSV ? '\t' : (format == F_ASCII ? ' ' : ','));
+
+    if (output && output[0] == '-') {
+	strcpy (sk->fname, "-");
+	if (format != F_FITS && (sk->fd = tmpfile ()) == (FILE *) NULL) {
+	    fprintf (stderr, "ERROR: Cannot open temp file\n");
+	    free ((void *) sk);
+	    return ((voSink *) NULL);
+	}
+    } else {
+	root = ((use_name || all_named || id_col) ?
+	    vot_getOFName (pars, NULL) : vot_getOFIndex (pars, NULL));
+	sprintf (sk->fname, "%s_%d.%s", vot_getSName (root), pid, extn);
+
+	if (format != F_FITS &&
+	    (sk->fd = fopen (sk->fname, "w+")) == (FILE *) NULL) {
+	        fprintf (stderr, "ERROR: Cannot open output file: '%s'\n",
+		    sk->fname);
+	        free ((void *) sk);
+	        return ((voSink *) NULL);
+	}
+    }
+
+    for (prev=&sinkList; *prev; prev=&(*prev)->next)
+	if ((*prev)->svc_index > sk->svc_index)
+	    break;
+    sk->next = *prev;
+    *prev = sk;
+
+    return (sk);
+}
+
+
+/*  Take the table schema of the sink from its first result.
+*/
+static void
+vot_sinkSchema (voSink *sk, handle_t tab)
+{
+    handle_t field;
+    int      i, j;
+
+
+    for (field=vot_getFIELD (tab); field; field=vot_getNext (field))
+	sk->ncols++;
+
+    sk->attrs = (char **) calloc (max(1,sk->ncols) * SINK_NATTR,
+	sizeof (char *));
+    for (i=0, field=vot_getFIELD (tab); field; field=vot_getNext (field), i++)
+	for (j=0; j < SINK_NATTR; j++)
+	    sk->attrs[i*SINK_NATTR+j] = vot_getAttr (field, sinkAttrs[j]);
+}
+
+
+/*  Write the header of the output.
+*/
+static void
+vot_sinkHeader (voSink *sk)
+{
+    char   *val, col[SZ_LINE];
+    int     i, j;
+
+
+    if (format == F_FITS || !sk->fd)
+	return;
+
+    if (format == F_RAW) {
+	fprintf (sk->fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf (sk->fd, "<VOTABLE version=\"1.1\">\n<RESOURCE>\n<TABLE>\n");
+	fprintf (sk->fd, "<FIELD name=\"svc\" datatype=\"char\" ");
+	fprintf (sk->fd, "arraysize=\"*\" ucd=\"meta.id\"/>\n");
+	fprintf (sk->fd, "<FIELD name=\"obj\" datatype=\"char\" ");
+	fprintf (sk->fd, "arraysize=\"*\" ucd=\"meta.id;src\"/>\n");
+
+	for (i=0; i < sk->ncols; i++) {
+	    fprintf (sk->fd, "<FIELD");
+	    for (j=0; j < SINK_NATTR; j++) {
+		if ((val = sk->attrs[i*SINK_NATTR+j])) {
+		    fprintf (sk->fd, " %s=\"", sinkAttrs[j]);
+		    vot_sinkXML (sk->fd, val);
+		    fprintf (sk->fd, "\"");
+		}
+	    }
+	    fprintf (sk->fd, "/>\n");
+	}
+	fprintf (sk->fd, "<DATA><TABLEDATA>\n");
+
+    } else {
+	fprintf (sk->fd, "svc%cobj", sk->delim);
+	for (i=0; i < sk->ncols; i++) {
+	    if (!(val = sk->attrs[i*SINK_NATTR]))	/* name or ID	*/
+		val = sk->attrs[i*SINK_NATTR+1];
+	    if (!val) {
+		sprintf (col, "col%d", i);
+		val = col;
+	    }
+	    fprintf (sk->fd, "%c%s", sk->delim, val);
+	}
+	fprintf (sk->fd, "\n");
+    }
+}
+
+
+/*  Write (or hold) one value of a row.
+*/
+static void
+vot_sinkValue (voSink *sk, char *val, int last)
+{
+    switch (format) {
+    case F_FITS:
+	vot_sinkKeep (sk, val);
+	break;
+    case F_RAW:
+	fprintf (sk->fd, "<TD>");
+	vot_sinkXML (sk->fd, val);
+	fprintf (sk->fd, "</TD>");
+	break;
+    default:
+	if (strchr (val, (int) sk->delim) || strchr (val, (int) ' '))
+	    fprintf (sk->fd, "\"%s\"", val);
+	else
+	    fputs (val, sk->fd);
+	if (!last)
+	    fputc (sk->delim, sk->fd);
+	break;
+    }
+}
+
+
+/*  Hold a FITS cell until the sink is closed.
+*/
+static void
+vot_sinkKeep (voSink *sk, char *val)
+{
+    if (sk->ncells == sk->szcells) {
+	sk->szcells += SINK_CHUNK;
+	sk->cells = (char **) realloc (sk->cells,
+	    sk->szcells * sizeof (char *));
+    }
+    sk->cells[sk->ncells++] = strdup (val);
+}
+
+
+/*  Write the held rows of a sink as a FITS binary table extension.
+*/
+static void
+vot_sinkFITS (voSink *sk, fitsfile *fp)
+{
+    char    **ttype, **tform, **tunit, *cell, *ch;
+    int       i, j, len, ncols = sk->ncols + 2, *widths, *spaces;
+    int       status = 0;
+    long      naxes[2] = { 0, 0 };
+
+
+    if (fits_get_num_hdus (fp, &i, &status) == 0 && i == 0 &&
+        fits_create_img (fp, 8, 0, naxes, &status)) {
+	    fits_report_error (stderr, status);
+	    return;
+    }
+
+    /*  Size the columns from the data, as vot_writeFITS() does.
+    */
+    widths = (int *) calloc (ncols, sizeof (int));
+    spaces = (int *) calloc (ncols, sizeof (int));
+    for (i=0; i < sk->nrows; i++) {
+	for (j=0; j < ncols; j++) {
+	    cell = sk->cells[i*ncols+j];
+	    if ((len = strlen (cell)) > widths[j])
+		widths[j] = len;
+	    if (i == 0 && j >= 2 && len > 1 && strchr (cell, (int)' ')) {
+		for (ch=&cell[len-1]; isspace(*ch) && ch > cell; ch--)
+		    *ch = '\0';
+		for (ch=cell; isspace(*ch); )
+		    ch++;
+		for (       ; *ch; ch++)
+		    if (*ch == ' ')
+			spaces[j]++;
+	    }
+	}
+    }
+
+    ttype = (char **) calloc (ncols, sizeof (char *));
+    tform = (char **) calloc (ncols, sizeof (char *));
+    tunit = (char **) calloc (ncols, sizeof (char *));
+    for (j=0; j < ncols; j++) {
+	tform[j] = calloc (1, 16);
+	if (j < 2) {
+	    ttype[j] = strdup (j ? "obj" : "svc");
+	    tunit[j] = strdup ("");
+	    vot_fitsTForm (tform[j], "char", "*", max(1,widths[j]), 0);
+	} else {
+	    char **a = &sk->attrs[(j-2)*SINK_NATTR];
+
+	    ttype[j] = calloc (1, SZ_LINE);
+	    if (a[0] || a[1])
+		strncpy (ttype[j], (a[0] ? a[0] : a[1]), SZ_LINE-1);
+	    else
+		sprintf (ttype[j], "col%d", j - 1);
+	    tunit[j] = strdup (a[8] ? a[8] : "");
+	    vot_fitsTForm (tform[j], a[4], a[5], max(1,widths[j]), spaces[j]);
+	}
+    }
+
+    if (fits_create_tbl (fp, BINARY_TBL, sk->nrows, ncols, ttype, tform,
+	tunit, sk->sname, &status)) {
+	    fits_report_error (stderr, status);
+    } else if (sk->nrows > 0)
+	vot_writeFITSData (fp, sk->cells, tform, sk->nrows, ncols, 1L);
+
+    for (j=0; j < ncols; j++) {
+	free ((void *) ttype[j]);
+	free ((void *) tform[j]);
+	free ((void *) tunit[j]);
+    }
+    free ((void *) ttype);
+    free ((void *) tform);
+    free ((void *) tunit);
+    free ((void *) widths);
+    free ((void *) spaces);
+}
+
+
+/*  Write a string with the XML special characters escaped.
+*/
+static void
+vot_sinkXML (FILE *fd, char *s)
+{
+    for ( ; *s; s++) {
+	switch (*s) {
+	case '<':	fputs ("&lt;", fd);	break;
+	case '>':	fputs ("&gt;", fd);	break;
+	case '&':	fputs ("&amp;", fd);	break;
+	case '"':	fputs ("&quot;", fd);	break;
+	default:	fputc (*s, fd);		break;
+	}
+    }
+}
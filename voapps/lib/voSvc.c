@@ -13,6 +13,8 @@
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <poll.h>
 #include "VOClient.h"
 #include "votParse.h"
 #include "voAppsP.h"
@@ -34,12 +36,23 @@ extern Service *svcList, *svcTail;
 
 int svcIndex	= 0;
 
+#define	SZ_FEEDBUF	65536		/* service feed buffer		*/
+
+static int   svcFeed	= -1;		/* service feed descriptor	*/
+static char *feedBuf	= (char *) NULL;
+static int   feedLen	= 0;
+
 
 int    vot_parseServiceList (char *list, int dalOnly);
 int    vot_printServiceList (FILE *fd);
 int    vot_printServiceVOTable (FILE *fd);
 int    vot_isSupportedSvc (char *type);
 
+void   vot_svcFeedOpen (int fd);
+int    vot_svcFeedRead (int nwait);
+int    vot_svcFeedActive (void);
+void   vot_svcFeedClose (void);
+
 void   vot_addToSvcList (char *name, char *ident,char *url, char *type,
 				char *title);
 void   vot_freeServiceList (void);
@@ -49,6 +62,7 @@ void   vot_readSvcFile (char *fname, int dalOnly);
 static int vot_serviceResolver (char *idlist, int dalOnly);
 static int isResourceVOTable (char *fname);
 static int vot_loadResourceVOTable (char *fname);
+static int vot_svcFeedLine (char *line);
 
 static void  vot_regCacheResults (char *fname, char *results, int nres);
 
@@ -87,7 +101,14 @@ vot_parseServiceList (char *list, int dalOnly)
     extern char *vot_getline (FILE *fd);
 
 
-    if (access (list, R_OK) == 0) {
+    if (svcFeed >= 0) {
+	/*  The services are coming from a feed, wait for the first of them
+	**  (enough that a list of more than one is treated as such) and
+	**  take the rest as the queries run.
+	*/
+	nservices += vot_svcFeedRead (2);
+
+    } else if (access (list, R_OK) == 0) {
 
 	if (isResourceVOTable (list)) {
 	    nservices += vot_loadResourceVOTable (list);
@@ -209,6 +230,134 @@ vot_loadResourceVOTable (char *fname)
 }
 
 
+/****************************************************************************
+**  SVCFEED -- A service list arriving while the queries run.  The task
+**  producing the list (e.g. the Registry query of votopic) writes each
+**  service to a pipe as the line
+**
+**	<name> \t <identifier> \t <url> \t <type> \t <title> \n
+**
+**  as soon as it has it.  vot_svcFeedRead() adds the services that have
+**  arrived to the service list, waiting until at least 'nwait' are added
+**  or the feed ends.  The pipe is the bounded queue between the two:  the
+**  producer blocks when it is full and the reader (vot_runSvcQueries())
+**  stops taking services while enough are already waiting to be queried.
+*/
+void
+vot_svcFeedOpen (int fd)
+{
+    svcFeed = fd;
+    feedLen = 0;
+    if (!feedBuf)
+	feedBuf = calloc (1, SZ_FEEDBUF + 1);
+}
+
+
+int
+vot_svcFeedRead (int nwait)
+{
+    struct pollfd pfd;
+    char  *ip, *nl;
+    int    nadd = 0, n;
+
+
+    while (svcFeed >= 0) {
+	pfd.fd = svcFeed;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if ((n = poll (&pfd, 1, (nadd < nwait ? -1 : 0))) < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0)
+	    break;				/* nothing more right now */
+
+	if ((n = read (svcFeed, &feedBuf[feedLen], SZ_FEEDBUF - feedLen)) < 0
+	    && errno == EINTR)
+		continue;
+	if (n <= 0) {
+	    vot_svcFeedClose ();		/* producer is done	*/
+	    break;
+	}
+	feedLen += n;
+	feedBuf[feedLen] = '\0';
+
+	/*  Add the complete lines, keep any partial one for the next read.
+	*/
+	for (ip=feedBuf; (nl = strchr (ip, '\n')); ip = nl + 1) {
+	    *nl = '\0';
+	    nadd += vot_svcFeedLine (ip);
+	}
+	if ((feedLen -= (ip - feedBuf)) >= SZ_FEEDBUF)
+	    feedLen = 0;			/* drop an overlong line */
+	memmove (feedBuf, ip, feedLen);
+    }
+
+    return (nadd);
+}
+
+
+int
+vot_svcFeedActive (void)
+{
+    return (svcFeed >= 0);
+}
+
+
+void
+vot_svcFeedClose (void)
+{
+    if (svcFeed >= 0)
+	close (svcFeed);
+    svcFeed = -1;
+    feedLen = 0;
+}
+
+
+/*  Add the service of one feed line.  Returns 1 if it was added.
+*/
+static int
+vot_svcFeedLine (char *line)
+{
+    char  *f[5], *ip;
+    char  url[SZ_LINE], name[SZ_FNAME], id[SZ_FNAME];
+    char  type[SZ_FNAME], title[SZ_LINE];
+    Service *tail;
+    int   n;
+
+
+    for (n=0, ip=line; n < 5 && ip; n++) {
+	f[n] = ip;
+	if ((ip = strchr (ip, '\t')))
+	    *ip++ = '\0';
+    }
+    if (n < 5)
+	return (0);
+
+    memset (name,  0, SZ_FNAME);   strncpy (name,  f[0], SZ_FNAME - 1);
+    memset (id,    0, SZ_FNAME);   strncpy (id,    f[1], SZ_FNAME - 1);
+    memset (url,   0, SZ_LINE);    strncpy (url,   f[2], SZ_LINE - 1);
+    memset (type,  0, SZ_FNAME);   strncpy (type,  f[3], SZ_FNAME - 1);
+    memset (title, 0, SZ_LINE);    strncpy (title, f[4], SZ_LINE - 1);
+
+    if (strcasestr ("SimpleImageAccess", type))
+        strcpy (type, "SIAP");
+    if (strcasestr ("ConeSearch", type))
+        strcpy (type, "CONE");
+    if (strcasestr ("skyservice", type))
+        strcpy (type, "TABULARSKYSERVICE");
+
+    if (! vot_isSupportedSvc (type) && !meta && !inventory) {
+	if (!quiet && verbose > 1)
+            fprintf (stderr,
+	        "# Unsupported type %s for '%s', skipping...\n", type, name);
+	return (0);
+    }
+    tail = svcTail;
+    vot_addToSvcList (name, id, url, type, title);
+
+    return (svcTail != tail);
+}
+
+
 /****************************************************************************
 **  ISRESOURCEVOTABLE --  Test a file or string to see if it's a Resource 
 **  VOTable by looking for a <FIELD> element with a 'ShortName' attribute.
@@ -1,6 +1,16 @@
 /**
  *  VOTASK.C -- Utilities to run a VOApps task as a connected subprocess.
  *
+ *  Tasks are normally run in a forked child with the result returned over
+ *  a pipe.  Callers that run many small tasks may instead select the
+ *  in-process mode (vo_setTaskMode(VO_TASK_THREAD), or VOAPP_TASKMODE=thread
+ *  in the environment):  the task runs on a thread of the calling process
+ *  and the result buffer it allocates is handed back as-is.  Tasks keep
+ *  static state and parse arguments with getopt(), so in-process runs are
+ *  serialized.  Each task resets its options on entry and returns errors
+ *  rather than calling exit(), only the processes a task forks itself (e.g.
+ *  the vosamp proxy or a detached votget) exit.
+ *
  *  @file       voTask.c
  *  @author     Mike Fitzpatrick
  *  @date       6/23/12
@@ -17,6 +27,8 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <setjmp.h>
+#include <pthread.h>
+#include <getopt.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/select.h>
@@ -40,12 +52,28 @@
 #define OK		0
 
 #define MAX_TASK_ARGS	64
+#define SZ_TASK_STACK	(16*1024*1024)	/* in-process task stack size	*/
 
     
 static int  rpipe[2]	= {-1, -1};	/* subprocess read pipes	*/
 static int  wpipe[2]	= {-1, -1};	/* subprocess write pipes	*/
 static int  nr 		= 0;
 
+static int  task_mode	= -1;		/* execution mode (-1 = unset)	*/
+static pthread_mutex_t task_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*  In-process task state, passed to the task thread.
+ */
+typedef struct {
+    Task   *app;			/* task to run			*/
+    int     argc;			/* argument count		*/
+    char  **argv;			/* argument vector		*/
+    size_t  len;			/* result length		*/
+    void   *result;			/* result object		*/
+    int     status;			/* task status			*/
+} taskThread;
+
 
 
 /*  Internal procedures.
@@ -56,6 +84,9 @@ static void    *vo_taskResult (pid_t pid, size_t len);
 static void     vo_taskReaper (int sig, int *arg1, int *arg2);
 static size_t   vo_taskRead (int fd, void *data, size_t len);
 static size_t   vo_taskWrite (int fd, void *data, size_t len);
+static int      vo_taskThreadRun (char *method, Task *apps, int argc, 
+			char **argv, size_t *len, void **result);
+static void    *vo_taskThread (void *data);
 
 typedef void  (*SIGFUNC)();
 
@@ -100,6 +131,9 @@ vo_runTask (char *method, Task *apps, int argc, char **argv, size_t *len, void *
 
     memset (err, 0, 128);
 
+    if (vo_getTaskMode () == VO_TASK_THREAD)
+	return (vo_taskThreadRun (method, apps, argc, argv, len, result));
+
     old_sigcld = (SIGFUNC) signal (SIGCHLD, (SIGFUNC) vo_taskReaper);
     vo_signal_status = 0;
     vo_exit_status   = 0;
@@ -146,6 +180,50 @@ vo_runTask (char *method, Task *apps, int argc, char **argv, size_t *len, void *
 }
 
 
+/**
+ *  VO_SETTASKMODE -- Set how vo_runTask() executes a task.
+ *
+ *  @brief  Set how vo_runTask() executes a task.
+ *  @fn     int vo_setTaskMode (int mode)
+ *
+ *  @param   mode	VO_TASK_FORK or VO_TASK_THREAD
+ *  @return             previous mode
+ */
+int
+vo_setTaskMode (int mode)
+{
+    int  old = vo_getTaskMode ();
+
+    task_mode = (mode == VO_TASK_THREAD ? VO_TASK_THREAD : VO_TASK_FORK);
+    return (old);
+}
+
+
+/**
+ *  VO_GETTASKMODE -- Get how vo_runTask() executes a task.
+ *
+ *  @brief  Get how vo_runTask() executes a task.
+ *  @fn     int vo_getTaskMode (void)
+ *
+ *  @return             VO_TASK_FORK or VO_TASK_THREAD
+ *
+ *  Unless set with vo_setTaskMode(), the VOAPP_TASKMODE environment
+ *  variable ("fork" or "thread") selects the mode, the default is to fork.
+ */
+int
+vo_getTaskMode (void)
+{
+    char  *mode = NULL;
+
+    if (task_mode < 0) {
+	mode = getenv ("VOAPP_TASKMODE");
+	task_mode = ((mode && strcasecmp (mode, "thread") == 0) ? 
+	    VO_TASK_THREAD : VO_TASK_FORK);
+    }
+    return (task_mode);
+}
+
+
 /**
  *  VO_TASKTEST -- Execute a task as a unit test.
  *
@@ -721,6 +799,91 @@ vo_taskWrite (int fd, void *vptr, size_t nbytes)
 
 
 
+/**
+ *  VO_TASKTHREADRUN -- Run a task on a thread of the calling process.
+ *
+ *  @brief  Run a task on a thread of the calling process.
+ *  @fn     int vo_taskThreadRun (char *method, Task *apps, int argc, 
+ *				char *argv[], size_t *len, void **result)
+ *
+ *  @param   method     task name to call
+ *  @param   apps       application table
+ *  @param   argc       argument count
+ *  @param   argv       argument vector
+ *  @param   len        length of result object
+ *  @param   result     pointer to result object
+ *  @return             status (0=OK, 1=ERR)
+ *
+ *  The result is the buffer allocated by the task, nothing is copied.  The
+ *  thread gets a large stack since tasks keep big buffers on the stack.
+ */
+static int
+vo_taskThreadRun (char *method, Task *apps, int argc, char **argv, 
+			size_t *len, void **result)
+{
+    Task  *app = (Task *) NULL;
+    taskThread  tt;
+    pthread_t   tid;
+    pthread_attr_t  attr;
+
+    extern  int optind;
+#ifdef Darwin
+    extern  int optreset;
+#endif
+
+
+    for (app = apps; app->name; app++)
+	if (strcmp (app->name, method) == 0)
+	    break;
+    if (app->name == NULL) {
+	*len    = strlen (E_NOTFOUND);
+	*result = (void *) strdup (E_NOTFOUND);
+	return (EXIT_FAILURE);
+    }
+
+    memset (&tt, 0, sizeof (tt));
+    tt.app  = app;
+    tt.argc = argc;
+    tt.argv = argv;
+
+    /*  Tasks share getopt() and their own static state, run one at a time.
+     */
+    pthread_mutex_lock (&task_lock);
+    optind   = 0;
+#ifdef Darwin
+    optreset = 1;
+#endif
+
+    pthread_attr_init (&attr);
+    pthread_attr_setstacksize (&attr, SZ_TASK_STACK);
+    if (pthread_create (&tid, &attr, vo_taskThread, (void *) &tt) == 0)
+	pthread_join (tid, NULL);
+    else
+	vo_taskThread ((void *) &tt);	/* run on the caller's stack	*/
+    pthread_attr_destroy (&attr);
+
+    pthread_mutex_unlock (&task_lock);
+
+    *len    = tt.len;
+    *result = tt.result;
+    return (tt.status);
+}
+
+
+/**
+ *  VO_TASKTHREAD -- Task thread entry point.
+ */
+static void *
+vo_taskThread (void *data)
+{
+    taskThread *tt = (taskThread *) data;
+
+    tt->status = (*tt->app->func) (tt->argc, tt->argv, &tt->len, &tt->result);
+    return ((void *) NULL);
+}
+
+
+
 #ifdef VO_UNIT_TESTS
 
 /************************************************************************/
@@ -37,7 +37,7 @@ static int  reg_nresolved 	= 0;
 
 
 extern int  verbose, count, debug, errno, meta, res_all, quiet, do_votable;
-extern int  group, nterms, table_hskip, ecols;
+extern int  group, nterms, table_hskip, ecols, reg_local, reg_feed;
 extern char *terms[], *delim;
 
 
@@ -57,6 +57,9 @@ void  ppResSummary (char *result, int nresults);
 
 void  vot_skipHdr (FILE *fd);
 char *vot_getTableCol (char *line, int col, int span);
+char *vot_tableCol (char *line, int col, int span, char *value);
+char *vot_normCoord (char *coord, char *norm);
+char *vot_normName (char *str, char *name);
 int   vot_isNumericField (handle_t field);
 int   vot_fileType (char *fname);
 
@@ -87,6 +90,7 @@ double	vot_atof (char *val);
 void   vot_setArg (char **argv, int *argc, char *value);
 void   vot_printRegVOTableHdr (FILE *fd);
 void   vot_printRegVOTableRec (FILE *fd, RegResult resource, int recnum);
+void   vot_printRegFeedRec (FILE *fd, RegResult resource, int recnum);
 void   vot_printRegVOTableTail (FILE *fd);
 
 extern char *strcasestr ();
@@ -507,6 +511,21 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
     bzero (keyws, SZ_RESBUF);
     
 
+    /* Answer the search from the local Registry index if we can.
+    */
+    if (reg_local && (nresults = vot_regIdxSearch (ids, nids, svctype, 
+	bpass, subject, clevel, orValues, dalOnly)) >= 0) {
+	    for (i=0; i < nids && strcmp ("any", ids[0]); i++) {
+		if (keyws[0])
+		    strcat (keyws, " ");
+		strcat (keyws, ids[i]);
+	    }
+	    res = REG_LOCALRES;
+	    goto query_done;
+    }
+    if (reg_local && vot_regIdxConnect () == ERR)
+	return (0);			/* sent on to the Registry	*/
+
     /* Extract any terms that may be ADQL strings.
     */
     for (i=0; i < nids; i++) {
@@ -670,6 +689,7 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	    qstring, keyws, nresults);
 	
 
+query_done:
     /* No longer need the query buffers so free them here.
     */
     if (svcstr) free (svcstr);
@@ -683,7 +703,7 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	results = (char *)calloc (1, (nresults * 30));
 	strcpy (results, " \t");
         for (i=0; i < nresults; i++) {
-            attr_val = voc_resGetStr (res, attr_list[1], i);	/* SvcType    */
+            attr_val = vot_regGetStr (res, attr_list[1], i);	/* SvcType    */
 	    strcat (results, (attr_val ? attr_val : " "));
 	    strcat (results, "\t \n\t");
 	    voc_freePointer ((char *) attr_val);
@@ -703,7 +723,10 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 
     if (votable) {
         for (i=0; i < nresults; i++) {
-	    vot_printRegVOTableRec (vot_fd, res, i);
+	    if (reg_feed)
+	        vot_printRegFeedRec (vot_fd, res, i);
+	    else
+	        vot_printRegVOTableRec (vot_fd, res, i);
 	}
     	return (nresults);		/* return number of matches found */
     }
@@ -723,7 +746,7 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	    printf ("-----------------------------------------------\n");
 
 	if (dalOnly) {						/* CapName    */
-            attr_val = voc_resGetStr (res, "CapabilityName", i);
+            attr_val = vot_regGetStr (res, "CapabilityName", i);
 	    bzero (cname, SZ_LINE);
 	    strcpy (cname, (attr_val ? attr_val : ""));
 	    voc_freePointer ((char *) attr_val);
@@ -737,7 +760,8 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	    printf ("%2d(%2d) ", rank, idx);
 	    */
 	    if (sortRes)
-	        printf ("%3d %3d ", i, voc_resGetInt(res, "index", i) );
+	        printf ("%3d %3d ", i, (res == REG_LOCALRES ? i :
+		    voc_resGetInt (res, "index", i)) );
 
 	    if (terse > 1) {
 		/* "Tweet" format.
@@ -746,30 +770,30 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 
 	        printf ("New VO Resource: ");
 
-                attr_val = voc_resGetStr (res, "Title", i);
+                attr_val = vot_regGetStr (res, "Title", i);
 	        printf ("\"%-s\" ", attr_val);
 	        voc_freePointer ((char *) attr_val);
 
-                attr_val = voc_resGetStr (res, "Waveband", i);
+                attr_val = vot_regGetStr (res, "Waveband", i);
 	        printf ("W:%s ", attr_val);
 	        voc_freePointer ((char *) attr_val);
 
-                attr_val = voc_resGetStr (res, "CapabilityStandardID", i);
+                attr_val = vot_regGetStr (res, "CapabilityStandardID", i);
 	        printf ("T:%s ", attr_val);
 	        voc_freePointer ((char *) attr_val);
 
-                attr_val = voc_resGetStr (res, "Subject", i);
+                attr_val = vot_regGetStr (res, "Subject", i);
 		if (attr_val && (ip = strchr (attr_val, (int)':')))
 		    *ip = '\0';		/* kill qualifiers	*/
 	        printf ("S:%-s\n", attr_val);
 	        voc_freePointer ((char *) attr_val);
 
 	    } else {
-                attr_val = voc_resGetStr (res, attr_list[1], i);/* SvcType    */
+                attr_val = vot_regGetStr (res, attr_list[1], i);/* SvcType    */
 	        printf ("%-7.7s ", attr_val);
 	        voc_freePointer ((char *) attr_val);
 
-                attr_val = voc_resGetStr (res, attr_list[0], i);/* Title      */
+                attr_val = vot_regGetStr (res, attr_list[0], i);/* Title      */
 	        printf ((sortRes ? "%-63.63s\n" : "%-71.71s\n"), attr_val);
 	        voc_freePointer ((char *) attr_val);
 	    }
@@ -777,18 +801,18 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	    continue;
 
 	} else {
-            attr_val = voc_resGetStr (res, attr_list[1], i);	/* SvcType    */
+            attr_val = vot_regGetStr (res, attr_list[1], i);	/* SvcType    */
 	    printf ("       Type: %-s\n", attr_val);
 	    voc_freePointer ((char *) attr_val);
 
-            attr_val = voc_resGetStr (res, attr_list[0], i);	/* Title      */
+            attr_val = vot_regGetStr (res, attr_list[0], i);	/* Title      */
 	    printf ("      Title: ");
             ppMultiLine (attr_val, 13, 67, 1024);
 	    printf ("\n");
 	    voc_freePointer ((char *) attr_val);
 	}
 
-        attr_val = voc_resGetStr (res, attr_list[2], i);	/* ShortName  */
+        attr_val = vot_regGetStr (res, attr_list[2], i);	/* ShortName  */
 	if (dalOnly && verbose == 0) {
 	    printf ("  ShortName: %-s\n", attr_val);
 	    printf ("ServiceName: %s\n", cname);
@@ -796,7 +820,7 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	    printf ("  ShortName: %-s\n", attr_val);
 	voc_freePointer ((char *) attr_val);
 
-        attr_val = voc_resGetStr (res, attr_list[3], i);	/* Subject    */
+        attr_val = vot_regGetStr (res, attr_list[3], i);	/* Subject    */
 	printf ("    Subject: ");
         ppMultiLine (attr_val, 13, 67, 1024);
 	printf ("\n");
@@ -805,21 +829,21 @@ vot_regSearch (char **ids, int nids, char *svctype, char *bpass,
 	if (verbose == 0)
 	    continue;
 
-        attr_val = voc_resGetStr (res, attr_list[4], i);	/* Identifier */
+        attr_val = vot_regGetStr (res, attr_list[4], i);	/* Identifier */
 	if (dalOnly)
 	    printf (" Identifier: %-s#%s\n", attr_val, cname);
 	else
 	    printf (" Identifier: %-s\n", attr_val);
 	voc_freePointer ((char *) attr_val);
 
-        attr_val = voc_resGetStr (res, attr_list[5], i);	/* ServiceUrl */
+        attr_val = vot_regGetStr (res, attr_list[5], i);	/* ServiceUrl */
 	printf (" ServiceURL: %-s\n", attr_val);
 	voc_freePointer ((char *) attr_val);
 
 	if (verbose == 1)
 	    continue;
 
-        attr_val = voc_resGetStr (res, attr_list[6], i);	/* Descr.     */
+        attr_val = vot_regGetStr (res, attr_list[6], i);	/* Descr.     */
 	printf ("Description: ");
         ppMultiLine (attr_val, 13, 67, 1024);
 	printf ("\n");
@@ -1634,7 +1658,7 @@ vot_printRegVOTableRec (FILE *fd, RegResult resource, int recnum)
 	if (attr == NULL)
 	    break;
 
-        attr_val = xmlEncode (voc_resGetStr (resource, attr, recnum));
+        attr_val = xmlEncode (vot_regGetStr (resource, attr, recnum));
 
 	/* Escape any URLs to take care of special chars.
 	*/
@@ -1661,6 +1685,44 @@ vot_printRegVOTableRec (FILE *fd, RegResult resource, int recnum)
 }
 
 
+/************************************************************************
+**  Print a Registry record as a line of a service feed (see votopic), the
+**  ShortName, Identifier, AccessURL, Type and Title, tab-delimited.
+*/
+void
+vot_printRegFeedRec (FILE *fd, RegResult resource, int recnum)
+{
+    register int i;
+    char *attr_val, *ip;
+
+    static char *feedAttr[] = {
+        "shortName",      "identifier",     "accessURL",
+        "type",           "title",
+        NULL
+    };
+
+
+    for (i=0; feedAttr[i]; i++) {
+        attr_val = vot_regGetStr (resource, feedAttr[i], recnum);
+	if (i == 3 && !(attr_val && *attr_val)) {
+	    if (attr_val)
+	        voc_freePointer ((char *) attr_val);
+            attr_val = vot_regGetStr (resource, "capabilityClass", recnum);
+	}
+
+	for (ip=attr_val; ip && *ip; ip++)	/* keep the line intact	*/
+	    if (*ip == '\t' || *ip == '\n' || *ip == '\r')
+		*ip = ' ';
+	fprintf (fd, "%s%s", (i ? "\t" : ""), (attr_val ? attr_val : ""));
+
+	if (attr_val)
+	    voc_freePointer ((char *) attr_val);
+    }
+    fprintf (fd, "\n");
+    fflush (fd);
+}
+
+
 
 /************************************************************************
 **  PRINTVOTABLETAIL -- Print the epilog to the VOTable output.
@@ -1767,10 +1829,20 @@ vot_getline (FILE *fd)
 char *
 vot_normalizeCoord (char *coord)
 {
-    static char *ip, *op, norm[SZ_LINE];
+    static char norm[SZ_LINE];
 
+    return (vot_normCoord (coord, norm));
+}
+
+
+/*  Reentrant form of vot_normalizeCoord(), the result is written to 'norm'
+**  (SZ_LINE chars).
+*/
+char *
+vot_normCoord (char *coord, char *norm)
+{
+    char *ip, *op;
 
-    bzero (norm, SZ_LINE);
 
     /* Remove trailing whitespace       */
     for (ip=&coord[strlen(coord)-1]; isspace(*ip) && ip > coord; )
@@ -1788,6 +1860,7 @@ vot_normalizeCoord (char *coord)
         } else
             *op++ = *ip++;
     }
+    *op = '\0';
 
     return (norm);
 }
@@ -1799,13 +1872,23 @@ vot_normalizeCoord (char *coord)
 char *
 vot_normalize (char *str)
 {
-    char *ip, *op;
     static char name[SZ_FNAME];
 
+    return (vot_normName (str, name));
+}
+
+
+/*  Reentrant form of vot_normalize(), the result is written to 'name'
+**  (SZ_FNAME chars).
+*/
+char *
+vot_normName (char *str, char *name)
+{
+    char *ip, *op;
+
     if (str == (char *)NULL)
         return ("");
 
-    bzero (name, SZ_FNAME);
     for (ip=str, op=name; *ip; ) {
         if (strchr (".+-", (int)*ip))
             *op++ = *ip++;
@@ -1814,12 +1897,12 @@ vot_normalize (char *str)
         else
             *op++ = *ip++;
     }
+    *op = '\0';
 
     return (name);
 }
 
 
-
 /* UTILITY FUNCTIONS. 
 */
 
@@ -2026,20 +2109,33 @@ vot_skipHdr (FILE *fd)
 */
 char *
 vot_getTableCol (char *line, int col, int span)
+{
+    static char value[SZ_LINE];
+
+    return (vot_tableCol (line, col, span, value));
+}
+
+
+/*  Reentrant form of vot_getTableCol(), the value is written to 'value'
+**  (SZ_LINE chars).
+*/
+char *
+vot_tableCol (char *line, int col, int span, char *value)
 {
     int    i, nsp = span;
     char   sep[6], *ip, *op, *del = (char *)NULL;
-    static char value[SZ_LINE];
 
 
-    bzero (value, SZ_LINE);
+    value[0] = '\0';
     bzero (sep, 6);
 
     /*  If we're doing exact columns, copy whatever is in those columns
     **  to the output file.  Otherwise, parse the line based on delimiters.
     */
     if (ecols) {
+	span = min (span, SZ_LINE-1);
 	strncpy (value, (char *)&line[col-1], span);
+	value[span] = '\0';
 	for (i=span-1; i && isspace(value[i]); i--) /* trailing space 	*/
 	    value[i] = '\0';
 	for (i=0; isspace(value[i]); i++)	/* leading space 	*/
@@ -2063,16 +2159,18 @@ vot_getTableCol (char *line, int col, int span)
 	    }
 	    if (i++ == col) {
 		if (--nsp == 0) {
+		    *op = '\0';
 		    return (value);
 		} else {
 		    *op++ = ' ';		/* add a space for span */
 		    i--;
 		}
 	    } else 
-		bzero ((op=value), SZ_LINE);
+		op = value;
 	} else
 	    *op++ = *ip;
     }
+    *op = '\0';
 
     return ( (i == col) ? value : (char *)NULL );
 }
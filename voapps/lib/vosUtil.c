@@ -415,13 +415,15 @@ vos_openClientSocket (char *host, int port, int retry)
 
             if (!he) {
                 fprintf (stderr, "Cannot resolve address.\n");
-                exit (2);
+	        close (ps);
+                return (-1);
             }
             if (he->h_addrtype != AF_INET || 
 	        he->h_length != sizeof (servaddr.sin_addr)) {
                     fprintf (stderr, "Cannot handle addr type %d, length %d.\n",
                         he->h_addrtype, he->h_length);
-                    exit(2);
+	            close (ps);
+                    return (-1);
             }
             memcpy (&servaddr.sin_addr, he->h_addr_list[0], 
 	        sizeof (servaddr.sin_addr) );
@@ -886,7 +888,7 @@ vos_getHostByName (char *name)
     hp = gethostbyname (name);
     if (hp == (struct hostent *) NULL) {
 	fprintf (stderr, "vos_getHostByName: cannot resolve '%s'\n", name);
-	exit (0);
+	return (hp);
     }
 
     strcpy (h->name, name);
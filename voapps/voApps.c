@@ -26,17 +26,15 @@ Task  *app    = (Task *) NULL;
  */
 extern int  vosamp (int argc, char **argv, size_t *len, void **result);
 
-/***  NOT YET IMPLEMENTED  ***
 extern int  votcat (int argc, char **argv, size_t *len, void **result);
-extern int  votjoin (int argc, char **argv, size_t *len, void **result);
-extern int  votselect (int argc, char **argv, size_t *len, void **result);
-extern int  votsplit (int argc, char **argv, size_t *len, void **result);
-****/
 extern int  votcnv (int argc, char **argv, size_t *len, void **result);
 extern int  votget (int argc, char **argv, size_t *len, void **result);
 extern int  votinfo (int argc, char **argv, size_t *len, void **result);
+extern int  votjoin (int argc, char **argv, size_t *len, void **result);
 extern int  votpos (int argc, char **argv, size_t *len, void **result);
+extern int  votselect (int argc, char **argv, size_t *len, void **result);
 extern int  votsort (int argc, char **argv, size_t *len, void **result);
+extern int  votsplit (int argc, char **argv, size_t *len, void **result);
 extern int  votstat (int argc, char **argv, size_t *len, void **result);
 
 extern int  vosesame (int argc, char **argv, size_t *len, void **result);
@@ -57,18 +55,15 @@ extern int  voregistry (int argc, char **argv, size_t *len, void **result);
  */
 
 Task voApps[] = {
-   /***  NOT YET IMPLEMENTED  ****
-   { "votcat",          votcat      },
-   { "votjoin",         votjoin     },
-   { "votselect",       votselect   },
-   { "votsplit",        votsplit    },
-   ****/
-
-   { "votcnv",          votcnv      },          /* VOTable apps      	      */
+   { "votcat",          votcat      },          /* VOTable apps      	      */
+   { "votcnv",          votcnv      },
    { "votget",          votget      },
    { "votinfo",         votinfo     },
+   { "votjoin",         votjoin     },
    { "votpos",          votpos      },
+   { "votselect",       votselect   },
    { "votsort",         votsort     },
+   { "votsplit",        votsplit    },
    { "votstat",         votstat     },
 
    { "vosamp",          vosamp      },          /* SAMP messaging  	      */
@@ -10,6 +10,7 @@
 
 
 #include <getopt.h>
+#include <stdint.h>
 
 
 #ifdef  SZ_FORMAT
@@ -134,10 +135,55 @@ typedef struct {
 } ImInfo, *ImInfoP;
 
 
+/*  WCS keywords of an image HDU, as read through CFITSIO or directly from
+ *  the header blocks.
+ */
+typedef struct {
+    double  xrval, yrval;                       /* fits_read_img_coord()    */
+    double  xrpix, yrpix;                       /*   values		    */
+    double  xinc, yinc, rot;
+    char    proj[5];                            /* projection type	    */
+
+    int     has_cd;                             /* CD1_1 found		    */
+    int     has_cdelt;                          /* CDELT1 found (no CD)	    */
+    int     has_crota;                          /* CROTA1 found (w/ CDELT)  */
+    double  cd11, cd12, cd21, cd22;             /* CD matrix		    */
+    double  cdelt1, cdelt2;                     /* CDELTn values	    */
+    double  crota1, crota2;                     /* CROTAn values	    */
+    char    ctype1[32];                         /* CTYPE1 value		    */
+} wcsKeys;
+
+
 ImInfo *vot_imageInfo (char *name, int do_all);
 void    vot_printImageInfo (FILE *fd, ImInfo *im);
 int     vot_imageNExtns (char *image);
 void    vot_freeImageInfo (ImInfo *img);
+void    vot_imageFrame (ImInfo *info, int nextns, int naxis);
+int     vot_frameWcs (frameInfo *info, wcsKeys *kw);
+
+ImInfo *vot_imageInfoMap (char *name);
+int     vot_imageInfoList (char **names, int nimages, int nthreads,
+		int use_cache, ImInfo **info);
+
+
+/*  Worker thread pool.
+ */
+typedef struct voPool voPool;
+
+voPool *vot_poolCreate (int nthreads);
+int     vot_poolSize (voPool *pool);
+void    vot_poolRun (voPool *pool, void (*func)(void *data, int k),
+		void *data);
+void    vot_poolFree (voPool *pool);
+
+
+/*  Hashed append-log cache files.
+ */
+int      vot_hlogOpen (char *subdir, char *name, char *magic, int nbuckets,
+		int tag, int writable);
+char    *vot_hlogLookup (int fd, char *key, int sep, int maxlen, int *len);
+int      vot_hlogStore (int fd, char *key, char *rec, int len);
+uint64_t vot_hlogHash (char *key);
 
 
 
@@ -153,10 +199,18 @@ typedef struct {
 } Task;
 
 
+/*  Task execution modes.
+ */
+#define	VO_TASK_FORK	0		/* run in a forked child	*/
+#define	VO_TASK_THREAD	1		/* run in-process on a thread	*/
+
+
 /*  Tasking execution procedure.
  */
 int  vo_runTask (char *method, Task *apps, int argc, char **argv, size_t *len, 
 		    void **result);
+int  vo_setTaskMode (int mode);
+int  vo_getTaskMode (void);
 int  vo_taskTest (Task *self, char *arg, ...);
 void vo_taskTestFile (char *str, char *fname);
 void vo_taskTestReport (Task self);
@@ -171,6 +225,75 @@ int  vo_appendResultFromString (char *str, size_t *len, void **data,
 
 
 
+/*  Download engine.
+ */
+#define	DL_PENDING		0	/* not yet downloaded		*/
+#define	DL_DONE			1	/* downloaded			*/
+#define	DL_ERROR		-1	/* download failed		*/
+
+typedef struct {
+    char   *url;			/* URL to download		*/
+    char   *fname;			/* output file ("-" = stdout)	*/
+    char   *buf;			/* data if no output file	*/
+    int     resume;			/* continue an existing file?	*/
+    int     nchunks;			/* max parallel ranges of file	*/
+    long    nbytes;			/* bytes received		*/
+    int     status;			/* DL_xxx status		*/
+    int     ntries;			/* attempts made		*/
+    void   *data;			/* caller data			*/
+} dlReq;
+
+typedef void (*dlDoneFunc) (dlReq *req, char *errmsg);
+
+int  vot_dlRun (dlReq *reqs, int nreqs, int maxconn, int maxhost, 
+		    int maxtrys, dlDoneFunc done);
+int  vot_dlDigest (char *fname, unsigned char *md5);
+
+
+/*  Download cache.
+ */
+int  vot_dlcGet (char *url, char *fname);
+int  vot_dlcPut (char *url, char *fname);
+
+
+/*  Service list feed.
+ */
+void vot_svcFeedOpen (int fd);
+int  vot_svcFeedRead (int nwait);
+int  vot_svcFeedActive (void);
+void vot_svcFeedClose (void);
+
+
+/*  Batch name resolution.
+ */
+#define	SZ_RESVAL		64
+
+typedef struct {
+    char   *name;			/* object name			*/
+    char    pos[SZ_RESVAL];		/* sexagesimal position		*/
+    double  ra, dec;			/* J2000 position (degrees)	*/
+    double  era, edec;			/* position errors (mas)	*/
+    char    otype[SZ_RESVAL];		/* object type			*/
+    int     status;			/* OK, or ERR if not resolved	*/
+} resObj;
+
+int  vot_resolveNames (resObj *objs, int nobjs, int maxconn, int refresh);
+
+
+/*  Local Registry index.
+ */
+#define	REG_LOCALRES		-1	/* result handle of a local search */
+
+int   vot_regIdxBuild (int refresh);
+int   vot_regIdxOpen (void);
+int   vot_regIdxConnect (void);
+int   vot_regIdxSearch (char **ids, int nids, char *svctype, char *bpass,
+		    char *subject, char *clevel, int orValues, int dalOnly);
+char *vot_regIdxStr (int index, char *attr);
+char *vot_regGetStr (int res, char *attr, int index);
+
+
+
 /*  Tasking parameter procedures.
  */
 char **vo_paramInit (int argc, char *argv[],
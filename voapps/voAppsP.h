@@ -25,12 +25,20 @@
 
 /* Local processing definitions.
 */
-#define MAX_DOWNLOADS            8      /* max downloads to run         */
+#define MAX_DOWNLOADS         1024      /* max downloads to run         */
 #define MAX_THREADS            128      /* max threads to run           */
 #define MAX_PROCS               64      /* max processes to run         */
-#define DEF_DOWNLOADS            1      /* default no. downloads to run */
+#define DEF_DOWNLOADS           16      /* default no. downloads to run */
 #define DEF_NTHREADS            16      /* default num threads to run   */
 #define DEF_NPROCS              10      /* default num processes to run */
+#define MAX_QUERIES            512      /* max queries to run           */
+#define DEF_HOSTQUERIES         16      /* default queries to one host  */
+#define MAX_DALTHREADS          64      /* max in-process query threads */
+#define DEF_CACHE_TTL       604800      /* query cache entry life (sec) */
+#define DEF_CACHE_SIZE         256      /* query cache size limit (MB)  */
+#define DEF_DLCACHE_TTL    2592000      /* download cache entry life    */
+#define DEF_DLCACHE_SIZE      4096      /* download cache limit (MB)    */
+#define DEF_RESOLVE_CONN         8      /* default name resolver queries*/
 #define DEF_PGID              6200      /* default process group id	*/
 
 #define SZ_TARGET               64      /* size of target name          */
@@ -68,6 +76,12 @@
 #define SVC_SKYNODE             0020	/* Skynode			*/
 #define SVC_OTHER               0040	/* Other type of service	*/
 
+/* Query result cache modes.
+*/
+#define QC_OFF                  0       /* bypass the cache             */
+#define QC_ON                   1       /* use the cache                */
+#define QC_REFRESH              2       /* re-query and update cache    */
+
 /* Table pretty-print defs
 */
 #define PP_WIDTH                40	
@@ -1,7 +1,7 @@
 /**
  *  VOATLAS -- Query the SkyView Image service for an all-sky image.
  *
- *  Usage:   voatlas [<opts>] <name> | <ra dec>
+ *  Usage:   voatlas [<opts>] <name> | <ra dec> | @<file>
  *
  *  Where
  *       -%%,--test             run unit tests
@@ -11,7 +11,7 @@
  *
  * 	 -b,--band <bpass>	Bandpass
  * 	 -l,--list 		List available surveys for position
- * 	 -p,--survey <survey>	Survey program name
+ * 	 -p,--survey <survey>	Survey program name(s), comma-delimited
  * 	 -g,--graphic 		Get a graphic image (i.e. JPEG)
  * 	 -n,--naxis <npix>	Set returned image size
  *
@@ -24,10 +24,18 @@
  *	 -D,--dec <dec>		Set query Dec position
  *	 -P,--pos <ra,dec>	Set query as a POS string
  *	 -S,--samp 		Broadcast as SAMP message
- *	 -o <name>		Save image to named file
+ *	 -c,--nconn <N>		Number of simultaneous connections
+ *	 -o <name>		Save image to named file (or directory)
  *
  *	 <name>			Target name to be resolved to position
  *	 <ra> <dec>		Position to query (dec. deg or Eq. sexagesimal)
+ *	 @<file>		File of target names or positions, one per line
+ *
+ *  The SIAP queries for all fields and surveys are run at once, then the
+ *  images are downloaded at once, both through the download engine (see
+ *  voDownload.c).  Each query response is parsed locally to get the record
+ *  values rather than asking the VOClient server for each.  With --samp
+ *  each image is broadcast as soon as it is downloaded.
  *
  *
  *  @file       voatlas.c
@@ -44,11 +52,36 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/stat.h>
 #include "VOClient.h"
+#include "votParse.h"
 #include "voApps.h"
+#include "voAppsP.h"
 #include "samp.h"
 
 
+#define	DEF_NCONN	8		/* def. simultaneous connections	*/
+#define	MAX_TRYS	3		/* max query/download attempts	*/
+
+typedef struct {
+    char   *name;			/* target name, or NULL		*/
+    char   *pos;			/* "<ra> <dec>" string, or NULL	*/
+    double  ra, dec;			/* field position		*/
+    char   *base;			/* root of the output names	*/
+    int     status;			/* OK if the position is known	*/
+} atlasField;
+
+typedef struct {
+    atlasField *field;			/* field queried		*/
+    char   *survey;			/* survey name			*/
+    char   *url;			/* SIAP query URL		*/
+    char   *votable;			/* query response		*/
+    char   *acref;			/* image to download		*/
+    char   *ofname;			/* output file			*/
+    int     status;			/* OK when the image is saved	*/
+} atlasJob;
+
+
 static double  ra      	   = 0.0;	/* default values		*/
 static double  dec     	   = 0.0;
 static double  size    	   = 0.25;
@@ -58,25 +91,49 @@ static  int   do_samp	   = FALSE;	/* broadcast SAMP msg?		*/
 static  int   graphic	   = FALSE;	/* get graphics format?		*/
 static  int   list_surveys = FALSE;	/* list results?		*/
 static  int   verbose      = FALSE;	/* verbose output?		*/
+static  int   use_cache    = TRUE;	/* use the download cache?	*/
 static  char *field	   = NULL;	/* Input field name		*/
 static  char *pos	   = NULL;	/* Input position		*/
 static  char *bpass	   = NULL;	/* Bandpass			*/
+static  char *flist	   = NULL;	/* File of fields		*/
+static  int   nconn	   = DEF_NCONN;	/* simultaneous connections	*/
+static  int   nquery	   = 0;		/* number of queries		*/
+static  int   samp	   = -1;	/* SAMP handle			*/
+static  int   samp_wait	   = FALSE;	/* broadcast after downloads?	*/
     
 static  char  svc_url[SZ_URL], survey[SZ_FNAME];
 
 
 static char *base_url = "http://skyview.gsfc.nasa.gov/cgi-bin/vo/sia.pl?";
 
-static  int 	voa_resolveField (char *field, double *ra, double *dec);
+static  int 	voa_resolveFields (atlasField *fields, int nfields);
 static  int 	voa_resolvePos (char *pos, double *ra, double *dec);
+static  int 	voa_readFields (char *fname, atlasField **fields);
+static  int 	voa_isPos (char *str);
 static  double 	voa_getSize (char *arg);
-static  int     voa_callService (char *url, double ra, double dec, double size,
-			char *ofname, char *format, int maximages);
+static  int     voa_runQueries (atlasJob *jobs, int njobs, char *format);
+static  void    voa_queryDone (dlReq *req, char *errmsg);
+static  int     voa_selectImage (atlasJob *job, char *format, int maximages);
+static  int     voa_runDownloads (atlasJob *jobs, int njobs);
+static  void    voa_imageDone (dlReq *req, char *errmsg);
+static  void    voa_imageReady (atlasJob *job);
+static  void    voa_sampImage (atlasJob *job);
+static  char   *voa_fieldName (atlasField *f);
+static  void    voa_fieldBases (atlasField *fields, int nfields);
 
 extern	double	sexa (char *s);
 extern  char   *strcasestr ();
 extern  int     vot_atoi (char *v);
 extern  double  vot_atof (char *v);
+extern  char   *vot_cacheGet (char *url, int fmt);
+extern  void    vot_cachePut (char *url, int fmt, char *result);
+
+extern  DAL     dal_openConnection (char *baseurl, char *protocol, char *version);
+extern  void    dal_closeConnection (DAL dal_h);
+extern  Query   dal_getSiapQuery (DAL dal_h, double ra, double dec,
+		    double ra_size, double dec_size, char *format);
+extern  void    dal_closeQuery (Query query_h);
+extern  char   *dal_getQueryURL (Query query_h);
 
 
 #ifdef USE_RESBUF
@@ -90,7 +147,7 @@ int  voatlas (int argc, char **argv, size_t *len, void **result);
 
 static int   do_return	= 0;
 static Task  self       = {  "voatlas",  voatlas,  0,  0,  0  };
-static char  *opts      = "%hF:R:D:P:b:dgs:o:Srlp:n:v";
+static char  *opts      = "%hF:R:D:P:b:dgs:o:Srlp:n:vNc:";
 static struct option long_opts[] = {
         { "field",        1, 0,   'F'},         /* query field name	*/
         { "ra",           1, 0,   'R'},         /* RA of position	*/
@@ -105,6 +162,8 @@ static struct option long_opts[] = {
         { "output",       1, 0,   'o'},         /* set output name	*/
         { "samp",         2, 0,   'S'},         /* broadcast SAMP	*/
         { "verbose",      2, 0,   'v'},         /* required             */
+        { "nocache",      2, 0,   'N'},         /* no download cache	*/
+        { "nconn",        1, 0,   'c'},         /* connections		*/
         { "help",         2, 0,   'h'},         /* required             */
         { "debug",        2, 0,   'd'},         /* required (debug)     */
         { "test",         2, 0,   '%'},         /* required             */
@@ -124,9 +183,14 @@ int
 voatlas (int argc, char **argv, size_t *reslen, void **result)
 {
     char **pargv, optval[SZ_FNAME], ch;
-    char  *iname = NULL, *oname = NULL, *dlname = NULL;
-    char   tmp[SZ_FNAME], buf[SZ_FNAME];
-    int    i=1, status = OK, apos = 0, samp = -1, naxis = 512;
+    char  *iname = NULL, *oname = NULL, *dlname = NULL, *odir = NULL;
+    char   tmp[SZ_FNAME], buf[SZ_FNAME], *ip, *sv, *surveys[SZ_FNAME];
+    int    i=1, j, status = OK, apos = 0, naxis = 512, multi = 0, rmtmp = 0;
+    int    nfields = 0, nsurveys = 0, njobs = 0, nimages = 0;
+    atlasField *fields = (atlasField *) NULL;
+    atlasJob   *jobs   = (atlasJob *) NULL;
+    DAL    dal;
+    Query  query;
 
 
     /*  Initialize.
@@ -139,6 +203,12 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
     *reslen = 0;
     *result = NULL;
 
+    ra      = 0.0,  dec = 0.0,  size = 0.25;	/* reset the options	*/
+    debug   = do_samp = graphic = list_surveys = verbose = FALSE;
+    use_cache = TRUE,  samp_wait = FALSE,  samp = -1;
+    field   = pos = bpass = flist = NULL;
+    nconn   = DEF_NCONN,  nquery = 0,  do_return = 0;
+
 
     /*  Parse the argument list.
      */
@@ -181,6 +251,8 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
 
 	    case 'S':  do_samp = 1;			break;
 	    case 'v':  verbose = 1;			break;
+	    case 'N':  use_cache = 0;			break;
+	    case 'c':  nconn = vot_atoi (optval); i++;	break;
 
 	    default:
 		fprintf (stderr, "Invalid argument '%c'\n", ch);
@@ -191,7 +263,9 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
             return (ERR);
 
 	} else {
-	    if (i == (argc-2)) {
+	    if (optval[0] == '@') {
+		flist = strdup (&optval[1]);
+	    } else if (i == (argc-2)) {
 		sprintf (buf, "%s %s", optval, argv[i+1]);
 		pos = strdup (buf);
 	        sscanf (pos, "%lf %lf", &ra, &dec);
@@ -204,7 +278,7 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
 
     /*  Sanity checks.
      */
-    if (!field && !pos && (ra == 0.0 && dec == 0.0)) {
+    if (!field && !pos && !flist && (ra == 0.0 && dec == 0.0)) {
 	fprintf (stderr, "Error: no field/position specified.\n");
 	return (ERR);
     }
@@ -234,21 +308,63 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
 	memset (survey, 0, SZ_FNAME);
     }
 
+    /*  Split a list of surveys.  The list option queries all surveys at
+     *  once as before.
+     */
+    for (ip=survey; (sv = strtok (ip, ", ")); ip=NULL)
+	surveys[nsurveys++] = sv;
+    if (nsurveys == 0)
+	surveys[nsurveys++] = "";
+
+    /*  Get the fields.
+     */
+    if (flist) {
+	if (field || pos) {
+	    fprintf (stderr, 
+	        "Error: only one of 'field', 'pos' or '@file' may be given.\n");
+	    return (ERR);
+	}
+	if ((nfields = voa_readFields (flist, &fields)) <= 0) {
+	    fprintf (stderr, "Error: no fields in '%s'\n", flist);
+	    return (ERR);
+	}
+    } else {
+	fields = (atlasField *) calloc (1, sizeof (atlasField));
+	fields[0].name   = (field ? strdup (field) : NULL);
+	fields[0].pos    = (pos ? strdup (pos) : NULL);
+	fields[0].ra     = ra;
+	fields[0].dec    = dec;
+	fields[0].status = OK;
+	nfields = 1;
+    }
+    multi = (nfields > 1 || nsurveys > 1);
+
 
-    /*  Setup the output name.
+    /*  Setup the output name.  With several fields or surveys each image
+     *  is named for its field and survey, in the directory given as the
+     *  output name.
      */
-    if (oname) {
+    if (multi) {
+	if (oname && (access (oname, F_OK) < 0) && mkdir (oname, 0755) < 0) {
+	    fprintf (stderr, "Error: cannot create directory '%s'\n", oname);
+	    status = ERR;
+	    goto done_;
+	}
+	odir = oname;			    /* output directory		*/
+	rmtmp = (do_samp && !oname);	    /* temp files for SAMP	*/
+    } else if (oname) {
 	dlname = oname;			    /* output name specified	*/
     } else if (do_samp) {
 	strcpy (tmp, "/tmp/voatlasXXXXXX");    /* temp download name	*/
-	mkstemp (tmp);
+	close (mkstemp (tmp));
 	dlname = tmp;
+	rmtmp = 1;
     } else {
 	if (field)
 	    sprintf (buf, "%s.%s", field, (graphic ? "jpg" : "fits"));
 
 	else if (pos) {
-	    char *ip, *op;
+	    char *op;
 
 	    memset (buf, 0, SZ_FNAME);
 	    for (op=buf, ip=pos; *ip; ip++)
@@ -273,16 +389,11 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
     if (debug) {
 	fprintf (stderr, "field='%s' pos='%s' ra=%g dec=%g\n", 
 	    field, pos, ra, dec);
-	fprintf (stderr, "bpass='%s' survey='%s'\n", bpass, survey);
+	fprintf (stderr, "bpass='%s' survey='%s' nfields=%d nsurveys=%d\n",
+	    bpass, survey, nfields, nsurveys);
 	fprintf (stderr, "oname='%s'\n", oname);
     }
 
-    /*  Initialize the VOClient code.  Error messages are printed by the
-     *  interface so we just quit if there is a problem.
-     */
-    if (voc_initVOClient ("runid=voc.voatlas") == ERR) 
-        return (ERR);
-
     /* Sanity checks
      */
     if (iname == NULL) iname = strdup ("stdin");
@@ -295,74 +406,114 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
 	    "Error: only one of 'field' or 'pos' may be specified.\n");
 	    status = ERR;
 	    goto done_;
-    } else if (field) {
-	if (voa_resolveField (field, &ra, &dec) != OK) {
-	    fprintf (stderr, "Error: cannot resolve object '%s'\n", field);
-	    status = ERR;
-	    goto done_;
-	}
-    } else if (pos) {
-	if (voa_resolvePos (pos, &ra, &dec) != OK) {
-	    fprintf (stderr, "Error: cannot convert position '%s'\n", pos);
-	    status = ERR;
-	    goto done_;
-	}
     }
 
+    /*  Resolve the fields, object names all at once.
+     */
+    if ((j = voa_resolveFields (fields, nfields)) == 0) {
+	status = ERR;
+	goto done_;
+    } else if (j < nfields)
+	status = ERR;
+    if (multi)
+	voa_fieldBases (fields, nfields);
+
 
-    /*  Form the service URL.
+    /*  Form the query of each field and survey.
      */
-    memset (svc_url, 0, SZ_URL);
-    sprintf (svc_url, "%snaxis=%d&", base_url, naxis);
-    if (survey[0]) {
-	strcat (svc_url, "survey=");
-	strcat (svc_url, survey);
-	strcat (svc_url, "&");
+    jobs = (atlasJob *) calloc (nfields * nsurveys, sizeof (atlasJob));
+    for (j=0; j < nsurveys; j++) {
+        memset (svc_url, 0, SZ_URL);
+        sprintf (svc_url, "%snaxis=%d&", base_url, naxis);
+        if (surveys[j][0]) {
+	    strcat (svc_url, "survey=");
+	    strcat (svc_url, surveys[j]);
+	    strcat (svc_url, "&");
+        }
+        if (debug)
+	    fprintf (stderr, "url='%s'\n", svc_url);
+
+	if ((dal = dal_openConnection (svc_url, "sia", "1.0")) <= 0)
+	    continue;
+	for (i=0; i < nfields; i++) {
+	    atlasJob *job = &jobs[njobs];
+
+	    if (fields[i].status != OK)
+		continue;
+	    query = dal_getSiapQuery (dal, fields[i].ra, fields[i].dec, size,
+		size, (list_surveys ? NULL : 
+		    (graphic ? "image/jpeg" : "image/fits")));
+	    if (query <= 0)
+		continue;
+
+	    job->field  = &fields[i];
+	    job->survey = surveys[j];
+	    job->url    = dal_getQueryURL (query);
+	    if (multi) {
+		sprintf (buf, "%s%s%s.%s.%s", (odir ? odir : ""),
+		    (odir ? "/" : ""), fields[i].base,
+		    (surveys[j][0] ? surveys[j] : "all"), 
+		    (graphic ? "jpg" : "fits"));
+		if (rmtmp) {
+		    strcpy (buf, "/tmp/voatlasXXXXXX");
+		    close (mkstemp (buf));
+		}
+		job->ofname = strdup (buf);
+	    } else
+		job->ofname = strdup (dlname ? dlname : "");
+	    dal_closeQuery (query);
+	    njobs++;
+	}
+	dal_closeConnection (dal);
     }
-    if (debug)
-	fprintf (stderr, "ra = %g  dec = %g\nurl='%s'\n", ra, dec, svc_url);
 
 
-    /*  Call the SkyView SIA service.
+    /*  Call the SkyView SIA service for all the queries, then pick the
+     *  image from each response.
      */
-    if (voa_callService (svc_url, ra, dec, size, dlname, 
-	(graphic ? "jpeg" : "fits"), 1) == ERR) {
-	    fprintf (stderr, "Error: cannot contact SkyView service\n");
-	    status = ERR;
-	    goto done_;
+    if (voa_runQueries (jobs, njobs, (graphic ? "jpeg" : "fits")) == 0) {
+	fprintf (stderr, "Error: cannot contact SkyView service\n");
+	status = ERR;
+	goto done_;
     }
 
-    /*  Broadcast the image as a message if requested.
-     */
-    if (do_samp) {
-	if ((samp = sampInit ("voatlas", "VOClient Task")) >= 0) {
-	    char url[SZ_LINE], cwd[SZ_LINE];
-
-	    samp_setSyncMode (samp);	/* use asynchronous mode	*/
-	    sampStartup (samp);		/* register w/ Hub		*/
-
-	    memset (url, 0, SZ_LINE);
-	    memset (cwd, 0, SZ_LINE);
-	    getcwd (cwd, SZ_LINE);
-	    if (tmp[0])
-	        sprintf (url, "file://%s", dlname);
-	    else
-	        sprintf (url, "file://%s/%s", cwd, oname);
+    if (!list_surveys) {
+        /*  Images are broadcast as they arrive if requested.  Temp files
+         *  are deleted once we're done, so those are broadcast after the
+         *  downloads in synchronous mode to wait for the clients to load
+         *  them.
+         */
+        if (do_samp) {
+	    if ((samp = sampInit ("voatlas", "VOClient Task")) >= 0) {
+		samp_wait = rmtmp;
+		if (samp_wait)
+	            samp_setSyncMode (samp);	/* wait for the replies	*/
+		else
+	            samp_setASyncMode (samp);	/* use asynchronous mode */
+	        sampStartup (samp);		/* register w/ Hub		*/
+	    }
+        }
 
-	    if (verbose)
-		printf ("Displaying image %s ...\n", url);
-            (void) samp_imageLoadFITS (samp, "all", url, "", field);
+        if ((nimages = voa_runDownloads (jobs, njobs)) < njobs)
+	    status = ERR;
 
-	    if (tmp[0])
-		unlink (dlname);
+        if (samp >= 0) {
+	    for (i=0; samp_wait && i < njobs; i++)
+		if (jobs[i].status == OK)
+		    voa_sampImage (&jobs[i]);
 	    sampShutdown (samp);
-	}
+	    samp = -1;
+        }
+        if (rmtmp) {
+	    for (i=0; i < njobs; i++)
+	        unlink (jobs[i].ofname);
+        }
     }
 
 
     /*  See if we're returning the image.
      */
-    if (do_return) {
+    if (do_return && !multi && (nimages || list_surveys)) {
 	vo_setResultFromFile (dlname, reslen, result);
         unlink (dlname);
     }
@@ -371,12 +522,26 @@ voatlas (int argc, char **argv, size_t *reslen, void **result)
     /*  Clean up and shutdown.
      */
 done_:
+    for (i=0; i < njobs; i++) {
+	if (jobs[i].url)      free ((void *) jobs[i].url);
+	if (jobs[i].votable)  free ((void *) jobs[i].votable);
+	if (jobs[i].acref)    free ((void *) jobs[i].acref);
+	if (jobs[i].ofname)   free ((void *) jobs[i].ofname);
+    }
+    for (i=0; i < nfields; i++) {
+	if (fields[i].name)   free ((void *) fields[i].name);
+	if (fields[i].pos)    free ((void *) fields[i].pos);
+	if (fields[i].base)   free ((void *) fields[i].base);
+    }
+    if (jobs)   free ((void *) jobs);
+    if (fields) free ((void *) fields);
+    if (flist)  free (flist);
     if (pos)    free (pos);
     if (field)  free (field);
     if (iname)  free (iname);
     if (oname)  free (oname);
+    flist = pos = field = NULL;
 
-    voc_closeVOClient (1);
     vo_paramFree (argc, pargv);
 
     sleep (2);		/*  FIXME -- SkyView seems to have a reset issue...  */
@@ -392,7 +557,7 @@ static void
 Usage (void)
 {
     fprintf (stderr, "\n  Usage:\n\t"
-        "voatlas [<opts>] [<field> | <pos>]\n\n"
+        "voatlas [<opts>] [<field> | <pos> | @<file>]\n\n"
         "  where\n"
 	"       -%%,--test              run unit test\n"
 	"       -d,--debug              enable debugging\n"
@@ -400,7 +565,7 @@ Usage (void)
 	"       -r,--return             return result from metho\n"
 	"\n"
 	" 	-b,--band <bpass>	Bandpas\n"
-	" 	-p,--survey <survey>	Survey program nam\n"
+	" 	-p,--survey <survey>	Survey program name(s)\n"
 	" 	-g,--graphic 		Get a graphic image (i.e. JPEG\n"
 	" 	-n,--naxis <npix>	Set returned image size\n"
 	"\n"
@@ -414,10 +579,13 @@ Usage (void)
 	"	-P,--pos <ra,dec>	Set query as a POS strin\n"
 	"	-S,--samp 		Broadcast as SAMP messag\n"
 	"	-v,--verbose 		Verbose output\n"
-	"	-o <name>		Save image to named fil\n"
+	"	-N,--nocache 		Don't use the download cache\n"
+	"	-c,--nconn <N>		Number of simultaneous connections\n"
+	"	-o <name>		Save image to named file (or directory)\n"
 	"\n"
 	"	 <name>			Target name to be resolved\n"
 	"	 <ra> <dec>		Position to query\n"
+	"	 @<file>		File of names or positions\n"
         "\n"
         "Examples:\n\n"
 	"    1)  Display an image of M83 on Aladin using SAMP\n\n"
@@ -435,6 +603,9 @@ Usage (void)
 	"    5)  List (verbose) the survey images available for ngc1234\n\n"
 	"	    %% voatlas --survey=list -v ngc1234\n"
 	"\n"
+	"    6)  Get DSS and 2MASS images of a list of fields in 'img'\n\n"
+	"	    %% voatlas --survey=dss2b,2massk -o img @fields.txt\n"
+	"\n"
     );
 }
 
@@ -477,97 +648,144 @@ Tests (char *input)
 
 
 /**
- *  Simple test routine to call a Siap search service and summarize results.
+ *  VOA_RUNQUERIES -- Call the SIA service for each job.  Responses not in
+ *  the query cache are fetched at once, then the image to download is
+ *  picked from each.  Returns the number of queries with results.
  */
 static int
-voa_callService (char *svc_url, double ra, double dec, double size,
-    char *ofname, char *format, int maximages)
+voa_runQueries (atlasJob *jobs, int njobs, char *format)
 {
-    char   *acref = NULL, *fmt = NULL, *program = NULL;
-    double  dra, ddec;
-    int     i, nrec = 0, recnum = 0;
-    FILE   *fd = (FILE *) NULL;
+    dlReq  *reqs = (dlReq *) calloc (max(1,njobs), sizeof (dlReq));
+    int     i, nreqs = 0, ngot = 0;
 
 
-    DAL	      siap;				/* DAL Connection	 */
-    Query     query;				/* query handle		 */
-    QResponse qr;                               /* query response handle */
-    QRecord   rec;				/* result record handle	 */
-    QRAttribute v;				/* dataset attribute	 */
-	
+    for (i=0; i < njobs; i++) {
+	if (VOAPP_DEBUG || debug)
+            fprintf (stderr, "Executing Query:\n\t'%s'\n\n", jobs[i].url);
 
-    /*  Get a new connection to the named service.
-     */
-    siap = voc_openSiapConnection (svc_url);    /* open a connection    */
+	if (use_cache && (jobs[i].votable = vot_cacheGet (jobs[i].url, F_RAW)))
+	    continue;
+	reqs[nreqs].url  = jobs[i].url;
+	reqs[nreqs].data = (void *) &jobs[i];
+	nreqs++;
+    }
+    if (nreqs > 0)
+	(void) vot_dlRun (reqs, nreqs, nconn, nconn, MAX_TRYS, voa_queryDone);
+    free ((void *) reqs);
 
-    /*  Form a query.  Here we'll use the one search size we're given for
-     *  both the RA,DEC sizes, and specify a null format.
+    /*  Select the images in query order so listings are repeatable.
      */
-    query = voc_getSiapQuery (siap, ra, dec, size, size, 
-	(list_surveys ? NULL : (graphic ? "image/jpeg" : "image/fits")));
+    for (nquery=njobs, i=0; i < njobs; i++)
+	if (jobs[i].votable && voa_selectImage (&jobs[i], format, 1) == OK)
+	    ngot++;
+
+    return (ngot);
+}
+
+
+/**
+ *  VOA_QUERYDONE -- Keep a query response, called by the download engine.
+ */
+static void
+voa_queryDone (dlReq *req, char *errmsg)
+{
+    atlasJob *job = (atlasJob *) req->data;
 
 
-    if (VOAPP_DEBUG || debug) {
-        fprintf (stderr, "Executing Query:\n\t'%s'\n\n", 
-            voc_getQueryString (query,SIAP_CONN,0));
+    if (req->status == DL_DONE && req->buf) {
+	job->votable = req->buf;
+	if (use_cache)
+	    vot_cachePut (job->url, F_RAW, job->votable);
+    } else {
+	if (req->buf)
+	    free ((void *) req->buf);
+	if (verbose || debug)
+	    fprintf (stderr, "Error: query failed%s%s\n", 
+		(errmsg ? ": " : ""), (errmsg ? errmsg : ""));
     }
-        
+    req->buf = (char *) NULL;
+}
 
-    /* Execute the query.
-     */
-    qr = voc_executeQuery (query);                  /* execute the query    */
-    if ((nrec = voc_getRecordCount (qr)) <= 0)
-        return (ERR);
 
-    if (do_return && list_surveys)
-	fd = fopen (ofname, "w+");
-    else
-	fd = stdout;
+/**
+ *  VOA_SELECTIMAGE -- Parse a query response and pick the image of the
+ *  survey in the given format, or list the images found.  The columns are
+ *  found by UCD, or by name if a service does not set the UCD.
+ */
+static int
+voa_selectImage (atlasJob *job, char *format, int maximages)
+{
+    static char *ucds[] = { "VOX:Image_Format", "VOX:Image_Title",
+		"POS_EQ_RA_MAIN", "POS_EQ_DEC_MAIN", "VOX:Image_AccessReference" };
+    static char *names[] = { "Format", "Title", "Ra", "Dec", 
+		"AccessReference" };
+    char   *acref = NULL, *fmt = NULL, *program = NULL, *s;
+    int     i, k, col[5], nrec = 0, recnum = 0;
+    handle_t vot, res, tab, data, tdata, fld, tr;
+    FILE   *fd = (FILE *) NULL;
 
 
-    /*  Download the first 'maximages' images.
-     */
-    for (i=0; i < nrec && i < nrec; i++) {
-	rec = voc_getRecord (qr, i);            /* get a row in the table   */
+    if ((vot = vot_openVOTABLE (job->votable)) <= 0)
+	return (ERR);
+
+    res = vot_getRESOURCE (vot);
+    if (!res || !(tab = vot_getTABLE (res)) || !(data = vot_getDATA (tab)) ||
+	!(tdata = vot_getTABLEDATA (data)) || (nrec = vot_getNRows (tdata)) <= 0) {
+	    vot_closeVOTABLE (vot);
+	    return (ERR);
+    }
 
-	v = voc_getAttribute (rec, "Format"); 	/* get the right format	    */
-	if (!(fmt = voc_stringValue(v)) || strcasestr (fmt, format) == NULL) 
+    for (k=0; k < 5; k++) {
+	col[k] = -1;
+	for (i=0, fld=vot_getFIELD (tab); fld; fld=vot_getNext (fld), i++) {
+	    if ((s = vot_getAttr (fld, "ucd")) && strcasecmp (s, ucds[k]) == 0)
+		col[k] = i;
+	    if (s)
+		free ((void *) s);
+	    if (col[k] < 0 && (s = vot_getAttr (fld, "name"))) {
+		if (strcasecmp (s, names[k]) == 0)
+		    col[k] = i;
+		free ((void *) s);
+	    }
+	}
+    }
+
+    if (do_return && list_surveys && nquery == 1)
+	fd = fopen (job->ofname, "w+");
+    if (!fd)
+	fd = stdout;
+    if (list_surveys && nquery > 1)
+	fprintf (fd, "# %s  %s\n", voa_fieldName (job->field), 
+	    (job->survey[0] ? job->survey : "all"));
+
+    /*  Pick the first 'maximages' images.
+     */
+    for (i=0, tr=vot_getTR (tdata); tr; tr=vot_getNext (tr), i++) {
+	fmt = (col[0] >= 0 ? vot_getTableCell (tdata, i, col[0]) : NULL);
+	if (!fmt || strcasestr (fmt, format) == NULL) 
 	    if (!list_surveys)
 	 	continue;
 
-	v = voc_getAttribute (rec, "Title"); /* get the survey   	    */
-	program = voc_stringValue(v);
+	program = (col[1] >= 0 ? vot_getTableCell (tdata, i, col[1]) : NULL);
 	if (list_surveys) {
-	    v = voc_getAttribute (rec, "Ra");   dra = voc_floatValue (v);
-	    v = voc_getAttribute (rec, "Dec");  ddec = voc_floatValue (v);
 	    if (verbose)
-	        fprintf (fd, "%3d  %12.12s  %g %g  %s\n",
-		    (i+1), program, dra, ddec, fmt);
+	        fprintf (fd, "%3d  %12.12s  %g %g  %s\n", (i+1), program,
+		    (col[2] >= 0 ? vot_atof (vot_getTableCell (tdata,i,col[2])) : 0.),
+		    (col[3] >= 0 ? vot_atof (vot_getTableCell (tdata,i,col[3])) : 0.),
+		    fmt);
 	    else
 	        fprintf (fd, "%3d  %12.12s  %s\n", (i+1), program, fmt);
 
 	} else if (program) {
 	    int  plen = strlen (program);
-	    int  slen = strlen (survey);
-
-	    if (strncasecmp (program, survey, min(plen,slen)) == 0) {
-	        if ((v = voc_getAttribute (rec, "AccessReference"))) {
-	            acref = voc_stringValue (v);
-		    if (verbose) {
-			printf ("Downloading %d of %d: '%s' ....", 
-			    i, nrec, ofname);
-			fflush (stdout);
-		    }
-	            if ( voc_getDataset (rec, acref, ofname) != OK ) {
-		        if (verbose)
-			    printf ("error downloading file\n");
-                        return (ERR);
-	            }
-		    if (verbose)
-			printf ("done\n");
-
-	            if ( ++recnum >= maximages )
-	                break;
+	    int  slen = strlen (job->survey);
+
+	    if (strncasecmp (program, job->survey, min(plen,slen)) == 0) {
+	        if (col[4] >= 0 && 
+		    (acref = vot_getTableCell (tdata, i, col[4])) && acref[0]) {
+		        job->acref = strdup (acref);
+	                if ( ++recnum >= maximages )
+	                    break;
 	        }
 	    }
 	}
@@ -575,12 +793,244 @@ voa_callService (char *svc_url, double ra, double dec, double size,
 
     if (fd != stdout)
 	fclose (fd);
+    vot_closeVOTABLE (vot);
 
-    voc_closeConnection (siap);			/* close the siap connection */
     return (OK);
 }
 
 
+/**
+ *  VOA_RUNDOWNLOADS -- Download the selected images.  Images already in the
+ *  download cache are not fetched again, e.g. repeated cutouts of the same
+ *  field.  Returns the number of images saved.
+ */
+static int
+voa_runDownloads (atlasJob *jobs, int njobs)
+{
+    dlReq  *reqs = (dlReq *) calloc (max(1,njobs), sizeof (dlReq));
+    int     i, nreqs = 0, ngot = 0;
+
+
+    for (i=0; i < njobs; i++) {
+	if (!jobs[i].acref) {
+	    fprintf (stderr, "Warning: no '%s' image of '%s'\n", 
+		jobs[i].survey, voa_fieldName (jobs[i].field));
+	    continue;
+	}
+
+	/*  Take the image from the download cache if we have it.
+	 */
+	if (use_cache && vot_dlcGet (jobs[i].acref, jobs[i].ofname) == OK) {
+	    jobs[i].status = OK;
+	    voa_imageReady (&jobs[i]);
+	    continue;
+	}
+	unlink (jobs[i].ofname);
+	reqs[nreqs].url   = jobs[i].acref;
+	reqs[nreqs].fname = jobs[i].ofname;
+	reqs[nreqs].data  = (void *) &jobs[i];
+	nreqs++;
+    }
+    if (nreqs > 0)
+	(void) vot_dlRun (reqs, nreqs, nconn, nconn, MAX_TRYS, voa_imageDone);
+    free ((void *) reqs);
+
+    for (i=0; i < njobs; i++)
+	ngot += (jobs[i].status == OK);
+    return (ngot);
+}
+
+
+/**
+ *  VOA_IMAGEDONE -- Save a downloaded image in the cache and display it,
+ *  called by the download engine as each image completes.
+ */
+static void
+voa_imageDone (dlReq *req, char *errmsg)
+{
+    atlasJob *job = (atlasJob *) req->data;
+
+
+    if (req->status == DL_DONE) {
+	if (use_cache)
+	    (void) vot_dlcPut (job->acref, job->ofname);
+	job->status = OK;
+	voa_imageReady (job);
+
+    } else if (verbose)
+	printf ("Error downloading '%s'%s%s\n", job->ofname,
+	    (errmsg ? ": " : ""), (errmsg ? errmsg : ""));
+}
+
+
+/**
+ *  VOA_IMAGEREADY -- Report an image and broadcast it if requested.
+ */
+static void
+voa_imageReady (atlasJob *job)
+{
+    if (verbose)
+	printf ("Downloaded '%s'\n", job->ofname);
+    if (samp >= 0 && !samp_wait)
+	voa_sampImage (job);
+}
+
+
+/**
+ *  VOA_SAMPIMAGE -- Broadcast an image to the SAMP clients.
+ */
+static void
+voa_sampImage (atlasJob *job)
+{
+    char url[SZ_LINE], cwd[SZ_LINE];
+
+
+    memset (url, 0, SZ_LINE);
+    memset (cwd, 0, SZ_LINE);
+    if (job->ofname[0] == '/')
+        sprintf (url, "file://%s", job->ofname);
+    else {
+        getcwd (cwd, SZ_LINE);
+        sprintf (url, "file://%s/%s", cwd, job->ofname);
+    }
+
+    if (verbose)
+	printf ("Displaying image %s ...\n", url);
+    (void) samp_imageLoadFITS (samp, "all", url, "", 
+	voa_fieldName (job->field));
+}
+
+
+/**
+ *  VOA_READFIELDS -- Read a file of target names or positions, one per line.
+ *  Blank lines and '#' comments are skipped.  Returns the number of fields.
+ */
+static int
+voa_readFields (char *fname, atlasField **fields)
+{
+    FILE  *fd;
+    char   line[SZ_LINE], *ip, *ep;
+    int    nfields = 0, szfields = 0;
+    atlasField *f = (atlasField *) NULL;
+
+
+    if (strcmp (fname, "-") == 0)
+	fd = stdin;
+    else if ((fd = fopen (fname, "r")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open '%s'\n", fname);
+	return (0);
+    }
+
+    while (fgets (line, SZ_LINE, fd)) {
+	for (ip=line; isspace (*ip); ip++)
+	    ;
+	for (ep=ip+strlen(ip); ep > ip && isspace (ep[-1]); ep--)
+	    *(ep-1) = '\0';
+	if (!*ip || *ip == '#')
+	    continue;
+
+	if (nfields >= szfields) {
+	    szfields += 64;
+	    f = (atlasField *) realloc (f, szfields * sizeof (atlasField));
+	}
+	memset (&f[nfields], 0, sizeof (atlasField));
+	if (voa_isPos (ip)) {
+	    char *op = ip;			/* "<ra> <dec>" string	*/
+
+	    for (ep=ip; *ep; ep++) {
+		if (isspace (*ep) || *ep == ',') {
+		    if (op > ip && op[-1] != ' ')
+			*op++ = ' ';
+		} else
+		    *op++ = *ep;
+	    }
+	    *op = '\0';
+	    f[nfields].pos = strdup (ip);
+	} else
+	    f[nfields].name = strdup (ip);
+	nfields++;
+    }
+
+    if (fd != stdin)
+	fclose (fd);
+    *fields = f;
+    return (nfields);
+}
+
+
+/**
+ *  VOA_ISPOS -- See whether a string is a "<ra> <dec>" position, in decimal
+ *  degrees or sexagesimal, rather than an object name.
+ */
+static int
+voa_isPos (char *str)
+{
+    char *ip;
+    int   nwords = 0, inword = 0;
+
+
+    for (ip=str; *ip; ip++) {
+	if (isspace (*ip) || *ip == ',') {
+	    inword = 0;
+	} else if (isdigit (*ip) || strchr ("+-.:", *ip)) {
+	    if (!inword)
+		nwords++, inword = 1;
+	} else
+	    return (0);
+    }
+    return (nwords == 2);
+}
+
+
+/**
+ *  VOA_RESOLVEFIELDS -- Get the position of each field.  Object names are
+ *  resolved all at once.  Returns the number of fields with a position.
+ */
+static int
+voa_resolveFields (atlasField *fields, int nfields)
+{
+    resObj *objs = (resObj *) calloc (nfields, sizeof (resObj));
+    char    buf[SZ_LINE];
+    int     i, nobjs = 0, ngot = 0;
+
+
+    for (i=0; i < nfields; i++) {
+	fields[i].status = OK;
+	if (fields[i].name)
+	    objs[nobjs++].name = fields[i].name;
+    }
+    if (nobjs > 0)
+	(void) vot_resolveNames (objs, nobjs, nconn, !use_cache);
+
+    for (i=0, nobjs=0; i < nfields; i++) {
+	if (fields[i].name) {
+	    if ((fields[i].status = objs[nobjs].status) == OK) {
+		fields[i].ra  = objs[nobjs].ra;
+		fields[i].dec = objs[nobjs].dec;
+	    } else
+	        fprintf (stderr, "Error: cannot resolve object '%s'\n", 
+		    fields[i].name);
+	    nobjs++;
+
+	} else if (fields[i].pos) {
+	    strncpy (buf, fields[i].pos, SZ_LINE-1);
+	    buf[SZ_LINE-1] = '\0';
+	    if ((fields[i].status = voa_resolvePos (buf, 
+		&fields[i].ra, &fields[i].dec)) != OK)
+	            fprintf (stderr, "Error: cannot convert position '%s'\n", 
+			fields[i].pos);
+	}
+	ngot += (fields[i].status == OK);
+	if (debug)
+	    fprintf (stderr, "field '%s': ra = %g  dec = %g\n",
+		voa_fieldName (&fields[i]), fields[i].ra, fields[i].dec);
+    }
+
+    free ((void *) objs);
+    return (ngot);
+}
+
+
 /**
  *  VOA_RESOLVEPOS -- Resolve a position string to decimal degrees.
  */
@@ -609,25 +1059,6 @@ voa_resolvePos (char *pos, double *ra, double *dec)
 }
 
 
-/**
- *  VOA_RESOLVEFIELD -- Resolve an object field name to a position in decimal
- *  degrees.
- */
-static int
-voa_resolveField (char *field, double *ra, double *dec)
-{
-    Sesame sr;
-    extern  char *vo_urlEncode();
-
-
-    if ((sr = voc_nameResolver (vo_urlEncode (field))) != 0) {
-        *ra = (double) voc_resolverRA (sr);
-        *dec = (double) voc_resolverDEC (sr);
-    }
-    return ((sr > 0) ? OK : ERR);
-}
-
-
 /**
  *  VOA_GETSIZE -- Convert an argument size spec into a decimal degree value.
  */
@@ -658,3 +1089,50 @@ voa_getSize (char *arg)
 
     return ((double) 0.0);
 }
+
+
+/**
+ *  VOA_FIELDNAME -- Get the name of a field for messages.
+ */
+static char *
+voa_fieldName (atlasField *f)
+{
+    return (f->name ? f->name : (f->pos ? f->pos : ""));
+}
+
+
+/**
+ *  VOA_FIELDBASES -- Set the root of the output names of each field.  A
+ *  field repeated in the list (or whose name only differs in blanks) has
+ *  its field number added so its images don't overwrite the first.
+ */
+static void
+voa_fieldBases (atlasField *fields, int nfields)
+{
+    atlasField *f;
+    char  buf[SZ_FNAME], *ip;
+    int   i, j;
+
+
+    for (i=0; i < nfields; i++) {
+	f = &fields[i];
+	if (f->name || f->pos)
+	    snprintf (buf, SZ_FNAME - 16, "%s", voa_fieldName (f));
+	else
+	    sprintf (buf, "%g_%g", f->ra, f->dec);
+
+	for (ip=buf; *ip; ip++)
+	    if (isspace (*ip) || *ip == '/')
+		*ip = '_';
+
+	for (j=0; j < i; ) {
+	    if (strcmp (fields[j].base, buf) == 0 &&
+		(ip - buf) < SZ_FNAME - 16) {
+		    ip += sprintf (ip, "_%d", i + 1);
+		    j = 0;			/* check the new name too */
+	    } else
+		j++;
+	}
+	f->base = strdup (buf);
+    }
+}
@@ -105,10 +105,13 @@ int     longlines   = FALSE;		/* output long lines?		*/
 int     iportal     = FALSE;		/* iportal support?		*/
 int     numout      = FALSE;		/* numeric output sorting?	*/
 int     samp        = FALSE;		/* broadcast table via SAMP	*/
+int     inproc      = FALSE;		/* run queries in-process	*/
+int     qcache      = QC_ON;		/* query result cache mode	*/
 
 int	max_download= DEF_DOWNLOADS;	/* max download procs to run	*/
 int	max_procs   = DEF_NPROCS;	/* max children to run		*/
 int	max_threads = DEF_NTHREADS;	/* max threads to run		*/
+int	max_hostq   = DEF_HOSTQUERIES;	/* max queries to one host	*/
 
 int     table_hskip = 0;		/* no. of table eeader to skip	*/
 int     table_nlines= 0;		/* max lines of table to read	*/
@@ -192,6 +195,8 @@ extern int   vot_parseObjectList (char *list, int isCmdLine);
 extern int   vot_countObjectList (void);
 extern int   vot_parseServiceList (char *list, int dalOnly);
 extern int   vot_countServiceList (void);
+extern int   vot_svcFeedRead (int nwait);
+extern int   vot_svcFeedActive (void);
 extern int   vot_decodeRanges (char *range_string, int *ranges, int max_ranges,
 		int *nvalues);
 extern int   is_in_range (int ranges[], int number);
@@ -229,17 +234,22 @@ extern int  vo_appendResultFromString (char *str, size_t *len, void **data,
 extern char *vot_doInventory (void);
 #endif
 extern char *vot_urlFname (char *url);
-extern char *vot_getOFName (svcParams *pars, char *extn, int pid);
-extern char *vot_getOFIndex (svcParams *pars, char *extn, int pid);
+extern char *vot_getOFName (svcParams *pars, char *extn);
+extern void  vot_dalExit (int code, int count);
+extern char *vot_getOFIndex (svcParams *pars, char *extn);
 extern char *vot_normalize (char *str);
 extern char *vot_svcTypeCode (int type);
 
 static int   vot_parseArgToken (char *arg, char *next, int pos, int *inc);
 static int   vot_validateOptions (void);
 static int   vot_getNextCmdline (void);
-static void  vot_runSvcThreads (void);
+static void  vot_runSvcQueries (void);
 static void  vot_printProcStat (Proc *procList, char *svc_name, int fail_only);
-static void  vot_setProcStat (Service *svc, int pid, int status);
+static void  vot_setProcStat (Service *svc, Proc *pp, int status);
+static int   vot_svcHost (char *url, char **hosts, int *nhosts);
+
+#define	ARG_DONE	-1		/* vot_setArgWord() status	*/
+#define	ARG_ERR		-2
 
 static void  vot_printProcTime ();
 static char *vot_requiredArg (char *arg);
@@ -254,12 +264,10 @@ static char *vot_cnvType (char *intype);
 static void  vot_printUsage (void);
 static void  vot_printExamples (void);
 
-void   *vot_procObjs (void *arg);
 void    vot_printSvcList (Service *sl);
 void    vot_printSvcHdr (void);
 
     
-pthread_mutex_t svc_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 /*  Task specific option declarations.
@@ -340,6 +348,9 @@ static struct option long_opts[] = {
     { "ek",          2, &mf, 25 },	/* opt arg word			*/
     { "eK",          2, &mf, 26 },	/* opt arg word			*/
     { "hskip",       2, &mf, 27 },	/* opt arg word			*/
+    { "inproc",      0, &mf, 28 },	/* no arg word			*/
+    { "nocache",     0, &mf, 29 },	/* no arg word			*/
+    { "refresh",     0, &mf, 33 },	/* no arg word			*/
 
     { "wh",          2, &mf, 30 },	/* opt arg word			*/
     { "wb",          2, &mf, 31 },	/* opt arg word			*/
@@ -401,6 +412,27 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
     rowRange.nvalues  = RANGE_ALL;
     fileRange.nvalues = RANGE_NONE;
 
+    /*  Reset the options, the task may be run more than once in the same
+    **  process.
+    */
+    format = F_CSV, sv_apos = -1, filenum = 0, rd_stdin = wr_stdout = 0;
+    do_votable = 0, svcNumber = -1, dalOnly = 1, simple_out = 0;
+    inventory = quiet = FALSE, verbose = TRUE, file_get = FALSE;
+    raw_vizier = meta = count_only = FALSE, count = save_res = TRUE;
+    extract = EX_NONE, all_named = use_name = url_proc = force_svc = FALSE;
+    svc_list = obj_list = fixed_svc = fixed_obj = fixed_pos = FALSE;
+    data_type = DT_ANY, proxy = res_all = force_read = longlines = FALSE;
+    iportal = numout = samp = inproc = FALSE, qcache = QC_ON;
+    table_hskip = table_nlines = 0, table_sample = 1;
+    typestr = bpass = output = ecols = sources = resources = NULL;
+    d2_band = d2_time = d2_format = d2_version = sampName = NULL;
+    delim = " \t,|;", cols = "1,2", tmpdir = "/tmp/", sr = DEF_SR;
+    dverbose = debug = 0, arg_fd = (FILE *) NULL;
+    html_header = html_border = html_color = TRUE;
+    memset (wrkdir, 0, SZ_FNAME);
+    max_download = DEF_DOWNLOADS, max_procs = DEF_NPROCS;
+    max_threads = DEF_NTHREADS, max_hostq = DEF_HOSTQUERIES;
+
 
     /* Get some environment definitions.  We allow the command-line flags
     ** to override these values.
@@ -411,6 +443,12 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 	max_procs = vot_atoi (eval);
     if ((eval = getenv("VOC_MAX_THREADS")))
 	max_threads = vot_atoi (eval);
+    if ((eval = getenv("VOC_MAX_HOST")))
+	max_hostq = vot_atoi (eval);
+    if ((eval = getenv("VOC_INPROC")))
+	inproc = (vot_atoi (eval) > 0);
+    if ((eval = getenv("VOC_NO_CACHE")))
+	qcache = QC_OFF;
 
 
     /*  Initializations.
@@ -421,6 +459,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
     svcIndex  = 0;
     objIndex  = 0;
     all_data  = 0;
+    status    = OK;
+
 
 
     rs_time = time ((time_t *) NULL);
@@ -481,9 +521,9 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 		format = F_CSV;
 		break;
             case 'F':    			/* FITS table output	*/
-		fprintf (stderr,
-		    "FITS tables not yet implemented, using ASCII\n");
-		format = F_ASCII;           
+		format = F_FITS;		/* written by the sinks	*/
+                extract |= EX_COLLECT;
+		inproc = TRUE;
 		break;
             case 'H':				/* HTML output		*/
                 extract |= EX_HTML;
@@ -592,11 +632,13 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 		    if (strlen (argfile) > 1) {
 			fprintf (stderr, "ERROR: the '-i' flag requires ");
 			fprintf (stderr, "a filename or '-' for stdin\n");
-			exit (1);
+			status = ERR;
+			goto cleanup_;
 		    } else if (rd_stdin) {
 			fprintf (stderr,
 				"ERROR: stdin can only be used once\n");
-			exit (1);
+			status = ERR;
+			goto cleanup_;
 		    } else {
 			rd_stdin++;
 			arg_fd = stdin;
@@ -637,7 +679,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 		    if (rd_stdin) {
                         fprintf (stderr,
                             "ERROR: stdin can only be used once\n");
-                        exit (1);
+			status = ERR;
+			goto cleanup_;
 
 		    } else {
                         rd_stdin++;
@@ -669,7 +712,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 			return (ERR);
                     } else if (rd_stdin) {
                         fprintf(stderr, "ERROR: stdin can only be used once\n");
-                        exit (1);
+			status = ERR;
+			goto cleanup_;
 		    } else {
                         rd_stdin++, fixed_pos++;
 			vot_readObjFile ("-");
@@ -708,7 +752,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 		    if (strlen (next_arg) > 1) {
 			fprintf(stderr,"ERROR: the '-s' flag requires ");
 			fprintf(stderr,"a service name or '-' for stdin\n");
-			exit (1);
+			status = ERR;
+			goto cleanup_;
 		    } else
 			vot_readSvcFile ("-", dalOnly);
 //		    i++;			/* advance argv 	*/
@@ -752,7 +797,10 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 		    long_opts[pos].name);
 		status = ERR;
 		goto cleanup_;
-            }
+            } else if (ch == ARG_ERR) {
+		status = ERR;
+		goto cleanup_;
+	    }
 
 
 #ifdef ENG_FLAGS
@@ -818,7 +866,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 
     	    for (i=optind ; i < argc; i++) {
 	        if (vot_parseArgToken(pargv[i], pargv[i+1], apos, &inc) != OK) {
-	    	    exit (1);
+		    status = ERR;
+		    goto cleanup_;
 	        } else 
 	            i += inc;		/* add the argv[] increment  	*/
 
@@ -891,7 +940,8 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
 
 	    if (nobjects == 0 && sources == NULL) {
 		fprintf (stderr, "No object position(s) specified.\n");
-		exit (1);
+		status = ERR;
+		break;
 
 	    } else {
     	        vot_printSvcHdr ();
@@ -919,10 +969,11 @@ vodata (int argc, char *argv[], size_t *reslen, void **result)
             */
     	    vot_printSvcHdr ();
     
-            /* Now run the serice queries.  Each service is run on a separate
-            ** thread, we'll handle summary output and any postprocessing later.
+            /* Now run the service queries.  The (service x object) queries
+            ** share one pool of child processes, we'll handle summary output
+            ** and any postprocessing later.
             */
-            vot_runSvcThreads ();
+            vot_runSvcQueries ();
         }
     
         /*  Process the access reference list to download any pending data.
@@ -983,7 +1034,7 @@ cleanup_:
 /*  Set an argument that may optionally be specified as an entire word.
 */
 
-#define	ARG_DONE	-1
+static int  arg_err	= 0;		/* missing/invalid word value	*/
 
 static char
 vot_setArgWord (char *arg, char *val)
@@ -991,6 +1042,8 @@ vot_setArgWord (char *arg, char *val)
     if (PARAM_DBG)
 	fprintf (stderr, "setArg = '%s'  val = '%s'\n", arg, val);
 
+    arg_err = 0;
+
     if (arg[0] == '-') {
 	fprintf (stderr, "Invalid argument string '--'\n");
 	return (0);
@@ -1128,6 +1181,10 @@ vot_setArgWord (char *arg, char *val)
             max_threads = vot_atoi(ip);
             max_threads = min(MAX_THREADS,max_threads);
             break;
+        case 'h':			/* --maxhost=<N>	*/
+            max_hostq = vot_atoi(ip);
+            max_hostq = min(MAX_QUERIES,max_hostq);
+            break;
         }
 
     } else if (strncmp (arg, "nlines", 6) == 0) {
@@ -1143,7 +1200,8 @@ vot_setArgWord (char *arg, char *val)
         if (!ip || ip[0] == '-') {
             if (rd_stdin) {
                 fprintf (stderr, "ERROR: stdin can only be used once\n");
-                exit (1);
+		free ((void *) ip);
+		return (ARG_ERR);
 
             } else {
                 rd_stdin++;
@@ -1190,18 +1248,19 @@ vot_setArgWord (char *arg, char *val)
             if (strlen (ip) > 1) {
                 fprintf (stderr,"ERROR: the '--pos' flag requires ");
                 fprintf (stderr,"coords or '-' for stdin\n");
-                exit (1);
+		free ((void *) ip);
+		return (ARG_ERR);
             } else if (rd_stdin) {
                 fprintf (stderr, "ERROR: stdin can only be used once\n");
-                exit (1);
-                rd_stdin++, fixed_pos++;
+		free ((void *) ip);
+		return (ARG_ERR);
             } else {
                 vot_readObjFile ("-");
             }
         } else {
 	    char v1[SZ_FNAME], v2[SZ_FNAME], *op;
 
-	    op = strchr (val, (int)',');   /* find delimiter  	*/
+	    op = (val ? strchr (val, (int)',') : NULL);   /* find delimiter */
 	    memset (v1, 0, SZ_FNAME);	   /* clear arrays    	*/
 	    memset (v2, 0, SZ_FNAME);
 	    if (op) {
@@ -1210,7 +1269,8 @@ vot_setArgWord (char *arg, char *val)
 		strcpy (v2, op+1);	   /* second arg	*/
 	    } else {
                 fprintf (stderr, "ERROR: Invalid '--pos' argument\n");
-                exit (1);
+		free ((void *) ip);
+		return (ARG_ERR);
 	    }
 
             if (isSexagesimal(v1) || isDecimal(v1)) {
@@ -1234,7 +1294,7 @@ vot_setArgWord (char *arg, char *val)
     } else if (strncmp (arg, "sr", 2) == 0) {
 	char *ip = vot_requiredArg (val);
 	int  len = strlen(ip);
-	char units = ip[len-1];
+	char units = (len > 0 ? ip[len-1] : '0');
 
 	if (!isdigit(units))
 	    ip[len-1] = '\0';
@@ -1258,7 +1318,8 @@ vot_setArgWord (char *arg, char *val)
             if (strlen (ip) > 1) {
                 fprintf (stderr,"ERROR: the '-s' flag requires ");
                 fprintf (stderr,"a service name or '-' for stdin\n");
-                exit (1);
+		free ((void *) ip);
+		return (ARG_ERR);
             } else
                 vot_readSvcFile ("-", dalOnly);
         } else {
@@ -1286,6 +1347,14 @@ vot_setArgWord (char *arg, char *val)
     } else if (strncmp (arg, "onefile",  7) == 0) {
 	extract |= EX_COLLECT;			/* one-file output	*/
 
+    } else if (strncmp (arg, "inproc",  6) == 0) {
+	inproc = TRUE;				/* in-process queries	*/
+
+    } else if (strncmp (arg, "nocache",  7) == 0) {
+	qcache = QC_OFF;			/* bypass result cache	*/
+    } else if (strncmp (arg, "refresh",  7) == 0) {
+	qcache = QC_REFRESH;			/* refresh result cache	*/
+
     } else if (strncmp (arg, "wb", 2) == 0 || 
 	strncmp (arg, "webnoborder", 9) == 0) {
             html_border = FALSE;  		/* disable table border    */
@@ -1325,7 +1394,7 @@ vot_setArgWord (char *arg, char *val)
 	d2_version = vot_requiredArg (val);
     }
 
-    return (ARG_DONE);
+    return (arg_err ? ARG_ERR : ARG_DONE);
 }
 
 
@@ -1333,8 +1402,9 @@ static char *
 vot_requiredArg (char *arg)
 {
     if (! arg) {
-        fprintf (stderr, "ERROR: Missing '--%s' argument.\n", arg);
-        exit (1);
+        fprintf (stderr, "ERROR: Missing option argument.\n");
+	arg_err++;
+	return ( strdup ("") );
     }
 
     return ( strdup (arg) );
@@ -1412,7 +1482,7 @@ vot_parseArgToken (char *arg, char *next, int pos, int *inc)
 	    } else {
 		fprintf (stderr, "Invalid resource type for Inventory, '%s'\n",
 		    arg);
-		exit (1);
+		return (ERR);
 	    }
 #endif
 
@@ -1522,13 +1592,17 @@ vot_getNextCmdline ()
 	strcpy (a_argv[a_argc++], tok);
     }
 
-    if (voc_initVOClient ("runid=voc.vodata") == ERR) 
-        exit (-1);
+    if (voc_initVOClient ("runid=voc.vodata") == ERR) {
+	status = ERR;
+        return (ERR);
+    }
 
     apos = sv_apos;
     for (i=0; i < a_argc; i++) {
         if (vot_parseArgToken (a_argv[i], a_argv[i+1], apos, &inc) != OK) {
-    	    exit (1);
+    	    voc_closeVOClient (0);
+	    status = ERR;
+	    return (ERR);
         } else 
             i += inc;		/* add the argv[] increment  	*/
 
@@ -1576,6 +1650,14 @@ vot_validateOptions ()
     if (output && output[0] == '-')
 	extract |= EX_COLLECT;
 
+    /*  FITS tables are only written by the in-process result sinks.
+    */
+    if (format == F_FITS && (samp || meta || count_only)) {
+	fprintf (stderr,
+	    "FITS tables not supported with this output, using ASCII\n");
+	format = F_ASCII;
+    }
+
     if (kml_sample)
 	kml_max *= kml_sample;
 
@@ -1623,84 +1705,252 @@ vot_printSvcHdr ()
 
 
 /************************************************************************
-**  RUNSVCTHREADS --  Begin a processing thread for each data service.  We
-**  split the object list over each service in parallel threads.
+**  RUNSVCQUERIES --  Run the (service x object) queries.  Every query is a
+**  child process started by the service's call function; they are run
+**  from one pool of at most (maxthreads * maxprocs) children, with at most
+**  'maxprocs' running for any one service and 'maxhost' on any one server.
+**  A free slot goes to the next service (round-robin) that has queries
+**  left and is under its limits, so a slow service never holds the others
+**  back.  Only our own children are reaped so each status is recorded
+**  against the query that produced it.
+**
+**  With the 'inproc' option the same pool is instead served by a set of
+**  query threads calling the services directly (see vot_dalQuery()), so
+**  no process is forked per query.  Metadata and SAMP queries always use
+**  the forked callers.
+**
+**  When the service list comes from a feed (see vot_svcFeedRead()) the
+**  services are queued as they arrive, so the first queries run while the
+**  producer is still finding the rest.  At most FEED_QMAX services are
+**  taken from the feed ahead of their first query.
 */
+
+#define	QUERY_POLL	20000		/* reap poll interval (usec)	*/
+#define	FEED_QMAX	256		/* max services waiting on feed */
+
+typedef struct {
+    Service *svc;			/* service			*/
+    Proc    *next;			/* next query to start		*/
+    Object  *obj;			/* its object			*/
+    int      nobj;			/* its object number (1-indexed)*/
+    int      nrun;			/* queries running		*/
+    int      ndone;			/* queries completed		*/
+    int      host;			/* server index			*/
+} svcQueue;
+
+typedef struct {
+    pid_t     pid;			/* child pid (0 = free slot)	*/
+    Proc     *proc;			/* query being run		*/
+    svcQueue *sq;			/* its service			*/
+} querySlot;
+
+typedef struct {
+    svcQueue **queue;			/* service queues		*/
+    int        nsvc;			/* no. of services		*/
+    int        nalloc;			/* queues allocated		*/
+    char     **hosts;			/* server names			*/
+    int        nhosts;			/* no. of servers		*/
+    int       *hrun;			/* queries running per server	*/
+} svcQueues;
+
+typedef struct {
+    svcQueues *sq;			/* service queues		*/
+    int        cur;			/* next service to try		*/
+    int        nstart;			/* queries started		*/
+    int        ntot;			/* total queries		*/
+    int        feeding;			/* services still arriving?	*/
+    pthread_cond_t cond;		/* signaled as queries finish	*/
+} queryPool;
+
+extern pthread_mutex_t vot_dalLock;
+extern int   vot_dalQuery (svcParams *pars, int *count);
+extern int   vot_sinkInit (void);
+extern int   vot_sinkEnabled (void);
+extern void  vot_sinkClose (void);
+extern int   vot_kmlSinkInit (void);
+extern void  vot_kmlSinkClose (int save);
+
+static svcQueue *vot_nextQuery (svcQueues *qs, int *cur, svcParams *pars,
+		Proc **proc);
+static int   vot_queueSvcs (svcQueues *qs, Service *svc);
+static int   vot_svcWaiting (svcQueues *qs);
+static void  vot_queryDone (svcQueue *sq, Proc *cp, int status, int *hrun);
+static void *vot_queryThread (void *data);
+
+
 static void
-vot_runSvcThreads ()
+vot_runSvcQueries ()
 {
-    int     t, tc, rc, status, t_start, t_end, nthreads;
-/*
-    pthread_t  thread[nservices];
-*/
-    static pthread_t  thread[10000];
-    Service *svc = svcList;
-    Proc    *new = (Proc *)NULL;
-    Proc    *cur = (Proc *)NULL;
-    pthread_attr_t  attr;		/* thread attributes		*/
+    int     i, t, status, maxrun, nrun, ndone, ntot;
+    int     cur, started, reaped;
+    pid_t   pid, r_pid;
+    Service  *svc = svcList, *last;
+    Proc     *cp  = (Proc *)NULL;
+    svcQueue  *sq;
+    svcQueues  qs;
+    querySlot *slot;
+    svcParams  pars;
 
 
     qs_time = time ((time_t *) NULL);
 
     if (verbose && !count && !meta && nservices > 1)
-	fprintf (stderr, "# Creating service processing threads...\n");
+	fprintf (stderr, "# Starting service queries...\n");
 
-    /* Pre-allocate the process lists so they're in the global memory
+    /* Set up the service queues and the server each one is on.  The
+    ** process lists are pre-allocated so they're in the global memory
     ** space.
     */
-    for (svc=svcList; svc; svc=svc->next) {
-	for (t=0; t < nobjects; t++) {
-	    new = (Proc *) calloc (1, sizeof (Proc));
-	    new->svc = (Service *) svc;		/* set back pointer	*/
-	    if (t == 0) {
-		svc->proc = new;
-		cur = svc->proc;
-	    } else {
-		cur->next = new;
-		cur = cur->next;
-	    }
+    memset (&qs, 0, sizeof (qs));
+    if (svcList == NULL || nobjects <= 0)
+	return;
+    ntot = vot_queueSvcs (&qs, svcList) * nobjects;
+
+    maxrun = max(1, min(MAX_QUERIES, max(1,max_threads) * max(1,max_procs)));
+    slot   = (querySlot *) calloc (maxrun, sizeof (querySlot));
+
+
+    if (inproc && !meta && !samp) {
+	/* Run the queries from a pool of query threads.  Each in-process
+	** query holds a DALClient connection context while it runs, so the
+	** thread count is kept well under the number of those.  We take
+	** any services still arriving on the feed while they run.
+	*/
+	queryPool  qp;
+	pthread_t *tids;
+	pthread_attr_t attr;
+	int nthreads = max(1, min(MAX_DALTHREADS, maxrun));
+
+	if (!vot_svcFeedActive ())
+	    nthreads = min(nthreads, ntot);
+
+	memset (&qp, 0, sizeof (qp));
+	qp.sq      = &qs;
+	qp.ntot    = ntot;
+	qp.feeding = vot_svcFeedActive ();
+	pthread_cond_init (&qp.cond, NULL);
+	(void) vot_sinkInit ();		/* one-file output in-memory	*/
+	(void) vot_kmlSinkInit ();	/* KML documents to one spool	*/
+
+	tids = (pthread_t *) calloc (nthreads, sizeof (pthread_t));
+	pthread_attr_init (&attr);
+	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+	for (i=0, t=0; i < nthreads; i++)
+	    if (pthread_create (&tids[t], &attr, vot_queryThread, &qp) == 0)
+		t++;
+
+	while (qp.feeding) {
+	    pthread_mutex_lock (&vot_dalLock);
+	    while (t > 0 && vot_svcWaiting (&qs) >= FEED_QMAX)
+		pthread_cond_wait (&qp.cond, &vot_dalLock);
+	    pthread_mutex_unlock (&vot_dalLock);
+
+	    last = svcTail;
+	    (void) vot_svcFeedRead (1);
+
+	    pthread_mutex_lock (&vot_dalLock);
+	    qp.ntot += vot_queueSvcs (&qs, last->next) * nobjects;
+	    qp.feeding = vot_svcFeedActive ();
+	    pthread_cond_broadcast (&qp.cond);
+	    pthread_mutex_unlock (&vot_dalLock);
 	}
-    }
 
-    nthreads = min (nservices, max_threads);
-    t_start = 0;
-    t_end   = nthreads;
+	if (t == 0)
+	    (void) vot_queryThread (&qp);	/* run them ourselves	*/
+	for (i=0; i < t; i++)
+	    pthread_join (tids[i], NULL);
 
+	pthread_attr_destroy (&attr);
+	pthread_cond_destroy (&qp.cond);
+	free ((void *) tids);
+	ntot = 0;				/* all queries done	*/
+    }
 
-    /* Spawn the processing threads.
-    */
-    svc = svcList;
-    for (tc=0; tc < nservices; tc += nthreads) {
-        t_end   = min((nservices-tc),nthreads);
+    for (cur=nrun=ndone=0; ndone < ntot || vot_svcFeedActive (); ) {
 
-        /* Initialize the service processing thread attributes and run 'em.
-        */
-        pthread_attr_init (&attr);
-        pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
-
-        for (t=0; t < t_end; t++, svc=svc->next) {
-	    if ((rc = pthread_create (&thread[t], &attr, vot_procObjs, 
-		(void *)svc))) {
-	            fprintf (stderr,
-			"ERROR: pthread_create() fails, code: %d\n", rc);
-	            exit (-1);
-	    }
-        }
+	/* Take the services that have arrived on the feed, waiting for
+	** them if there's nothing else to do.
+	*/
+	if (vot_svcFeedActive () && vot_svcWaiting (&qs) < FEED_QMAX) {
+	    last = svcTail;
+	    (void) vot_svcFeedRead (nrun == 0 && ndone == ntot);
+	    ntot += vot_queueSvcs (&qs, last->next) * nobjects;
+	}
 
-        /* Free attribute and wait for the threads to complete.
+        /* Fill the free slots from the services that can take them.
         */
-        for (t=0; t < t_end; t++) {
-	    if ((rc = pthread_join (thread[t], (void **)&status)) ) {
-		/*
-	        fprintf (stderr, "ERROR: pthread_join() fails, code: %d\n", rc);
-	        exit (-1);
-		*/
+	for (started=0; nrun < maxrun; ) {
+	    if (!(sq = vot_nextQuery (&qs, &cur, &pars, &cp)))
+		break;				/* nothing can start now  */
+	    svc = sq->svc;
+
+	    if ((pid = (*(PFI)(*svc->func))((void *)&pars)) < 0) {
+	        fprintf (stderr,"ERROR: process fork() fails\n");
+		sq->nrun++, qs.hrun[sq->host]++;
+		vot_queryDone (sq, cp, E_REQFAIL, qs.hrun);
+		ndone++;
+		continue;
+	    } else if (pid == 0)
+		vot_dalExit (E_NONE, 0);	/* child returned	*/
+
+	    cp->pid = pid;			/* load the process struct */
+    	    memset (cp->root, 0, SZ_FNAME);
+	    if (use_name || all_named || id_col)
+		strcpy (cp->root, vot_getOFName (&pars, NULL));
+            else
+		strcpy (cp->root, vot_getOFIndex (&pars, NULL));
+
+	    for (i=0; slot[i].pid; i++)		/* take a free slot	*/
 		;
-	    }
-        }
+	    slot[i].pid  = pid;
+	    slot[i].proc = cp;
+	    slot[i].sq   = sq;
+	    sq->nrun++, qs.hrun[sq->host]++, nrun++;
+	    started++;
+
+	    if (debug)
+		fprintf (stderr, "runSvcQueries(%s): %d ra=%f dec=%f pid=%d\n",
+    		    svc->name, pars.index, pars.ra, pars.dec, pid);
+	}
 
-        pthread_attr_destroy (&attr);
+	/* Reap the queries that have completed.
+	*/
+	for (i=0, reaped=0; i < maxrun; i++) {
+	    if (slot[i].pid == 0)
+		continue;
+	    if ((r_pid = waitpid (slot[i].pid, &status, WNOHANG)) == 0)
+		continue;
+
+	    if (r_pid < 0)			/* lost the child	*/
+		status = E_REQFAIL;
+	    else if (WIFSIGNALED(status))
+		status = E_REQFAIL;
+	    else
+		status = WEXITSTATUS(status);
+	    if (debug)
+		fprintf (stderr, "pid = %d  stat = %d\n", slot[i].pid, status);
+
+	    vot_queryDone (slot[i].sq, slot[i].proc, status, qs.hrun);
+	    nrun--, ndone++;
+	    slot[i].pid = 0;
+	    reaped++;
+	}
+
+	if (!started && !reaped)
+	    usleep (QUERY_POLL);
     }
+
+    nservices = vot_countServiceList ();	/* including fed services */
+
+    for (i=0; i < qs.nhosts; i++)
+	free ((void *) qs.hosts[i]);
+    for (i=0; i < qs.nsvc; i++)
+	free ((void *) qs.queue[i]);
+    free ((void *) qs.hosts);
+    free ((void *) qs.hrun);
+    free ((void *) qs.queue);
+    free ((void *) slot);
+
     qe_time = time ((time_t *) NULL);
 
     if ((debug && verbose > 1)) {
@@ -1725,6 +1975,7 @@ vot_runSvcThreads ()
 	    strcpy (fname, "-");
 	if (nservices > 1 && nobjects > 1)
 	    vot_concatKML (fname);	
+	vot_kmlSinkClose (!(nservices > 1 && nobjects > 1));
 
     } else if (format & F_XML || (extract & EX_XML && extract & EX_COLLECT)) {
  	    char  fname[SZ_FNAME];
@@ -1742,7 +1993,10 @@ vot_runSvcThreads ()
     } else if (extract & EX_COLLECT) {
 	extern void vot_concat (void);
 
-	vot_concat ();			/* concatenate results		*/
+	if (vot_sinkEnabled ())
+	    vot_sinkClose ();		/* finish the service outputs	*/
+	else
+	    vot_concat ();		/* concatenate results		*/
     }
 
 
@@ -1830,260 +2084,321 @@ vot_printSvcList (Service *sl)
 }
 
 
+static char *
+vizPatch (char *url)
+{
+    static char new[SZ_LINE], *ip, *op;
+
+    memset (new, 0, SZ_LINE);
+    for (ip=url, op=new; *ip; ) {
+	if (*ip == '&' && *(ip+1) == '/')
+	   ip++;
+	*op++ = *ip++;
+    }
+
+    return (new);
+}
+
+
 /************************************************************************
-**  PROCOBJS --  Create threads to process the object list.  Our only 
-**  argument is the Service object to run.
+**  SETPROCSTAT -- Set the process return status of a query.  'pp' is the
+**  query's entry in the process list of service 'svc'.
 */
-void *
-vot_procObjs (void *arg)
+static void
+vot_setProcStat (Service *svc, Proc *pp, int status)
 {
-    int    nobj, nprocs, nrunning, nremaining, nupdate;
-    int    lock,  nrep, status;
-    pid_t  r_pid, pid;
+    int    i, sem_id, nf = 1;
 
-    Object *obj    = objList;
-    Service *svc   = (Service *)arg;
-    Proc *curproc  = (Proc *) svc->proc;
-    svcParams  pars;
 
-		
-    /* Figure out how many threads to run at a time.
+    /* Set the status for this svc/obj process.
     */
-    nprocs = ( (nobjects > max_threads) ?  max_threads : nobjects );
-    nupdate  = 10;
+    pp->status = status;
 
-    nrep = nrunning = 0;
-    nremaining = nobjects;
+    /* Get the semaphore set by the child indicating the result count.  An
+    ** in-process query (no pid) has already set its count.
+    */
+    if (pp->pid > 0) {
+	pp->count = 0;
+	if ((sem_id = semget (pp->pid, 0, 0)) >= 0) {
+	    if ((pp->count = semctl (sem_id, 0, GETVAL, 0)) < 0)
+		pp->count = 0;
+    	    (void) semctl (sem_id, 0, IPC_RMID, NULL);    /* release it */
+	}
+    }
+    svc->count += pp->count;
 
-    for (nobj=1; nremaining > 0; ) {
+    if (status != E_NONE && status != E_NODATA)
+        svc->nfailed++;
+    else if (status == E_NODATA || pp->count == 0)
+        svc->nnodata++;
 
-	if (debug)
-	    fprintf (stderr, "procObjs(%s): n=%d/%d nprocs=%d nrun=%d sr=%f\n",
-    	  	svc->name, nobj, nobjects, nprocs, nrunning, sr);
+    /* If we created a URL extraction, add the URLS to the access list.
+    */
+    if (extract == EX_ACREF || extract == EX_BOTH) {
+	char  fname[SZ_FNAME], url[SZ_URL];
+	FILE  *fd;
 
-        /* Spawn a process thread for each object/position.
-        */
-	if (nrunning < nprocs && nobj <= nobjects) {
+	/* Get the filename of the URLs we'll get.
+	*/
+	memset (fname, 0, SZ_FNAME);
+	sprintf (fname, "%s.urls", pp->root);
 
-	    /* Set up the service parameter struct.  Each thread gets its
-	    ** own instance.
-	    */
-	    strcpy (pars.service_url, vizPatch(svc->service_url));
-	    strcpy (pars.identifier, svc->identifier);
-	    strcpy (pars.name, svc->name);
-	    if (id_col && obj->id && obj->id[0])
-	        strcpy (pars.oname, obj->id);
-	    else
-	        strcpy (pars.oname, obj->name);
-	    strcpy (pars.title, svc->title);
-	    pars.ra    = obj->ra;
-	    pars.dec   = obj->dec;
+	/* Construct a template for each file.
+	*/
+	if (access (fname, R_OK) == 0 && (fd = fopen (fname, "r"))) {
+	    for (i=1; fgets (url, SZ_URL, fd); i++) {
+		url[strlen(url)-1] = '\0';  /* kill newline   */
+		    
+		memset (fname, 0, SZ_FNAME);
+		if (file_get > 1)
+		    sprintf (fname, "%s.%03d", pp->root, i);
+		else
+		    sprintf (fname, "%s", pp->root);
+
+		if (file_get && is_in_range(fileRange.ranges,i)) {
+		    vot_addToAclist (url, fname);
+		    nf++;
+		}
+	    }
+	    fclose (fd);
+	}
+    }
+}
 
-	    /*  Prior to Registry 1.0 we didn't have a real cone capability
-	    **  for Vizier tables and needed to set flags to download the
-	    **  entire table.  This is no longer necessary, the user can set
-	    **  a negative search radius to get the entire table if they choose.
 
-	    pars.sr    = sr;
-	    */
-	    if (all_data && svc->type == SVC_VIZIER)
-	 	pars.sr = -1.0;
-	    else
-		pars.sr = sr;
-	    pars.fmt   = format;
-	    pars.type  = svc->type;
-	    pars.index = nobj;
-	    pars.obj_index = nobj - 1;		/* zero-indexed		*/
-	    pars.svc_index = svc->index;
+/************************************************************************
+**  NEXTQUERY -- Take the next query to run from the first service (round-
+**  robin from 'cur') that has queries left and is under its limits, and
+**  set up its service parameters.  Returns the service queue or NULL if
+**  nothing can start now.
+*/
+static svcQueue *
+vot_nextQuery (svcQueues *qs, int *cur, svcParams *pars, Proc **proc)
+{
+    svcQueue *sq = (svcQueue *) NULL;
+    Service  *svc;
+    Proc     *cp;
+    int       k, nsvc = qs->nsvc;
 
-	    if ((pid = (*(PFI)(*svc->func))((void *)&pars)) < 0) {
-	        fprintf (stderr,"ERROR: process fork() fails\n");
-	        pthread_exit ((void *) NULL);
-	    }
-	    nrunning++;
-	    nobj++;
 
-            /* Allocate the process summary struct.  Only save the status if
-	    ** we'll be printing a summary later.
-            */
-    	    if ((extract & EX_COLLECT) || !quiet) {
-
-		/* Lock the thread to protect us from messing with the
-		** service list data.
-		*/
-	        lock = pthread_mutex_lock (&svc_mutex);
-	        curproc->pid = pid;	    /* load the process struct	*/
-	        curproc->obj = obj;
-	        curproc->status = 0;
-    		memset (curproc->root, 0, SZ_FNAME);
-		if (use_name || all_named || id_col)
-		    strcpy (curproc->root, vot_getOFName(&pars,NULL,(int)pid));
-                else
-		    strcpy (curproc->root, vot_getOFIndex(&pars,NULL,(int)pid));
-
-
-	        curproc = curproc->next;    /* move on			*/
-		lock = pthread_mutex_unlock (&svc_mutex);
-	    }
+    for (k=0; k < nsvc; k++) {
+	sq = qs->queue[(*cur + k) % nsvc];
+	if (sq->nobj <= nobjects && sq->nrun < max(1,max_procs) &&
+	    qs->hrun[sq->host] < max(1,max_hostq))
+	        break;
+	sq = NULL;
+    }
+    if (sq == NULL)
+	return (NULL);
+    *cur = (*cur + k + 1) % nsvc;
 
-	    if (debug)
-		fprintf (stderr, "procObjs(%s): %d ra=%f dec=%f pid=%d\n",
-    		    svc->name, nobj, obj->ra, obj->dec, pid);
+    /* Set up the service parameter struct, a child gets its own copy.
+    */
+    svc = sq->svc;
+    memset (pars, 0, sizeof (svcParams));
+    strcpy (pars->service_url, vizPatch(svc->service_url));
+    strcpy (pars->identifier, svc->identifier);
+    strcpy (pars->name, svc->name);
+    if (id_col && sq->obj->id && sq->obj->id[0])
+        strcpy (pars->oname, sq->obj->id);
+    else
+        strcpy (pars->oname, sq->obj->name);
+    strcpy (pars->title, svc->title);
+    pars->ra    = sq->obj->ra;
+    pars->dec   = sq->obj->dec;
+
+    /*  Prior to Registry 1.0 we didn't have a real cone capability
+    **  for Vizier tables and needed to set flags to download the
+    **  entire table.  This is no longer necessary, the user can set
+    **  a negative search radius to get the entire table if they choose.
+    */
+    if (all_data && svc->type == SVC_VIZIER)
+ 	pars->sr = -1.0;
+    else
+	pars->sr = sr;
+    pars->fmt   = format;
+    pars->type  = svc->type;
+    pars->index = sq->nobj;
+    pars->obj_index = sq->nobj - 1;	/* zero-indexed		*/
+    pars->svc_index = svc->index;
+
+    cp = sq->next;
+    cp->obj = sq->obj;
+    cp->status = 0;
+    sq->next = cp->next;
+    sq->obj  = sq->obj->next;
+    sq->nobj++;
+
+    *proc = cp;
+    return (sq);
+}
 
-	    if (obj) 
-		obj = obj->next;
-		
-        } else {
 
-            /* Process table full, wait for any child processes to complete.
-            */
-	    if (debug)
-	        fprintf (stderr, "procObjs(%s:%d): waiting %d remaining....\n", 
-    		    svc->name, getpid(), nremaining);
-
-	    if ((r_pid = waitpid ((pid_t)-1, &status, (int) 0)) < 0 ) {
-		/*  FIXME
-		if (verbose || debug) 
-	            fprintf (stderr, "ERROR: waitpid() fails, code[%d] %s\n",
-		        (int)errno, strerror(errno));
-	        pthread_exit ((void *) NULL);
-		*/
-	    }
+/************************************************************************
+**  QUEUESVCS -- Add a query queue for each service from 'svc' to the end
+**  of the list, with its process list.  Returns the number added.
+*/
+static int
+vot_queueSvcs (svcQueues *qs, Service *svc)
+{
+    svcQueue *sq;
+    Proc     *new, *cp = (Proc *) NULL;
+    int       n, t;
+
+
+    for (n=0; svc; svc=svc->next, n++) {
+	if (qs->nsvc == qs->nalloc) {
+	    qs->nalloc = (qs->nalloc ? 2 * qs->nalloc : 64);
+	    qs->queue = realloc (qs->queue, qs->nalloc * sizeof (svcQueue *));
+	    qs->hosts = realloc (qs->hosts, qs->nalloc * sizeof (char *));
+	    qs->hrun  = realloc (qs->hrun, qs->nalloc * sizeof (int));
+	    memset (&qs->hrun[qs->nhosts], 0, 
+		(qs->nalloc - qs->nhosts) * sizeof (int));
+	}
 
-	    status = WEXITSTATUS(status);
-	    if (debug)
-		fprintf (stderr, "pid = %d  stat = %d\n", r_pid, status);
-		
-	    lock = pthread_mutex_lock (&svc_mutex);
-	    vot_setProcStat (svc, (int)r_pid, status);
-	    lock = pthread_mutex_unlock (&svc_mutex);
-
-	    nrunning--;
-	    nremaining--;
-        }
+	for (t=0; t < nobjects; t++) {
+	    new = (Proc *) calloc (1, sizeof (Proc));
+	    new->svc = (Service *) svc;		/* set back pointer	*/
+	    new->obj = (Object *) NULL;
+	    if (t == 0)
+		svc->proc = cp = new;
+	    else
+		cp = cp->next = new;
+	}
 
-	if (!quiet && nobj < nobjects && (nobj % nupdate) == 0 && 
-	    !count && !file_get && nrep == 0) {
-	      fprintf (stderr,
-		"# Service %15s: Completed %3d of %4d objects (%d running)\n",
-    	        svc->name, nobj, nobjects, nrunning);
-	    nrep = 1;
-	} else if (nrep == 1) 
-	    nrep = 0;
+	sq = qs->queue[qs->nsvc++] = (svcQueue *) calloc (1, sizeof (svcQueue));
+	sq->svc  = svc;
+	sq->next = svc->proc;
+	sq->obj  = objList;
+	sq->nobj = 1;
+	sq->host = vot_svcHost (svc->service_url, qs->hosts, &qs->nhosts);
     }
 
-    if (!quiet && !count && !file_get && !meta) {
-	fprintf (stderr, "# Service %25s: ", svc->name);
-	fprintf (stderr, "Finished processing (%d of %d succeeded).\n",
-	    (nobjects - (svc->nfailed + svc->nnodata)), 
-	    nobjects);
-    }
-    if (debug)  
-	fprintf (stderr, "procObjs done (%s).\n", svc->name);
+    return (n);
+}
 
 
-    pthread_exit (NULL);
+/************************************************************************
+**  SVCWAITING -- Count the services with no query started yet.
+*/
+static int
+vot_svcWaiting (svcQueues *qs)
+{
+    int  i, n = 0;
+
+    for (i=0; i < qs->nsvc; i++)
+	if (qs->queue[i]->nobj == 1)
+	    n++;
+    return (n);
 }
 
 
-static char *
-vizPatch (char *url)
+/************************************************************************
+**  QUERYDONE -- Record the status of a completed query and release its
+**  place in the service and server limits.
+*/
+static void
+vot_queryDone (svcQueue *sq, Proc *cp, int status, int *hrun)
 {
-    static char new[SZ_LINE], *ip, *op;
+    Service *svc = sq->svc;
 
-    memset (new, 0, SZ_LINE);
-    for (ip=url, op=new; *ip; ) {
-	if (*ip == '&' && *(ip+1) == '/')
-	   ip++;
-	*op++ = *ip++;
-    }
 
-    return (new);
+    vot_setProcStat (svc, cp, status);
+    sq->nrun--, hrun[sq->host]--;
+    sq->ndone++;
+
+    if (!quiet && !count && !file_get && !meta) {
+	if (sq->ndone == nobjects) {
+	    fprintf (stderr, "# Service %25s: ", svc->name);
+	    fprintf (stderr, 
+		"Finished processing (%d of %d succeeded).\n",
+	    	(nobjects - (svc->nfailed + svc->nnodata)), nobjects);
+	} else if ((sq->ndone % 10) == 0) {
+	    fprintf (stderr,
+	     "# Service %15s: Completed %3d of %4d objects (%d running)\n",
+    	     svc->name, sq->ndone, nobjects, sq->nrun);
+	}
+    }
 }
 
 
 /************************************************************************
-**  SETPROCSTAT -- Set the process return status.  'procList' is the 
-**  process list running on this particular thread.
+**  QUERYTHREAD -- Query thread for in-process queries.  Threads take the
+**  queries from the pool in the same order the forked callers would be
+**  started, waiting while every service with queries left is at one of
+**  its limits.  The pool is guarded by the 'vot_dalLock', which the query
+**  result processing also holds, so only the service request itself runs
+**  unlocked.
 */
-static void
-vot_setProcStat (Service *svc, int pid, int status)
+static void *
+vot_queryThread (void *data)
 {
-    Service *s = svcList;
-    Proc *pp;
-    int    i, rc, sem_id, n = nservices;
+    queryPool *qp = (queryPool *) data;
+    svcQueue  *sq;
+    svcParams  pars;
+    Proc      *cp;
+    int        status, nrec;
 
-    if (svcList == (Service *) NULL)
-	return;
 
-    for (s=svcList; s; s=s->next, n--) {
-        for (pp=s->proc; pp; pp=pp->next) {
-	    if (pp->pid == pid) {
-		/* Set the status for this svc/obj process.
-		*/
-	        pp->status = status;
-        	if (status == E_REQFAIL)
-            	    s->nfailed++;
-        	if (status == E_NODATA)
-            	    s->nnodata++;
-
-		/* If we created a URL extraction, add the URLS to the 
-		** access list.
-		*/
-		if (extract == EX_ACREF || extract == EX_BOTH) {
-		    char  fname[SZ_FNAME], url[SZ_URL];
-		    FILE  *fd;
-		    int   nf = 1;
-
-		    /* Get the filename of the URLs we'll get.
-		    */
-		    memset (fname, 0, SZ_FNAME);
-		    sprintf (fname, "%s.urls", pp->root);
-
-		    /* Construct a template for each file.
-		    */
-		    if (access (fname, R_OK) == 0) {
-			fd = fopen (fname, "r");
-			for (i=1; fgets (url, SZ_URL, fd); i++) {
-			    url[strlen(url)-1] = '\0';  /* kill newline   */
-		    
-			    memset (fname, 0, SZ_FNAME);
-			    if (file_get > 1)
-			        sprintf (fname, "%s.%03d", pp->root, i);
-			    else
-			        sprintf (fname, "%s", pp->root);
-
-			    if (file_get && is_in_range(fileRange.ranges,i)) {
-			        vot_addToAclist (url, fname);
-			        nf++;
-			    }
-			}
-			fclose (fd);
-		    }
-		}
+    pthread_mutex_lock (&vot_dalLock);
+    while (qp->nstart < qp->ntot || qp->feeding) {
+	if (!(sq = vot_nextQuery (qp->sq, &qp->cur, &pars, &cp))) {
+	    pthread_cond_wait (&qp->cond, &vot_dalLock);
+	    continue;
+	}
+	qp->nstart++;
+	sq->nrun++, qp->sq->hrun[sq->host]++;
 
-		/* Get the semaphore set by the child indicating the
-		** result count.
-		*/
-		sem_id = semget (pid, 0, 0);
-		pp->count = semctl (sem_id, 0, GETVAL, 0);  /* get value  */
-		s->count += pp->count;
-    		rc = semctl (sem_id, 0, IPC_RMID, NULL);    /* release it */
-        	if (status != E_NODATA && s->count == 0)
-            	    s->nnodata++;
+	cp->pid = 0;				/* no child process	*/
+    	memset (cp->root, 0, SZ_FNAME);
+	if (use_name || all_named || id_col)
+	    strcpy (cp->root, vot_getOFName (&pars, NULL));
+	else
+	    strcpy (cp->root, vot_getOFIndex (&pars, NULL));
 
-	        break;
-	    }
-        }
-    }
-    if (s == (Service *) NULL && n) {	/* no matching service found */
-	fprintf (stderr, "Warning: NO SERVICE FOUND....pid=%d  status=%d\n",
-	    pid, status);
-	return;
+	if (debug)
+	    fprintf (stderr, "queryThread(%s): %d ra=%f dec=%f\n",
+    		pars.name, pars.index, pars.ra, pars.dec);
+	pthread_mutex_unlock (&vot_dalLock);
+
+	status = vot_dalQuery (&pars, &nrec);
+
+	pthread_mutex_lock (&vot_dalLock);
+	cp->count = nrec;
+	vot_queryDone (sq, cp, status, qp->sq->hrun);
+	pthread_cond_broadcast (&qp->cond);
     }
+    pthread_mutex_unlock (&vot_dalLock);
+
+    return (NULL);
 }
 
 
+/************************************************************************
+**  SVCHOST -- Get the index of the server of a service URL, adding it to
+**  the host list if it's a new one.
+*/
+static int
+vot_svcHost (char *url, char **hosts, int *nhosts)
+{
+    char  host[SZ_LINE], *ip, *op;
+    int   i;
+
+
+    memset (host, 0, SZ_LINE);
+    ip = ((ip = strstr (url, "://")) ? ip + 3 : url);
+    for (op=host; *ip && *ip != '/' && *ip != ':' && *ip != '?' &&
+	(op - host) < (SZ_LINE - 1); )
+	    *op++ = tolower (*ip++);
+
+    for (i=0; i < *nhosts; i++)
+	if (strcmp (hosts[i], host) == 0)
+	    return (i);
+
+    hosts[*nhosts] = strdup (host);
+    return ((*nhosts)++);
+}
+
 
 /************************************************************************
 **  PRINTPROCSTAT -- Print a summary of the processing results.  If 
@@ -2250,9 +2565,12 @@ Usage()
   printf ("    --wh             Disable HTML page header\n");
 
   printf ("\n\tProcessing Options:\n");
-  printf ("    --md <N>         Set max downloads (def: 1)\n");
+  printf ("    --md <N>         Set max simultaneous downloads (def: 16)\n");
   printf ("    --mp <N>         Set max number of processes per obj query\n");
   printf ("    --mt <N>         Set max number of resource threads to run\n");
+  printf ("    --mh <N>         Set max number of queries to one server\n");
+  printf ("    --nocache        Don't use the query result cache\n");
+  printf ("    --refresh        Re-run the queries and update the cache\n");
   printf ("    \n");
 
   printf ("\n    Notes:\n");
@@ -3,6 +3,12 @@
  *
  *    Usage:
  *		voiminfo [<otps>] image.fits
+ *		voiminfo [<otps>] [image.fits | dir | @file] ...
+ *
+ *  Directories are expanded to the FITS files they contain and '@file'
+ *  arguments to the names listed in the file.  The images are read in
+ *  chunks on a pool of threads (see vot_imageInfoList()), and the results
+ *  printed in the order given.
  *
  *  @file       voiminfo.c
  *  @author     Mike Fitzpatrick
@@ -17,6 +23,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "votParse.h"			/* keep these in order!		*/
 #include "voApps.h"
@@ -24,8 +32,8 @@
 
 
 
-#define	MAX_IMAGES	20480		/* max images to process	*/
-#define SZ_RESBUF	819200
+#define	SZ_RESBUF	819200
+#define	SCAN_CHUNK	1024		/* images read at a time	*/
 
 #define	OPT_ALL		0001
 #define	OPT_BOX		0002
@@ -48,6 +56,8 @@ static int do_corners	= 0;		/* print image corners		*/
 static int do_extns	= 0;		/* print extension values	*/
 static int do_info	= 0;		/* print image info		*/
 static int do_naxis	= 0;		/* print NAXIS values		*/
+static int do_cache	= 0;		/* use the header cache		*/
+static int nthreads	= 0;		/* scan threads (0 = ncpus)	*/
 
 static int debug	= 0;		/* debug flag			*/
 static int verbose	= 1;		/* verbose flag			*/
@@ -59,7 +69,7 @@ static int verbose	= 1;		/* verbose flag			*/
 int  voiminfo (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "voiminfo",  voiminfo,  0,  0,  0  };
-static char  *opts 	= "%:habcdvnseio:r";
+static char  *opts 	= "%:habcdvnseio:rN:C";
 static struct option long_opts[] = {
         { "test",         1, 0,   '%'},		/* --test is std	*/
         { "help",         2, 0,   'h'},		/* --help is std	*/
@@ -75,6 +85,8 @@ static struct option long_opts[] = {
         { "naxes",     	  2, 0,   'n'},		/* print NEXIS values 	*/
         { "output",       1, 0,   'o'},		/* output filename	*/
         { "sex",          2, 0,   's'},		/* sexagesimal values	*/
+        { "nthreads",     1, 0,   'N'},		/* scan threads		*/
+        { "cache",        2, 0,   'C'},		/* use header cache	*/
         { NULL,           0, 0,    0 }
 };
 
@@ -88,6 +100,10 @@ static char *fmt (double pos, int is_ra);
 static char *fmt_naxis (char *imname, ImInfo *im, int do_all);
 static char *fmt_box (char *imname, ImInfo *im, int do_all);
 static char *fmt_corners (char *imname, ImInfo *im, int do_all);
+static int   add_image (char *name, char ***imlist, int *nfiles, int *nalloc);
+static int   add_dir (char *dir, char ***imlist, int *nfiles, int *nalloc);
+static int   add_list (char *fname, char ***imlist, int *nfiles, int *nalloc);
+static int   cmp_names (const void *a, const void *b);
 
 extern int   vos_getURL (char *url, char *name);
 
@@ -102,24 +118,32 @@ voiminfo (int argc, char **argv, size_t *reslen, void **result)
     /*  These declarations are required for the VOApps param interface.
      */
     char **pargv, optval[SZ_FNAME], resbuf[SZ_RESBUF];
-    char   imname[SZ_LINE];
+    char   tmpname[SZ_LINE];
 
 
     /*  These declarations are specific to the task.
      */
-    char   *oname = NULL, *imlist[MAX_IMAGES], *nimlist[MAX_IMAGES];
-    int     i, ch = 0, status = OK, pos = 0, nfiles = 0, narg = 0;;
+    char   *oname = NULL, **imlist = NULL, *imname, *names[SCAN_CHUNK];
+    int     i, j, n, ch = 0, status = OK, pos = 0, nfiles = 0, nalloc = 0;
     size_t  maxlen = SZ_RESBUF;
     FILE   *fd = (FILE *) NULL;
-    ImInfo *im;
+    ImInfo *im, *info[SCAN_CHUNK];
+    struct stat st;
 
 
     /* Initialize result object	whether we return an object or not.
      */
     *reslen = 0;	
     *result = NULL;
-    memset (imlist,  0, MAX_IMAGES);
-    memset (nimlist, 0, MAX_IMAGES);
+
+    /*  Initialize the task options, the task may be run more than once.
+     */
+    do_return = 0;
+    do_all    = do_sex  = do_box   = do_corners = 0;
+    do_extns  = do_info = do_naxis = do_cache   = 0;
+    nthreads  = 0;
+    debug     = 0;
+    verbose   = 1;
 
 
     /*  Parse the argument list.  The use of vo_paramInit() is required to
@@ -150,6 +174,8 @@ voiminfo (int argc, char **argv, size_t *reslen, void **result)
 	    case 's':  do_sex++;			break;
 	    case 'n':  do_naxis++;			break;
 	    case 'o':  oname = strdup (optval);		break;
+	    case 'N':  nthreads = atoi (optval);	break;
+	    case 'C':  do_cache++;			break;
 	    default:
 		fprintf (stderr, "Invalid option '%s'\n", optval);
 		return (1);
@@ -162,25 +188,28 @@ voiminfo (int argc, char **argv, size_t *reslen, void **result)
 	    /*  This code processes the positional arguments.  The 'optval'
 	     *  string contains the value but since this string is
 	     *  overwritten w/ each arch we need to make a copy (and must
-	     *  remember to free it later.
+	     *  remember to free it later.  Directories and '@file' lists
+	     *  are expanded to the images they name.
 	     */
-	    imlist[nfiles++] = strdup (optval);
-	    narg++;
-	}
-
-	if (narg > MAX_IMAGES) {
-            fprintf (stderr, "ERROR: Too many images to process\n");
-            return (1);
+	    if (optval[0] == '@')
+		status = add_list (&optval[1], &imlist, &nfiles, &nalloc);
+	    else if (stat (optval, &st) == 0 && S_ISDIR(st.st_mode))
+		status = add_dir (optval, &imlist, &nfiles, &nalloc);
+	    else
+		status = add_image (optval, &imlist, &nfiles, &nalloc);
+	    if (status != OK)
+		return (ERR);
 	}
     }
 
 
     /*  Sanity checks.
      */
-    if (imlist[0] == NULL || strcmp (imlist[0], "-") == 0) { 
+    if (nfiles == 0) {
+	(void) add_image ("stdin", &imlist, &nfiles, &nalloc);
+    } else if (strcmp (imlist[0], "-") == 0) { 
 	free (imlist[0]);
 	imlist[0] = strdup ("stdin");  
-	nfiles = 1;
     }
     if (do_all && strcasecmp (imlist[0], "stdin") == 0) {
 	fprintf (stderr, "Error: Option not supported with standard input\n");
@@ -207,45 +236,57 @@ voiminfo (int argc, char **argv, size_t *reslen, void **result)
 
 
     /**
-     *  Main body of task
+     *  Main body of task.  Images are read a chunk at a time so the
+     *  results of a large list needn't all be held at once.
      */
-    for (i=0; i < nfiles; i++) {
-
-	memset (imname, 0, SZ_LINE);
-	if (strncmp ("http://", imlist[i], 7) == 0) {
-	    if (access ("/tmp/voiminfo.fits", F_OK) == 0)
-		unlink ("/tmp/voiminfo.fits");
-	    strcpy (imname, "/tmp/voiminfo.fits");
-	    if (vos_getURL (imlist[i], imname) <= 0)
-		continue;
-	} else
-	    strcpy (imname, imlist[i]);
-
-	if ((im = vot_imageInfo (imname, do_all)) ) {
-    	    memset (resbuf,  0, SZ_RESBUF);
-	    if (do_info) {
-                vot_printImageInfo (fd, im);
-	    } else if (do_naxis) {
-		strcpy (resbuf, fmt_naxis (imname, im, do_all));
-	    } else if (do_box) {
-		strcpy (resbuf, fmt_box (imname, im, do_all));
-	    } else if (do_corners) {
-		strcpy (resbuf, fmt_corners (imname, im, do_all));
-	    } else {
-                sprintf (resbuf, "%s\t%s\t%s\t%s\n", imlist[i], 
-		    fmt (im->frame.cx,1), fmt (im->frame.cy,0), 
-		    fmt (im->frame.radius,0));
+    for (i=0; i < nfiles; i += SCAN_CHUNK) {
+	n = (nfiles - i < SCAN_CHUNK ? nfiles - i : SCAN_CHUNK);
+
+	/*  Remote images are downloaded first.
+	 */
+	for (j=0; j < n; j++) {
+	    names[j] = imlist[i+j];
+	    if (strncmp ("http://", imlist[i+j], 7) == 0) {
+	        sprintf (tmpname, "/tmp/voiminfo%d_%d.fits", (int)getpid(), j);
+	        if (access (tmpname, F_OK) == 0)
+		    unlink (tmpname);
+	        if (vos_getURL (imlist[i+j], tmpname) > 0)
+		    names[j] = strdup (tmpname);
 	    }
+	}
 
-	    if (do_return)
-		vo_appendResultFromString (resbuf, reslen, result, &maxlen);
-	    else
-                fprintf (fd, "%s", resbuf);
-
-            vot_freeImageInfo (im);
+	(void) vot_imageInfoList (names, n, nthreads, do_cache, info);
+
+	for (j=0; j < n; j++) {
+	    imname = names[j];
+	    if ((im = info[j])) {
+    	        memset (resbuf,  0, SZ_RESBUF);
+	        if (do_info) {
+                    vot_printImageInfo (fd, im);
+	        } else if (do_naxis) {
+		    strcpy (resbuf, fmt_naxis (imname, im, do_all));
+	        } else if (do_box) {
+		    strcpy (resbuf, fmt_box (imname, im, do_all));
+	        } else if (do_corners) {
+		    strcpy (resbuf, fmt_corners (imname, im, do_all));
+	        } else {
+                    sprintf (resbuf, "%s\t%s\t%s\t%s\n", imlist[i+j], 
+		        fmt (im->frame.cx,1), fmt (im->frame.cy,0), 
+		        fmt (im->frame.radius,0));
+	        }
+
+	        if (do_return)
+		    vo_appendResultFromString (resbuf, reslen, result, &maxlen);
+	        else
+                    fprintf (fd, "%s", resbuf);
+
+                vot_freeImageInfo (im);
+	    }
 
-	    if (strncmp ("http://", imlist[i], 7) == 0)
-	        unlink (imname);
+	    if (names[j] != imlist[i+j]) {
+	        unlink (names[j]);
+	        free ((void *) names[j]);
+	    }
 	}
     }
 
@@ -253,14 +294,10 @@ voiminfo (int argc, char **argv, size_t *reslen, void **result)
     /*  Clean up.  Rememebr to free whatever pointers were created when
      *  parsing arguments.
      */
-    for (i=0; i < MAX_IMAGES; i++) {
-        if (imlist[i])  
-	    free (imlist[i]);
-        if (nimlist[i]) 
-	    free (nimlist[i]);
-	else
-	    break;
-    }
+    for (i=0; i < nfiles; i++)
+	free (imlist[i]);
+    if (imlist)
+	free ((void *) imlist);
     if (oname) free (oname);
     if (fd != stdout)
 	fclose (fd);
@@ -290,6 +327,8 @@ Usage (void)
         "	-n,--naxes     		print NAXIS values\n"
         "	-o,--output    		output filename\n"
         "	-s,--sex       		sexagesimal values\n"
+        "	-N,--nthreads=<N>	number of scan threads\n"
+        "	-C,--cache     		use the header cache\n"
 	"\n"
         "       -o,--output=<file>	output file\n"
 	"\n"
@@ -307,6 +346,9 @@ Usage (void)
 	"    4) Print the box values for an entire mosaic MEF file:\n\n"
 	"	    %% voiminfo -b mef.fits\n"
 	"\n"
+	"    5) Catalog a directory of images on 8 threads, caching headers:\n\n"
+	"	    %% voiminfo -N 8 -C /data/images\n"
+	"\n"
     );
 }
 
@@ -492,3 +534,95 @@ fmt_corners (char *imname, ImInfo *im, int do_all)
     }
     return (line);
 }
+
+
+/**
+ *  ADD_IMAGE -- Add an image name to the list.
+ */
+static int
+add_image (char *name, char ***imlist, int *nfiles, int *nalloc)
+{
+    if (*nfiles == *nalloc) {
+	*nalloc += SCAN_CHUNK;
+	*imlist = (char **) realloc (*imlist, *nalloc * sizeof (char *));
+	if (*imlist == (char **) NULL) {
+            fprintf (stderr, "ERROR: Too many images to process\n");
+	    return (ERR);
+	}
+    }
+    (*imlist)[(*nfiles)++] = strdup (name);
+    return (OK);
+}
+
+
+/**
+ *  ADD_DIR -- Add the FITS files of a directory to the list, sorted by name.
+ */
+static int
+add_dir (char *dir, char ***imlist, int *nfiles, int *nalloc)
+{
+    DIR    *dp;
+    struct dirent *ent;
+    char    path[SZ_LINE], *ext;
+    int     first = *nfiles, status = OK;
+
+
+    if ((dp = opendir (dir)) == (DIR *) NULL) {
+	fprintf (stderr, "Error: cannot open directory '%s'\n", dir);
+	return (ERR);
+    }
+    while (status == OK && (ent = readdir (dp))) {
+	if (!(ext = strrchr (ent->d_name, '.')) ||
+	    (strcasecmp (ext, ".fits") && strcasecmp (ext, ".fit") &&
+	     strcasecmp (ext, ".fts")))
+		continue;
+	snprintf (path, SZ_LINE, "%s/%s", dir, ent->d_name);
+	status = add_image (path, imlist, nfiles, nalloc);
+    }
+    closedir (dp);
+
+    qsort (&(*imlist)[first], *nfiles - first, sizeof (char *), cmp_names);
+    return (status);
+}
+
+
+/**
+ *  ADD_LIST -- Add the images named in a file, one per line.
+ */
+static int
+add_list (char *fname, char ***imlist, int *nfiles, int *nalloc)
+{
+    FILE   *fp;
+    char    line[SZ_LINE], *ip, *op;
+    int     status = OK;
+
+
+    if ((fp = fopen (fname, "r")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open list file '%s'\n", fname);
+	return (ERR);
+    }
+    while (status == OK && fgets (line, SZ_LINE, fp)) {
+	for (ip=line; *ip && isspace (*ip); ip++)
+	    ;
+	for (op=ip; *op && *op != '\n'; op++)
+	    ;
+	while (op > ip && isspace (op[-1]))
+	    op--;
+	*op = '\0';
+	if (*ip && *ip != '#')
+	    status = add_image (ip, imlist, nfiles, nalloc);
+    }
+    fclose (fp);
+
+    return (status);
+}
+
+
+/**
+ *  CMP_NAMES -- Compare image names for sorting.
+ */
+static int
+cmp_names (const void *a, const void *b)
+{
+    return (strcmp (*(char **) a, *(char **) b));
+}
@@ -23,6 +23,10 @@
  *      -N,--new <time>          get only newly registered svcs
  *      -U,--updated <time>      get only newly updated entries
  *
+ *      -x,--local               search the local Registry index
+ *         --snapshot            snapshot the Registry to the local index
+ *         --refresh             add recent updates to the local index
+ *
  *      -a,--all                 print all results (default)
  *      -f,--fields <fields>     output only specified fields
  *      -O,--or                  logically OR the search terms
@@ -113,6 +117,7 @@ extern int      group;			/* group terms			*/
 extern int	exact;			/* exact match only?		*/
 extern int	debug;			/* debug output?		*/
 extern int      nterms;			/* number of search terms	*/
+extern int      reg_local;		/* search local Registry index  */
 
 int     exact       = 0;                /* exact match only?            */
 int     res_index   = -1;		/* index of result      	*/
@@ -129,6 +134,8 @@ int     terse       = 0;		/* terse results?            	*/
 int     cset        = 0;            	/* constraints set?		*/
 int     do_samp     = 0;            	/* broadcast SAMP result?	*/
 int     timeSearch  = 0;            	/* search by create/update time */
+int     reg_build   = 0;            	/* snapshot/refresh local index */
+int     reg_feed    = 0;            	/* write a service feed		*/
 
 
 char   *fields      = (char *) NULL;	/* output fields		*/
@@ -156,7 +163,7 @@ static void Tests (char *input);
 /*  For getopt_long() option parsing.
 */
 int     opt_index;
-static  char *opt_string = "aBb:C:cdef:ghn:IlLmOo:rRs:St:TvVX123789%";
+static  char *opt_string = "aBb:C:cdef:ghn:IlLmOo:rRs:St:TvVxX123789%";
 
 static struct option long_options[] = {
 
@@ -184,6 +191,11 @@ static struct option long_options[] = {
     { "subject",  1, 0, 's'},  		/* subject constraint		*/
     { "type",     1, 0, 't'},		/* svctype constraint		*/
 
+	/* LOCAL INDEX OPTS		*/
+    { "local",    2, 0, 'x'},		/* search local index		*/
+    { "snapshot", 2, 0, 'W'},		/* snapshot the Registry	*/
+    { "refresh",  2, 0, 'Z'},		/* refresh local index		*/
+
 	/* OUTPUT CONTROL OPTS		*/
     { "all",      2, 0, 'a'},  		/* print all results		*/
     { "fields",   1, 0, 'f'},		/* set output fields		*/
@@ -207,6 +219,7 @@ static struct option long_options[] = {
     { "tweet",    2, 0, '7'},		/* tweet output			*/
     { "sort",     2, 0, '8'},		/* */
     { "terse",    2, 0, '9'},		/* */
+    { "feed",     2, 0, 'P'},		/* service feed output		*/
 
     { NULL,       0, 0, 0  }
 };
@@ -300,6 +313,18 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
     meta    = 0;
     vot_fd  = stdout;
 
+    /*  Reset the options, the task may be run more than once.
+     */
+    mode = M_SEARCH,  exact = 0,  res_index = -1,  nresults = 0;
+    user_fields = orValues = out_votable = dal_only = sortRes = terse = 0;
+    cset = do_samp = timeSearch = reg_build = reg_feed = reg_local = 0;
+#ifdef REG10_KLUDGE
+    reg10 = 0;
+#endif
+    fields = ofname = bandpass = subject = stype = clevel = (char *) NULL;
+    verbose = 1,  debug = 0,  proxy = res_all = longlines = group = 0;
+    nterms  = 0;
+
     memset (vot_name, 0, SZ_FNAME);
     memset (outname, 0, SZ_FNAME);
 
@@ -339,6 +364,11 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
             case '9':				/* EXPERIMENTAL		*/
 		terse++;
 		break;
+            case 'P':				/* service feed output	*/
+		reg_feed++;
+		out_votable++;
+		verbose = 2;
+		break;
 	    /* EXPERIMENTAL FLAGS */
 
 	
@@ -477,6 +507,16 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
 		verbose++;
 		break;
 
+            case 'x':				/* search local index	*/
+		reg_local++;
+		break;
+            case 'W':				/* snapshot Registry	*/
+		reg_build = 1;
+		break;
+            case 'Z':				/* refresh local index	*/
+		reg_build = 2;
+		break;
+
             case 'N':				/* new resources	*/
 		timeSearch++;
 		terms[nterms++] = vot_getTime (TIME_NEW, optarg);
@@ -541,7 +581,8 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
         	*/
         	if ((fd = fopen (arg, "r")) == (FILE *) NULL) {
             	    fprintf (stderr, "ERROR: Cannot open file '%s'\n", arg);
-            	    exit (1);
+		    free ((void *) name);
+            	    return (ERR);
         	}
         	while (fgets (name, SZ_FNAME, fd)) {
 		    name[strlen(name)-1] = '\0';	/* kill newline */
@@ -591,11 +632,23 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
     }
 
 
-    /*  Initialize the VOClient code.  Error messages are printed by the
-     *  interface so we just quit if there is a problem.
+    /*  Snapshot or refresh the local Registry index and quit.
      */
-    if (voc_initVOClient ("runid=voc.voregistry") == ERR) 
-        return (ERR);
+    if (reg_build) {
+        if (voc_initVOClient ("runid=voc.voregistry") == ERR) 
+            return (ERR);
+	nresults = vot_regIdxBuild (reg_build > 1);
+        voc_closeVOClient (0);
+	if (nresults < 0)
+	    return (ERR);
+	printf ("%d records in the local Registry index\n", nresults);
+	return (OK);
+    }
+    if (reg_local && !vot_regIdxOpen ()) {
+	fprintf (stderr, 
+	    "Warning: no local Registry index, use '--snapshot' to create it\n");
+	reg_local = 0;
+    }
 
 
     /* See whether any flags negate other options, or imply values for 
@@ -621,6 +674,16 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
 	        terms[nterms++] = strdup ("catalog");
 	}
     }
+
+
+    /*  Initialize the VOClient code.  Error messages are printed by the
+     *  interface so we just quit if there is a problem.  Searches of the
+     *  local index don't need it, vot_regSearch() connects for any it
+     *  has to send on to the Registry.
+     */
+    if (!(reg_local && mode == M_SEARCH) && vot_regIdxConnect () == ERR) 
+        return (ERR);
+
 #ifdef FOO
     if (fields && mode != M_RESOLVE) {
 	fprintf (stderr, "ERROR: 'fields' can only be used in Resolve Mode\n");
@@ -670,9 +733,12 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
     }
 
 
-    /* If we're printing a VOTable, output the prolog.
+    /* If we're printing a VOTable, output the prolog.  A service feed (see
+    ** votopic) is written to the stdout a line per record instead.
     */
-    if (!meta && out_votable) {
+    if (reg_feed) {
+	vot_fd = stdout;
+    } else if (!meta && out_votable) {
 	strcpy (vot_name, (outname[0] ? outname :  "/tmp/vot.xml"));
 	if (access (vot_name, F_OK) == 0)
 	    unlink (vot_name);
@@ -688,7 +754,7 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
     case M_RESOLVE:
 	printResolveRecord ();
         voc_closeVOClient (0);			/* close VOClient connection */
-        if (!meta && out_votable) 
+        if (!meta && out_votable && !reg_feed) 
 	    vot_printRegVOTableTail (vot_fd);
 	return ( (nresults == 0) );
 
@@ -727,13 +793,16 @@ voregistry (int argc, char *argv[], size_t *reslen, void **result)
 
     default:
 	fprintf (stderr, "Invalid mode.\n");
-	exit (1);
+	status = ERR;
     }
 
 
     /* Close the VOTable.
     */
-    if (!meta && out_votable) {
+    if (reg_feed) {
+	fflush (stdout);
+	return (nresults == 0);
+    } else if (!meta && out_votable) {
 	vot_printRegVOTableTail (vot_fd);
 	if (vot_fd != stdout)
 	    fclose (vot_fd);
@@ -1198,6 +1267,10 @@ Usage ()
       -t,--type <type>         constrain by service type\n\
       -N,--new <time>          get only newly registered svcs\n\
       -U,--updated <time>      get only newly updated entries\n\
+  \n\
+      -x,--local               search the local Registry index\n\
+         --snapshot            snapshot the Registry to the local index\n\
+         --refresh             add recent updates to the local index\n\
   \n\
       -a,--all                 print all results (default)\n\
       -f,--fields <fields>     output only specified fields\n\
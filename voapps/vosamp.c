@@ -135,6 +135,7 @@ static int	timeout 	= VOS_TIMEOUT;	/* child timeout	    */
 
 static int	hub_connected	= 0;		/* connected to SAMP hub    */
 static int	sess_connected	= 0;		/* connected to session mgr */
+static volatile int msg_done	= 0;		/* 'handle' message seen?   */
 
 char  *session_host = SESS_DEFHOST;  		/* session manager host IP  */
 int    session_port = SESS_DEFPORT;         	/* session manager port     */
@@ -275,6 +276,16 @@ vosamp (int argc, char **argv, size_t *reslen, void **result)
     *result     = NULL;
     return_stat = OK;
 
+    /*  Reset the options, the task may be run more than once.
+     */
+    sampH = 0,  verbose = quiet = debug = interact = multiple = xml_trace = 0;
+    keep_alive = 1,  proxy_pid = 0,  proxy_port = VOS_DEFPORT;
+    svr_sock = session_sock = input_sock = 0,  use_ipc = 1;
+    have_dotfile = 0,  in_parent = 1,  do_return = 1,  numargs = 0;
+    timeout = VOS_TIMEOUT,  hub_connected = sess_connected = 0;
+    proxy = session = pattern = cmdfile = filt_mtype = filt_sender = NULL;
+    to = NULL;
+
 
     /*  Parse the argument list.
      */
@@ -1471,12 +1482,8 @@ vos_msgHandler (char *sender, char *mtype, char *msg_id, int params)
     if (!quiet)
         vos_printMessage (mtype, samp_id2app (sampH, sender), params);
 
-    if (!interact && !multiple) {       /*  Do a clean disconnect ....  */
-        if (sampShutdown (sampH) < 0)
-            fprintf (stderr, "SAMP shutdown fails\n");
-        sampClose (sampH);
-        exit (0);
-    }
+    if (!interact && !multiple)		/*  Stop waiting, see 'handle'  */
+	msg_done++;
 }
 
 
@@ -1755,9 +1762,11 @@ vos_procCmd (int sampH, char *to, char *cmd, char *args[], int numargs)
 	if (*args[1])
 	    filt_sender = args[1];
 
+	msg_done = 0;
 	samp_Subscribe (sampH, (filt_mtype = args[0]), vos_msgHandler);
     	samp_DeclareSubscriptions (sampH);
-	sleep (timeout);
+	for ( ; timeout > 0 && !msg_done; timeout--)
+	    sleep (1);
 
     } else if (MATCH ("snoop")) {
         /*  Subscribe to all message types and install the snoop handler.
@@ -1794,13 +1803,16 @@ vos_procCmd (int sampH, char *to, char *cmd, char *args[], int numargs)
         Usage ();
 
     } else if (MATCH ("quit")) {                   	/* QUIT 	      */
+	unlink (vos_dotFile());
+	if (in_parent)			/* the task shuts down on return */
+	    return;
+
         if (sampShutdown (sampH) < 0) {
 	    if (!use_ipc)
                 fprintf (stderr, "Shutdown fails\n");
 	}
         sampClose (sampH);
-	unlink (vos_dotFile());
-        exit (0);
+        exit (0);			/* quit the proxy process	*/
 
     } else if (MATCH ("trace")) {          		/* TRACE 	      */
         xml_trace++;
@@ -72,6 +72,7 @@ static int   verbose		= FALSE;    /* std verbose flag		    */
 static int   quiet		= FALSE;    /* suppress output flag	    */
 static int   user_pos		= TRUE;	    /* using user position?	    */
 static int   status		= OK;	    /* return status		    */
+static int   refresh		= FALSE;    /* bypass the resolver cache?   */
 
 static char  delim		= ' ';	    /* output table delimiter	    */
 static char *output		= (char *) NULL;
@@ -127,7 +128,7 @@ extern  char   *toSexa();
 extern  double  vot_atof (char *v);
 
 static  int  process_target (char *target);
-static  int  print_result (char *target, Sesame sr);
+static  int  print_result (char *target, resObj *obj);
 static  void print_header (void);
 static  void procUserCoord (char *u_ra, char *u_dec);
 
@@ -149,7 +150,12 @@ vosesame (int argc, char *argv[], size_t *reslen, void **result)
     out	     = stdout;
     *reslen  = 0;
     *result  = NULL;
-    memset (flags, 0, MAX_FLAGS);
+    memset (flags, 0, sizeof (flags));
+
+    ntargets = 0,  all_flags = 0,  format = TRUE,  header = FALSE;
+    invert   = FALSE,  debug = FALSE,  verbose = FALSE,  quiet = FALSE;
+    user_pos = TRUE,  status = OK,  refresh = FALSE,  delim = ' ';
+    output   = u_ra = u_dec = sep = (char *) NULL;
 
     pargv = vo_paramInit (argc, argv, opts, long_opts);
     while ((ch = vo_paramNext (opts,long_opts,argc,pargv,optval,&pos)) != 0) {
@@ -191,12 +197,7 @@ vosesame (int argc, char *argv[], size_t *reslen, void **result)
 		procUserCoord (u_ra, u_dec);
 		break;
 
-	    case 'f':
-		if (voc_initVOClient("runid=voc.vosesame,use_cache=no") != OK) {
-		    fprintf (stderr, "ERROR: cannot open VOClient\n");
-		    return (ERR);
-		}
-		break;
+	    case 'f':    refresh++;			break;
 
 	    case 'o':    
 		output = strdup (optval);
@@ -214,7 +215,7 @@ vosesame (int argc, char *argv[], size_t *reslen, void **result)
 
 	    case 'I':    /*  FIXME  */
 			 system ("/bin/rm -f ~/.voclient/cache/sesame/*");
-			 exit (0);;
+			 return (OK);
 	    }
 
         } else if (ch == PARG_ERR) {
@@ -475,9 +476,9 @@ procUserCoord (char *ra, char *dec)
 static int
 process_target (char *target)
 {
-    int     status;
+    int     status = OK, i, nobjs = 0, nalloc = 0;
     char    name[SZ_FNAME];
-    extern  char *vo_urlEncode();
+    resObj *objs = (resObj *) NULL, obj;
 
 
     /*  Do some error checking before we move on.
@@ -515,14 +516,32 @@ process_target (char *target)
 
 	while (fgets (name, SZ_FNAME, fd)) {
 	    name[strlen(name)-1] = '\0';		/* kill newline	*/
-            status = print_result (name, voc_nameResolver (vo_urlEncode(name)));
+	    if (nobjs == nalloc) {
+		nalloc += 1024;
+		objs = (resObj *) realloc (objs, nalloc * sizeof (resObj));
+	    }
+	    memset (&objs[nobjs], 0, sizeof (resObj));
+	    objs[nobjs++].name = strdup (name);
 	}
 	fclose (fd); 			/* close the file and clean up	 */
 
+	/* Resolve the names all at once, then print them in order.
+	*/
+	(void) vot_resolveNames (objs, nobjs, 0, refresh);
+	for (i=0; i < nobjs; i++) {
+            status = print_result (objs[i].name, &objs[i]);
+	    free ((void *) objs[i].name);
+	}
+	if (objs)
+	    free ((void *) objs);
+
     } else {
         /*  Print the result for a single resolved target.
         */
-        status = print_result (target, voc_nameResolver (vo_urlEncode(target)));
+	memset (&obj, 0, sizeof (resObj));
+	obj.name = target;
+	(void) vot_resolveNames (&obj, 1, 1, refresh);
+        status = print_result (target, &obj);
     }
 
     return (status);
@@ -533,14 +552,14 @@ process_target (char *target)
 **  PRINT_RESULT --  Print the result table in the requested format.
 */
 static int
-print_result (char *target, Sesame sr)
+print_result (char *target, resObj *obj)
 {
     register int i, found;
     char     *type = NULL, *ip, *pos, sp;
     double   ra, dec, Era, Edec;
 
 
-    if (sr == 0)			/* check for no match found	*/
+    if (obj->status != OK)		/* check for no match found	*/
 	return (ERR);
 
     /* Fix the target name so spaces become underscores.
@@ -561,17 +580,14 @@ print_result (char *target, Sesame sr)
 
     /* Get the information for the object.
     */
-    pos = voc_resolverPos(sr);
-    if (delim != ' ' && ip) {
-        for (ip=pos; *ip; ip++)
-            *ip = (isspace(*ip) ? delim : *ip);
-    }
-    ra   = voc_resolverRA(sr);
-    dec  = voc_resolverDEC(sr);
-    Era  = voc_resolverRAErr(sr);
-    Edec = voc_resolverDECErr(sr);
-    type = voc_resolverOtype(sr);
-    pos  = voc_resolverPos(sr);
+    pos  = obj->pos;
+    for (ip=pos; *ip; ip++)
+        *ip = (isspace(*ip) ? delim : *ip);
+    ra   = obj->ra;
+    dec  = obj->dec;
+    Era  = obj->era;
+    Edec = obj->edec;
+    type = (obj->otype[0] ? obj->otype : NULL);
 
     found = 1;
     if (ra == 0.0 && dec == 0.0 && Era == 0.0 && Edec == 0.0)
@@ -600,7 +616,7 @@ print_result (char *target, Sesame sr)
             fprintf (out, fmt, target, delim, pos, delim,
 		ra, delim, dec, delim,
 		Era, delim, Edec, delim,
-		type);
+		(type ? type : "Unknown"));
 	}
 
     } else if ((found && !invert) || (!found && invert)) {
@@ -620,10 +636,6 @@ print_result (char *target, Sesame sr)
     		fprintf (out, "%s", (type ? type : "Unknown"));
 		break;
 	    case F_SEX:
-                for (ip=pos; *ip; ip++) {
-                    if (isspace (*ip))
-    	                *ip = delim;
-                }
     		fprintf (out, "%s", pos);
 		break;
 	    }
@@ -21,15 +21,10 @@
 
 
 
-#define	MAX_FILES	1024
+#define	MAX_FILES	4096
 
 
 static int nfiles  	= 0;		/* Number of input files	*/
-static int out		= 0;		/* Output VOTable handle	*/
-
-static int vot[MAX_FILES];		/* First VOTable handle		*/
-static int res[MAX_FILES];		/* <RESOURCE> handle 		*/
-
 static int do_return	= 0;		/* return object?		*/
 
 /*  Task specific option declarations.
@@ -37,11 +32,10 @@ static int do_return	= 0;		/* return object?		*/
 int  votcat (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "votcat",  votcat,  0,  0,  0  };
-static char  *opts      = "hivo:r%:";
+static char  *opts      = "hvo:r%:";
 static struct option long_opts[] = {
         { "help",         2, 0,   'h'},         /* required             */
         { "test",         1, 0,   '%'},         /* required             */
-        { "indent",       2, 0,   'i'},         /* task option          */
         { "output",       1, 0,   'o'},         /* task option          */
         { "verbose",      2, 0,   'v'},         /* task option          */
         { NULL,           0, 0,    0 }
@@ -50,8 +44,6 @@ static struct option long_opts[] = {
 static void Usage (void);
 static void Tests (char *input);
 
-extern int  vot_atoi (char *v);
-
 
 /**
  *  Application entry point.
@@ -62,23 +54,19 @@ votcat (int argc, char **argv, size_t *reslen, void **result)
     char **pargv, optval[SZ_FNAME];
     char  *oname = (char *) NULL, ch;
     char  *infile[MAX_FILES];
-    int   i, verbose = 0, indent = 1, pos = 0;
+    int   i, verbose = 0, pos = 0, status = OK;
 
 
-    if (argc < 3) {
-	fprintf (stderr, "Usage:  votconcat [-o <out>] <vot1> <vot2> ....\n");
-	return (1);
-    }
-
     /*  Parse the argument list.
      */
+    nfiles    = 0;
+    do_return = 0;
     pargv = vo_paramInit (argc, argv, opts, long_opts);
     while ((ch = vo_paramNext (opts,long_opts,argc,pargv,optval,&pos)) != 0) {
         if (ch > 0) {
             switch (ch) {
             case '%':  Tests (optval);                  return (self.nfail);
             case 'h':  Usage ();                        return (OK);
-	    case 'i':  indent = vot_atoi (optval);	break;
 	    case 'o':  oname = strdup (optval);		break;
 	    case 'v':  verbose++; 			break;
             case 'r':  do_return = 1;                   break;
@@ -91,41 +79,35 @@ votcat (int argc, char **argv, size_t *reslen, void **result)
             return (ERR);
 
         } else {
+	    if (nfiles >= MAX_FILES) {
+		fprintf (stderr, "Error: too many input files (max %d)\n",
+		    MAX_FILES);
+		return (ERR);
+	    }
 	    infile[nfiles++] = strdup (optval);
         }
     }
 
     /* Sanity checks
      */
+    if (nfiles == 0) {
+	Usage ();
+	return (ERR);
+    }
     if (oname == NULL) oname = strdup ("stdout");
     if (strcmp (oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
         
 
-    /*  Open output table.
-     */
-    out = vot_openVOTABLE (NULL); 	
-
-    /*  Loop over the input tables on the cmdline.
-     */
-    for (i=0; i < nfiles; i++) {
-        vot[i] = vot_openVOTABLE (infile[i]);	/*  Parse the table	*/
-
-	/*  Concatenate the tables.
- 	 */
-	if ((res[i] = vot_getRESOURCE (vot[i])))
-            vot_attachNode (out, res[i]); 		
-    }
-
-    /*  Write it out.
+    /*  Stream the top-level elements of each input to the output.  The
+     *  tables are never parsed to a document tree so memory use doesn't
+     *  depend on the size or number of the inputs.
      */
-    vot_writeVOTable (out, oname, indent);
-
-    for (i=0; i < nfiles; i++)
-        vot_closeVOTABLE (vot[i]);	/* close the input tables	*/
-    vot_closeVOTABLE (vot[i]);             /* close the output table	*/
+    if (verbose)
+	fprintf (stderr, "Concatenating %d tables to '%s'\n", nfiles, oname);
+    status = vot_streamCat (infile, nfiles, oname);
 
 
-    /*  Close (and free) the output table and allocated pointers.
+    /*  Free allocated pointers.
      */
     if (oname) 
 	free (oname);
@@ -135,7 +117,7 @@ votcat (int argc, char **argv, size_t *reslen, void **result)
     }
 
     vo_paramFree (argc, pargv);
-    return (OK);
+    return (status);
 }
 
 
@@ -146,20 +128,24 @@ static void
 Usage (void)
 {
     fprintf (stderr, "\n  Usage:\n\t"
-        "generic [<opts>] votable.xml\n\n"
+        "votcat [<opts>] <votable> <votable> ....\n\n"
         "  where\n"
         "       -%%,--test               run unit tests\n"
         "       -h,--help               this message\n"
-        "       -n,--number             number output\n"
         "       -o,--output=<file>      output file\n"
-        "       -r,--return             return result from method\n"
+        "       -v,--verbose            verbose output\n"
+        "\n"
+        "  The <RESOURCE> elements of each table, and the INFO, PARAM,\n"
+        "  COOSYS and GROUP elements beside them, are copied to the output\n"
+        "  as-is, the tables are streamed rather than parsed so there is no\n"
+        "  limit on their size.  The output file may be one of the inputs.\n"
         "\n"
         "  Examples:\n\n"
-        "    1)  First example\n\n"
-        "           %% votcat test.xml\n"
+        "    1)  Concatenate two tables to the stdout\n\n"
+        "           %% votcat sia.xml sia2.xml\n"
         "\n"
-        "    2)  Second example\n\n"
-        "           %% votcat -o pos.txt test.xml\n"
+        "    2)  Concatenate all the vodata results to a single file\n\n"
+        "           %% votcat -o all.xml vodata_*.xml\n"
         "\n"
     );
 }
@@ -178,4 +164,11 @@ Tests (char *input)
     *  always be a NULL to terminate the cmd args.
     */
    vo_taskTest (task, "--help", NULL);
+
+   vo_taskTest (task, input, input, NULL);			// Ex 1
+   vo_taskTest (task, "-o", "cat.xml", input, input, NULL);	// Ex 2
+
+   if (access ("cat.xml", F_OK) == 0)   unlink ("cat.xml");
+
+   vo_taskTestReport (self);
 }
@@ -37,6 +37,9 @@ static int    indent	= 0;		/* indention at each level	*/
 static int    hdr	= 1;		/* print header ??		*/
 static int    do_return	= 0;		/* return result from method?	*/
 
+static char  *fmtname[] = { "vot", "asv", "bsv", "csv", "tsv", "html",
+			    "shtml", "fits", "ascii", "xml", "raw" };
+
 /*  Task specific option declarations.
  */
 int  votcnv (int argc, char **argv, size_t *len, void **result);
@@ -70,11 +73,19 @@ extern int vot_atoi (char *v);
 int
 votcnv (int argc, char **argv, size_t *reslen, void **result)
 {
-    int     status = OK, pos = 0;
+    int     status = OK, pos = 0, ifmt = 0, lazy = 0;
     char   *iname = NULL, *name = NULL, *oname = NULL, format[SZ_FORMAT];
     char  **pargv, ch, optval[SZ_FNAME];
 
 
+    /*  Initialize the options, the task may be run more than once.
+     */
+    fmt       = NULL;
+    vot       = 0;
+    indent    = 0;
+    hdr       = 1;
+    do_return = 0;
+
     /*  Parse the argument list.
      */
     pargv = vo_paramInit (argc, argv, opts, long_opts);
@@ -125,32 +136,42 @@ votcnv (int argc, char **argv, size_t *reslen, void **result)
         oname = (oname ? oname : strdup ("stdout"));
 
 
-    /* Open and parse the input table.
-    */
-    if ( (vot = vot_openVOTABLE (iname) ) <= 0) {
-	fprintf (stderr, "Error opening VOTable '%s'\n", iname);
-	return (ERR);
-    }
-
-    /*  Output the new format.
+    /*  Output the new format.  Table formats are converted as a stream,
+     *  the VOTable writers need the document tree but the <TR>/<TD>
+     *  elements are kept only as cells.
      */
-    switch (strdic (fmt, format, SZ_FORMAT, FORMATS)) {
-    case   VOT:   vot_writeVOTable (vot, oname, indent);      break;
-    case   ASV:   vot_writeASV (vot, oname, hdr);      	      break;
-    case   BSV:   vot_writeBSV (vot, oname, hdr);      	      break;
-    case   CSV:   vot_writeCSV (vot, oname, hdr);      	      break;
-    case   TSV:   vot_writeTSV (vot, oname, hdr);      	      break;
-    case  HTML:   vot_writeHTML (vot, iname, oname);          break;
-    case SHTML:   vot_writeSHTML (vot, iname, oname);         break;
-    case  FITS:   vot_writeFITS (vot, oname);    	      break;
-    case   XML:   vot_writeVOTable (vot, oname, indent);      break;
-    case ASCII:   vot_writeASV (vot, oname, hdr);      	      break;
-    case   RAW:   vot_writeVOTable (vot, oname, indent);      break;
+    switch ((ifmt = strdic (fmt, format, SZ_FORMAT, FORMATS))) {
+    case   ASV:
+    case   BSV:
+    case   CSV:
+    case   TSV:
+    case  HTML:
+    case SHTML:
+    case  FITS:
+    case ASCII:
+	status = vot_streamConvert (iname, oname, fmtname[ifmt], hdr);
+	break;
+
+    case   VOT:
+    case   XML:
+    case   RAW:
+	lazy = vot_getLazyTD ();
+	vot_setLazyTD (1);
+	vot = vot_openVOTABLE (iname);
+	vot_setLazyTD (lazy);
+	if (vot <= 0) {
+	    fprintf (stderr, "Error opening VOTable '%s'\n", iname);
+	    status = ERR;
+	    break;
+	}
+	vot_writeVOTable (vot, oname, indent);
+	vot_closeVOTABLE (vot);		/* close the table  	*/
+	break;
+
     default:
 	fprintf (stderr, "Unknown output format '%s'\n", fmt);
 	status = ERR;
     }
-    vot_closeVOTABLE (vot);		/* close the table  	*/
 
 
     /*  If we requested a return object, get it from the output file.
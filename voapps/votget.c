@@ -20,10 +20,13 @@
  *
  *	    -A,--acref <colnum>	    Col number for acref column (0-indexed)
  *	    -B,--bkg  		    Background, i.e. run in forked child process
- *	    -C,--cache  	    Cache the downloaded file
+ *	    -C,--cache  	    Use the download cache
  *	    -D,--download  	    Set download directory
  *	    -F,--fmtcol <colnum>    Col number for format column (0-indexed)
  *	    -N,--num <N> 	    Number of simultaneous downloads
+ *	    -M,--maxhost <N> 	    Max simultaneous downloads from a server
+ *	    -P,--parallel <N> 	    Fetch large files in N parallel ranges
+ *	    -R,--resume  	    Resume partial downloads
  *	    -S,--samp		    start as SAMP listener
  *	    -m,--mtype <mtype>	    mtype to wait for
  *
@@ -53,22 +56,15 @@
 #include <sys/uio.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
-#include <pthread.h>
-
-#include <curl/curl.h>
-#ifdef OLD_CURL
-#include <curl/types.h>
-#endif
-#include <curl/easy.h>
 
 #include "samp.h"
 #include "votParse.h"
 #include "voApps.h"
 
 
-#define	MIN_THREADS	4		/* min no. simultaneous thread	*/
-#define	MAX_THREADS	64		/* max no. simultaneous threads */
-#define	MAX_DOWNLOADS	4096		/* max no. files to download	*/
+#define	DEF_NCONN	16		/* def. simultaneous downloads	*/
+#define	DEF_HOSTCONN	8		/* def. downloads from a server	*/
+#define	SZ_ACLIST	1024		/* access list allocation chunk	*/
 #define	MAX_TRYS	3		/* max download attempts	*/
 
 #define NAXIS_UCD   	"VOX:Image_Naxis"
@@ -83,17 +79,21 @@ static int   verbose	= 0;		/* verbose parameter	     	*/
 static int   debug	= 0;		/* debug flag	     		*/
 static int   extract	= 0;		/* extract references only	*/
 static int   detach	= 0;		/* run as detached process	*/
+static int   dl_child	= 0;		/* in the detached child?	*/
 static int   nfiles     = 0;		/* number of download files	*/
 static int   ngot 	= 0;		/* number of files downloaded	*/
 static int   seq 	= 1;		/* use sequential file numbers  */
 static int   isCache    = 0;		/* is this a cache file?	*/
 static int   isTemp     = 0;		/* is this a temp file?		*/
 static int   force      = 0;		/* overwrite existing file      */
+static int   resume     = 0;		/* resume partial downloads	*/
 static int   acol	= -1;		/* access reference column 	*/
 static int   tcol	= -1;		/* image type column 		*/
 static int   filenum	= 0;		/* running download file number	*/
 
-static int   nthreads   = MIN_THREADS;	/* number of download threads	*/
+static int   nconn      = DEF_NCONN;	/* simultaneous downloads	*/
+static int   hostconn   = DEF_HOSTCONN;	/* downloads from one server	*/
+static int   nchunks    = 1;		/* parallel ranges per file	*/
 static int   maxTrys	= MAX_TRYS;	/* download attempts		*/
 
 static char *base	= NULL;		/* output base filename    	*/
@@ -108,17 +108,15 @@ static char *fmt_ucd    = NULL;		/* image format UCD 	     	*/
 
 static FILE  *afd = (FILE *) NULL;	/* acref file descriptor	*/
 
-static pthread_mutex_t counter_mut = PTHREAD_MUTEX_INITIALIZER;
-
 typedef void  (*SIGFUNC)();           	/* signal handler type		*/
 
 typedef struct {
-    char   url[SZ_URL];			/* access URL			*/
-    char   fname[SZ_URL];		/* local filename		*/
-    int    tnum;			/* worker thread number		*/
+    char  *url;				/* access URL			*/
+    char  *fname;			/* local filename		*/
 } Acref, *AcrefP;
 
-Acref   aclist[MAX_DOWNLOADS];		/* access list			*/
+static Acref *aclist	= NULL;		/* access list			*/
+static int    szaclist	= 0;		/* allocated list size		*/
 
 
 /*  Task specific option declarations.
@@ -126,7 +124,7 @@ Acref   aclist[MAX_DOWNLOADS];		/* access list			*/
 int  votget (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "votget",  votget,  0,  0,  0  };
-static char  *opts      = "%:hb:e:f:dstu:o:vxA:BCD:F:N:Sm:";
+static char  *opts      = "%:hb:e:f:dstu:o:vxA:BCD:F:M:N:P:RSm:";
 static struct option long_opts[] = {
         { "base",         1, 0,   'b'},         /* task option          */
         { "extn",         1, 0,   'e'},         /* task option          */
@@ -143,6 +141,9 @@ static struct option long_opts[] = {
         { "download",     1, 0,   'D'},         /* task option          */
         { "fmtcol",       1, 0,   'F'},         /* task option          */
         { "num",          1, 0,   'N'},         /* task option          */
+        { "maxhost",      1, 0,   'M'},         /* task option          */
+        { "parallel",     1, 0,   'P'},         /* task option          */
+        { "resume",       2, 0,   'R'},         /* task option          */
         { "force",        2, 0,   'O'},         /* task option          */
         { "samp",         2, 0,   'S'},         /* task option          */
         { "mtype",        1, 0,   'm'},         /* task option          */
@@ -181,9 +182,11 @@ static int   vot_typeColumn (handle_t tab);
 static int   vot_loadText (char *infile);
 static int   vot_loadVOTable (char *infile);
 static int   vot_getData (char *url, char *ofname);
+static int   vot_dlPrep (char *ofname, char *fname);
+static void  vot_dlDone (dlReq *req, char *errmsg);
 
-static void  vot_saveAcref (char *acref, int num, int fnum);
-static void *vot_getAclist (void *arg);
+static int   vot_saveAcref (char *acref, int fnum);
+static void  vot_clearAclist (void);
 static void  vot_printAclist ();
 static void  vot_reaper (int sig, int *arg1, int *arg2);
 
@@ -201,11 +204,22 @@ votget (int argc, char **argv, size_t *reslen, void **result)
     int    samp = 0, pos = 0, stat = OK;
 
 
-    /*  Initialize. 
+    /*  Initialize.  The options are reset since the task may be run more
+     *  than once in the same process.
      */
     *reslen = 0;
     *result = NULL;
 
+    vot      = 0,  verbose  = 0,  debug   = 0,  extract = 0;
+    detach   = 0,  dl_child = 0,  ngot    = 0,  seq     = 1;
+    isCache  = 0,  isTemp   = 0,  force   = 0,  resume  = 0;
+    acol     = -1, tcol     = -1, filenum = 0,  nchunks = 1;
+    nconn    = DEF_NCONN,  hostconn = DEF_HOSTCONN,  maxTrys = MAX_TRYS;
+    base     = extn = dir = afname = NULL;
+    acref    = acref_ucd = fmt = fmt_ucd = NULL;
+    afd      = (FILE *) NULL;
+    do_return = do_samp = 0,  mtype = NULL;
+
 
     /*  Parse the argument list.
      */
@@ -239,7 +253,10 @@ votget (int argc, char **argv, size_t *reslen, void **result)
 	    case 'C':   isCache++;			break;
 	    case 'D':   dir = strdup (optval);		break;
 	    case 'F':   tcol = vot_atoi (optval);	break;
-	    case 'N':   nthreads = vot_atoi (optval); 	break;
+	    case 'M':   hostconn = vot_atoi (optval); 	break;
+	    case 'N':   nconn = vot_atoi (optval); 	break;
+	    case 'P':   nchunks = vot_atoi (optval); 	break;
+	    case 'R':   resume++;			break;
 	    case 'O':   force++;			break;
 	    case 'S':   do_samp++;			break;
 	    case 'm':   mtype = strdup (optval);;	break;
@@ -267,7 +284,7 @@ votget (int argc, char **argv, size_t *reslen, void **result)
     /*  Setup defaults and initialize.
      */
     do_return = 0;
-    memset (&aclist[0], 0, (sizeof (Acref) * MAX_DOWNLOADS));
+    vot_clearAclist ();
 
     if (afname && (afd = fopen (afname, "a+")) == (FILE *) NULL) {
 	if (verbose)
@@ -316,12 +333,14 @@ votget (int argc, char **argv, size_t *reslen, void **result)
     if (fmt)       free (fmt);
     if (fmt_ucd)   free (fmt_ucd);
     if (mtype)     free (mtype);
+    vot_clearAclist ();
 
     vo_paramFree (argc, pargv);
-    if (detach)
-        exit (OK);
-    else
-        return (stat);
+    if (dl_child) {			/* the detached child is done	*/
+	fflush (NULL);
+        _exit (stat);
+    }
+    return (stat);
 }
 
 
@@ -343,7 +362,7 @@ votableHandler (char *url, char *tblId, char *name)
     if (strncmp (url, "http://", 7) == 0) {
         strcpy (fname, "/tmp/votgetXXXXXX");    /* temp download name    */
         mkstemp (fname);
-        if (vot_getData (url, fname) < 0) 
+        if (vot_getData (url, fname) == 0) 
 	    fprintf (stderr, "Error accessing url '%s'\n", url);
 
         vot_procFile (fname);
@@ -360,8 +379,7 @@ votableHandler (char *url, char *tblId, char *name)
 
     /*  Clean up for the next file to process.
      */
-    memset (&aclist[0], 0, (sizeof (Acref) * MAX_DOWNLOADS));
-    nfiles = 0;
+    vot_clearAclist ();
 }
 
 
@@ -421,7 +439,8 @@ vot_procFile (char *iname)
         signal (SIGCHLD, (SIGFUNC)vot_reaper);
         switch ((pid = fork ())) {
         case -1:  return (ERR);			/* We are an error      */
-        case 0:   break;			/* We are the child     */
+        case 0:   dl_child++;			/* We are the child     */
+		  break;
         default:  return (OK);			/* We are the parent    */
         }
     }
@@ -440,53 +459,43 @@ vot_procFile (char *iname)
 	chdir (dir);
     }
 
-    /*  Do the downloads.
+    /*  Do the downloads.  Files already downloaded, or being downloaded
+     *  by another process, are skipped.
      */
-    if (nfiles < MIN_THREADS)
-	nthreads = nfiles;
-
-    if (nthreads == 1) {
-	vot_getAclist (NULL);
-
-    } else {
-	/* Spawn the worker threads.
-	 */
-	int  rc = 0, tc = 0, status = 0, tnum[MAX_THREADS];
-	pthread_attr_t  attr;               	/* thread attributes 	*/
-	pthread_t  thread[MAX_THREADS];
-
-
-        /*  Initialize the service processing thread attributes and run 'em.
-         */
-        pthread_attr_init (&attr);
-        pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_JOINABLE);
+    if (nfiles > 0) {
+	dlReq  *reqs = (dlReq *) calloc (nfiles, sizeof (dlReq));
+	char    fname[SZ_FNAME];
+	int     i, nreqs = 0;
 
         if (verbose)
 	    fprintf (stderr, "Starting download ....\r");
 
-        for (tc=0; tc < nthreads; tc++) {
-	    tnum[tc] = tc;
-            if ((rc = pthread_create (&thread[tc], &attr, vot_getAclist,
-                (void *)&tnum[tc]))) {
-                    fprintf (stderr, "ERROR: pthread_create() fails, code=%d\n",
-			rc);
-                    return (-1);
-            }
-        }
-
-        /* Free attribute and wait for the threads to complete.
-        */
-        pthread_attr_destroy (&attr);
-        for (tc=0; tc < nthreads; tc++) {
-            if ((rc = pthread_join (thread[tc], (void **)&status)) ) {
-		if (rc != ESRCH) {
-                    fprintf (stderr, 
-		        "ERROR: pthread_join() fails, code=%d status=%d\n", 
-		        rc, status);
-                    return (-1);
+	for (i=0; i < nfiles; i++) {
+	    if (vot_dlPrep (aclist[i].fname, fname)) {
+		if (isCache && vot_dlcGet (aclist[i].url, fname) == OK) {
+		    dlReq  hit;			/* no need to download	*/
+
+		    memset (&hit, 0, sizeof (dlReq));
+		    hit.url    = aclist[i].url;
+		    hit.fname  = fname;
+		    hit.status = DL_DONE;
+		    hit.data   = (void *) &aclist[i];
+		    vot_dlDone (&hit, NULL);
+		    continue;
 		}
-            } 
-        }
+		reqs[nreqs].url   = aclist[i].url;
+		reqs[nreqs].fname = strdup (fname);
+		reqs[nreqs].resume  = resume;
+		reqs[nreqs].nchunks = nchunks;
+		reqs[nreqs].data  = (void *) &aclist[i];
+		nreqs++;
+	    }
+	}
+	(void) vot_dlRun (reqs, nreqs, nconn, hostconn, maxTrys, vot_dlDone);
+
+	for (i=0; i < nreqs; i++)
+	    free ((void *) reqs[i].fname);
+	free ((void *) reqs);
 
         if (verbose) {
 	    fprintf (stderr, 
@@ -532,10 +541,13 @@ Usage (void)
         "\n" 
         "   -A,--acref <colnum>     Col number for acref column (0-indexed)\n"
         "   -B,--bkg                Background, i.e. run in forked child\n"
-        "   -C,--cache              Cache the downloaded file\n"
+        "   -C,--cache              Use the download cache\n"
         "   -D,--download           Set download directory\n"
         "   -F,--fmtcol <colnum>    Col number for format column (0-indexed)\n"
         "   -N,--num <N>            Number of simultaneous downloads\n"
+        "   -M,--maxhost <N>        Max simultaneous downloads from a server\n"
+        "   -P,--parallel <N>       Fetch large files in N parallel ranges\n"
+        "   -R,--resume             Resume partial downloads\n"
         "   -S,--samp               start as SAMP listener\n"
         "\n" 
         "   -h,--help               Print help summary\n"
@@ -632,8 +644,7 @@ vot_loadText (char *infile)
     struct stat info;
 
 
-    nfiles = 0;
-    memset (&aclist[0], 0, (sizeof (Acref) * MAX_DOWNLOADS));
+    vot_clearAclist ();
 
     if ((fd = open (infile, O_RDONLY)) < 0)
 	return (-1);
@@ -651,15 +662,17 @@ vot_loadText (char *infile)
 	    ;
 	*ip = '\0';
 
-	vot_saveAcref (acref, i, filenum++);
+	if (vot_saveAcref (acref, filenum++))
+	    nfiles++;
 
 	acref = ip + 1;
-	nfiles++;
 	tnum++;
     }
 
-    if (afd)					/* close the acref file	*/
+    if (afd) {					/* close the acref file	*/
 	fclose (afd);
+	afd = (FILE *) NULL;
+    }
 
     return (nfiles);
 }
@@ -676,8 +689,7 @@ vot_loadVOTable (char *infile)
     char  *acref;
 
 
-    nfiles = 0;
-    memset (&aclist[0], 0, (sizeof (Acref) * MAX_DOWNLOADS));
+    vot_clearAclist ();
 
     /*  Open the table.  This also parses it.
      */
@@ -715,8 +727,7 @@ vot_loadVOTable (char *infile)
 	 *  out the acref for a simple extract, or by adding to the access
 	 *  list to be processed below.
          */
-	i = 0;
-        for (tr=vot_getTR (tdata); tr; tr=vot_getNext(tr)) {
+        for (i=0, tr=vot_getTR (tdata); tr; tr=vot_getNext(tr), i++) {
 	    acref = vot_getTableCell (tdata, i, acol);
 	    if (tcol >= 0) {
 		char  *format = vot_getTableCell (tdata, i, tcol);
@@ -725,19 +736,19 @@ vot_loadVOTable (char *infile)
 		    continue;
 	    }
 
-	    vot_saveAcref (acref, i, filenum++);
-
-	    nfiles++;
+	    if (vot_saveAcref (acref, filenum++))
+		nfiles++;
 	    tnum++;
-	    i++;
         }
     }
 
 
     /*  Clean up.
      */
-    if (afd)					/* close the acref file	*/
+    if (afd) {					/* close the acref file	*/
 	fclose (afd);
+	afd = (FILE *) NULL;
+    }
 
     vot_closeVOTABLE (vot);			
 
@@ -746,25 +757,58 @@ vot_loadVOTable (char *infile)
 
 
 /**
- *  VOT_SAVEACREF -- Save the URL to the access list.
+ *  VOT_SAVEACREF -- Save the URL to the access list.  Returns 1 if it was
+ *  added to the list, for the caller to count in 'nfiles', or 0 if it was
+ *  only written to the acref file or extracted.
  */
-static void
-vot_saveAcref (char *acref, int num, int fnum)
+static int
+vot_saveAcref (char *acref, int fnum)
 {
+    char  fname[SZ_FNAME];
+
+
     if (afd)
 	fprintf (afd, "%s\n", acref);
     else if (extract)
 	fprintf (stderr, "%s\n", acref);
     else {
-	/*  Save to the access list.
+	/*  Save to the access list, growing it as needed.
 	 */
-	aclist[num].tnum = ((nthreads == 1) ? 0 : (num % nthreads));
-	strcpy (aclist[num].url, acref);
+	if (nfiles >= szaclist) {
+	    szaclist += SZ_ACLIST;
+	    aclist = (Acref *) realloc (aclist, szaclist * sizeof (Acref));
+	}
 	if (seq)
-	    sprintf (aclist[num].fname, "%s%04d", base, (int) fnum);
+	    sprintf (fname, "%s%04d", base, (int) fnum);
 	else
-	    sprintf (aclist[num].fname, "%s%d", base, vot_sum32 (acref));
+	    sprintf (fname, "%s%d", base, vot_sum32 (acref));
+
+	aclist[nfiles].url   = strdup (acref);
+	aclist[nfiles].fname = strdup (fname);
+	return (1);
     }
+    return (0);
+}
+
+
+/**
+ *  VOT_CLEARACLIST -- Free the access list.
+ */
+static void
+vot_clearAclist (void)
+{
+    register int i;
+
+    for (i=0; i < nfiles && aclist; i++) {
+	free ((void *) aclist[i].url);
+	free ((void *) aclist[i].fname);
+    }
+    if (aclist)
+	free ((void *) aclist);
+
+    aclist = (Acref *) NULL;
+    szaclist = 0;
+    nfiles = 0;
 }
 
 
@@ -867,46 +911,34 @@ vot_typeColumn (handle_t tab)
 
 
 /** 
- *  VOT_GETACLIST -- Download all the files for the specified thread.
+ *  VOT_GETDATA -- Utility routine to do a simple URL download to the file.
+ *  Returns 1 on success, 0 on error.
  */
-static void *
-vot_getAclist (void *arg)
+static int 
+vot_getData (char *url, char *ofname)
 {
-    register int i, j, done = 0, ret = 0;
-    int threadNum = 0;
+    dlReq  req;
 
 
-    if (arg) 
-	threadNum = *(int *)arg;
+    memset (&req, 0, sizeof (dlReq));
+    req.url   = url;
+    req.fname = ofname;
 
-    for (i=0; i < nfiles; i++) {
-	if (aclist[i].tnum == threadNum) {
-    	    for (j=0; j < maxTrys; j++) {
-	        if ((ret = vot_getData (aclist[i].url, aclist[i].fname)))
-		    break;
-	    }
-	    done += ret;
-	}
-    }
-    
-/*
-    pthread_exit (NULL);
-*/
-    return ((void *) NULL);
+    return (vot_dlRun (&req, 1, 1, 1, maxTrys, NULL));
 }
 
 
 /** 
- *  VOT_GETDATA -- Utility routine to do a simple URL download to the file.
+ *  VOT_DLPREP -- Prepare to download an access list file.  Returns zero if
+ *  the file already exists or is being downloaded by another process,
+ *  otherwise the lock file is created and the output filename, with any
+ *  extension, is returned in 'fname'.  When resuming, a file left with
+ *  its lock file by an interrupted download is continued.
  */
 static int 
-vot_getData (char *url, char *ofname)
+vot_dlPrep (char *ofname, char *fname)
 {
-    int  stat = 0;
-    char lockfile[SZ_FNAME], dot[SZ_FNAME], errBuf[CURL_ERROR_SIZE];
-    char fname[SZ_FNAME], ffname[SZ_FNAME];
-    FILE *fd;
-    CURL *curl_handle;
+    char lockfile[SZ_FNAME], dot[SZ_FNAME], ffname[SZ_FNAME];
 
 
     /*   FIXME   */
@@ -916,15 +948,6 @@ vot_getData (char *url, char *ofname)
         sprintf (ffname, "%s.fits", ofname);
     }
 
-    if (access (ofname, F_OK) == 0 || access (ffname, F_OK) == 0) {
-	/* file already exists	*/
-	if (force)
-	    unlink (ofname);
-	else 
-	    return (1);
-    }
-
-
     /*  Initialize the lock file.
      */
     memset (lockfile, 0, SZ_FNAME);
@@ -933,8 +956,16 @@ vot_getData (char *url, char *ofname)
     sprintf (lockfile, ".%s.LOCK", ofname);
     sprintf (dot, ".%s", ofname);
 
-    if (access (lockfile, F_OK) == 0 && access (dot, F_OK) < 0) {
-	/*  Download currently in progress, perhaps on another thread?
+    if (access (ofname, F_OK) == 0 || access (ffname, F_OK) == 0) {
+	/* file already exists	*/
+	if (force)
+	    unlink (ofname);
+	else if (!resume || access (lockfile, F_OK) < 0)
+	    return (0);
+    }
+
+    if (access (lockfile, F_OK) == 0 && access (dot, F_OK) < 0 && !resume) {
+	/*  Download currently in progress, perhaps in another process?
 	  */
 	return (0);
     } else if (access (lockfile, F_OK) == 0 && access (dot, F_OK) == 0) {
@@ -955,68 +986,60 @@ vot_getData (char *url, char *ofname)
     else
 	strcpy (fname, ofname);
 
+    return (1);
+}
 
-    /*  For the CURL operation to download the file.
-     */
-    curl_global_init (CURL_GLOBAL_ALL);     	/* init curl session	*/
-    curl_handle = curl_easy_init ();
 
-    /*  Open the output file.
-     */
-    if ((fd = fopen (fname, "wb")) == NULL) { 	
-	if (verbose)
-	    fprintf (stderr, "Error: cannot open output file '%s'\n", fname);
-        curl_easy_cleanup (curl_handle);
-        return 0;
-    }
+/** 
+ *  VOT_DLDONE -- Download engine callback to finish an access list file.
+ *  The request 'data' is the access list entry.  Also called for files
+ *  taken from the download cache, which have no download attempts.
+ */
+static void 
+vot_dlDone (dlReq *req, char *errmsg)
+{
+    Acref *ac = (Acref *) req->data;
+    char   lockfile[SZ_FNAME], dot[SZ_FNAME], *fname = req->fname;
+    char   new[SZ_FNAME];
+    FILE  *fd;
 
-    /*  Set cURL options
-     */
-    curl_easy_setopt (curl_handle, CURLOPT_URL, url);
-    curl_easy_setopt (curl_handle, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt (curl_handle, CURLOPT_WRITEDATA, fd);
-    curl_easy_setopt (curl_handle, CURLOPT_ERRORBUFFER, errBuf);
-    curl_easy_setopt (curl_handle, CURLOPT_FOLLOWLOCATION, 1);
 
-    /*  Do the download.
-     */
-    if ((stat = curl_easy_perform (curl_handle)) != 0) {
-	/*  Error in download, clean up.
+    sprintf (lockfile, ".%s.LOCK", ac->fname);
+    sprintf (dot, ".%s", ac->fname);
+
+    if (req->status != DL_DONE) {
+	/*  Error in download, the engine has removed the file.
 	 */
 	if (verbose)
-	    fprintf (stderr, "Error: can't download '%s' : %s\n", url, errBuf);
-	unlink (fname); unlink (lockfile);
-        fclose (fd); 			    	/* close the file 	*/
-        curl_easy_cleanup (curl_handle);    	/* cleanup curl stuff 	*/
-	return (0);
+	    fprintf (stderr, "Error: can't download '%s' : %s\n", 
+		req->url, (errmsg ? errmsg : ""));
+	unlink (lockfile);
+	return;
     }
 
-    fflush (fd);
-    fclose (fd); 			    	/* close the file 	*/
-    curl_easy_cleanup (curl_handle); 	    	/* cleanup curl stuff 	*/
-
     /*  Save the URL to a "dotfile" is we're downloading to a cache.
      */
     if (isCache) {
         if ((fd = fopen (dot, "w")) == NULL) { /* open cache file   */
 	    if (verbose)
 	        fprintf (stderr, "Error: cannot open cache file '%s'\n", dot);
-            return 0;
+	} else {
+	    fprintf (fd, "%s\n", req->url);
+	    fclose (fd);
 	}
-	fprintf (fd, "%s\n", url);
-	fclose (fd);
     }
 
     /*  If we didn't specify an extension, try to determin the file type
      *  automatically.
      */
     if (!extn) {
-	int  i = 0, dfd, maxtrys = 30;
+	int  dfd;
 
 	if ((dfd = open (fname, O_RDONLY)) > 0) {
-	    char  buf[1024], new[SZ_FNAME];
+	    char  buf[1024];
 	    unsigned short *s = (unsigned short *) NULL;
 
+	    memset (buf, 0, 1024);
 	    (void) read (dfd, buf, 1024);
 
 	    s = (unsigned short *) buf;
@@ -1043,40 +1066,38 @@ vot_getData (char *url, char *ofname)
 	    memset (new, 0, SZ_FNAME);
 	    if (strncmp ("SIMPLE", buf, 6) == 0) {	/* FITS		*/
 		sprintf (new, "%s.fits", fname);
-		rename (fname, new);
-		for (i=0; i < maxtrys; i++) {
-		    if (access (new, F_OK) != 0)
-			sleep (1);
-		}
+		if (rename (fname, new) == 0)
+		    fname = new;
 	    }
 
 	    close (dfd);
 	}
     }
 
-    pthread_mutex_lock (&counter_mut);
+    /*  Add a new download to the download cache once it is decompressed,
+     *  so a cached copy needs no further processing.
+     */
+    if (isCache && req->ntries > 0)
+	(void) vot_dlcPut (req->url, fname);
+
     ngot++;
     if (verbose) {
 	fprintf (stderr, "Downloaded %d of %d files ....\r", ngot, nfiles);
 	fflush (stderr);
     }
-    pthread_mutex_unlock (&counter_mut);
 
     /*  Remove the lock file to indicate we are done.
      */
     unlink (lockfile);
-
-    return (1);
 }
 
 
-
 /******************************************************************************
 **  Debug Utilities
 ******************************************************************************/
 
 /** 
- *  VOT_GETACLIST -- Download all the files for the specified thread.
+ *  VOT_PRINTACLIST -- Print the access list.
  */
 static void
 vot_printAclist ()
@@ -1085,7 +1106,7 @@ vot_printAclist ()
 
     fprintf (stderr, "\nAccess List:  nfiles = %d\n", nfiles);
     for (i=0; i < nfiles; i++) {
-	fprintf (stderr, "%2d: url='%20.20s...'  fname='%s'  tnum=%d\n",
-	    i, aclist[i].url, aclist[i].fname, aclist[i].tnum);
+	fprintf (stderr, "%2d: url='%20.20s...'  fname='%s'\n",
+	    i, aclist[i].url, aclist[i].fname);
     }
 }
@@ -93,9 +93,13 @@ votinfo (int argc, char **argv, size_t *reslen, void **result)
 
     /*  Initialize. 
      */
+    vot      = 0;
     size     = 0;
     warn     = 0;
     verbose  = 0;
+    numberOf = 0;
+    getCols  = getDesc = getInfo = getParam = getQuery = 0;
+    do_return = 0;
     iname    = NULL;
     memset (param, 0, SZ_FNAME);
     memset (optval, 0, SZ_FNAME);
@@ -1,14 +1,33 @@
 /*
- *  VOTJOIN -- Perform an inner-join of two VOTables.
+ *  VOTJOIN -- Join two VOTables on one or more key columns.
  *
  *    Usage:
- *		votjoin [<otps>] <votable>
+ *		votjoin [<opts>] <left.xml> <right.xml>
  *
  *  @file       votjoin.c
  *  @author     Mike Fitzpatrick
  *  @date       6/03/12
  *
- *  @brief      Perform an inner-join of two VOTables.
+ *  @brief      Join two VOTables on one or more key columns.
+ *
+ *  The join is an equi-join on the key column values.  Numeric columns are
+ *  compared by value, other columns as whitespace-trimmed strings, and a
+ *  row with an empty key never matches.  A hash table is built from the
+ *  rows of the smaller input and the larger input is streamed past it so
+ *  only the smaller table is held in memory.  When the smaller input is
+ *  still larger than the memory limit, both inputs are first partitioned
+ *  on the key hash to temporary files and each pair of partitions is then
+ *  joined in turn (a Grace hash join), the output rows are then grouped
+ *  by partition rather than in input order.
+ *
+ *  Given a match radius the tables are instead cross-matched by position.
+ *  The RA/Dec columns default to the main position UCDs (as for votpos)
+ *  and the smaller table is indexed in declination zones of at least the
+ *  radius in height, each sorted by RA, so a row of the larger table only
+ *  needs to search the RA range of the few zones within the radius.  The
+ *  zones are sorted and each batch of streamed rows is searched by a pool
+ *  of worker threads, the matches are then written in input order.  The
+ *  positional match is always done in memory.
  */
 
 #include <stdio.h>
@@ -16,26 +35,129 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <sys/stat.h>
 
 #include "votParse.h"			/* keep these in order!		*/
 #include "voApps.h"
 
 
+#define	MAX_KEYS	16		/* max key columns		*/
+#define	MAX_PARTS	256		/* max Grace partitions		*/
+#define	SZ_KEY		4096		/* max key length		*/
+#define	SZ_BLOCK	1048576		/* row storage block size	*/
+#define	SZ_OBUF		262144		/* output buffer size		*/
+#define	DEF_MEMLIM	512		/* default memory limit (MB)	*/
+
+#define	J_INNER		0		/* join types			*/
+#define	J_LEFT		1
+#define	J_RIGHT		2
+#define	J_OUTER		3
+
+#define	KEY_SEP		'\037'		/* multiple key separator	*/
+
+#define	MAX_ZONES	648000		/* max dec zones (1" high)	*/
+#define	MAX_THREADS	64		/* max worker threads		*/
+#define	DEG2RAD		(M_PI / 180.0)
+
+#define	T_SORT		0		/* worker tasks			*/
+#define	T_MATCH		1
+
+
+typedef struct {			/* an input table		*/
+    char     *iname;			/* file name			*/
+    char     *keys;			/* key column list		*/
+    int       keycol[MAX_KEYS];		/* key column numbers		*/
+    int       numeric[MAX_KEYS];	/* compare key by value?	*/
+    int       nkeys;			/* number of key columns	*/
+    int       ncols;			/* number of columns		*/
+    int       keep;			/* keep unmatched rows?		*/
+    int       ntables;			/* TABLEDATAs seen		*/
+    long      nrows;			/* rows read			*/
+    long      size;			/* file size (-1 if unknown)	*/
+    handle_t  vot;			/* metadata document		*/
+    handle_t  tab;			/* joined <TABLE>		*/
+    char    **names;			/* output column names		*/
+    char    **ids;			/* output column IDs		*/
+} jTable;
+
+typedef struct jBlock {			/* row storage block		*/
+    struct jBlock *next;
+    size_t    used, size;
+    char     *data;
+} jBlock;
+
+typedef struct {			/* zone index entry		*/
+    double    ra;			/* RA (deg)			*/
+    double    x, y, z;			/* unit vector			*/
+    int       row;			/* build row			*/
+} jZent;
+
+typedef struct {			/* a positional match		*/
+    int       prow;			/* probe row in the batch	*/
+    int       brow;			/* build row			*/
+    double    sep;			/* separation (arcsec)		*/
+} jMatch;
+
+typedef struct {			/* per-thread match list	*/
+    jMatch   *m;
+    int       n, max;
+} jWork;
+
+typedef struct {			/* build-side hash table	*/
+    jBlock   *blocks;			/* cell string storage		*/
+    char    **cells;			/* row cells, row-major		*/
+    char    **keys;			/* row keys (NULL: no key)	*/
+    unsigned *hash;			/* row key hashes		*/
+    int      *next;			/* hash chains			*/
+    char     *matched;			/* row matched?			*/
+    int      *bucket;			/* hash bucket heads		*/
+    unsigned  nbuckets;			/* number of buckets (2^N)	*/
+    long      nrows, maxrows;
+
+    double   *ra, *dec;			/* positions (NaN: none)	*/
+    jZent    *zent;			/* zone index entries		*/
+    int      *zstart;			/* first entry of each zone	*/
+    int       nzones;			/* number of zones		*/
+    double    zh;			/* zone height (deg)		*/
+    char   ***best;			/* best probe row (--best)	*/
+    double   *bsep;			/* best separation		*/
+} jHash;
+
+typedef struct {
+    jTable    tab[2];			/* left and right inputs	*/
+    jTable   *build, *probe;		/* hashed and streamed inputs	*/
+    jTable   *cur;			/* input being read		*/
+    jHash     ht;			/* build-side rows		*/
+
+    int       nparts;			/* Grace partitions (0: none)	*/
+    FILE    **bpart, **ppart;		/* build/probe partitions	*/
+
+    FILE     *fd;			/* output file			*/
+    int       vot_out;			/* VOTable output?		*/
+    char      delim;			/* delimited output separator	*/
+    int       hdr;			/* header written?		*/
+    long      nout;			/* output rows			*/
+    int       status;			/* OK or ERR			*/
+
+    double    radius;			/* match radius (deg, 0: keys)	*/
+    double    chord2;			/* squared chord of the radius	*/
+    int       best;			/* best match only?		*/
+    int       nthreads;			/* worker threads		*/
+    voPool   *pool;			/* worker pool			*/
+    int       task;			/* worker task			*/
+    char    **bcells;			/* batch being matched		*/
+    int       bnrows;
+    char     *bmatched;			/* batch rows matched?		*/
+    jWork     work[MAX_THREADS];	/* per-thread matches		*/
+} jJoin;
+
 
 /*  Global task declarations.  These should all be defined as 'static' to
  *  avoid namespace collisions.
  */
-static int  vot         = 0;            /* VOTable handle               */
 static int  do_return   = 0;		/* return result?		*/
-
-
-/*  Result Buffer.
- */
-#ifdef USE_RESBUF
-#define	SZ_RESBUF	8192
-
-static char *resbuf;
-#endif
+static int  verbose     = 0;		/* verbose output?		*/
 
 
 /*  Task specific option declarations.  Task options are declared using the
@@ -44,22 +166,76 @@ static char *resbuf;
 int  votjoin (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "votjoin",  votjoin,  0,  0,  0  };
-static char  *opts 	= "hr";
+static char  *opts 	= "hk:1:2:t:f:m:R:bn:o:rv%:";
 static struct option long_opts[] = {
+        { "key",          1, 0,   'k'},		/* task option		*/
+        { "key1",         1, 0,   '1'},		/* task option		*/
+        { "key2",         1, 0,   '2'},		/* task option		*/
+        { "type",         1, 0,   't'},		/* task option		*/
+        { "fmt",          1, 0,   'f'},		/* task option		*/
+        { "mem",          1, 0,   'm'},		/* task option		*/
+        { "radius",       1, 0,   'R'},		/* task option		*/
+        { "best",         2, 0,   'b'},		/* task option		*/
+        { "nthreads",     1, 0,   'n'},		/* task option		*/
+        { "output",       1, 0,   'o'},		/* task option		*/
+        { "verbose",      2, 0,   'v'},		/* task option		*/
         { "help",         2, 0,   'h'},		/* --help is std	*/
         { "return",       2, 0,   'r'},		/* --return is std	*/
-        { "test",         2, 0,   '%'},		/* --return is std	*/
+        { "test",         1, 0,   '%'},		/* --test is std	*/
         { NULL,           0, 0,    0 }
 };
 
 
-/*  All tasks should declare a static Usage() method to print the help 
- *  text in response to a '-h' or '--help' flag.  The help text should 
+/*  All tasks should declare a static Usage() method to print the help
+ *  text in response to a '-h' or '--help' flag.  The help text should
  *  include a usage summary, a description of options, and some examples.
  */
 static void Usage (void);
 static void Tests (char *input);
 
+static void  join_rows (void *client, handle_t tdata, char **cells, int nrows,
+			int flag);
+static int   join_setTable (jJoin *j, jTable *t, handle_t tdata);
+static int   join_keyCols (jTable *t);
+static int   join_makeKey (jTable *t, char **row, char *key);
+static unsigned join_hash (char *key);
+static void  join_store (jJoin *j, char **row, char *key);
+static void  join_probe (jJoin *j, char **row, char *key);
+static void  join_unmatched (jJoin *j);
+static void  join_reset (jHash *ht);
+static char *join_strdup (jHash *ht, char *s);
+static void  join_spill (jJoin *j, jTable *t, FILE **part, char **row);
+static int   join_readSpill (FILE *fd, char **line, size_t *len,
+			char **fields, int nfields);
+static void  join_grace (jJoin *j);
+
+static void  join_colNames (jJoin *j);
+static void  join_header (jJoin *j);
+static void  join_footer (jJoin *j);
+static void  join_emit (jJoin *j, char **prow, char **brow, double sep);
+static void  join_xmlStr (FILE *fd, char *s);
+static long  join_fsize (char *fname);
+
+static int   join_posCols (jTable *t);
+static int   join_coord (char *s, int hours, double *val);
+static int   join_getPos (jTable *t, char **row, double *ra, double *dec);
+static int   join_zone (jHash *ht, double dec);
+static void  join_zones (jJoin *j);
+static int   join_zentCmp (const void *a, const void *b);
+static void  join_search (jJoin *j, jWork *w, int prow, double ra,
+			double dec);
+static void  join_scan (jJoin *j, jWork *w, int prow, int zn, double lo,
+			double hi, double *v);
+static void  join_xmatch (jJoin *j, char **cells, int nrows);
+static void  join_bestRow (jJoin *j, char **row, int brow, double sep);
+static void  join_bestOut (jJoin *j);
+static void  join_run (jJoin *j, int task);
+static void  join_work (void *data, int k);
+
+extern int strdic (char *in_str, char *out_str, int maxchars, char *dict);
+
+
+
 
 /**
  *  Application entry point.
@@ -67,28 +243,31 @@ static void Tests (char *input);
 int
 votjoin (int argc, char **argv, size_t *reslen, void **result)
 {
-    char **pargv, optval[SZ_FNAME];
-    char  *iname, *oname;
-    int    ch = 0, status = OK, number = 0, pos = 0;
+    char  **pargv, optval[SZ_FNAME], format[SZ_FORMAT];
+    char   *oname = NULL, *keys = NULL, *fmt = NULL;
+    int     ch = 0, status = OK, pos = 0, nin = 0, type = J_INNER, i, k;
+    long    memlim = DEF_MEMLIM;
+    jJoin   j;
+    jTable *t;
 
 
     /* Initialize result object	whether we return an object or not.
      */
-    *reslen = 0;	
+    *reslen = 0;
     *result = NULL;
 
     /*  Initialize local task values.
      */
-    iname  = NULL;
-    oname  = NULL;
-    vot    = -1;
+    memset (&j, 0, sizeof (jJoin));
+    do_return = 0;
+    verbose   = 0;
 
 
     /*  Parse the argument list.  The use of vo_paramInit() is required to
      *  rewrite the argv[] strings in a way vo_paramNext() can be used to
      *  parse them.  The programmatic interface allows "param=value" to
      *  be passed in, but the getopt_long() interface requires these to
-     *  be written as "--param=value" so they are not confused with 
+     *  be written as "--param=value" so they are not confused with
      *  positional parameters (i.e. any param w/out a leading '-').
      */
     pargv = vo_paramInit (argc, argv, opts, long_opts);
@@ -100,9 +279,32 @@ votjoin (int argc, char **argv, size_t *reslen, void **result)
 	    switch (ch) {
 	    case '%':  Tests (optval);			return (self.nfail);
 	    case 'h':  Usage ();			return (OK);
-	    case 'n':  number++;			break;
+	    case 'k':  keys = strdup (optval);		break;
+	    case '1':  j.tab[0].keys = strdup (optval);	break;
+	    case '2':  j.tab[1].keys = strdup (optval);	break;
+	    case 'f':  fmt = strdup (optval);		break;
+	    case 'm':  memlim = atol (optval);		break;
+	    case 'R':  j.radius = atof (optval) / 3600.;	break;
+	    case 'b':  j.best++;			break;
+	    case 'n':  j.nthreads = atoi (optval);	break;
 	    case 'o':  oname = strdup (optval);		break;
 	    case 'r':  do_return=1;	    	    	break;
+	    case 'v':  verbose++;	    	    	break;
+	    case 't':
+		if (strncasecmp (optval, "inner", 1) == 0)
+		    type = J_INNER;
+		else if (strncasecmp (optval, "left", 1) == 0)
+		    type = J_LEFT;
+		else if (strncasecmp (optval, "right", 1) == 0)
+		    type = J_RIGHT;
+		else if (strncasecmp (optval, "outer", 1) == 0 ||
+			 strncasecmp (optval, "full", 1) == 0)
+		    type = J_OUTER;
+		else {
+		    fprintf (stderr, "Error: invalid join type '%s'\n", optval);
+		    return (ERR);
+		}
+		break;
 	    default:
 		fprintf (stderr, "Invalid option '%s'\n", optval);
 		return (1);
@@ -117,8 +319,11 @@ votjoin (int argc, char **argv, size_t *reslen, void **result)
 	     *  overwritten w/ each arch we need to make a copy (and must
 	     *  remember to free it later.
 	     */
-	    iname = strdup (optval);
-	    break;
+	    if (nin >= 2) {
+		fprintf (stderr, "Error: only two tables may be joined\n");
+		return (ERR);
+	    }
+	    j.tab[nin++].iname = strdup (optval);
 	}
     }
 
@@ -126,34 +331,197 @@ votjoin (int argc, char **argv, size_t *reslen, void **result)
     /*  Sanity checks.  Tasks should validate input and accept stdin/stdout
      *  where it makes sense.
      */
-    if (iname == NULL) iname = strdup ("stdin");
+    if (nin < 2) {
+	Usage ();
+	return (ERR);
+    }
+    for (i=0; i < 2; i++) {
+	t = &j.tab[i];
+	if (strcmp (t->iname, "-") == 0) {
+	    free (t->iname), t->iname = strdup ("stdin");
+	}
+	if (t->keys == NULL && keys)
+	    t->keys = strdup (keys);
+	if (t->keys == NULL && j.radius <= 0.0) {
+	    fprintf (stderr, "Error: no key columns given for '%s'\n",
+		t->iname);
+	    status = ERR;
+	    goto clean_up_;
+	}
+    }
+    if (strcasecmp (j.tab[0].iname, "stdin") == 0 &&
+	strcasecmp (j.tab[1].iname, "stdin") == 0) {
+	    fprintf (stderr, "Error: only one input may be the stdin\n");
+	    status = ERR;
+	    goto clean_up_;
+    }
+    if (do_return) {			/* return result		*/
+	if (oname) free (oname);
+	oname = calloc (1, SZ_FNAME);
+	sprintf (oname, "/tmp/votjoin.%d", (int) getpid());
+    }
     if (oname == NULL) oname = strdup ("stdout");
-    if (strcmp (iname, "-") == 0) { free (iname), iname = strdup ("stdin");  }
     if (strcmp (oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
 
+    j.vot_out = 1;
+    if (fmt) {
+	switch (strdic (fmt, format, SZ_FORMAT, FORMATS)) {
+	case   VOT:
+	case   XML:
+	case   RAW:   j.vot_out = 1;			break;
+	case   CSV:   j.vot_out = 0, j.delim = ',';	break;
+	case   TSV:   j.vot_out = 0, j.delim = '\t';	break;
+	case   BSV:   j.vot_out = 0, j.delim = '|';	break;
+	case   ASV:
+	case ASCII:   j.vot_out = 0, j.delim = ' ';	break;
+	default:
+	    fprintf (stderr, "Error: unsupported output format '%s'\n", fmt);
+	    status = ERR;
+	    goto clean_up_;
+	}
+    }
+
+
+    /*  Hash the smaller input and stream the larger one, a stdin input
+     *  is always streamed since its size isn't known.
+     */
+    j.tab[0].size = join_fsize (j.tab[0].iname);
+    j.tab[1].size = join_fsize (j.tab[1].iname);
+    if (j.tab[1].size >= 0 &&
+	(j.tab[0].size < 0 || j.tab[1].size < j.tab[0].size))
+	    j.build = &j.tab[1], j.probe = &j.tab[0];
+    else
+	    j.build = &j.tab[0], j.probe = &j.tab[1];
+
+    j.tab[0].keep = (type == J_LEFT  || type == J_OUTER);
+    j.tab[1].keep = (type == J_RIGHT || type == J_OUTER);
+
+    /*  Partition both inputs when the build side won't fit in memory.
+     */
+    if (j.radius > 0.0) {
+	j.chord2 = 4.0 * pow (sin (j.radius * DEG2RAD / 2.0), 2.0);
+	if (j.nthreads <= 0)
+	    j.nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	j.nthreads = (j.nthreads < 1 ? 1 :
+	    (j.nthreads > MAX_THREADS ? MAX_THREADS : j.nthreads));
+	j.pool = vot_poolCreate (j.nthreads);
+	j.nthreads = vot_poolSize (j.pool);
+
+    } else if (memlim > 0 && j.build->size > memlim * 1048576L) {
+	j.nparts = (int) (j.build->size / (memlim * 1048576L)) * 2 + 2;
+	if (j.nparts > MAX_PARTS)
+	    j.nparts = MAX_PARTS;
 
+	j.bpart = (FILE **) calloc (j.nparts, sizeof (FILE *));
+	j.ppart = (FILE **) calloc (j.nparts, sizeof (FILE *));
+	for (i=0; i < j.nparts; i++) {
+	    if (!(j.bpart[i] = tmpfile ()) || !(j.ppart[i] = tmpfile ())) {
+		fprintf (stderr, "Error: cannot create partition files\n");
+		status = ERR;
+		goto clean_up_;
+	    }
+	}
+    }
+
+    if (strcasecmp (oname, "stdout") == 0)
+	j.fd = stdout;
+    else if ((j.fd = fopen (oname, "w+")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open output file '%s'\n", oname);
+	status = ERR;
+	goto clean_up_;
+    }
+    setvbuf (j.fd, NULL, _IOFBF, SZ_OBUF);
+
+    if (verbose)
+	fprintf (stderr, "%s '%s', streaming '%s'%s\n",
+	    (j.radius > 0.0 ? "Indexing" : "Hashing"), j.build->iname,
+	    j.probe->iname, (j.nparts ? " (partitioned)" : ""));
 
 
-   /********
-    ********
-    ********
-    ********
-    ********		Main body of task
-    ********
-    ********
-    ********
-    *******/
+    /*  Read the build side, then stream the probe side past it.  The
+     *  output header is written as the probe table starts.
+     */
+    for (i=0; i < 2 && j.status == OK; i++) {
+	t = j.cur = (i == 0 ? j.build : j.probe);
+
+	if ((t->vot = vot_streamRows (t->iname, join_rows, &j)) == 0) {
+	    fprintf (stderr, "Error opening VOTable '%s'\n", t->iname);
+	    j.status = ERR;
+	} else if (j.status == OK && t->ntables == 0) {
+	    fprintf (stderr, "Error: no TABLEDATA in '%s'\n", t->iname);
+	    j.status = ERR;
+	}
+
+	if (i == 0 && j.radius > 0.0 && j.status == OK)
+	    join_zones (&j);
+    }
+
+    if (j.status == OK) {
+	if (j.nparts)
+	    join_grace (&j);
+	else if (j.radius > 0.0 && j.best && j.build == &j.tab[0])
+	    join_bestOut (&j);
+	else if (j.build->keep)
+	    join_unmatched (&j);
+	join_footer (&j);
+
+	if (verbose)
+	    fprintf (stderr, "Joined %ld x %ld rows, %ld output rows\n",
+		j.tab[0].nrows, j.tab[1].nrows, j.nout);
+    }
+    status = j.status;
+
+    if (j.fd != stdout)
+	fclose (j.fd);
+    else
+	fflush (j.fd);
 
 
+    /*  If we requested a return object, get it from the output file.
+     */
+    if (do_return && status == OK) {
+	vo_setResultFromFile (oname, reslen, result);
+	unlink (oname);
+    }
 
 
     /*  Clean up.  Rememebr to free whatever pointers were created when
      *  parsing arguments.
      */
-    if (iname)
-	free (iname);
-    if (oname)
-	free (oname);
+clean_up_:
+    vot_poolFree (j.pool);
+    for (i=0; i < MAX_THREADS; i++)
+	if (j.work[i].m)
+	    free ((void *) j.work[i].m);
+    if (j.bmatched)
+	free ((void *) j.bmatched);
+    join_reset (&j.ht);
+    for (i=0; i < j.nparts; i++) {
+	if (j.bpart[i]) fclose (j.bpart[i]);
+	if (j.ppart[i]) fclose (j.ppart[i]);
+    }
+    if (j.bpart) free ((void *) j.bpart);
+    if (j.ppart) free ((void *) j.ppart);
+
+    for (i=0; i < 2; i++) {
+	t = &j.tab[i];
+	if (t->vot > 0)
+	    vot_closeVOTABLE (t->vot);
+	if (t->names) {
+	    for (k=0; k < t->ncols; k++) {
+		free ((void *) t->names[k]);
+		if (t->ids[k])
+		    free ((void *) t->ids[k]);
+	    }
+	    free ((void *) t->names);
+	    free ((void *) t->ids);
+	}
+	if (t->iname) free (t->iname);
+	if (t->keys)  free (t->keys);
+    }
+    if (keys)  free (keys);
+    if (fmt)   free (fmt);
+    if (oname) free (oname);
 
     vo_paramFree (argc, pargv);
 
@@ -168,20 +536,46 @@ static void
 Usage (void)
 {
     fprintf (stderr, "\n  Usage:\n\t"
-        "votjoin [<opts>] votable.xml\n\n"
+        "votjoin [<opts>] left.xml right.xml\n\n"
         "  where\n"
         "       -%%,--test		run unit tests\n"
         "       -h,--help		this message\n"
-        "       -n,--number		number output\n"
+        "       -k,--key=<cols>		key column(s) in both tables\n"
+        "       -1,--key1=<cols>		key column(s) in the left table\n"
+        "       -2,--key2=<cols>		key column(s) in the right table\n"
+        "       -t,--type=<type>		join type (inner|left|right|outer)\n"
+        "       -f,--fmt=<fmt>		output format (vot|csv|tsv|asv|bsv)\n"
+        "       -m,--mem=<MB>		memory limit before partitioning\n"
+        "       -R,--radius=<arcsec>	cross-match by position\n"
+        "       -b,--best		best positional match only\n"
+        "       -n,--nthreads=<N>	cross-match worker threads\n"
         "       -o,--output=<file>	output file\n"
         "       -r,--return		return result from method\n"
+        "       -v,--verbose		verbose output\n"
+	"\n"
+	"  Key columns are a comma-delimited list matched against the\n"
+	"  column name, ID or UCD in that order.  The output contains all\n"
+	"  the columns of the left table followed by those of the right,\n"
+	"  a column name in both tables is given a '_1' or '_2' suffix.\n"
+	"\n"
+	"  With a --radius the keys are the RA and Dec columns (in degrees\n"
+	"  or sexagesimal), by default those with the main position UCDs.\n"
+	"  All pairs within the radius are output with their separation\n"
+	"  in a 'sep' column, or with --best only the nearest match for\n"
+	"  each row of the left table.\n"
 	"\n"
  	"  Examples:\n\n"
-	"    1)  First example\n\n"
-	"	    %% votjoin test.xml\n"
+	"    1)  Inner join of two tables on an 'id' column:\n\n"
+	"	    %% votjoin --key=id cat.xml targets.xml\n"
+	"\n"
+	"    2)  Keep all catalog rows, output as CSV:\n\n"
+	"	    %% votjoin -k objid -t left -f csv cat.xml targets.xml\n"
 	"\n"
-	"    2)  Second example\n\n"
-	"	    %% votjoin -o pos.txt test.xml\n"
+	"    3)  Join on two columns with different names in each table:\n\n"
+	"	    %% votjoin -1 field,obj -2 fld,num -o out.xml a.xml b.xml\n"
+	"\n"
+	"    4)  Best match within 2 arcsec of each target position:\n\n"
+	"	    %% votjoin --radius=2 --best targets.xml cat.xml\n"
 	"\n"
     );
 }
@@ -200,4 +594,1217 @@ Tests (char *input)
     *  always be a NULL to terminate the cmd args.
     */
    vo_taskTest (task, "--help", NULL);
+
+   vo_taskTest (task, "--key=id", input, input, NULL);			// Ex 1
+   vo_taskTest (task, "-k", "id", "-t", "left", "-f", "csv", 		// Ex 2
+	input, input, NULL);
+   vo_taskTest (task, "-1", "id", "-2", "id", "-o", "join.xml", 	// Ex 3
+	input, input, NULL);
+   vo_taskTest (task, "-k", "id", "-t", "outer", "--mem=0",
+	input, input, NULL);
+   vo_taskTest (task, "--radius=2", "--best", input, input, NULL);	// Ex 4
+   vo_taskTest (task, "-R", "5", "-t", "left", "-n", "2", "-f", "csv",
+	input, input, NULL);
+
+   if (access ("join.xml", F_OK) == 0)   unlink ("join.xml");
+
+   vo_taskTestReport (self);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  JOIN_ROWS -- Row function for both inputs, store or probe each row.
+ */
+static void
+join_rows (void *client, handle_t tdata, char **cells, int nrows, int flag)
+{
+    jJoin  *j = (jJoin *) client;
+    jTable *t = j->cur;
+    char    key[SZ_KEY], **row;
+    int     i;
+
+
+    switch (flag) {
+    case VOT_ROWS_BEGIN:
+	if (t->ntables++ == 0 && j->status == OK)
+	    j->status = join_setTable (j, t, tdata);
+	else if (t->ntables == 2)
+	    fprintf (stderr, "Warning: only the first table in '%s' is used\n",
+		t->iname);
+	break;
+
+    case VOT_ROWS_DATA:
+	if (t->ntables != 1 || j->status != OK)
+	    break;
+
+	if (j->radius > 0.0 && t == j->probe) {
+	    join_xmatch (j, cells, nrows);
+	    t->nrows += nrows;
+	    break;
+	}
+
+	for (i=0; i < nrows; i++) {
+	    row = &cells[i * t->ncols];
+	    if (j->nparts)
+		join_spill (j, t, (t == j->build ? j->bpart : j->ppart), row);
+	    else if (t == j->build && j->radius > 0.0)
+		join_store (j, row, NULL);
+	    else if (t == j->build)
+		join_store (j, row, (join_makeKey (t, row, key) < 0 ? NULL:key));
+	    else
+		join_probe (j, row, (join_makeKey (t, row, key) < 0 ? NULL:key));
+	}
+	t->nrows += nrows;
+	break;
+    }
+}
+
+
+/**
+ *  JOIN_SETTABLE -- Set up an input as its first table starts.
+ */
+static int
+join_setTable (jJoin *j, jTable *t, handle_t tdata)
+{
+    t->tab   = vot_getParent (vot_getParent (tdata));
+    t->ncols = vot_getNCols (tdata);
+
+    if ((j->radius > 0.0 ? join_posCols (t) : join_keyCols (t)) != OK)
+	return (ERR);
+
+    if (t == j->probe) {
+	if (t->nkeys != j->build->nkeys) {
+	    fprintf (stderr, "Error: tables must have the same number of keys\n");
+	    return (ERR);
+	}
+	join_colNames (j);
+	join_header (j);
+    }
+    return (OK);
+}
+
+
+/**
+ *  JOIN_KEYCOLS -- Find the key columns of a table by name, ID or UCD.
+ */
+static int
+join_keyCols (jTable *t)
+{
+    char   *list = strdup (t->keys), *name, *last = NULL, *dtype;
+    handle_t field;
+    int     col, i;
+
+
+    t->nkeys = 0;
+    for (name=strtok_r (list, ",", &last); name;
+	name=strtok_r (NULL, ",", &last)) {
+	    while (isspace (*name))
+		name++;
+	    if (!*name)
+		continue;
+
+	    if (t->nkeys >= MAX_KEYS) {
+		fprintf (stderr, "Error: too many key columns (max %d)\n",
+		    MAX_KEYS);
+		free (list);
+		return (ERR);
+	    }
+	    if ((col = vot_colByName (t->tab, name, NULL)) < 0 &&
+	        (col = vot_colByID (t->tab, name, NULL)) < 0 &&
+	        (col = vot_colByUCD (t->tab, name, NULL)) < 0) {
+		    fprintf (stderr, "Error: no key column '%s' in '%s'\n",
+			name, t->iname);
+		    free (list);
+		    return (ERR);
+	    }
+
+	    /*  Numeric keys are compared by value so that e.g. "1.0" and
+	     *  "1" match.
+	     */
+	    for (i=0, field=vot_getFIELD (t->tab); field && i < col; i++)
+		field = vot_getNext (field);
+	    dtype = (field ? vot_getAttr (field, "datatype") : NULL);
+
+	    t->keycol[t->nkeys]  = col;
+	    t->numeric[t->nkeys] = (dtype &&
+		(strcasecmp (dtype, "short") == 0  ||
+		 strcasecmp (dtype, "int") == 0    ||
+		 strcasecmp (dtype, "long") == 0   ||
+		 strcasecmp (dtype, "float") == 0  ||
+		 strcasecmp (dtype, "double") == 0 ||
+		 strcasecmp (dtype, "unsignedByte") == 0));
+	    t->nkeys++;
+	    if (dtype)
+		free ((void *) dtype);
+    }
+    free (list);
+
+    if (t->nkeys == 0) {
+	fprintf (stderr, "Error: no key columns given for '%s'\n", t->iname);
+	return (ERR);
+    }
+    return (OK);
+}
+
+
+/**
+ *  JOIN_MAKEKEY -- Make the normalized key string for a row.  Returns the
+ *  key length, or -1 if a key cell is empty and the row can't match.
+ */
+static int
+join_makeKey (jTable *t, char **row, char *key)
+{
+    char   *s, *e, *ep, num[SZ_LINE];
+    int     k, len = 0, n;
+    double  d;
+
+
+    for (k=0; k < t->nkeys; k++) {
+	if ((s = row[t->keycol[k]]) == NULL)
+	    return (-1);
+	while (isspace (*s))
+	    s++;
+	for (e=s+strlen(s); e > s && isspace (e[-1]); e--)
+	    ;
+	if (e == s)
+	    return (-1);
+
+	if (t->numeric[k]) {
+	    d = strtod (s, &ep);
+	    if (ep == e) {
+		if (d != d)			/* NaN never matches	*/
+		    return (-1);
+		sprintf (num, "%.17g", d);
+		s = num;
+		e = num + strlen (num);
+	    }
+	}
+
+	n = (int) (e - s);
+	if (len + n + 2 > SZ_KEY)
+	    return (-1);
+	if (k > 0)
+	    key[len++] = KEY_SEP;
+	memcpy (&key[len], s, n);
+	len += n;
+    }
+    key[len] = '\0';
+
+    return (len);
+}
+
+
+/**
+ *  JOIN_HASH -- FNV-1a hash of a key.
+ */
+static unsigned
+join_hash (char *key)
+{
+    unsigned h = 2166136261U;
+
+    for ( ; *key; key++) {
+	h ^= (unsigned char) *key;
+	h *= 16777619U;
+    }
+    return (h);
+}
+
+
+/**
+ *  JOIN_STORE -- Add a build-side row to the hash table.
+ */
+static void
+join_store (jJoin *j, char **row, char *key)
+{
+    jHash  *ht = &j->ht;
+    int     ncols = j->build->ncols, i;
+    long    r;
+
+
+    if (ht->nrows == ht->maxrows) {
+	ht->maxrows = (ht->maxrows ? 2 * ht->maxrows : 4096);
+	ht->cells   = realloc (ht->cells, ht->maxrows * ncols * sizeof(char *));
+	ht->keys    = realloc (ht->keys, ht->maxrows * sizeof (char *));
+	ht->hash    = realloc (ht->hash, ht->maxrows * sizeof (unsigned));
+	ht->next    = realloc (ht->next, ht->maxrows * sizeof (int));
+	ht->matched = realloc (ht->matched, ht->maxrows * sizeof (char));
+	if (j->radius > 0.0) {
+	    ht->ra   = realloc (ht->ra, ht->maxrows * sizeof (double));
+	    ht->dec  = realloc (ht->dec, ht->maxrows * sizeof (double));
+	    ht->best = realloc (ht->best, ht->maxrows * sizeof (char **));
+	    ht->bsep = realloc (ht->bsep, ht->maxrows * sizeof (double));
+	}
+	if (!ht->cells || !ht->keys || !ht->hash || !ht->next || !ht->matched ||
+	    (j->radius > 0.0 && (!ht->ra || !ht->dec || !ht->best || !ht->bsep))){
+	    fprintf (stderr, "Error: out of memory storing '%s', try --mem\n",
+		j->build->iname);
+	    j->status = ERR;
+	    return;
+	}
+    }
+
+    /*  Keep the bucket count at or above the row count, rehashing the
+     *  stored rows when it is doubled.
+     */
+    if (ht->nrows >= (long) ht->nbuckets) {
+	ht->nbuckets = (ht->nbuckets ? 2 * ht->nbuckets : 4096);
+	free ((void *) ht->bucket);
+	ht->bucket = (int *) malloc (ht->nbuckets * sizeof (int));
+	memset (ht->bucket, -1, ht->nbuckets * sizeof (int));
+	for (r=0; r < ht->nrows; r++) {
+	    if (ht->keys[r]) {
+		i = ht->hash[r] & (ht->nbuckets - 1);
+		ht->next[r] = ht->bucket[i];
+		ht->bucket[i] = (int) r;
+	    }
+	}
+    }
+
+    r = ht->nrows++;
+    for (i=0; i < ncols; i++)
+	ht->cells[r * ncols + i] = join_strdup (ht, row[i]);
+    ht->matched[r] = 0;
+
+    if (j->radius > 0.0) {
+	if (join_getPos (j->build, row, &ht->ra[r], &ht->dec[r]) != OK)
+	    ht->ra[r] = ht->dec[r] = NAN;
+	ht->best[r] = NULL;
+	ht->bsep[r] = -1.0;
+    }
+
+    if (key) {
+	ht->keys[r] = join_strdup (ht, key);
+	ht->hash[r] = join_hash (key);
+	i = ht->hash[r] & (ht->nbuckets - 1);
+	ht->next[r] = ht->bucket[i];
+	ht->bucket[i] = (int) r;
+    } else
+	ht->keys[r] = NULL;
+}
+
+
+/**
+ *  JOIN_PROBE -- Output the joins of a probe-side row.
+ */
+static void
+join_probe (jJoin *j, char **row, char *key)
+{
+    jHash  *ht = &j->ht;
+    unsigned h;
+    int     r, nmatch = 0;
+
+
+    if (key && ht->nbuckets) {
+	h = join_hash (key);
+	for (r=ht->bucket[h & (ht->nbuckets-1)]; r >= 0; r=ht->next[r]) {
+	    if (ht->hash[r] == h && strcmp (ht->keys[r], key) == 0) {
+		join_emit (j, row, &ht->cells[(long) r * j->build->ncols],
+		    -1.0);
+		ht->matched[r] = 1;
+		nmatch++;
+	    }
+	}
+    }
+
+    if (nmatch == 0 && j->probe->keep)
+	join_emit (j, row, NULL, -1.0);
+}
+
+
+/**
+ *  JOIN_UNMATCHED -- Output the build-side rows that were never matched.
+ */
+static void
+join_unmatched (jJoin *j)
+{
+    jHash  *ht = &j->ht;
+    long    r;
+
+    for (r=0; r < ht->nrows; r++)
+	if (!ht->matched[r])
+	    join_emit (j, NULL, &ht->cells[r * j->build->ncols], -1.0);
+}
+
+
+/**
+ *  JOIN_RESET -- Free the hash table contents.
+ */
+static void
+join_reset (jHash *ht)
+{
+    jBlock *b, *next;
+    long    r;
+
+    for (r=0; ht->best && r < ht->nrows; r++)
+	if (ht->best[r])
+	    free ((void *) ht->best[r]);
+    for (b=ht->blocks; b; b=next) {
+	next = b->next;
+	free ((void *) b);
+    }
+    if (ht->cells)   free ((void *) ht->cells);
+    if (ht->keys)    free ((void *) ht->keys);
+    if (ht->hash)    free ((void *) ht->hash);
+    if (ht->next)    free ((void *) ht->next);
+    if (ht->matched) free ((void *) ht->matched);
+    if (ht->bucket)  free ((void *) ht->bucket);
+    if (ht->ra)      free ((void *) ht->ra);
+    if (ht->dec)     free ((void *) ht->dec);
+    if (ht->zent)    free ((void *) ht->zent);
+    if (ht->zstart)  free ((void *) ht->zstart);
+    if (ht->best)    free ((void *) ht->best);
+    if (ht->bsep)    free ((void *) ht->bsep);
+
+    memset (ht, 0, sizeof (jHash));
+}
+
+
+/**
+ *  JOIN_STRDUP -- Copy a string to the row storage.
+ */
+static char *
+join_strdup (jHash *ht, char *s)
+{
+    jBlock *b = ht->blocks;
+    size_t  len, size;
+    char   *p;
+
+
+    if (s == NULL)
+	return (NULL);
+
+    len = strlen (s) + 1;
+    if (b == NULL || b->used + len > b->size) {
+	size = (len > SZ_BLOCK ? len : SZ_BLOCK);
+	if ((b = (jBlock *) malloc (sizeof (jBlock) + size)) == NULL)
+	    return (NULL);
+	b->data = (char *) (b + 1);
+	b->size = size;
+	b->used = 0;
+	b->next = ht->blocks;
+	ht->blocks = b;
+    }
+
+    p = &b->data[b->used];
+    memcpy (p, s, len);
+    b->used += len;
+
+    return (p);
+}
+
+
+/**
+ *  JOIN_SPILL -- Write a row to its partition file.  Each row is a line
+ *  of the key followed by the cells, tab-separated with tabs, newlines
+ *  and backslashes escaped.  An empty field is a NULL cell.
+ */
+static void
+join_spill (jJoin *j, jTable *t, FILE **part, char **row)
+{
+    char     key[SZ_KEY], *s;
+    unsigned h;
+    int      i, p;
+    FILE    *fd;
+
+
+    if (join_makeKey (t, row, key) < 0) {
+	if (!t->keep)
+	    return;
+	if (t == j->probe) {		/* can't match, output it now	*/
+	    join_emit (j, row, NULL, -1.0);
+	    return;
+	}
+	key[0] = '\0';
+	p = 0;
+
+    } else {
+	/*  Mix the hash so the partition doesn't select the low bits
+	 *  used for the buckets.
+	 */
+	h  = join_hash (key);
+	h ^= h >> 16;  h *= 0x85ebca6bU;
+	h ^= h >> 13;  h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	p  = (int) (h % (unsigned) j->nparts);
+    }
+
+    fd = part[p];
+    for (i=-1; i < t->ncols; i++) {
+	if (i >= 0)
+	    putc ('\t', fd);
+	if ((s = (i < 0 ? key : row[i])) == NULL)
+	    continue;
+	for ( ; *s; s++) {
+	    switch (*s) {
+	    case '\\':  putc ('\\', fd), putc ('\\', fd);	break;
+	    case '\t':  putc ('\\', fd), putc ('t', fd);	break;
+	    case '\n':  putc ('\\', fd), putc ('n', fd);	break;
+	    default:    putc (*s, fd);
+	    }
+	}
+    }
+    putc ('\n', fd);
+}
+
+
+/**
+ *  JOIN_READSPILL -- Read a row from a partition file into 'fields', the
+ *  line buffer is reused.  Returns the number of fields or -1 at EOF.
+ */
+static int
+join_readSpill (FILE *fd, char **line, size_t *len, char **fields, int nfields)
+{
+    char   *s, *d;
+    int     n = 0;
+
+
+    if (getline (line, len, fd) < 0)
+	return (-1);
+
+    fields[n] = s = d = *line;
+    for ( ; *s && *s != '\n'; s++) {
+	if (*s == '\t') {
+	    *d++ = '\0';
+	    if (++n < nfields)
+		fields[n] = d;
+	} else if (*s == '\\' && s[1]) {
+	    s++;
+	    *d++ = (*s == 't' ? '\t' : (*s == 'n' ? '\n' : *s));
+	} else
+	    *d++ = *s;
+    }
+    *d = '\0';
+
+    for (n++; n < nfields; n++)		/* short line, pad w/ NULLs	*/
+	fields[n] = NULL;
+    for (n=0; n < nfields; n++)
+	if (fields[n] && !fields[n][0])
+	    fields[n] = NULL;
+
+    return (nfields);
+}
+
+
+/**
+ *  JOIN_GRACE -- Join each pair of partitions in turn.
+ */
+static void
+join_grace (jJoin *j)
+{
+    char  **bf, **pf, *line = NULL;
+    size_t  len = 0;
+    int     p;
+
+
+    bf = (char **) calloc (j->build->ncols + 1, sizeof (char *));
+    pf = (char **) calloc (j->probe->ncols + 1, sizeof (char *));
+
+    for (p=0; p < j->nparts && j->status == OK; p++) {
+	rewind (j->bpart[p]);
+	while (join_readSpill (j->bpart[p], &line, &len, bf,
+	    j->build->ncols + 1) > 0 && j->status == OK)
+		join_store (j, &bf[1], bf[0]);
+
+	rewind (j->ppart[p]);
+	while (join_readSpill (j->ppart[p], &line, &len, pf,
+	    j->probe->ncols + 1) > 0)
+		join_probe (j, &pf[1], pf[0]);
+
+	if (j->build->keep)
+	    join_unmatched (j);
+
+	if (verbose > 1)
+	    fprintf (stderr, "Partition %d: %ld rows hashed\n", p, j->ht.nrows);
+	join_reset (&j->ht);
+
+	fclose (j->bpart[p]),  j->bpart[p] = NULL;
+	fclose (j->ppart[p]),  j->ppart[p] = NULL;
+    }
+
+    if (line) free ((void *) line);
+    free ((void *) bf);
+    free ((void *) pf);
+}
+
+
+/**
+ *  JOIN_COLNAMES -- Set the output column names and IDs of both tables,
+ *  a name or ID used in both tables gets a '_1' or '_2' suffix.
+ */
+static void
+join_colNames (jJoin *j)
+{
+    jTable  *t, *o;
+    handle_t field;
+    char     buf[SZ_LINE], *name, *id, **fnames[2];
+    int      i, k, n, nf[2], dup;
+
+
+    /*  Get the FIELD names of both tables once for the duplicate checks.
+     */
+    for (n=0; n < 2; n++) {
+	t = &j->tab[n];
+	for (nf[n]=0, field=vot_getFIELD (t->tab); field;
+	    field=vot_getNext (field))
+		nf[n]++;
+	fnames[n] = (char **) calloc (nf[n] + 1, sizeof (char *));
+	for (i=0, field=vot_getFIELD (t->tab); field;
+	    field=vot_getNext (field))
+		fnames[n][i++] = vot_getAttr (field, "name");
+    }
+
+    for (n=0; n < 2; n++) {
+	t = &j->tab[n];
+	o = &j->tab[1-n];
+	t->names = (char **) calloc (t->ncols, sizeof (char *));
+	t->ids   = (char **) calloc (t->ncols, sizeof (char *));
+
+	for (i=0, field=vot_getFIELD (t->tab); i < t->ncols; i++) {
+	    name = (i < nf[n] ? fnames[n][i] : NULL);
+	    id   = (field ? vot_getAttr (field, "id") : NULL);
+
+	    memset (buf, 0, SZ_LINE);
+	    if (name && *name)
+		strncpy (buf, name, SZ_LINE - 4);
+	    else
+		sprintf (buf, "col%d", i);
+
+	    for (dup=0, k=0; k < nf[1-n] && !dup; k++)
+		dup = (fnames[1-n][k] && strcmp (fnames[1-n][k], buf) == 0);
+	    if (dup)
+		strcat (buf, (n == 0 ? "_1" : "_2"));
+	    t->names[i] = strdup (buf);
+
+	    if (id && *id) {
+		memset (buf, 0, SZ_LINE);
+		strncpy (buf, id, SZ_LINE - 4);
+		if (vot_colByID (o->tab, id, NULL) >= 0)
+		    strcat (buf, (n == 0 ? "_1" : "_2"));
+		t->ids[i] = strdup (buf);
+	    }
+	    if (id)
+		free ((void *) id);
+
+	    if (field)
+		field = vot_getNext (field);
+	}
+    }
+
+    for (n=0; n < 2; n++) {
+	for (i=0; i < nf[n]; i++)
+	    if (fnames[n][i])
+		free ((void *) fnames[n][i]);
+	free ((void *) fnames[n]);
+    }
+}
+
+
+/**
+ *  JOIN_HEADER -- Write the output header.
+ */
+static void
+join_header (jJoin *j)
+{
+    static char *attrs[] = { "datatype", "arraysize", "width", "precision",
+			     "unit", "ucd", "utype", "xtype", NULL };
+    jTable  *t;
+    handle_t field, desc;
+    char    *val;
+    FILE    *fd = j->fd;
+    int      i, n, k;
+
+
+    if (j->hdr++)
+	return;
+
+    if (!j->vot_out) {
+	fprintf (fd, "# ");
+	for (n=0; n < 2; n++) {
+	    t = &j->tab[n];
+	    for (i=0; i < t->ncols; i++) {
+		fprintf (fd, "%s", t->names[i]);
+		if (n == 0 || i < (t->ncols-1))
+		    putc (j->delim, fd);
+	    }
+	}
+	if (j->radius > 0.0)
+	    fprintf (fd, "%csep", j->delim);
+	putc ('\n', fd);
+	return;
+    }
+
+    fprintf (fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf (fd, "<VOTABLE version=\"1.2\" "
+	"xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+	"xmlns=\"http://www.ivoa.net/xml/VOTable/v1.2\">\n");
+    fprintf (fd, "<RESOURCE>\n<TABLE name=\"votjoin\">\n");
+
+    for (n=0; n < 2; n++) {
+	t = &j->tab[n];
+	for (i=0, field=vot_getFIELD (t->tab); i < t->ncols; i++) {
+	    fprintf (fd, "<FIELD");
+	    if (t->ids[i]) {
+		fprintf (fd, " ID=\"");
+		join_xmlStr (fd, t->ids[i]);
+		putc ('"', fd);
+	    }
+	    fprintf (fd, " name=\"");
+	    join_xmlStr (fd, t->names[i]);
+	    putc ('"', fd);
+
+	    for (k=0; field && attrs[k]; k++) {
+		if ((val = vot_getAttr (field, attrs[k]))) {
+		    if (*val) {
+			fprintf (fd, " %s=\"", attrs[k]);
+			join_xmlStr (fd, val);
+			putc ('"', fd);
+		    }
+		    free ((void *) val);
+		}
+	    }
+
+	    if (field && (desc = vot_getDESCRIPTION (field)) &&
+		(val = vot_getValue (desc)) && *val) {
+		    fprintf (fd, ">\n<DESCRIPTION>");
+		    join_xmlStr (fd, val);
+		    fprintf (fd, "</DESCRIPTION>\n</FIELD>\n");
+	    } else
+		fprintf (fd, "/>\n");
+
+	    if (field)
+		field = vot_getNext (field);
+	}
+    }
+    if (j->radius > 0.0)
+	fprintf (fd, "<FIELD name=\"sep\" datatype=\"double\" unit=\"arcsec\" "
+	    "ucd=\"pos.angDistance\"/>\n");
+    fprintf (fd, "<DATA>\n<TABLEDATA>\n");
+}
+
+
+/**
+ *  JOIN_FOOTER -- Write the end of the output.
+ */
+static void
+join_footer (jJoin *j)
+{
+    if (j->vot_out)
+	fprintf (j->fd,
+	    "</TABLEDATA>\n</DATA>\n</TABLE>\n</RESOURCE>\n</VOTABLE>\n");
+}
+
+
+/**
+ *  JOIN_EMIT -- Write an output row from a probe and a build row, either
+ *  may be NULL for an unmatched row of an outer join.  The separation of
+ *  a positional match is in arcsec, negative if there is none.
+ */
+static void
+join_emit (jJoin *j, char **prow, char **brow, double sep)
+{
+    jTable *t;
+    char  **row, *s;
+    FILE   *fd = j->fd;
+    int     i, n;
+
+
+    if (j->vot_out)
+	fprintf (fd, "<TR>");
+
+    for (n=0; n < 2; n++) {
+	t   = &j->tab[n];
+	row = (t == j->probe ? prow : brow);
+
+	for (i=0; i < t->ncols; i++) {
+	    s = (row ? row[i] : NULL);
+	    if (j->vot_out) {
+		fprintf (fd, "<TD>");
+		if (s)
+		    join_xmlStr (fd, s);
+		fprintf (fd, "</TD>");
+	    } else {
+		if (s && strchr (s, (int) j->delim))
+		    fprintf (fd, "\"%s\"", s);
+		else if (s)
+		    fprintf (fd, "%s", s);
+		if (n == 0 || i < (t->ncols-1))
+		    putc (j->delim, fd);
+	    }
+	}
+    }
+
+    if (j->radius > 0.0) {
+	if (j->vot_out)
+	    fprintf (fd, (sep >= 0.0 ? "<TD>%.4f</TD>" : "<TD></TD>"), sep);
+	else if (sep >= 0.0)
+	    fprintf (fd, "%c%.4f", j->delim, sep);
+	else
+	    putc (j->delim, fd);
+    }
+
+    if (j->vot_out)
+	fprintf (fd, "</TR>\n");
+    else
+	putc ('\n', fd);
+    j->nout++;
+}
+
+
+/**
+ *  JOIN_XMLSTR -- Write a string with the XML special characters escaped.
+ */
+static void
+join_xmlStr (FILE *fd, char *s)
+{
+    for ( ; *s; s++) {
+	switch (*s) {
+	case '&':   fputs ("&amp;", fd);	break;
+	case '<':   fputs ("&lt;", fd);		break;
+	case '>':   fputs ("&gt;", fd);		break;
+	case '"':   fputs ("&quot;", fd);	break;
+	default:    putc (*s, fd);
+	}
+    }
+}
+
+
+/**
+ *  JOIN_FSIZE -- Size of an input file, or -1 if not known.
+ */
+static long
+join_fsize (char *fname)
+{
+    struct stat  st;
+
+    if (strcasecmp (fname, "stdin") == 0)
+	return (-1L);
+    if (strncmp (fname, "file://", 7) == 0)
+	fname += 7;
+    return ((stat (fname, &st) == 0) ? (long) st.st_size : -1L);
+}
+
+
+
+/****************************************************************************
+ *  Positional cross-match.
+ ****************************************************************************/
+
+/**
+ *  JOIN_POSCOLS -- Find the RA and Dec columns of a table, either those
+ *  named in the key list or the main position UCDs.
+ */
+static int
+join_posCols (jTable *t)
+{
+    handle_t field;
+    char    *ucd;
+    int      i, ra = -1, dec = -1;
+
+
+    if (t->keys) {
+	if (join_keyCols (t) != OK)
+	    return (ERR);
+	if (t->nkeys != 2) {
+	    fprintf (stderr, "Error: positional keys must be 'ra,dec'\n");
+	    return (ERR);
+	}
+	return (OK);
+    }
+
+    for (i=0, field=vot_getFIELD (t->tab); field;
+	field=vot_getNext (field), i++) {
+	    if ((ucd = vot_getAttr (field, "ucd")) == NULL)
+		continue;
+	    if (strcmp (ucd, "POS_EQ_RA_MAIN") == 0 ||		/* UCD 1  */
+		strcmp (ucd, "pos.eq.ra;meta.main") == 0)	/* UCD 1+ */
+		    ra = i;
+	    if (strcmp (ucd, "POS_EQ_DEC_MAIN") == 0 ||		/* UCD 1  */
+		strcmp (ucd, "pos.eq.dec;meta.main") == 0)	/* UCD 1+ */
+		    dec = i;
+	    free ((void *) ucd);
+    }
+    if (ra < 0 || dec < 0) {
+	fprintf (stderr, "Error: cannot find position columns in '%s'\n",
+	    t->iname);
+	return (ERR);
+    }
+
+    t->keycol[0] = ra;
+    t->keycol[1] = dec;
+    t->nkeys = 2;
+
+    return (OK);
+}
+
+
+/**
+ *  JOIN_COORD -- Convert a coordinate cell to degrees, sexagesimal values
+ *  are allowed and are in hours for the RA.
+ */
+static int
+join_coord (char *s, int hours, double *val)
+{
+    double  d, m = 0.0, sec = 0.0, sign = 1.0;
+    char   *ep;
+
+
+    if (s == NULL)
+	return (ERR);
+    while (isspace (*s))
+	s++;
+
+    if (strchr (s, (int) ':')) {
+	if (*s == '-' || *s == '+')
+	    sign = (*s++ == '-' ? -1.0 : 1.0);
+	if (sscanf (s, "%lf:%lf:%lf", &d, &m, &sec) < 2)
+	    return (ERR);
+	*val = sign * (d + m / 60.0 + sec / 3600.0) * (hours ? 15.0 : 1.0);
+	return (OK);
+    }
+
+    d = strtod (s, &ep);
+    if (ep == s || d != d)
+	return (ERR);
+    *val = d;
+
+    return (OK);
+}
+
+
+/**
+ *  JOIN_GETPOS -- Get the (RA,Dec) of a row in degrees.
+ */
+static int
+join_getPos (jTable *t, char **row, double *ra, double *dec)
+{
+    if (join_coord (row[t->keycol[0]], 1, ra) != OK ||
+	join_coord (row[t->keycol[1]], 0, dec) != OK)
+	    return (ERR);
+    if (*dec < -90.0 || *dec > 90.0)
+	return (ERR);
+
+    if ((*ra = fmod (*ra, 360.0)) < 0.0)
+	*ra += 360.0;
+
+    return (OK);
+}
+
+
+/**
+ *  JOIN_ZONE -- Zone number of a declination.
+ */
+static int
+join_zone (jHash *ht, double dec)
+{
+    int  z = (int) floor ((dec + 90.0) / ht->zh);
+
+    return (z < 0 ? 0 : (z >= ht->nzones ? ht->nzones - 1 : z));
+}
+
+
+/**
+ *  JOIN_ZONES -- Build the zone index of the build-side positions.
+ */
+static void
+join_zones (jJoin *j)
+{
+    jHash  *ht = &j->ht;
+    jZent  *e;
+    int    *fill, z;
+    long    r, n;
+
+
+    ht->zh     = (j->radius > 180.0 / MAX_ZONES ? j->radius :
+		    180.0 / MAX_ZONES);
+    ht->nzones = (int) (180.0 / ht->zh) + 1;
+    ht->zstart = (int *) calloc (ht->nzones + 1, sizeof (int));
+    fill       = (int *) calloc (ht->nzones + 1, sizeof (int));
+
+    for (r=0; r < ht->nrows; r++)		/* count each zone	*/
+	if (ht->dec[r] == ht->dec[r])
+	    ht->zstart[join_zone (ht, ht->dec[r]) + 1]++;
+    for (z=0; z < ht->nzones; z++)
+	ht->zstart[z+1] += ht->zstart[z];
+    n = ht->zstart[ht->nzones];
+
+    memcpy (fill, ht->zstart, (ht->nzones + 1) * sizeof (int));
+    ht->zent = (jZent *) malloc ((n ? n : 1) * sizeof (jZent));
+    for (r=0; r < ht->nrows; r++) {
+	if (ht->dec[r] != ht->dec[r])
+	    continue;
+	e = &ht->zent[fill[join_zone (ht, ht->dec[r])]++];
+	e->ra  = ht->ra[r];
+	e->x   = cos (ht->dec[r] * DEG2RAD) * cos (ht->ra[r] * DEG2RAD);
+	e->y   = cos (ht->dec[r] * DEG2RAD) * sin (ht->ra[r] * DEG2RAD);
+	e->z   = sin (ht->dec[r] * DEG2RAD);
+	e->row = (int) r;
+    }
+    free ((void *) fill);
+
+    join_run (j, T_SORT);		/* sort the zones by RA		*/
+
+    if (verbose)
+	fprintf (stderr, "Indexed %ld positions in %d zones, %d threads\n",
+	    n, ht->nzones, j->nthreads);
+}
+
+
+/**
+ *  JOIN_ZENTCMP -- Compare zone entries by RA.
+ */
+static int
+join_zentCmp (const void *a, const void *b)
+{
+    double  ra1 = ((jZent *) a)->ra, ra2 = ((jZent *) b)->ra;
+
+    return (ra1 < ra2 ? -1 : (ra1 > ra2 ? 1 : 0));
+}
+
+
+/**
+ *  JOIN_SEARCH -- Find the build rows within the radius of a position.
+ */
+static void
+join_search (jJoin *j, jWork *w, int prow, double ra, double dec)
+{
+    jHash  *ht = &j->ht;
+    double  r = j->radius, v[3], alpha, lo, hi, c1, c2;
+    int     z, z0, z1;
+
+
+    v[0] = cos (dec * DEG2RAD) * cos (ra * DEG2RAD);
+    v[1] = cos (dec * DEG2RAD) * sin (ra * DEG2RAD);
+    v[2] = sin (dec * DEG2RAD);
+
+    /*  Half-width in RA of the search box, the whole zone near a pole.
+     */
+    if (fabs (dec) + r >= 89.99)
+	alpha = 180.0;
+    else {
+	c1 = cos ((dec - r) * DEG2RAD);
+	c2 = cos ((dec + r) * DEG2RAD);
+	alpha = atan (sin (r * DEG2RAD) / sqrt (fabs (c1 * c2))) / DEG2RAD;
+	alpha = alpha * 1.000001 + 1.0e-9;
+    }
+
+    z0 = join_zone (ht, dec - r);
+    z1 = join_zone (ht, dec + r);
+    for (z=z0; z <= z1; z++) {
+	if (alpha >= 180.0) {
+	    join_scan (j, w, prow, z, 0.0, 360.0, v);
+	    continue;
+	}
+
+	lo = ra - alpha;
+	hi = ra + alpha;
+	if (lo < 0.0) {
+	    join_scan (j, w, prow, z, lo + 360.0, 360.0, v);
+	    join_scan (j, w, prow, z, 0.0, hi, v);
+	} else if (hi >= 360.0) {
+	    join_scan (j, w, prow, z, lo, 360.0, v);
+	    join_scan (j, w, prow, z, 0.0, hi - 360.0, v);
+	} else
+	    join_scan (j, w, prow, z, lo, hi, v);
+    }
+}
+
+
+/**
+ *  JOIN_SCAN -- Test the entries of a zone in an RA range.  With --best
+ *  and the probe table on the left only the nearest match is kept.
+ */
+static void
+join_scan (jJoin *j, jWork *w, int prow, int zn, double lo, double hi,
+	double *v)
+{
+    jHash  *ht = &j->ht;
+    jZent  *e, *end = &ht->zent[ht->zstart[zn+1]];
+    jMatch *m;
+    double  dx, dy, dz, d2, sep;
+    int     a = ht->zstart[zn], b = ht->zstart[zn+1], mid;
+
+
+    while (a < b) {				/* first entry >= lo	*/
+	mid = (a + b) / 2;
+	if (ht->zent[mid].ra < lo)
+	    a = mid + 1;
+	else
+	    b = mid;
+    }
+
+    for (e=&ht->zent[a]; e < end && e->ra <= hi; e++) {
+	dx = e->x - v[0];
+	dy = e->y - v[1];
+	dz = e->z - v[2];
+	if ((d2 = dx*dx + dy*dy + dz*dz) > j->chord2)
+	    continue;
+	sep = 2.0 * asin (sqrt (d2) / 2.0) / DEG2RAD * 3600.0;
+
+	if (j->best && j->probe == &j->tab[0] &&
+	    w->n > 0 && w->m[w->n-1].prow == prow) {
+		m = &w->m[w->n-1];
+		if (sep < m->sep)
+		    m->brow = e->row, m->sep = sep;
+		continue;
+	}
+
+	if (w->n == w->max) {
+	    w->max = (w->max ? 2 * w->max : 1024);
+	    w->m = (jMatch *) realloc (w->m, w->max * sizeof (jMatch));
+	}
+	m = &w->m[w->n++];
+	m->prow = prow;
+	m->brow = e->row;
+	m->sep  = sep;
+    }
+}
+
+
+/**
+ *  JOIN_XMATCH -- Cross-match a batch of probe rows.  The workers each
+ *  search a slice of the batch, the matches are then written in order.
+ */
+static void
+join_xmatch (jJoin *j, char **cells, int nrows)
+{
+    jHash  *ht = &j->ht;
+    jWork  *w;
+    jMatch *m;
+    int     k, i, p = 0, ncols = j->probe->ncols;
+
+
+    j->bcells = cells;
+    j->bnrows = nrows;
+    join_run (j, T_MATCH);
+
+    for (k=0; k < j->nthreads; k++) {
+	w = &j->work[k];
+	for (i=0; i < w->n; i++) {
+	    m = &w->m[i];
+	    for ( ; p < m->prow; p++)		/* unmatched rows before */
+		if (j->probe->keep)
+		    join_emit (j, &cells[p * ncols], NULL, -1.0);
+	    if (p == m->prow)
+		p++;
+
+	    if (j->best && j->build == &j->tab[0])
+		join_bestRow (j, &cells[m->prow * ncols], m->brow, m->sep);
+	    else {
+		join_emit (j, &cells[m->prow * ncols],
+		    &ht->cells[(long) m->brow * j->build->ncols], m->sep);
+		ht->matched[m->brow] = 1;
+	    }
+	}
+    }
+    for ( ; p < nrows; p++)
+	if (j->probe->keep)
+	    join_emit (j, &cells[p * ncols], NULL, -1.0);
+}
+
+
+/**
+ *  JOIN_BESTROW -- Keep a copy of a probe row if it is the nearest yet to
+ *  a build row (--best with the build table on the left).
+ */
+static void
+join_bestRow (jJoin *j, char **row, int brow, double sep)
+{
+    jHash  *ht = &j->ht;
+    char  **copy, *s;
+    size_t  len = 0;
+    int     i, ncols = j->probe->ncols;
+
+
+    if (ht->bsep[brow] >= 0.0 && ht->bsep[brow] <= sep)
+	return;
+
+    for (i=0; i < ncols; i++)
+	len += (row[i] ? strlen (row[i]) + 1 : 0);
+    if ((copy = (char **) malloc (ncols * sizeof (char *) + len)) == NULL)
+	return;
+
+    s = (char *) &copy[ncols];
+    for (i=0; i < ncols; i++) {
+	if (row[i]) {
+	    strcpy (s, row[i]);
+	    copy[i] = s;
+	    s += strlen (s) + 1;
+	} else
+	    copy[i] = NULL;
+    }
+
+    if (ht->best[brow])
+	free ((void *) ht->best[brow]);
+    ht->best[brow] = copy;
+    ht->bsep[brow] = sep;
+}
+
+
+/**
+ *  JOIN_BESTOUT -- Write the build rows with their best match.
+ */
+static void
+join_bestOut (jJoin *j)
+{
+    jHash  *ht = &j->ht;
+    long    r;
+
+    for (r=0; r < ht->nrows; r++) {
+	if (ht->best[r])
+	    join_emit (j, ht->best[r], &ht->cells[r * j->build->ncols],
+		ht->bsep[r]);
+	else if (j->build->keep)
+	    join_emit (j, NULL, &ht->cells[r * j->build->ncols], -1.0);
+    }
+}
+
+
+/**
+ *  JOIN_RUN -- Run a task on all the workers and wait for them to finish.
+ */
+static void
+join_run (jJoin *j, int task)
+{
+    j->task = task;
+    vot_poolRun (j->pool, join_work, (void *) j);
+}
+
+
+/**
+ *  JOIN_WORK -- Do worker k's share of the current task.
+ */
+static void
+join_work (void *data, int k)
+{
+    jJoin  *j = (jJoin *) data;
+    jHash  *ht = &j->ht;
+    jWork  *w = &j->work[k];
+    double  ra, dec;
+    int     z, i, lo, hi;
+
+
+    switch (j->task) {
+    case T_SORT:
+	for (z=k; z < ht->nzones; z += j->nthreads)
+	    if (ht->zstart[z+1] - ht->zstart[z] > 1)
+		qsort (&ht->zent[ht->zstart[z]],
+		    ht->zstart[z+1] - ht->zstart[z], sizeof (jZent),
+		    join_zentCmp);
+	break;
+
+    case T_MATCH:
+	lo = (int) ((long) j->bnrows * k / j->nthreads);
+	hi = (int) ((long) j->bnrows * (k + 1) / j->nthreads);
+	w->n = 0;
+	for (i=lo; i < hi; i++)
+	    if (join_getPos (j->probe, &j->bcells[(long) i * j->probe->ncols],
+		&ra, &dec) == OK)
+		    join_search (j, w, i, ra, dec);
+	break;
+    }
 }
@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "votParse.h"			/* keep these in order!		*/
 #include "voApps.h"
@@ -63,12 +65,16 @@ int
 votopic (int argc, char **argv, size_t *reslen, void **result)
 {
     int    i, nres_arg = 0, ndat_arg = 0, status = OK, term = 0;
+    int    pfd[2], wstat = 0;
     char  *res_argv[MAX_ARGS], *dat_argv[MAX_ARGS], *topic = NULL;
     char  *resname;
+    pid_t  pid;
 
 
     memset (res_argv, 0, argc+2);	/* initialize	*/
     memset (dat_argv, 0, argc+2);
+    debug   = 0;
+    by_subj = 0;
     resname = vot_mktemp ("votopic");
 
 
@@ -162,11 +168,11 @@ votopic (int argc, char **argv, size_t *reslen, void **result)
 #endif
 
 
-    /*  Create the list of VOREGISTRY arguments.
+    /*  Create the list of VOREGISTRY arguments.  The services found are
+     *  written as a feed rather than a resource file, see below.
      */
     vot_setArg (res_argv, &nres_arg, "-d");		/* dalOnly 	*/
-    vot_setArg (res_argv, &nres_arg, "-o");		/* output name	*/
-    vot_setArg (res_argv, &nres_arg, resname);
+    vot_setArg (res_argv, &nres_arg, "--feed");		/* service feed	*/
     if (by_subj)
         vot_setArg (res_argv, &nres_arg, "-s");
     vot_setArg (res_argv, &nres_arg, topic);
@@ -181,9 +187,26 @@ votopic (int argc, char **argv, size_t *reslen, void **result)
     }
 
 
-    /*  Run the Registry query to get the resource list of topics.
+    /*  Run the Registry query for the resource list of topics in a child
+     *  process.  Once the query returns, the child writes each service to
+     *  the pipe as its record is read.  Flush our output first so the child
+     *  doesn't inherit and repeat it.
      */
-    status = voregistry (nres_arg, res_argv, reslen, result);
+    fflush (stdout);
+    if (pipe (pfd) < 0 || (pid = fork ()) < 0) {
+	fprintf (stderr, "ERROR: process fork() fails\n");
+	status = ERR;
+	goto done;
+
+    } else if (pid == 0) {
+	close (pfd[0]);
+	dup2 (pfd[1], fileno (stdout));
+	close (pfd[1]);
+	status = voregistry (nres_arg, res_argv, reslen, result);
+	fflush (stdout);
+	_exit (status);
+    }
+    close (pfd[1]);
 
 
     /*  Initialize result object whether we return an object or not.
@@ -191,15 +214,20 @@ votopic (int argc, char **argv, size_t *reslen, void **result)
     *reslen = 0;	
     *result = NULL;
 
-   /*  The VODATA task does all the real work, execute it on the list of
-    *  resources we just obtained.
+   /*  The VODATA task does all the real work, execute it on the resources
+    *  as they arrive from the Registry results so the first data queries
+    *  run while the rest of the records are still being read.
     */
+    vot_svcFeedOpen (pfd[0]);
     status = vodata (ndat_arg, dat_argv, reslen, result);
+    vot_svcFeedClose ();			/* if vodata quit early	*/
+    waitpid (pid, &wstat, 0);
 
 
     /*  Clean up.  Rememebr to free whatever pointers were created when
      *  parsing arguments.
      */
+done:
     for (i=0; i < nres_arg; i++)
 	if (res_argv[i])
 	    free ((void *) res_argv[i]);
@@ -234,7 +262,8 @@ Usage (void)
         "       This query is against only 142 services (data found for 128),\n"
         "       a similar query against ALL catalog services would require\n"
         "       more than 8000 services to be queried. This is equivalent to\n"
-        "       the commands:\n"
+        "       the commands below, except that the services are queried as\n"
+        "       the Registry search finds them:\n"
 	"\n"
 	"           %% voregistry -t catalog -d -o lens.xml lens\n"
         "           %% vodata lens.xml A2712\n"
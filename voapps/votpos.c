@@ -7,6 +7,7 @@
  *    where
  *       -%%,--test              run unit tests
  *       -h,--help               this message
+ *       -N,--Number             number output (number after position)
  *       -n,--number             number output
  *       -o,--output=<file>      output file
  *       -r,--return             return result from method
@@ -16,6 +17,11 @@
  *  @date       6/03/12
  *
  *  @brief       Extract the main positional columns from a VOTable.
+ *
+ *  The table is streamed:  the RA/Dec columns are found from the FIELD
+ *  UCDs before the first row and only those two cells of each row are kept
+ *  and written, the rest of the row is never stored.  Only the first table
+ *  of the input is used.
  */
 
 #include <stdio.h>
@@ -30,9 +36,23 @@
 
 
 #define	SZ_RESBUF	8192
+#define	SZ_OUTBUF	65536		/* output buffer size		*/
+
+
+/*  Extraction state, passed to the row function.
+ */
+typedef struct {
+    char   *oname;			/* output file name		*/
+    FILE   *fd;				/* output file			*/
+    char   *obuf;			/* output buffer		*/
+    int     ra_col, dec_col;		/* position columns		*/
+    int     ncols;			/* table columns		*/
+    int     nrows;			/* rows written			*/
+    int     ntabs;			/* tables seen			*/
+    int     status;			/* task status			*/
+} posState;
 
 
-static int  vot		= 0;		/* VOTable handle		*/
 static int  number	= 0;		/* number values?		*/
 static int  do_return   = 0;		/* return result?		*/
 
@@ -61,6 +81,10 @@ static struct option long_opts[] = {
 static void Usage (void);
 static void Tests (char *input);
 
+static int  pos_findCols (posState *st, handle_t tab);
+static void pos_rows (void *client, handle_t tdata, char **cells,
+			int nrows, int flag);
+
 
 
 /**
@@ -69,17 +93,18 @@ static void Tests (char *input);
 int
 votpos (int argc, char **argv, size_t *reslen, void **result)
 {
-    char **pargv, optval[SZ_FNAME], *iname = NULL, *oname = NULL, *ucd = NULL;
-    int    res, tab, data, tdata, field, status = OK;
-    int    i, ncols, nrows, pos = 0, ch, ra_col, dec_col;
-    int    got_ra_col = 0, got_dec_col = 0;
-    FILE  *fd = (FILE *) NULL;
+    char **pargv, optval[SZ_FNAME], *iname = NULL, *oname = NULL;
+    int    pos = 0, ch;
+    handle_t vot = 0;
+    posState st;
 
 
     /*  Initialize. 
      */
     oname   = NULL;
     iname   = NULL;
+    number  = 0;
+    do_return = 0;
     *reslen = 0;
     *result = NULL;
 
@@ -118,85 +143,147 @@ votpos (int argc, char **argv, size_t *reslen, void **result)
     if (strcmp (oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
 	
 
-    /* Open the table.  This also parses it.
-    */
-    if ( (vot = vot_openVOTABLE (iname) ) <= 0) {
+    /*  Stream the table, the position columns are found from the FIELD
+     *  metadata before the first row and only those cells are kept.
+     */
+    memset (&st, 0, sizeof (st));
+    st.oname  = oname;
+    st.status = OK;
+
+    if ((vot = vot_streamRows (iname, pos_rows, (void *) &st)) <= 0) {
 	fprintf (stderr, "Error opening VOTable '%s'\n", iname);
-	return (1);
+	st.status = ERR;
+    } else if (st.ntabs == 0 && st.status == OK) {
+	/*  No TABLEDATA, nothing was printed but check the columns anyway.
+	 */
+	handle_t res = vot_getRESOURCE (vot);
+	if (res && vot_getLength (res) > 1) {
+	    fprintf (stderr,
+		"Error: multiple RESOURCE elements not supported\n");
+	} else if (!res || !pos_findCols (&st, vot_getTABLE (res))) {
+	    fprintf (stderr, "Error: Cannot find position columns in table.\n");
+	    st.status = ERR;
+	}
     }
 
-    res   = vot_getRESOURCE (vot);	/* get handles		*/
-    if (vot_getLength (res) > 1) {
-	fprintf (stderr, "Error: multiple RESOURCE elements not supported\n");
-        goto clean_up_;
+
+    /* Clean up.
+     */
+    if (st.fd) {
+	fflush (st.fd);
+	if (st.fd != stdout)
+	    fclose (st.fd);
     }
-    tab   = vot_getTABLE (res);
-    if ((data  = vot_getDATA (tab))) {
-        tdata = vot_getTABLEDATA (data);
-        nrows = vot_getNRows (tdata);
-        ncols = vot_getNCols (tdata);
-    } else
-        goto clean_up_;
+    if (st.obuf) free (st.obuf);
+    if (iname) free (iname);
+    if (oname) free (oname);
+
+    vo_paramFree (argc, pargv);
+    if (vot > 0)
+	vot_closeVOTABLE (vot);		/* close the table  	*/
+
+    return (st.status);
+}
+
+
+/**
+ *  POS_FINDCOLS -- Find the main RA and Dec columns of a table by UCD.
+ */
+static int
+pos_findCols (posState *st, handle_t tab)
+{
+    handle_t field;
+    char  *ucd = NULL;
+    int    i, got_ra_col = 0, got_dec_col = 0;
 
 
-    /*  Find the columns.
-    */
     for (i=0, field=vot_getFIELD(tab); field; field=vot_getNext (field),i++) {
 	if ((ucd  = vot_getAttr (field, "ucd"))) {
 	  if ((strcmp (ucd, "POS_EQ_RA_MAIN") == 0)  ||		/* UCD 1  */
 	      (strcmp (ucd, "pos.eq.ra;meta.main") == 0)) {	/* UCD 1+ */
-		ra_col = i;
+		st->ra_col = i;
 		got_ra_col = 1;
 	  }
 	  if ((strcmp (ucd, "POS_EQ_DEC_MAIN") == 0) ||		/* UCD 1  */
 	      (strcmp (ucd, "pos.eq.dec;meta.main") == 0)) {	/* UCD 1+ */
-		dec_col = i;
+		st->dec_col = i;
 		got_dec_col = 1;
 	  }
+	  free ((void *) ucd);
 	}
     }
-    if (!got_ra_col || !got_dec_col) {
-	fprintf (stderr, "Error: Cannot find position columns in table.\n");
-	status = ERR;
-        goto clean_up_;
-    }
-		
-    /*  Print the position cells.
-     */
-    fd = stdout;
-    if (strncasecmp ("stdout", oname, 6)) {
-	if ((fd = fopen (oname, "w+")) == NULL) {
-	    fprintf (stderr, "Error: Cannot open output file '%s'\n", oname);
-	    return (ERR);
-	}
-    }
+    return (got_ra_col && got_dec_col);
+}
 
-    for (i=0; i < nrows; i++) {
-	char  *ra, *dec, *s;
-
-	s   = vot_getTableCell (tdata, i, ra_col);   ra  = (s ? s : "INDEF");
-	s   = vot_getTableCell (tdata, i, dec_col);  dec = (s ? s : "INDEF");
-	if (number > 0)
-	    fprintf (fd, "%d  ", i);
-	fprintf (fd, "%s %s", ra, dec);
-	if (number < 0)
-	    fprintf (fd, "  %d", i);
-	fprintf (fd, "\n");
-    }
 
+/**
+ *  POS_ROWS -- Row function, print the position cells of each batch.
+ */
+static void
+pos_rows (void *client, handle_t tdata, char **cells, int nrows, int flag)
+{
+    posState *st = (posState *) client;
+    char  **row, *ra, *dec, num[32];
+    int     cols[2];
 
-    /* Clean up.
-     */
-clean_up_:
-    if (fd != stdout)
-	fclose (fd);
-    if (iname) free (iname);
-    if (oname) free (oname);
 
-    vo_paramFree (argc, pargv);
-    vot_closeVOTABLE (vot);		/* close the table  	*/
+    if (flag == VOT_ROWS_BEGIN) {
+	handle_t tab = vot_getParent (vot_getParent (tdata));
+
+	st->ncols = vot_getNCols (tdata);
+	st->ntabs++;
+	if (!pos_findCols (st, tab)) {
+	    fprintf (stderr, "Error: Cannot find position columns in table.\n");
+	    st->status = ERR;
+	    vot_streamStop ();
+	    return;
+	}
+
+	/*  Keep only the two position cells of each row.
+	 */
+	cols[0] = st->ra_col;
+	cols[1] = st->dec_col;
+	vot_streamColumns (cols, 2);
+
+	st->fd = stdout;
+	if (strncasecmp ("stdout", st->oname, 6)) {
+	    if ((st->fd = fopen (st->oname, "w+")) == NULL) {
+		fprintf (stderr, "Error: Cannot open output file '%s'\n",
+		    st->oname);
+		st->status = ERR;
+		vot_streamStop ();
+		return;
+	    }
+	    /*  Give our own output a large buffer, the stdout is left
+	     *  as the caller has it.
+	     */
+	    if ((st->obuf = (char *) malloc (SZ_OUTBUF)))
+		setvbuf (st->fd, st->obuf, _IOFBF, SZ_OUTBUF);
+	}
+	return;
 
-    return (status);
+    } else if (flag == VOT_ROWS_END) {
+	vot_streamStop ();		/* only the first table is used	*/
+	return;
+    }
+
+    for (row=cells; nrows-- > 0; row += st->ncols, st->nrows++) {
+	ra  = (row[st->ra_col]  ? row[st->ra_col]  : "INDEF");
+	dec = (row[st->dec_col] ? row[st->dec_col] : "INDEF");
+
+	if (number > 0) {
+	    sprintf (num, "%d  ", st->nrows);
+	    fputs (num, st->fd);
+	}
+	fputs (ra, st->fd);
+	fputc (' ', st->fd);
+	fputs (dec, st->fd);
+	if (number < 0) {
+	    sprintf (num, "  %d", st->nrows);
+	    fputs (num, st->fd);
+	}
+	fputc ('\n', st->fd);
+    }
 }
 
 
@@ -211,6 +298,7 @@ Usage (void)
         "  where\n"
         "       -%%,--test		run unit tests\n"
         "       -h,--help		this message\n"
+        "       -N,--Number		number output (number after position)\n"
         "       -n,--number		number output\n"
         "       -o,--output=<file>	output file\n"
         "       -r,--return		return result from method\n"
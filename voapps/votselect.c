@@ -0,0 +1,1688 @@
+/*
+ *  VOTSELECT -- Select rows from a VOTable with a boolean expression.
+ *
+ *    Usage:
+ *		votselect [<opts>] <expr> <votable.xml>
+ *
+ *  @file       votselect.c
+ *  @author     Mike Fitzpatrick
+ *  @date       6/03/12
+ *
+ *  @brief      Select rows from a VOTable with a boolean expression.
+ *
+ *  The expression is compiled once against the FIELDs of the table into a
+ *  short program for a vector machine:  each instruction computes a value
+ *  for every row of a batch of rows at once, and a column is converted to
+ *  an array of numbers (or strings) once per batch no matter how often it
+ *  is used.  The rows where the result is true are written as they are
+ *  read so the table size isn't limited by memory.  Null values follow the
+ *  SQL rules, a comparison with a null is itself null and a null result
+ *  doesn't select the row.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <regex.h>
+#include <fnmatch.h>
+
+#include "votParse.h"			/* keep these in order!		*/
+#include "voApps.h"
+
+
+#define	MAX_CODE	512		/* max program instructions	*/
+#define	MAX_REGS	512		/* max vector registers		*/
+#define	MAX_ARGS	4		/* max function arguments	*/
+#define	SZ_OBUF		262144		/* output buffer size		*/
+#define	DEG2RAD		(M_PI / 180.0)
+
+#define	T_NUM		0		/* value types			*/
+#define	T_STR		1
+
+#define	TK_EOF		0		/* expression tokens		*/
+#define	TK_NUM		1
+#define	TK_STR		2
+#define	TK_IDENT	3
+#define	TK_COL		4
+#define	TK_OP		5
+
+#define	OP_LDNUM	0		/* load column as numbers	*/
+#define	OP_LDSTR	1		/* load column as strings	*/
+#define	OP_TONUM	2		/* convert strings to numbers	*/
+#define	OP_NEG		3
+#define	OP_ADD		4
+#define	OP_SUB		5
+#define	OP_MUL		6
+#define	OP_DIV		7
+#define	OP_MOD		8
+#define	OP_POW		9
+#define	OP_NOT		10
+#define	OP_AND		11
+#define	OP_OR		12
+#define	OP_LT		13		/* numeric comparisons		*/
+#define	OP_LE		14
+#define	OP_GT		15
+#define	OP_GE		16
+#define	OP_EQ		17
+#define	OP_NE		18
+#define	OP_SLT		19		/* string comparisons		*/
+#define	OP_SLE		20
+#define	OP_SGT		21
+#define	OP_SGE		22
+#define	OP_SEQ		23
+#define	OP_SNE		24
+#define	OP_MATCH	25		/* regular expression match	*/
+#define	OP_LIKE		26		/* wildcard match		*/
+#define	OP_CONTAINS	27		/* substring match		*/
+#define	OP_LEN		28		/* string length		*/
+#define	OP_ISNULL	29		/* null number?			*/
+#define	OP_SNULL	30		/* null string?			*/
+#define	OP_FN1		31		/* math function of one arg	*/
+#define	OP_FN2		32		/* math function of two args	*/
+#define	OP_SEP		33		/* angular separation		*/
+
+#define	S_NULL(s)	((s) == NULL || *(s) == '\0')
+
+
+typedef struct {			/* a vector register		*/
+    int       type;			/* T_NUM or T_STR		*/
+    int       col;			/* column loaded (-1: none)	*/
+    int       konst;			/* constant value?		*/
+    double    dval;			/* constant number		*/
+    char     *sval;			/* constant string		*/
+    double    nullval;			/* column null value		*/
+    int       hasnull;			/* column has a null value?	*/
+    double   *num;			/* number vector		*/
+    char    **str;			/* string vector		*/
+} sReg;
+
+typedef struct {			/* a program instruction	*/
+    int       op;			/* opcode			*/
+    int       dst;			/* result register		*/
+    int       a, b, c, d;		/* argument registers		*/
+    int       col;			/* column to load		*/
+    double  (*fn1) (double);		/* OP_FN1 function		*/
+    double  (*fn2) (double, double);	/* OP_FN2 function		*/
+    regex_t  *re;			/* OP_MATCH pattern		*/
+} sInst;
+
+typedef struct {
+    char     *iname;			/* input file name		*/
+    char     *expr;			/* expression			*/
+    char     *cols;			/* output column list		*/
+    handle_t  tab;			/* selected <TABLE>		*/
+    int       ncols;			/* input columns		*/
+    int       ntables;			/* TABLEDATAs seen		*/
+
+    char     *ip;			/* parse position		*/
+    char     *tpos;			/* start of current token	*/
+    int       tok;			/* current token type		*/
+    char      tval[SZ_LINE];		/* current token value		*/
+    double    tnum;			/* current token number		*/
+
+    sInst     code[MAX_CODE];		/* compiled program		*/
+    int       ncode;
+    sReg      reg[MAX_REGS];		/* vector registers		*/
+    int       nregs;
+    int       result;			/* result register		*/
+    int       cap;			/* vector length		*/
+
+    int      *ocol;			/* output columns		*/
+    int       nout;
+    FILE     *fd;			/* output file			*/
+    int       vot_out;			/* VOTable output?		*/
+    char      delim;			/* delimited output separator	*/
+    int       count;			/* print the count only?	*/
+    long      nrows, nsel;		/* rows read and selected	*/
+    int       status;			/* OK or ERR			*/
+} sSel;
+
+
+/*  Math functions that may be called in an expression.
+ */
+static double sel_degrees (double x)	{ return (x / DEG2RAD); }
+static double sel_radians (double x)	{ return (x * DEG2RAD); }
+
+static struct {
+    char     *name;			/* function name		*/
+    double  (*fn1) (double);		/* one argument function	*/
+    double  (*fn2) (double, double);	/* two argument function	*/
+} funcs[] = {
+    { "abs",	  fabs,		NULL	},
+    { "sqrt",	  sqrt,		NULL	},
+    { "exp",	  exp,		NULL	},
+    { "log",	  log,		NULL	},
+    { "log10",	  log10,	NULL	},
+    { "sin",	  sin,		NULL	},
+    { "cos",	  cos,		NULL	},
+    { "tan",	  tan,		NULL	},
+    { "asin",	  asin,		NULL	},
+    { "acos",	  acos,		NULL	},
+    { "atan",	  atan,		NULL	},
+    { "floor",	  floor,	NULL	},
+    { "ceil",	  ceil,		NULL	},
+    { "round",	  round,	NULL	},
+    { "degrees",  sel_degrees,	NULL	},
+    { "radians",  sel_radians,	NULL	},
+    { "atan2",	  NULL,		atan2	},
+    { "pow",	  NULL,		pow	},
+    { "mod",	  NULL,		fmod	},
+    { "min",	  NULL,		fmin	},
+    { "max",	  NULL,		fmax	},
+    { NULL,	  NULL,		NULL	}
+};
+
+
+/*  Global task declarations.  These should all be defined as 'static' to
+ *  avoid namespace collisions.
+ */
+static int  do_return   = 0;		/* return result?		*/
+static int  verbose     = 0;		/* verbose output?		*/
+
+
+/*  Task specific option declarations.  Task options are declared using the
+ *  getopt_long(3) syntax.
+ */
+int  votselect (int argc, char **argv, size_t *len, void **result);
+
+static Task  self       = {  "votselect",  votselect,  0,  0,  0  };
+static char  *opts 	= "he:c:f:no:rv%:";
+static struct option long_opts[] = {
+        { "expr",         1, 0,   'e'},		/* task option		*/
+        { "cols",         1, 0,   'c'},		/* task option		*/
+        { "fmt",          1, 0,   'f'},		/* task option		*/
+        { "count",        2, 0,   'n'},		/* task option		*/
+        { "output",       1, 0,   'o'},		/* task option		*/
+        { "verbose",      2, 0,   'v'},		/* task option		*/
+        { "help",         2, 0,   'h'},		/* --help is std	*/
+        { "return",       2, 0,   'r'},		/* --return is std	*/
+        { "test",         1, 0,   '%'},		/* --test is std	*/
+        { NULL,           0, 0,    0 }
+};
+
+
+/*  All tasks should declare a static Usage() method to print the help
+ *  text in response to a '-h' or '--help' flag.  The help text should
+ *  include a usage summary, a description of options, and some examples.
+ */
+static void Usage (void);
+static void Tests (char *input);
+
+static void  sel_rows (void *client, handle_t tdata, char **cells, int nrows,
+			int flag);
+static int   sel_setTable (sSel *s, handle_t tdata);
+static int   sel_findCol (sSel *s, char *name);
+static int   sel_outCols (sSel *s);
+
+static int   sel_compile (sSel *s);
+static void  sel_lex (sSel *s);
+static int   sel_isOp (sSel *s, char *op);
+static int   sel_isWord (sSel *s, char *word);
+static int   sel_error (sSel *s, char *msg);
+static int   sel_or (sSel *s);
+static int   sel_and (sSel *s);
+static int   sel_not (sSel *s);
+static int   sel_cmp (sSel *s);
+static int   sel_add (sSel *s);
+static int   sel_mul (sSel *s);
+static int   sel_unary (sSel *s);
+static int   sel_pow (sSel *s);
+static int   sel_primary (sSel *s);
+static int   sel_call (sSel *s, char *name);
+static int   sel_regex (sSel *s, int a, int pat);
+static int   sel_column (sSel *s, int col, int type);
+static int   sel_number (sSel *s, int r);
+static int   sel_string (sSel *s, int r);
+static int   sel_reg (sSel *s, int type);
+static int   sel_const (sSel *s, double dval, char *sval);
+static int   sel_emit (sSel *s, int op, int type, int a, int b);
+
+static void  sel_alloc (sSel *s, int n);
+static void  sel_exec (sSel *s, char **cells, int n);
+static double sel_atof (char *s);
+
+static void  sel_header (sSel *s);
+static void  sel_footer (sSel *s);
+static void  sel_emitRow (sSel *s, char **row);
+static void  sel_xmlStr (FILE *fd, char *s);
+static void  sel_free (sSel *s);
+
+extern int strdic (char *in_str, char *out_str, int maxchars, char *dict);
+extern int vot_isNumericField (handle_t field);
+
+
+
+/**
+ *  Application entry point.  All VOApps tasks MUST contain this
+ *  method signature.
+ */
+int
+votselect (int argc, char **argv, size_t *reslen, void **result)
+{
+    char  **pargv, optval[SZ_FNAME], format[SZ_FORMAT];
+    char   *oname = NULL, *fmt = NULL, *arg[2] = { NULL, NULL };
+    int     ch = 0, status = OK, pos = 0, narg = 0;
+    handle_t vot;
+    sSel    s;
+
+
+    /* Initialize result object	whether we return an object or not.
+     */
+    *reslen = 0;
+    *result = NULL;
+
+    /*  Initialize local task values.
+     */
+    memset (&s, 0, sizeof (sSel));
+    do_return = 0;
+    verbose   = 0;
+
+
+    /*  Parse the argument list.  The use of vo_paramInit() is required to
+     *  rewrite the argv[] strings in a way vo_paramNext() can be used to
+     *  parse them.  The programmatic interface allows "param=value" to
+     *  be passed in, but the getopt_long() interface requires these to
+     *  be written as "--param=value" so they are not confused with
+     *  positional parameters (i.e. any param w/out a leading '-').
+     */
+    pargv = vo_paramInit (argc, argv, opts, long_opts);
+    while ((ch = vo_paramNext(opts,long_opts,argc,pargv,optval,&pos)) != 0) {
+        if (ch > 0) {
+	    /*  If the 'ch' value is > 0 we are parsing a single letter
+	     *  flag as defined in the 'opts string.
+	     */
+	    switch (ch) {
+	    case '%':  Tests (optval);			return (self.nfail);
+	    case 'h':  Usage ();			return (OK);
+	    case 'e':  s.expr = strdup (optval);	break;
+	    case 'c':  s.cols = strdup (optval);	break;
+	    case 'f':  fmt = strdup (optval);		break;
+	    case 'n':  s.count++;			break;
+	    case 'o':  oname = strdup (optval);		break;
+	    case 'r':  do_return=1;	    	    	break;
+	    case 'v':  verbose++;	    	    	break;
+	    default:
+		fprintf (stderr, "Invalid option '%s'\n", optval);
+		return (1);
+	    }
+
+        } else if (ch == PARG_ERR) {
+            return (ERR);
+
+	} else {
+	    /*  This code processes the positional arguments.  The 'optval'
+	     *  string contains the value but since this string is
+	     *  overwritten w/ each arch we need to make a copy (and must
+	     *  remember to free it later.
+	     */
+	    if (narg >= 2) {
+		fprintf (stderr, "Error: too many arguments '%s'\n", optval);
+		status = ERR;
+		goto clean_up_;
+	    }
+	    arg[narg++] = strdup (optval);
+	}
+    }
+
+
+    /*  Sanity checks.  Tasks should validate input and accept stdin/stdout
+     *  where it makes sense.  The expression is the first argument unless
+     *  given with --expr, the input defaults to the stdin.
+     */
+    if (s.expr == NULL && narg > 0) {
+	s.expr = arg[0];
+	arg[0] = arg[1], arg[1] = NULL, narg--;
+    }
+    if (s.expr == NULL || narg > 1) {
+	Usage ();
+	status = ERR;
+	goto clean_up_;
+    }
+    s.iname = (arg[0] ? arg[0] : strdup ("stdin")), arg[0] = NULL;
+    if (strcmp (s.iname, "-") == 0) {
+	free (s.iname), s.iname = strdup ("stdin");
+    }
+    if (oname == NULL) oname = strdup ("stdout");
+    if (strcmp (oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
+
+    s.vot_out = 1;
+    if (fmt) {
+	switch (strdic (fmt, format, SZ_FORMAT, FORMATS)) {
+	case   VOT:
+	case   XML:
+	case   RAW:   s.vot_out = 1;			break;
+	case   CSV:   s.vot_out = 0, s.delim = ',';	break;
+	case   TSV:   s.vot_out = 0, s.delim = '\t';	break;
+	case   BSV:   s.vot_out = 0, s.delim = '|';	break;
+	case   ASV:
+	case ASCII:   s.vot_out = 0, s.delim = ' ';	break;
+	default:
+	    fprintf (stderr, "Error: unsupported output format '%s'\n", fmt);
+	    status = ERR;
+	    goto clean_up_;
+	}
+    }
+
+    if (strcasecmp (oname, "stdout") == 0)
+	s.fd = stdout;
+    else if ((s.fd = fopen (oname, "w+")) == (FILE *) NULL) {
+	fprintf (stderr, "Error: cannot open output file '%s'\n", oname);
+	status = ERR;
+	goto clean_up_;
+    }
+    setvbuf (s.fd, NULL, _IOFBF, SZ_OBUF);
+
+
+    /*  Stream the table, the expression is compiled as the table starts.
+     */
+    if ((vot = vot_streamRows (s.iname, sel_rows, &s)) == 0) {
+	fprintf (stderr, "Error opening VOTable '%s'\n", s.iname);
+	s.status = ERR;
+    } else {
+	vot_closeVOTABLE (vot);
+	if (s.status == OK && s.ntables == 0) {
+	    fprintf (stderr, "Error: no TABLEDATA in '%s'\n", s.iname);
+	    s.status = ERR;
+	}
+    }
+
+    if (s.status == OK) {
+	if (s.count)
+	    fprintf (s.fd, "%ld\n", s.nsel);
+	else
+	    sel_footer (&s);
+
+	if (verbose)
+	    fprintf (stderr, "Selected %ld of %ld rows\n", s.nsel, s.nrows);
+    }
+    status = s.status;
+
+    if (s.fd != stdout)
+	fclose (s.fd);
+    else
+	fflush (s.fd);
+
+
+    /*  If we requested a return object, get it from the output file.
+     */
+    if (do_return && status == OK) {
+	vo_setResultFromFile (oname, reslen, result);
+	unlink (oname);
+    }
+
+
+    /*  Clean up.  Rememebr to free whatever pointers were created when
+     *  parsing arguments.
+     */
+clean_up_:
+    sel_free (&s);
+    if (arg[0]) free (arg[0]);
+    if (arg[1]) free (arg[1]);
+    if (fmt)    free (fmt);
+    if (oname)  free (oname);
+
+    vo_paramFree (argc, pargv);
+
+    return (status);	/* status must be OK or ERR (i.e. 0 or 1)     	*/
+}
+
+
+/**
+ *  USAGE -- Print task help summary.
+ */
+static void
+Usage (void)
+{
+    fprintf (stderr, "\n  Usage:\n\t"
+        "votselect [<opts>] <expr> [<votable.xml>]\n\n"
+        "  where\n"
+        "       -%%,--test		run unit tests\n"
+        "       -h,--help		this message\n"
+        "       -e,--expr=<expr>		selection expression\n"
+        "       -c,--cols=<cols>		output columns\n"
+        "       -f,--fmt=<fmt>		output format (vot|csv|tsv|asv|bsv)\n"
+        "       -n,--count		print the number of rows selected\n"
+        "       -o,--output=<file>	output file\n"
+        "       -r,--return		return result from method\n"
+        "       -v,--verbose		verbose output\n"
+	"\n"
+	"  A column is named in the expression by its name, ID or UCD, by\n"
+	"  '$N' for the N'th (1-indexed) column, or by '[name]' for a name\n"
+	"  that isn't a simple word.  The expression may use\n"
+	"\n"
+	"	+ - * / %% ^		arithmetic\n"
+	"	< <= > >= == != 	comparison (numbers or strings)\n"
+	"	&& || !  and or not	boolean logic\n"
+	"	~ !~			regular expression (not) matched\n"
+	"	isnull(x) len(s) like(s,'glob') match(s,'regex')\n"
+	"	contains(s,t) sep(ra1,dec1,ra2,dec2) (arcsec)\n"
+	"	abs sqrt exp log log10 sin cos tan asin acos atan\n"
+	"	atan2 pow mod min max floor ceil round degrees radians\n"
+	"\n"
+	"  Strings are quoted with ' or \", an expression beginning with a\n"
+	"  '-' must be put in parentheses.  An empty cell is null, a\n"
+	"  comparison with a null is also null and a row is selected only\n"
+	"  when the expression is true.  The --cols list selects the output\n"
+	"  columns in the same way, the default is all columns.\n"
+	"\n"
+ 	"  Examples:\n\n"
+	"    1)  Select the bright stars of a table:\n\n"
+	"	    %% votselect 'mag < 12 && class == \"star\"' cat.xml\n"
+	"\n"
+	"    2)  Select by UCD, output only some columns as CSV:\n\n"
+	"	    %% votselect -c id,ra,dec -f csv '[phot.mag;em.opt.V] < 10' "
+		"cat.xml\n"
+	"\n"
+	"    3)  Count the rows within 1 arcmin of a position:\n\n"
+	"	    %% votselect -n 'sep(ra,dec,10.68,41.27) < 60' cat.xml\n"
+	"\n"
+	"    4)  Rows with a name starting with 'NGC' and no redshift:\n\n"
+	"	    %% votselect --expr=\"name ~ '^NGC' and isnull(z)\" -o "
+		"out.xml cat.xml\n"
+	"\n"
+    );
+}
+
+
+/**
+ *  Tests -- Task unit tests.
+ */
+static void
+Tests (char *input)
+{
+   Task *task = &self;
+
+
+   /*  First argument must always be the 'self' variable, the last must
+    *  always be a NULL to terminate the cmd args.
+    */
+   vo_taskTest (task, "--help", NULL);
+
+   vo_taskTest (task, "id > 0", input, NULL);				// Ex 1
+   vo_taskTest (task, "-c", "id", "-f", "csv", "$1 >= 0", input, NULL);	// Ex 2
+   vo_taskTest (task, "-n", "!isnull(id)", input, NULL);		// Ex 3
+   vo_taskTest (task, "--expr=id ~ '^[0-9]' or not (id < 10)", 	// Ex 4
+	"-o", "sel.xml", input, NULL);
+   vo_taskTest (task, "-f", "tsv", "abs(sqrt(id) - 2) * 2 ^ 2 < 1e9",
+	input, NULL);
+
+   if (access ("sel.xml", F_OK) == 0)   unlink ("sel.xml");
+
+   vo_taskTestReport (self);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  SEL_ROWS -- Row function, evaluate the expression for each batch of
+ *  rows and write those selected.
+ */
+static void
+sel_rows (void *client, handle_t tdata, char **cells, int nrows, int flag)
+{
+    sSel   *s = (sSel *) client;
+    double *v;
+    int     i;
+
+
+    switch (flag) {
+    case VOT_ROWS_BEGIN:
+	if (s->ntables++ == 0 && s->status == OK)
+	    s->status = sel_setTable (s, tdata);
+	else if (s->ntables == 2)
+	    fprintf (stderr, "Warning: only the first table in '%s' is used\n",
+		s->iname);
+	break;
+
+    case VOT_ROWS_DATA:
+	if (s->ntables != 1 || s->status != OK)
+	    break;
+
+	sel_alloc (s, nrows);
+	sel_exec (s, cells, nrows);
+
+	for (i=0, v=s->reg[s->result].num; i < nrows; i++) {
+	    if (v[i] == v[i] && v[i] != 0.0) {
+		if (!s->count)
+		    sel_emitRow (s, &cells[(long) i * s->ncols]);
+		s->nsel++;
+	    }
+	}
+	s->nrows += nrows;
+	break;
+    }
+}
+
+
+/**
+ *  SEL_SETTABLE -- Compile the expression for a table as it starts.
+ */
+static int
+sel_setTable (sSel *s, handle_t tdata)
+{
+    s->tab   = vot_getParent (vot_getParent (tdata));
+    s->ncols = vot_getNCols (tdata);
+
+    if (sel_outCols (s) != OK || sel_compile (s) != OK)
+	return (ERR);
+
+    if (!s->count)
+	sel_header (s);
+    return (OK);
+}
+
+
+/**
+ *  SEL_FINDCOL -- Find a column by name, ID, UCD or 1-indexed number.
+ */
+static int
+sel_findCol (sSel *s, char *name)
+{
+    char  *ep;
+    int    col;
+
+
+    if ((col = vot_colByName (s->tab, name, NULL)) >= 0 ||
+	(col = vot_colByID (s->tab, name, NULL)) >= 0 ||
+	(col = vot_colByUCD (s->tab, name, NULL)) >= 0)
+	    return (col);
+
+    col = (int) strtol (name, &ep, 10);
+    if (ep != name && *ep == '\0' && col >= 1 && col <= s->ncols)
+	return (col - 1);
+
+    return (-1);
+}
+
+
+/**
+ *  SEL_OUTCOLS -- Set the list of output columns.
+ */
+static int
+sel_outCols (sSel *s)
+{
+    char  *list, *name, *last = NULL;
+    int    i, col;
+
+
+    s->ocol = (int *) calloc (s->ncols + 1, sizeof (int));
+    if (s->cols == NULL) {
+	for (i=0; i < s->ncols; i++)
+	    s->ocol[i] = i;
+	s->nout = s->ncols;
+	return (OK);
+    }
+
+    list = strdup (s->cols);
+    for (name=strtok_r (list, ",", &last); name;
+	name=strtok_r (NULL, ",", &last)) {
+	    while (isspace (*name))
+		name++;
+	    if (!*name)
+		continue;
+
+	    if ((col = sel_findCol (s, (*name == '$' ? name+1 : name))) < 0) {
+		fprintf (stderr, "Error: no column '%s' in '%s'\n", name,
+		    s->iname);
+		free (list);
+		return (ERR);
+	    }
+	    if (s->nout > s->ncols) {
+		fprintf (stderr, "Error: too many output columns\n");
+		free (list);
+		return (ERR);
+	    }
+	    s->ocol[s->nout++] = col;
+    }
+    free (list);
+
+    if (s->nout == 0) {
+	fprintf (stderr, "Error: no output columns given\n");
+	return (ERR);
+    }
+    return (OK);
+}
+
+
+
+/****************************************************************************
+ *  Expression compiler.
+ ****************************************************************************/
+
+/**
+ *  SEL_COMPILE -- Compile the expression.  This is a recursive-descent
+ *  parser that emits the instructions for each operator as it's parsed,
+ *  each instruction writing a new register, so the program is the
+ *  expression in postfix order and the last register is the result.
+ */
+static int
+sel_compile (sSel *s)
+{
+    int    r;
+
+
+    s->ip = s->expr;
+    sel_lex (s);
+
+    if ((r = sel_or (s)) < 0)
+	return (ERR);
+    if (s->tok != TK_EOF)
+	return (sel_error (s, "syntax error"));
+
+    if ((s->result = sel_number (s, r)) < 0)
+	return (ERR);
+
+    if (verbose > 1)
+	fprintf (stderr, "Compiled '%s': %d instructions, %d registers\n",
+	    s->expr, s->ncode, s->nregs);
+    return (OK);
+}
+
+
+/**
+ *  SEL_LEX -- Read the next token of the expression.
+ */
+static void
+sel_lex (sSel *s)
+{
+    static char *ops2[] = { "<=", ">=", "==", "!=", "<>", "&&", "||", "**",
+			    "!~", NULL };
+    char   *ip = s->ip, *ep, q;
+    int     n = 0, k;
+
+
+    while (isspace (*ip))
+	ip++;
+    s->tpos = ip;
+    s->tval[0] = '\0';
+
+    if (*ip == '\0') {
+	s->tok = TK_EOF;
+
+    } else if (isdigit (*ip) || (*ip == '.' && isdigit (ip[1]))) {
+	s->tnum = strtod (ip, &ep);
+	s->tok  = TK_NUM;
+	ip = ep;
+
+    } else if (isalpha (*ip) || *ip == '_') {
+	while ((isalnum (*ip) || *ip == '_' || *ip == '.') && n < SZ_LINE-1)
+	    s->tval[n++] = *ip++;
+	s->tok = TK_IDENT;
+
+    } else if (*ip == '\'' || *ip == '"') {
+	/*  Quoted string, a doubled quote is a literal quote.
+	 */
+	for (q=*ip++; *ip; ip++) {
+	    if (*ip == q && ip[1] != q)
+		break;
+	    if (*ip == q)
+		ip++;
+	    if (n < SZ_LINE-1)
+		s->tval[n++] = *ip;
+	}
+	s->tok = (*ip == q ? TK_STR : TK_OP);	/* unterminated: error	*/
+	if (*ip)
+	    ip++;
+
+    } else if (*ip == '$') {
+	for (ip++; isdigit (*ip) && n < SZ_LINE-1; )
+	    s->tval[n++] = *ip++;
+	s->tok = TK_COL;
+
+    } else if (*ip == '[') {
+	for (ip++; *ip && *ip != ']' && n < SZ_LINE-1; )
+	    s->tval[n++] = *ip++;
+	s->tok = (*ip == ']' ? TK_COL : TK_OP);
+	if (*ip)
+	    ip++;
+
+    } else {
+	s->tok = TK_OP;
+	for (k=0; ops2[k]; k++)
+	    if (strncmp (ip, ops2[k], 2) == 0)
+		break;
+	s->tval[n++] = *ip++;
+	if (ops2[k])
+	    s->tval[n++] = *ip++;
+    }
+
+    s->tval[n] = '\0';
+    s->ip = ip;
+}
+
+
+/**
+ *  SEL_ISOP -- Is the current token the given operator?
+ */
+static int
+sel_isOp (sSel *s, char *op)
+{
+    return (s->tok == TK_OP && strcmp (s->tval, op) == 0);
+}
+
+
+/**
+ *  SEL_ISWORD -- Is the current token the given keyword?
+ */
+static int
+sel_isWord (sSel *s, char *word)
+{
+    return (s->tok == TK_IDENT && strcasecmp (s->tval, word) == 0);
+}
+
+
+/**
+ *  SEL_ERROR -- Print a compile error at the current token.
+ */
+static int
+sel_error (sSel *s, char *msg)
+{
+    if (*s->tpos)
+	fprintf (stderr, "Error: %s at '%s' in expression\n", msg, s->tpos);
+    else
+	fprintf (stderr, "Error: %s at end of expression\n", msg);
+    return (-1);
+}
+
+
+/**
+ *  SEL_OR -- or_expr :: and_expr { ('||' | 'or') and_expr }
+ */
+static int
+sel_or (sSel *s)
+{
+    int    l, r;
+
+    if ((l = sel_and (s)) < 0)
+	return (-1);
+    while (sel_isOp (s, "||") || sel_isWord (s, "or")) {
+	sel_lex (s);
+	if ((r = sel_and (s)) < 0)
+	    return (-1);
+	l = sel_emit (s, OP_OR, T_NUM, sel_number (s, l), sel_number (s, r));
+    }
+    return (l);
+}
+
+
+/**
+ *  SEL_AND -- and_expr :: not_expr { ('&&' | 'and') not_expr }
+ */
+static int
+sel_and (sSel *s)
+{
+    int    l, r;
+
+    if ((l = sel_not (s)) < 0)
+	return (-1);
+    while (sel_isOp (s, "&&") || sel_isWord (s, "and")) {
+	sel_lex (s);
+	if ((r = sel_not (s)) < 0)
+	    return (-1);
+	l = sel_emit (s, OP_AND, T_NUM, sel_number (s, l), sel_number (s, r));
+    }
+    return (l);
+}
+
+
+/**
+ *  SEL_NOT -- not_expr :: ('!' | 'not') not_expr | cmp_expr
+ */
+static int
+sel_not (sSel *s)
+{
+    int    a;
+
+    if (sel_isOp (s, "!") || sel_isWord (s, "not")) {
+	sel_lex (s);
+	if ((a = sel_not (s)) < 0)
+	    return (-1);
+	return (sel_emit (s, OP_NOT, T_NUM, sel_number (s, a), -1));
+    }
+    return (sel_cmp (s));
+}
+
+
+/**
+ *  SEL_CMP -- cmp_expr :: add_expr [ cmp_op add_expr ]
+ *
+ *  Two strings are compared as strings, otherwise both sides are compared
+ *  as numbers.
+ */
+static int
+sel_cmp (sSel *s)
+{
+    static char *cmps[] = { "<", "<=", ">", ">=", "==", "!=", "=", "<>", NULL };
+    static int   nops[] = { OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+			    OP_EQ, OP_NE };
+    int    l, r, k, op;
+
+
+    if ((l = sel_add (s)) < 0)
+	return (-1);
+
+    if (sel_isOp (s, "~") || sel_isOp (s, "!~")) {
+	op = sel_isOp (s, "!~");
+	sel_lex (s);
+	if ((r = sel_add (s)) < 0 || (r = sel_regex (s, l, r)) < 0)
+	    return (-1);
+	return (op ? sel_emit (s, OP_NOT, T_NUM, r, -1) : r);
+    }
+
+    for (k=0; cmps[k] && !sel_isOp (s, cmps[k]); k++)
+	;
+    if (cmps[k] == NULL)
+	return (l);
+
+    sel_lex (s);
+    if ((r = sel_add (s)) < 0)
+	return (-1);
+
+    if (s->reg[l].type == T_STR && s->reg[r].type == T_STR)
+	return (sel_emit (s, nops[k] - OP_LT + OP_SLT, T_NUM, l, r));
+    else
+	return (sel_emit (s, nops[k], T_NUM, sel_number (s, l),
+	    sel_number (s, r)));
+}
+
+
+/**
+ *  SEL_ADD -- add_expr :: mul_expr { ('+' | '-') mul_expr }
+ */
+static int
+sel_add (sSel *s)
+{
+    int    l, r, op;
+
+    if ((l = sel_mul (s)) < 0)
+	return (-1);
+    while (sel_isOp (s, "+") || sel_isOp (s, "-")) {
+	op = (sel_isOp (s, "+") ? OP_ADD : OP_SUB);
+	sel_lex (s);
+	if ((r = sel_mul (s)) < 0)
+	    return (-1);
+	l = sel_emit (s, op, T_NUM, sel_number (s, l), sel_number (s, r));
+    }
+    return (l);
+}
+
+
+/**
+ *  SEL_MUL -- mul_expr :: unary_expr { ('*' | '/' | '%') unary_expr }
+ */
+static int
+sel_mul (sSel *s)
+{
+    int    l, r, op;
+
+    if ((l = sel_unary (s)) < 0)
+	return (-1);
+    while (sel_isOp (s, "*") || sel_isOp (s, "/") || sel_isOp (s, "%")) {
+	op = (sel_isOp (s, "*") ? OP_MUL : (sel_isOp (s, "/") ? OP_DIV:OP_MOD));
+	sel_lex (s);
+	if ((r = sel_unary (s)) < 0)
+	    return (-1);
+	l = sel_emit (s, op, T_NUM, sel_number (s, l), sel_number (s, r));
+    }
+    return (l);
+}
+
+
+/**
+ *  SEL_UNARY -- unary_expr :: ('-' | '+') unary_expr | pow_expr
+ */
+static int
+sel_unary (sSel *s)
+{
+    int    a;
+
+    if (sel_isOp (s, "-") || sel_isOp (s, "+")) {
+	int neg = sel_isOp (s, "-");
+
+	sel_lex (s);
+	if ((a = sel_unary (s)) < 0 || (a = sel_number (s, a)) < 0)
+	    return (-1);
+	if (!neg)
+	    return (a);
+	if (s->reg[a].konst)			/* fold a negative constant */
+	    return (sel_const (s, -s->reg[a].dval, NULL));
+	return (sel_emit (s, OP_NEG, T_NUM, a, -1));
+    }
+    return (sel_pow (s));
+}
+
+
+/**
+ *  SEL_POW -- pow_expr :: primary [ ('^' | '**') unary_expr ]
+ */
+static int
+sel_pow (sSel *s)
+{
+    int    l, r;
+
+    if ((l = sel_primary (s)) < 0)
+	return (-1);
+    if (sel_isOp (s, "^") || sel_isOp (s, "**")) {
+	sel_lex (s);
+	if ((r = sel_unary (s)) < 0)
+	    return (-1);
+	l = sel_emit (s, OP_POW, T_NUM, sel_number (s, l), sel_number (s, r));
+    }
+    return (l);
+}
+
+
+/**
+ *  SEL_PRIMARY -- primary :: number | string | column | func '(' args ')'
+ *				| '(' or_expr ')'
+ */
+static int
+sel_primary (sSel *s)
+{
+    char   name[SZ_LINE];
+    int    r, col;
+
+
+    switch (s->tok) {
+    case TK_NUM:
+	r = sel_const (s, s->tnum, NULL);
+	sel_lex (s);
+	return (r);
+
+    case TK_STR:
+	r = sel_const (s, 0.0, s->tval);
+	sel_lex (s);
+	return (r);
+
+    case TK_COL:
+    case TK_IDENT:
+	strcpy (name, s->tval);
+	if (s->tok == TK_IDENT) {
+	    while (isspace (*s->ip))
+		s->ip++;
+	    if (*s->ip == '(') {
+		sel_lex (s);
+		return (sel_call (s, name));
+	    }
+	    if (strcasecmp (name, "true") == 0 ||
+		strcasecmp (name, "false") == 0) {
+		    sel_lex (s);
+		    return (sel_const (s, (name[0] == 't' || name[0] == 'T'),
+			NULL));
+	    }
+	}
+	if ((col = sel_findCol (s, name)) < 0)
+	    return (sel_error (s, "unknown column"));
+	sel_lex (s);
+	return (sel_column (s, col, -1));
+
+    case TK_OP:
+	if (sel_isOp (s, "(")) {
+	    sel_lex (s);
+	    if ((r = sel_or (s)) < 0)
+		return (-1);
+	    if (!sel_isOp (s, ")"))
+		return (sel_error (s, "missing ')'"));
+	    sel_lex (s);
+	    return (r);
+	}
+	return (sel_error (s, "syntax error"));
+    }
+
+    return (sel_error (s, "unexpected end"));
+}
+
+
+/**
+ *  SEL_CALL -- Compile a function call, the current token is the '('.
+ */
+static int
+sel_call (sSel *s, char *name)
+{
+    int    arg[MAX_ARGS], nargs = 0, want, k, a, b;
+
+
+    sel_lex (s);
+    while (!sel_isOp (s, ")")) {
+	if (nargs >= MAX_ARGS)
+	    return (sel_error (s, "too many arguments"));
+	if ((arg[nargs++] = sel_or (s)) < 0)
+	    return (-1);
+	if (sel_isOp (s, ","))
+	    sel_lex (s);
+	else if (!sel_isOp (s, ")"))
+	    return (sel_error (s, "missing ')'"));
+    }
+
+    for (k=0; funcs[k].name && strcasecmp (name, funcs[k].name); k++)
+	;
+    if (funcs[k].name)
+	want = (funcs[k].fn1 ? 1 : 2);
+    else if (strcasecmp (name, "isnull") == 0 || strcasecmp (name, "len") == 0)
+	want = 1;
+    else if (strcasecmp (name, "like") == 0 ||
+	     strcasecmp (name, "match") == 0 ||
+	     strcasecmp (name, "contains") == 0)
+	want = 2;
+    else if (strcasecmp (name, "sep") == 0)
+	want = 4;
+    else {
+	fprintf (stderr, "Error: unknown function '%s' in expression\n", name);
+	return (-1);
+    }
+
+    if (nargs != want) {
+	fprintf (stderr, "Error: %s() takes %d argument%s\n", name, want,
+	    (want > 1 ? "s" : ""));
+	return (-1);
+    }
+    sel_lex (s);
+
+
+    if (funcs[k].name) {
+	if ((a = sel_number (s, arg[0])) < 0)
+	    return (-1);
+	if (funcs[k].fn1) {
+	    a = sel_emit (s, OP_FN1, T_NUM, a, -1);
+	    s->code[s->ncode-1].fn1 = funcs[k].fn1;
+	} else {
+	    if ((b = sel_number (s, arg[1])) < 0)
+		return (-1);
+	    a = sel_emit (s, OP_FN2, T_NUM, a, b);
+	    s->code[s->ncode-1].fn2 = funcs[k].fn2;
+	}
+	return (a);
+
+    } else if (strcasecmp (name, "isnull") == 0) {
+	return (sel_emit (s, (s->reg[arg[0]].type == T_STR ? OP_SNULL :
+	    OP_ISNULL), T_NUM, arg[0], -1));
+
+    } else if (strcasecmp (name, "len") == 0) {
+	if ((a = sel_string (s, arg[0])) < 0)
+	    return (-1);
+	return (sel_emit (s, OP_LEN, T_NUM, a, -1));
+
+    } else if (strcasecmp (name, "match") == 0) {
+	return (sel_regex (s, arg[0], arg[1]));
+
+    } else if (strcasecmp (name, "sep") == 0) {
+	for (k=0; k < 4; k++)
+	    if ((arg[k] = sel_number (s, arg[k])) < 0)
+		return (-1);
+	a = sel_emit (s, OP_SEP, T_NUM, arg[0], arg[1]);
+	s->code[s->ncode-1].c = arg[2];
+	s->code[s->ncode-1].d = arg[3];
+	return (a);
+
+    } else {
+	if ((a = sel_string (s, arg[0])) < 0 || (b = sel_string (s, arg[1])) < 0)
+	    return (-1);
+	return (sel_emit (s, (strcasecmp (name, "like") == 0 ? OP_LIKE :
+	    OP_CONTAINS), T_NUM, a, b));
+    }
+}
+
+
+/**
+ *  SEL_REGEX -- Compile a regular expression match, the pattern must be a
+ *  string constant so it's only compiled once.
+ */
+static int
+sel_regex (sSel *s, int a, int pat)
+{
+    regex_t *re;
+    char     msg[SZ_LINE];
+    int      r, err;
+
+
+    if ((a = sel_string (s, a)) < 0)
+	return (-1);
+    if (!s->reg[pat].konst || s->reg[pat].type != T_STR) {
+	fprintf (stderr, "Error: pattern must be a quoted string\n");
+	return (-1);
+    }
+
+    re = (regex_t *) calloc (1, sizeof (regex_t));
+    if ((err = regcomp (re, s->reg[pat].sval, REG_EXTENDED|REG_NOSUB))) {
+	regerror (err, re, msg, SZ_LINE);
+	fprintf (stderr, "Error: bad pattern '%s': %s\n", s->reg[pat].sval,
+	    msg);
+	free ((void *) re);
+	return (-1);
+    }
+
+    if ((r = sel_emit (s, OP_MATCH, T_NUM, a, -1)) < 0)
+	regfree (re), free ((void *) re);
+    else
+	s->code[s->ncode-1].re = re;
+    return (r);
+}
+
+
+/**
+ *  SEL_COLUMN -- Get the register holding a column, loading it as numbers
+ *  or strings (type -1: by the column datatype) unless already loaded.
+ */
+static int
+sel_column (sSel *s, int col, int type)
+{
+    handle_t field, values;
+    char    *nval, *dtype;
+    int      i, r;
+
+
+    for (i=0, field=vot_getFIELD (s->tab); field && i < col; i++)
+	field = vot_getNext (field);
+
+    if (type < 0) {
+	dtype = (field ? vot_getAttr (field, "datatype") : NULL);
+	type = (dtype && vot_isNumericField (field)) ? T_NUM : T_STR;
+	if (dtype)
+	    free ((void *) dtype);
+    }
+
+    for (r=0; r < s->nregs; r++)
+	if (s->reg[r].col == col && s->reg[r].type == type)
+	    return (r);
+
+    if ((r = sel_emit (s, (type == T_NUM ? OP_LDNUM : OP_LDSTR), type,
+	-1, -1)) < 0)
+	    return (-1);
+    s->code[s->ncode-1].col = col;
+    s->reg[r].col = col;
+
+    /*  A numeric column may declare a value that means null.
+     */
+    if (type == T_NUM && field && (values = vot_getVALUES (field)) &&
+	(nval = vot_getAttr (values, "null"))) {
+	    if (*nval) {
+		s->reg[r].nullval = sel_atof (nval);
+		s->reg[r].hasnull = (s->reg[r].nullval == s->reg[r].nullval);
+	    }
+	    free ((void *) nval);
+    }
+    return (r);
+}
+
+
+/**
+ *  SEL_NUMBER -- Get a register as numbers, converting it if needed.
+ */
+static int
+sel_number (sSel *s, int r)
+{
+    if (r < 0 || s->reg[r].type == T_NUM)
+	return (r);
+    if (s->reg[r].konst)
+	return (sel_const (s, sel_atof (s->reg[r].sval), NULL));
+    if (s->reg[r].col >= 0)
+	return (sel_column (s, s->reg[r].col, T_NUM));
+    return (sel_emit (s, OP_TONUM, T_NUM, r, -1));
+}
+
+
+/**
+ *  SEL_STRING -- Get a register as strings, only a column or a constant
+ *  may be used as a string.
+ */
+static int
+sel_string (sSel *s, int r)
+{
+    if (r < 0 || s->reg[r].type == T_STR)
+	return (r);
+    if (s->reg[r].col >= 0)
+	return (sel_column (s, s->reg[r].col, T_STR));
+
+    fprintf (stderr, "Error: string value expected in expression\n");
+    return (-1);
+}
+
+
+/**
+ *  SEL_REG -- Allocate a register.
+ */
+static int
+sel_reg (sSel *s, int type)
+{
+    sReg  *r;
+
+    if (s->nregs >= MAX_REGS) {
+	fprintf (stderr, "Error: expression too complex\n");
+	return (-1);
+    }
+    r = &s->reg[s->nregs];
+    memset (r, 0, sizeof (sReg));
+    r->type = type;
+    r->col  = -1;
+    return (s->nregs++);
+}
+
+
+/**
+ *  SEL_CONST -- Allocate a constant register, a string if 'sval' is given.
+ */
+static int
+sel_const (sSel *s, double dval, char *sval)
+{
+    int    r;
+
+    if ((r = sel_reg (s, (sval ? T_STR : T_NUM))) < 0)
+	return (-1);
+    s->reg[r].konst = 1;
+    s->reg[r].dval  = dval;
+    s->reg[r].sval  = (sval ? strdup (sval) : NULL);
+    return (r);
+}
+
+
+/**
+ *  SEL_EMIT -- Append an instruction, returns its result register.
+ */
+static int
+sel_emit (sSel *s, int op, int type, int a, int b)
+{
+    sInst *in;
+    int    r;
+
+
+    if ((op != OP_LDNUM && op != OP_LDSTR && a < 0) ||
+	(op >= OP_ADD && op <= OP_SNE && op != OP_NOT && b < 0))
+	    return (-1);			/* error in an operand	*/
+
+    if (s->ncode >= MAX_CODE) {
+	fprintf (stderr, "Error: expression too complex\n");
+	return (-1);
+    }
+    if ((r = sel_reg (s, type)) < 0)
+	return (-1);
+
+    in = &s->code[s->ncode++];
+    memset (in, 0, sizeof (sInst));
+    in->op  = op;
+    in->dst = r;
+    in->a   = a;
+    in->b   = b;
+    in->c   = in->d = in->col = -1;
+
+    return (r);
+}
+
+
+
+/****************************************************************************
+ *  Vector machine.
+ ****************************************************************************/
+
+/**
+ *  SEL_ALLOC -- Make sure the registers hold at least 'n' rows.
+ */
+static void
+sel_alloc (sSel *s, int n)
+{
+    sReg  *r;
+    int    i, k;
+
+
+    if (n <= s->cap)
+	return;
+
+    for (k=0; k < s->nregs; k++) {
+	r = &s->reg[k];
+	if (r->type == T_NUM) {
+	    r->num = (double *) realloc (r->num, n * sizeof (double));
+	    for (i=0; r->konst && i < n; i++)
+		r->num[i] = r->dval;
+	} else {
+	    r->str = (char **) realloc (r->str, n * sizeof (char *));
+	    for (i=0; r->konst && i < n; i++)
+		r->str[i] = r->sval;
+	}
+    }
+    s->cap = n;
+}
+
+
+/**
+ *  SEL_EXEC -- Run the program for a batch of rows.
+ */
+static void
+sel_exec (sSel *s, char **cells, int n)
+{
+    sInst  *in;
+    sReg   *r;
+    double *d, *a, *b, *c, *e, x, y, z;
+    char  **ds, **as, **bs;
+    long    ncols = s->ncols;
+    int     i, k;
+
+
+#define	ARG(x)		((x) >= 0 ? s->reg[x].num : NULL)
+#define	SARG(x)		((x) >= 0 ? s->reg[x].str : NULL)
+#define	NUMOP(expr)	for (i=0; i < n; i++) d[i] = (expr)
+#define	NUMCMP(rel)	for (i=0; i < n; i++) \
+			    d[i] = ((a[i] != a[i] || b[i] != b[i]) ? NAN : \
+				(double) (a[i] rel b[i]))
+#define	STRCMP(rel)	for (i=0; i < n; i++) \
+			    d[i] = ((S_NULL(as[i]) || S_NULL(bs[i])) ? NAN : \
+				(double) (strcmp (as[i], bs[i]) rel 0))
+
+    for (k=0; k < s->ncode; k++) {
+	in = &s->code[k];
+	r  = &s->reg[in->dst];
+	d  = r->num,    ds = r->str;
+	a  = ARG(in->a), as = SARG(in->a);
+	b  = ARG(in->b), bs = SARG(in->b);
+
+	switch (in->op) {
+	case OP_LDNUM:
+	    for (i=0; i < n; i++) {
+		d[i] = sel_atof (cells[i * ncols + in->col]);
+		if (r->hasnull && d[i] == r->nullval)
+		    d[i] = NAN;
+	    }
+	    break;
+	case OP_LDSTR:
+	    for (i=0; i < n; i++)
+		ds[i] = cells[i * ncols + in->col];
+	    break;
+	case OP_TONUM:	NUMOP(sel_atof (as[i]));			break;
+
+	case OP_NEG:	NUMOP(-a[i]);					break;
+	case OP_ADD:	NUMOP(a[i] + b[i]);				break;
+	case OP_SUB:	NUMOP(a[i] - b[i]);				break;
+	case OP_MUL:	NUMOP(a[i] * b[i]);				break;
+	case OP_DIV:	NUMOP(a[i] / b[i]);				break;
+	case OP_MOD:	NUMOP(fmod (a[i], b[i]));			break;
+	case OP_POW:	NUMOP(pow (a[i], b[i]));			break;
+
+	/*  Boolean operators use three-valued logic, a null is only the
+	 *  result when the other operand doesn't decide it.
+	 */
+	case OP_NOT:	NUMOP(a[i] != a[i] ? NAN : (double) (a[i] == 0.0));
+			break;
+	case OP_AND:
+	    for (i=0; i < n; i++) {
+		if (a[i] == 0.0 || b[i] == 0.0)
+		    d[i] = 0.0;
+		else
+		    d[i] = ((a[i] != a[i] || b[i] != b[i]) ? NAN : 1.0);
+	    }
+	    break;
+	case OP_OR:
+	    for (i=0; i < n; i++) {
+		if ((a[i] == a[i] && a[i] != 0.0) || (b[i] == b[i] && b[i] != 0.0))
+		    d[i] = 1.0;
+		else
+		    d[i] = ((a[i] != a[i] || b[i] != b[i]) ? NAN : 0.0);
+	    }
+	    break;
+
+	case OP_LT:	NUMCMP(<);					break;
+	case OP_LE:	NUMCMP(<=);					break;
+	case OP_GT:	NUMCMP(>);					break;
+	case OP_GE:	NUMCMP(>=);					break;
+	case OP_EQ:	NUMCMP(==);					break;
+	case OP_NE:	NUMCMP(!=);					break;
+	case OP_SLT:	STRCMP(<);					break;
+	case OP_SLE:	STRCMP(<=);					break;
+	case OP_SGT:	STRCMP(>);					break;
+	case OP_SGE:	STRCMP(>=);					break;
+	case OP_SEQ:	STRCMP(==);					break;
+	case OP_SNE:	STRCMP(!=);					break;
+
+	case OP_MATCH:
+	    NUMOP(S_NULL(as[i]) ? NAN :
+		(double) (regexec (in->re, as[i], 0, NULL, 0) == 0));
+	    break;
+	case OP_LIKE:
+	    NUMOP((S_NULL(as[i]) || S_NULL(bs[i])) ? NAN :
+		(double) (fnmatch (bs[i], as[i], 0) == 0));
+	    break;
+	case OP_CONTAINS:
+	    NUMOP((S_NULL(as[i]) || !bs[i]) ? NAN :
+		(double) (strstr (as[i], bs[i]) != NULL));
+	    break;
+	case OP_LEN:	NUMOP(S_NULL(as[i]) ? NAN : (double) strlen (as[i]));
+			break;
+	case OP_ISNULL:	NUMOP((double) (a[i] != a[i]));			break;
+	case OP_SNULL:	NUMOP((double) S_NULL(as[i]));			break;
+	case OP_FN1:	NUMOP((*in->fn1) (a[i]));			break;
+	case OP_FN2:	NUMOP((*in->fn2) (a[i], b[i]));			break;
+
+	case OP_SEP:
+	    /*  Haversine separation of (a,b) and (c,e) in arcsec.
+	     */
+	    c = ARG(in->c), e = ARG(in->d);
+	    for (i=0; i < n; i++) {
+		x = sin ((e[i] - b[i]) * DEG2RAD / 2.0);
+		y = sin ((c[i] - a[i]) * DEG2RAD / 2.0);
+		z = x * x + cos (b[i] * DEG2RAD) * cos (e[i] * DEG2RAD) * y * y;
+		d[i] = 2.0 * asin (sqrt (z < 1.0 ? z : 1.0)) / DEG2RAD * 3600.;
+	    }
+	    break;
+	}
+    }
+
+#undef	ARG
+#undef	SARG
+#undef	NUMOP
+#undef	NUMCMP
+#undef	STRCMP
+}
+
+
+/**
+ *  SEL_ATOF -- Convert a cell to a number, NaN if null or not a number.
+ */
+static double
+sel_atof (char *s)
+{
+    char   *ep;
+    double  d;
+
+    if (S_NULL(s))
+	return (NAN);
+    d = strtod (s, &ep);
+    if (ep == s)
+	return (NAN);
+    while (isspace (*ep))
+	ep++;
+    return (*ep ? NAN : d);
+}
+
+
+
+/****************************************************************************
+ *  Output.
+ ****************************************************************************/
+
+/**
+ *  SEL_HEADER -- Write the output header.
+ */
+static void
+sel_header (sSel *s)
+{
+    static char *attrs[] = { "datatype", "arraysize", "width", "precision",
+			     "unit", "ucd", "utype", "xtype", NULL };
+    handle_t field, desc;
+    char    *val, buf[SZ_LINE];
+    FILE    *fd = s->fd;
+    int      i, k, n;
+
+
+    if (!s->vot_out) {
+	fprintf (fd, "# ");
+	for (n=0; n < s->nout; n++) {
+	    for (i=0, field=vot_getFIELD (s->tab); field && i < s->ocol[n]; i++)
+		field = vot_getNext (field);
+	    if (field && (val = vot_getAttr (field, "name")) && *val)
+		fprintf (fd, "%s", val);
+	    else
+		fprintf (fd, "col%d", s->ocol[n]);
+	    if (field && val)
+		free ((void *) val);
+	    if (n < (s->nout-1))
+		putc (s->delim, fd);
+	}
+	putc ('\n', fd);
+	return;
+    }
+
+    fprintf (fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf (fd, "<VOTABLE version=\"1.2\" "
+	"xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+	"xmlns=\"http://www.ivoa.net/xml/VOTable/v1.2\">\n");
+    fprintf (fd, "<RESOURCE>\n<TABLE name=\"");
+    if ((val = vot_getAttr (s->tab, "name")) && *val)
+	sel_xmlStr (fd, val);
+    else
+	fprintf (fd, "votselect");
+    if (val)
+	free ((void *) val);
+    fprintf (fd, "\">\n");
+
+    for (n=0; n < s->nout; n++) {
+	for (i=0, field=vot_getFIELD (s->tab); field && i < s->ocol[n]; i++)
+	    field = vot_getNext (field);
+
+	fprintf (fd, "<FIELD");
+	if (field && (val = vot_getAttr (field, "id"))) {
+	    if (*val) {
+		fprintf (fd, " ID=\"");
+		sel_xmlStr (fd, val);
+		putc ('"', fd);
+	    }
+	    free ((void *) val);
+	}
+	if (field && (val = vot_getAttr (field, "name")) && *val)
+	    strncpy (buf, val, SZ_LINE-1), buf[SZ_LINE-1] = '\0';
+	else
+	    sprintf (buf, "col%d", s->ocol[n]);
+	if (field && val)
+	    free ((void *) val);
+	fprintf (fd, " name=\"");
+	sel_xmlStr (fd, buf);
+	putc ('"', fd);
+
+	for (k=0; field && attrs[k]; k++) {
+	    if ((val = vot_getAttr (field, attrs[k]))) {
+		if (*val) {
+		    fprintf (fd, " %s=\"", attrs[k]);
+		    sel_xmlStr (fd, val);
+		    putc ('"', fd);
+		}
+		free ((void *) val);
+	    }
+	}
+
+	if (field && (desc = vot_getDESCRIPTION (field)) &&
+	    (val = vot_getValue (desc)) && *val) {
+		fprintf (fd, ">\n<DESCRIPTION>");
+		sel_xmlStr (fd, val);
+		fprintf (fd, "</DESCRIPTION>\n</FIELD>\n");
+	} else
+	    fprintf (fd, "/>\n");
+    }
+    fprintf (fd, "<DATA>\n<TABLEDATA>\n");
+}
+
+
+/**
+ *  SEL_FOOTER -- Write the end of the output.
+ */
+static void
+sel_footer (sSel *s)
+{
+    if (s->vot_out)
+	fprintf (s->fd,
+	    "</TABLEDATA>\n</DATA>\n</TABLE>\n</RESOURCE>\n</VOTABLE>\n");
+}
+
+
+/**
+ *  SEL_EMITROW -- Write a selected row.
+ */
+static void
+sel_emitRow (sSel *s, char **row)
+{
+    char   *c;
+    FILE   *fd = s->fd;
+    int     n;
+
+
+    if (s->vot_out)
+	fprintf (fd, "<TR>");
+
+    for (n=0; n < s->nout; n++) {
+	c = row[s->ocol[n]];
+	if (s->vot_out) {
+	    fprintf (fd, "<TD>");
+	    if (c)
+		sel_xmlStr (fd, c);
+	    fprintf (fd, "</TD>");
+	} else {
+	    if (c && strchr (c, (int) s->delim))
+		fprintf (fd, "\"%s\"", c);
+	    else if (c)
+		fprintf (fd, "%s", c);
+	    if (n < (s->nout-1))
+		putc (s->delim, fd);
+	}
+    }
+
+    if (s->vot_out)
+	fprintf (fd, "</TR>\n");
+    else
+	putc ('\n', fd);
+}
+
+
+/**
+ *  SEL_XMLSTR -- Write a string with the XML special characters escaped.
+ */
+static void
+sel_xmlStr (FILE *fd, char *s)
+{
+    for ( ; *s; s++) {
+	switch (*s) {
+	case '&':   fputs ("&amp;", fd);	break;
+	case '<':   fputs ("&lt;", fd);		break;
+	case '>':   fputs ("&gt;", fd);		break;
+	case '"':   fputs ("&quot;", fd);	break;
+	default:    putc (*s, fd);
+	}
+    }
+}
+
+
+/**
+ *  SEL_FREE -- Free the compiled program and task state.
+ */
+static void
+sel_free (sSel *s)
+{
+    int    k;
+
+    for (k=0; k < s->ncode; k++) {
+	if (s->code[k].re) {
+	    regfree (s->code[k].re);
+	    free ((void *) s->code[k].re);
+	}
+    }
+    for (k=0; k < s->nregs; k++) {
+	if (s->reg[k].num)  free ((void *) s->reg[k].num);
+	if (s->reg[k].str)  free ((void *) s->reg[k].str);
+	if (s->reg[k].sval) free ((void *) s->reg[k].sval);
+    }
+    if (s->ocol)  free ((void *) s->ocol);
+    if (s->iname) free (s->iname);
+    if (s->expr)  free (s->expr);
+    if (s->cols)  free (s->cols);
+}
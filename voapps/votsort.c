@@ -123,6 +123,8 @@ votsort (int argc, char **argv, size_t *reslen, void **result)
      */
     iname  = NULL;
     oname  = NULL;
+    do_return  = 0;
+    sort_order = 1;
 
 
     /*  Parse the argument list.  The use of vo_paramInit() is required to
@@ -25,30 +25,22 @@
 /*  Global task declarations.  These should all be defined as 'static' to
  *  avoid namespace collisions.
  */
-static int  vot         = 0;            /* VOTable handle               */
 static int  do_return   = 0;		/* return result?		*/
 
 
-/*  Result Buffer.
- */
-#ifdef USE_RESBUF
-#define	SZ_RESBUF	8192
-
-static char *resbuf;
-#endif
-
-
 /*  Task specific option declarations.  Task options are declared using the
  *  getopt_long(3) syntax.
  */
 int  votsplit (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "votsplit",  votsplit,  0,  0,  0  };
-static char  *opts 	= "hr";
+static char  *opts 	= "hno:r%:";
 static struct option long_opts[] = {
         { "help",         2, 0,   'h'},		/* --help is std	*/
+        { "number",       2, 0,   'n'},		/* task option		*/
+        { "output",       1, 0,   'o'},		/* task option		*/
         { "return",       2, 0,   'r'},		/* --return is std	*/
-        { "test",         2, 0,   '%'},		/* --return is std	*/
+        { "test",         1, 0,   '%'},		/* --test is std	*/
         { NULL,           0, 0,    0 }
 };
 
@@ -68,8 +60,8 @@ int
 votsplit (int argc, char **argv, size_t *reslen, void **result)
 {
     char **pargv, optval[SZ_FNAME];
-    char  *iname, *oname;
-    int    ch = 0, status = OK, number = 0, pos = 0;
+    char  *iname, *oname, *ip;
+    int    ch = 0, status = OK, number = 0, pos = 0, nres = 0;
 
 
     /* Initialize result object	whether we return an object or not.
@@ -81,7 +73,7 @@ votsplit (int argc, char **argv, size_t *reslen, void **result)
      */
     iname  = NULL;
     oname  = NULL;
-    vot    = -1;
+    do_return = 0;
 
 
     /*  Parse the argument list.  The use of vo_paramInit() is required to
@@ -124,30 +116,31 @@ votsplit (int argc, char **argv, size_t *reslen, void **result)
 
 
     /*  Sanity checks.  Tasks should validate input and accept stdin/stdout
-     *  where it makes sense.
+     *  where it makes sense.  The output root defaults to the input name
+     *  without its path or extension.
      */
     if (iname == NULL) iname = strdup ("stdin");
-    if (oname == NULL) oname = strdup ("stdout");
     if (strcmp (iname, "-") == 0) { free (iname), iname = strdup ("stdin");  }
-    if (strcmp (oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
-
-
-
-
-   /********
-    ********
-    ********
-    ********
-    ********		Main body of task
-    ********
-    ********
-    ********
-    *******/
+    if (oname == NULL) {
+	if (strcasecmp (iname, "stdin") == 0)
+	    oname = strdup ("votsplit");
+	else {
+	    oname = strdup ((ip = strrchr (iname, '/')) ? ip+1 : iname);
+	    if ((ip = strrchr (oname, '.')) && ip != oname)
+		*ip = '\0';
+	}
+    }
 
 
+    /*  Stream each top-level <RESOURCE> to its own output table.
+     */
+    if ((nres = vot_streamSplit (iname, oname, number)) < 0)
+	status = ERR;
+    else if (nres == 0)
+	fprintf (stderr, "Warning: no <RESOURCE> found in '%s'\n", iname);
 
 
-    /*  Clean up.  Rememebr to free whatever pointers were created when
+    /*  Clean up.  Remember to free whatever pointers were created when
      *  parsing arguments.
      */
     if (iname)
@@ -172,16 +165,21 @@ Usage (void)
         "  where\n"
         "       -%%,--test		run unit tests\n"
         "       -h,--help		this message\n"
-        "       -n,--number		number output\n"
-        "       -o,--output=<file>	output file\n"
+        "       -n,--number		number output files\n"
+        "       -o,--output=<root>	output root name\n"
         "       -r,--return		return result from method\n"
 	"\n"
+	"  Each top-level <RESOURCE> is written to <root>.<id>.xml, where\n"
+	"  <id> is the ID or name of the RESOURCE, or to <root>.<N>.xml if\n"
+	"  it has neither or the -n flag is set.  The table is streamed\n"
+	"  rather than parsed so there is no limit on its size.\n"
+	"\n"
  	"  Examples:\n\n"
-	"    1)  First example\n\n"
-	"	    %% votsplit test.xml\n"
+	"    1)  Split a table into test.1.xml, test.2.xml, ...\n\n"
+	"	    %% votsplit -n test.xml\n"
 	"\n"
-	"    2)  Second example\n\n"
-	"	    %% votsplit -o pos.txt test.xml\n"
+	"    2)  Split a table into files with the root name 'res'\n\n"
+	"	    %% votsplit -o res test.xml\n"
 	"\n"
     );
 }
@@ -199,4 +197,10 @@ Tests (char *input)
     *  always be a NULL to terminate the cmd args.
     */
    vo_taskTest (task, "--help", NULL);
+
+   vo_taskTest (task, "-n", "-o", "split", input, NULL);	// Ex 1
+
+   if (access ("split.1.xml", F_OK) == 0)   unlink ("split.1.xml");
+
+   vo_taskTestReport (self);
 }
@@ -9,6 +9,14 @@
  *  @date       6/03/12
  *
  *  @brief      Compute statistics for numeric columns of a VOTable.
+ *
+ *  The table is streamed and all the columns are accumulated in a single
+ *  pass over the rows.  Each batch of rows is split between a pool of
+ *  worker threads that keep their own accumulators, these are merged when
+ *  the table ends.  The mean and variance use Welford's update and Chan's
+ *  merge so they don't lose precision on large tables, and the median and
+ *  percentiles come from a mergeable KLL quantile sketch so are only
+ *  approximate for a table larger than a few hundred rows.
  */
 
 #include <stdio.h>
@@ -22,11 +30,53 @@
 #include "voApps.h"
 
 
+#define	MAX_THREADS	64		/* max worker threads		*/
+#define	MAX_PCT		16		/* max percentiles		*/
+#define	SKETCH_K	256		/* quantile sketch size		*/
+#define	SKETCH_C	(2.0 / 3.0)	/* sketch level size ratio	*/
+
+#define	S_NULL(s)	((s) == NULL || *(s) == '\0')
+
+
+typedef struct {			/* a KLL quantile sketch	*/
+    double  **lev;			/* compactor at each level	*/
+    int      *len, *max;		/* level lengths, allocations	*/
+    int       nlev;			/* number of levels		*/
+    int       size, maxsize;		/* items held, compaction limit	*/
+    unsigned  seed;			/* compaction coin		*/
+} sSketch;
+
+typedef struct {			/* a column accumulator		*/
+    long      n;			/* number of values		*/
+    long      nnull;			/* null cells			*/
+    long      nnan;			/* NaN or non-numeric cells	*/
+    double    min, max;
+    double    mean, m2;			/* mean, sum of squared devs	*/
+    sSketch   q;			/* quantile sketch		*/
+} sAcc;
+
+
+typedef struct {
+    char     *iname;			/* input file name		*/
+    handle_t  tab;			/* <TABLE> being read		*/
+    int       ncols;			/* number of columns		*/
+    int       ntables;			/* TABLEDATAs seen		*/
+    long      nrows;			/* rows read			*/
+    int      *numeric;			/* numeric column?		*/
+    int      *hasnull;			/* column has a null value?	*/
+    double   *nullval;			/* column null value		*/
+    sAcc     *acc[MAX_THREADS];		/* per-thread accumulators	*/
+    int       status;			/* OK or ERR			*/
+
+    int       nthreads;			/* worker threads		*/
+    voPool   *pool;			/* worker pool			*/
+    char    **bcells;			/* batch being read		*/
+    int       bnrows;
+} sStat;
+
 
 /*  Global task declarations.
  */
-static int vot		= 0;		/* VOTable handle		*/
-
 static int  do_all	= 0;		/* all columns?			*/
 static int  do_return   = 0;		/* return result?		*/
 
@@ -49,12 +99,14 @@ static char *resbuf;
 int  votstat (int argc, char **argv, size_t *len, void **result);
 
 static Task  self       = {  "votstat",  votstat,  0,  0,  0  };
-static char  *opts 	= "%:hao:r";
+static char  *opts 	= "%:hao:p:n:r";
 static struct option long_opts[] = {
         { "test",         1, 0,   '%'},
         { "help",         2, 0,   'h'},
         { "all",          2, 0,   'a'},
         { "output",       1, 0,   'o'},
+        { "pct",          1, 0,   'p'},
+        { "nthreads",     1, 0,   'n'},
         { "return",       2, 0,   'r'},
         { NULL,           0, 0,    0 }
 };
@@ -65,11 +117,26 @@ static struct option long_opts[] = {
 static void Usage (void);
 static void Tests (char *input);
 
-void vot_colStat (int tdata, int col, int nrows, double *min, double *max, 
-	double *mean, double *stddev); 
+static void  stat_rows (void *client, handle_t tdata, char **cells, int nrows,
+			int flag);
+static int   stat_setTable (sStat *s, handle_t tdata);
+static void  stat_accum (sStat *s, sAcc *acc, char **cells, int lo, int hi);
+static void  stat_merge (sAcc *a, sAcc *b);
+static void  stat_print (sStat *s, FILE *fd, double *pct, int npct);
+static void  stat_free (sStat *s);
+
+static void  stat_skGrow (sSketch *q);
+static void  stat_skAdd (sSketch *q, int h, double x);
+static void  stat_skUpdate (sSketch *q, double x);
+static void  stat_skCompress (sSketch *q);
+static void  stat_skMerge (sSketch *a, sSketch *b);
+static void  stat_skQuantiles (sSketch *q, double *pct, int npct, double *val);
+static void  stat_skFree (sSketch *q);
+static int   stat_dblCmp (const void *a, const void *b);
+
+static void  stat_work (void *data, int k);
 
 extern int    vot_isNumericField (handle_t field);
-extern double vot_atof (char *v);
 
 
 /**
@@ -84,23 +151,27 @@ votstat (int argc, char **argv, size_t *reslen, void **result)
 
     /*  These declarations are specific to the task.
      */
-    char  *iname, *oname, *name, *id, *fstr;
-    int    ch = 0, status = OK, numeric = 0;
-    int    res, tab, data, tdata, field;
-    int    i, ncols, nrows, pos = 0;
+    char  *iname, *oname, *ip, *ep;
+    int    ch = 0, status = OK, pos = 0, npct = 0;
+    double pct[MAX_PCT], x;
+    handle_t vot;
+    sStat  s;
     FILE  *fd = (FILE *) NULL;
 
 
     /* Initialize result object	whether we return an object or not.
      */
-    *reslen = 0;	
+    *reslen = 0;
     *result = NULL;
 
     iname  = NULL; 		/* initialize local task values  	*/
     oname  = NULL;
+    do_all = 0;
+    do_return = 0;
+    memset (&s, 0, sizeof (sStat));
 
 
-    /*  Parse the argument list.  
+    /*  Parse the argument list.
      */
     pargv = vo_paramInit (argc, argv, opts, long_opts);
     while ((ch = vo_paramNext(opts,long_opts,argc,pargv,optval,&pos)) != 0) {
@@ -110,7 +181,20 @@ votstat (int argc, char **argv, size_t *reslen, void **result)
 	    case 'h':  Usage ();			return (OK);
 	    case 'a':  do_all++;			break;
 	    case 'o':  oname = strdup (optval);		break;
+	    case 'n':  s.nthreads = atoi (optval);	break;
 	    case 'r':  do_return=1;	    	    	break;
+	    case 'p':
+		for (ip=optval; *ip; ip = (*ep ? ep+1 : ep)) {
+		    x = strtod (ip, &ep);
+		    if (ep == ip || (*ep && *ep != ',') || x < 0.0 || x > 100.0) {
+			fprintf (stderr, "Error: invalid percentile list '%s'\n",
+			    optval);
+			return (ERR);
+		    }
+		    if (npct < MAX_PCT)
+			pct[npct++] = x;
+		}
+		break;
 	    default:
 		fprintf (stderr, "Invalid option '%s'\n", optval);
 		return (1);
@@ -136,60 +220,55 @@ votstat (int argc, char **argv, size_t *reslen, void **result)
     if (strcmp(iname, "-") == 0) { free (iname), iname = strdup ("stdin");  }
     if (strcmp(oname, "-") == 0) { free (oname), oname = strdup ("stdout"); }
 
-    if (strcmp ("stdout", oname) == 0) 
+    if (strcmp ("stdout", oname) == 0)
 	fd = stdout;
     else {
 	if ((fd = fopen (oname, "w+")) == (FILE *) NULL) {
 	    fprintf (stderr, "Cannot open output file '%s'\n", oname);
+	    free (iname), free (oname);
 	    return (ERR);
 	}
     }
 
-    /* Open the table.  This also parses it.
-    */
-    if ( (vot = vot_openVOTABLE (iname) ) <= 0) {
-        fprintf (stderr, "Error opening VOTable '%s'\n", iname);
-        return (1);
-    }
+    if (s.nthreads <= 0)
+	s.nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    s.nthreads = (s.nthreads < 1 ? 1 :
+	(s.nthreads > MAX_THREADS ? MAX_THREADS : s.nthreads));
+    s.iname = iname;
+
 
-    res   = vot_getRESOURCE (vot);      /* get handles          */
-    if (vot_getLength (res) > 1) {
-        fprintf (stderr, "Error: multiple RESOURCE elements not supported\n");
-        goto clean_up_;
+    /*  Stream the table, the statistics are accumulated as the rows are
+     *  read and the document holds only the metadata.
+     */
+    s.pool = vot_poolCreate (s.nthreads);
+    if (vot_poolSize (s.pool) < s.nthreads) {
+	s.nthreads = vot_poolSize (s.pool);
+	fprintf (stderr, "Warning: only %d worker threads started\n",
+	    s.nthreads);
     }
-    tab   = vot_getTABLE (res);
-    if ((data = vot_getDATA (tab)) <= 0)
+    if ((vot = vot_streamRows (iname, stat_rows, &s)) <= 0) {
+        fprintf (stderr, "Error opening VOTable '%s'\n", iname);
+        status = ERR;
 	goto clean_up_;
-    tdata = vot_getTABLEDATA (data);
-    nrows = vot_getNRows (tdata);
-    ncols = vot_getNCols (tdata);
-
-
-    fprintf (fd, "# %3s  %-20.20s  %9.9s  %9.9s  %9.9s  %9.9s\n#\n",
-	"Col", "Name", "Min", "Max", "Mean", "StdDev");
-
-    for (i=0,field=vot_getFIELD(tab); field; field=vot_getNext (field), i++) {
-        name  = vot_getAttr (field, "name");
-        id    = vot_getAttr (field, "id");
-
-	numeric = vot_isNumericField (field);
-	fstr = (name ? name : (id ? id : "(none)"));
+    }
 
-	if (do_all && !numeric)		/* non-numeric column		*/
-            fprintf (fd, "  %3d  %-20.20s\n", i, fstr);
+    if (s.status == OK && s.ntables > 0)
+	stat_print (&s, fd, pct, npct);
+    status = s.status;
+    vot_closeVOTABLE (vot);
 
-	else if (do_all || numeric) {	/* numeric column		*/
-	    double  min, max, mean, stddev;
+    if (fd != stdout)
+	fclose (fd);
+    else
+	fflush (fd);
+    fd = (FILE *) NULL;
 
-	    vot_colStat (tdata, i, nrows, &min, &max, &mean, &stddev);
 
-	    if (mean > 1.0e6 || mean < 1.0e-3)
-                fprintf (fd, "  %3d  %-20.20s  %9.4g  %9.4g  %9.4g  %9.4g\n",
-                    i, fstr, min, max, mean, stddev);
-	    else
-                fprintf (fd, "  %3d  %-20.20s  %9.2f  %9.2f  %9.2f  %9.2f\n",
-                    i, fstr, min, max, mean, stddev);
-	}
+    /*  If we requested a return object, get it from the output file.
+     */
+    if (do_return && status == OK) {
+	vo_setResultFromFile (oname, reslen, result);
+	unlink (oname);
     }
 
 
@@ -197,49 +276,20 @@ votstat (int argc, char **argv, size_t *reslen, void **result)
      *  parsing arguments.
      */
 clean_up_:
+    vot_poolFree (s.pool);
+    stat_free (&s);
     if (iname) free (iname);
     if (oname) free (oname);
 
     vo_paramFree (argc, pargv);
-    vot_closeVOTABLE (vot);
 
-    if (fd != stdout)
+    if (fd && fd != stdout)
 	fclose (fd);
 
     return (status);	/* status must be OK or ERR (i.e. 0 or 1)     	*/
 }
 
 
-/**
- *  VOT_COLSTAT -- Determine the statistics of a table column.
- */
-void
-vot_colStat (int tdata, int col, int nrows, double *min, double *max, 
-		double *mean, double *stddev)
-{
-    register int i = 0;
-    double  sum = 0.0, sum2 = 0.0, val = 0.0;
-
-
-    *min    =  0.99e306;
-    *max    = -0.99e306;
-    *mean   = 0.0;
-    *stddev = 0.0;
-
-    for (i=0; i < nrows; i++) {
-	val   = vot_atof (vot_getTableCell (tdata, i, col));
-	sum  += val;
-	sum2 += (val * val);
-	if (val < (*min))  *min = val;
-	if (val > (*max))  *max = val;
-    }
-
-    *mean = (double) (sum / (double) nrows);
-    *stddev = sqrt ( ( sum2 / (double) nrows) - 
-	( (sum / (double) nrows) * (sum / (double) nrows) ));
-}
-
-
 /**
  *  USAGE -- Print task help summary.
  */
@@ -254,7 +304,14 @@ Usage (void)
         "       -r,--return		return result from method\n"
 	"\n"
         "       -a,--all		print all columns\n"
+        "       -n,--nthreads=<N>	number of worker threads\n"
         "       -o,--output=<file>	output file\n"
+        "       -p,--pct=<list>		also print these percentiles\n"
+	"\n"
+	"  Empty cells and those equal to the column's VALUES null are\n"
+	"  counted as nulls, NaN and non-numeric values are counted\n"
+	"  separately, neither is included in the statistics.  The median\n"
+	"  and percentiles are estimated to within about 1%% in rank.\n"
 	"\n"
  	"  Examples:\n\n"
 	"    1) Print statistics for a VOTable\n\n"
@@ -264,6 +321,9 @@ Usage (void)
         "       results to a file.\n\n"
 	"	    %% votstat -a -o stats test.xml\n"
 	"\n"
+	"    3) Include the quartiles and 99th percentile, using 4 threads\n\n"
+	"	    %% votstat --pct=25,75,99 --nthreads=4 test.xml\n"
+	"\n"
     );
 }
 
@@ -278,4 +338,458 @@ Tests (char *input)
    Task *task = &self;
 
    vo_taskTest (task, "--help", NULL);
+
+   vo_taskTest (task, input, NULL);					// Ex 1
+   vo_taskTest (task, "-a", "-o", "stats", input, NULL);		// Ex 2
+   vo_taskTest (task, "--pct=25,75,99", "--nthreads=4", input, NULL);	// Ex 3
+   vo_taskTest (task, "-n", "1", "-p", "0,100", input, NULL);
+
+   if (access ("stats", F_OK) == 0)   unlink ("stats");
+
+   vo_taskTestReport (self);
+}
+
+
+
+/****************************************************************************
+ *  Private procedures.
+ ****************************************************************************/
+
+/**
+ *  STAT_ROWS -- Row function, accumulate each batch of rows.
+ */
+static void
+stat_rows (void *client, handle_t tdata, char **cells, int nrows, int flag)
+{
+    sStat  *s = (sStat *) client;
+
+    switch (flag) {
+    case VOT_ROWS_BEGIN:
+	if (s->ntables++ == 0 && s->status == OK)
+	    s->status = stat_setTable (s, tdata);
+	else if (s->ntables == 2)
+	    fprintf (stderr, "Warning: only the first table in '%s' is used\n",
+		s->iname);
+	break;
+
+    case VOT_ROWS_DATA:
+	if (s->ntables != 1 || s->status != OK)
+	    break;
+
+	s->bcells = cells;
+	s->bnrows = nrows;
+	vot_poolRun (s->pool, stat_work, (void *) s);
+	s->nrows += nrows;
+	break;
+    }
+}
+
+
+/**
+ *  STAT_SETTABLE -- Set up the accumulators as the table starts.
+ */
+static int
+stat_setTable (sStat *s, handle_t tdata)
+{
+    handle_t field, values;
+    char    *dtype, *nval, *ep;
+    int      i, k;
+
+
+    s->tab     = vot_getParent (vot_getParent (tdata));
+    s->ncols   = vot_getNCols (tdata);
+    s->numeric = (int *) calloc (s->ncols + 1, sizeof (int));
+    s->hasnull = (int *) calloc (s->ncols + 1, sizeof (int));
+    s->nullval = (double *) calloc (s->ncols + 1, sizeof (double));
+
+    for (i=0,field=vot_getFIELD(s->tab); field && i < s->ncols;
+	field=vot_getNext (field), i++) {
+	    dtype = vot_getAttr (field, "datatype");
+	    s->numeric[i] = (dtype && vot_isNumericField (field));
+
+	    if (s->numeric[i] && (values = vot_getVALUES (field)) &&
+		(nval = vot_getAttr (values, "null")) && *nval) {
+		    s->nullval[i] = strtod (nval, &ep);
+		    s->hasnull[i] = (ep != nval);
+	    }
+    }
+
+    for (k=0; k < s->nthreads; k++) {
+	s->acc[k] = (sAcc *) calloc (s->ncols + 1, sizeof (sAcc));
+	for (i=0; i < s->ncols; i++) {
+	    s->acc[k][i].min = HUGE_VAL;
+	    s->acc[k][i].max = -HUGE_VAL;
+	    s->acc[k][i].q.seed = (unsigned) (k * 7919 + i + 1);
+	}
+    }
+    return (OK);
+}
+
+
+/**
+ *  STAT_ACCUM -- Accumulate rows [lo,hi) of a batch.
+ */
+static void
+stat_accum (sStat *s, sAcc *acc, char **cells, int lo, int hi)
+{
+    register int i, c;
+    char   **row, *v, *ep;
+    double   x, d;
+    sAcc    *a;
+
+
+    for (i=lo; i < hi; i++) {
+	row = &cells[(long) i * s->ncols];
+
+	for (c=0; c < s->ncols; c++) {
+	    if (!s->numeric[c] && !do_all)
+		continue;
+
+	    a = &acc[c];
+	    if (S_NULL((v = row[c]))) {
+		a->nnull++;
+		continue;
+	    }
+	    if (!s->numeric[c]) {
+		a->n++;
+		continue;
+	    }
+
+	    x = strtod (v, &ep);
+	    while (isspace (*ep))
+		ep++;
+	    if (ep == v || *ep || x != x) {
+		a->nnan++;
+		continue;
+	    }
+	    if (s->hasnull[c] && x == s->nullval[c]) {
+		a->nnull++;
+		continue;
+	    }
+
+	    /*  Welford's update of the mean and sum of squared deviations.
+	     */
+	    a->n++;
+	    d = x - a->mean;
+	    a->mean += d / (double) a->n;
+	    a->m2   += d * (x - a->mean);
+	    if (x < a->min)  a->min = x;
+	    if (x > a->max)  a->max = x;
+
+	    stat_skUpdate (&a->q, x);
+	}
+    }
+}
+
+
+/**
+ *  STAT_MERGE -- Merge accumulator 'b' into 'a' (Chan et al).
+ */
+static void
+stat_merge (sAcc *a, sAcc *b)
+{
+    double  d;
+    long    n = a->n + b->n;
+
+
+    if (b->n > 0) {
+	d = b->mean - a->mean;
+	a->mean += d * ((double) b->n / (double) n);
+	a->m2   += b->m2 + d * d * ((double) a->n * (double) b->n / (double) n);
+	if (b->min < a->min)  a->min = b->min;
+	if (b->max > a->max)  a->max = b->max;
+	stat_skMerge (&a->q, &b->q);
+    }
+    a->n      = n;
+    a->nnull += b->nnull;
+    a->nnan  += b->nnan;
+}
+
+
+/**
+ *  STAT_PRINT -- Merge the thread accumulators and print the statistics.
+ */
+static void
+stat_print (sStat *s, FILE *fd, double *pct, int npct)
+{
+    handle_t field;
+    char    *name, *id, *fstr, *fmt, lab[SZ_FNAME];
+    double   p[MAX_PCT+1], val[MAX_PCT+1], stddev;
+    sAcc    *a;
+    int      i, k;
+
+
+    p[0] = 50.0;				/* the median		*/
+    for (k=0; k < npct; k++)
+	p[k+1] = pct[k];
+
+    fprintf (fd, "# %3s  %-20.20s  %8.8s  %6.6s  %6.6s  %9.9s  %9.9s  "
+	"%9.9s  %9.9s  %9.9s", "Col", "Name", "N", "Null", "NaN",
+	"Min", "Max", "Mean", "StdDev", "Median");
+    for (k=0; k < npct; k++) {
+	sprintf (lab, "P%g", pct[k]);
+	fprintf (fd, "  %9.9s", lab);
+    }
+    fprintf (fd, "\n#\n");
+
+    for (i=0,field=vot_getFIELD(s->tab); field && i < s->ncols;
+	field=vot_getNext (field), i++) {
+	    if (!s->numeric[i] && !do_all)
+		continue;
+
+	    for (k=1, a=&s->acc[0][i]; k < s->nthreads; k++)
+		stat_merge (a, &s->acc[k][i]);
+
+	    name  = vot_getAttr (field, "name");
+	    id    = vot_getAttr (field, "id");
+	    fstr  = ((name && *name) ? name : ((id && *id) ? id : "(none)"));
+
+	    fprintf (fd, "  %3d  %-20.20s  %8ld  %6ld  %6ld", i, fstr,
+		a->n, a->nnull, a->nnan);
+
+	    if (!s->numeric[i]) {		/* non-numeric column	*/
+		fprintf (fd, "\n");
+		continue;
+	    }
+	    if (a->n == 0) {
+		fprintf (fd, "  %9s  %9s  %9s  %9s  %9s\n",
+		    "INDEF", "INDEF", "INDEF", "INDEF", "INDEF");
+		continue;
+	    }
+
+	    stddev = sqrt (a->m2 / (double) a->n);
+	    stat_skQuantiles (&a->q, p, npct + 1, val);
+
+	    fmt = ((fabs (a->mean) > 1.0e6 || fabs (a->mean) < 1.0e-3) ?
+		"  %9.4g" : "  %9.2f");
+	    fprintf (fd, fmt, a->min);
+	    fprintf (fd, fmt, a->max);
+	    fprintf (fd, fmt, a->mean);
+	    fprintf (fd, fmt, stddev);
+	    for (k=0; k <= npct; k++)
+		fprintf (fd, fmt, val[k]);
+	    fprintf (fd, "\n");
+    }
+}
+
+
+/**
+ *  STAT_FREE -- Free the accumulators.
+ */
+static void
+stat_free (sStat *s)
+{
+    int    i, k;
+
+    for (k=0; k < MAX_THREADS; k++) {
+	if (s->acc[k]) {
+	    for (i=0; i < s->ncols; i++)
+		stat_skFree (&s->acc[k][i].q);
+	    free ((void *) s->acc[k]);
+	}
+    }
+    if (s->numeric) free ((void *) s->numeric);
+    if (s->hasnull) free ((void *) s->hasnull);
+    if (s->nullval) free ((void *) s->nullval);
+}
+
+
+
+/****************************************************************************
+ *  KLL quantile sketch (Karnin, Lang & Liberty 2016).  Values are added to
+ *  level 0, when a level fills it's sorted and every other value (chosen
+ *  by a coin toss) is promoted to the next level with twice the weight.
+ *  Lower levels are given smaller capacities so the sketch size is about
+ *  3*SKETCH_K values however many are added, and two sketches are merged
+ *  by concatenating their levels and compacting.
+ ****************************************************************************/
+
+/**
+ *  STAT_SKCAP -- Capacity of a sketch level.
+ */
+static int
+stat_skCap (sSketch *q, int h)
+{
+    return ((int) ceil (pow (SKETCH_C, (double) (q->nlev - h - 1)) *
+	SKETCH_K) + 1);
+}
+
+
+/**
+ *  STAT_SKGROW -- Add a level to a sketch.
+ */
+static void
+stat_skGrow (sSketch *q)
+{
+    int    h;
+
+    q->lev = (double **) realloc (q->lev, (q->nlev + 1) * sizeof (double *));
+    q->len = (int *) realloc (q->len, (q->nlev + 1) * sizeof (int));
+    q->max = (int *) realloc (q->max, (q->nlev + 1) * sizeof (int));
+    q->lev[q->nlev] = NULL;
+    q->len[q->nlev] = q->max[q->nlev] = 0;
+    q->nlev++;
+
+    for (h=0, q->maxsize=0; h < q->nlev; h++)
+	q->maxsize += stat_skCap (q, h);
+}
+
+
+/**
+ *  STAT_SKADD -- Append a value to a sketch level.
+ */
+static void
+stat_skAdd (sSketch *q, int h, double x)
+{
+    if (q->len[h] >= q->max[h]) {
+	q->max[h] = (q->max[h] ? 2 * q->max[h] : SKETCH_K / 2);
+	q->lev[h] = (double *) realloc (q->lev[h], q->max[h] * sizeof (double));
+    }
+    q->lev[h][q->len[h]++] = x;
+}
+
+
+/**
+ *  STAT_SKUPDATE -- Add a value to a sketch.
+ */
+static void
+stat_skUpdate (sSketch *q, double x)
+{
+    if (q->nlev == 0)
+	stat_skGrow (q);
+    stat_skAdd (q, 0, x);
+    if (++q->size >= q->maxsize)
+	stat_skCompress (q);
+}
+
+
+/**
+ *  STAT_SKCOMPRESS -- Compact the lowest full level of a sketch.  With an
+ *  odd number of values the smallest stays behind.
+ */
+static void
+stat_skCompress (sSketch *q)
+{
+    int    h, i, n, odd;
+
+
+    for (h=0; h < q->nlev; h++) {
+	if (q->len[h] < stat_skCap (q, h))
+	    continue;
+	if (h + 1 >= q->nlev)
+	    stat_skGrow (q);
+
+	n   = q->len[h];
+	odd = n & 1;
+	qsort (q->lev[h], n, sizeof (double), stat_dblCmp);
+
+	q->seed = q->seed * 1103515245 + 12345;
+	for (i=odd + ((q->seed >> 16) & 1); i < n; i += 2)
+	    stat_skAdd (q, h + 1, q->lev[h][i]);
+
+	q->len[h] = odd;
+	q->size  -= (n - odd) / 2;
+	break;
+    }
+}
+
+
+/**
+ *  STAT_SKMERGE -- Merge sketch 'b' into 'a'.
+ */
+static void
+stat_skMerge (sSketch *a, sSketch *b)
+{
+    int    h, i;
+
+    if (a->nlev == 0)
+	stat_skGrow (a);
+    while (a->nlev < b->nlev)
+	stat_skGrow (a);
+
+    for (h=0; h < b->nlev; h++) {
+	for (i=0; i < b->len[h]; i++)
+	    stat_skAdd (a, h, b->lev[h][i]);
+	a->size += b->len[h];
+    }
+    while (a->size >= a->maxsize)
+	stat_skCompress (a);
+}
+
+
+/**
+ *  STAT_SKQUANTILES -- Estimate the given percentiles from a sketch.
+ */
+static void
+stat_skQuantiles (sSketch *q, double *pct, int npct, double *val)
+{
+    double *v, total = 0.0, cum;
+    int     h, i, k, n = 0;
+
+
+    /*  Sort the values, each is encoded with its level in a pair so the
+     *  weight goes with it.
+     */
+    v = (double *) calloc (2 * q->size + 2, sizeof (double));
+    for (h=0; h < q->nlev; h++) {
+	for (i=0; i < q->len[h]; i++, n++) {
+	    v[2*n]   = q->lev[h][i];
+	    v[2*n+1] = ldexp (1.0, h);
+	    total   += v[2*n+1];
+	}
+    }
+    qsort (v, n, 2 * sizeof (double), stat_dblCmp);
+
+    for (k=0; k < npct; k++) {
+	for (i=0, cum=0.0; i < n - 1; i++) {
+	    if ((cum += v[2*i+1]) >= pct[k] / 100.0 * total)
+		break;
+	}
+	val[k] = (n > 0 ? v[2*i] : 0.0);
+    }
+    free ((void *) v);
+}
+
+
+/**
+ *  STAT_SKFREE -- Free a sketch.
+ */
+static void
+stat_skFree (sSketch *q)
+{
+    int    h;
+
+    for (h=0; h < q->nlev; h++)
+	if (q->lev[h])
+	    free ((void *) q->lev[h]);
+    if (q->lev) free ((void *) q->lev);
+    if (q->len) free ((void *) q->len);
+    if (q->max) free ((void *) q->max);
+    memset (q, 0, sizeof (sSketch));
+}
+
+
+/**
+ *  STAT_DBLCMP -- Compare two doubles for qsort().
+ */
+static int
+stat_dblCmp (const void *a, const void *b)
+{
+    double  x = *(double *) a, y = *(double *) b;
+
+    return ((x < y) ? -1 : ((x > y) ? 1 : 0));
+}
+
+
+/**
+ *  STAT_WORK -- Accumulate worker k's slice of the current batch.
+ */
+static void
+stat_work (void *data, int k)
+{
+    sStat *s = (sStat *) data;
+    int    lo = (int) ((long) s->bnrows * k / s->nthreads);
+    int    hi = (int) ((long) s->bnrows * (k + 1) / s->nthreads);
+
+    stat_accum (s, s->acc[k], s->bcells, lo, hi);
 }